@@ -26,7 +26,10 @@
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/app/chain_write_queue.hpp>
 #include <graphene/app/impacted.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/account_history_store.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -77,7 +80,9 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ) );
+          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ),
+             std::dynamic_pointer_cast< market_history_plugin >( _app.get_plugin( "market_history" ) ).get(),
+             _app.api_readers() );
        }
        else if( api_name == "network_broadcast_api" )
        {
@@ -106,48 +111,38 @@ namespace graphene { namespace app {
 
     network_broadcast_api::network_broadcast_api(application& a):_app(a)
     {
-       _applied_block_connection = _app.chain_database()->applied_block.connect([this](const signed_block& b){ on_applied_block(b); });
     }
 
-    void network_broadcast_api::on_applied_block( const signed_block& b )
+    void network_broadcast_api::broadcast_transaction(const signed_transaction& trx)
     {
-       if( _callbacks.size() )
-       {
-          /// we need to ensure the database_api is not deleted for the life of the async operation
-          auto capture_this = shared_from_this();
-          for( uint32_t trx_num = 0; trx_num < b.transactions.size(); ++trx_num )
-          {
-             const auto& trx = b.transactions[trx_num];
-             auto id = trx.id();
-             auto itr = _callbacks.find(id);
-             if( itr != _callbacks.end() )
-             {
-                auto block_num = b.block_num();
-                auto& callback = _callbacks.find(id)->second;
-                fc::async( [capture_this,this,id,block_num,trx_num,trx,callback](){ callback( fc::variant(transaction_confirmation{ id, block_num, trx_num, trx}) ); } );
-             }
-          }
-       }
+       _app.chain_database()->validate_transaction_stateless(trx);
+       _app.write_queue().run( chain_write_queue::api_write, [&]() { _app.chain_database()->push_transaction(trx); } );
+       _app.p2p_node()->broadcast_transaction(trx);
     }
 
-    void network_broadcast_api::broadcast_transaction(const signed_transaction& trx)
+    vector<transaction_admission> network_broadcast_api::broadcast_transactions(const vector<signed_transaction>& trxs)
     {
-       trx.validate();
-       _app.chain_database()->push_transaction(trx);
-       _app.p2p_node()->broadcast_transaction(trx);
+       vector<transaction_admission> results = _app.write_queue().run( chain_write_queue::api_write, [&]() {
+          return _app.chain_database()->push_transactions(trxs);
+       });
+       for( size_t i = 0; i < trxs.size(); ++i )
+          if( results[i].trx.valid() )
+             _app.p2p_node()->broadcast_transaction(trxs[i]);
+       return results;
     }
 
     void network_broadcast_api::broadcast_block( const signed_block& b )
     {
-       _app.chain_database()->push_block(b);
+       _app.write_queue().run( chain_write_queue::block_write, [&]() { return _app.chain_database()->push_block(b); } );
        _app.p2p_node()->broadcast( net::block_message( b ));
     }
 
     void network_broadcast_api::broadcast_transaction_with_callback(confirmation_callback cb, const signed_transaction& trx)
     {
-       trx.validate();
-       _callbacks[trx.id()] = cb;
-       _app.chain_database()->push_transaction(trx);
+       _app.chain_database()->validate_transaction_stateless(trx);
+       /// the api is kept alive while the callback runs
+       _app.confirmations()->watch( trx, shared_from_this(), cb );
+       _app.write_queue().run( chain_write_queue::api_write, [&]() { _app.chain_database()->push_transaction(trx); } );
        _app.p2p_node()->broadcast_transaction(trx);
     }
 
@@ -187,6 +182,24 @@ namespace graphene { namespace app {
        return _app.p2p_node()->set_advanced_node_parameters(params);
     }
 
+    fc::variant_object network_node_api::get_network_statistics() const
+    {
+       fc::mutable_variant_object result = _app.p2p_node()->network_get_statistics();
+       result["usage"] = _app.p2p_node()->network_get_usage_stats();
+       result["delegate_call_statistics"] = _app.p2p_node()->get_call_statistics();
+       return result;
+    }
+
+    block_production_statistics network_node_api::get_block_production_statistics() const
+    {
+       return _app.get_block_production_statistics();
+    }
+
+    std::vector<slow_api_call> network_node_api::get_slow_api_calls() const
+    {
+       return _app.api_calls().get_slow_calls();
+    }
+
     fc::api<network_broadcast_api> login_api::network_broadcast()const
     {
        FC_ASSERT(_network_broadcast_api);
@@ -223,7 +236,7 @@ namespace graphene { namespace app {
        return *_debug_api;
     }
 
-    vector<account_id_type> get_relevant_accounts( const object* obj )
+    vector<account_id_type> get_relevant_accounts( const object* obj, const graphene::chain::database& db )
     {
        vector<account_id_type> result;
        if( obj->id.space() == protocol_ids )
@@ -335,7 +348,11 @@ namespace graphene { namespace app {
                   const auto& aobj = dynamic_cast<const transaction_object*>(obj);
                   assert( aobj != nullptr );
                   flat_set<account_id_type> impacted;
-                  transaction_get_impacted_accounts( aobj->trx, impacted );
+                  // without keep-transaction-bodies a transaction in a block is read back from the block log
+                  if( aobj->trx.valid() )
+                     transaction_get_impacted_accounts( *aobj->trx, impacted );
+                  else
+                     transaction_get_impacted_accounts( db.get_recent_transaction( aobj->trx_id ), impacted );
                   result.reserve( impacted.size() );
                   for( auto& item : impacted ) result.emplace_back(item);
                   break;
@@ -367,27 +384,36 @@ namespace graphene { namespace app {
        return result;
     } // end get_relevant_accounts( obj )
 
+    /** the on-disk tier of the account history, if the account history plugin keeps one */
+    static const account_history::account_history_store* account_history_store_of( const application& app )
+    {
+       auto plugin = std::dynamic_pointer_cast<account_history::account_history_plugin>( app.get_plugin( "account_history" ) );
+       return plugin ? plugin->history_store() : nullptr;
+    }
+
     vector<order_history_object> history_api::get_fill_order_history( asset_id_type a, asset_id_type b, uint32_t limit  )const
     {
        FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
+       auto hist = _app.get_plugin<market_history_plugin>( "market_history" );
        if( a > b ) std::swap(a,b);
-       const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-       history_key hkey;
-       hkey.base = a;
-       hkey.quote = b;
-       hkey.sequence = std::numeric_limits<int64_t>::min();
-
-       uint32_t count = 0;
-       auto itr = history_idx.lower_bound( hkey );
        vector<order_history_object> result;
-       while( itr != history_idx.end() && count < limit)
-       {
-          if( itr->key.base != a || itr->key.quote != b ) break;
-          result.push_back( *itr );
-          ++itr;
-          ++count;
-       }
+       hist->read_history( [&]( const graphene::db::object_database& db ) {
+          const auto& history_idx = db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
+          history_key hkey;
+          hkey.base = a;
+          hkey.quote = b;
+          hkey.sequence = std::numeric_limits<int64_t>::min();
+
+          uint32_t count = 0;
+          auto itr = history_idx.lower_bound( hkey );
+          while( itr != history_idx.end() && count < limit)
+          {
+             if( itr->key.base != a || itr->key.quote != b ) break;
+             result.push_back( *itr );
+             ++itr;
+             ++count;
+          }
+       });
 
        return result;
     }
@@ -401,21 +427,28 @@ namespace graphene { namespace app {
        const auto& db = *_app.chain_database();       
        FC_ASSERT( limit <= 100 );
        vector<operation_history_object> result;
-       const auto& stats = account(db).statistics(db);
-       if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
-       const account_transaction_history_object* node = &stats.most_recent_op(db);
-       if( start == operation_history_id_type() )
-          start = node->operation_id;
-          
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+       const auto& by_op_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_op>();
+       auto itr = start == operation_history_id_type() ? by_op_idx.upper_bound( boost::make_tuple( account ) )
+                                                       : by_op_idx.upper_bound( boost::make_tuple( account, start ) );
+       auto begin = by_op_idx.lower_bound( boost::make_tuple( account ) );
+       while( itr != begin && result.size() < limit )
        {
-          if( node->operation_id.instance.value <= start.instance.value )
-             result.push_back( node->operation_id(db) );
-          if( node->next == account_transaction_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
+          --itr;
+          if( itr->operation_id.instance.value <= stop.instance.value )
+             return result;
+          result.push_back( itr->operation_id(db) );
+       }
+
+       // older operations may have been moved to the on-disk store
+       auto store = account_history_store_of( _app );
+       if( store && result.size() < limit )
+       {
+          uint64_t older = start == operation_history_id_type() ? std::numeric_limits<uint64_t>::max() : start.instance.value;
+          if( !result.empty() )
+             older = result.back().id.instance() - 1;
+          auto stored = store->get_account_history( account, older, stop.instance.value, limit - result.size() );
+          result.insert( result.end(), stored.begin(), stored.end() );
        }
-       
        return result;
     }
     
@@ -435,15 +468,23 @@ namespace graphene { namespace app {
        const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
        
        auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-       auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
-       --itr;
-       
-       while ( itr != itr_stop && result.size() < limit )
+       auto begin = by_seq_idx.lower_bound( boost::make_tuple( account ) );
+       uint32_t older = start;
+       while( itr != begin && result.size() < limit )
        {
-          result.push_back( itr->operation_id(db) );
           --itr;
+          if( itr->sequence <= stop )
+             return result;
+          result.push_back( itr->operation_id(db) );
+          older = itr->sequence - 1;
+       }
+
+       auto store = account_history_store_of( _app );
+       if( store && result.size() < limit )
+       {
+          auto stored = store->get_relative_account_history( account, older, stop, limit - result.size() );
+          result.insert( result.end(), stored.begin(), stored.end() );
        }
-       
        return result;
     }
 
@@ -458,25 +499,49 @@ namespace graphene { namespace app {
                                                            uint32_t bucket_seconds, fc::time_point_sec start, fc::time_point_sec end )const
     { try {
        FC_ASSERT(_app.chain_database());
-       const auto& db = *_app.chain_database();
+       auto hist = _app.get_plugin<market_history_plugin>( "market_history" );
        vector<bucket_object> result;
        result.reserve(200);
 
        if( a > b ) std::swap(a,b);
 
-       const auto& bidx = db.get_index_type<bucket_index>();
-       const auto& by_key_idx = bidx.indices().get<by_key>();
+       hist->read_history( [&]( const graphene::db::object_database& db ) {
+          const auto& bidx = db.get_index_type<bucket_index>();
+          const auto& by_key_idx = bidx.indices().get<by_key>();
 
-       auto itr = by_key_idx.lower_bound( bucket_key( a, b, bucket_seconds, start ) );
-       while( itr != by_key_idx.end() && itr->key.open <= end && result.size() < 200 )
-       {
-          if( !(itr->key.base == a && itr->key.quote == b && itr->key.seconds == bucket_seconds) )
+          auto itr = by_key_idx.lower_bound( bucket_key( a, b, bucket_seconds, start ) );
+          while( itr != by_key_idx.end() && itr->key.open <= end && result.size() < 200 )
           {
-            return result;
+             if( !(itr->key.base == a && itr->key.quote == b && itr->key.seconds == bucket_seconds) )
+                break;
+             result.push_back(*itr);
+             ++itr;
           }
-          result.push_back(*itr);
-          ++itr;
-       }
+
+          // a rolled up size does not include the newest bucket of the size it is rolled up from yet
+          const uint32_t source = hist->rollup_source( bucket_seconds );
+          if( source == 0 || result.size() >= 200 )
+             return;
+          auto newest = by_key_idx.upper_bound( bucket_key( a, b, source, fc::time_point_sec::maximum() ) );
+          if( newest == by_key_idx.begin() )
+             return;
+          --newest;
+          if( newest->key.base != a || newest->key.quote != b || newest->key.seconds != source )
+             return;
+          bucket_key rolled( a, b, bucket_seconds, fc::time_point() +
+                             fc::seconds( (newest->key.open.sec_since_epoch() / bucket_seconds) * bucket_seconds ) );
+          if( rolled.open < start || rolled.open > end )
+             return;
+          if( !result.empty() && result.back().key.open == rolled.open )
+             merge_bucket( result.back(), *newest );
+          else
+          {
+             bucket_object open_bucket = *newest;
+             open_bucket.id = object_id_type();
+             open_bucket.key = rolled;
+             result.push_back( open_bucket );
+          }
+       });
        return result;
     } FC_CAPTURE_AND_RETHROW( (a)(b)(bucket_seconds)(start)(end) ) }
     
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_call_log.hpp>
+
+#include <fc/io/json.hpp>
+
+namespace graphene { namespace app {
+
+const size_t api_call_log::max_argument_chars;
+const size_t api_call_log::default_max_slow_calls;
+
+api_call_log::api_call_log( graphene::utilities::metrics_registry* metrics )
+   : _metrics( metrics )
+{
+   if( _metrics )
+      _slow_calls_total = &_metrics->counter( "graphene_api_slow_calls_total",
+                                              "API calls that took longer than api-slow-call-threshold-ms" );
+}
+
+void api_call_log::set_threshold( fc::microseconds threshold )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _threshold = threshold;
+}
+
+fc::microseconds api_call_log::threshold()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _threshold;
+}
+
+void api_call_log::set_max_slow_calls( size_t max_calls )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _max_slow_calls = max_calls;
+   while( _slow_calls.size() > _max_slow_calls )
+      _slow_calls.pop_front();
+}
+
+std::vector<double> api_call_log::size_buckets()
+{
+   return { 256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216 };
+}
+
+const api_call_log::method_metrics& api_call_log::get_method_metrics( const std::string& method )
+{
+   auto itr = _method_metrics.find( method );
+   if( itr != _method_metrics.end() )
+      return itr->second;
+   method_metrics& m = _method_metrics[method];
+   const std::string labels = "method=\"" + method + "\"";
+   m.response_size = &_metrics->histogram( "graphene_api_response_bytes", "Size of the JSON of API responses",
+                                           size_buckets(), labels );
+   m.encode_time = &_metrics->histogram( "graphene_api_encode_seconds", "Time spent encoding API results as JSON",
+                                         graphene::utilities::metrics_registry::latency_buckets(), labels );
+   return m;
+}
+
+void api_call_log::record( const std::string& method, const fc::variants& args, const std::string& remote_endpoint,
+                           fc::microseconds duration, const fc::optional<fc::microseconds>& encode_time,
+                           uint64_t response_size, bool failed )
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   if( _metrics && !failed )
+   {
+      const method_metrics& m = get_method_metrics( method );
+      m.response_size->observe( response_size );
+      if( encode_time )
+         m.encode_time->observe( encode_time->count() / 1000000.0 );
+   }
+   if( _threshold.count() == 0 || duration < _threshold )
+      return;
+
+   ++_slow_call_count;
+   if( _slow_calls_total )
+      _slow_calls_total->add();
+   if( _max_slow_calls == 0 )
+      return;
+   lock.unlock();
+
+   // the arguments are only written out for the calls that are kept
+   slow_api_call call;
+   call.time = fc::time_point::now();
+   call.method = method;
+   call.arguments = fc::json::to_string( fc::variant( args ) );
+   if( call.arguments.size() > max_argument_chars )
+   {
+      call.arguments.resize( max_argument_chars );
+      call.arguments += "...";
+   }
+   call.remote_endpoint = remote_endpoint;
+   call.duration = duration.count();
+   call.encode_time = encode_time ? encode_time->count() : 0;
+   call.response_size = response_size;
+   call.failed = failed;
+
+   lock.lock();
+   _slow_calls.push_back( std::move( call ) );
+   while( _slow_calls.size() > _max_slow_calls )
+      _slow_calls.pop_front();
+}
+
+std::vector<slow_api_call> api_call_log::get_slow_calls()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return std::vector<slow_api_call>( _slow_calls.begin(), _slow_calls.end() );
+}
+
+uint64_t api_call_log::slow_call_count()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _slow_call_count;
+}
+
+} } // graphene::app
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_reader_pool.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace graphene { namespace app {
+
+fc::task_specific_ptr<uint32_t> api_reader_pool::inline_scope::_depth;
+
+api_reader_pool::inline_scope::inline_scope()
+{
+   if( uint32_t* depth = _depth.get() )
+      ++*depth;
+   else
+      _depth.reset( new uint32_t( 1 ) );
+}
+
+api_reader_pool::inline_scope::~inline_scope()
+{
+   --*_depth;
+}
+
+bool api_reader_pool::inline_scope::active()
+{
+   const uint32_t* depth = _depth.get();
+   return depth && *depth > 0;
+}
+
+api_reader_pool::api_reader_pool( const chain::database& db, uint32_t threads )
+   : _db( db ), _next( 0 )
+{
+   for( uint32_t i = 0; i < threads; ++i )
+      _threads.emplace_back( new fc::thread( "api_reader_" + fc::to_string(i) ) );
+}
+
+void api_reader_pool::set_limits( const limits& l )
+{
+   _limits = l;
+   dispatch();
+}
+
+void api_reader_pool::set_metrics( graphene::utilities::metrics_registry* metrics )
+{
+   if( !metrics )
+      return;
+   const char* const classes[] = { "class=\"light\"", "class=\"heavy\"" };
+   for( int cls = light_call; cls <= heavy_call; ++cls )
+      _queue_seconds[cls] = &metrics->histogram( "graphene_api_queue_seconds", "Time API calls waited for a reader thread by class",
+                                                 graphene::utilities::metrics_registry::latency_buckets(), classes[cls] );
+   _refused = &metrics->counter( "graphene_api_calls_refused_total", "API calls refused because their connection used up its time" );
+}
+
+api_reader_pool::call_class api_reader_pool::classify( const char* method )
+{
+   static const char* const heavy[] = {
+      "get_full_accounts", "get_full_accounts_paged", "get_key_references", "get_full_key_references",
+      "get_account_references", "get_balance_objects", "lookup_accounts", "list_assets",
+      "get_limit_orders", "get_call_orders", "get_settle_orders",
+      "get_limit_orders_page", "get_call_orders_page", "get_settle_orders_page",
+      "get_order_book", "get_order_books", "lookup_witness_accounts", "get_witnesses_by_votes",
+      "lookup_committee_member_accounts", "get_committee_members_by_votes", "get_proposed_transactions",
+      "simulate_transactions", "get_balances_for_accounts"
+   };
+   for( const char* name : heavy )
+      if( std::strcmp( name, method ) == 0 )
+         return heavy_call;
+   return light_call;
+}
+
+api_reader_pool::turn::turn( api_reader_pool& pool, client& c, call_class cls )
+   : _pool( pool ), _client( c ), _class( cls )
+{
+   _pool.admit( _client, _class );
+   _start = fc::time_point::now();
+}
+
+api_reader_pool::turn::~turn()
+{
+   _pool.release( _client, _class, fc::time_point::now() - _start );
+}
+
+void api_reader_pool::check_quota( client& c )
+{
+   if( !_limits.client_cpu_ms )
+      return;
+   pay_back( c );
+   if( c._debt >= fc::milliseconds( _limits.client_cpu_ms ) )
+   {
+      if( _refused )
+         _refused->add();
+      FC_THROW( "The connection used up its time of the API, retry in ${ms} ms",
+                ("ms", ( c._debt.count() - fc::milliseconds( _limits.client_cpu_ms ).count() ) / _limits.client_cpu_ms + 1) );
+   }
+}
+
+void api_reader_pool::charge( client& c, fc::microseconds elapsed )
+{
+   if( !_limits.client_cpu_ms )
+      return;
+   pay_back( c );
+   c._debt += elapsed;
+}
+
+void api_reader_pool::admit( client& c, call_class cls )
+{
+   check_quota( c );
+
+   const fc::time_point queued = fc::time_point::now();
+   // dispatch() leaves no call waiting that could start, so one that can start now goes ahead of no other
+   if( can_start( c, cls ) )
+      start( c, cls );
+   else
+   {
+      fc::promise<void>::ptr ready( new fc::promise<void>( "api_reader_pool::admit" ) );
+      _waiting[cls].push_back( waiter{ &c, ready } );
+      try
+      {
+         ready->wait();
+      }
+      catch( ... )
+      {
+         auto& waiting = _waiting[cls];
+         auto itr = std::find_if( waiting.begin(), waiting.end(), [&ready]( const waiter& w ) { return w.ready == ready; } );
+         if( itr != waiting.end() )
+            waiting.erase( itr );
+         else // dispatch() started it already
+            release( c, cls, fc::microseconds() );
+         throw;
+      }
+   }
+   if( _queue_seconds[cls] )
+      _queue_seconds[cls]->observe( ( fc::time_point::now() - queued ).count() / 1000000.0 );
+}
+
+void api_reader_pool::release( client& c, call_class cls, fc::microseconds elapsed )
+{
+   --_running;
+   if( cls == heavy_call )
+      --_heavy_running;
+   --c._running;
+   charge( c, elapsed );
+   dispatch();
+}
+
+bool api_reader_pool::can_start( const client& c, call_class cls )const
+{
+   if( _running >= std::max<size_t>( _threads.size(), 1 ) )
+      return false;
+   if( cls == heavy_call && _limits.heavy_threads && _heavy_running >= _limits.heavy_threads )
+      return false;
+   return !_limits.client_calls || c._running < _limits.client_calls;
+}
+
+void api_reader_pool::start( client& c, call_class cls )
+{
+   ++_running;
+   if( cls == heavy_call )
+      ++_heavy_running;
+   ++c._running;
+}
+
+void api_reader_pool::dispatch()
+{
+   for( int cls = light_call; cls <= heavy_call; ++cls )
+   {
+      auto& waiting = _waiting[cls];
+      for( auto itr = waiting.begin(); itr != waiting.end(); )
+      {
+         if( !can_start( *itr->c, call_class(cls) ) )
+         {
+            ++itr;
+            continue;
+         }
+         start( *itr->c, call_class(cls) );
+         itr->ready->set_value();
+         itr = waiting.erase( itr );
+      }
+   }
+}
+
+void api_reader_pool::pay_back( client& c )const
+{
+   const fc::time_point now = fc::time_point::now();
+   if( c._debt.count() > 0 )
+   {
+      // the quota pays back client_cpu_ms every second
+      const int64_t paid = ( now - c._paid ).count() * _limits.client_cpu_ms / 1000;
+      c._debt = fc::microseconds( std::max<int64_t>( c._debt.count() - paid, 0 ) );
+   }
+   c._paid = now;
+}
+
+} } // graphene::app
@@ -23,8 +23,17 @@
  */
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_reader_pool.hpp>
+#include <graphene/app/batch_api_connection.hpp>
+#include <graphene/app/block_log_bootstrap.hpp>
+#include <graphene/app/chain_write_queue.hpp>
+#include <graphene/app/confirmation_registry.hpp>
+#include <graphene/app/applied_block_queue.hpp>
+#include <graphene/app/applied_operation_log.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
+#include <graphene/app/send_queue.hpp>
+#include <graphene/app/serialized_object_cache.hpp>
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/protocol/types.hpp>
@@ -38,7 +47,10 @@
 #include <graphene/time/time.hpp>
 
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/utilities/metrics.hpp>
+#include <graphene/utilities/trace.hpp>
 #include <graphene/chain/worker_evaluator.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <fc/smart_ref_impl.hpp>
 
@@ -46,12 +58,16 @@
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/network/resolve.hpp>
+#include <fc/network/http/server.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/signals2.hpp>
 #include <boost/range/algorithm/reverse.hpp>
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <thread>
 
 #include <fc/log/file_appender.hpp>
 #include <fc/log/logger.hpp>
@@ -112,6 +128,19 @@ namespace detail {
       fc::optional<fc::temp_file> _lock_file;
       bool _is_block_producer = false;
       bool _force_validate = false;
+      block_production_statistics _block_production_statistics;
+
+      /** appends the operations of every block of _chain_db to the log once the block is irreversible, replays included */
+      void connect_applied_operation_log()
+      {
+         std::shared_ptr<graphene::app::applied_operation_log> log = _applied_operation_log;
+         _applied_operation_log_queue.reset();
+         _applied_operation_log_queue.reset( new graphene::app::applied_block_queue( "applied_ops_log",
+            [log]( const graphene::app::applied_block_queue::applied_block_data& data ) {
+               log->append( data.block.block_num(), data.operations );
+            }, 100 ) );
+         _applied_operation_log_queue->connect( *_chain_db );
+      }
 
       void reset_p2p_node(const fc::path& data_dir)
       { try {
@@ -119,6 +148,8 @@ namespace detail {
 
          _p2p_network->load_configuration(data_dir / "p2p");
          _p2p_network->set_node_delegate(this);
+         if( _options->count("p2p-io-threads") )
+            _p2p_network->set_io_threads( _options->at("p2p-io-threads").as<uint32_t>() );
 
          if( _options->count("seed-node") )
          {
@@ -135,6 +166,16 @@ namespace detail {
             }
          }
 
+         if( _options->count("witness-relay-endpoint") )
+         {
+            for( const string& endpoint_string : _options->at("witness-relay-endpoint").as<vector<string>>() )
+               for( const fc::ip::endpoint& endpoint : resolve_string_to_ip_endpoints(endpoint_string) )
+               {
+                  ilog("Adding witness relay ${endpoint}", ("endpoint", endpoint));
+                  _p2p_network->add_witness_relay_endpoint(endpoint);
+               }
+         }
+
          if( _options->count("p2p-endpoint") )
             _p2p_network->listen_on_endpoint(fc::ip::endpoint::from_string(_options->at("p2p-endpoint").as<string>()), true);
          else
@@ -175,6 +216,40 @@ namespace detail {
          FC_CAPTURE_AND_RETHROW((endpoint_string))
       }
 
+      /** serves the calls of @ref db_api with large results on @ref wsc by writing their JSON without variants, and
+       *  runs the reads of the batches on @ref wsc through @ref db_api */
+      static void add_direct_calls( graphene::app::batch_api_connection& wsc, fc::api_id_type api,
+                                    const std::shared_ptr<graphene::app::database_api>& db_api )
+      {
+         // a call with too few or too many arguments fails with an assertion rather than a range error
+         auto check_arity = []( const char* method, const fc::variants& args, size_t min_args, size_t max_args ) {
+            FC_ASSERT( args.size() >= min_args && args.size() <= max_args,
+                       "${m} takes ${min} to ${max} arguments, ${n} given",
+                       ("m",method)("min",min_args)("max",max_args)("n",args.size()) );
+         };
+         wsc.add_direct_call( api, "get_objects", [db_api, check_arity]( const fc::variants& args, std::string& out ) {
+            check_arity( "get_objects", args, 1, 1 );
+            db_api->get_objects_json( args[0].as< vector<object_id_type> >(), out );
+         } );
+         wsc.add_direct_call( api, "get_block", [db_api, check_arity]( const fc::variants& args, std::string& out ) {
+            check_arity( "get_block", args, 1, 1 );
+            db_api->get_block_json( args[0].as<uint32_t>(), out );
+         } );
+         wsc.add_direct_call( api, "get_full_accounts", [db_api, check_arity]( const fc::variants& args, std::string& out ) {
+            check_arity( "get_full_accounts", args, 2, 2 );
+            db_api->get_full_accounts_json( args[0].as< vector<string> >(), args[1].as<bool>(), out );
+         } );
+         wsc.add_direct_call( api, "get_order_book", [db_api, check_arity]( const fc::variants& args, std::string& out ) {
+            check_arity( "get_order_book", args, 2, 3 );
+            db_api->get_order_book_json( args[0].as<string>(), args[1].as<string>(),
+                                         args.size() > 2 ? args[2].as<unsigned>() : 50, out );
+         } );
+         wsc.set_batch_runner( api, &graphene::app::database_api::read_call,
+                               [db_api]( bool heavy, const std::function<void()>& batch ) {
+            db_api->run_batch( heavy, batch );
+         } );
+      }
+
       void reset_websocket_server()
       { try {
          if( !_options->count("rpc-endpoint") )
@@ -185,10 +260,12 @@ namespace detail {
          _websocket_server = std::make_shared<fc::http::websocket_server>(enable_deflate_compression);
 
          _websocket_server->on_connection([&]( const fc::http::websocket_connection_ptr& c ){
-            auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c);
+            auto wsc = std::make_shared<graphene::app::batch_api_connection>( *c, &_api_calls, c->get_remote_endpoint_string() );
             auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
-            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()) );
-            wsc->register_api(fc::api<graphene::app::database_api>(db_api));
+            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()),
+               std::dynamic_pointer_cast<graphene::market_history::market_history_plugin>( _self->get_plugin( "market_history" ) ).get(),
+               _self->api_readers(), &_metrics );
+            add_direct_calls( *wsc, wsc->register_api(fc::api<graphene::app::database_api>(db_api)), db_api );
             wsc->register_api(fc::api<graphene::app::login_api>(login));
             c->set_session_data( wsc );
          });
@@ -213,10 +290,12 @@ namespace detail {
          _websocket_tls_server = std::make_shared<fc::http::websocket_tls_server>( _options->at("server-pem").as<string>(), password, enable_deflate_compression );
 
          _websocket_tls_server->on_connection([&]( const fc::http::websocket_connection_ptr& c ){
-            auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c);
+            auto wsc = std::make_shared<graphene::app::batch_api_connection>( *c, &_api_calls, c->get_remote_endpoint_string() );
             auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
-            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()) );
-            wsc->register_api(fc::api<graphene::app::database_api>(db_api));
+            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()),
+               std::dynamic_pointer_cast<graphene::market_history::market_history_plugin>( _self->get_plugin( "market_history" ) ).get(),
+               _self->api_readers(), &_metrics );
+            add_direct_calls( *wsc, wsc->register_api(fc::api<graphene::app::database_api>(db_api)), db_api );
             wsc->register_api(fc::api<graphene::app::login_api>(login));
             c->set_session_data( wsc );
          });
@@ -225,6 +304,90 @@ namespace detail {
          _websocket_tls_server->start_accept();
       } FC_CAPTURE_AND_RETHROW() }
 
+      /** serves the metrics in the Prometheus text format at /metrics of metrics-endpoint */
+      void reset_metrics_server()
+      { try {
+         if( !_options->count("metrics-endpoint") )
+            return;
+
+         _metrics.add_gauge( "graphene_head_block_number", "Number of the head block",
+                             [this]() -> double { return _chain_db->head_block_num(); } );
+         _metrics.add_gauge( "graphene_last_irreversible_block_number", "Number of the last irreversible block",
+                             [this]() -> double {
+                                return _chain_db->get_dynamic_global_properties().last_irreversible_block_num; } );
+         _metrics.add_gauge( "graphene_pending_transactions", "Transactions in the pending pool",
+                             [this]() -> double { return _chain_db->pending_transaction_count(); } );
+         _metrics.add_gauge( "graphene_undo_depth", "States in the undo database",
+                             [this]() -> double { return _chain_db->_undo_db.size(); } );
+         _metrics.add_gauge( "graphene_api_subscription_sessions", "API connections that may subscribe to objects",
+                             [this]() -> double { return subscription_hub::get( *_chain_db )->session_count(); } );
+         _metrics.add_gauge( "graphene_api_subscribed_objects", "Objects subscribed to by API connections",
+                             [this]() -> double { return subscription_hub::get( *_chain_db )->subscribed_objects(); } );
+         _metrics.add_gauge( "graphene_p2p_connections", "Connected peers",
+                             [this]() -> double { return _p2p_network ? _p2p_network->get_connection_count() : 0; } );
+         _write_queue.add_metrics( _metrics );
+         _metrics.add_collector( [this]( std::ostream& out ) {
+            if( _p2p_network )
+               write_numeric_leaves( out, "graphene_p2p", _p2p_network->network_get_statistics() );
+         });
+         _metrics.add_collector( [this]( std::ostream& out ) {
+            // every API session connects its own observers, which are summed up by name
+            std::map< std::pair<std::string,std::string>, chain::observer_statistics > observers;
+            for( const auto& event : _chain_db->get_observer_statistics() )
+               for( const auto& o : event.second )
+               {
+                  chain::observer_statistics& total = observers[ std::make_pair( event.first, o.name ) ];
+                  total.calls += o.calls;
+                  total.microseconds += o.microseconds;
+               }
+            out << "# HELP graphene_observer_calls_total Calls of the observers of a database event\n"
+                << "# TYPE graphene_observer_calls_total counter\n";
+            for( const auto& o : observers )
+               out << "graphene_observer_calls_total{event=\"" << o.first.first << "\",observer=\"" << o.first.second
+                   << "\"} " << o.second.calls << '\n';
+            out << "# HELP graphene_observer_seconds_total Time spent in the observers of a database event\n"
+                << "# TYPE graphene_observer_seconds_total counter\n";
+            for( const auto& o : observers )
+               out << "graphene_observer_seconds_total{event=\"" << o.first.first << "\",observer=\"" << o.first.second
+                   << "\"} " << o.second.microseconds / 1000000.0 << '\n';
+         });
+
+         _metrics_server = std::make_shared<fc::http::server>();
+         _metrics_server->on_request( [this]( const fc::http::request& request, const fc::http::server::response& response ) {
+            if( request.path != "/metrics" )
+            {
+               response.set_status( fc::http::reply::NotFound );
+               response.set_length( 0 );
+               return;
+            }
+            const std::string body = _metrics.render();
+            response.add_header( "Content-Type", "text/plain; version=0.0.4" );
+            response.set_status( fc::http::reply::OK );
+            response.set_length( body.size() );
+            response.write( body.data(), body.size() );
+         });
+         ilog("Configured metrics to be served on ${ip}", ("ip",_options->at("metrics-endpoint").as<string>()));
+         _metrics_server->listen( fc::ip::endpoint::from_string(_options->at("metrics-endpoint").as<string>()) );
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /** writes every number in @ref v as an untyped sample named by its path below @ref prefix */
+      static void write_numeric_leaves( std::ostream& out, const std::string& prefix, const fc::variant& v )
+      {
+         if( v.is_object() )
+         {
+            for( const auto& entry : v.get_object() )
+            {
+               std::string name = entry.key();
+               for( char& c : name )
+                  if( !std::isalnum( static_cast<unsigned char>(c) ) )
+                     c = '_';
+               write_numeric_leaves( out, prefix + "_" + name, entry.value() );
+            }
+         }
+         else if( v.is_numeric() )
+            out << prefix << ' ' << v.as_double() << '\n';
+      }
+
       application_impl(application* self)
          : _self(self),
            _chain_db(std::make_shared<chain::database>())
@@ -233,6 +396,9 @@ namespace detail {
 
       ~application_impl()
       {
+         // _executor goes before _chain_db, which may run its signature work on it
+         if( _chain_db )
+            _chain_db->set_signature_threads( 0 );
          fc::remove_all(_data_dir / "blockchain/dblock");
       }
 
@@ -256,7 +422,10 @@ namespace detail {
             {
                std::string genesis_str;
                fc::read_file_contents( _options->at("genesis-json").as<boost::filesystem::path>(), genesis_str );
-               genesis_state_type genesis = fc::json::from_string( genesis_str ).as<genesis_state_type>();
+               // a binary genesis carries the chain id of the JSON it was converted from
+               const bool binary_genesis = is_binary_genesis( genesis_str );
+               genesis_state_type genesis = binary_genesis ? unpack_binary_genesis( genesis_str )
+                                                           : parse_genesis_json( genesis_str );
                bool modified_genesis = false;
                if( _options->count("genesis-timestamp") )
                {
@@ -279,7 +448,7 @@ namespace detail {
                   genesis_str += "BOGUS";
                   genesis.initial_chain_id = fc::sha256::hash( genesis_str );
                }
-               else
+               else if( !binary_genesis )
                   genesis.initial_chain_id = fc::sha256::hash( genesis_str );
                return genesis;
             }
@@ -289,12 +458,75 @@ namespace detail {
                graphene::egenesis::compute_egenesis_json( egenesis_json );
                FC_ASSERT( egenesis_json != "" );
                FC_ASSERT( graphene::egenesis::get_egenesis_json_hash() == fc::sha256::hash( egenesis_json ) );
-               auto genesis = fc::json::from_string( egenesis_json ).as<genesis_state_type>();
+               auto genesis = parse_genesis_json( egenesis_json );
                genesis.initial_chain_id = fc::sha256::hash( egenesis_json );
                return genesis;
             }
          };
 
+         if( _options->count("db-io-threads") )
+            _chain_db->set_io_threads( _options->at("db-io-threads").as<uint32_t>() );
+         const std::string node_role = _options->at("node-role").as<std::string>();
+         FC_ASSERT( node_role == "api" || node_role == "witness" || node_role == "seed",
+                    "Unknown node-role ${role}", ("role",node_role) );
+         // witnesses and seed nodes serve no queries, the indexes only the API reads are not kept for them
+         const bool api_indexes = node_role == "api";
+         if( !api_indexes )
+            _chain_db->disable_api_indexes();
+         const uint32_t checkpoint_interval = _options->at("db-checkpoint-interval").as<uint32_t>();
+         _chain_db->set_checkpoint_interval( checkpoint_interval );
+         const uint32_t undo_compaction_depth = _options->at("undo-compaction-depth").as<uint32_t>();
+         _chain_db->_undo_db.set_compaction_depth( undo_compaction_depth );
+         const bool block_log_mmap = _options->count("block-log-mmap") > 0;
+         _chain_db->set_block_log_memory_mapped( block_log_mmap );
+         const uint32_t block_log_segment_size = _options->at("block-log-segment-size").as<uint32_t>();
+         const int block_log_compression = _options->at("block-log-compression").as<int>();
+         _chain_db->set_block_log_storage( block_log_segment_size, block_log_compression );
+         const uint32_t block_log_write_behind = _options->at("block-log-write-behind").as<uint32_t>();
+         _chain_db->set_block_log_write_behind( block_log_write_behind );
+         const uint32_t block_retention = _options->at("block-retention").as<uint32_t>();
+         _chain_db->set_block_retention( block_retention );
+         const uint32_t state_diff_history = _options->at("state-diff-history").as<uint32_t>();
+         _chain_db->set_state_diff_history( state_diff_history );
+         const uint32_t state_hash_history = _options->at("state-hash-history").as<uint32_t>();
+         _chain_db->set_state_hash_history( state_hash_history );
+         const uint32_t replay_prefetch_depth = _options->at("replay-prefetch-depth").as<uint32_t>();
+         _chain_db->set_replay_prefetch_depth( replay_prefetch_depth );
+         const uint32_t transaction_prefetch_depth = _options->at("transaction-prefetch-depth").as<uint32_t>();
+         _chain_db->set_transaction_prefetch_depth( transaction_prefetch_depth );
+         const uint32_t signature_threads = _options->at("signature-threads").as<uint32_t>();
+         _chain_db->set_signature_threads( signature_threads, _executor.get() );
+         const uint32_t api_reader_threads = _options->at("api-reader-threads").as<uint32_t>();
+         const uint32_t api_object_cache_size = _options->at("api-object-cache-size").as<uint32_t>();
+         graphene::app::send_queue::set_max_bytes( _options->at("api-max-queued-bytes").as<uint64_t>() );
+         graphene::app::database_api::set_max_full_account_objects( _options->at("api-max-full-account-objects").as<uint32_t>() );
+         const uint32_t signature_cache_size = _options->at("signature-cache-size").as<uint32_t>();
+         _chain_db->set_signature_cache_size( signature_cache_size );
+         const uint64_t fork_db_max_memory = _options->at("fork-db-max-memory").as<uint64_t>();
+         _chain_db->set_fork_db_max_memory( fork_db_max_memory );
+         const uint32_t max_pending_transactions = _options->at("max-pending-transactions").as<uint32_t>();
+         _chain_db->set_max_pending_transactions( max_pending_transactions );
+         const bool keep_transaction_bodies = _options->at("keep-transaction-bodies").as<bool>();
+         _chain_db->set_keep_transaction_bodies( keep_transaction_bodies );
+         const bool check_vote_tally = _options->at("check-vote-tally").as<bool>();
+         _chain_db->set_vote_tally_check( check_vote_tally );
+         const uint32_t maintenance_precount_blocks = _options->at("maintenance-precount-blocks").as<uint32_t>();
+         _chain_db->set_maintenance_precount_blocks( maintenance_precount_blocks );
+         const uint32_t object_paging_idle_blocks = _options->at("object-paging-idle-blocks").as<uint32_t>();
+         _chain_db->set_object_paging( object_paging_idle_blocks );
+         const bool operation_statistics = _options->at("operation-statistics").as<bool>();
+         _chain_db->set_operation_statistics( operation_statistics );
+         const uint32_t slow_block_threshold = _options->at("slow-block-threshold").as<uint32_t>();
+         _chain_db->set_slow_block_threshold( fc::milliseconds( slow_block_threshold ) );
+         _api_calls.set_threshold( fc::milliseconds( _options->at("api-slow-call-threshold-ms").as<uint32_t>() ) );
+         _api_calls.set_max_slow_calls( _options->at("api-slow-call-log-size").as<uint32_t>() );
+         graphene::utilities::tracer::set_buffer_size( _options->at("trace-buffer-size").as<uint32_t>() );
+         graphene::utilities::tracer::set_sampling( _options->at("trace-sample-rate").as<uint32_t>() );
+         const uint32_t index_statistics_interval = _options->at("index-statistics-interval").as<uint32_t>();
+         _chain_db->set_index_statistics_interval( index_statistics_interval );
+         const uint32_t change_notification_interval = _options->at("change-notification-interval").as<uint32_t>();
+         _chain_db->set_change_notification_interval( fc::milliseconds( change_notification_interval ) );
+
          if( _options->count("resync-blockchain") )
             _chain_db->wipe(_data_dir / "blockchain", true);
 
@@ -311,10 +543,77 @@ namespace detail {
          }
          _chain_db->add_checkpoints( loaded_checkpoints );
 
+         // a node that never built its state fills its block log from the mirrors up to the last checkpoint first
+         bool bootstrapped = false;
+         if( _options->count("bootstrap-mirror") && clean && !fc::exists( _data_dir / "db_version" ) )
+         {
+            graphene::app::block_log_bootstrap bootstrap( _options->at("bootstrap-mirror").as<vector<string>>(),
+                                                          _options->at("bootstrap-parallel-downloads").as<uint32_t>() );
+            bootstrap.set_storage( block_log_segment_size, block_log_compression );
+            bootstrapped = bootstrap.run( _data_dir / "blockchain" / "database" / "block_num_to_block", loaded_checkpoints ) > 0;
+         }
+
+         if( _options->at("applied-operations-log").as<bool>() )
+         {
+            _applied_operation_log = std::make_shared<graphene::app::applied_operation_log>();
+            _applied_operation_log->open( _data_dir / "blockchain" / "applied_ops" );
+            connect_applied_operation_log();
+         }
+
+         if( _options->count("verify-replay") )
+         {
+            optional<fc::sha256> trusted_state_hash;
+            if( _options->count("snapshot-state-hash") )
+               trusted_state_hash = fc::sha256( _options->at("snapshot-state-hash").as<string>() );
+            uint32_t threads = _options->at("verify-replay-threads").as<uint32_t>();
+            if( threads == 0 )
+               threads = std::max( 1u, std::thread::hardware_concurrency() );
+            vector<fc::path> snapshot_dirs;
+            for( const auto& dir : _options->at("verify-replay").as<vector<boost::filesystem::path>>() )
+               snapshot_dirs.push_back( dir );
+            const auto results = _chain_db->verify_replay( _data_dir / "blockchain", snapshot_dirs, trusted_state_hash,
+                                                           _data_dir / "verify_replay", threads );
+            if( _options->count("replay-report") )
+               fc::json::save_to_file( results, _options->at("replay-report").as<boost::filesystem::path>() );
+            const bool verified = std::all_of( results.begin(), results.end(),
+                                               []( const graphene::chain::replay_range_verification& r ) { return r.matches; } );
+            if( verified )
+               ilog( "The block log reproduces all ${n} snapshot states", ("n",results.size()+1) );
+            else
+               elog( "The block log does not reproduce the snapshot states" );
+            std::exit( verified ? EXIT_SUCCESS : EXIT_FAILURE );
+         }
+
+         // start from a trusted snapshot when one is configured, falling back to a replay from genesis
+         auto replay_chain = [&]()
+         {
+            bool replayed = false;
+            if( _options->count("replay-from-snapshot") )
+            {
+               try
+               {
+                  FC_ASSERT( _options->count("snapshot-state-hash"), "replay-from-snapshot requires snapshot-state-hash" );
+                  _chain_db->reindex_from_snapshot( _data_dir / "blockchain",
+                                                    _options->at("replay-from-snapshot").as<boost::filesystem::path>(),
+                                                    fc::sha256( _options->at("snapshot-state-hash").as<string>() ) );
+                  replayed = true;
+               }
+               catch( const fc::exception& e )
+               {
+                  elog( "Unable to replay from snapshot: ${e}", ("e", e.to_detail_string()) );
+               }
+            }
+            if( !replayed )
+               _chain_db->reindex( _data_dir / "blockchain", initial_state() );
+            if( _options->count("replay-report") )
+               fc::json::save_to_file( _chain_db->get_replay_statistics(),
+                                       _options->at("replay-report").as<boost::filesystem::path>() );
+         };
+
          if( _options->count("replay-blockchain") )
          {
             ilog("Replaying blockchain on user request.");
-            _chain_db->reindex(_data_dir/"blockchain", initial_state());
+            replay_chain();
          } else if( clean ) {
 
             auto is_new = [&]() -> bool
@@ -337,6 +636,11 @@ namespace detail {
 
             bool need_reindex = (!is_new() && is_outdated());
             std::string reindex_reason = "version upgrade";
+            if( bootstrapped )
+            {
+               need_reindex = true;
+               reindex_reason = "a bootstrap from block log mirrors";
+            }
 
             if( !need_reindex )
             {
@@ -357,7 +661,7 @@ namespace detail {
                ilog("Replaying blockchain due to ${reason}", ("reason", reindex_reason) );
 
                fc::remove_all( _data_dir / "db_version" );
-               _chain_db->reindex(_data_dir / "blockchain", initial_state());
+               replay_chain();
 
                // doing this down here helps ensure that DB will be wiped
                // if any of the above steps were interrupted on a previous run
@@ -372,8 +676,27 @@ namespace detail {
                }
             }
          } else {
-            wlog("Detected unclean shutdown. Replaying blockchain...");
-            _chain_db->reindex(_data_dir / "blockchain", initial_state());
+            // snapshots are swapped in whole once they are on disk, so the last one is intact and open()
+            // applies the blocks after it from the block log
+            bool recovered = false;
+            if( checkpoint_interval > 0 )
+               wlog("Detected unclean shutdown. Recovering from the last checkpoint...");
+            else
+               wlog("Detected unclean shutdown. Recovering from the last saved state...");
+            try
+            {
+               _chain_db->open(_data_dir / "blockchain", initial_state);
+               recovered = true;
+            }
+            catch( const fc::exception& e )
+            {
+               elog( "Unable to recover the saved state: ${e}", ("e", e.to_detail_string()) );
+            }
+            if( !recovered )
+            {
+               wlog("Detected unclean shutdown. Replaying blockchain...");
+               replay_chain();
+            }
          }
 
          if (!_options->count("genesis-json") &&
@@ -382,9 +705,52 @@ namespace detail {
             _chain_db->wipe(_data_dir / "blockchain", true);
             _chain_db.reset();
             _chain_db = std::make_shared<chain::database>();
+            if( _options->count("db-io-threads") )
+               _chain_db->set_io_threads( _options->at("db-io-threads").as<uint32_t>() );
+            if( !api_indexes )
+               _chain_db->disable_api_indexes();
+            _chain_db->set_checkpoint_interval( checkpoint_interval );
+            _chain_db->_undo_db.set_compaction_depth( undo_compaction_depth );
+            _chain_db->set_block_log_memory_mapped( block_log_mmap );
+            _chain_db->set_block_log_storage( block_log_segment_size, block_log_compression );
+            _chain_db->set_block_log_write_behind( block_log_write_behind );
+            _chain_db->set_block_retention( block_retention );
+            _chain_db->set_state_diff_history( state_diff_history );
+            _chain_db->set_state_hash_history( state_hash_history );
+            _chain_db->set_replay_prefetch_depth( replay_prefetch_depth );
+            _chain_db->set_transaction_prefetch_depth( transaction_prefetch_depth );
+            _chain_db->set_signature_threads( signature_threads, _executor.get() );
+            _chain_db->set_signature_cache_size( signature_cache_size );
+            _chain_db->set_fork_db_max_memory( fork_db_max_memory );
+            _chain_db->set_max_pending_transactions( max_pending_transactions );
+            _chain_db->set_keep_transaction_bodies( keep_transaction_bodies );
+            _chain_db->set_vote_tally_check( check_vote_tally );
+            _chain_db->set_maintenance_precount_blocks( maintenance_precount_blocks );
+            _chain_db->set_object_paging( object_paging_idle_blocks );
+            _chain_db->set_operation_statistics( operation_statistics );
+            _chain_db->set_slow_block_threshold( fc::milliseconds( slow_block_threshold ) );
+            _chain_db->set_index_statistics_interval( index_statistics_interval );
+            _chain_db->set_change_notification_interval( fc::milliseconds( change_notification_interval ) );
             _chain_db->add_checkpoints(loaded_checkpoints);
+            if( _applied_operation_log )
+               connect_applied_operation_log();
             _chain_db->open(_data_dir / "blockchain", initial_state);
          }
+         // plugins rebuilding from the log in plugin_startup() expect it to reach the last irreversible block
+         if( _applied_operation_log_queue )
+            _applied_operation_log_queue->flush();
+         _api_readers = std::make_shared<graphene::app::api_reader_pool>( *_chain_db, api_reader_threads );
+         graphene::app::api_reader_pool::limits reader_limits;
+         reader_limits.heavy_threads = _options->at("api-heavy-threads").as<uint32_t>();
+         reader_limits.client_calls = _options->at("api-connection-calls").as<uint32_t>();
+         reader_limits.client_cpu_ms = _options->at("api-connection-cpu-ms").as<uint32_t>();
+         _api_readers->set_limits( reader_limits );
+         _api_readers->set_metrics( &_metrics );
+         _confirmations = std::make_shared<graphene::app::confirmation_registry>( *_chain_db );
+         graphene::app::serialized_object_cache::get( *_chain_db )->set_capacity( api_object_cache_size );
+
+         if( _options->count("export-state-snapshot") )
+            _chain_db->export_state_snapshot( _options->at("export-state-snapshot").as<boost::filesystem::path>() );
 
          if( _options->count("force-validate") )
          {
@@ -415,6 +781,7 @@ namespace detail {
          reset_p2p_node(_data_dir);
          reset_websocket_server();
          reset_websocket_tls_server();
+         reset_metrics_server();
       } FC_LOG_AND_RETHROW() }
 
       optional< api_access_info > get_api_access_info(const string& username)const
@@ -458,6 +825,12 @@ namespace detail {
        *
        * @throws exception if error validating the item, otherwise the item is safe to broadcast on.
        */
+      /** checks the merkle root and recovers the signature keys of a sync block on the signature threads */
+      virtual void prevalidate_block( const graphene::net::block_message& blk_msg ) override
+      {
+         _chain_db->prevalidate_block( blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures );
+      }
+
       virtual bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                                 std::vector<fc::uint160_t>& contained_transaction_message_ids) override
       { try {
@@ -481,7 +854,11 @@ namespace detail {
             // you can help the network code out by throwing a block_older_than_undo_history exception.
             // when the net code sees that, it will stop trying to push blocks from that chain, but
             // leave that peer connected so that they can get sync blocks from us
-            bool result = _chain_db->push_block(blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures);
+            const fc::time_point push_start = fc::time_point::now();
+            bool result = _write_queue.run( chain_write_queue::block_write, [&]() {
+               return _chain_db->push_block(blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures);
+            });
+            _block_push_time.observe( ( fc::time_point::now() - push_start ).count() / 1000000.0 );
 
             // the block was accepted, so we now know all of the transactions contained in the block
             if (!sync_mode)
@@ -515,6 +892,12 @@ namespace detail {
          }
       } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) }
 
+      /** validates and recovers the signature keys of a transaction on the signature threads */
+      virtual void prevalidate_transaction( const graphene::net::trx_message& trx_msg ) override
+      {
+         _chain_db->prevalidate_transaction( trx_msg.trx );
+      }
+
       virtual void handle_transaction(const graphene::net::trx_message& transaction_message) override
       { try {
          static fc::time_point last_call;
@@ -527,7 +910,8 @@ namespace detail {
             trx_count = 0;
          }
 
-         _chain_db->push_transaction( transaction_message.trx );
+         _transactions_received.add();
+         _write_queue.run( chain_write_queue::p2p_write, [&]() { _chain_db->push_transaction( transaction_message.trx ); } );
       } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
       virtual void handle_message(const message& message_to_process) override
@@ -587,11 +971,11 @@ namespace detail {
            if (!found_a_block_in_synopsis)
              FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
          }
-         for( uint32_t num = block_header::num_from_id(last_known_block_id);
-              num <= _chain_db->head_block_num() && result.size() < limit;
-              ++num )
-            if( num > 0 )
-               result.push_back(_chain_db->get_block_id_for_num(num));
+         // one read of the block index for the whole range, rather than a seek per block
+         uint32_t first_num = std::max<uint32_t>( block_header::num_from_id(last_known_block_id), 1 );
+         if( first_num <= _chain_db->head_block_num() && limit > 0 )
+            result = _chain_db->get_block_ids_for_nums( first_num,
+                                                        std::min<uint32_t>( limit, _chain_db->head_block_num() - first_num + 1 ) );
 
          if( !result.empty() && block_header::num_from_id(result.back()) < _chain_db->head_block_num() )
             remaining_item_count = _chain_db->head_block_num() - block_header::num_from_id(result.back());
@@ -607,13 +991,12 @@ namespace detail {
         // ilog("Request for item ${id}", ("id", id));
          if( id.item_type == graphene::net::block_message_type )
          {
-            auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-            if( !opt_block )
-               elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
-                    ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-            FC_ASSERT( opt_block.valid() );
-            // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-            return block_message(std::move(*opt_block));
+            // serve the bytes as they are stored, there is no need to unpack the block just to pack it again
+            auto packed_block = _chain_db->fetch_packed_block_by_id(id.item_hash);
+            // the node replies item_not_available to a key_not_found_exception, e.g. for pruned blocks
+            if( !packed_block )
+               FC_THROW_EXCEPTION( fc::key_not_found_exception, "Couldn't find block ${id}", ("id", id.item_hash) );
+            return block_message::from_packed_block(std::move(*packed_block), id.item_hash);
          }
          return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
       } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -684,6 +1067,17 @@ namespace detail {
       virtual std::vector<item_hash_t> get_blockchain_synopsis(const item_hash_t& reference_point, 
                                                                uint32_t number_of_blocks_after_reference_point) override
       { try {
+          // every syncing peer asks for much the same synopses, and they only change with our head block
+          if( _synopsis_cache_head != _chain_db->head_block_id() )
+          {
+             _synopsis_cache.clear();
+             _synopsis_cache_head = _chain_db->head_block_id();
+          }
+          const auto cache_key = std::make_pair( reference_point, number_of_blocks_after_reference_point );
+          auto cached = _synopsis_cache.find( cache_key );
+          if( cached != _synopsis_cache.end() )
+             return cached->second;
+
           std::vector<item_hash_t> synopsis;
           synopsis.reserve(30);
           uint32_t high_block_num;
@@ -794,6 +1188,9 @@ namespace detail {
           while (low_block_num <= high_block_num);
 
           idump((synopsis));
+          if( _synopsis_cache.size() >= max_cached_synopses )
+             _synopsis_cache.clear();
+          _synopsis_cache[cache_key] = synopsis;
           return synopsis;
       } FC_CAPTURE_AND_RETHROW() }
 
@@ -859,6 +1256,15 @@ namespace detail {
          return _chain_db->get_global_properties().parameters.block_interval;
       }
 
+      bool is_active_witness_key( const fc::ecc::public_key& key ) override
+      {
+         const public_key_type signing_key( key );
+         for( const witness_id_type& witness : _chain_db->get_global_properties().active_witnesses )
+            if( witness(*_chain_db).signing_key == signing_key )
+               return true;
+         return false;
+      }
+
       application* _self;
 
       fc::path _data_dir;
@@ -866,13 +1272,35 @@ namespace detail {
       api_access _apiaccess;
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
+      std::shared_ptr<graphene::app::api_reader_pool>       _api_readers;
+      std::shared_ptr<graphene::app::confirmation_registry> _confirmations;
+      std::shared_ptr<graphene::app::applied_operation_log> _applied_operation_log;
+      /** declared after _chain_db so it disconnects from it first */
+      std::unique_ptr<graphene::app::applied_block_queue>   _applied_operation_log_queue;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
 
+      graphene::utilities::metrics_registry            _metrics;
+      graphene::app::api_call_log                      _api_calls{ &_metrics };
+      /** the worker threads the subsystems share, see executor-threads; declared after _metrics, which it reports to */
+      std::unique_ptr<graphene::utilities::executor>   _executor;
+      /** declared after _metrics and _executor, whose gauges it reads while serving a scrape, so it stops first */
+      std::shared_ptr<fc::http::server>                _metrics_server;
+      chain_write_queue                                _write_queue;
+      graphene::utilities::metrics_histogram&          _block_push_time = _metrics.histogram( "graphene_block_push_seconds",
+         "Time spent pushing the blocks received from the network", graphene::utilities::metrics_registry::latency_buckets() );
+      graphene::utilities::metrics_counter&            _transactions_received = _metrics.counter(
+         "graphene_p2p_transactions_received_total", "Transactions received from the network" );
+
       std::map<string, std::shared_ptr<abstract_plugin>> _plugins;
 
       bool _is_finished_syncing = false;
+
+      /** synopses handed out by get_blockchain_synopsis() since the head block was _synopsis_cache_head */
+      static const size_t max_cached_synopses = 64;
+      block_id_type _synopsis_cache_head;
+      std::map<std::pair<item_hash_t, uint32_t>, std::vector<item_hash_t>> _synopsis_cache;
    };
 
 }
@@ -898,18 +1326,126 @@ void application::set_program_options(boost::program_options::options_descriptio
                                       boost::program_options::options_description& configuration_file_options) const
 {
    configuration_file_options.add_options()
+         ("state-hash-history", bpo::value<uint32_t>()->default_value(0), "Number of recent blocks whose state hash is "
+                                "kept for get_state_hash, the hash is then updated as objects change, 0 keeps none")
+         ("object-paging-idle-blocks", bpo::value<uint32_t>()->default_value(0), "Move the statistics of accounts that "
+                                       "were not used in this many blocks from memory to a page file, 0 keeps them all "
+                                       "in memory")
          ("p2p-endpoint", bpo::value<string>(), "Endpoint for P2P node to listen on")
          ("seed-node,s", bpo::value<vector<string>>()->composing(), "P2P nodes to connect to on startup (may specify multiple times)")
+         ("witness-relay-endpoint", bpo::value<vector<string>>()->composing(), "P2P nodes of other witnesses to stay "
+                                    "connected to and push new blocks to directly, if both nodes hold the signing key of "
+                                    "an active witness (may specify multiple times)")
+         ("p2p-io-threads", bpo::value<uint32_t>()->default_value(0), "Number of threads reading and decrypting the traffic "
+                            "of the P2P peers, the messages are still handled one at a time. 0 reads on the P2P thread")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
+         ("bootstrap-mirror", bpo::value<vector<string>>()->composing(), "http:// URL of the block_num_to_block directory "
+                              "of a node with block-log-segment-size; a new node fetches the blocks up to the last "
+                              "checkpoint from these before it replays them and syncs the rest over p2p")
+         ("bootstrap-parallel-downloads", bpo::value<uint32_t>()->default_value(4), "Number of block log segments "
+                                          "fetched from the bootstrap mirrors at once")
          ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8090"), "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
          ("enable-permessage-deflate", "Enable support for per-message deflate compression in the websocket servers "
                                        "(--rpc-endpoint and --rpc-tls-endpoint), disabled by default")
          ("server-pem,p", bpo::value<string>()->implicit_value("server.pem"), "The TLS certificate file for this server")
          ("server-pem-password,P", bpo::value<string>()->implicit_value(""), "Password for this certificate")
-         ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
+         ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from, JSON or the binary format written by genesis_update")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
+         ("db-io-threads", bpo::value<uint32_t>()->default_value(1), "Number of threads used to load and save the object database")
+         ("db-checkpoint-interval", bpo::value<uint32_t>()->default_value(0), "Append changed objects to the object database changelog every N blocks "
+                                    "so an unclean shutdown does not require a full replay, 0 disables checkpoints")
+         ("undo-compaction-depth", bpo::value<uint32_t>()->default_value(0), "Merge undo history older than this many blocks into a single state to "
+                                   "bound memory, forks deeper than this cannot be switched to. 0 keeps per block history")
+         ("block-log-mmap", "Read blocks from the block log through memory mapped files so API and p2p requests "
+                            "can be served concurrently")
+         ("block-log-segment-size", bpo::value<uint32_t>()->default_value(0), "Store the blocks of a newly created block log in "
+                                    "one file per this many blocks, 0 keeps a single file")
+         ("block-log-compression", bpo::value<int>()->default_value(0), "zlib compression level (1-9) for newly stored blocks, 0 stores them uncompressed")
+         ("block-log-write-behind", bpo::value<uint32_t>()->default_value(0), "Write new blocks to the block log on a separate "
+                                    "thread and flush it every N blocks and at every new irreversible block, 0 writes "
+                                    "blocks as they are applied")
+         ("block-retention", bpo::value<uint32_t>()->default_value(0), "Delete the block log segments older than this many "
+                             "irreversible blocks, requires block-log-segment-size. Block ids stay available for every "
+                             "block, 0 keeps all blocks")
+         ("node-role", bpo::value<string>()->default_value("api"), "api serves every API call; witness and seed "
+                       "drop the indexes only the API reads, the accounts by key and member and the proposals by account")
+         ("metrics-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8091"), "Endpoint to serve chain, network, API "
+                              "and plugin metrics on at /metrics in the Prometheus text format")
+         ("state-diff-history", bpo::value<uint32_t>()->default_value(0), "Number of recent blocks whose object changes are "
+                                "kept for delayed nodes copying the state with replicate-state, 0 keeps none")
+         ("replay-prefetch-depth", bpo::value<uint32_t>()->default_value(64), "Number of blocks read and hashed ahead of the replay "
+                                   "thread while reindexing, 0 replays serially")
+         ("transaction-prefetch-depth", bpo::value<uint32_t>()->default_value(0), "Number of transactions ahead of the one "
+                                        "being applied whose fee paying accounts, balances and assets are looked up and "
+                                        "prefetched into the cache while a block is applied, 0 looks nothing up ahead")
+         ("executor-threads", bpo::value<uint32_t>()->default_value(0), "Number of worker threads shared by the node's "
+                               "parallel work, such as that of signature-threads, 0 for one per core")
+         ("executor-pin-cores", bpo::value<bool>()->default_value(false), "Pin every executor thread to a core of its own, "
+                                 "wrapping around when there are more threads than cores (Linux only)")
+         ("signature-threads", bpo::value<uint32_t>()->default_value(0), "Number of executor threads at once recovering the "
+                                "signature keys of incoming blocks (sync blocks as soon as they arrive) and validating their "
+                                "transactions before they are applied, and tallying votes at maintenance, 0 does this on the "
+                                "main thread")
+         ("api-reader-threads", bpo::value<uint32_t>()->default_value(0), "Number of threads serving the database_api calls "
+                                 "that only read the chain state, one at a time with the application of blocks, 0 serves "
+                                 "them on the main thread")
+         ("api-heavy-threads", bpo::value<uint32_t>()->default_value(0), "Number of API reader threads that calls scanning "
+                               "many objects may occupy at once, so the other calls always find one, 0 for all")
+         ("api-connection-calls", bpo::value<uint32_t>()->default_value(0), "Number of API calls of one connection that run "
+                                  "on the reader threads at once, further ones wait for their turn, 0 for no limit")
+         ("api-connection-cpu-ms", bpo::value<uint32_t>()->default_value(0), "Milliseconds per second the API calls of one "
+                                   "connection may run on the reader threads, further ones fail until the time is paid "
+                                   "back, 0 for no limit")
+         ("api-object-cache-size", bpo::value<uint32_t>()->default_value(graphene::app::serialized_object_cache::default_capacity),
+                                   "Number of objects kept serialized for get_objects and get_full_accounts until they "
+                                   "change, 0 disables the cache")
+         ("api-max-queued-bytes", bpo::value<uint64_t>()->default_value(graphene::app::send_queue::default_max_bytes),
+                                  "Bytes of notifications that may wait for a connection, one falling further behind "
+                                  "loses its subscriptions, 0 for no limit")
+         ("api-max-full-account-objects", bpo::value<uint32_t>()->default_value(graphene::app::database_api::default_max_full_account_objects),
+                                          "Most objects of accounts that get_full_accounts and get_full_accounts_paged return "
+                                          "in a call, 0 for no limit")
+         ("signature-cache-size", bpo::value<uint32_t>()->default_value(10000), "Number of recovered signature keys to remember "
+                                   "so transactions that are applied again skip signature recovery, 0 disables the cache")
+         ("fork-db-max-memory", bpo::value<uint64_t>()->default_value(256*1024*1024), "Bytes of reversible and forked blocks "
+                                "kept in memory, blocks off the current chain are dropped beyond it, 0 for no limit")
+         ("max-pending-transactions", bpo::value<uint32_t>()->default_value(0), "Number of pending transactions after which "
+                                      "new transactions are refused until a block includes some, 0 for no limit")
+         ("keep-transaction-bodies", bpo::value<bool>()->default_value(true), "Keep a copy of every unexpired transaction "
+                                     "for duplicate checks, otherwise recent transactions are read back from the block log")
+         ("check-vote-tally", bpo::value<bool>()->default_value(false), "Recount all votes at every maintenance interval "
+                              "and log any difference to the incrementally kept vote totals")
+         ("applied-operations-log", bpo::bool_switch()->default_value(false), "Keep the applied operations of every "
+                                    "irreversible block in blockchain/applied_ops, so plugins can rebuild their state from "
+                                    "them instead of a replay")
+         ("maintenance-precount-blocks", bpo::value<uint32_t>()->default_value(10), "Count the votes that changed in each "
+                                         "of this many blocks before a maintenance interval, so the maintenance block has less to do")
+         ("operation-statistics", bpo::value<bool>()->default_value(false), "Measure the time spent applying each "
+                                  "operation type and the objects it touches, see debug_get_operation_statistics")
+         ("slow-block-threshold", bpo::value<uint32_t>()->default_value(0), "Log the time spent in each phase of pushing "
+                                  "a block that takes longer than this many milliseconds, 0 never does")
+         ("api-slow-call-threshold-ms", bpo::value<uint32_t>()->default_value(0), "Keep the API calls that take longer "
+                                        "than this many milliseconds with their arguments and the client's address, see "
+                                        "get_slow_api_calls; 0 keeps none")
+         ("api-slow-call-log-size", bpo::value<uint32_t>()->default_value(graphene::app::api_call_log::default_max_slow_calls),
+                                    "Number of the latest slow API calls kept")
+         ("trace-sample-rate", bpo::value<uint32_t>()->default_value(0), "Trace the pushing of one in every this many "
+                               "blocks, p2p messages and API calls, with their phases, operations and observers, see "
+                               "debug_get_trace; 0 traces nothing")
+         ("trace-buffer-size", bpo::value<uint32_t>()->default_value(65536), "Number of the latest traced spans each "
+                               "thread keeps")
+         ("index-statistics-interval", bpo::value<uint32_t>()->default_value(0), "Log the object count, memory and changes "
+                                       "of every index every this many blocks, see debug_get_index_statistics; 0 never does")
+         ("change-notification-interval", bpo::value<uint32_t>()->default_value(0), "Report the objects changed by pending "
+                                          "transactions to subscribers at most once per this many milliseconds and with every "
+                                          "block, each object once, 0 reports every transaction right away")
+         ("replay-from-snapshot", bpo::value<boost::filesystem::path>(), "Directory of a state snapshot to start from whenever the "
+                                  "blockchain has to be replayed, only the blocks after the snapshot are applied")
+         ("snapshot-state-hash", bpo::value<string>(), "Trusted state hash the snapshot given by replay-from-snapshot must match")
+         ("replay-report", bpo::value<boost::filesystem::path>(), "Write block, transaction and operation throughput of a replay, "
+                           "or the ranges checked by verify-replay, to this file as JSON")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -919,7 +1455,15 @@ void application::set_program_options(boost::program_options::options_descriptio
           "invalid file is found, it will be replaced with an example Genesis State.")
          ("replay-blockchain", "Rebuild object graph by replaying all blocks")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("export-state-snapshot", bpo::value<boost::filesystem::path>(), "Write a snapshot of the chain state at the head block "
+                                   "to this directory after opening the database")
          ("force-validate", "Force validation of all transactions")
+         ("verify-replay", bpo::value<vector<boost::filesystem::path>>()->composing(), "Directories of state snapshots "
+                           "(may specify multiple times); replay the blocks between every two of them in parallel, compare "
+                           "the state hashes with the later snapshot and exit, the first one must match snapshot-state-hash "
+                           "if that is given")
+         ("verify-replay-threads", bpo::value<uint32_t>()->default_value(0), "Number of block ranges verify-replay replays "
+                                   "at the same time, 0 for one per core")
          ("genesis-timestamp", bpo::value<uint32_t>(), "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
          ;
    command_line_options.add(_cli_options);
@@ -955,6 +1499,10 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
 
       std::exit(EXIT_SUCCESS);
    }
+
+   const uint32_t executor_threads = options.count("executor-threads") ? options.at("executor-threads").as<uint32_t>() : 0;
+   const bool executor_pin_cores = options.count("executor-pin-cores") && options.at("executor-pin-cores").as<bool>();
+   my->_executor.reset( new graphene::utilities::executor( executor_threads, executor_pin_cores, &my->_metrics ) );
 }
 
 void application::startup()
@@ -985,11 +1533,56 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+std::shared_ptr<applied_operation_log> application::applied_operations()const
+{
+   return my->_applied_operation_log;
+}
+
+const fc::path& application::data_dir() const
+{
+   return my->_data_dir;
+}
+
+std::shared_ptr<api_reader_pool> application::api_readers() const
+{
+   return my->_api_readers;
+}
+
+std::shared_ptr<confirmation_registry> application::confirmations() const
+{
+   return my->_confirmations;
+}
+
+graphene::utilities::metrics_registry& application::metrics()
+{
+   return my->_metrics;
+}
+
+const api_call_log& application::api_calls()const
+{
+   return my->_api_calls;
+}
+
+graphene::utilities::executor* application::executor()const
+{
+   return my->_executor.get();
+}
+
+chain_write_queue& application::write_queue()
+{
+   return my->_write_queue;
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
 }
 
+block_production_statistics& application::get_block_production_statistics()
+{
+   return my->_block_production_statistics;
+}
+
 optional< api_access_info > application::get_api_access_info( const string& username )const
 {
    return my->get_api_access_info( username );
@@ -1018,6 +1611,10 @@ void application::shutdown_plugins()
 }
 void application::shutdown()
 {
+   if( my->_applied_operation_log_queue )
+      my->_applied_operation_log_queue->flush();
+   if( my->_applied_operation_log )
+      my->_applied_operation_log->flush();
    if( my->_p2p_network )
       my->_p2p_network->close();
    if( my->_chain_db )
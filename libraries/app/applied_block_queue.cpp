@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/applied_block_queue.hpp>
+
+namespace graphene { namespace app {
+
+applied_block_queue::applied_block_queue( const std::string& thread_name, handler_type handler, uint32_t max_queued )
+   : _handler( std::move(handler) ), _max_queued( std::max<uint32_t>( max_queued, 1 ) ), _thread( thread_name )
+{}
+
+applied_block_queue::~applied_block_queue()
+{
+   _connection.disconnect();
+   flush();
+}
+
+void applied_block_queue::connect( chain::database& db )
+{
+   _connection = db.applied_block.connect( [this, &db]( const chain::signed_block& b ) { on_applied_block( db, b ); },
+                                           "applied_block_queue" );
+}
+
+void applied_block_queue::flush()
+{
+   while( !_queued.empty() )
+   {
+      _queued.front().wait();
+      _queued.pop_front();
+   }
+}
+
+void applied_block_queue::on_applied_block( const chain::database& db, const chain::signed_block& b )
+{
+   // a fork switch pops blocks before it applies the blocks of the other branch, which replace them here
+   const uint32_t block_num = b.block_num();
+   while( !_reversible.empty() && _reversible.back()->block.block_num() >= block_num )
+      _reversible.pop_back();
+
+   auto data = std::make_shared<applied_block_data>();
+   data->block = b;
+   data->operations = db.get_applied_operations();
+   _reversible.push_back( std::move(data) );
+
+   const uint32_t last_irreversible = db.get_dynamic_global_properties().last_irreversible_block_num;
+   while( !_reversible.empty() && _reversible.front()->block.block_num() <= last_irreversible )
+   {
+      dispatch( _reversible.front() );
+      _reversible.pop_front();
+   }
+}
+
+void applied_block_queue::dispatch( const std::shared_ptr<const applied_block_data>& data )
+{
+   while( !_queued.empty() && _queued.front().ready() )
+      _queued.pop_front();
+   while( _queued.size() >= _max_queued )
+   {
+      _queued.front().wait();
+      _queued.pop_front();
+   }
+
+   _queued.push_back( _thread.async( [this, data]() {
+      try {
+         _handler( *data );
+      } catch( const fc::exception& e ) {
+         elog( "Applied block handler failed for block #${n}: ${e}",
+               ("n", data->block.block_num())("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         elog( "Applied block handler failed for block #${n}: ${e}", ("n", data->block.block_num())("e", e.what()) );
+      }
+   }, "applied_block_queue" ) );
+}
+
+} } // graphene::app
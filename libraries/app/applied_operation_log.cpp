@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/applied_operation_log.hpp>
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cstdio>
+
+namespace graphene { namespace app {
+
+struct applied_operation_log::entry
+{
+   uint64_t pos       = 0;
+   uint32_t size      = 0;
+   /** 0 for the blocks the log skipped */
+   uint32_t block_num = 0;
+};
+
+void applied_operation_log::open( const fc::path& dir, uint32_t segment_size )
+{ try {
+   FC_ASSERT( segment_size > 0 );
+   std::lock_guard<std::mutex> lock( _mutex );
+   fc::create_directories( dir );
+   _dir = dir;
+
+   const fc::path index_path  = dir / "index";
+   const fc::path layout_path = dir / "layout";
+   auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+   if( !fc::exists( index_path ) || !fc::exists( layout_path ) )
+   {
+      chain::block_storage_layout layout;
+      layout.segment_size = segment_size;
+      fc::json::save_to_file( layout, layout_path );
+      mode |= std::fstream::trunc;
+   }
+   _segment_size = fc::json::from_file( layout_path ).as<chain::block_storage_layout>().segment_size;
+   FC_ASSERT( _segment_size > 0, "invalid applied operations log layout in ${p}", ("p",layout_path) );
+
+   _index.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   _index.open( index_path.generic_string().c_str(), mode );
+
+   // the operations are flushed before the entry pointing to them is written, the entries at the end that a crash
+   // left torn or pointing past their segment are dropped
+   _index.seekg( 0, _index.end );
+   const uint64_t index_size = _index.tellg();
+   uint64_t entries = index_size / sizeof(entry);
+   while( entries > 1 )
+   {
+      entry e;
+      _index.seekg( ( entries - 1 ) * sizeof(entry) );
+      _index.read( (char*)&e, sizeof(e) );
+      const fc::path ops_path = segment_path( uint32_t( entries - 1 ) / _segment_size );
+      if( e.block_num == entries - 1 && fc::exists( ops_path ) && e.pos + e.size <= fc::file_size( ops_path ) )
+         break;
+      --entries;
+   }
+   if( index_size != entries * sizeof(entry) )
+      fc::resize_file( index_path, entries * sizeof(entry) );
+   _last_block_num = entries > 0 ? uint32_t( entries - 1 ) : 0;
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+bool applied_operation_log::is_open()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _index.is_open();
+}
+
+void applied_operation_log::flush()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   for( auto& segment : _segments )
+      segment.second->flush();
+   if( _index.is_open() )
+      _index.flush();
+}
+
+void applied_operation_log::close()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _segments.clear();
+   if( _index.is_open() )
+      _index.close();
+   _last_block_num = 0;
+}
+
+void applied_operation_log::append( uint32_t block_num, const operation_list& operations )
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   FC_ASSERT( _index.is_open(), "the applied operations log is not open" );
+   if( block_num <= _last_block_num )
+      return;
+
+   const vector<char> packed = fc::raw::pack( operations );
+   std::fstream& ops = segment_stream( block_num / _segment_size );
+   ops.seekp( 0, ops.end );
+
+   entry e;
+   e.pos       = ops.tellp();
+   e.size      = packed.size();
+   e.block_num = block_num;
+   ops.write( packed.data(), packed.size() );
+   // the operations first, so that the index never points past the end of the segment
+   ops.flush();
+
+   // seeking past the end leaves the entries of skipped blocks zeroed
+   _index.seekp( uint64_t( block_num ) * sizeof(entry) );
+   _index.write( (const char*)&e, sizeof(e) );
+   _last_block_num = block_num;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+uint32_t applied_operation_log::last_block_num()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _last_block_num;
+}
+
+fc::optional<applied_operation_log::operation_list> applied_operation_log::fetch( uint32_t block_num )const
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   entry e;
+   if( !read_entry( block_num, e ) )
+      return fc::optional<operation_list>();
+
+   vector<char> packed( e.size );
+   std::fstream& ops = segment_stream( block_num / _segment_size );
+   ops.seekg( e.pos );
+   ops.read( packed.data(), packed.size() );
+   return fc::raw::unpack<operation_list>( packed );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+bool applied_operation_log::read_entry( uint32_t block_num, entry& e )const
+{
+   if( !_index.is_open() || block_num == 0 || block_num > _last_block_num )
+      return false;
+   _index.seekg( uint64_t( block_num ) * sizeof(entry) );
+   _index.read( (char*)&e, sizeof(e) );
+   return e.block_num == block_num && fc::exists( segment_path( block_num / _segment_size ) );
+}
+
+fc::path applied_operation_log::segment_path( uint32_t segment )const
+{
+   char name[32];
+   snprintf( name, sizeof(name), "ops.%06u", segment );
+   return _dir / name;
+}
+
+std::fstream& applied_operation_log::segment_stream( uint32_t segment )const
+{
+   auto& stream = _segments[segment];
+   if( !stream )
+   {
+      const fc::path path = segment_path( segment );
+      auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+      if( !fc::exists( path ) )
+         mode |= std::fstream::trunc;
+
+      std::unique_ptr<std::fstream> s( new std::fstream );
+      s->exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      s->open( path.generic_string().c_str(), mode );
+      stream = std::move( s );
+   }
+   return *stream;
+}
+
+} } // graphene::app
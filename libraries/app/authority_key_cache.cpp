@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/authority_key_cache.hpp>
+
+#include <graphene/chain/account_object.hpp>
+
+namespace graphene { namespace app {
+
+const size_t authority_key_cache::max_reaches;
+
+std::shared_ptr<authority_key_cache> authority_key_cache::get( chain::database& db )
+{
+   static std::mutex                                                         caches_mutex;
+   static std::map< chain::database*, std::weak_ptr<authority_key_cache> >  caches;
+
+   std::lock_guard<std::mutex> lock( caches_mutex );
+   for( auto itr = caches.begin(); itr != caches.end(); )
+   {
+      if( itr->second.expired() )
+         itr = caches.erase( itr );
+      else
+         ++itr;
+   }
+
+   // the indexes of db own the cache, so it lives as long as db
+   auto& slot = caches[&db];
+   auto cache = slot.lock();
+   if( !cache )
+   {
+      cache = std::make_shared<authority_key_cache>();
+      db.add_index_observer( cache );
+      slot = cache;
+   }
+   return cache;
+}
+
+std::shared_ptr<const authority_key_cache::reach> authority_key_cache::get_active_reach( const chain::database& db,
+                                                                                        chain::account_id_type account,
+                                                                                        uint32_t depth )
+{
+   // the walk takes the temporary account as approved and never looks at its authority
+   if( account == GRAPHENE_TEMP_ACCOUNT )
+      return std::make_shared<const reach>();
+
+   const reach_key key( account, depth );
+   uint64_t epoch;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      auto itr = _reaches.find( key );
+      if( itr != _reaches.end() )
+         return itr->second;
+      epoch = _epoch;
+   }
+
+   auto result = std::make_shared<reach>();
+   const chain::account_object* obj = db.find( account );
+   if( obj == nullptr )
+   {
+      // the walk throws on an unknown account, leave that to it
+      result->exact = false;
+      return result;
+   }
+   // followed without holding the lock, the accounts below are looked up and cached the same way
+   add_reach( db, obj->active, depth, true, *result );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( epoch == _epoch )
+   {
+      if( _reaches.size() >= max_reaches )
+      {
+         _reaches.clear();
+         _authorities.clear();
+         ++_epoch;
+      }
+      else
+      {
+         _reaches[key] = result;
+         _authorities[account] = obj->active;
+      }
+   }
+   return result;
+}
+
+void authority_key_cache::add_reach( const chain::database& db, const chain::authority& auth, uint32_t depth,
+                                     bool with_keys, reach& into )
+{
+   if( with_keys )
+   {
+      for( const auto& k : auth.key_auths )
+         into.keys.insert( k.first );
+      for( const auto& a : auth.address_auths )
+         into.addresses.insert( a.first );
+   }
+   // without signatures only these satisfy an authority, and a satisfied one ends the walk of its parent early
+   if( auth.weight_threshold == 0 )
+      into.exact = false;
+   for( const auto& a : auth.account_auths )
+   {
+      if( a.first == GRAPHENE_TEMP_ACCOUNT )
+      {
+         into.exact = false;
+         continue;
+      }
+      if( depth == 0 )
+         break;
+      auto below = get_active_reach( db, a.first, depth - 1 );
+      into.keys.insert( below->keys.begin(), below->keys.end() );
+      into.addresses.insert( below->addresses.begin(), below->addresses.end() );
+      into.exact = into.exact && below->exact;
+   }
+}
+
+size_t authority_key_cache::size()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _reaches.size();
+}
+
+void authority_key_cache::invalidate( const graphene::db::object& obj, bool removed )
+{
+   if( obj.id.space() != chain::protocol_ids || obj.id.type() != chain::account_object_type )
+      return;
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _authorities.find( chain::account_id_type( obj.id ) );
+   if( itr == _authorities.end() )
+      return;
+   // an account is only removed by undoing its creation, after which its id may come back with another authority
+   if( !removed && itr->second == static_cast<const chain::account_object&>( obj ).active )
+      return;
+   _reaches.clear();
+   _authorities.clear();
+   ++_epoch;
+}
+
+} } // graphene::app
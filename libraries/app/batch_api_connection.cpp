@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/batch_api_connection.hpp>
+#include <graphene/app/api_reader_pool.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/rpc/state.hpp>
+
+#include <vector>
+
+namespace graphene { namespace app {
+
+namespace {
+
+std::string error_response( uint64_t id, const fc::exception& e )
+{
+   return fc::json::to_string( fc::variant( fc::rpc::response( id, fc::rpc::error_object{ 1, e.to_detail_string(), fc::variant( e ) } ) ) );
+}
+
+}
+
+const size_t batch_api_connection::max_batch_calls;
+
+batch_api_connection::batch_api_connection( fc::http::websocket_connection& c, api_call_log* call_log,
+                                            std::string remote_endpoint )
+   : fc::rpc::websocket_api_connection( c ), _call_log( call_log ), _remote_endpoint( std::move( remote_endpoint ) )
+{
+   c.on_message_handler( [this]( const std::string& message ) { on_batch_message( message, true ); } );
+   c.on_http_handler( [this]( const std::string& message ) { return on_batch_message( message, false ); } );
+}
+
+void batch_api_connection::add_direct_call( fc::api_id_type api, const std::string& method, direct_call call )
+{
+   _direct_calls[ std::make_pair( api, method ) ] = std::move( call );
+}
+
+void batch_api_connection::set_batch_runner( fc::api_id_type api, std::function<bool( const std::string& method )> is_read,
+                                             batch_runner runner )
+{
+   _batch_api = api;
+   _batch_is_read = std::move( is_read );
+   _batch_runner = std::move( runner );
+}
+
+std::string batch_api_connection::on_batch_message( const std::string& message, bool send_message )
+{
+   std::string reply;
+   try
+   {
+      const fc::variant parsed = fc::json::from_string( message );
+      if( parsed.is_array() )
+      {
+         const fc::variants& requests = parsed.get_array();
+         FC_ASSERT( !requests.empty(), "Empty batch" );
+         FC_ASSERT( requests.size() <= max_batch_calls, "A batch holds at most ${max} calls", ("max",max_batch_calls) );
+
+         std::vector<std::string> responses( requests.size() );
+         for( size_t i = 0; i < requests.size(); )
+         {
+            bool heavy = false;
+            size_t end = i;
+            while( end < requests.size() && batched_read( requests[end], heavy ) )
+               ++end;
+            if( end == i )
+            {
+               responses[i] = handle_call( requests[i] );
+               ++i;
+               continue;
+            }
+            try
+            {
+               _batch_runner( heavy, [&]() {
+                  for( size_t j = i; j < end; ++j )
+                     responses[j] = handle_call( requests[j] );
+               } );
+            }
+            catch( const fc::exception& e )
+            {
+               // refused as a whole, by the time quota of the connection
+               for( size_t j = i; j < end; ++j )
+               {
+                  const fc::variant_object& call = requests[j].get_object();
+                  if( call.contains( "id" ) && ( call["id"].is_uint64() || call["id"].is_int64() ) )
+                     responses[j] = error_response( call["id"].as_uint64(), e );
+               }
+            }
+            i = end;
+         }
+         for( const std::string& response : responses )
+         {
+            if( response.empty() )
+               continue;
+            reply += reply.empty() ? '[' : ',';
+            reply += response;
+         }
+         // a batch of notifications alone is not answered
+         if( reply.empty() )
+            return reply;
+         reply += ']';
+      }
+      else if( parsed.is_object() && parsed.get_object().contains( "method" ) )
+      {
+         reply = handle_call( parsed );
+         if( reply.empty() )
+            return reply;
+      }
+      else // the responses to the callbacks of the server and anything else
+         return on_message( message, send_message );
+   }
+   catch( const fc::exception& e )
+   {
+      reply = error_response( 0, e );
+   }
+   if( send_message )
+      _connection.send_message( reply );
+   return reply;
+}
+
+std::string batch_api_connection::handle_call( const fc::variant& request )
+{
+   fc::rpc::request call;
+   try
+   {
+      call = request.as<fc::rpc::request>();
+   }
+   catch( const fc::exception& e )
+   {
+      return error_response( 0, e );
+   }
+
+   const fc::time_point start = fc::time_point::now();
+   fc::optional<fc::microseconds> encode_time;
+   std::string response;
+   uint64_t response_size = 0;
+   bool failed = false;
+   try
+   {
+      std::string result;
+      if( !call_direct( call, result ) )
+      {
+         const fc::variant value = _rpc_state.local_call( call.method, call.params );
+         const fc::time_point encode_start = fc::time_point::now();
+         result = fc::json::to_string( value );
+         encode_time = fc::time_point::now() - encode_start;
+      }
+      response_size = result.size();
+      if( call.id )
+         response = "{\"id\":" + fc::json::to_string( fc::variant( *call.id ) ) + ",\"jsonrpc\":\"2.0\",\"result\":" + result + "}";
+   }
+   catch( const fc::exception& e )
+   {
+      failed = true;
+      if( call.id )
+         response = error_response( *call.id, e );
+      response_size = response.size();
+   }
+   if( _call_log )
+      record_call( call, fc::time_point::now() - start, encode_time, response_size, failed );
+   return response;
+}
+
+void batch_api_connection::record_call( const fc::rpc::request& call, fc::microseconds duration,
+                                        const fc::optional<fc::microseconds>& encode_time, uint64_t response_size,
+                                        bool failed )
+{
+   // the API calls are recorded by the name of the method of the API rather than as "call"
+   if( call.method == "call" && call.params.size() >= 2 && call.params[1].is_string() )
+   {
+      static const fc::variants no_args;
+      const fc::variants& args = call.params.size() > 2 && call.params[2].is_array() ? call.params[2].get_array() : no_args;
+      _call_log->record( call.params[1].get_string(), args, _remote_endpoint, duration, encode_time, response_size, failed );
+   }
+   else
+      _call_log->record( call.method, call.params, _remote_endpoint, duration, encode_time, response_size, failed );
+}
+
+bool batch_api_connection::batched_read( const fc::variant& request, bool& heavy )const
+{
+   if( !_batch_runner || !request.is_object() )
+      return false;
+   const fc::variant_object& call = request.get_object();
+   if( !call.contains( "method" ) || !call["method"].is_string() || call["method"].get_string() != "call"
+       || !call.contains( "params" ) || !call["params"].is_array() )
+      return false;
+   const fc::variants& params = call["params"].get_array();
+   if( params.size() < 2 || !( params[0].is_uint64() || params[0].is_int64() ) || !params[1].is_string()
+       || fc::api_id_type( params[0].as_uint64() ) != _batch_api || !_batch_is_read( params[1].get_string() ) )
+      return false;
+   if( api_reader_pool::classify( params[1].get_string().c_str() ) == api_reader_pool::heavy_call )
+      heavy = true;
+   return true;
+}
+
+bool batch_api_connection::call_direct( const fc::rpc::request& call, std::string& out )
+{
+   // the API calls come as "call" with [api id, method, arguments]
+   if( _direct_calls.empty() || call.method != "call" || call.params.size() < 2
+       || !( call.params[0].is_uint64() || call.params[0].is_int64() ) || !call.params[1].is_string() )
+      return false;
+   auto itr = _direct_calls.find( std::make_pair( fc::api_id_type( call.params[0].as_uint64() ), call.params[1].get_string() ) );
+   if( itr == _direct_calls.end() )
+      return false;
+   itr->second( call.params.size() > 2 ? call.params[2].get_array() : fc::variants(), out );
+   return true;
+}
+
+} } // graphene::app
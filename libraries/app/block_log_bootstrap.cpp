@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/block_log_bootstrap.hpp>
+
+#include <graphene/chain/block_database.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/network/http/connection.hpp>
+#include <fc/network/resolve.hpp>
+#include <fc/string.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+namespace graphene { namespace app {
+
+namespace {
+
+struct mirror_url
+{
+   std::string host;
+   uint16_t    port = 80;
+};
+
+/** the host and port of http://host[:port]/path */
+mirror_url parse_mirror_url( const std::string& url )
+{ try {
+   const std::string scheme = "http://";
+   FC_ASSERT( url.compare( 0, scheme.size(), scheme ) == 0, "Only http mirrors are supported" );
+   const size_t path_start = url.find( '/', scheme.size() );
+   std::string authority = url.substr( scheme.size(),
+                                       path_start == std::string::npos ? std::string::npos : path_start - scheme.size() );
+   mirror_url result;
+   const size_t colon = authority.rfind( ':' );
+   if( colon != std::string::npos )
+   {
+      result.port = boost::lexical_cast<uint16_t>( authority.substr( colon + 1 ) );
+      authority.resize( colon );
+   }
+   result.host = authority;
+   FC_ASSERT( !result.host.empty(), "The mirror has no host" );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (url) ) }
+
+}
+
+const uint64_t block_log_bootstrap::max_reply_size;
+
+block_log_bootstrap::block_log_bootstrap( std::vector<std::string> mirrors, uint32_t parallel_downloads )
+   : _mirrors( std::move( mirrors ) ), _parallel_downloads( std::max<uint32_t>( parallel_downloads, 1 ) )
+{
+   for( std::string& mirror : _mirrors )
+      while( !mirror.empty() && mirror.back() == '/' )
+         mirror.pop_back();
+}
+
+void block_log_bootstrap::set_storage( uint32_t segment_size, int compression_level )
+{
+   _segment_size = segment_size;
+   _compression_level = compression_level;
+}
+
+std::vector<char> block_log_bootstrap::fetch( size_t mirror, const std::string& path, uint64_t offset, uint64_t size )const
+{ try {
+   const std::string& base = _mirrors[mirror];
+   const mirror_url url = parse_mirror_url( base );
+   const std::vector<fc::ip::endpoint> endpoints = fc::resolve( url.host, url.port );
+   FC_ASSERT( !endpoints.empty(), "The host name can not be resolved" );
+
+   fc::http::connection connection;
+   connection.connect_to( endpoints.front() );
+   fc::http::headers headers;
+   if( size > 0 )
+      headers.push_back( fc::http::header( "Range", "bytes=" + fc::to_string( offset ) + "-" + fc::to_string( offset + size - 1 ) ) );
+   fc::http::reply reply = connection.request( "GET", base + "/" + path, std::string(), headers );
+   FC_ASSERT( reply.status == 200 || reply.status == 206, "The mirror answered with status ${s}", ("s",reply.status) );
+   FC_ASSERT( reply.body.size() <= max_reply_size, "The mirror sent ${n} bytes, more than the ${m} taken",
+              ("n",reply.body.size())("m",max_reply_size) );
+   if( size == 0 )
+      return std::move( reply.body );
+   if( reply.status == 206 )
+   {
+      FC_ASSERT( reply.body.size() == size, "The mirror sent ${n} of ${s} bytes", ("n",reply.body.size())("s",size) );
+      return std::move( reply.body );
+   }
+   // a server that takes no ranges sends the whole file
+   FC_ASSERT( reply.body.size() >= offset + size, "The file of the mirror ends after ${n} bytes", ("n",reply.body.size()) );
+   return std::vector<char>( reply.body.begin() + offset, reply.body.begin() + offset + size );
+} FC_CAPTURE_AND_RETHROW( (_mirrors[mirror])(path)(offset)(size) ) }
+
+std::vector<chain::signed_block> block_log_bootstrap::fetch_segment( size_t first_mirror, uint32_t first, uint32_t last,
+                                                                    const checkpoint_map& checkpoints,
+                                                                    const fc::optional<chain::block_id_type>& previous,
+                                                                    bool& rejected )const
+{
+   const uint32_t segment = first / _mirror_segment_size;
+   for( size_t attempt = 0; attempt < _mirrors.size(); ++attempt )
+   {
+      const size_t mirror = ( first_mirror + attempt ) % _mirrors.size();
+      try
+      {
+         const std::vector<char> index = fetch( mirror, "index", uint64_t( first ) * chain::block_database::index_entry_size,
+                                                uint64_t( last - first + 1 ) * chain::block_database::index_entry_size );
+         const auto span = chain::block_database::segment_copy_span( first, last, index );
+         FC_ASSERT( span.second - span.first <= max_reply_size, "The blocks take ${n} bytes in the segment of the mirror",
+                    ("n",span.second - span.first) );
+         const std::vector<char> stored = fetch( mirror, chain::block_database::segment_file_name( segment ),
+                                                 span.first, span.second - span.first );
+         std::vector<chain::signed_block> blocks = chain::block_database::read_segment_copy( first, last, index, stored,
+                                                                                             span.first );
+
+         // the ids only cover the headers, the bodies are checked against their merkle roots
+         rejected = true;
+         for( size_t i = 0; i < blocks.size(); ++i )
+         {
+            const chain::signed_block& b = blocks[i];
+            const uint32_t num = first + i;
+            FC_ASSERT( b.calculate_merkle_root() == b.transaction_merkle_root,
+                       "The transactions of block ${n} do not match its merkle root", ("n",num) );
+            if( i > 0 )
+               FC_ASSERT( b.previous == blocks[i - 1].id(), "Block ${n} does not link to the block before it", ("n",num) );
+            else if( previous.valid() )
+               FC_ASSERT( b.previous == *previous, "Block ${n} does not link to the block before it", ("n",num) );
+            const auto checkpoint = checkpoints.find( num );
+            FC_ASSERT( checkpoint == checkpoints.end() || checkpoint->second == b.id(),
+                       "Block ${n} is not the one of the checkpoint", ("n",num) );
+         }
+         rejected = false;
+         return blocks;
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Unable to fetch blocks ${a} through ${b} from ${m}: ${e}",
+               ("a",first)("b",last)("m",_mirrors[mirror])("e",e.to_detail_string()) );
+      }
+   }
+   FC_THROW( "No mirror has blocks ${a} through ${b}", ("a",first)("b",last) );
+}
+
+uint32_t block_log_bootstrap::run( const fc::path& block_log_dir,
+                                   const fc::flat_map<uint32_t, chain::block_id_type>& checkpoints )
+{ try {
+   if( checkpoints.empty() || _mirrors.empty() )
+      return 0;
+   const fc::path index_path = block_log_dir / "index";
+   if( fc::exists( index_path ) && fc::file_size( index_path ) > 0 )
+      return 0;
+   const uint32_t target = checkpoints.rbegin()->first;
+   const chain::block_id_type target_id = checkpoints.rbegin()->second;
+
+   // the mirrors have to split their block logs alike, those that do not are left out
+   std::vector<std::string> mirrors;
+   for( size_t mirror = 0; mirror < _mirrors.size(); ++mirror )
+   {
+      try
+      {
+         const std::vector<char> body = fetch( mirror, "layout" );
+         const auto layout = fc::json::from_string( std::string( body.begin(), body.end() ) ).as<chain::block_storage_layout>();
+         FC_ASSERT( layout.segment_size > 0, "The block log of the mirror has no segments" );
+         if( _mirror_segment_size == 0 )
+            _mirror_segment_size = layout.segment_size;
+         FC_ASSERT( layout.segment_size == _mirror_segment_size, "The mirror has segments of ${n} blocks, not ${m}",
+                    ("n",layout.segment_size)("m",_mirror_segment_size) );
+         mirrors.push_back( _mirrors[mirror] );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Leaving out the mirror ${m}: ${e}", ("m",_mirrors[mirror])("e",e.to_detail_string()) );
+      }
+   }
+   FC_ASSERT( !mirrors.empty(), "No mirror can be used" );
+   _mirrors = std::move( mirrors );
+
+   const fc::path staging_dir( block_log_dir.generic_string() + ".bootstrap" );
+   chain::block_database staging;
+   staging.set_segment_size( _segment_size );
+   staging.set_compression_level( _compression_level );
+   staging.open( staging_dir );
+   // blocks that do not lead to the checkpoint came from a mirror that can not be trusted
+   auto discard = [&]() {
+      staging.close();
+      fc::remove_all( staging_dir );
+   };
+
+   uint32_t next = 1;
+   chain::block_id_type previous;
+   if( const auto last = staging.last_id() )
+   {
+      previous = *last;
+      next = chain::block_header::num_from_id( previous ) + 1;
+      ilog( "Continuing the bootstrap after block ${n}", ("n",next - 1) );
+   }
+
+   // one range per segment of the mirrors, downloaded a few at once and stored in order
+   std::vector< std::pair<uint32_t, uint32_t> > ranges;
+   for( uint32_t first = next; first <= target; )
+   {
+      const uint32_t last = uint32_t( std::min<uint64_t>( target, ( uint64_t( first ) / _mirror_segment_size + 1 ) * _mirror_segment_size - 1 ) );
+      ranges.emplace_back( first, last );
+      first = last + 1;
+   }
+   ilog( "Fetching blocks ${a} through ${b} from ${n} mirrors", ("a",next)("b",target)("n",_mirrors.size()) );
+
+   std::vector< std::unique_ptr<fc::thread> > threads;
+   for( uint32_t i = 0; i < std::min<size_t>( _parallel_downloads, ranges.size() ); ++i )
+      threads.emplace_back( new fc::thread( "bootstrap" ) );
+   std::deque< fc::future< std::vector<chain::signed_block> > > downloads;
+   // set by the download of a range, read once it is waited on
+   std::unique_ptr<bool[]> rejected( new bool[ ranges.size() ]() );
+   size_t started = 0;
+   auto start_next = [&]() {
+      const std::pair<uint32_t, uint32_t> range = ranges[started];
+      const size_t mirror = started % _mirrors.size();
+      bool* range_rejected = &rejected[started];
+      downloads.push_back( threads[ started % threads.size() ]->async( [this, range, mirror, &checkpoints, range_rejected]() {
+         return fetch_segment( mirror, range.first, range.second, checkpoints, fc::optional<chain::block_id_type>(),
+                               *range_rejected );
+      }, "bootstrap_segment" ) );
+      ++started;
+   };
+
+   try
+   {
+      while( started < ranges.size() && downloads.size() < _parallel_downloads )
+         start_next();
+      for( size_t stored = 0; !downloads.empty(); ++stored )
+      {
+         std::vector<chain::signed_block> blocks;
+         try
+         {
+            blocks = downloads.front().wait();
+         }
+         catch( const fc::exception& )
+         {
+            // no mirror has the right segment; unless one sent wrong blocks, what is stored so far stays for the
+            // next attempt
+            downloads.pop_front();
+            if( rejected[stored] )
+               discard();
+            throw;
+         }
+         downloads.pop_front();
+         if( started < ranges.size() )
+            start_next();
+
+         // the segments download apart, one that does not link up with the one before it is fetched again from
+         // the other mirrors with the link checked
+         if( !blocks.empty() && blocks.front().previous != previous )
+         {
+            const std::pair<uint32_t, uint32_t> range = ranges[stored];
+            bool relinked_rejected = true;
+            try
+            {
+               blocks = fetch_segment( ( stored + 1 ) % _mirrors.size(), range.first, range.second, checkpoints, previous,
+                                       relinked_rejected );
+            }
+            catch( const fc::exception& )
+            {
+               if( relinked_rejected )
+                  discard();
+               throw;
+            }
+         }
+
+         for( const chain::signed_block& b : blocks )
+         {
+            const chain::block_id_type id = b.id();
+            staging.store( id, b );
+            previous = id;
+         }
+         if( !blocks.empty() )
+            ilog( "Bootstrapped blocks through ${n} of ${t}", ("n",blocks.back().block_num())("t",target) );
+      }
+   }
+   catch( ... )
+   {
+      // the downloads in flight use this object
+      for( auto& download : downloads )
+      {
+         try
+         {
+            download.wait();
+         }
+         catch( ... ) {}
+      }
+      throw;
+   }
+
+   // continuing a bootstrap to a lower checkpoint than before, the blocks after it are not known to be good
+   if( ranges.empty() )
+   {
+      if( staging.fetch_block_id( target ) != target_id )
+      {
+         discard();
+         FC_THROW( "The bootstrapped blocks do not lead to the checkpoint at block ${n}", ("n",target) );
+      }
+      staging.remove_after( target );
+   }
+
+   staging.flush();
+   staging.close();
+   if( fc::exists( block_log_dir ) )
+      fc::remove_all( block_log_dir );
+   fc::rename( staging_dir, block_log_dir );
+   ilog( "Bootstrapped the block log through block ${n}", ("n",target) );
+   return target;
+} FC_CAPTURE_AND_RETHROW( (block_log_dir) ) }
+
+} } // graphene::app
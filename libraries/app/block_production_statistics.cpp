@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/block_production_statistics.hpp>
+
+namespace graphene { namespace app {
+
+const size_t block_production_statistics::max_recent_attempts;
+
+void block_production_statistics::add( const block_production_attempt& attempt, bool keep )
+{
+   ++conditions[attempt.condition];
+   if( !keep )
+      return;
+
+   wakeup_drift.add( attempt.wakeup_drift );
+   if( attempt.block_num != 0 )
+   {
+      generate_time.add( attempt.generate_time );
+      block_size.add( attempt.block_size );
+      transactions_included += attempt.assembly.included;
+      transactions_postponed += attempt.assembly.postponed;
+      transactions_failed += attempt.assembly.failed;
+   }
+   recent_attempts.push_back( attempt );
+   while( recent_attempts.size() > max_recent_attempts )
+      recent_attempts.pop_front();
+}
+
+void block_production_statistics::broadcast( uint32_t block_num, int64_t microseconds )
+{
+   broadcast_time.add( microseconds );
+   for( auto itr = recent_attempts.rbegin(); itr != recent_attempts.rend(); ++itr )
+      if( itr->block_num == block_num )
+      {
+         itr->broadcast_time = microseconds;
+         break;
+      }
+}
+
+} } // graphene::app
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/chain_write_queue.hpp>
+
+#include <string>
+
+namespace graphene { namespace app {
+
+const char* const chain_write_queue::task_names[chain_write_queue::write_class_count] = {
+   "chain write block", "chain write production", "chain write api", "chain write p2p"
+};
+
+chain_write_queue::chain_write_queue()
+   : _thread( &fc::thread::current() )
+{
+   for( auto& w : _waiting )
+      w.store( 0, std::memory_order_relaxed );
+}
+
+const char* chain_write_queue::class_name( write_class cls )
+{
+   static const char* const names[write_class_count] = { "block", "production", "api", "p2p" };
+   return names[cls];
+}
+
+void chain_write_queue::add_metrics( graphene::utilities::metrics_registry& metrics )
+{
+   for( int i = 0; i < write_class_count; ++i )
+   {
+      const write_class cls = write_class( i );
+      const std::string labels = std::string( "class=\"" ) + class_name( cls ) + "\"";
+      metrics.add_gauge( "graphene_chain_writes_waiting", "Writes to the chain state waiting for the chain thread",
+                         [this, cls]() -> double { return waiting( cls ); }, labels );
+   }
+}
+
+} } // graphene::app
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/confirmation_registry.hpp>
+
+#include <fc/thread/thread.hpp>
+
+namespace graphene { namespace app {
+
+confirmation_registry::confirmation_registry( chain::database& db ) : _db( db )
+{
+   _connection = db.applied_block.connect( [this]( const chain::signed_block& b ) { on_applied_block( b ); },
+                                           "confirmation_registry" );
+}
+
+void confirmation_registry::watch( const chain::signed_transaction& trx, std::weak_ptr<const void> owner, callback_type cb )
+{
+   waiter w;
+   w.id = trx.id();
+   w.expiration = trx.expiration;
+   w.owner = std::move( owner );
+   w.callback = std::move( cb );
+   std::lock_guard<std::mutex> guard( _mutex );
+   _waiters.insert( std::move( w ) );
+}
+
+size_t confirmation_registry::size()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _waiters.size();
+}
+
+void confirmation_registry::on_applied_block( const chain::signed_block& b )
+{
+   struct ready_callback
+   {
+      std::weak_ptr<const void>              owner;
+      callback_type                          callback;
+      std::shared_ptr<const fc::variant>     confirmation;
+   };
+   std::vector<ready_callback> ready;
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      if( _waiters.empty() )
+         return;
+
+      auto& by_trx_id = _waiters.get<by_id>();
+      const auto& ids = _db.get_applied_transaction_ids();
+      const bool ids_known = ids.size() == b.transactions.size();
+      const uint32_t block_num = b.block_num();
+      for( uint32_t trx_num = 0; trx_num < b.transactions.size() && !by_trx_id.empty(); ++trx_num )
+      {
+         const chain::transaction_id_type id = ids_known ? ids[trx_num] : b.transactions[trx_num].id();
+         auto range = by_trx_id.equal_range( id );
+         if( range.first == range.second )
+            continue;
+         // built once for every connection waiting for the transaction
+         auto confirmation = std::make_shared<const fc::variant>(
+               transaction_confirmation{ id, block_num, trx_num, b.transactions[trx_num] } );
+         for( auto itr = range.first; itr != range.second; ++itr )
+            if( !itr->owner.expired() )
+               ready.push_back( ready_callback{ itr->owner, itr->callback, confirmation } );
+         by_trx_id.erase( range.first, range.second );
+      }
+
+      auto& by_exp = _waiters.get<by_expiration>();
+      by_exp.erase( by_exp.begin(), by_exp.lower_bound( b.timestamp ) );
+   }
+
+   for( auto& r : ready )
+      fc::async( [r]() {
+         if( auto alive = r.owner.lock() )
+            r.callback( *r.confirmation );
+      } );
+}
+
+} } // graphene::app
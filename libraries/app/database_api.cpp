@@ -22,10 +22,14 @@
  * THE SOFTWARE.
  */
 
+#include <graphene/app/authority_key_cache.hpp>
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/send_queue.hpp>
 #include <graphene/chain/get_config.hpp>
+#include <graphene/chain/member_name_index.hpp>
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/trace.hpp>
 
-#include <fc/bloom_filter.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <fc/crypto/hex.hpp>
@@ -34,7 +38,13 @@
 #include <boost/rational.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
+#include <atomic>
 #include <cctype>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 
 #include <cfenv>
 #include <iostream>
@@ -45,18 +55,81 @@ namespace graphene { namespace app {
 
 class database_api_impl;
 
+namespace {
+   /**
+    * The copy of the state that simulate_transactions() applies to, shared by every database_api of a database.  It
+    * is copied by the first call after a new head block, so there is one copy per node and at most one copy per
+    * block, and the calls take turns on it, each undoing its transactions when done.
+    */
+   class simulation_state
+   {
+      public:
+         static std::shared_ptr<simulation_state> get( const database& db )
+         {
+            static std::mutex                                                        states_mutex;
+            static std::map< const database*, std::weak_ptr<simulation_state> >     states;
+
+            std::lock_guard<std::mutex> lock( states_mutex );
+            for( auto itr = states.begin(); itr != states.end(); )
+            {
+               if( itr->second.expired() )
+                  itr = states.erase( itr );
+               else
+                  ++itr;
+            }
+
+            // the APIs own the state, the copy goes with the last of them
+            auto& slot = states[&db];
+            auto state = slot.lock();
+            if( !state )
+            {
+               state = std::make_shared<simulation_state>();
+               slot = state;
+            }
+            return state;
+         }
+
+         /** held while a call applies its transactions to fork() */
+         std::mutex mutex;
+
+         /** @return the copy of @ref db for its head block, copied anew if there is none; call with mutex held */
+         database& fork( const database& db )
+         {
+            if( !_fork || _head != db.head_block_id() || _fork->get_applied_operations().size() > max_simulated_operations )
+            {
+               // the copy of the previous head goes first, so there is no more than one at any time
+               _fork.reset();
+               _fork = db.fork_state();
+               _head = db.head_block_id();
+            }
+            return *_fork;
+         }
+
+      private:
+         /** the applied operations a fork collects before it is copied again, they are only dropped with a block */
+         static const size_t          max_simulated_operations = 10000;
+
+         std::unique_ptr<database>    _fork;
+         block_id_type                _head;
+   };
+}
 
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
-      database_api_impl( graphene::chain::database& db );
+      database_api_impl( graphene::chain::database& db, const market_history_plugin* market_history,
+                         std::shared_ptr<api_reader_pool> readers, graphene::utilities::metrics_registry* metrics );
       ~database_api_impl();
 
       // Objects
       fc::variants get_objects(const vector<object_id_type>& ids)const;
+      vector<optional<vector<char>>> get_packed_objects(const vector<object_id_type>& ids)const;
+      object_cache_statistics get_object_cache_statistics()const;
 
       // Subscriptions
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool clear_filter );
+      void set_subscription_filter( subscription_filter_type filter );
+      uint64_t get_subscription_memory()const;
       void set_pending_transaction_callback( std::function<void(const variant&)> cb );
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
       void cancel_all_subscriptions();
@@ -64,6 +137,13 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       // Blocks and transactions
       optional<block_header> get_block_header(uint32_t block_num)const;
       optional<signed_block> get_block(uint32_t block_num)const;
+      vector<optional<vector<char>>> get_packed_blocks(uint32_t first_block_num, uint32_t count)const;
+      vector<vector<char>> get_packed_state_diffs(uint32_t first_block_num, uint32_t count)const;
+      optional<block_state_hash> get_state_hash(uint32_t block_num)const;
+      void stream_blocks( std::function<void(const variant&)> callback, uint32_t start_block_num,
+                          uint32_t end_block_num, bool include_applied_ops );
+      void acknowledge_streamed_blocks( uint32_t block_num );
+      void cancel_block_stream();
       processed_transaction get_transaction( uint32_t block_num, uint32_t trx_in_block )const;
 
       // Globals
@@ -75,10 +155,15 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       // Keys
       vector<vector<account_id_type>> get_key_references( vector<public_key_type> key )const;
+      vector<key_references> get_full_key_references( const vector<public_key_type>& keys )const;
+      /** the accounts with @ref key or one of its addresses in an authority, without subscribing to them */
+      vector<account_id_type> key_accounts( const public_key_type& key )const;
 
       // Accounts
       vector<optional<account_object>> get_accounts(const vector<account_id_type>& account_ids)const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
+      std::map<string,full_account_page> get_full_accounts_paged( const vector<string>& names_or_ids,
+                                                                  const full_account_query& query, bool subscribe );
       optional<account_object> get_account_by_name( string name )const;
       vector<account_id_type> get_account_references( account_id_type account_id )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
@@ -87,7 +172,13 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       // Balances
       vector<asset> get_account_balances(account_id_type id, const flat_set<asset_id_type>& assets)const;
+      api_page<asset> get_account_balances_page( account_id_type id, uint32_t limit, const string& cursor )const;
       vector<asset> get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const;
+      vector<account_balances> get_balances_for_accounts( const vector<account_id_type>& accounts,
+                                                          const flat_set<asset_id_type>& assets )const;
+      void subscribe_to_balances( std::function<void(const variant&)> callback,
+                                  const vector<account_id_type>& accounts, const flat_set<asset_id_type>& assets );
+      void unsubscribe_from_balances();
       vector<balance_object> get_balance_objects( const vector<address>& addrs )const;
       vector<asset> get_vested_balances( const vector<balance_id_type>& objs )const;
       vector<vesting_balance_object> get_vesting_balances( account_id_type account_id )const;
@@ -96,29 +187,55 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<optional<asset_object>> get_assets(const vector<asset_id_type>& asset_ids)const;
       vector<asset_object>           list_assets(const string& lower_bound_symbol, uint32_t limit)const;
       vector<optional<asset_object>> lookup_asset_symbols(const vector<string>& symbols_or_ids)const;
+      api_page<asset_holder>         get_asset_holders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
+      asset_holder_statistics        get_asset_holders_count( asset_id_type a )const;
 
       // Markets / feeds
       vector<limit_order_object>         get_limit_orders(asset_id_type a, asset_id_type b, uint32_t limit)const;
       vector<call_order_object>          get_call_orders(asset_id_type a, uint32_t limit)const;
       vector<force_settlement_object>    get_settle_orders(asset_id_type a, uint32_t limit)const;
+      api_page<limit_order_object>       get_limit_orders_page( asset_id_type sell, asset_id_type receive, uint32_t limit,
+                                                                const string& cursor )const;
+      api_page<call_order_object>        get_call_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
+      api_page<force_settlement_object>  get_settle_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
       vector<call_order_object>          get_margin_positions( const account_id_type& id )const;
       void subscribe_to_market(std::function<void(const variant&)> callback, asset_id_type a, asset_id_type b);
       void unsubscribe_from_market(asset_id_type a, asset_id_type b);
+      void subscribe_to_market_deltas(std::function<void(const variant&)> callback, asset_id_type a, asset_id_type b);
+      void unsubscribe_from_market_deltas(asset_id_type a, asset_id_type b);
+      const limit_order_book_index& get_order_book_index()const;
       market_ticker                      get_ticker( const string& base, const string& quote )const;
       market_volume                      get_24_volume( const string& base, const string& quote )const;
+      /** calls @ref reader with the latest and prior price and the 24 hour base and quote volume of a market */
+      void                               read_ticker( const asset_object& base, const asset_object& quote,
+                                                      const std::function<void(double,double,double,double)>& reader )const;
       order_book                         get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
+      order_book                         get_order_book( const asset_object& base_asset, const asset_object& quote_asset,
+                                                         const string& base, const string& quote, unsigned limit )const;
+      market_ticker                      get_ticker( const asset_object& base_asset, const asset_object& quote_asset,
+                                                     const string& base, const string& quote )const;
+      vector<order_book>                 get_order_books( const vector<std::pair<string,string>>& markets, unsigned limit )const;
+      vector<market_ticker>              get_tickers( const vector<std::pair<string,string>>& markets )const;
+      /** resolves the assets of all @ref markets at once and calls @ref visit for each market in order */
+      void                               for_each_market( const vector<std::pair<string,string>>& markets,
+                                                          const std::function<void(const asset_object&, const asset_object&,
+                                                                                   const std::pair<string,string>&)>& visit )const;
       vector<market_trade>               get_trade_history( const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100 )const;
+      api_page<market_trade>             get_trade_history_page( const string& base, const string& quote, fc::time_point_sec start,
+                                                                 fc::time_point_sec stop, uint32_t limit, const string& cursor )const;
 
       // Witnesses
       vector<optional<witness_object>> get_witnesses(const vector<witness_id_type>& witness_ids)const;
       fc::optional<witness_object> get_witness_by_account(account_id_type account)const;
       map<string, witness_id_type> lookup_witness_accounts(const string& lower_bound_name, uint32_t limit)const;
       uint64_t get_witness_count()const;
+      vector<witness_object> get_witnesses_by_votes(uint32_t limit)const;
 
       // Committee members
       vector<optional<committee_member_object>> get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const;
       fc::optional<committee_member_object> get_committee_member_by_account(account_id_type account)const;
       map<string, committee_member_id_type> lookup_committee_member_accounts(const string& lower_bound_name, uint32_t limit)const;
+      vector<committee_member_object> get_committee_members_by_votes(uint32_t limit)const;
 
       // Votes
       vector<variant> lookup_vote_ids( const vector<vote_id_type>& votes )const;
@@ -129,9 +246,15 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       set<public_key_type> get_potential_signatures( const signed_transaction& trx )const;
       set<address> get_potential_address_signatures( const signed_transaction& trx )const;
       bool verify_authority( const signed_transaction& trx )const;
+      /**
+       * @return the keys and addresses get_potential_signatures collects for @ref trx, from the authority key cache,
+       * or null if the walk has to be done
+       */
+      std::shared_ptr<const authority_key_cache::reach> get_potential_reach( const signed_transaction& trx )const;
       bool verify_account_authority( const string& name_or_id, const flat_set<public_key_type>& signers )const;
       processed_transaction validate_transaction( const signed_transaction& trx )const;
       vector< fc::variant > get_required_fees( const vector<operation>& ops, asset_id_type id )const;
+      vector<simulated_transaction> simulate_transactions( const vector<signed_transaction>& trxs )const;
 
       // Proposed transactions
       vector<proposal_object> get_proposed_transactions( account_id_type id )const;
@@ -140,47 +263,154 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<blinded_balance_object> get_blinded_balances( const flat_set<commitment_type>& commitments )const;
 
    //private:
-      template<typename T>
-      void subscribe_to_item( const T& i )const
+      /** runs the read-only call @ref reader on the reader threads, if there are any, counting it as @ref method;
+       *  it waits for its turn with the calls of the other connections and counts against the quotas of this one */
+      template<typename Reader>
+      auto read( const char* method, Reader&& reader )const -> decltype( reader() )
       {
-         auto vec = fc::raw::pack(i);
-         if( !_subscribe_callback )
-            return;
+         GRAPHENE_TRACE_SPAN( method );
+         call_timer timer( call_metrics( method ) );
+         graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_api );
+         if( !_readers )
+            return reader();
+         return _readers->run( _reader_client, method, [&reader]() -> decltype( reader() ) {
+            graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_api );
+            return reader();
+         } );
+      }
 
-         if( !is_subscribed_to_item(i) )
+      struct call_metrics_type
+      {
+         graphene::utilities::metrics_counter*   calls   = nullptr;
+         graphene::utilities::metrics_histogram* latency = nullptr;
+      };
+      /** observes the time until it is destroyed into the latency of a call, if there are metrics */
+      struct call_timer
+      {
+         call_timer( const call_metrics_type& m ) : metrics( m ), start( fc::time_point::now() )
          {
-            idump((i));
-            _subscribe_filter.insert( vec.data(), vec.size() );//(vecconst char*)&i, sizeof(i) );
+            if( metrics.calls )
+               metrics.calls->add();
          }
-      }
+         ~call_timer()
+         {
+            if( metrics.latency )
+               metrics.latency->observe( ( fc::time_point::now() - start ).count() / 1000000.0 );
+         }
+         const call_metrics_type& metrics;
+         fc::time_point           start;
+      };
+      /** the metrics of @ref method, looked up in the registry on its first call */
+      const call_metrics_type& call_metrics( const char* method )const;
 
-      template<typename T>
-      bool is_subscribed_to_item( const T& i )const
+      /** subscribes to the objects that get_objects returns */
+      void subscribe_to_objects( const vector<object_id_type>& ids )const;
+
+      void subscribe_to_item( object_id_type id )const
       {
-         if( !_subscribe_callback )
-            return false;
-         return true;
-         return _subscribe_filter.contains( i );
+         if( !_subscribing )
+            return;
+         _hub->subscribe( _hub_session, id );
       }
 
-      void broadcast_updates( const vector<variant>& updates );
+      /** keys and addresses are no objects, the objects found through them are subscribed to instead */
+      template<typename T>
+      typename std::enable_if< !std::is_convertible<T, object_id_type>::value >::type subscribe_to_item( const T& )const {}
+
+      void broadcast_updates( const vector<variant>& updates, const vector<uint64_t>& sizes );
+      /** ends the subscriptions of a connection that lets its notifications pile up */
+      void on_send_queue_overflow();
 
       /** called every time a block is applied to report the objects that were changed */
       void on_objects_changed(const vector<object_id_type>& ids);
       void on_objects_removed(const vector<const object*>& objs);
-      void on_applied_block();
+      void on_applied_block( const signed_block& b );
+      /** sends the stored blocks of _block_stream on a task of its own, as far as the acknowledged blocks allow */
+      void send_stored_blocks();
+
+      /** the bundle of get_full_accounts without the votes */
+      full_account make_full_account( const account_object* account )const;
+      /** the account of @ref name_or_id, nullptr when there is none */
+      const account_object* find_full_account( const string& name_or_id )const;
+      /** a full_account with the account, its statistics, referral names and cashback balance, but no sections */
+      full_account make_account_header( const account_object& account )const;
+      full_account_counts count_full_account( const account_object& account )const;
+      /** one page of each section of @ref account from @ref start, all sections from their beginning without it;
+       *  @ref budget is reduced by the objects returned */
+      full_account_page make_full_account_page( const account_object& account, const optional<full_account_cursor>& start,
+                                                uint32_t limit, uint32_t& budget )const;
+
+      /** the secondary index @ref SecondaryIndex of @ref PrimaryIndex, which nodes started with disable_api_indexes() lack */
+      template<typename SecondaryIndex, typename PrimaryIndex>
+      const SecondaryIndex& get_api_index()const
+      {
+         const SecondaryIndex* result = dynamic_cast<const primary_index<PrimaryIndex>&>(
+            _db.get_index_type<PrimaryIndex>() ).template find_secondary_index<SecondaryIndex>();
+         FC_ASSERT( result != nullptr, "This node does not keep the indexes this call needs, it runs with node-role "
+                                       "witness or seed" );
+         return *result;
+      }
 
-      mutable fc::bloom_filter                               _subscribe_filter;
+      std::shared_ptr<subscription_hub>                      _hub;
+      std::shared_ptr<serialized_object_cache>               _cache;
+      std::shared_ptr<authority_key_cache>                   _authority_keys;
+      /** every notification this session sends on its own goes through here */
+      std::shared_ptr<send_queue>                            _send_queue;
+      subscription_hub::session_id_type                      _hub_session;
       std::function<void(const fc::variant&)> _subscribe_callback;
+      /** whether _subscribe_callback is set, for the calls on reader threads */
+      std::atomic<bool>                       _subscribing;
       std::function<void(const fc::variant&)> _pending_trx_callback;
+
+      struct block_stream
+      {
+         std::function<void(const fc::variant&)> callback;
+         uint32_t                                next_block    = 0;
+         /** 0 to follow the head block */
+         uint32_t                                end_block     = 0;
+         uint32_t                                acknowledged  = 0;
+         bool                                    include_applied_ops = false;
+         /** set once the stored blocks are sent, from then on the applied blocks are */
+         bool                                    live          = false;
+      };
+      static const uint32_t                   block_stream_batch  = 100;
+      static const uint32_t                   block_stream_window = 2000;
+      optional<block_stream>                  _block_stream;
+      /** whether a send_stored_blocks() task is running */
+      bool                                    _sending_stored_blocks = false;
       std::function<void(const fc::variant&)> _block_applied_callback;
 
-      boost::signals2::scoped_connection                                                                                           _change_connection;
-      boost::signals2::scoped_connection                                                                                           _removed_connection;
-      boost::signals2::scoped_connection                                                                                           _applied_block_connection;
-      boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
+      graphene::chain::scoped_observer_connection                                                                                  _change_connection;
+      graphene::chain::scoped_observer_connection                                                                                  _removed_connection;
+      graphene::chain::scoped_observer_connection                                                                                  _applied_block_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
+      map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_delta_subscriptions;
+
+      struct balance_subscription
+      {
+         std::function<void(const variant&)> callback;
+         flat_set<account_id_type>           accounts;
+         /** empty for all assets */
+         flat_set<asset_id_type>             assets;
+
+         bool follows( const account_balance_object& b )const
+         {
+            return accounts.find( b.owner ) != accounts.end() && ( assets.empty() || assets.find( b.asset_type ) != assets.end() );
+         }
+      };
+      optional<balance_subscription>          _balance_subscription;
+      /** pushes the balances of @ref balances to _balance_subscription, with an amount of 0 for the removed ones */
+      void notify_balances( const vector<const account_balance_object*>& balances, bool removed );
       graphene::chain::database&                                                                                                            _db;
+      const market_history_plugin*                                                                                                          _market_history;
+      std::shared_ptr<api_reader_pool>                                                                                                      _readers;
+      mutable api_reader_pool::client                                                                                                       _reader_client;
+      graphene::utilities::metrics_registry*                                                                                                _metrics;
+      /** keyed by the address of the method name, which is a literal */
+      mutable std::map< const char*, call_metrics_type >                                                                                    _call_metrics;
+
+      /** the copy of the state simulate_transactions() applies to */
+      std::shared_ptr<simulation_state>                                                                                                     _simulation;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -189,30 +419,55 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-database_api::database_api( graphene::chain::database& db )
-   : my( new database_api_impl( db ) ) {}
+database_api::database_api( graphene::chain::database& db, const market_history_plugin* market_history,
+                            std::shared_ptr<api_reader_pool> readers, graphene::utilities::metrics_registry* metrics )
+   : my( new database_api_impl( db, market_history, std::move(readers), metrics ) ) {}
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+const uint32_t        database_api::default_max_full_account_objects;
+std::atomic<uint32_t> database_api::_max_full_account_objects( database_api::default_max_full_account_objects );
+
+database_api_impl::database_api_impl( graphene::chain::database& db, const market_history_plugin* market_history,
+                                      std::shared_ptr<api_reader_pool> readers,
+                                      graphene::utilities::metrics_registry* metrics )
+   :_hub(subscription_hub::get(db)),_cache(serialized_object_cache::get(db)),_authority_keys(authority_key_cache::get(db)),
+    _send_queue(std::make_shared<send_queue>([this](){ on_send_queue_overflow(); })),_subscribing(false),_db(db),_market_history(market_history),_readers(std::move(readers)),_metrics(metrics),
+    _simulation(simulation_state::get(db))
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
+   _hub_session = _hub->add_session([this](const vector<variant>& updates, const vector<uint64_t>& sizes) {
+                                broadcast_updates(updates, sizes);
+                                });
    _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids) {
                                 on_objects_changed(ids);
-                                });
+                                }, "database_api");
    _removed_connection = _db.removed_objects.connect([this](const vector<const object*>& objs) {
                                 on_objects_removed(objs);
-                                });
-   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
-
-   _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
-                         if( _pending_trx_callback ) _pending_trx_callback( fc::variant(trx) );
-                      });
+                                }, "database_api");
+   _applied_block_connection = _db.applied_block.connect([this](const signed_block& b){ on_applied_block(b); }, "database_api");
 }
 
 database_api_impl::~database_api_impl()
 {
    elog("freeing database api ${x}", ("x",int64_t(this)) );
+   _hub->remove_session( _hub_session );
+}
+
+const database_api_impl::call_metrics_type& database_api_impl::call_metrics( const char* method )const
+{
+   auto itr = _call_metrics.find( method );
+   if( itr != _call_metrics.end() )
+      return itr->second;
+   call_metrics_type& result = _call_metrics[method];
+   if( _metrics )
+   {
+      const std::string labels = std::string( "method=\"" ) + method + "\"";
+      result.calls = &_metrics->counter( "graphene_api_calls_total", "Database API calls by method", labels );
+      result.latency = &_metrics->histogram( "graphene_api_call_seconds", "Time spent in database API calls by method",
+                                             graphene::utilities::metrics_registry::latency_buckets(), labels );
+   }
+   return result;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -223,12 +478,78 @@ database_api_impl::~database_api_impl()
 
 fc::variants database_api::get_objects(const vector<object_id_type>& ids)const
 {
-   return my->get_objects( ids );
+   return my->read( "get_objects", [&]() { return my->get_objects( ids ); } );
 }
 
 fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)const
 {
-   if( _subscribe_callback )  {
+   subscribe_to_objects( ids );
+
+   fc::variants result;
+   result.reserve(ids.size());
+
+   std::transform(ids.begin(), ids.end(), std::back_inserter(result),
+                  [this](object_id_type id) -> fc::variant {
+      if(auto obj = _db.find_object(id))
+         return _cache->to_variant( *obj );
+      return {};
+   });
+
+   return result;
+}
+
+void database_api::get_objects_json( const vector<object_id_type>& ids, std::string& out )const
+{
+   my->read( "get_objects", [&]() {
+      my->subscribe_to_objects( ids );
+      out += '[';
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         if( i > 0 )
+            out += ',';
+         if( const object* obj = my->_db.find_object( ids[i] ) )
+            obj->to_json( out );
+         else
+            out += "null";
+      }
+      out += ']';
+   } );
+}
+
+vector<optional<vector<char>>> database_api::get_packed_objects(const vector<object_id_type>& ids)const
+{
+   return my->read( "get_packed_objects", [&]() { return my->get_packed_objects( ids ); } );
+}
+
+vector<optional<vector<char>>> database_api_impl::get_packed_objects(const vector<object_id_type>& ids)const
+{
+   subscribe_to_objects( ids );
+
+   vector<optional<vector<char>>> result;
+   result.reserve(ids.size());
+   for( auto id : ids )
+   {
+      if( auto obj = _db.find_object(id) )
+         result.emplace_back( obj->pack() );
+      else
+         result.emplace_back();
+   }
+   return result;
+}
+
+object_cache_statistics database_api::get_object_cache_statistics()const
+{
+   return my->get_object_cache_statistics();
+}
+
+object_cache_statistics database_api_impl::get_object_cache_statistics()const
+{
+   return _cache->get_statistics();
+}
+
+void database_api_impl::subscribe_to_objects( const vector<object_id_type>& ids )const
+{
+   if( _subscribing )  {
       for( auto id : ids )
       {
          if( id.type() == operation_history_object_type && id.space() == protocol_ids ) continue;
@@ -241,18 +562,6 @@ fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)co
    {
       elog( "getObjects without subscribe callback??" );
    }
-
-   fc::variants result;
-   result.reserve(ids.size());
-
-   std::transform(ids.begin(), ids.end(), std::back_inserter(result),
-                  [this](object_id_type id) -> fc::variant {
-      if(auto obj = _db.find_object(id))
-         return obj->to_variant();
-      return {};
-   });
-
-   return result;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -270,15 +579,29 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 {
    edump((clear_filter));
    _subscribe_callback = cb;
+   _subscribing = bool(cb);
    if( clear_filter || !cb )
-   {
-      static fc::bloom_parameters param;
-      param.projected_element_count    = 10000;
-      param.false_positive_probability = 1.0/10000;
-      param.maximum_size = 1024*8*8*2;
-      param.compute_optimal_parameters();
-      _subscribe_filter = fc::bloom_filter(param);
-   }
+      _hub->clear_subscriptions( _hub_session );
+}
+
+void database_api::set_subscription_filter( subscription_filter_type filter )
+{
+   my->set_subscription_filter( filter );
+}
+
+void database_api_impl::set_subscription_filter( subscription_filter_type filter )
+{
+   _hub->set_filter( _hub_session, filter );
+}
+
+uint64_t database_api::get_subscription_memory()const
+{
+   return my->get_subscription_memory();
+}
+
+uint64_t database_api_impl::get_subscription_memory()const
+{
+   return _hub->session_memory( _hub_session );
 }
 
 void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb )
@@ -289,6 +612,13 @@ void database_api::set_pending_transaction_callback( std::function<void(const va
 void database_api_impl::set_pending_transaction_callback( std::function<void(const variant&)> cb )
 {
    _pending_trx_callback = cb;
+   // the hub turns every pending transaction into a variant once for all connections following them
+   subscription_hub::transaction_callback_type forward;
+   if( cb )
+      forward = [this]( const variant& trx, uint64_t size ) {
+         if( _pending_trx_callback ) _send_queue->push( _pending_trx_callback, trx, size );
+      };
+   _hub->set_pending_transaction_callback( _hub_session, forward );
 }
 
 void database_api::set_block_applied_callback( std::function<void(const variant& block_id)> cb )
@@ -310,6 +640,22 @@ void database_api_impl::cancel_all_subscriptions()
 {
    set_subscribe_callback( std::function<void(const fc::variant&)>(), true);
    _market_subscriptions.clear();
+   _market_delta_subscriptions.clear();
+   _balance_subscription.reset();
+   cancel_block_stream();
+   _send_queue->clear();
+}
+
+void database_api_impl::on_send_queue_overflow()
+{
+   wlog( "ending the subscriptions of database api ${x}, which does not keep up with its notifications", ("x",int64_t(this)) );
+   // the queue overflows while the hub or the chain database notify, so the subscriptions end once they are done
+   auto capture_this = shared_from_this();
+   fc::async([this,capture_this](){
+      cancel_all_subscriptions();
+      set_pending_transaction_callback( std::function<void(const fc::variant&)>() );
+      _block_applied_callback = std::function<void(const fc::variant&)>();
+   });
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -336,11 +682,188 @@ optional<signed_block> database_api::get_block(uint32_t block_num)const
    return my->get_block( block_num );
 }
 
+void database_api::run_batch( bool heavy, const std::function<void()>& batch )
+{
+   if( !my->_readers )
+      return batch();
+   my->_readers->run_batch( my->_reader_client, heavy ? api_reader_pool::heavy_call : api_reader_pool::light_call, batch );
+}
+
+bool database_api::read_call( const std::string& method )
+{
+   // the methods that go through database_api_impl::read()
+   static const std::set<std::string> reads = {
+      "get_objects", "get_packed_objects", "get_key_references", "get_full_key_references", "get_accounts",
+      "get_full_accounts", "get_full_accounts_paged", "get_account_references", "lookup_account_names",
+      "lookup_accounts", "get_account_balances", "get_account_balances_page", "get_balances_for_accounts",
+      "get_named_account_balances", "get_balance_objects", "get_vested_balances", "get_vesting_balances",
+      "get_assets", "list_assets", "lookup_asset_symbols", "get_asset_holders_page", "get_asset_holders_count",
+      "get_order_book", "get_order_books", "get_limit_orders", "get_call_orders", "get_settle_orders",
+      "get_limit_orders_page", "get_call_orders_page", "get_settle_orders_page", "get_margin_positions",
+      "get_witnesses", "lookup_witness_accounts", "get_witnesses_by_votes", "get_committee_members",
+      "lookup_committee_member_accounts", "get_committee_members_by_votes", "lookup_vote_ids",
+      "get_required_signatures", "get_potential_signatures", "get_potential_address_signatures",
+      "simulate_transactions", "get_proposed_transactions"
+   };
+   return reads.count( method ) != 0;
+}
+
+void database_api::get_block_json( uint32_t block_num, std::string& out )const
+{
+   graphene::db::json_encoder( out ).write( my->get_block( block_num ) );
+}
+
 optional<signed_block> database_api_impl::get_block(uint32_t block_num)const
 {
    return _db.fetch_block_by_number(block_num);
 }
 
+vector<optional<vector<char>>> database_api::get_packed_blocks(uint32_t first_block_num, uint32_t count)const
+{
+   return my->get_packed_blocks( first_block_num, count );
+}
+
+vector<optional<vector<char>>> database_api_impl::get_packed_blocks(uint32_t first_block_num, uint32_t count)const
+{
+   FC_ASSERT( count <= 100 );
+   vector<optional<vector<char>>> result;
+   result.reserve(count);
+   for( uint32_t i = 0; i < count; ++i )
+      result.emplace_back( _db.fetch_packed_block_by_number( first_block_num + i ) );
+   return result;
+}
+
+vector<vector<char>> database_api::get_packed_state_diffs(uint32_t first_block_num, uint32_t count)const
+{
+   return my->get_packed_state_diffs( first_block_num, count );
+}
+
+vector<vector<char>> database_api_impl::get_packed_state_diffs(uint32_t first_block_num, uint32_t count)const
+{
+   FC_ASSERT( count <= 100 );
+   const auto diffs = _db.get_state_diffs( first_block_num, count );
+   vector<vector<char>> result;
+   result.reserve( diffs.size() );
+   for( const auto& diff : diffs )
+      result.emplace_back( fc::raw::pack( diff ) );
+   return result;
+}
+
+optional<block_state_hash> database_api::get_state_hash(uint32_t block_num)const
+{
+   return my->get_state_hash( block_num );
+}
+
+optional<block_state_hash> database_api_impl::get_state_hash(uint32_t block_num)const
+{
+   return _db.get_block_state_hash( block_num );
+}
+
+void database_api::stream_blocks( std::function<void(const variant&)> callback, uint32_t start_block_num,
+                                  uint32_t end_block_num, bool include_applied_ops )
+{
+   my->stream_blocks( callback, start_block_num, end_block_num, include_applied_ops );
+}
+
+void database_api_impl::stream_blocks( std::function<void(const variant&)> callback, uint32_t start_block_num,
+                                       uint32_t end_block_num, bool include_applied_ops )
+{
+   FC_ASSERT( callback );
+   FC_ASSERT( end_block_num == 0 || end_block_num >= start_block_num );
+   block_stream stream;
+   stream.callback            = callback;
+   stream.next_block          = std::max<uint32_t>( start_block_num, 1 );
+   stream.end_block           = end_block_num;
+   stream.acknowledged        = stream.next_block - 1;
+   stream.include_applied_ops = include_applied_ops;
+   _block_stream = stream;
+   send_stored_blocks();
+}
+
+void database_api::acknowledge_streamed_blocks( uint32_t block_num )
+{
+   my->acknowledge_streamed_blocks( block_num );
+}
+
+void database_api_impl::acknowledge_streamed_blocks( uint32_t block_num )
+{
+   if( !_block_stream )
+      return;
+   _block_stream->acknowledged = std::max( _block_stream->acknowledged, block_num );
+   if( !_block_stream->live )
+      send_stored_blocks();
+}
+
+void database_api::cancel_block_stream()
+{
+   my->cancel_block_stream();
+}
+
+void database_api_impl::cancel_block_stream()
+{
+   _block_stream.reset();
+}
+
+void database_api_impl::send_stored_blocks()
+{
+   // a running task picks up a new stream or acknowledgement with its next batch
+   if( _sending_stored_blocks )
+      return;
+   _sending_stored_blocks = true;
+
+   /// we need to ensure the database_api is not deleted for the life of the async operation
+   auto capture_this = shared_from_this();
+   fc::async([this,capture_this](){
+      try
+      {
+         while( _block_stream && !_block_stream->live )
+         {
+            block_stream& stream = *_block_stream;
+            uint32_t last = _db.head_block_num();
+            if( stream.end_block )
+               last = std::min( last, stream.end_block );
+            if( stream.next_block > last )
+            {
+               if( stream.end_block && stream.next_block > stream.end_block )
+                  _block_stream.reset();
+               else
+                  stream.live = true;
+               break;
+            }
+            last = std::min( last, stream.acknowledged + block_stream_window );
+            if( stream.next_block > last )
+               break;
+            last = std::min( last, stream.next_block + block_stream_batch - 1 );
+
+            vector<streamed_block> batch;
+            batch.reserve( last - stream.next_block + 1 );
+            for( uint32_t block_num = stream.next_block; block_num <= last; ++block_num )
+            {
+               auto block = _db.fetch_block_by_number( block_num );
+               if( !block )
+                  continue;
+               batch.emplace_back();
+               batch.back().block_num = block_num;
+               batch.back().block     = std::move( *block );
+            }
+            stream.next_block = last + 1;
+
+            // sending may yield, during which the stream can be replaced
+            auto callback = stream.callback;
+            if( batch.size() )
+               callback( fc::variant( batch ) );
+            fc::yield();
+         }
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "block stream failed: ${e}", ("e",e.to_detail_string()) );
+         _block_stream.reset();
+      }
+      _sending_stored_blocks = false;
+   });
+}
+
 processed_transaction database_api::get_transaction( uint32_t block_num, uint32_t trx_in_block )const
 {
    return my->get_transaction( block_num, trx_in_block );
@@ -427,7 +950,7 @@ dynamic_global_property_object database_api_impl::get_dynamic_global_properties(
 
 vector<vector<account_id_type>> database_api::get_key_references( vector<public_key_type> key )const
 {
-   return my->get_key_references( key );
+   return my->read( "get_key_references", [&]() { return my->get_key_references( key ); } );
 }
 
 /**
@@ -435,58 +958,70 @@ vector<vector<account_id_type>> database_api::get_key_references( vector<public_
  */
 vector<vector<account_id_type>> database_api_impl::get_key_references( vector<public_key_type> keys )const
 {
-   wdump( (keys) );
    vector< vector<account_id_type> > final_result;
    final_result.reserve(keys.size());
 
    for( auto& key : keys )
+      final_result.emplace_back( key_accounts( key ) );
+
+   for( const auto& accounts : final_result )
+      for( account_id_type account : accounts )
+         subscribe_to_item( account );
+
+   return final_result;
+}
+
+vector<account_id_type> database_api_impl::key_accounts( const public_key_type& key )const
+{
+   const auto& refs = get_api_index<account_member_index, account_index>();
+   vector<account_id_type> result;
+
+   for( const address& a : addresses_of( key ) )
+   {
+      auto itr = refs.account_to_address_memberships.find(a);
+      if( itr != refs.account_to_address_memberships.end() )
+         result.insert( result.end(), itr->second.begin(), itr->second.end() );
+   }
+
+   auto itr = refs.account_to_key_memberships.find(key);
+   if( itr != refs.account_to_key_memberships.end() )
+      result.insert( result.end(), itr->second.begin(), itr->second.end() );
+   return result;
+}
+
+vector<key_references> database_api::get_full_key_references( const vector<public_key_type>& keys )const
+{
+   return my->read( "get_full_key_references", [&]() { return my->get_full_key_references( keys ); } );
+}
+
+vector<key_references> database_api_impl::get_full_key_references( const vector<public_key_type>& keys )const
+{
+   const auto& balances_by_owner = _db.get_index_type<balance_index>().indices().get<by_owner>();
+   const auto& vesting_by_account = _db.get_index_type<vesting_balance_index>().indices().get<by_account>();
+
+   vector<key_references> result;
+   result.reserve( keys.size() );
+   for( const auto& key : keys )
    {
+      key_references refs;
+      refs.accounts = key_accounts( key );
+      std::sort( refs.accounts.begin(), refs.accounts.end() );
+      refs.accounts.erase( std::unique( refs.accounts.begin(), refs.accounts.end() ), refs.accounts.end() );
 
-      address a1( pts_address(key, false, 56) );
-      address a2( pts_address(key, true, 56) );
-      address a3( pts_address(key, false, 0)  );
-      address a4( pts_address(key, true, 0)  );
-      address a5( key );
-
-      subscribe_to_item( key );
-      subscribe_to_item( a1 );
-      subscribe_to_item( a2 );
-      subscribe_to_item( a3 );
-      subscribe_to_item( a4 );
-      subscribe_to_item( a5 );
-
-      const auto& idx = _db.get_index_type<account_index>();
-      const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
-      const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
-      auto itr = refs.account_to_key_memberships.find(key);
-      vector<account_id_type> result;
-
-      for( auto& a : {a1,a2,a3,a4,a5} )
+      for( const address& a : addresses_of( key ) )
       {
-          auto itr = refs.account_to_address_memberships.find(a);
-          if( itr != refs.account_to_address_memberships.end() )
-          {
-             result.reserve( itr->second.size() );
-             for( auto item : itr->second )
-             {
-                wdump((a)(item)(item(_db).name));
-                result.push_back(item);
-             }
-          }
+         auto range = balances_by_owner.equal_range( boost::make_tuple( a ) );
+         refs.balances.insert( refs.balances.end(), range.first, range.second );
       }
-
-      if( itr != refs.account_to_key_memberships.end() )
+      for( account_id_type account : refs.accounts )
       {
-         result.reserve( itr->second.size() );
-         for( auto item : itr->second ) result.push_back(item);
+         auto range = vesting_by_account.equal_range( account );
+         refs.vesting_balances.insert( refs.vesting_balances.end(), range.first, range.second );
+         subscribe_to_item( account );
       }
-      final_result.emplace_back( std::move(result) );
+      result.emplace_back( std::move( refs ) );
    }
-
-   for( auto i : final_result )
-      subscribe_to_item(i);
-
-   return final_result;
+   return result;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -497,7 +1032,7 @@ vector<vector<account_id_type>> database_api_impl::get_key_references( vector<pu
 
 vector<optional<account_object>> database_api::get_accounts(const vector<account_id_type>& account_ids)const
 {
-   return my->get_accounts( account_ids );
+   return my->read( "get_accounts", [&]() { return my->get_accounts( account_ids ); } );
 }
 
 vector<optional<account_object>> database_api_impl::get_accounts(const vector<account_id_type>& account_ids)const
@@ -517,96 +1052,306 @@ vector<optional<account_object>> database_api_impl::get_accounts(const vector<ac
 
 std::map<string,full_account> database_api::get_full_accounts( const vector<string>& names_or_ids, bool subscribe )
 {
-   return my->get_full_accounts( names_or_ids, subscribe );
+   return my->read( "get_full_accounts", [&]() { return my->get_full_accounts( names_or_ids, subscribe ); } );
 }
 
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids, bool subscribe)
 {
    idump((names_or_ids));
    std::map<std::string, full_account> results;
+   const uint32_t max_objects = database_api::max_full_account_objects();
+   uint64_t objects = 0;
 
    for (const std::string& account_name_or_id : names_or_ids)
    {
-      const account_object* account = nullptr;
-      if (std::isdigit(account_name_or_id[0]))
-         account = _db.find(fc::variant(account_name_or_id).as<account_id_type>());
-      else
-      {
-         const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
-         auto itr = idx.find(account_name_or_id);
-         if (itr != idx.end())
-            account = &*itr;
-      }
+      const account_object* account = find_full_account( account_name_or_id );
       if (account == nullptr)
          continue;
 
+      if( max_objects )
+      {
+         objects += count_full_account( *account ).total();
+         FC_ASSERT( objects <= max_objects, "The accounts hold more than ${max} objects, read them with get_full_accounts_paged",
+                    ("max",max_objects) );
+      }
+
       if( subscribe )
       {
          ilog( "subscribe to ${id}", ("id",account->name) );
          subscribe_to_item( account->id );
       }
 
-      // fc::mutable_variant_object full_account;
-      full_account acnt;
-      acnt.account = *account;
-      acnt.statistics = account->statistics(_db);
-      acnt.registrar_name = account->registrar(_db).name;
-      acnt.referrer_name = account->referrer(_db).name;
-      acnt.lifetime_referrer_name = account->lifetime_referrer(_db).name;
+      // the votes of an account change with the objects voted for, so they are looked up every time
+      full_account acnt = _cache->get_full_account( *account, [&]() { return make_full_account( account ); } );
       acnt.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
+      results[account_name_or_id] = std::move( acnt );
+   }
+   return results;
+}
+
+void database_api::get_full_accounts_json( const vector<string>& names_or_ids, bool subscribe, std::string& out )
+{
+   graphene::db::json_encoder( out ).write( get_full_accounts( names_or_ids, subscribe ) );
+}
+
+std::map<string,full_account_page> database_api::get_full_accounts_paged( const vector<string>& names_or_ids,
+                                                                          const full_account_query& query, bool subscribe )
+{
+   return my->read( "get_full_accounts_paged", [&]() { return my->get_full_accounts_paged( names_or_ids, query, subscribe ); } );
+}
+
+std::map<string,full_account_page> database_api_impl::get_full_accounts_paged( const vector<string>& names_or_ids,
+                                                                               const full_account_query& query, bool subscribe )
+{
+   FC_ASSERT( query.limit <= 1000 );
+   std::map<string,full_account_page> results;
+   const uint32_t max_objects = database_api::max_full_account_objects();
+   uint32_t budget = max_objects ? max_objects : std::numeric_limits<uint32_t>::max();
 
-      // Add the account itself, its statistics object, cashback balance, and referral account names
-      /*
-      full_account("account", *account)("statistics", account->statistics(_db))
-            ("registrar_name", account->registrar(_db).name)("referrer_name", account->referrer(_db).name)
-            ("lifetime_referrer_name", account->lifetime_referrer(_db).name);
-            */
-      if (account->cashback_vb)
+   for( const string& account_name_or_id : names_or_ids )
+   {
+      const account_object* account = find_full_account( account_name_or_id );
+      if( account == nullptr )
+         continue;
+
+      if( subscribe )
+         subscribe_to_item( account->id );
+
+      full_account_page page;
+      if( query.summary )
       {
-         acnt.cashback_balance = account->cashback_balance(_db);
+         page.account = make_account_header( *account );
+         page.counts = count_full_account( *account );
       }
-      // Add the account's proposals
-      const auto& proposal_idx = _db.get_index_type<proposal_index>();
-      const auto& pidx = dynamic_cast<const primary_index<proposal_index>&>(proposal_idx);
-      const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
-      auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account->id );
+      else
+      {
+         optional<full_account_cursor> start;
+         auto itr = query.start.find( account_name_or_id );
+         if( itr != query.start.end() )
+            start = itr->second;
+         page = make_full_account_page( *account, start, query.limit, budget );
+      }
+      page.account.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
+      results[account_name_or_id] = std::move( page );
+   }
+   return results;
+}
+
+const account_object* database_api_impl::find_full_account( const string& name_or_id )const
+{
+   if( name_or_id.empty() )
+      return nullptr;
+   if( std::isdigit(name_or_id[0]) )
+      return _db.find( fc::variant(name_or_id).as<account_id_type>() );
+   const auto& idx = _db.get_index_type<account_index>().indices().get<by_name>();
+   auto itr = idx.find( name_or_id );
+   return itr != idx.end() ? &*itr : nullptr;
+}
+
+full_account database_api_impl::make_account_header( const account_object& account )const
+{
+   full_account acnt;
+   acnt.account = account;
+   acnt.statistics = account.statistics(_db);
+   acnt.registrar_name = account.registrar(_db).name;
+   acnt.referrer_name = account.referrer(_db).name;
+   acnt.lifetime_referrer_name = account.lifetime_referrer(_db).name;
+   if( account.cashback_vb )
+      acnt.cashback_balance = account.cashback_balance(_db);
+   return acnt;
+}
+
+full_account_counts database_api_impl::count_full_account( const account_object& account )const
+{
+   full_account_counts counts;
+   const auto& proposals_by_account = get_api_index<required_approval_index, proposal_index>();
+   auto required_approvals_itr = proposals_by_account._account_to_proposals.find( account.id );
+   if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+      counts.proposals = required_approvals_itr->second.size();
+
+   auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range( boost::make_tuple(account.id) );
+   counts.balances = std::distance( balance_range.first, balance_range.second );
+   auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range( account.id );
+   counts.vesting_balances = std::distance( vesting_range.first, vesting_range.second );
+   auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range( account.id );
+   counts.limit_orders = std::distance( order_range.first, order_range.second );
+   auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range( account.id );
+   counts.call_orders = std::distance( call_range.first, call_range.second );
+   return counts;
+}
+
+namespace {
+
+/** copies the objects of [itr,end) to @ref out until it holds @ref limit, and returns where it stopped */
+template<typename Iterator, typename Object>
+Iterator take_page( Iterator itr, Iterator end, vector<Object>& out, uint32_t limit )
+{
+   for( ; itr != end && out.size() < limit; ++itr )
+      out.push_back( *itr );
+   return itr;
+}
+
+/** the cursor of an api_page, the hex of the packed key fields of the next object in its index */
+template<typename... Fields>
+string encode_cursor( const Fields&... fields )
+{
+   const vector<char> packed[] = { fc::raw::pack( fields )... };
+   vector<char> data;
+   for( const auto& field : packed )
+      data.insert( data.end(), field.begin(), field.end() );
+   return fc::to_hex( data.data(), data.size() );
+}
+
+/** reads the fields of a cursor of encode_cursor back, false for the empty cursor of the first page */
+template<typename... Fields>
+bool decode_cursor( const string& cursor, Fields&... fields )
+{
+   if( cursor.empty() )
+      return false;
+   vector<char> data( cursor.size() / 2 );
+   FC_ASSERT( cursor.size() % 2 == 0 && fc::from_hex( cursor, data.data(), data.size() ) == data.size(),
+              "Invalid cursor ${c}", ("c",cursor) );
+   fc::datastream<const char*> ds( data.data(), data.size() );
+   const int unpacked[] = { ( fc::raw::unpack( ds, fields ), 0 )... };
+   (void)unpacked;
+   FC_ASSERT( ds.remaining() == 0, "Invalid cursor ${c}", ("c",cursor) );
+   return true;
+}
+
+/** copies [itr,end) to @ref page until it holds @ref limit objects, and gives it the cursor of the next one */
+template<typename Iterator, typename Object, typename MakeCursor>
+void fill_page( Iterator itr, Iterator end, uint32_t limit, api_page<Object>& page, MakeCursor make_cursor )
+{
+   itr = take_page( itr, end, page.items, limit );
+   if( itr != end )
+      page.next = make_cursor( *itr );
+}
+
+}
+
+full_account_page database_api_impl::make_full_account_page( const account_object& account,
+                                                             const optional<full_account_cursor>& start,
+                                                             uint32_t limit, uint32_t& budget )const
+{
+   full_account_page page;
+   page.account = make_account_header( account );
+   page.counts = count_full_account( account );
+   // a continued account returns the sections its cursor names only
+   const bool all = !start.valid();
+   const full_account_cursor from = all ? full_account_cursor() : *start;
+
+   if( all || from.proposals.valid() )
+   {
+      const auto& proposals_by_account = get_api_index<required_approval_index, proposal_index>();
+      auto required_approvals_itr = proposals_by_account._account_to_proposals.find( account.id );
       if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
       {
-         acnt.proposals.reserve( required_approvals_itr->second.size() );
-         for( auto proposal_id : required_approvals_itr->second )
-            acnt.proposals.push_back( proposal_id(_db) );
+         const auto& ids = required_approvals_itr->second;
+         auto itr = from.proposals.valid() ? ids.lower_bound( *from.proposals ) : ids.begin();
+         for( ; itr != ids.end() && page.account.proposals.size() < std::min( limit, budget ); ++itr )
+            page.account.proposals.push_back( (*itr)(_db) );
+         budget -= page.account.proposals.size();
+         if( itr != ids.end() )
+            page.next_page.proposals = *itr;
       }
+   }
 
+   if( all || from.balances.valid() )
+   {
+      const auto& idx = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      auto itr = idx.lower_bound( boost::make_tuple( account.id, from.balances.valid() ? *from.balances : asset_id_type() ) );
+      auto end = idx.upper_bound( boost::make_tuple( account.id ) );
+      itr = take_page( itr, end, page.account.balances, std::min( limit, budget ) );
+      budget -= page.account.balances.size();
+      if( itr != end )
+         page.next_page.balances = itr->asset_type;
+   }
 
-      // Add the account's balances
-      auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range(boost::make_tuple(account->id));
-      //vector<account_balance_object> balances;
-      std::for_each(balance_range.first, balance_range.second,
-                    [&acnt](const account_balance_object& balance) {
-                       acnt.balances.emplace_back(balance);
-                    });
+   if( all || from.vesting_balances.valid() )
+   {
+      // the vesting balances of an account are ordered by owner alone, so they are sorted by ID to page them
+      vector<const vesting_balance_object*> vesting;
+      auto range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range( account.id );
+      for( ; range.first != range.second; ++range.first )
+         if( !from.vesting_balances.valid() || !(range.first->id < object_id_type(*from.vesting_balances)) )
+            vesting.push_back( &*range.first );
+      std::sort( vesting.begin(), vesting.end(),
+                 []( const vesting_balance_object* a, const vesting_balance_object* b ) { return a->id < b->id; } );
+      auto itr = vesting.begin();
+      for( ; itr != vesting.end() && page.account.vesting_balances.size() < std::min( limit, budget ); ++itr )
+         page.account.vesting_balances.push_back( **itr );
+      budget -= page.account.vesting_balances.size();
+      if( itr != vesting.end() )
+         page.next_page.vesting_balances = vesting_balance_id_type( (*itr)->id );
+   }
 
-      // Add the account's vesting balances
-      auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(vesting_range.first, vesting_range.second,
-                    [&acnt](const vesting_balance_object& balance) {
-                       acnt.vesting_balances.emplace_back(balance);
-                    });
+   if( all || from.limit_orders.valid() )
+   {
+      const auto& idx = _db.get_index_type<limit_order_index>().indices().get<by_account>();
+      auto itr = idx.lower_bound( boost::make_tuple( account.id,
+                                  from.limit_orders.valid() ? object_id_type(*from.limit_orders) : object_id_type() ) );
+      auto end = idx.upper_bound( boost::make_tuple( account.id ) );
+      itr = take_page( itr, end, page.account.limit_orders, std::min( limit, budget ) );
+      budget -= page.account.limit_orders.size();
+      if( itr != end )
+         page.next_page.limit_orders = limit_order_id_type( itr->id );
+   }
 
-      // Add the account's orders
-      auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(order_range.first, order_range.second,
-                    [&acnt] (const limit_order_object& order) {
-                       acnt.limit_orders.emplace_back(order);
-                    });
-      auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(call_range.first, call_range.second,
-                    [&acnt] (const call_order_object& call) {
-                       acnt.call_orders.emplace_back(call);
-                    });
-      results[account_name_or_id] = acnt;
+   if( all || from.call_orders.valid() )
+   {
+      const auto& idx = _db.get_index_type<call_order_index>().indices().get<by_account>();
+      auto itr = idx.lower_bound( boost::make_tuple( account.id, from.call_orders.valid() ? *from.call_orders : asset_id_type() ) );
+      auto end = idx.upper_bound( boost::make_tuple( account.id ) );
+      itr = take_page( itr, end, page.account.call_orders, std::min( limit, budget ) );
+      budget -= page.account.call_orders.size();
+      if( itr != end )
+         page.next_page.call_orders = itr->debt_type();
    }
-   return results;
+   return page;
+}
+
+full_account database_api_impl::make_full_account( const account_object* account )const
+{
+   full_account acnt = make_account_header( *account );
+
+   // Add the account's proposals
+   const auto& proposals_by_account = get_api_index<required_approval_index, proposal_index>();
+   auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account->id );
+   if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+   {
+      acnt.proposals.reserve( required_approvals_itr->second.size() );
+      for( auto proposal_id : required_approvals_itr->second )
+         acnt.proposals.push_back( proposal_id(_db) );
+   }
+
+
+   // Add the account's balances
+   auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range(boost::make_tuple(account->id));
+   //vector<account_balance_object> balances;
+   std::for_each(balance_range.first, balance_range.second,
+                 [&acnt](const account_balance_object& balance) {
+                    acnt.balances.emplace_back(balance);
+                 });
+
+   // Add the account's vesting balances
+   auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account->id);
+   std::for_each(vesting_range.first, vesting_range.second,
+                 [&acnt](const vesting_balance_object& balance) {
+                    acnt.vesting_balances.emplace_back(balance);
+                 });
+
+   // Add the account's orders
+   auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account->id);
+   std::for_each(order_range.first, order_range.second,
+                 [&acnt] (const limit_order_object& order) {
+                    acnt.limit_orders.emplace_back(order);
+                 });
+   auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account->id);
+   std::for_each(call_range.first, call_range.second,
+                 [&acnt] (const call_order_object& call) {
+                    acnt.call_orders.emplace_back(call);
+                 });
+   return acnt;
 }
 
 optional<account_object> database_api::get_account_by_name( string name )const
@@ -625,14 +1370,12 @@ optional<account_object> database_api_impl::get_account_by_name( string name )co
 
 vector<account_id_type> database_api::get_account_references( account_id_type account_id )const
 {
-   return my->get_account_references( account_id );
+   return my->read( "get_account_references", [&]() { return my->get_account_references( account_id ); } );
 }
 
 vector<account_id_type> database_api_impl::get_account_references( account_id_type account_id )const
 {
-   const auto& idx = _db.get_index_type<account_index>();
-   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
-   const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
+   const auto& refs = get_api_index<account_member_index, account_index>();
    auto itr = refs.account_to_account_memberships.find(account_id);
    vector<account_id_type> result;
 
@@ -646,7 +1389,7 @@ vector<account_id_type> database_api_impl::get_account_references( account_id_ty
 
 vector<optional<account_object>> database_api::lookup_account_names(const vector<string>& account_names)const
 {
-   return my->lookup_account_names( account_names );
+   return my->read( "lookup_account_names", [&]() { return my->lookup_account_names( account_names ); } );
 }
 
 vector<optional<account_object>> database_api_impl::lookup_account_names(const vector<string>& account_names)const
@@ -664,7 +1407,7 @@ vector<optional<account_object>> database_api_impl::lookup_account_names(const v
 
 map<string,account_id_type> database_api::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->lookup_accounts( lower_bound_name, limit );
+   return my->read( "lookup_accounts", [&]() { return my->lookup_accounts( lower_bound_name, limit ); } );
 }
 
 map<string,account_id_type> database_api_impl::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
@@ -677,7 +1420,7 @@ map<string,account_id_type> database_api_impl::lookup_accounts(const string& low
         limit-- && itr != accounts_by_name.end();
         ++itr )
    {
-      result.insert(make_pair(itr->name, itr->get_id()));
+      result.emplace_hint(result.end(), itr->name, itr->get_id());
       if( limit == 1 )
          subscribe_to_item( itr->get_id() );
    }
@@ -703,7 +1446,7 @@ uint64_t database_api_impl::get_account_count()const
 
 vector<asset> database_api::get_account_balances(account_id_type id, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_account_balances( id, assets );
+   return my->read( "get_account_balances", [&]() { return my->get_account_balances( id, assets ); } );
 }
 
 vector<asset> database_api_impl::get_account_balances(account_id_type acnt, const flat_set<asset_id_type>& assets)const
@@ -728,9 +1471,31 @@ vector<asset> database_api_impl::get_account_balances(account_id_type acnt, cons
    return result;
 }
 
+api_page<asset> database_api::get_account_balances_page( account_id_type id, uint32_t limit, const string& cursor )const
+{
+   return my->read( "get_account_balances_page", [&]() { return my->get_account_balances_page( id, limit, cursor ); } );
+}
+
+api_page<asset> database_api_impl::get_account_balances_page( account_id_type acnt, uint32_t limit, const string& cursor )const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& idx = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+   asset_id_type from;
+   decode_cursor( cursor, from );
+   auto itr = idx.lower_bound( boost::make_tuple( acnt, from ) );
+   auto end = idx.upper_bound( boost::make_tuple( acnt ) );
+
+   api_page<asset> page;
+   for( ; itr != end && page.items.size() < limit; ++itr )
+      page.items.push_back( itr->get_balance() );
+   if( itr != end )
+      page.next = encode_cursor( itr->asset_type );
+   return page;
+}
+
 vector<asset> database_api::get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_named_account_balances( name, assets );
+   return my->read( "get_named_account_balances", [&]() { return my->get_named_account_balances( name, assets ); } );
 }
 
 vector<asset> database_api_impl::get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets) const
@@ -741,9 +1506,79 @@ vector<asset> database_api_impl::get_named_account_balances(const std::string& n
    return get_account_balances(itr->get_id(), assets);
 }
 
+vector<account_balances> database_api::get_balances_for_accounts( const vector<account_id_type>& accounts,
+                                                                   const flat_set<asset_id_type>& assets )const
+{
+   return my->read( "get_balances_for_accounts", [&]() { return my->get_balances_for_accounts( accounts, assets ); } );
+}
+
+vector<account_balances> database_api_impl::get_balances_for_accounts( const vector<account_id_type>& accounts,
+                                                                       const flat_set<asset_id_type>& assets )const
+{
+   FC_ASSERT( accounts.size() <= 100000 );
+   const auto& idx = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+
+   vector<account_balances> result;
+   result.reserve( accounts.size() );
+   for( const account_id_type& acnt : accounts )
+   {
+      result.emplace_back();
+      result.back().account = acnt;
+      vector<asset>& balances = result.back().balances;
+      if( assets.empty() )
+      {
+         auto range = idx.equal_range( boost::make_tuple( acnt ) );
+         for( const account_balance_object& balance : boost::make_iterator_range( range.first, range.second ) )
+            balances.push_back( balance.get_balance() );
+      }
+      else
+      {
+         // both are in asset order, so the balances of the account are walked once
+         balances.reserve( assets.size() );
+         auto itr = idx.lower_bound( boost::make_tuple( acnt ) );
+         const auto end = idx.upper_bound( boost::make_tuple( acnt ) );
+         for( const asset_id_type& id : assets )
+         {
+            while( itr != end && itr->asset_type < id )
+               ++itr;
+            balances.emplace_back( itr != end && itr->asset_type == id ? itr->balance : share_type( 0 ), id );
+         }
+      }
+   }
+   return result;
+}
+
+void database_api::subscribe_to_balances( std::function<void(const variant&)> callback,
+                                          const vector<account_id_type>& accounts, const flat_set<asset_id_type>& assets )
+{
+   my->subscribe_to_balances( callback, accounts, assets );
+}
+
+void database_api_impl::subscribe_to_balances( std::function<void(const variant&)> callback,
+                                               const vector<account_id_type>& accounts,
+                                               const flat_set<asset_id_type>& assets )
+{
+   FC_ASSERT( accounts.size() <= 100000 );
+   balance_subscription sub;
+   sub.callback = callback;
+   sub.accounts = flat_set<account_id_type>( accounts.begin(), accounts.end() );
+   sub.assets = assets;
+   _balance_subscription = std::move( sub );
+}
+
+void database_api::unsubscribe_from_balances()
+{
+   my->unsubscribe_from_balances();
+}
+
+void database_api_impl::unsubscribe_from_balances()
+{
+   _balance_subscription.reset();
+}
+
 vector<balance_object> database_api::get_balance_objects( const vector<address>& addrs )const
 {
-   return my->get_balance_objects( addrs );
+   return my->read( "get_balance_objects", [&]() { return my->get_balance_objects( addrs ); } );
 }
 
 vector<balance_object> database_api_impl::get_balance_objects( const vector<address>& addrs )const
@@ -772,7 +1607,7 @@ vector<balance_object> database_api_impl::get_balance_objects( const vector<addr
 
 vector<asset> database_api::get_vested_balances( const vector<balance_id_type>& objs )const
 {
-   return my->get_vested_balances( objs );
+   return my->read( "get_vested_balances", [&]() { return my->get_vested_balances( objs ); } );
 }
 
 vector<asset> database_api_impl::get_vested_balances( const vector<balance_id_type>& objs )const
@@ -790,7 +1625,7 @@ vector<asset> database_api_impl::get_vested_balances( const vector<balance_id_ty
 
 vector<vesting_balance_object> database_api::get_vesting_balances( account_id_type account_id )const
 {
-   return my->get_vesting_balances( account_id );
+   return my->read( "get_vesting_balances", [&]() { return my->get_vesting_balances( account_id ); } );
 }
 
 vector<vesting_balance_object> database_api_impl::get_vesting_balances( account_id_type account_id )const
@@ -816,7 +1651,7 @@ vector<vesting_balance_object> database_api_impl::get_vesting_balances( account_
 
 vector<optional<asset_object>> database_api::get_assets(const vector<asset_id_type>& asset_ids)const
 {
-   return my->get_assets( asset_ids );
+   return my->read( "get_assets", [&]() { return my->get_assets( asset_ids ); } );
 }
 
 vector<optional<asset_object>> database_api_impl::get_assets(const vector<asset_id_type>& asset_ids)const
@@ -836,7 +1671,7 @@ vector<optional<asset_object>> database_api_impl::get_assets(const vector<asset_
 
 vector<asset_object> database_api::list_assets(const string& lower_bound_symbol, uint32_t limit)const
 {
-   return my->list_assets( lower_bound_symbol, limit );
+   return my->read( "list_assets", [&]() { return my->list_assets( lower_bound_symbol, limit ); } );
 }
 
 vector<asset_object> database_api_impl::list_assets(const string& lower_bound_symbol, uint32_t limit)const
@@ -859,7 +1694,7 @@ vector<asset_object> database_api_impl::list_assets(const string& lower_bound_sy
 
 vector<optional<asset_object>> database_api::lookup_asset_symbols(const vector<string>& symbols_or_ids)const
 {
-   return my->lookup_asset_symbols( symbols_or_ids );
+   return my->read( "lookup_asset_symbols", [&]() { return my->lookup_asset_symbols( symbols_or_ids ); } );
 }
 
 vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vector<string>& symbols_or_ids)const
@@ -880,6 +1715,43 @@ vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vec
    return result;
 }
 
+api_page<asset_holder> database_api::get_asset_holders_page( asset_id_type a, uint32_t limit, const string& cursor )const
+{
+   return my->read( "get_asset_holders_page", [&]() { return my->get_asset_holders_page( a, limit, cursor ); } );
+}
+
+api_page<asset_holder> database_api_impl::get_asset_holders_page( asset_id_type a, uint32_t limit, const string& cursor )const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& idx = _db.get_index_type<account_balance_index>().indices().get<by_asset_balance>();
+   auto itr = idx.lower_bound( boost::make_tuple( a ) );
+   share_type from_balance;
+   account_id_type from_owner;
+   if( decode_cursor( cursor, from_balance, from_owner ) )
+      itr = idx.lower_bound( boost::make_tuple( a, from_balance, from_owner ) );
+   // balances are sorted largest first, the empty ones of former holders come last
+   auto end = idx.lower_bound( boost::make_tuple( a, share_type(0) ) );
+
+   api_page<asset_holder> page;
+   for( ; itr != end && page.items.size() < limit; ++itr )
+      page.items.push_back( asset_holder{ itr->owner, itr->balance } );
+   if( itr != end )
+      page.next = encode_cursor( itr->balance, itr->owner );
+   return page;
+}
+
+asset_holder_statistics database_api::get_asset_holders_count( asset_id_type a )const
+{
+   return my->read( "get_asset_holders_count", [&]() { return my->get_asset_holders_count( a ); } );
+}
+
+asset_holder_statistics database_api_impl::get_asset_holders_count( asset_id_type a )const
+{
+   const auto& idx = dynamic_cast<const primary_index<account_balance_index>&>(
+         _db.get_index_type<account_balance_index>() );
+   return idx.get_secondary_index<asset_holders_index>().get_statistics( a );
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Markets / feeds                                                  //
@@ -888,7 +1760,7 @@ vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vec
 
 vector<limit_order_object> database_api::get_limit_orders(asset_id_type a, asset_id_type b, uint32_t limit)const
 {
-   return my->get_limit_orders( a, b, limit );
+   return my->read( "get_limit_orders", [&]() { return my->get_limit_orders( a, b, limit ); } );
 }
 
 /**
@@ -915,45 +1787,119 @@ vector<limit_order_object> database_api_impl::get_limit_orders(asset_id_type a,
    limit_end = limit_price_idx.upper_bound(price::min(b,a));
    while(limit_itr != limit_end && count < limit)
    {
-      result.push_back(*limit_itr);
-      ++limit_itr;
-      ++count;
+      result.push_back(*limit_itr);
+      ++limit_itr;
+      ++count;
+   }
+
+   return result;
+}
+
+vector<call_order_object> database_api::get_call_orders(asset_id_type a, uint32_t limit)const
+{
+   return my->read( "get_call_orders", [&]() { return my->get_call_orders( a, limit ); } );
+}
+
+vector<call_order_object> database_api_impl::get_call_orders(asset_id_type a, uint32_t limit)const
+{
+   const auto& call_index = _db.get_index_type<call_order_index>().indices().get<by_price>();
+   const asset_object& mia = _db.get(a);
+   price index_price = price::min(mia.bitasset_data(_db).options.short_backing_asset, mia.get_id());
+
+   return vector<call_order_object>(call_index.lower_bound(index_price.min()),
+                                    call_index.lower_bound(index_price.max()));
+}
+
+vector<force_settlement_object> database_api::get_settle_orders(asset_id_type a, uint32_t limit)const
+{
+   return my->read( "get_settle_orders", [&]() { return my->get_settle_orders( a, limit ); } );
+}
+
+vector<force_settlement_object> database_api_impl::get_settle_orders(asset_id_type a, uint32_t limit)const
+{
+   const auto& settle_index = _db.get_index_type<force_settlement_index>().indices().get<by_expiration>();
+   const asset_object& mia = _db.get(a);
+   return vector<force_settlement_object>(settle_index.lower_bound(mia.get_id()),
+                                          settle_index.upper_bound(mia.get_id()));
+}
+
+api_page<limit_order_object> database_api::get_limit_orders_page( asset_id_type sell, asset_id_type receive, uint32_t limit,
+                                                                  const string& cursor )const
+{
+   return my->read( "get_limit_orders_page", [&]() { return my->get_limit_orders_page( sell, receive, limit, cursor ); } );
+}
+
+api_page<limit_order_object> database_api_impl::get_limit_orders_page( asset_id_type sell, asset_id_type receive, uint32_t limit,
+                                                                       const string& cursor )const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& limit_price_idx = _db.get_index_type<limit_order_index>().indices().get<by_price>();
+   auto itr = limit_price_idx.lower_bound( price::max( sell, receive ) );
+   price from;
+   object_id_type from_id;
+   if( decode_cursor( cursor, from, from_id ) )
+   {
+      FC_ASSERT( from.base.asset_id == sell && from.quote.asset_id == receive, "The cursor is of another market" );
+      itr = limit_price_idx.lower_bound( boost::make_tuple( price_key( from ), from_id ) );
    }
 
-   return result;
+   api_page<limit_order_object> page;
+   fill_page( itr, limit_price_idx.upper_bound( price::min( sell, receive ) ), limit, page,
+              []( const limit_order_object& o ) { return encode_cursor( o.sell_price, o.id ); } );
+   return page;
 }
 
-vector<call_order_object> database_api::get_call_orders(asset_id_type a, uint32_t limit)const
+api_page<call_order_object> database_api::get_call_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const
 {
-   return my->get_call_orders( a, limit );
+   return my->read( "get_call_orders_page", [&]() { return my->get_call_orders_page( a, limit, cursor ); } );
 }
 
-vector<call_order_object> database_api_impl::get_call_orders(asset_id_type a, uint32_t limit)const
+api_page<call_order_object> database_api_impl::get_call_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const
 {
+   FC_ASSERT( limit <= 1000 );
    const auto& call_index = _db.get_index_type<call_order_index>().indices().get<by_price>();
    const asset_object& mia = _db.get(a);
    price index_price = price::min(mia.bitasset_data(_db).options.short_backing_asset, mia.get_id());
+   auto itr = call_index.lower_bound( index_price.min() );
+   price from;
+   object_id_type from_id;
+   if( decode_cursor( cursor, from, from_id ) )
+   {
+      FC_ASSERT( from.base.asset_id == index_price.base.asset_id && from.quote.asset_id == a, "The cursor is of another asset" );
+      itr = call_index.lower_bound( boost::make_tuple( price_key( from ), from_id ) );
+   }
 
-   return vector<call_order_object>(call_index.lower_bound(index_price.min()),
-                                    call_index.lower_bound(index_price.max()));
+   api_page<call_order_object> page;
+   fill_page( itr, call_index.lower_bound( index_price.max() ), limit, page,
+              []( const call_order_object& o ) { return encode_cursor( o.call_price, o.id ); } );
+   return page;
 }
 
-vector<force_settlement_object> database_api::get_settle_orders(asset_id_type a, uint32_t limit)const
+api_page<force_settlement_object> database_api::get_settle_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const
 {
-   return my->get_settle_orders( a, limit );
+   return my->read( "get_settle_orders_page", [&]() { return my->get_settle_orders_page( a, limit, cursor ); } );
 }
 
-vector<force_settlement_object> database_api_impl::get_settle_orders(asset_id_type a, uint32_t limit)const
+api_page<force_settlement_object> database_api_impl::get_settle_orders_page( asset_id_type a, uint32_t limit,
+                                                                             const string& cursor )const
 {
+   FC_ASSERT( limit <= 1000 );
    const auto& settle_index = _db.get_index_type<force_settlement_index>().indices().get<by_expiration>();
-   const asset_object& mia = _db.get(a);
-   return vector<force_settlement_object>(settle_index.lower_bound(mia.get_id()),
-                                          settle_index.upper_bound(mia.get_id()));
+   auto itr = settle_index.lower_bound( a );
+   fc::time_point_sec from;
+   object_id_type from_id;
+   if( decode_cursor( cursor, from, from_id ) )
+      itr = settle_index.lower_bound( boost::make_tuple( a, from, from_id ) );
+
+   api_page<force_settlement_object> page;
+   fill_page( itr, settle_index.upper_bound( a ), limit, page,
+              []( const force_settlement_object& o ) { return encode_cursor( o.settlement_date, o.id ); } );
+   return page;
 }
 
 vector<call_order_object> database_api::get_margin_positions( const account_id_type& id )const
 {
-   return my->get_margin_positions( id );
+   return my->read( "get_margin_positions", [&]() { return my->get_margin_positions( id ); } );
 }
 
 vector<call_order_object> database_api_impl::get_margin_positions( const account_id_type& id )const
@@ -998,6 +1944,39 @@ void database_api_impl::unsubscribe_from_market(asset_id_type a, asset_id_type b
    _market_subscriptions.erase(std::make_pair(a,b));
 }
 
+void database_api::subscribe_to_market_deltas(std::function<void(const variant&)> callback, asset_id_type a, asset_id_type b)
+{
+   my->subscribe_to_market_deltas( callback, a, b );
+}
+
+void database_api_impl::subscribe_to_market_deltas(std::function<void(const variant&)> callback, asset_id_type a, asset_id_type b)
+{
+   if(a > b) std::swap(a,b);
+   FC_ASSERT(a != b);
+   // starts the collection of changed levels, if no one has asked for them yet
+   get_order_book_index().get_deltas( _db.head_block_id(),
+                                      _db.get_dynamic_global_properties().last_irreversible_block_num );
+   _market_delta_subscriptions[ std::make_pair(a,b) ] = callback;
+}
+
+void database_api::unsubscribe_from_market_deltas(asset_id_type a, asset_id_type b)
+{
+   my->unsubscribe_from_market_deltas( a, b );
+}
+
+void database_api_impl::unsubscribe_from_market_deltas(asset_id_type a, asset_id_type b)
+{
+   if(a > b) std::swap(a,b);
+   FC_ASSERT(a != b);
+   _market_delta_subscriptions.erase(std::make_pair(a,b));
+}
+
+const limit_order_book_index& database_api_impl::get_order_book_index()const
+{
+   const auto& idx = dynamic_cast<const primary_index<limit_order_index>&>( _db.get_index_type<limit_order_index>() );
+   return idx.get_secondary_index<limit_order_book_index>();
+}
+
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
 {
    return my->get_ticker( base, quote );
@@ -1008,57 +1987,36 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
    auto assets = lookup_asset_symbols( {base, quote} );
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
+   return get_ticker( *assets[0], *assets[1], base, quote );
+}
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-
+market_ticker database_api_impl::get_ticker( const asset_object& base_asset, const asset_object& quote_asset,
+                                             const string& base, const string& quote )const
+{
    market_ticker result;
 
    result.base = base;
    result.quote = quote;
+   result.latest = 0;
    result.base_volume = 0;
    result.quote_volume = 0;
    result.percent_change = 0;
    result.lowest_ask = 0;
    result.highest_bid = 0;
 
-   auto price_to_real = [&]( const share_type a, int p ) { return double( a.value ) / pow( 10, p ); };
-
    try {
-      if( base_id > quote_id ) std::swap(base_id, quote_id);
-
-      uint32_t day = 86400;
-      auto now = fc::time_point_sec( fc::time_point::now() );
-      auto orders = get_order_book( base, quote, 1 );
-      auto trades = get_trade_history( base, quote, now, fc::time_point_sec( now.sec_since_epoch() - day ), 100 );
-
-      result.latest = trades[0].price;
-
-      for ( market_trade t: trades )
-      {
-         result.base_volume += t.value;
-         result.quote_volume += t.amount;
-      }
-
-      while (trades.size() == 100)
-      {
-         trades = get_trade_history( base, quote, trades[99].date, fc::time_point_sec( now.sec_since_epoch() - day ), 100 );
-
-         for ( market_trade t: trades )
-         {
-            result.base_volume += t.value;
-            result.quote_volume += t.amount;
-         }
-      }
-
-      trades = get_trade_history( base, quote, trades.back().date, fc::time_point_sec(), 1 );
-      result.percent_change = trades.size() > 0 ? ( ( result.latest / trades.back().price ) - 1 ) * 100 : 0;
+      read_ticker( base_asset, quote_asset, [&]( double latest, double prior, double base_volume, double quote_volume ) {
+         result.latest = latest;
+         result.percent_change = prior != 0 ? ( ( latest / prior ) - 1 ) * 100 : 0;
+         result.base_volume = base_volume;
+         result.quote_volume = quote_volume;
+      });
 
-      //if (assets[0]->id == base_id)
-      {
+      auto orders = get_order_book( base_asset, quote_asset, base, quote, 1 );
+      if( !orders.asks.empty() )
          result.lowest_ask = orders.asks[0].price;
+      if( !orders.bids.empty() )
          result.highest_bid = orders.bids[0].price;
-      }
 
       return result;
    } FC_CAPTURE_AND_RETHROW( (base)(quote) )
@@ -1075,9 +2033,6 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-
    market_volume result;
    result.base = base;
    result.quote = quote;
@@ -1085,82 +2040,131 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
    result.quote_volume = 0;
 
    try {
-      if( base_id > quote_id ) std::swap(base_id, quote_id);
-
-      uint32_t bucket_size = 86400;
-      auto now = fc::time_point_sec( fc::time_point::now() );
-
-      auto trades = get_trade_history( base, quote, now, fc::time_point_sec( now.sec_since_epoch() - bucket_size ), 100 );
-
-      for ( market_trade t: trades )
-      {
-         result.base_volume += t.value;
-         result.quote_volume += t.amount;
-      }
+      read_ticker( *assets[0], *assets[1], [&]( double, double, double base_volume, double quote_volume ) {
+         result.base_volume = base_volume;
+         result.quote_volume = quote_volume;
+      });
+      return result;
+   } FC_CAPTURE_AND_RETHROW( (base)(quote) )
+}
 
-      while (trades.size() == 100)
+void database_api_impl::read_ticker( const asset_object& base, const asset_object& quote,
+                                     const std::function<void(double,double,double,double)>& reader )const
+{
+   FC_ASSERT( _market_history, "The market_history plugin is required for market tickers" );
+   auto price_to_real = []( share_type b, const asset_object& b_asset, share_type q, const asset_object& q_asset ) {
+      if( q == 0 ) return 0.0;
+      return ( double( b.value ) / pow( 10, b_asset.precision ) ) / ( double( q.value ) / pow( 10, q_asset.precision ) );
+   };
+   auto now = fc::time_point_sec( fc::time_point::now() );
+   const asset_id_type base_id = base.id;
+   const asset_id_type quote_id = quote.id;
+
+   _market_history->read_history( [&]( const graphene::db::object_database& db ) {
+      const auto& by_market_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+      auto itr = by_market_idx.find( boost::make_tuple( std::min( base_id, quote_id ), std::max( base_id, quote_id ) ) );
+      if( itr == by_market_idx.end() )
+         return;
+
+      // the slots that went out of the window since the last fill
+      market_ticker_object ticker;
+      ticker.base_volume = itr->base_volume;
+      ticker.quote_volume = itr->quote_volume;
+      ticker.prior_base = itr->prior_base;
+      ticker.prior_quote = itr->prior_quote;
+      for( const ticker_slot& slot : itr->slots )
       {
-         trades = get_trade_history( base, quote, trades[99].date, fc::time_point_sec( now.sec_since_epoch() - bucket_size ), 100 );
-
-         for ( market_trade t: trades )
-         {
-            result.base_volume += t.value;
-            result.quote_volume += t.amount;
-         }
+         if( !market_ticker_object::expired( slot, now ) )
+            break;
+         ticker.base_volume -= slot.base_volume;
+         ticker.quote_volume -= slot.quote_volume;
+         ticker.prior_base = slot.close_base;
+         ticker.prior_quote = slot.close_quote;
       }
 
-      return result;
-   } FC_CAPTURE_AND_RETHROW( (base)(quote) )
+      // the ticker is kept with base < quote, turn it around when asked the other way
+      if( base_id == itr->base )
+         reader( price_to_real( itr->last_base, base, itr->last_quote, quote ),
+                 price_to_real( ticker.prior_base, base, ticker.prior_quote, quote ),
+                 double( ticker.base_volume.value ) / pow( 10, base.precision ),
+                 double( ticker.quote_volume.value ) / pow( 10, quote.precision ) );
+      else
+         reader( price_to_real( itr->last_quote, base, itr->last_base, quote ),
+                 price_to_real( ticker.prior_quote, base, ticker.prior_base, quote ),
+                 double( ticker.quote_volume.value ) / pow( 10, base.precision ),
+                 double( ticker.base_volume.value ) / pow( 10, quote.precision ) );
+   });
 }
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   return my->read( "get_order_book", [&]() { return my->get_order_book( base, quote, limit); } );
+}
+
+void database_api::get_order_book_json( const string& base, const string& quote, unsigned limit, std::string& out )const
+{
+   graphene::db::json_encoder( out ).write( get_order_book( base, quote, limit ) );
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   using boost::multiprecision::uint128_t;
    FC_ASSERT( limit <= 50 );
 
-   order_book result;
-   result.base = base;
-   result.quote = quote;
-
    auto assets = lookup_asset_symbols( {base, quote} );
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
+   return get_order_book( *assets[0], *assets[1], base, quote, limit );
+}
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-   auto orders = get_limit_orders( base_id, quote_id, limit );
+order_book database_api_impl::get_order_book( const asset_object& base_asset, const asset_object& quote_asset,
+                                              const string& base, const string& quote, unsigned limit )const
+{
+   using boost::multiprecision::uint128_t;
+
+   order_book result;
+   result.base = base;
+   result.quote = quote;
 
+   const asset_id_type base_id = base_asset.id;
+   const asset_id_type quote_id = quote_asset.id;
 
    auto asset_to_real = [&]( const asset& a, int p ) { return double(a.amount.value)/pow( 10, p ); };
    auto price_to_real = [&]( const price& p )
    {
       if( p.base.asset_id == base_id )
-         return asset_to_real( p.base, assets[0]->precision ) / asset_to_real( p.quote, assets[1]->precision );
+         return asset_to_real( p.base, base_asset.precision ) / asset_to_real( p.quote, quote_asset.precision );
       else
-         return asset_to_real( p.quote, assets[0]->precision ) / asset_to_real( p.base, assets[1]->precision );
+         return asset_to_real( p.quote, base_asset.precision ) / asset_to_real( p.base, quote_asset.precision );
    };
 
-   for( const auto& o : orders )
+   // each entry is one price level, read from the depth kept by limit_order_book_index
+   const auto& book = get_order_book_index();
+
+   if( const auto* levels = book.get_levels( base_id, quote_id ) )
    {
-      if( o.sell_price.base.asset_id == base_id )
+      for( const auto& level : *levels )
       {
+         if( result.bids.size() >= limit )
+            break;
+         const price& p = level.first;
          order ord;
-         ord.price = price_to_real( o.sell_price );
-         ord.quote = asset_to_real( share_type( ( uint128_t( o.for_sale.value ) * o.sell_price.quote.amount.value ) / o.sell_price.base.amount.value ), assets[1]->precision );
-         ord.base = asset_to_real( o.for_sale, assets[0]->precision );
+         ord.price = price_to_real( p );
+         ord.quote = asset_to_real( share_type( ( uint128_t( level.second.for_sale.value ) * p.quote.amount.value ) / p.base.amount.value ), quote_asset.precision );
+         ord.base = asset_to_real( level.second.for_sale, base_asset.precision );
          result.bids.push_back( ord );
       }
-      else
+   }
+   if( const auto* levels = book.get_levels( quote_id, base_id ) )
+   {
+      for( const auto& level : *levels )
       {
+         if( result.asks.size() >= limit )
+            break;
+         const price& p = level.first;
          order ord;
-         ord.price = price_to_real( o.sell_price );
-         ord.quote = asset_to_real( o.for_sale, assets[1]->precision );
-         ord.base = asset_to_real( share_type( ( uint64_t( o.for_sale.value ) * o.sell_price.quote.amount.value ) / o.sell_price.base.amount.value ), assets[0]->precision );
+         ord.price = price_to_real( p );
+         ord.quote = asset_to_real( level.second.for_sale, quote_asset.precision );
+         ord.base = asset_to_real( share_type( ( uint128_t( level.second.for_sale.value ) * p.quote.amount.value ) / p.base.amount.value ), base_asset.precision );
          result.asks.push_back( ord );
       }
    }
@@ -1168,6 +2172,63 @@ order_book database_api_impl::get_order_book( const string& base, const string&
    return result;
 }
 
+vector<order_book> database_api::get_order_books( const vector<std::pair<string,string>>& markets, unsigned limit )const
+{
+   return my->read( "get_order_books", [&]() { return my->get_order_books( markets, limit ); } );
+}
+
+vector<order_book> database_api_impl::get_order_books( const vector<std::pair<string,string>>& markets,
+                                                       unsigned limit )const
+{
+   FC_ASSERT( limit <= 50 );
+   vector<order_book> result;
+   result.reserve( markets.size() );
+   for_each_market( markets, [&]( const asset_object& base, const asset_object& quote, const std::pair<string,string>& m ) {
+      result.push_back( get_order_book( base, quote, m.first, m.second, limit ) );
+   });
+   return result;
+}
+
+vector<market_ticker> database_api::get_tickers( const vector<std::pair<string,string>>& markets )const
+{
+   return my->get_tickers( markets );
+}
+
+vector<market_ticker> database_api_impl::get_tickers( const vector<std::pair<string,string>>& markets )const
+{
+   vector<market_ticker> result;
+   result.reserve( markets.size() );
+   for_each_market( markets, [&]( const asset_object& base, const asset_object& quote, const std::pair<string,string>& m ) {
+      result.push_back( get_ticker( base, quote, m.first, m.second ) );
+   });
+   return result;
+}
+
+void database_api_impl::for_each_market( const vector<std::pair<string,string>>& markets,
+                                         const std::function<void(const asset_object&, const asset_object&,
+                                                                  const std::pair<string,string>&)>& visit )const
+{
+   FC_ASSERT( markets.size() <= 100 );
+
+   // each asset is looked up once, however many markets it is part of
+   flat_set<string> names;
+   for( const auto& m : markets )
+   {
+      names.insert( m.first );
+      names.insert( m.second );
+   }
+   const vector<string> symbols( names.begin(), names.end() );
+   const auto assets = lookup_asset_symbols( symbols );
+   auto find_asset = [&]( const string& name ) -> const asset_object& {
+      const auto& a = assets[ std::lower_bound( symbols.begin(), symbols.end(), name ) - symbols.begin() ];
+      FC_ASSERT( a, "Invalid asset symbol: ${s}", ("s",name) );
+      return *a;
+   };
+
+   for( const auto& m : markets )
+      visit( find_asset( m.first ), find_asset( m.second ), m );
+}
+
 vector<market_trade> database_api::get_trade_history( const string& base,
                                                       const string& quote,
                                                       fc::time_point_sec start,
@@ -1184,6 +2245,24 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
                                                            unsigned limit )const
 {
    FC_ASSERT( limit <= 100 );
+   return get_trade_history_page( base, quote, start, stop, limit, string() ).items;
+}
+
+api_page<market_trade> database_api::get_trade_history_page( const string& base, const string& quote,
+                                                             fc::time_point_sec start, fc::time_point_sec stop,
+                                                             uint32_t limit, const string& cursor )const
+{
+   return my->get_trade_history_page( base, quote, start, stop, limit, cursor );
+}
+
+api_page<market_trade> database_api_impl::get_trade_history_page( const string& base, const string& quote,
+                                                                  fc::time_point_sec start, fc::time_point_sec stop,
+                                                                  uint32_t limit, const string& cursor )const
+{
+   FC_ASSERT( limit <= 1000 );
+   fc::time_point_sec from_time;
+   int64_t from_sequence = 0;
+   const bool resume = decode_cursor( cursor, from_time, from_sequence );
 
    auto assets = lookup_asset_symbols( {base, quote} );
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
@@ -1193,24 +2272,25 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
    auto quote_id = assets[1]->id;
 
    if( base_id > quote_id ) std::swap( base_id, quote_id );
-   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
-   history_key hkey;
-   hkey.base = base_id;
-   hkey.quote = quote_id;
-   hkey.sequence = std::numeric_limits<int64_t>::min();
 
    auto price_to_real = [&]( const share_type a, int p ) { return double( a.value ) / pow( 10, p ); };
 
    if ( start.sec_since_epoch() == 0 )
       start = fc::time_point_sec( fc::time_point::now() );
 
-   uint32_t count = 0;
-   auto itr = history_idx.lower_bound( hkey );
-   vector<market_trade> result;
-
-   while( itr != history_idx.end() && count < limit && !( itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop ) )
-   {
-      if( itr->time < start )
+   api_page<market_trade> page;
+   vector<market_trade>& result = page.items;
+   auto read_trades = [&]( const graphene::db::object_database& db ) {
+      // one side of each trade, newest first, so the page starts with a seek and walks no further than it returns
+      const auto& time_idx = db.get_index_type<graphene::market_history::history_index>().indices()
+                               .get<graphene::market_history::by_market_time>();
+      auto itr = resume ? time_idx.lower_bound( boost::make_tuple( base_id, quote_id, true, from_time, from_sequence ) )
+                        : time_idx.upper_bound( boost::make_tuple( base_id, quote_id, true, start ) );
+      auto in_range = [&]( decltype(itr) i ) {
+         return i != time_idx.end() && i->base() == base_id && i->quote() == quote_id && i->pays_base() && i->time >= stop;
+      };
+
+      for( ; in_range( itr ) && result.size() < limit; ++itr )
       {
          market_trade trade;
 
@@ -1229,15 +2309,16 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
          trade.price = trade.value / trade.amount;
 
          result.push_back( trade );
-         ++count;
       }
+      if( in_range( itr ) )
+         page.next = encode_cursor( itr->time, itr->key.sequence );
+   };
+   if( _market_history )
+      _market_history->read_history( read_trades );
+   else
+      read_trades( _db );
 
-      // Trades are tracked in each direction.
-      ++itr;
-      ++itr;
-   }
-
-   return result;
+   return page;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1248,7 +2329,7 @@ vector<market_trade> database_api_impl::get_trade_history( const string& base,
 
 vector<optional<witness_object>> database_api::get_witnesses(const vector<witness_id_type>& witness_ids)const
 {
-   return my->get_witnesses( witness_ids );
+   return my->read( "get_witnesses", [&]() { return my->get_witnesses( witness_ids ); } );
 }
 
 vector<worker_object> database_api::get_workers_by_account(account_id_type account)const
@@ -1295,30 +2376,19 @@ fc::optional<witness_object> database_api_impl::get_witness_by_account(account_i
 
 map<string, witness_id_type> database_api::lookup_witness_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->lookup_witness_accounts( lower_bound_name, limit );
+   return my->read( "lookup_witness_accounts", [&]() { return my->lookup_witness_accounts( lower_bound_name, limit ); } );
 }
 
 map<string, witness_id_type> database_api_impl::lookup_witness_accounts(const string& lower_bound_name, uint32_t limit)const
 {
    FC_ASSERT( limit <= 1000 );
-   const auto& witnesses_by_id = _db.get_index_type<witness_index>().indices().get<by_id>();
-
-   // we want to order witnesses by account name, but that name is in the account object
-   // so the witness_index doesn't have a quick way to access it.
-   // get all the names and look them all up, sort them, then figure out what
-   // records to return.  This could be optimized, but we expect the
-   // number of witnesses to be few and the frequency of calls to be rare
-   std::map<std::string, witness_id_type> witnesses_by_account_name;
-   for (const witness_object& witness : witnesses_by_id)
-       if (auto account_iter = _db.find(witness.witness_account))
-           if (account_iter->name >= lower_bound_name) // we can ignore anything below lower_bound_name
-               witnesses_by_account_name.insert(std::make_pair(account_iter->name, witness.id));
-
-   auto end_iter = witnesses_by_account_name.begin();
-   while (end_iter != witnesses_by_account_name.end() && limit--)
-       ++end_iter;
-   witnesses_by_account_name.erase(end_iter, witnesses_by_account_name.end());
-   return witnesses_by_account_name;
+   const auto& idx = dynamic_cast<const primary_index<witness_index>&>( _db.get_index_type<witness_index>() );
+   const auto& by_name = idx.get_secondary_index<witness_name_index>().by_name;
+
+   map<string, witness_id_type> result;
+   for( auto itr = by_name.lower_bound( lower_bound_name ); limit-- && itr != by_name.end(); ++itr )
+      result.emplace_hint( result.end(), *itr );
+   return result;
 }
 
 uint64_t database_api::get_witness_count()const
@@ -1331,6 +2401,22 @@ uint64_t database_api_impl::get_witness_count()const
    return _db.get_index_type<witness_index>().indices().size();
 }
 
+vector<witness_object> database_api::get_witnesses_by_votes(uint32_t limit)const
+{
+   return my->read( "get_witnesses_by_votes", [&]() { return my->get_witnesses_by_votes( limit ); } );
+}
+
+vector<witness_object> database_api_impl::get_witnesses_by_votes(uint32_t limit)const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& witnesses_by_votes = _db.get_index_type<witness_index>().indices().get<by_votes>();
+   vector<witness_object> result;
+   result.reserve( std::min<size_t>( limit, witnesses_by_votes.size() ) );
+   for( auto itr = witnesses_by_votes.begin(); itr != witnesses_by_votes.end() && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Committee members                                                //
@@ -1339,7 +2425,7 @@ uint64_t database_api_impl::get_witness_count()const
 
 vector<optional<committee_member_object>> database_api::get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const
 {
-   return my->get_committee_members( committee_member_ids );
+   return my->read( "get_committee_members", [&]() { return my->get_committee_members( committee_member_ids ); } );
 }
 
 vector<optional<committee_member_object>> database_api_impl::get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const
@@ -1370,30 +2456,36 @@ fc::optional<committee_member_object> database_api_impl::get_committee_member_by
 
 map<string, committee_member_id_type> database_api::lookup_committee_member_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->lookup_committee_member_accounts( lower_bound_name, limit );
+   return my->read( "lookup_committee_member_accounts", [&]() { return my->lookup_committee_member_accounts( lower_bound_name, limit ); } );
 }
 
 map<string, committee_member_id_type> database_api_impl::lookup_committee_member_accounts(const string& lower_bound_name, uint32_t limit)const
 {
    FC_ASSERT( limit <= 1000 );
-   const auto& committee_members_by_id = _db.get_index_type<committee_member_index>().indices().get<by_id>();
-
-   // we want to order committee_members by account name, but that name is in the account object
-   // so the committee_member_index doesn't have a quick way to access it.
-   // get all the names and look them all up, sort them, then figure out what
-   // records to return.  This could be optimized, but we expect the
-   // number of committee_members to be few and the frequency of calls to be rare
-   std::map<std::string, committee_member_id_type> committee_members_by_account_name;
-   for (const committee_member_object& committee_member : committee_members_by_id)
-       if (auto account_iter = _db.find(committee_member.committee_member_account))
-           if (account_iter->name >= lower_bound_name) // we can ignore anything below lower_bound_name
-               committee_members_by_account_name.insert(std::make_pair(account_iter->name, committee_member.id));
-
-   auto end_iter = committee_members_by_account_name.begin();
-   while (end_iter != committee_members_by_account_name.end() && limit--)
-       ++end_iter;
-   committee_members_by_account_name.erase(end_iter, committee_members_by_account_name.end());
-   return committee_members_by_account_name;
+   const auto& idx = dynamic_cast<const primary_index<committee_member_index>&>( _db.get_index_type<committee_member_index>() );
+   const auto& by_name = idx.get_secondary_index<committee_member_name_index>().by_name;
+
+   map<string, committee_member_id_type> result;
+   for( auto itr = by_name.lower_bound( lower_bound_name ); limit-- && itr != by_name.end(); ++itr )
+      result.emplace_hint( result.end(), *itr );
+   return result;
+}
+
+vector<committee_member_object> database_api::get_committee_members_by_votes(uint32_t limit)const
+{
+   return my->read( "get_committee_members_by_votes", [&]() { return my->get_committee_members_by_votes( limit ); } );
+}
+
+vector<committee_member_object> database_api_impl::get_committee_members_by_votes(uint32_t limit)const
+{
+   FC_ASSERT( limit <= 1000 );
+   const auto& committee_members_by_votes = _db.get_index_type<committee_member_index>().indices().get<by_votes>();
+   vector<committee_member_object> result;
+   result.reserve( std::min<size_t>( limit, committee_members_by_votes.size() ) );
+   for( auto itr = committee_members_by_votes.begin();
+        itr != committee_members_by_votes.end() && result.size() < limit; ++itr )
+      result.push_back( *itr );
+   return result;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -1404,7 +2496,7 @@ map<string, committee_member_id_type> database_api_impl::lookup_committee_member
 
 vector<variant> database_api::lookup_vote_ids( const vector<vote_id_type>& votes )const
 {
-   return my->lookup_vote_ids( votes );
+   return my->read( "lookup_vote_ids", [&]() { return my->lookup_vote_ids( votes ); } );
 }
 
 vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>& votes )const
@@ -1426,7 +2518,7 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
          {
             auto itr = committee_idx.find( id );
             if( itr != committee_idx.end() )
-               result.emplace_back( variant( *itr ) );
+               result.emplace_back( _cache->to_variant( *itr ) );
             else
                result.emplace_back( variant() );
             break;
@@ -1435,7 +2527,7 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
          {
             auto itr = witness_idx.find( id );
             if( itr != witness_idx.end() )
-               result.emplace_back( variant( *itr ) );
+               result.emplace_back( _cache->to_variant( *itr ) );
             else
                result.emplace_back( variant() );
             break;
@@ -1444,12 +2536,12 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
          {
             auto itr = for_worker_idx.find( id );
             if( itr != for_worker_idx.end() ) {
-               result.emplace_back( variant( *itr ) );
+               result.emplace_back( _cache->to_variant( *itr ) );
             }
             else {
                auto itr = against_worker_idx.find( id );
                if( itr != against_worker_idx.end() ) {
-                  result.emplace_back( variant( *itr ) );
+                  result.emplace_back( _cache->to_variant( *itr ) );
                }
                else {
                   result.emplace_back( variant() );
@@ -1481,7 +2573,7 @@ std::string database_api_impl::get_transaction_hex(const signed_transaction& trx
 
 set<public_key_type> database_api::get_required_signatures( const signed_transaction& trx, const flat_set<public_key_type>& available_keys )const
 {
-   return my->get_required_signatures( trx, available_keys );
+   return my->read( "get_required_signatures", [&]() { return my->get_required_signatures( trx, available_keys ); } );
 }
 
 set<public_key_type> database_api_impl::get_required_signatures( const signed_transaction& trx, const flat_set<public_key_type>& available_keys )const
@@ -1498,16 +2590,53 @@ set<public_key_type> database_api_impl::get_required_signatures( const signed_tr
 
 set<public_key_type> database_api::get_potential_signatures( const signed_transaction& trx )const
 {
-   return my->get_potential_signatures( trx );
+   return my->read( "get_potential_signatures", [&]() { return my->get_potential_signatures( trx ); } );
 }
 set<address> database_api::get_potential_address_signatures( const signed_transaction& trx )const
 {
-   return my->get_potential_address_signatures( trx );
+   return my->read( "get_potential_address_signatures", [&]() { return my->get_potential_address_signatures( trx ); } );
+}
+
+std::shared_ptr<const authority_key_cache::reach> database_api_impl::get_potential_reach( const signed_transaction& trx )const
+{
+   // the signatures a transaction already carries satisfy authorities and cut the walk short
+   if( !trx.signatures.empty() )
+      return nullptr;
+
+   flat_set<account_id_type> required_active;
+   flat_set<account_id_type> required_owner;
+   vector<authority> other;
+   trx.get_required_authorities( required_active, required_owner, other );
+
+   const uint32_t max_depth = _db.get_global_properties().parameters.max_authority_depth;
+   auto result = std::make_shared<authority_key_cache::reach>();
+   for( const auto& auth : other )
+      _authority_keys->add_reach( _db, auth, max_depth, false, *result );
+   for( const auto& id : required_owner )
+   {
+      const account_object* account = _db.find( id );
+      if( account == nullptr )
+         return nullptr;
+      _authority_keys->add_reach( _db, account->owner, max_depth, true, *result );
+   }
+   for( const auto& id : required_active )
+   {
+      auto active = _authority_keys->get_active_reach( _db, id, max_depth );
+      result->keys.insert( active->keys.begin(), active->keys.end() );
+      result->addresses.insert( active->addresses.begin(), active->addresses.end() );
+      result->exact = result->exact && active->exact;
+   }
+   if( !result->exact )
+      return nullptr;
+   return result;
 }
 
 set<public_key_type> database_api_impl::get_potential_signatures( const signed_transaction& trx )const
 {
    wdump((trx));
+   if( auto reach = get_potential_reach( trx ) )
+      return set<public_key_type>( reach->keys.begin(), reach->keys.end() );
+
    set<public_key_type> result;
    trx.get_required_signatures(
       _db.get_chain_id(),
@@ -1535,6 +2664,9 @@ set<public_key_type> database_api_impl::get_potential_signatures( const signed_t
 
 set<address> database_api_impl::get_potential_address_signatures( const signed_transaction& trx )const
 {
+   if( auto reach = get_potential_reach( trx ) )
+      return set<address>( reach->addresses.begin(), reach->addresses.end() );
+
    set<address> result;
    trx.get_required_signatures(
       _db.get_chain_id(),
@@ -1695,6 +2827,80 @@ vector< fc::variant > database_api_impl::get_required_fees( const vector<operati
    return result;
 }
 
+vector<simulated_transaction> database_api::simulate_transactions( const vector<signed_transaction>& trxs )const
+{
+   return my->read( "simulate_transactions", [&]() { return my->simulate_transactions( trxs ); } );
+}
+
+namespace {
+   struct operation_fee_visitor
+   {
+      typedef asset result_type;
+      template<typename Op>
+      asset operator()( const Op& op )const { return op.fee; }
+   };
+}
+
+vector<simulated_transaction> database_api_impl::simulate_transactions( const vector<signed_transaction>& trxs )const
+{
+   FC_ASSERT( trxs.size() <= 100 );
+   vector<simulated_transaction> results( trxs.size() );
+   if( trxs.empty() )
+      return results;
+
+   // copying the state is what a call costs, so the copy is shared and kept until the next block; the batch
+   // session undoes this call's transactions before the next call
+   std::lock_guard<std::mutex> lock( _simulation->mutex );
+   database* sandbox = &_simulation->fork( _db );
+   auto batch = sandbox->_undo_db.start_undo_session();
+   operation_fee_visitor fee_of;
+   for( size_t i = 0; i < trxs.size(); ++i )
+   {
+      const signed_transaction& trx = trxs[i];
+      simulated_transaction& result = results[i];
+      for( const operation& op : trx.operations )
+      {
+         const asset fee = op.visit( fee_of );
+         const asset_object* fee_asset = sandbox->find( fee.asset_id );
+         result.fees.push_back( fee );
+         // a fee in an unknown asset fails the transaction anyway
+         result.required_fees.push_back( fee_asset ? sandbox->current_fee_schedule().calculate_fee( op,
+                                                        fee_asset->options.core_exchange_rate )
+                                                   : asset( 0, fee.asset_id ) );
+      }
+
+      // every transaction gets an undo session of its own, so a failure drops only its changes, and on
+      // success the session tells which objects it touched
+      const size_t applied_before = sandbox->get_applied_operations().size();
+      try
+      {
+         auto session = sandbox->_undo_db.start_undo_session();
+         result.trx = sandbox->apply_transaction( trx );
+         const auto& changes = sandbox->_undo_db.head();
+         for( const auto& id : changes.new_ids )
+            result.impacted_objects.push_back( id );
+         for( const auto& item : changes.old_values )
+            result.impacted_objects.push_back( item.first );
+         for( const auto& item : changes.removed )
+            result.impacted_objects.push_back( item.first );
+         std::sort( result.impacted_objects.begin(), result.impacted_objects.end() );
+         session.merge();
+
+         const auto& applied = sandbox->get_applied_operations();
+         for( size_t n = applied_before; n < applied.size(); ++n )
+            if( applied[n].valid() )
+               result.applied_operations.push_back( *applied[n] );
+         result.success = true;
+      }
+      catch( const fc::exception& e )
+      {
+         result.trx = processed_transaction( trx );
+         result.error = e.to_string();
+      }
+   }
+   return results;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Proposed transactions                                            //
@@ -1703,24 +2909,45 @@ vector< fc::variant > database_api_impl::get_required_fees( const vector<operati
 
 vector<proposal_object> database_api::get_proposed_transactions( account_id_type id )const
 {
-   return my->get_proposed_transactions( id );
+   return my->read( "get_proposed_transactions", [&]() { return my->get_proposed_transactions( id ); } );
 }
 
-/** TODO: add secondary index that will accelerate this process */
 vector<proposal_object> database_api_impl::get_proposed_transactions( account_id_type id )const
 {
-   const auto& idx = _db.get_index_type<proposal_index>();
-   vector<proposal_object> result;
+   // the accounts id can approve for: those naming it in their authorities, up to the depth the authority
+   // checks follow, found upwards through the account_member_index
+   const auto& members = get_api_index<account_member_index, account_index>();
+   const uint32_t max_depth = _db.get_global_properties().parameters.max_authority_depth;
+   flat_set<account_id_type> approvers{ id };
+   vector<account_id_type> frontier{ id };
+   for( uint32_t depth = 0; depth < max_depth && !frontier.empty(); ++depth )
+   {
+      vector<account_id_type> next;
+      for( const account_id_type& a : frontier )
+      {
+         auto itr = members.account_to_account_memberships.find( a );
+         if( itr == members.account_to_account_memberships.end() )
+            continue;
+         for( const account_id_type& parent : itr->second )
+            if( approvers.insert( parent ).second )
+               next.push_back( parent );
+      }
+      frontier.swap( next );
+   }
 
-   idx.inspect_all_objects( [&](const object& obj){
-           const proposal_object& p = static_cast<const proposal_object&>(obj);
-           if( p.required_active_approvals.find( id ) != p.required_active_approvals.end() )
-              result.push_back(p);
-           else if ( p.required_owner_approvals.find( id ) != p.required_owner_approvals.end() )
-              result.push_back(p);
-           else if ( p.available_active_approvals.find( id ) != p.available_active_approvals.end() )
-              result.push_back(p);
-   });
+   const auto& approvals = get_api_index<required_approval_index, proposal_index>();
+   set<proposal_id_type> proposal_ids;
+   for( const account_id_type& a : approvers )
+   {
+      auto itr = approvals._account_to_proposals.find( a );
+      if( itr != approvals._account_to_proposals.end() )
+         proposal_ids.insert( itr->second.begin(), itr->second.end() );
+   }
+
+   vector<proposal_object> result;
+   result.reserve( proposal_ids.size() );
+   for( const proposal_id_type& p : proposal_ids )
+      result.push_back( p(_db) );
    return result;
 }
 
@@ -1755,27 +2982,22 @@ vector<blinded_balance_object> database_api_impl::get_blinded_balances( const fl
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+void database_api_impl::broadcast_updates( const vector<variant>& updates, const vector<uint64_t>& sizes )
 {
-   if( updates.size() ) {
-      auto capture_this = shared_from_this();
-      fc::async([capture_this,updates](){
-          capture_this->_subscribe_callback( fc::variant(updates) );
-      });
-   }
+   if( updates.size() && _subscribe_callback )
+      _send_queue->push_objects( _subscribe_callback, updates, sizes );
 }
 
+/** the subscription_hub reports the removed objects to the subscribe callback, this only serves the markets */
 void database_api_impl::on_objects_removed( const vector<const object*>& objs )
 {
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   if( _subscribe_callback )
+   if( _balance_subscription )
    {
-      vector<variant>    updates;
-      updates.reserve(objs.size());
-
-      for( auto obj : objs )
-         updates.emplace_back( obj->id );
-      broadcast_updates( updates );
+      vector<const account_balance_object*> balances;
+      for( const auto& obj : objs )
+         if( obj->id.space() == implementation_ids && obj->id.type() == impl_account_balance_object_type )
+            balances.push_back( static_cast<const account_balance_object*>( obj ) );
+      notify_balances( balances, true );
    }
 
    if( _market_subscriptions.size() )
@@ -1791,88 +3013,110 @@ void database_api_impl::on_objects_removed( const vector<const object*>& objs )
                broadcast_queue[order->get_market()].emplace_back( order->id );
          }
       }
-      if( broadcast_queue.size() )
-      {
-         auto capture_this = shared_from_this();
-         fc::async([capture_this,this,broadcast_queue](){
-             for( const auto& item : broadcast_queue )
-             {
-               auto sub = _market_subscriptions.find(item.first);
-               if( sub != _market_subscriptions.end() )
-                   sub->second( fc::variant(item.second ) );
-             }
-         });
-      }
+      for( const auto& item : broadcast_queue )
+         _send_queue->push( _market_subscriptions.at(item.first), fc::variant(item.second) );
    }
 }
 
+/** the subscription_hub reports the changed objects to the subscribe callback, this only serves the markets */
 void database_api_impl::on_objects_changed(const vector<object_id_type>& ids)
 {
-   vector<variant>    updates;
+   if( _balance_subscription )
+   {
+      vector<const account_balance_object*> balances;
+      for( const auto& id : ids )
+         if( id.space() == implementation_ids && id.type() == impl_account_balance_object_type )
+            if( const object* obj = _db.find_object( id ) )
+               balances.push_back( static_cast<const account_balance_object*>( obj ) );
+      notify_balances( balances, false );
+   }
+
+   if( _market_subscriptions.empty() )
+      return;
+
    map< pair<asset_id_type, asset_id_type>,  vector<variant> > market_broadcast_queue;
 
    for(auto id : ids)
    {
-      const object* obj = nullptr;
-      if( _subscribe_callback )
-      {
-         obj = _db.find_object( id );
-         if( obj )
-         {
-            updates.emplace_back( obj->to_variant() );
-         }
-         else
-         {
-            updates.emplace_back(id); // send just the id to indicate removal
-         }
-      }
-
-      if( _market_subscriptions.size() )
+      if( id.space() != protocol_ids || id.type() != limit_order_object_type )
+         continue;
+      const object* obj = _db.find_object( id );
+      if( obj )
       {
-         if( !_subscribe_callback )
-            obj = _db.find_object( id );
-         if( obj )
-         {
-            const limit_order_object* order = dynamic_cast<const limit_order_object*>(obj);
-            if( order )
-            {
-               auto sub = _market_subscriptions.find( order->get_market() );
-               if( sub != _market_subscriptions.end() )
-                  market_broadcast_queue[order->get_market()].emplace_back( order->id );
-            }
-         }
+         const limit_order_object* order = static_cast<const limit_order_object*>(obj);
+         auto sub = _market_subscriptions.find( order->get_market() );
+         if( sub != _market_subscriptions.end() )
+            market_broadcast_queue[order->get_market()].emplace_back( order->id );
       }
    }
 
-   auto capture_this = shared_from_this();
+   if( market_broadcast_queue.empty() )
+      return;
 
-   /// pushing the future back / popping the prior future if it is complete.
-   /// if a connection hangs then this could get backed up and result in
-   /// a failure to exit cleanly.
-   fc::async([capture_this,this,updates,market_broadcast_queue](){
-      if( _subscribe_callback ) _subscribe_callback( updates );
+   for( const auto& item : market_broadcast_queue )
+      _send_queue->push( _market_subscriptions.at(item.first), fc::variant(item.second) );
+}
 
-      for( const auto& item : market_broadcast_queue )
-      {
-        auto sub = _market_subscriptions.find(item.first);
-        if( sub != _market_subscriptions.end() )
-            sub->second( fc::variant(item.second ) );
-      }
-   });
+void database_api_impl::notify_balances( const vector<const account_balance_object*>& balances, bool removed )
+{
+   map< account_id_type, vector<asset> > changed;
+   for( const account_balance_object* b : balances )
+      if( _balance_subscription->follows( *b ) )
+         changed[b->owner].emplace_back( removed ? share_type( 0 ) : b->balance, b->asset_type );
+   if( changed.empty() )
+      return;
+
+   vector<account_balances> updates;
+   updates.reserve( changed.size() );
+   for( auto& item : changed )
+   {
+      updates.emplace_back();
+      updates.back().account = item.first;
+      updates.back().balances = std::move( item.second );
+   }
+   _send_queue->push( _balance_subscription->callback, fc::variant( updates ) );
 }
 
 /** note: this method cannot yield because it is called in the middle of
  * apply a block.
  */
-void database_api_impl::on_applied_block()
+void database_api_impl::on_applied_block( const signed_block& b )
 {
+   if( _block_stream && _block_stream->live )
+   {
+      vector<streamed_block> batch( 1 );
+      batch[0].block_num = b.block_num();
+      batch[0].block     = b;
+      if( _block_stream->include_applied_ops )
+         for( const auto& op : _db.get_applied_operations() )
+            if( op.valid() )
+               batch[0].applied_operations.push_back( *op );
+
+      auto callback = _block_stream->callback;
+      _block_stream->next_block = batch[0].block_num + 1;
+      if( _block_stream->end_block && batch[0].block_num >= _block_stream->end_block )
+         _block_stream.reset();
+
+      _send_queue->push( callback, fc::variant( batch ) );
+   }
+
    if (_block_applied_callback)
+      _send_queue->push( _block_applied_callback, fc::variant(_db.head_block_id()) );
+
+   if( _market_delta_subscriptions.size() )
    {
-      auto capture_this = shared_from_this();
-      block_id_type block_id = _db.head_block_id();
-      fc::async([this,capture_this,block_id](){
-         _block_applied_callback(fc::variant(block_id));
-      });
+      // shared by every connection, the deltas of a block are collected and turned into variants once
+      const auto& deltas = get_order_book_index().get_deltas( _db.head_block_id(),
+                                                              _db.get_dynamic_global_properties().last_irreversible_block_num );
+      vector< pair< pair<asset_id_type,asset_id_type>, variant > > queue;
+      for( const auto& sub : _market_delta_subscriptions )
+      {
+         auto itr = deltas.find( sub.first );
+         if( itr != deltas.end() )
+            queue.emplace_back( sub.first, itr->second );
+      }
+      for( const auto& item : queue )
+         _send_queue->push( _market_delta_subscriptions.at(item.first), item.second );
    }
 
    if(_market_subscriptions.size() == 0)
@@ -1905,16 +3149,8 @@ void database_api_impl::on_applied_block()
       if(_market_subscriptions.count(market))
          subscribed_markets_ops[market].push_back(std::make_pair(op.op, op.result));
    }
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
-      for(auto item : subscribed_markets_ops)
-      {
-         auto itr = _market_subscriptions.find(item.first);
-         if(itr != _market_subscriptions.end())
-            itr->second(fc::variant(item.second));
-      }
-   });
+   for( const auto& item : subscribed_markets_ops )
+      _send_queue->push( _market_subscriptions.at(item.first), fc::variant(item.second) );
 }
 
 } } // graphene::app
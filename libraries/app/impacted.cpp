@@ -205,12 +205,42 @@ struct get_impacted_account_visitor
 
 };
 
+/// visits with the operation's type known, so the authorities and impacted accounts need no second dispatch
+struct get_required_and_impacted_account_visitor
+{
+   flat_set<account_id_type>& _impacted;
+   get_required_and_impacted_account_visitor( flat_set<account_id_type>& impact ):_impacted(impact) {}
+   typedef void result_type;
+
+   template<typename Op>
+   void operator()( const Op& op )
+   {
+      _impacted.insert( op.fee_payer() );
+      op.get_required_active_authorities( _impacted );
+      op.get_required_owner_authorities( _impacted );
+      vector<authority> other;
+      op.get_required_authorities( other );
+      for( const auto& a : other )
+         for( const auto& item : a.account_auths )
+            _impacted.insert( item.first );
+
+      get_impacted_account_visitor impacted( _impacted );
+      impacted( op );
+   }
+};
+
 void operation_get_impacted_accounts( const operation& op, flat_set<account_id_type>& result )
 {
    get_impacted_account_visitor vtor = get_impacted_account_visitor( result );
    op.visit( vtor );
 }
 
+void operation_get_required_and_impacted_accounts( const operation& op, flat_set<account_id_type>& result )
+{
+   get_required_and_impacted_account_visitor vtor( result );
+   op.visit( vtor );
+}
+
 void transaction_get_impacted_accounts( const transaction& tx, flat_set<account_id_type>& result )
 {
    for( const auto& op : tx.operations )
@@ -23,6 +23,9 @@
  */
 #pragma once
 
+#include <graphene/app/api_call_log.hpp>
+#include <graphene/app/block_production_statistics.hpp>
+#include <graphene/app/confirmation_registry.hpp>
 #include <graphene/app/database_api.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
@@ -126,13 +129,7 @@ namespace graphene { namespace app {
       public:
          network_broadcast_api(application& a);
 
-         struct transaction_confirmation
-         {
-            transaction_id_type   id;
-            uint32_t              block_num;
-            uint32_t              trx_num;
-            processed_transaction trx;
-         };
+         typedef graphene::app::transaction_confirmation transaction_confirmation;
 
          typedef std::function<void(variant/*transaction_confirmation*/)> confirmation_callback;
 
@@ -145,26 +142,24 @@ namespace graphene { namespace app {
           */
          void broadcast_transaction(const signed_transaction& trx);
 
+         /**
+          * @brief Broadcast a batch of transactions to the network
+          * @param trxs The transactions to broadcast, applied locally in this order
+          * @return For each transaction the applied transaction, or the error it was rejected with
+          *
+          * Each transaction is checked like in broadcast_transaction(), but a transaction that fails to apply
+          * locally does not stop the others: only it is left out of the broadcast.
+          */
+         vector<transaction_admission> broadcast_transactions(const vector<signed_transaction>& trxs);
+
          /** this version of broadcast transaction registers a callback method that will be called when the transaction is
           * included into a block.  The callback method includes the transaction id, block number, and transaction number in the
-          * block.
+          * block.  The callbacks of all connections wait in the application's confirmation_registry.
           */
          void broadcast_transaction_with_callback( confirmation_callback cb, const signed_transaction& trx);
 
          void broadcast_block( const signed_block& block );
-
-         /**
-          * @brief Not reflected, thus not accessible to API clients.
-          *
-          * This function is registered to receive the applied_block
-          * signal from the chain database when a block is received.
-          * It then dispatches callbacks to clients who have requested
-          * to be notified when a particular txid is included in a block.
-          */
-         void on_applied_block( const signed_block& b );
       private:
-         boost::signals2::scoped_connection             _applied_block_connection;
-         map<transaction_id_type,confirmation_callback> _callbacks;
          application&                                   _app;
    };
 
@@ -210,6 +205,24 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Return traffic by message type, queue and cache sizes, item fetch latencies
+          *        and the rate of duplicate items received, to tune the p2p parameters by
+          */
+         fc::variant_object get_network_statistics() const;
+
+         /**
+          * @brief Return the recent block production attempts of the witnesses of this node, with histograms of the
+          *        wakeup drift, generation and broadcast times and block sizes
+          */
+         block_production_statistics get_block_production_statistics() const;
+
+         /**
+          * @brief Return the latest API calls that took longer than api-slow-call-threshold-ms, oldest first, with
+          *        their arguments, the client's address and the time spent encoding the response
+          */
+         std::vector<slow_api_call> get_slow_api_calls() const;
+
       private:
          application& _app;
    };
@@ -301,8 +314,6 @@ namespace graphene { namespace app {
 
 }}  // graphene::app
 
-FC_REFLECT( graphene::app::network_broadcast_api::transaction_confirmation,
-        (id)(block_num)(trx_num)(trx) )
 FC_REFLECT( graphene::app::verify_range_result,
         (success)(min_val)(max_val) )
 FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
@@ -319,6 +330,7 @@ FC_API(graphene::app::history_api,
      )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
+       (broadcast_transactions)
        (broadcast_transaction_with_callback)
        (broadcast_block)
      )
@@ -329,6 +341,9 @@ FC_API(graphene::app::network_node_api,
        (get_potential_peers)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
+       (get_network_statistics)
+       (get_block_production_statistics)
+       (get_slow_api_calls)
      )
 FC_API(graphene::app::crypto_api,
        (blind_sign)
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/utilities/metrics.hpp>
+
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+#include <fc/variant.hpp>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/** An API call that took longer than the slow call threshold */
+struct slow_api_call
+{
+   fc::time_point_sec   time;            ///< when the call was answered
+   std::string          method;
+   std::string          arguments;       ///< JSON, cut off after api_call_log::max_argument_chars
+   std::string          remote_endpoint;
+   int64_t              duration = 0;    ///< microseconds from the request until the response was encoded
+   int64_t              encode_time = 0; ///< microseconds of that spent encoding the result as JSON
+   uint64_t             response_size = 0;
+   bool                 failed = false;
+};
+
+/**
+ *  @brief The response sizes and encoding times of the API calls by method, and the recent calls that were slow
+ *
+ *  batch_api_connection records every call it answers.  The calls and their latency by method are counted by
+ *  database_api already, this adds what only the connection sees: the size of the JSON and the time it took to
+ *  write it.  Calls over the threshold are kept with their arguments, so a client that asks for too much can be found.
+ *  Only calls that succeeded are counted by method, so that unknown method names do not add labels to /metrics.
+ *
+ *  Connections record from their own threads, the log takes a lock.
+ */
+class api_call_log
+{
+   public:
+      /** @param metrics where the sizes, encoding times and slow calls are counted, may be null */
+      explicit api_call_log( graphene::utilities::metrics_registry* metrics = nullptr );
+
+      /** calls taking at least this long are kept, 0 keeps none */
+      void set_threshold( fc::microseconds threshold );
+      fc::microseconds threshold()const;
+      /** the most slow calls kept, older ones are dropped */
+      void set_max_slow_calls( size_t max_calls );
+
+      /**
+       *  @param encode_time unset when the call wrote its JSON itself
+       *  @param failed the response is an error, which is only logged when slow
+       */
+      void record( const std::string& method, const fc::variants& args, const std::string& remote_endpoint,
+                   fc::microseconds duration, const fc::optional<fc::microseconds>& encode_time,
+                   uint64_t response_size, bool failed );
+
+      /** the kept slow calls, oldest first */
+      std::vector<slow_api_call> get_slow_calls()const;
+      /** slow calls recorded since the start, kept or not */
+      uint64_t slow_call_count()const;
+
+      static const size_t max_argument_chars = 256;
+      static const size_t default_max_slow_calls = 100;
+
+      /** upper bounds in bytes for responses from 256B to 16MB */
+      static std::vector<double> size_buckets();
+
+   private:
+      struct method_metrics
+      {
+         graphene::utilities::metrics_histogram* response_size = nullptr;
+         graphene::utilities::metrics_histogram* encode_time = nullptr;
+      };
+      const method_metrics& get_method_metrics( const std::string& method );
+
+      graphene::utilities::metrics_registry*      _metrics;
+      graphene::utilities::metrics_counter*       _slow_calls_total = nullptr;
+      mutable std::mutex                          _mutex;
+      fc::microseconds                            _threshold;
+      size_t                                      _max_slow_calls = default_max_slow_calls;
+      uint64_t                                    _slow_call_count = 0;
+      std::deque<slow_api_call>                   _slow_calls;
+      std::map<std::string, method_metrics>       _method_metrics;
+};
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::slow_api_call,
+            (time)(method)(arguments)(remote_endpoint)(duration)(encode_time)(response_size)(failed) )
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+#include <graphene/utilities/metrics.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/thread_specific.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Runs read-only API calls on a pool of threads while the main thread goes on applying blocks
+ *
+ *  Every call holds database::with_read_lock() on its thread, so it sees the state between two blocks or
+ *  transactions and a heavy call delays block processing at most until the next block has to be applied, instead
+ *  of keeping the main thread busy.  The calling fiber waits for the result, other tasks of its thread keep
+ *  running meanwhile.  Without threads the calls run on the calling thread as before.
+ *
+ *  The calls of a @ref client take turns: at most one call per thread runs at once, light calls go before the heavy
+ *  ones that wait, and heavy calls occupy at most limits::heavy_threads so light calls always find a thread.  Each
+ *  client may be held to a number of calls at once and to a share of the time of the threads.  Broadcasts do not
+ *  pass through the pool, they run on the main thread which the reads no longer occupy.  The turns are kept without
+ *  a lock, so the calls with a client are all made from one thread, the one of the API server.
+ *
+ *  run_batch() takes a single turn for a number of calls, which then read the state of one moment on one thread.
+ */
+class api_reader_pool
+{
+   public:
+      enum call_class
+      {
+         light_call = 0,
+         heavy_call = 1  ///< a call that may scan many objects
+      };
+
+      struct limits
+      {
+         /** threads heavy calls may occupy at once, 0 for all */
+         uint32_t heavy_threads     = 0;
+         /** calls one client may have running at once, further ones wait, 0 for no limit */
+         uint32_t client_calls      = 0;
+         /** milliseconds per second the calls of one client may run, further ones fail until it is paid back,
+          *  0 for no limit */
+         uint32_t client_cpu_ms     = 0;
+      };
+
+      /** the calls of one API connection, which share its quotas */
+      class client
+      {
+         public:
+            uint32_t calls_running()const { return _running; }
+
+         private:
+            friend class api_reader_pool;
+            uint32_t         _running = 0;
+            /** time of its calls the quota has not paid back yet as of _paid */
+            fc::microseconds _debt;
+            fc::time_point   _paid;
+      };
+
+      /**
+       * Runs the calls of every pool on the calling thread while it lives, without waiting for a turn, see
+       * run_batch(), whose turn and read lock they run under.
+       *
+       * The scope covers the fc task that opened it only, the other tasks of the thread, which run while a call of the
+       * batch yields, wait for their turn as before.
+       */
+      class inline_scope
+      {
+         public:
+            inline_scope();
+            ~inline_scope();
+
+            static bool active();
+
+         private:
+            static fc::task_specific_ptr<uint32_t> _depth;
+      };
+
+      api_reader_pool( const chain::database& db, uint32_t threads );
+
+      template<typename Reader>
+      auto run( Reader&& reader ) -> decltype( reader() )
+      {
+         if( _threads.empty() || inline_scope::active() )
+            return reader();
+         fc::thread& thread = *_threads[ _next++ % _threads.size() ];
+         return thread.async( [this, &reader]() { return _db.with_read_lock( reader ); }, "api_reader" ).wait();
+      }
+
+      /** runs @ref reader as a call of @ref c once it is its turn, failing when @ref c used up its time */
+      template<typename Reader>
+      auto run( client& c, const char* method, Reader&& reader ) -> decltype( reader() )
+      {
+         if( inline_scope::active() )
+            return reader();
+         turn t( *this, c, classify( method ) );
+         return run( std::forward<Reader>( reader ) );
+      }
+
+      /**
+       * Runs @ref batch as one call of @ref c of class @ref cls: it waits for its turn, then runs on one thread under
+       * one read lock, and the calls it makes with run() run inline, so they all read the state of one moment without
+       * holding up the thread applying blocks.  The batch counts as one call against limits::client_calls and with
+       * all of its time against the time quota of @ref c.
+       */
+      template<typename Batch>
+      void run_batch( client& c, call_class cls, Batch&& batch )
+      {
+         turn t( *this, c, cls );
+         run( [&batch]() {
+            inline_scope one_view;
+            batch();
+         } );
+      }
+
+      size_t thread_count()const { return _threads.size(); }
+
+      void set_limits( const limits& l );
+      const limits& get_limits()const { return _limits; }
+      /** counts the time the calls waited for their turn by class, and the calls refused by the time quota */
+      void set_metrics( graphene::utilities::metrics_registry* metrics );
+
+      /** heavy_call for the calls of database_api that scan a number of objects the caller chooses */
+      static call_class classify( const char* method );
+
+      /** calls of all clients running and waiting for their turn */
+      uint32_t calls_running()const { return _running; }
+      size_t   calls_waiting()const { return _waiting[light_call].size() + _waiting[heavy_call].size(); }
+
+   private:
+      /** the turn of a call, from the time it may start until it ended */
+      class turn
+      {
+         public:
+            turn( api_reader_pool& pool, client& c, call_class cls );
+            ~turn();
+
+         private:
+            api_reader_pool& _pool;
+            client&          _client;
+            call_class       _class;
+            fc::time_point   _start;
+      };
+
+      struct waiter
+      {
+         client*                 c;
+         fc::promise<void>::ptr  ready;
+      };
+
+      /** throws when @ref c used up its time */
+      void check_quota( client& c );
+      void charge( client& c, fc::microseconds elapsed );
+      void admit( client& c, call_class cls );
+      void release( client& c, call_class cls, fc::microseconds elapsed );
+      bool can_start( const client& c, call_class cls )const;
+      void start( client& c, call_class cls );
+      /** starts the waiting calls that may start, light ones first */
+      void dispatch();
+      /** reduces the debt of @ref c by the quota of the time passed since it was last paid */
+      void pay_back( client& c )const;
+
+      const chain::database&                      _db;
+      std::atomic<uint32_t>                       _next;
+      std::vector< std::unique_ptr<fc::thread> >  _threads;
+
+      limits                                      _limits;
+      uint32_t                                    _running = 0;
+      uint32_t                                    _heavy_running = 0;
+      std::deque<waiter>                          _waiting[2];
+
+      graphene::utilities::metrics_histogram*     _queue_seconds[2] = { nullptr, nullptr };
+      graphene::utilities::metrics_counter*       _refused = nullptr;
+};
+
+} } // graphene::app
@@ -24,8 +24,12 @@
 #pragma once
 
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_call_log.hpp>
+#include <graphene/app/block_production_statistics.hpp>
 #include <graphene/net/node.hpp>
 #include <graphene/chain/database.hpp>
+#include <graphene/utilities/executor.hpp>
+#include <graphene/utilities/metrics.hpp>
 
 #include <boost/program_options.hpp>
 
@@ -34,6 +38,10 @@ namespace graphene { namespace app {
    using std::string;
 
    class abstract_plugin;
+   class api_reader_pool;
+   class chain_write_queue;
+   class confirmation_registry;
+   class applied_operation_log;
 
    class application
    {
@@ -79,8 +87,26 @@ namespace graphene { namespace app {
 
          net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+         /** the log of applied-operations-log, null when it is disabled */
+         std::shared_ptr<applied_operation_log> applied_operations()const;
+         /** the data directory passed to initialize() */
+         const fc::path& data_dir()const;
+         /** the threads serving read-only API calls, see api-reader-threads */
+         std::shared_ptr<api_reader_pool> api_readers()const;
+         /** the transactions broadcast_transaction_with_callback() calls of all connections wait for */
+         std::shared_ptr<confirmation_registry> confirmations()const;
+         /** served at /metrics of metrics-endpoint, plugins may add their own metrics */
+         graphene::utilities::metrics_registry& metrics();
+         /** the response sizes and slow calls of the API connections, see network_node_api::get_slow_api_calls() */
+         const api_call_log& api_calls()const;
+         /** the worker threads the subsystems and plugins share, null before initialize() */
+         graphene::utilities::executor* executor()const;
+         /** what writes to the chain database goes through, see chain_write_queue */
+         chain_write_queue& write_queue();
 
          void set_block_production(bool producing_blocks);
+         /** filled in by the witness plugin, see network_node_api::get_block_production_statistics() */
+         block_production_statistics& get_block_production_statistics();
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
          void set_api_access_info(const string& username, api_access_info&& permissions);
 
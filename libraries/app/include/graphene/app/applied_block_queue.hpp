@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Hands the blocks applied to the chain database to a plugin worker thread once they are irreversible
+ *
+ *  A plugin that writes into its own object store instead of the chain database cannot have its changes undone by
+ *  a fork switch, so every applied block is kept together with its applied operations until it becomes
+ *  irreversible.  Blocks that a fork switch replaces are dropped.  The handler then runs on the worker thread, one
+ *  block after another, while the chain goes on with the next block.
+ *
+ *  At most max_queued blocks wait for the worker.  Applying a block while the queue is full waits until the worker
+ *  is done with the oldest one, so a slow plugin slows the chain down instead of using up memory.
+ */
+class applied_block_queue
+{
+   public:
+      struct applied_block_data
+      {
+         chain::signed_block                                            block;
+         std::vector< fc::optional< chain::operation_history_object > > operations;
+      };
+      typedef std::function< void( const applied_block_data& ) > handler_type;
+
+      applied_block_queue( const std::string& thread_name, handler_type handler, uint32_t max_queued );
+      /** waits for the queued blocks */
+      ~applied_block_queue();
+
+      /** subscribes to the applied_block signal of @ref db */
+      void connect( chain::database& db );
+      /** waits until the worker has handled every queued block */
+      void flush();
+
+      uint32_t queued_blocks()const { return _queued.size(); }
+
+   private:
+      void on_applied_block( const chain::database& db, const chain::signed_block& b );
+      void dispatch( const std::shared_ptr<const applied_block_data>& data );
+
+      handler_type                                            _handler;
+      uint32_t                                                _max_queued;
+      fc::thread                                              _thread;
+      /** applied blocks that are not irreversible yet, oldest first */
+      std::deque< std::shared_ptr<const applied_block_data> > _reversible;
+      std::deque< fc::future<void> >                          _queued;
+      graphene::chain::scoped_observer_connection             _connection;
+};
+
+} } // graphene::app
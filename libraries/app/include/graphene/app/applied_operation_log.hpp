@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Keeps the applied operations of every irreversible block on disk
+ *
+ *  The operations of a block, virtual operations included, are the same each time the block is applied, so a
+ *  plugin that lost or dropped its state can rebuild it from this log instead of replaying the chain.  Blocks are
+ *  appended to "ops.NNNNNN" segment files of segment_size blocks each, and an "index" file holds the position of
+ *  every block at block_num * entry size, so a lookup is a single seek.  Blocks the log was not running for are
+ *  simply missing from it.
+ */
+class applied_operation_log
+{
+   public:
+      typedef std::vector< fc::optional< chain::operation_history_object > > operation_list;
+
+      /** @param segment_size number of blocks per segment file, has no effect on an existing log */
+      void open( const fc::path& dir, uint32_t segment_size = 100000 );
+      bool is_open()const;
+      void flush();
+      void close();
+
+      /** stores the operations of block_num, blocks up to the last one stored are left as they are */
+      void append( uint32_t block_num, const operation_list& operations );
+
+      /** @return the highest block number stored, 0 if the log is empty */
+      uint32_t last_block_num()const;
+      /** @return the operations of block_num, nothing if the log does not have that block */
+      fc::optional<operation_list> fetch( uint32_t block_num )const;
+
+   private:
+      struct entry;
+
+      fc::path           segment_path( uint32_t segment )const;
+      std::fstream&      segment_stream( uint32_t segment )const;
+      bool               read_entry( uint32_t block_num, entry& e )const;
+
+      fc::path                                                  _dir;
+      uint32_t                                                  _segment_size = 0;
+      uint32_t                                                  _last_block_num = 0;
+      mutable std::fstream                                      _index;
+      mutable std::map<uint32_t, std::unique_ptr<std::fstream>> _segments;
+      /** the log is appended to from a worker thread while plugins read it */
+      mutable std::mutex                                        _mutex;
+};
+
+} } // graphene::app
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Keeps the keys and addresses reachable from the active authority of accounts, flattened
+ *
+ *  get_potential_signatures walks the account authorities of the accounts a transaction needs down to
+ *  max_authority_depth and collects every key it meets.  Wallets and multisig services ask this again for the same
+ *  accounts with every transaction, so the cache keeps, for an account and the depth left below it, the union of
+ *  the keys and addresses of its active authority and of the accounts it names, and remembers the active
+ *  authorities of the accounts it went through.
+ *
+ *  A walk without signatures only ever stops early at an authority that the temporary account or a zero threshold
+ *  satisfies, then the union is more than the walk collects and reach::exact is false.  Callers fall back to the
+ *  walk in that case.
+ *
+ *  The cache observes every index of the database, and forgets everything once the active authority of an account
+ *  it went through changes, undo included.  Other account changes leave it alone.
+ */
+class authority_key_cache : public graphene::db::index_observer
+{
+   public:
+      struct reach
+      {
+         fc::flat_set<chain::public_key_type> keys;
+         fc::flat_set<chain::address>         addresses;
+         bool                             exact = true;
+      };
+
+      /** @return the cache of @ref db, which observes the indexes of @ref db from the first call on */
+      static std::shared_ptr<authority_key_cache> get( chain::database& db );
+
+      /** the reach of the active authority of @ref account following account authorities @ref depth levels down */
+      std::shared_ptr<const reach> get_active_reach( const chain::database& db, chain::account_id_type account,
+                                                     uint32_t depth );
+      /**
+       * adds the reach of @ref auth to @ref into, the way get_active_reach() follows an active authority, with the keys
+       * of @ref auth itself only if @ref with_keys
+       */
+      void add_reach( const chain::database& db, const chain::authority& auth, uint32_t depth, bool with_keys,
+                      reach& into );
+
+      size_t size()const;
+
+      virtual void on_add( const graphene::db::object& obj ) override    { invalidate( obj, false ); }
+      virtual void on_remove( const graphene::db::object& obj ) override { invalidate( obj, true ); }
+      virtual void on_modify( const graphene::db::object& obj ) override { invalidate( obj, false ); }
+
+      /** the cache is dropped whole once it holds this many reaches */
+      static const size_t max_reaches = 100000;
+
+   private:
+      void invalidate( const graphene::db::object& obj, bool removed );
+
+      typedef std::pair<chain::account_id_type, uint32_t> reach_key;
+
+      mutable std::mutex                                             _mutex;
+      std::map< reach_key, std::shared_ptr<const reach> >            _reaches;
+      /** the active authorities the reaches were made from */
+      std::map< chain::account_id_type, chain::authority >           _authorities;
+      /** counts the times the cache was dropped, reaches made before are not kept */
+      uint64_t                                                       _epoch = 0;
+};
+
+} } // graphene::app
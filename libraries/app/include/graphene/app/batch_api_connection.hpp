@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api_call_log.hpp>
+
+#include <fc/rpc/websocket_api.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief A websocket API connection that also takes JSON-RPC 2.0 batches, over websocket and HTTP alike
+ *
+ *  A message that is a JSON array is a batch: its calls are dispatched in order in one pass and answered by one array
+ *  of the responses of the calls that have an id.  The reads of the API given to set_batch_runner() that follow
+ *  each other run together through its runner, on a reader thread as one call, so they all read the state of one
+ *  moment; the other calls run on the thread of the connection in between, as do all of them without a runner.
+ *
+ *  The calls added with add_direct_call() write their result as JSON themselves, the others are answered with the
+ *  JSON of the variant the API returns.  Messages that are no calls are handled by fc::rpc::websocket_api_connection.
+ *
+ *  Every call answered is recorded in the api_call_log given, if any, with its time, the time spent encoding its
+ *  result and the size of its response.
+ */
+class batch_api_connection : public fc::rpc::websocket_api_connection
+{
+   public:
+      /** appends the JSON of the result of a call with @ref args to @ref out */
+      typedef std::function<void( const fc::variants& args, std::string& out )> direct_call;
+      /** runs @ref batch as one call, a heavy one if @ref heavy, see database_api::run_batch() */
+      typedef std::function<void( bool heavy, const std::function<void()>& batch )> batch_runner;
+
+      /**
+       *  @param call_log where the calls are recorded, may be null
+       *  @param remote_endpoint the client's address, for the slow calls
+       */
+      explicit batch_api_connection( fc::http::websocket_connection& c, api_call_log* call_log = nullptr,
+                                     std::string remote_endpoint = std::string() );
+
+      /** answers @ref method of the API registered as @ref api by @ref call, which must write what the method returns */
+      void add_direct_call( fc::api_id_type api, const std::string& method, direct_call call );
+
+      /** runs the calls of a batch to the methods of the API registered as @ref api that @ref is_read names through
+       *  @ref runner, as many of them in a row as there are */
+      void set_batch_runner( fc::api_id_type api, std::function<bool( const std::string& method )> is_read,
+                             batch_runner runner );
+
+      /** calls a batch may hold at most */
+      static const size_t max_batch_calls = 100;
+
+   private:
+      std::string on_batch_message( const std::string& message, bool send_message );
+      /** the response to the call @ref request, empty when it has no id */
+      std::string handle_call( const fc::variant& request );
+      /** true if @ref request is a call the batch runner takes, @ref heavy set if it is a heavy one */
+      bool batched_read( const fc::variant& request, bool& heavy )const;
+      /** writes the result of @ref call to @ref out if it is a direct call, false if it is none */
+      bool call_direct( const fc::rpc::request& call, std::string& out );
+      void record_call( const fc::rpc::request& call, fc::microseconds duration,
+                        const fc::optional<fc::microseconds>& encode_time, uint64_t response_size, bool failed );
+
+      std::map< std::pair<fc::api_id_type, std::string>, direct_call > _direct_calls;
+      fc::api_id_type                                                   _batch_api = 0;
+      std::function<bool( const std::string& )>                         _batch_is_read;
+      batch_runner                                                      _batch_runner;
+      api_call_log*                                                     _call_log;
+      std::string                                                       _remote_endpoint;
+};
+
+} } // graphene::app
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Fills the block log of a new node from HTTP mirrors of the block logs of other nodes, up to a checkpoint
+ *
+ *  A mirror is any HTTP server that serves the database/block_num_to_block directory of a node whose block log has
+ *  segments, e.g. http://host:8080/block_num_to_block.  Its "layout" file tells the segment size, the entries of a
+ *  segment are fetched from its "index" and the blocks from its "blocks.NNNNNN" file, both with range requests.
+ *  Several segments download at once, from the mirrors in turn, and a segment that fails is tried at the next mirror.
+ *
+ *  The blocks are only trusted through the checkpoints: every block has to link to the one before it, its
+ *  transactions have to match its merkle root and the blocks at the checkpoints have to have their ids, so all
+ *  blocks up to the highest checkpoint are the ones it names.  A segment of a mirror that fails any of this counts
+ *  as a failed download.  The blocks are stored in a block log of their own next to the one of the node, which
+ *  replaces it once the highest checkpoint is reached.  An interrupted bootstrap continues where it stopped, one
+ *  that no mirror can complete leaves nothing behind.  The state is then replayed from the block log and the blocks
+ *  after the checkpoint come over p2p.
+ */
+class block_log_bootstrap
+{
+   public:
+      /** @param mirrors base URLs of the mirrors, plain http only */
+      block_log_bootstrap( std::vector<std::string> mirrors, uint32_t parallel_downloads );
+
+      /** the layout and compression of the block log written, see block_database */
+      void set_storage( uint32_t segment_size, int compression_level );
+
+      /**
+       *  Fills the empty block log in @ref block_log_dir with the blocks through the highest checkpoint.
+       *  @return the number of the last block stored, 0 when there are no checkpoints or the block log has blocks
+       */
+      uint32_t run( const fc::path& block_log_dir, const fc::flat_map<uint32_t, chain::block_id_type>& checkpoints );
+
+      /** the most bytes taken from a mirror in one reply */
+      static const uint64_t max_reply_size = 256 * 1024 * 1024;
+
+   private:
+      typedef fc::flat_map<uint32_t, chain::block_id_type> checkpoint_map;
+
+      /** the bytes of @ref path below the base URL of mirror @ref mirror, all of them or @ref size from @ref offset */
+      std::vector<char> fetch( size_t mirror, const std::string& path, uint64_t offset = 0, uint64_t size = 0 )const;
+      /**
+       * the blocks first to last of the first mirror that has them right, they are all in one segment of the
+       * mirrors; with @ref previous the first block has to link to it.  @ref rejected is set when a mirror sent
+       * blocks that are not the right ones, rather than none at all
+       */
+      std::vector<chain::signed_block> fetch_segment( size_t first_mirror, uint32_t first, uint32_t last,
+                                                      const checkpoint_map& checkpoints,
+                                                      const fc::optional<chain::block_id_type>& previous,
+                                                      bool& rejected )const;
+
+      std::vector<std::string>  _mirrors;
+      uint32_t                  _parallel_downloads;
+      uint32_t                  _segment_size = 0;
+      int                       _compression_level = 0;
+      /** the segment size of the block logs of the mirrors, which all have to have the same */
+      uint32_t                  _mirror_segment_size = 0;
+};
+
+} } // graphene::app
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <deque>
+#include <map>
+#include <string>
+
+namespace graphene { namespace app {
+
+/** What happened when a witness of this node came to produce a block */
+struct block_production_attempt
+{
+   fc::time_point_sec      slot_time;        ///< the slot that was checked
+   std::string             condition;        ///< the outcome, a block_production_condition of the witness plugin
+   int64_t                 wakeup_drift = 0; ///< microseconds the production loop woke up after it was scheduled to
+   int64_t                 generate_time = 0;///< microseconds spent putting the block together, signing and pushing it
+   uint32_t                block_num = 0;
+   uint32_t                block_size = 0;   ///< packed size of the block in bytes
+   chain::block_assembly   assembly;         ///< how the transactions of the block were picked
+   int64_t                 broadcast_time = 0; ///< microseconds from the slot until the block was handed to the p2p node
+};
+
+/**
+ *  @brief The recent block production attempts of the witnesses of this node and the distributions over all of them
+ *
+ *  Only the attempts at slots of our witnesses are kept, the loop wakes up every second and is mostly told it is
+ *  not our turn or that the node is not synced.  The counts by condition cover every wakeup.  This tells a slow
+ *  machine (generate_time) from a large pending pool (the assembly counts) or a drifting clock (wakeup_drift).
+ */
+struct block_production_statistics
+{
+   std::map<std::string, uint64_t>         conditions;
+   chain::latency_histogram                wakeup_drift;
+   chain::latency_histogram                generate_time;
+   chain::latency_histogram                broadcast_time;
+   /** in bytes rather than microseconds */
+   chain::latency_histogram                block_size;
+   uint64_t                                transactions_included = 0;
+   uint64_t                                transactions_postponed = 0;
+   uint64_t                                transactions_failed = 0;
+   std::deque<block_production_attempt>    recent_attempts;
+
+   static const size_t max_recent_attempts = 100;
+
+   void add( const block_production_attempt& attempt, bool keep );
+   /** the block of an earlier attempt was handed to the p2p node */
+   void broadcast( uint32_t block_num, int64_t microseconds );
+};
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::block_production_attempt,
+            (slot_time)(condition)(wakeup_drift)(generate_time)(block_num)(block_size)(assembly)(broadcast_time) )
+FC_REFLECT( graphene::app::block_production_statistics,
+            (conditions)(wakeup_drift)(generate_time)(broadcast_time)(block_size)
+            (transactions_included)(transactions_postponed)(transactions_failed)(recent_attempts) )
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/utilities/metrics.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief Runs the writes to the chain state on the chain thread, the waiting ones by the priority of their class
+ *
+ *  The chain database is written by the thread that applies blocks, its tasks yield to each other cooperatively.
+ *  A write handed to run() becomes a task of that thread with the priority of its class, so once the running task
+ *  yields the waiting blocks go first, then the blocks the local witnesses produce, then the transactions
+ *  broadcast through the API and last the transactions received from peers.  A write that runs is never
+ *  interrupted, priorities only order the ones waiting.
+ *
+ *  run() may be called from any thread, the number of writes of each class waiting for their turn is kept for
+ *  the metrics.
+ */
+class chain_write_queue
+{
+   public:
+      enum write_class
+      {
+         block_write,
+         production_write,
+         api_write,
+         p2p_write,
+         write_class_count
+      };
+
+      /** the writes run on the thread constructing the queue */
+      chain_write_queue();
+
+      /** runs @ref write on the chain thread and returns what it returns, exceptions included */
+      template<typename Write>
+      auto run( write_class cls, Write&& write ) -> decltype( write() )
+      {
+         _waiting[cls].fetch_add( 1, std::memory_order_relaxed );
+         return _thread->async( [this, cls, &write]() -> decltype( write() ) {
+            _waiting[cls].fetch_sub( 1, std::memory_order_relaxed );
+            return write();
+         }, task_names[cls], fc::priority( write_class_count - cls ) ).wait();
+      }
+
+      /** writes of @ref cls waiting for the chain thread */
+      uint32_t waiting( write_class cls )const { return _waiting[cls].load( std::memory_order_relaxed ); }
+
+      /** adds the writes of each class waiting to @ref metrics */
+      void add_metrics( graphene::utilities::metrics_registry& metrics );
+
+      static const char* class_name( write_class cls );
+
+   private:
+      static const char* const   task_names[write_class_count];
+
+      fc::thread*                _thread;
+      std::atomic<uint32_t>      _waiting[write_class_count];
+};
+
+} } // graphene::app
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace app {
+
+/** sent to the callback of network_broadcast_api::broadcast_transaction_with_callback() */
+struct transaction_confirmation
+{
+   chain::transaction_id_type     id;
+   uint32_t                       block_num;
+   uint32_t                       trx_num;
+   chain::processed_transaction   trx;
+};
+
+/**
+ *  @brief The transactions API connections wait for, shared by all of them
+ *
+ *  Every applied block is matched once against the waiting transactions, by the ids the chain database computed
+ *  while applying it, and only the callbacks of included transactions run.  A transaction that expired without
+ *  being included can never be, so it is forgotten at the first block after its expiration.
+ */
+class confirmation_registry
+{
+   public:
+      typedef std::function<void(const fc::variant& /*transaction_confirmation*/)> callback_type;
+
+      /** subscribes to the applied_block signal of @ref db */
+      explicit confirmation_registry( chain::database& db );
+
+      /**
+       * Calls cb on the current thread with a transaction_confirmation after trx is included into a block, once.
+       * Nothing is called when owner is gone by then, which the callback keeps alive meanwhile.
+       */
+      void watch( const chain::signed_transaction& trx, std::weak_ptr<const void> owner, callback_type cb );
+
+      /** number of waiting callbacks */
+      size_t size()const;
+
+   private:
+      struct waiter
+      {
+         chain::transaction_id_type   id;
+         fc::time_point_sec           expiration;
+         std::weak_ptr<const void>    owner;
+         callback_type                callback;
+      };
+      struct by_id;
+      struct by_expiration;
+      typedef boost::multi_index_container<
+         waiter,
+         boost::multi_index::indexed_by<
+            boost::multi_index::hashed_non_unique< boost::multi_index::tag<by_id>,
+               boost::multi_index::member<waiter, chain::transaction_id_type, &waiter::id>,
+               std::hash<chain::transaction_id_type> >,
+            boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+               boost::multi_index::member<waiter, fc::time_point_sec, &waiter::expiration> >
+         >
+      > waiter_index;
+
+      void on_applied_block( const chain::signed_block& b );
+
+      const chain::database&                        _db;
+      mutable std::mutex                            _mutex;
+      waiter_index                                  _waiters;
+      graphene::chain::scoped_observer_connection   _connection;
+};
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::transaction_confirmation, (id)(block_num)(trx_num)(trx) )
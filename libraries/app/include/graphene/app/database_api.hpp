@@ -23,7 +23,10 @@
  */
 #pragma once
 
+#include <graphene/app/api_reader_pool.hpp>
 #include <graphene/app/full_account.hpp>
+#include <graphene/app/serialized_object_cache.hpp>
+#include <graphene/app/subscription_hub.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
 
@@ -43,6 +46,8 @@
 
 #include <graphene/market_history/market_history_plugin.hpp>
 
+#include <graphene/utilities/metrics.hpp>
+
 #include <fc/api.hpp>
 #include <fc/optional.hpp>
 #include <fc/variant_object.hpp>
@@ -51,6 +56,7 @@
 
 #include <boost/container/flat_set.hpp>
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
@@ -107,6 +113,66 @@ struct market_trade
    double                     value;
 };
 
+/** one holder of an asset, see database_api::get_asset_holders_page() */
+struct asset_holder
+{
+   account_id_type            account;
+   share_type                 amount;
+};
+
+/** balances of one account, see database_api::get_balances_for_accounts() */
+struct account_balances
+{
+   account_id_type            account;
+   vector<asset>              balances;
+};
+
+/** what one key gives access to, see database_api::get_full_key_references() */
+struct key_references
+{
+   vector<account_id_type>          accounts;
+   vector<balance_object>           balances;
+   vector<vesting_balance_object>   vesting_balances;
+};
+
+/**
+ * one page of a list returned by the database_api calls ending in _page; @ref next is passed back for the page after
+ * it, and is empty after the last page. It stands for the index position of the next object, so a page costs the same
+ * however deep it is, and objects created or removed meanwhile neither shift nor repeat the pages after them.
+ */
+template<typename T>
+struct api_page
+{
+   vector<T> items;
+   string    next;
+};
+
+/** one block of a database_api::stream_blocks() batch */
+struct streamed_block
+{
+   uint32_t                           block_num = 0;
+   signed_block                       block;
+   /** every operation applied by the block including the virtual ones, when requested and the block was streamed live */
+   vector<operation_history_object>   applied_operations;
+};
+
+/** what applying one transaction of a database_api::simulate_transactions() batch did */
+struct simulated_transaction
+{
+   /** false when the transaction failed, the rest of the batch then sees the state without it */
+   bool                               success = false;
+   /** the transaction and, on success, its operation_results */
+   processed_transaction              trx;
+   /** the fee each operation pays and the least the fee schedule asks of it in the same asset */
+   vector<asset>                      fees;
+   vector<asset>                      required_fees;
+   /** the operations applied, the virtual ones such as order fills included */
+   vector<operation_history_object>   applied_operations;
+   /** the objects created, modified or removed, in id order */
+   vector<object_id_type>             impacted_objects;
+   string                             error;
+};
+
 /**
  * @brief The database_api class implements the RPC API for the chain database.
  *
@@ -117,7 +183,13 @@ struct market_trade
 class database_api
 {
    public:
-      database_api(graphene::chain::database& db);
+      /** @param market_history when given, trade history is read through it, as with market-history-async the
+       *  history is not kept in @ref db
+       *  @param readers when given, the calls that only read the object indexes run on its threads
+       *  @param metrics when given, those calls are counted and timed by method in it */
+      database_api(graphene::chain::database& db, const market_history_plugin* market_history = nullptr,
+                   std::shared_ptr<api_reader_pool> readers = nullptr,
+                   graphene::utilities::metrics_registry* metrics = nullptr);
       ~database_api();
 
       /////////////
@@ -133,11 +205,39 @@ class database_api
        */
       fc::variants get_objects(const vector<object_id_type>& ids)const;
 
+      /**
+       * @brief Get the objects corresponding to the provided IDs in their binary form
+       * @param ids IDs of the objects to retrieve
+       * @return The objects packed by fc::raw, in the order they are mentioned in ids
+       *
+       * Works like @ref get_objects, but every object is sent as a single hex string laid out as the FC_REFLECT
+       * of its type, which js_operation_serializer describes, instead of a tree of JSON values.  The type follows
+       * from the space and type of its ID.  If an ID does not map to an object, null is returned in its position.
+       */
+      vector<optional<vector<char>>> get_packed_objects(const vector<object_id_type>& ids)const;
+
+      /**
+       * @return how well the node's cache of the objects returned by get_objects and get_full_accounts does
+       */
+      object_cache_statistics get_object_cache_statistics()const;
+
       ///////////////////
       // Subscriptions //
       ///////////////////
 
       void set_subscribe_callback( std::function<void(const variant&)> cb, bool clear_filter );
+      /**
+       * @brief Choose how the objects this connection subscribes to are remembered
+       * @param filter exact_subscription_filter by default, bloom_subscription_filter to trade a few unrelated
+       * updates for less memory when subscribing to very many objects
+       *
+       * This removes every object subscription.
+       */
+      void set_subscription_filter( subscription_filter_type filter );
+      /**
+       * @return the bytes that the object subscriptions of this connection take up on the node
+       */
+      uint64_t get_subscription_memory()const;
       void set_pending_transaction_callback( std::function<void(const variant&)> cb );
       void set_block_applied_callback( std::function<void(const variant& block_id)> cb );
       /**
@@ -165,6 +265,59 @@ class database_api
        */
       optional<signed_block> get_block(uint32_t block_num)const;
 
+      /**
+       * @brief Retrieve consecutive blocks in their binary form
+       * @param first_block_num Height of the first block to be returned
+       * @param count Number of blocks to return, at most 100
+       * @return the blocks packed by fc::raw as hex strings, null for blocks that were not found
+       *
+       * Irreversible blocks are sent as they are stored on disk, without unpacking them.
+       */
+      vector<optional<vector<char>>> get_packed_blocks(uint32_t first_block_num, uint32_t count)const;
+
+      /**
+       * @brief Retrieve the object changes of consecutive irreversible blocks, for nodes copying the state
+       * @param first_block_num Height of the first block whose changes are returned
+       * @param count Number of blocks to return, at most 100
+       * @return a block_state_diff packed by fc::raw for each block, stopping at the first block that was not recorded
+       *
+       * Only nodes started with state-diff-history record the changes, see database::apply_state_diff().
+       */
+      vector<vector<char>> get_packed_state_diffs(uint32_t first_block_num, uint32_t count)const;
+
+      /**
+       * @brief Retrieve the hash of the object state after a recent block
+       * @param block_num Height of the block
+       * @return the state hash after the block, null if it is not one of the blocks kept
+       *
+       * Only nodes started with state-hash-history keep the hashes.  Nodes on the same chain running the same
+       * plugins report the same hash for the same block.
+       */
+      optional<block_state_hash> get_state_hash(uint32_t block_num)const;
+
+      /**
+       * @brief Stream a range of blocks, then continue with every new block
+       * @param callback Callback method which is passed each batch of blocks
+       * @param start_block_num Height of the first block to be streamed
+       * @param end_block_num Height of the last block to be streamed, 0 to keep streaming the blocks applied from now on
+       * @param include_applied_ops Whether to add the applied operations, including virtual ones, to blocks that are
+       * streamed as they are applied; blocks from disk only carry the results in their transactions
+       *
+       * Callback will be passed a variant containing a vector<streamed_block> of at most 100 consecutive blocks.
+       * The stored blocks are read one after another and sent no further than 2000 blocks ahead of the last
+       * @ref acknowledge_streamed_blocks call.  Once the stream reaches the head block every applied block is
+       * sent on its own; after a fork switch the blocks of the new branch follow again with lower numbers.  A
+       * connection has one stream, starting another ends the previous one.
+       */
+      void stream_blocks( std::function<void(const variant&)> callback, uint32_t start_block_num,
+                          uint32_t end_block_num, bool include_applied_ops );
+      /**
+       * @brief Confirm that the blocks up to @ref block_num arrived, which lets the stream send further blocks
+       */
+      void acknowledge_streamed_blocks( uint32_t block_num );
+      /** @brief Stop the block stream */
+      void cancel_block_stream();
+
       /**
        * @brief used to fetch an individual transaction.
        */
@@ -212,6 +365,17 @@ class database_api
 
       vector<vector<account_id_type>> get_key_references( vector<public_key_type> key )const;
 
+      /**
+       * @brief Find everything each of the keys gives access to
+       * @param keys the public keys to look up
+       * @return per key the accounts with the key or one of its addresses in their active or owner authority, the
+       * balances owned by any of its addresses and the vesting balances of those accounts
+       *
+       * Wallets importing many keys at once, as exchanges do, get the results of @ref get_key_references and
+       * @ref get_balance_objects for all of them in a single call, the PTS address forms of every key included.
+       */
+      vector<key_references> get_full_key_references( const vector<public_key_type>& keys )const;
+
       //////////////
       // Accounts //
       //////////////
@@ -235,9 +399,26 @@ class database_api
        * accounts. If any of the strings in @ref names_or_ids cannot be tied to an account, that input will be
        * ignored. All other accounts will be retrieved and subscribed.
        *
+       * The call fails when the accounts hold more objects together than @ref max_full_account_objects, those are
+       * read with @ref get_full_accounts_paged.
        */
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
 
+      /**
+       * @brief Fetch the objects of the specified accounts a page at a time
+       * @param names_or_ids Each item must be the name or ID of an account to retrieve
+       * @param query How many objects of each section to return, and where to continue the sections of a previous call
+       * @param subscribe true to subscribe to updates of the given accounts
+       * @return Map of string from @ref names_or_ids to the corresponding account with its section counts
+       *
+       * Each section of an account holds at most query.limit objects, and all the sections of all the accounts at
+       * most @ref max_full_account_objects. A section that was cut short has its next_page cursor set, passing
+       * next_page back in query.start returns the following page of those sections alone. With query.summary only
+       * the accounts and the counts of their sections are returned.
+       */
+      std::map<string,full_account_page> get_full_accounts_paged( const vector<string>& names_or_ids,
+                                                                  const full_account_query& query, bool subscribe );
+
       optional<account_object> get_account_by_name( string name )const;
 
       /**
@@ -274,6 +455,39 @@ class database_api
        */
       vector<asset> get_account_balances(account_id_type id, const flat_set<asset_id_type>& assets)const;
 
+      /**
+       * @brief Get the balances of an account a page at a time, in the order of their asset IDs
+       * @param id ID of the account to get balances for
+       * @param limit Maximum number of balances to retrieve, must not exceed 1000
+       * @param cursor next of the previous page, empty for the first page
+       */
+      api_page<asset> get_account_balances_page( account_id_type id, uint32_t limit, const string& cursor )const;
+
+      /**
+       * @brief Get the balances of many accounts at once
+       * @param accounts IDs of the accounts to get balances for, at most 100000
+       * @param assets IDs of the assets to get balances of; if empty, get all assets each account has a balance in
+       * @return The balances of each account, in the order of @ref accounts
+       */
+      vector<account_balances> get_balances_for_accounts( const vector<account_id_type>& accounts,
+                                                          const flat_set<asset_id_type>& assets )const;
+
+      /**
+       * @brief Request the balances of a set of accounts that change
+       * @param callback Callback method which is called with the balances that changed
+       * @param accounts IDs of the accounts to follow, at most 100000
+       * @param assets IDs of the assets to follow; if empty, all assets
+       *
+       * Callback will be passed a variant containing a vector<account_balances> with the new amount of each balance
+       * that changed since the last call, both in blocks and in pending transactions.  A new subscription
+       * replaces the previous one of the connection.
+       */
+      void subscribe_to_balances( std::function<void(const variant&)> callback,
+                                  const vector<account_id_type>& accounts, const flat_set<asset_id_type>& assets );
+
+      /** @brief Stop the balance notifications of subscribe_to_balances */
+      void unsubscribe_from_balances();
+
       /// Semantically equivalent to @ref get_account_balances, but takes a name instead of an ID.
       vector<asset> get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const;
 
@@ -319,6 +533,21 @@ class database_api
        */
       vector<optional<asset_object>> lookup_asset_symbols(const vector<string>& symbols_or_ids)const;
 
+      /**
+       * @brief Get the holders of an asset a page at a time
+       * @param a ID of the asset
+       * @param limit Maximum number of holders to retrieve, must not exceed 1000
+       * @param cursor next of the previous page, empty for the first page
+       * @return The accounts holding a positive balance of the asset, largest balance first
+       */
+      api_page<asset_holder> get_asset_holders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
+
+      /**
+       * @brief Get the number of holders of an asset and the total they hold in balances, without visiting them
+       * @param a ID of the asset
+       */
+      asset_holder_statistics get_asset_holders_count( asset_id_type a )const;
+
       /////////////////////
       // Markets / feeds //
       /////////////////////
@@ -348,6 +577,35 @@ class database_api
        */
       vector<force_settlement_object> get_settle_orders(asset_id_type a, uint32_t limit)const;
 
+      /**
+       * @brief Get the limit orders selling one asset for another a page at a time
+       * @param sell ID of the asset sold by the orders
+       * @param receive ID of the asset the orders receive
+       * @param limit Maximum number of orders to retrieve, must not exceed 1000
+       * @param cursor next of the previous page, empty for the first page
+       * @return The orders, ordered from the best price to the worst
+       */
+      api_page<limit_order_object> get_limit_orders_page( asset_id_type sell, asset_id_type receive, uint32_t limit,
+                                                          const string& cursor )const;
+
+      /**
+       * @brief Get the call orders of a market issued asset a page at a time
+       * @param a ID of the market issued asset
+       * @param limit Maximum number of orders to retrieve, must not exceed 1000
+       * @param cursor next of the previous page, empty for the first page
+       * @return The orders, ordered from the first to be margin called to the last
+       */
+      api_page<call_order_object> get_call_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
+
+      /**
+       * @brief Get the forced settlement orders of an asset a page at a time
+       * @param a ID of asset being settled
+       * @param limit Maximum number of orders to retrieve, must not exceed 1000
+       * @param cursor next of the previous page, empty for the first page
+       * @return The orders, ordered from earliest settlement date to latest
+       */
+      api_page<force_settlement_object> get_settle_orders_page( asset_id_type a, uint32_t limit, const string& cursor )const;
+
       /**
        *  @return all open margin positions for a given account id.
        */
@@ -372,6 +630,26 @@ class database_api
        */
       void unsubscribe_from_market( asset_id_type a, asset_id_type b );
 
+      /**
+       * @brief Request the order book changes of the market between two assets after each block
+       * @param callback Callback method which is called after each block that changed the market
+       * @param a First asset ID
+       * @param b Second asset ID
+       *
+       * Callback will be passed a variant containing a vector<order_book_delta>, the new size of each price level
+       * that changed in the block.  The side is given by the asset the level sells, and a level that is gone
+       * has a for_sale of 0.  The deltas are computed once per block for all subscribers.
+       */
+      void subscribe_to_market_deltas(std::function<void(const variant&)> callback,
+                   asset_id_type a, asset_id_type b);
+
+      /**
+       * @brief Unsubscribe from the order book changes of a given market
+       * @param a First asset ID
+       * @param b Second asset ID
+       */
+      void unsubscribe_from_market_deltas( asset_id_type a, asset_id_type b );
+
       /**
        * @brief Returns the ticker for the market assetA:assetB
        * @param a String name of the first asset
@@ -393,10 +671,25 @@ class database_api
        * @param base String name of the first asset
        * @param quote String name of the second asset
        * @param depth of the order book. Up to depth of each asks and bids, capped at 50. Prioritizes most moderate of each
-       * @return Order book of the market
+       * @return Order book of the market, one entry for each price level with the amounts of all orders at that price
        */
       order_book get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
 
+      /**
+       * @brief Returns the order books of several markets in one call
+       * @param markets Pairs of base and quote asset names, at most 100
+       * @param limit Depth of each order book, capped at 50
+       * @return The order books in the order of @ref markets
+       */
+      vector<order_book> get_order_books( const vector<std::pair<string,string>>& markets, unsigned limit = 50 )const;
+
+      /**
+       * @brief Returns the tickers of several markets in one call
+       * @param markets Pairs of base and quote asset names, at most 100
+       * @return The market tickers for the past 24 hours in the order of @ref markets
+       */
+      vector<market_ticker> get_tickers( const vector<std::pair<string,string>>& markets )const;
+
       /**
        * @brief Returns recent trades for the market assetA:assetB
        * Note: Currentlt, timezone offsets are not supported. The time must be UTC.
@@ -409,6 +702,13 @@ class database_api
        */
       vector<market_trade> get_trade_history( const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100 )const;
 
+      /**
+       * @brief Get the trades of @ref get_trade_history a page at a time
+       * @param cursor next of the previous page, empty for the first page
+       */
+      api_page<market_trade> get_trade_history_page( const string& base, const string& quote, fc::time_point_sec start,
+                                                     fc::time_point_sec stop, uint32_t limit, const string& cursor )const;
+
 
 
       ///////////////
@@ -444,6 +744,13 @@ class database_api
        */
       uint64_t get_witness_count()const;
 
+      /**
+       * @brief Get the witnesses with the most votes as of the last maintenance interval
+       * @param limit Maximum number of results to return -- must not exceed 1000
+       * @return Witnesses ordered by total_votes, most first
+       */
+      vector<witness_object> get_witnesses_by_votes(uint32_t limit)const;
+
       ///////////////////////
       // Committee members //
       ///////////////////////
@@ -472,6 +779,13 @@ class database_api
        */
       map<string, committee_member_id_type> lookup_committee_member_accounts(const string& lower_bound_name, uint32_t limit)const;
 
+      /**
+       * @brief Get the committee_members with the most votes as of the last maintenance interval
+       * @param limit Maximum number of results to return -- must not exceed 1000
+       * @return Committee_members ordered by total_votes, most first
+       */
+      vector<committee_member_object> get_committee_members_by_votes(uint32_t limit)const;
+
 
       /// WORKERS
 
@@ -537,12 +851,24 @@ class database_api
        */
       vector< fc::variant > get_required_fees( const vector<operation>& ops, asset_id_type id )const;
 
+      /**
+       * Applies the transactions one after the other to a copy of the current state, pending transactions
+       * included, without broadcasting them, so a transaction can depend on the ones before it.  The copy is shared
+       * by every database_api of the node, made by the first call after a block and reused by the following ones,
+       * each starting from it as it was made, so transactions that became pending after that are not part of it.
+       * At most 100 transactions.
+       * @return what each transaction did, or why it failed
+       */
+      vector<simulated_transaction> simulate_transactions( const vector<signed_transaction>& trxs )const;
+
       ///////////////////////////
       // Proposed transactions //
       ///////////////////////////
 
       /**
-       *  @return the set of proposed transactions relevant to the specified account id.
+       *  @return the set of proposed transactions relevant to the specified account id: those it is a required
+       *  or available approver of, and those of the accounts it can approve for through their authorities,
+       *  as deep as the authority checks go
        */
       vector<proposal_object> get_proposed_transactions( account_id_type id )const;
 
@@ -555,24 +881,65 @@ class database_api
        */
       vector<blinded_balance_object> get_blinded_balances( const flat_set<commitment_type>& commitments )const;
 
+      /////////////////////////////////////////////////////////////////////////
+      // The JSON of the results of calls, written without variants, see   //
+      // graphene::db::json_encoder.  These are not part of the RPC API.    //
+      /////////////////////////////////////////////////////////////////////////
+
+      /** append the JSON of the result of the call of the same name without _json to @ref out */
+      void get_objects_json( const vector<object_id_type>& ids, std::string& out )const;
+      void get_block_json( uint32_t block_num, std::string& out )const;
+      void get_full_accounts_json( const vector<string>& names_or_ids, bool subscribe, std::string& out );
+      void get_order_book_json( const string& base, const string& quote, unsigned limit, std::string& out )const;
+
+      /**
+       * Runs @ref batch, which makes calls that read_call() names, as one call of this API on a reader thread, see
+       * api_reader_pool::run_batch(); a heavy call if @ref heavy.  Not part of the RPC API.
+       */
+      void run_batch( bool heavy, const std::function<void()>& batch );
+      /** true for the methods that only read the state and so may run in a batch on a reader thread */
+      static bool read_call( const std::string& method );
+
+      /** the most objects of accounts get_full_accounts and get_full_accounts_paged return in a call, for every
+       *  database_api of the process, 0 for no limit */
+      static void     set_max_full_account_objects( uint32_t count ) { _max_full_account_objects = count; }
+      static uint32_t max_full_account_objects() { return _max_full_account_objects; }
+
+      static const uint32_t default_max_full_account_objects = 10000;
+
    private:
       std::shared_ptr< database_api_impl > my;
+
+      static std::atomic<uint32_t> _max_full_account_objects;
 };
 
 } }
 
 FC_REFLECT( graphene::app::order, (price)(quote)(base) );
 FC_REFLECT( graphene::app::order_book, (base)(quote)(bids)(asks) );
+GRAPHENE_JSON_DIRECT( graphene::app::order )
+GRAPHENE_JSON_DIRECT( graphene::app::order_book )
 FC_REFLECT( graphene::app::market_ticker, (base)(quote)(latest)(lowest_ask)(highest_bid)(percent_change)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_volume, (base)(quote)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_trade, (date)(price)(amount)(value) );
+FC_REFLECT( graphene::app::asset_holder, (account)(amount) );
+FC_REFLECT( graphene::app::account_balances, (account)(balances) );
+FC_REFLECT( graphene::app::key_references, (accounts)(balances)(vesting_balances) );
+FC_REFLECT_TEMPLATE( (typename T), graphene::app::api_page<T>, (items)(next) );
+FC_REFLECT( graphene::app::streamed_block, (block_num)(block)(applied_operations) );
+FC_REFLECT( graphene::app::simulated_transaction,
+            (success)(trx)(fees)(required_fees)(applied_operations)(impacted_objects)(error) );
 
 FC_API(graphene::app::database_api,
    // Objects
    (get_objects)
+   (get_packed_objects)
+   (get_object_cache_statistics)
 
    // Subscriptions
    (set_subscribe_callback)
+   (set_subscription_filter)
+   (get_subscription_memory)
    (set_pending_transaction_callback)
    (set_block_applied_callback)
    (cancel_all_subscriptions)
@@ -580,6 +947,12 @@ FC_API(graphene::app::database_api,
    // Blocks and transactions
    (get_block_header)
    (get_block)
+   (get_packed_blocks)
+   (get_packed_state_diffs)
+   (get_state_hash)
+   (stream_blocks)
+   (acknowledge_streamed_blocks)
+   (cancel_block_stream)
    (get_transaction)
    (get_recent_transaction_by_id)
 
@@ -592,10 +965,12 @@ FC_API(graphene::app::database_api,
 
    // Keys
    (get_key_references)
+   (get_full_key_references)
 
    // Accounts
    (get_accounts)
    (get_full_accounts)
+   (get_full_accounts_paged)
    (get_account_by_name)
    (get_account_references)
    (lookup_account_names)
@@ -604,6 +979,10 @@ FC_API(graphene::app::database_api,
 
    // Balances
    (get_account_balances)
+   (get_account_balances_page)
+   (get_balances_for_accounts)
+   (subscribe_to_balances)
+   (unsubscribe_from_balances)
    (get_named_account_balances)
    (get_balance_objects)
    (get_vested_balances)
@@ -613,29 +992,41 @@ FC_API(graphene::app::database_api,
    (get_assets)
    (list_assets)
    (lookup_asset_symbols)
+   (get_asset_holders_page)
+   (get_asset_holders_count)
 
    // Markets / feeds
    (get_order_book)
+   (get_order_books)
    (get_limit_orders)
    (get_call_orders)
    (get_settle_orders)
+   (get_limit_orders_page)
+   (get_call_orders_page)
+   (get_settle_orders_page)
    (get_margin_positions)
    (subscribe_to_market)
    (unsubscribe_from_market)
+   (subscribe_to_market_deltas)
+   (unsubscribe_from_market_deltas)
    (get_ticker)
+   (get_tickers)
    (get_24_volume)
    (get_trade_history)
+   (get_trade_history_page)
 
    // Witnesses
    (get_witnesses)
    (get_witness_by_account)
    (lookup_witness_accounts)
    (get_witness_count)
+   (get_witnesses_by_votes)
 
    // Committee members
    (get_committee_members)
    (get_committee_member_by_account)
    (lookup_committee_member_accounts)
+   (get_committee_members_by_votes)
 
    // workers
    (get_workers_by_account)
@@ -651,6 +1042,7 @@ FC_API(graphene::app::database_api,
    (verify_account_authority)
    (validate_transaction)
    (get_required_fees)
+   (simulate_transactions)
 
    // Proposed transactions
    (get_proposed_transactions)
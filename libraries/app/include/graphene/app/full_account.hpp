@@ -46,6 +46,51 @@ namespace graphene { namespace app {
       vector<proposal_object>          proposals;
    };
 
+   /** where each section of a full_account_page continues, absent for the sections that are complete */
+   struct full_account_cursor
+   {
+      optional<asset_id_type>           balances;         ///< asset of the next balance
+      optional<vesting_balance_id_type> vesting_balances;
+      optional<limit_order_id_type>     limit_orders;
+      optional<asset_id_type>           call_orders;      ///< debt asset of the next call order
+      optional<proposal_id_type>        proposals;
+   };
+
+   /** what database_api::get_full_accounts_paged() returns of each account */
+   struct full_account_query
+   {
+      /** return the counts of the sections only, without their objects */
+      bool                summary = false;
+      /** most objects returned in each section */
+      uint32_t            limit = 100;
+      /** the next_page of an account in the previous call by the name or ID it was asked for, to continue only the
+       *  sections it names where they stopped; the other accounts start all their sections from the beginning */
+      std::map<string, full_account_cursor> start;
+   };
+
+   /** the number of objects in each section of an account, whether they were returned or not */
+   struct full_account_counts
+   {
+      uint32_t balances = 0;
+      uint32_t vesting_balances = 0;
+      uint32_t limit_orders = 0;
+      uint32_t call_orders = 0;
+      uint32_t proposals = 0;
+
+      uint64_t total()const
+      {
+         return uint64_t(balances) + vesting_balances + limit_orders + call_orders + proposals;
+      }
+   };
+
+   struct full_account_page
+   {
+      /** the account with one page of each section */
+      full_account        account;
+      full_account_counts counts;
+      full_account_cursor next_page;
+   };
+
 } }
 
 FC_REFLECT( graphene::app::full_account, 
@@ -62,3 +107,9 @@ FC_REFLECT( graphene::app::full_account,
             (call_orders)
             (proposals) 
           )
+GRAPHENE_JSON_DIRECT( graphene::app::full_account )
+
+FC_REFLECT( graphene::app::full_account_cursor, (balances)(vesting_balances)(limit_orders)(call_orders)(proposals) )
+FC_REFLECT( graphene::app::full_account_query, (summary)(limit)(start) )
+FC_REFLECT( graphene::app::full_account_counts, (balances)(vesting_balances)(limit_orders)(call_orders)(proposals) )
+FC_REFLECT( graphene::app::full_account_page, (account)(counts)(next_page) )
@@ -34,6 +34,14 @@ void operation_get_impacted_accounts(
    const graphene::chain::operation& op,
    fc::flat_set<graphene::chain::account_id_type>& result );
 
+/**
+ * The accounts required to authorize op, the accounts named in the other authorities it requires and the accounts
+ * operation_get_impacted_accounts() adds, all collected in a single visit of op.
+ */
+void operation_get_required_and_impacted_accounts(
+   const graphene::chain::operation& op,
+   fc::flat_set<graphene::chain::account_id_type>& result );
+
 void transaction_get_impacted_accounts(
    const graphene::chain::transaction& tx,
    fc::flat_set<graphene::chain::account_id_type>& result
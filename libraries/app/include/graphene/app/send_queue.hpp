@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/db/object_id.hpp>
+
+#include <fc/variant.hpp>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/**
+ *  @brief The notifications waiting to be sent to one connection
+ *
+ *  A database_api used to start a task per notification, each calling the callback of the connection, so a client
+ *  reading slowly made the tasks and their notifications pile up without limit.  The notifications go through a
+ *  send_queue instead, which sends them in order from a single task.  Object updates wait coalesced by object id,
+ *  so a connection that falls behind is sent the newest version of each object once.
+ *
+ *  When more than max_bytes() of notifications are waiting, the connection is considered too slow: the queue is
+ *  dropped and the overflow handler is called, which ends the subscriptions of the connection.
+ *
+ *  The queue is used on the thread of the chain database only and does not lock itself.
+ */
+class send_queue : public std::enable_shared_from_this<send_queue>
+{
+   public:
+      typedef std::function< void( const fc::variant& ) > callback_type;
+
+      explicit send_queue( std::function<void()> on_overflow );
+
+      /** queues @ref updates for @ref callback, replacing the versions of the same objects that still wait */
+      void push_objects( const callback_type& callback, const std::vector<fc::variant>& updates );
+      /** like push_objects(), with the estimated_size() of every update already known */
+      void push_objects( const callback_type& callback, const std::vector<fc::variant>& updates,
+                         const std::vector<uint64_t>& sizes );
+      void push( const callback_type& callback, fc::variant message );
+      /** like push(), with the estimated_size() of @ref message already known */
+      void push( const callback_type& callback, fc::variant message, uint64_t size );
+      /** drops every notification still waiting */
+      void clear();
+
+      uint64_t queued_bytes()const { return _bytes; }
+
+      /** the limit for every queue of the process, 0 for no limit */
+      static void     set_max_bytes( uint64_t bytes ) { _max_bytes = bytes; }
+      static uint64_t max_bytes() { return _max_bytes; }
+
+      static const uint64_t default_max_bytes = 16 * 1024 * 1024;
+
+      /** about the size of @ref v in JSON, walking it is much cheaper than printing it */
+      static uint64_t estimated_size( const fc::variant& v );
+
+   private:
+      struct message
+      {
+         callback_type  callback;
+         fc::variant    value;
+         uint64_t       bytes = 0;
+         /** stands for the coalesced object updates, which are sent in its place */
+         bool           objects = false;
+      };
+
+      void queued( uint64_t bytes );
+      /** starts the task sending the queue unless it runs already */
+      void send();
+
+      std::function<void()>                                          _on_overflow;
+      std::deque<message>                                            _messages;
+      callback_type                                                  _objects_callback;
+      std::vector<fc::variant>                                       _objects;
+      std::vector<uint64_t>                                          _object_bytes;
+      /** where the update of an object is in _objects */
+      std::unordered_map<graphene::db::object_id_type, size_t>       _object_slots;
+      uint64_t                                                       _bytes   = 0;
+      bool                                                           _sending = false;
+
+      static std::atomic<uint64_t>                                   _max_bytes;
+};
+
+} } // graphene::app
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/full_account.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace app {
+
+struct object_cache_statistics
+{
+   uint64_t entries        = 0;
+   uint64_t capacity       = 0;
+   uint64_t hits           = 0;
+   uint64_t misses         = 0;
+   uint64_t bundle_hits    = 0;
+   uint64_t bundle_misses  = 0;
+   uint64_t evictions      = 0;
+   uint64_t invalidations  = 0;
+};
+
+/**
+ *  @brief Keeps the objects that database_api returns in their serialized form until they change
+ *
+ *  Popular objects such as the global properties are asked for by many clients between two changes, so turning
+ *  them into a variant once and handing out copies, which share their members, saves most of the work.  The
+ *  same goes for the full_account bundles without their votes, which are looked up again every time.
+ *
+ *  The cache observes every index of the database, so an object is forgotten as soon as it is modified or
+ *  removed, undo included.  A change also drops the bundles of the accounts owning the object, see
+ *  subscription_hub::visit_owning_accounts(), and any change to a proposal drops every bundle.  At most capacity
+ *  objects are kept, the least recently used one makes room for a new one.
+ */
+class serialized_object_cache : public graphene::db::index_observer
+{
+   public:
+      /** @return the cache of @ref db, which observes the indexes of @ref db from the first call on */
+      static std::shared_ptr<serialized_object_cache> get( chain::database& db );
+
+      /** 0 turns the cache off */
+      void set_capacity( uint32_t entries );
+
+      fc::variant  to_variant( const object& obj );
+      /** @return the bundle of @ref account without votes, made by @ref build unless it is cached */
+      full_account get_full_account( const account_object& account, const std::function<full_account()>& build );
+
+      object_cache_statistics get_statistics()const;
+
+      virtual void on_add( const object& obj ) override    { invalidate( obj ); }
+      virtual void on_remove( const object& obj ) override { invalidate( obj ); }
+      virtual void on_modify( const object& obj ) override { invalidate( obj ); }
+
+      static const uint32_t default_capacity = 10000;
+
+   private:
+      struct entry
+      {
+         object_id_type                        id;
+         fc::variant                           variant;
+         std::shared_ptr<const full_account>   bundle;
+         /** the _bundle_epoch that bundle was made in */
+         uint64_t                              bundle_epoch = 0;
+      };
+      typedef std::list<entry> lru_list;
+
+      /** @return the entry of @ref id moved to the front, created if needed, the caller holds _mutex */
+      entry& touch( object_id_type id );
+      void   invalidate( const object& obj );
+
+      mutable std::mutex                                      _mutex;
+      uint32_t                                                _capacity = default_capacity;
+      /** most recently used first */
+      lru_list                                                _lru;
+      std::unordered_map<object_id_type, lru_list::iterator>  _entries;
+      uint64_t                                                _bundle_epoch = 0;
+      object_cache_statistics                                 _stats;
+};
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::object_cache_statistics,
+            (entries)(capacity)(hits)(misses)(bundle_hits)(bundle_misses)(evictions)(invalidations) )
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/bloom_filter.hpp>
+
+#include <boost/container/flat_set.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace app {
+
+/**
+ *  How a session remembers the objects it is subscribed to.  The exact filter is part of the inverted index of the
+ *  hub, so it never reports an object it was not asked for.  The bloom filter needs a fraction of the memory for
+ *  large subscriptions, but it is tested against every changed object and lets a small share of unrelated objects
+ *  through.  It grows by adding layers of twice the capacity, so its false positive rate stays below 1/10000.
+ */
+enum subscription_filter_type
+{
+   exact_subscription_filter,
+   bloom_subscription_filter
+};
+
+/**
+ *  @brief Fans the objects changed by the chain database out to the database_api sessions subscribed to them
+ *
+ *  Every session used to connect to the changed_objects signal itself and turn every changed object into a variant,
+ *  so a notification cost sessions times changed objects.  All sessions of a database share one hub instead, which
+ *  keeps an inverted index from object id to the sessions subscribed to it.  An object is looked up and turned into
+ *  a variant at most once per notification and only if a session is subscribed to it, either directly or through the
+ *  account that owns it, so the cost follows the number of matches.
+ *
+ *  The variant objects handed to the sessions share their members, so the copies that the sessions keep until their
+ *  callbacks run are cheap.  Their send_queue::estimated_size() is computed once as well and handed along, and the
+ *  pending transactions are turned into a variant once for all sessions that follow them.  Sessions may subscribe
+ *  from the threads of an api_reader_pool, the hub locks itself.
+ */
+class subscription_hub
+{
+   public:
+      typedef uint64_t                                                  session_id_type;
+      /** called with the updates and the estimated size of each of them */
+      typedef std::function< void( const std::vector<fc::variant>&, const std::vector<uint64_t>& ) > callback_type;
+      /** called with a pending transaction and its estimated size */
+      typedef std::function< void( const fc::variant&, uint64_t ) >                                transaction_callback_type;
+
+      /** @return the hub of @ref db, which is created by the first session and lives as long as any session uses it */
+      static std::shared_ptr<subscription_hub> get( chain::database& db );
+
+      explicit subscription_hub( chain::database& db );
+      ~subscription_hub();
+
+      /** @ref callback is called from the notification with the updates of the objects the session is subscribed to */
+      session_id_type add_session( callback_type callback );
+      void            remove_session( session_id_type session );
+      /** @ref callback is called with every transaction added to the pending pool, an empty callback stops it */
+      void            set_pending_transaction_callback( session_id_type session, transaction_callback_type callback );
+
+      void subscribe( session_id_type session, object_id_type id );
+      bool is_subscribed( session_id_type session, object_id_type id )const;
+      /** removes every subscription of @ref session */
+      void clear_subscriptions( session_id_type session );
+      /** switches @ref session to another kind of filter, which removes its subscriptions */
+      void set_filter( session_id_type session, subscription_filter_type filter );
+
+      /** @return the bytes that the subscriptions of @ref session take up */
+      uint64_t session_memory( session_id_type session )const;
+      /** @return the bytes that the subscriptions of all sessions take up */
+      uint64_t memory()const;
+
+      size_t session_count()const;
+      /** @return the number of objects with at least one session subscribed by an exact filter */
+      size_t subscribed_objects()const;
+
+      /** the first layer of a bloom filter holds this many objects, every further layer twice as many as the last */
+      static const uint32_t bloom_layer_capacity = 1024;
+
+      /** calls @ref visit with the accounts whose subscribers also receive the changes of @ref obj */
+      static void visit_owning_accounts( const object& obj, const std::function<void(account_id_type)>& visit );
+
+   private:
+      typedef boost::container::flat_set<session_id_type> session_set;
+
+      struct session
+      {
+         callback_type                               callback;
+         transaction_callback_type                   pending_transaction_callback;
+         subscription_filter_type                    filter = exact_subscription_filter;
+         /** the subscriptions of an exact filter */
+         boost::container::flat_set<object_id_type>  items;
+         /** the layers of a bloom filter, only the last one takes new objects */
+         std::vector<fc::bloom_filter>               bloom_layers;
+         uint32_t                                    bloom_items = 0;
+         uint64_t                                    memory = 0;
+
+         bool bloom_contains( object_id_type id )const;
+      };
+
+      /** removes the subscriptions of @ref s, the caller holds _mutex */
+      void clear_session( session_id_type id, session& s );
+      void on_objects_changed( const std::vector<object_id_type>& ids );
+      void on_objects_removed( const std::vector<const object*>& objs );
+      void on_pending_transaction( const chain::signed_transaction& trx );
+      /** adds the subscribers of @ref id to @ref matches */
+      void collect_subscribers( object_id_type id, session_set& matches )const;
+      /** adds the sessions with a bloom filter that contains @ref obj or one of its owning accounts to @ref matches */
+      void collect_bloom_subscribers( object_id_type id, const object* obj, session_set& matches )const;
+      /** the updates of one session and their estimated sizes */
+      struct session_updates
+      {
+         std::vector<fc::variant> updates;
+         std::vector<uint64_t>    sizes;
+      };
+      void dispatch( const std::map< session_id_type, session_updates >& updates )const;
+
+      chain::database&                                       _db;
+      mutable std::mutex                                     _mutex;
+      session_id_type                                        _next_session = 0;
+      std::map<session_id_type, session>                     _sessions;
+      std::unordered_map<object_id_type, session_set>        _subscribers;
+      session_set                                            _bloom_sessions;
+      session_set                                            _pending_transaction_sessions;
+      uint64_t                                               _memory = 0;
+      graphene::chain::scoped_observer_connection            _change_connection;
+      graphene::chain::scoped_observer_connection            _removed_connection;
+      graphene::chain::scoped_observer_connection            _pending_transaction_connection;
+};
+
+} } // graphene::app
+
+FC_REFLECT_ENUM( graphene::app::subscription_filter_type, (exact_subscription_filter)(bloom_subscription_filter) )
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/send_queue.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+const uint64_t        send_queue::default_max_bytes;
+std::atomic<uint64_t> send_queue::_max_bytes( send_queue::default_max_bytes );
+
+uint64_t send_queue::estimated_size( const fc::variant& v )
+{
+   switch( v.get_type() )
+   {
+      case fc::variant::string_type:
+         return v.get_string().size() + 2;
+      case fc::variant::array_type:
+      {
+         uint64_t size = 2;
+         for( const auto& item : v.get_array() )
+            size += estimated_size( item ) + 1;
+         return size;
+      }
+      case fc::variant::object_type:
+      {
+         uint64_t size = 2;
+         for( const auto& item : v.get_object() )
+            size += item.key().size() + 4 + estimated_size( item.value() );
+         return size;
+      }
+      default:
+         return 8;
+   }
+}
+
+namespace {
+   /** objects are updated by their variant with an id member, or reported removed by their id alone */
+   bool update_id( const fc::variant& v, graphene::db::object_id_type& id )
+   {
+      try
+      {
+         if( v.is_string() )
+         {
+            id = v.as<graphene::db::object_id_type>();
+            return true;
+         }
+         if( v.is_object() )
+         {
+            const auto& obj = v.get_object();
+            auto itr = obj.find( "id" );
+            if( itr != obj.end() )
+            {
+               id = itr->value().as<graphene::db::object_id_type>();
+               return true;
+            }
+         }
+      }
+      catch( const fc::exception& ) {}
+      return false;
+   }
+}
+
+send_queue::send_queue( std::function<void()> on_overflow )
+   : _on_overflow( std::move( on_overflow ) ) {}
+
+void send_queue::push_objects( const callback_type& callback, const std::vector<fc::variant>& updates )
+{
+   std::vector<uint64_t> sizes;
+   sizes.reserve( updates.size() );
+   for( const auto& update : updates )
+      sizes.push_back( estimated_size( update ) );
+   push_objects( callback, updates, sizes );
+}
+
+void send_queue::push_objects( const callback_type& callback, const std::vector<fc::variant>& updates,
+                               const std::vector<uint64_t>& sizes )
+{
+   FC_ASSERT( sizes.size() == updates.size() );
+   if( updates.empty() )
+      return;
+   if( _objects.empty() )
+   {
+      message m;
+      m.objects = true;
+      _messages.push_back( std::move( m ) );
+   }
+   _objects_callback = callback;
+
+   uint64_t bytes = 0;
+   for( size_t i = 0; i < updates.size(); ++i )
+   {
+      const fc::variant& update = updates[i];
+      const uint64_t size = sizes[i] + 1;
+      graphene::db::object_id_type id;
+      if( update_id( update, id ) )
+      {
+         auto slot = _object_slots.find( id );
+         if( slot != _object_slots.end() )
+         {
+            _bytes -= _object_bytes[slot->second];
+            _objects[slot->second]      = update;
+            _object_bytes[slot->second] = size;
+            bytes += size;
+            continue;
+         }
+         _object_slots[id] = _objects.size();
+      }
+      _objects.push_back( update );
+      _object_bytes.push_back( size );
+      bytes += size;
+   }
+   queued( bytes );
+}
+
+void send_queue::push( const callback_type& callback, fc::variant message_value )
+{
+   const uint64_t size = estimated_size( message_value );
+   push( callback, std::move( message_value ), size );
+}
+
+void send_queue::push( const callback_type& callback, fc::variant message_value, uint64_t size )
+{
+   message m;
+   m.callback = callback;
+   m.bytes    = size;
+   m.value    = std::move( message_value );
+   const uint64_t bytes = m.bytes;
+   _messages.push_back( std::move( m ) );
+   queued( bytes );
+}
+
+void send_queue::clear()
+{
+   _messages.clear();
+   _objects.clear();
+   _object_bytes.clear();
+   _object_slots.clear();
+   _bytes = 0;
+}
+
+void send_queue::queued( uint64_t bytes )
+{
+   _bytes += bytes;
+   const uint64_t limit = _max_bytes;
+   if( limit && _bytes > limit )
+   {
+      wlog( "dropping ${b} bytes of notifications for a connection that does not keep up", ("b",_bytes) );
+      clear();
+      if( _on_overflow )
+         _on_overflow();
+      return;
+   }
+   send();
+}
+
+void send_queue::send()
+{
+   if( _sending )
+      return;
+   _sending = true;
+
+   auto self = shared_from_this();
+   fc::async( [self,this]() {
+      while( !_messages.empty() )
+      {
+         message m = std::move( _messages.front() );
+         _messages.pop_front();
+         uint64_t sent = m.bytes;
+         if( m.objects )
+         {
+            for( uint64_t bytes : _object_bytes )
+               sent += bytes;
+            m.callback = _objects_callback;
+            m.value    = fc::variant( _objects );
+            _objects.clear();
+            _object_bytes.clear();
+            _object_slots.clear();
+         }
+         _bytes -= std::min( _bytes, sent );
+
+         try
+         {
+            if( m.callback )
+               m.callback( m.value );
+         }
+         catch( const fc::exception& e )
+         {
+            wdump( (e.to_detail_string()) );
+         }
+      }
+      _sending = false;
+   }, "send_queue" );
+}
+
+} } // graphene::app
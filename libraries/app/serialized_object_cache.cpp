@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/serialized_object_cache.hpp>
+#include <graphene/app/subscription_hub.hpp>
+
+#include <map>
+
+namespace graphene { namespace app {
+
+const uint32_t serialized_object_cache::default_capacity;
+
+std::shared_ptr<serialized_object_cache> serialized_object_cache::get( chain::database& db )
+{
+   static std::mutex                                                            caches_mutex;
+   static std::map< chain::database*, std::weak_ptr<serialized_object_cache> > caches;
+
+   std::lock_guard<std::mutex> lock( caches_mutex );
+   for( auto itr = caches.begin(); itr != caches.end(); )
+   {
+      if( itr->second.expired() )
+         itr = caches.erase( itr );
+      else
+         ++itr;
+   }
+
+   // the indexes of db own the cache, so it lives as long as db
+   auto& slot = caches[&db];
+   auto cache = slot.lock();
+   if( !cache )
+   {
+      cache = std::make_shared<serialized_object_cache>();
+      db.add_index_observer( cache );
+      slot = cache;
+   }
+   return cache;
+}
+
+void serialized_object_cache::set_capacity( uint32_t entries )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = entries;
+   while( _lru.size() > _capacity )
+   {
+      _entries.erase( _lru.back().id );
+      _lru.pop_back();
+      ++_stats.evictions;
+   }
+}
+
+serialized_object_cache::entry& serialized_object_cache::touch( object_id_type id )
+{
+   auto itr = _entries.find( id );
+   if( itr != _entries.end() )
+   {
+      _lru.splice( _lru.begin(), _lru, itr->second );
+      return _lru.front();
+   }
+
+   if( _lru.size() >= _capacity )
+   {
+      _entries.erase( _lru.back().id );
+      _lru.pop_back();
+      ++_stats.evictions;
+   }
+   _lru.emplace_front();
+   _lru.front().id = id;
+   _entries[id] = _lru.begin();
+   return _lru.front();
+}
+
+fc::variant serialized_object_cache::to_variant( const object& obj )
+{
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( _capacity == 0 )
+         return obj.to_variant();
+      auto itr = _entries.find( obj.id );
+      if( itr != _entries.end() && !itr->second->variant.is_null() )
+      {
+         ++_stats.hits;
+         _lru.splice( _lru.begin(), _lru, itr->second );
+         return itr->second->variant;
+      }
+      ++_stats.misses;
+   }
+
+   // serialize without holding the lock, readers on other threads may do the same meanwhile
+   fc::variant result = obj.to_variant();
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity > 0 )
+      touch( obj.id ).variant = result;
+   return result;
+}
+
+full_account serialized_object_cache::get_full_account( const account_object& account,
+                                                        const std::function<full_account()>& build )
+{
+   uint64_t epoch;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( _capacity == 0 )
+         return build();
+      epoch = _bundle_epoch;
+      auto itr = _entries.find( account.id );
+      if( itr != _entries.end() && itr->second->bundle && itr->second->bundle_epoch == epoch )
+      {
+         ++_stats.bundle_hits;
+         _lru.splice( _lru.begin(), _lru, itr->second );
+         return *itr->second->bundle;
+      }
+      ++_stats.bundle_misses;
+   }
+
+   auto bundle = std::make_shared<const full_account>( build() );
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity > 0 && epoch == _bundle_epoch )
+   {
+      entry& e = touch( account.id );
+      e.bundle       = bundle;
+      e.bundle_epoch = epoch;
+   }
+   return *bundle;
+}
+
+object_cache_statistics serialized_object_cache::get_statistics()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   object_cache_statistics result = _stats;
+   result.entries  = _entries.size();
+   result.capacity = _capacity;
+   return result;
+}
+
+void serialized_object_cache::invalidate( const object& obj )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _entries.empty() )
+      return;
+
+   if( obj.id.space() == protocol_ids && obj.id.type() == proposal_object_type )
+      ++_bundle_epoch;
+
+   auto itr = _entries.find( obj.id );
+   if( itr != _entries.end() )
+   {
+      _lru.erase( itr->second );
+      _entries.erase( itr );
+      ++_stats.invalidations;
+   }
+
+   subscription_hub::visit_owning_accounts( obj, [this]( account_id_type account ) {
+      auto owner = _entries.find( account );
+      if( owner != _entries.end() && owner->second->bundle )
+      {
+         owner->second->bundle.reset();
+         ++_stats.invalidations;
+      }
+   });
+}
+
+} } // graphene::app
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/subscription_hub.hpp>
+#include <graphene/app/send_queue.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+#include <graphene/chain/withdraw_permission_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+#include <graphene/chain/worker_object.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <mutex>
+
+namespace graphene { namespace app {
+
+/** an exact subscription is kept by the session and by the inverted index */
+static const uint64_t exact_subscription_memory = sizeof(object_id_type) + sizeof(subscription_hub::session_id_type);
+
+bool subscription_hub::session::bloom_contains( object_id_type id )const
+{
+   if( bloom_layers.empty() )
+      return false;
+   const auto key = fc::raw::pack( id );
+   for( const auto& layer : bloom_layers )
+      if( layer.contains( key.data(), key.size() ) )
+         return true;
+   return false;
+}
+
+std::shared_ptr<subscription_hub> subscription_hub::get( chain::database& db )
+{
+   static std::mutex                                                     hubs_mutex;
+   static std::map< chain::database*, std::weak_ptr<subscription_hub> > hubs;
+
+   std::lock_guard<std::mutex> lock( hubs_mutex );
+   for( auto itr = hubs.begin(); itr != hubs.end(); )
+   {
+      if( itr->second.expired() )
+         itr = hubs.erase( itr );
+      else
+         ++itr;
+   }
+
+   auto& entry = hubs[&db];
+   auto hub = entry.lock();
+   if( !hub )
+   {
+      hub = std::make_shared<subscription_hub>( db );
+      entry = hub;
+   }
+   return hub;
+}
+
+subscription_hub::subscription_hub( chain::database& db )
+   : _db( db )
+{
+   _change_connection = _db.changed_objects.connect( [this]( const std::vector<object_id_type>& ids ) {
+      on_objects_changed( ids );
+   }, "subscription_hub" );
+   _removed_connection = _db.removed_objects.connect( [this]( const std::vector<const object*>& objs ) {
+      on_objects_removed( objs );
+   }, "subscription_hub" );
+   _pending_transaction_connection = _db.on_pending_transaction.connect( [this]( const chain::signed_transaction& trx ) {
+      on_pending_transaction( trx );
+   }, "subscription_hub" );
+}
+
+subscription_hub::~subscription_hub() {}
+
+subscription_hub::session_id_type subscription_hub::add_session( callback_type callback )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   const session_id_type id = _next_session++;
+   _sessions[id].callback = std::move( callback );
+   return id;
+}
+
+void subscription_hub::remove_session( session_id_type session )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   clear_session( session, itr->second );
+   _bloom_sessions.erase( session );
+   _pending_transaction_sessions.erase( session );
+   _sessions.erase( itr );
+}
+
+void subscription_hub::set_pending_transaction_callback( session_id_type session, transaction_callback_type callback )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   FC_ASSERT( itr != _sessions.end(), "unknown session ${s}", ("s",session) );
+   if( callback )
+      _pending_transaction_sessions.insert( session );
+   else
+      _pending_transaction_sessions.erase( session );
+   itr->second.pending_transaction_callback = std::move( callback );
+}
+
+void subscription_hub::subscribe( session_id_type session, object_id_type id )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   FC_ASSERT( itr != _sessions.end(), "unknown session ${s}", ("s",session) );
+   auto& s = itr->second;
+
+   if( s.filter == exact_subscription_filter )
+   {
+      if( s.items.insert( id ).second )
+      {
+         _subscribers[id].insert( session );
+         s.memory += exact_subscription_memory;
+         _memory  += exact_subscription_memory;
+      }
+      return;
+   }
+
+   if( s.bloom_contains( id ) )
+      return;
+   if( s.bloom_layers.empty() || s.bloom_items >= ( uint64_t(bloom_layer_capacity) << ( s.bloom_layers.size() - 1 ) ) )
+   {
+      // the false positive rates of the layers add up to less than 1/10000
+      fc::bloom_parameters param;
+      param.projected_element_count    = uint64_t(bloom_layer_capacity) << s.bloom_layers.size();
+      param.false_positive_probability = 1.0 / 10000 / ( uint64_t(2) << s.bloom_layers.size() );
+      param.compute_optimal_parameters();
+      s.bloom_layers.emplace_back( param );
+      s.bloom_items = 0;
+
+      const uint64_t bytes = s.bloom_layers.back().size() / 8;
+      s.memory += bytes;
+      _memory  += bytes;
+   }
+   const auto key = fc::raw::pack( id );
+   s.bloom_layers.back().insert( key.data(), key.size() );
+   ++s.bloom_items;
+}
+
+bool subscription_hub::is_subscribed( session_id_type session, object_id_type id )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return false;
+   if( itr->second.filter == bloom_subscription_filter )
+      return itr->second.bloom_contains( id );
+   return itr->second.items.count( id ) != 0;
+}
+
+void subscription_hub::clear_subscriptions( session_id_type session )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   if( itr != _sessions.end() )
+      clear_session( session, itr->second );
+}
+
+void subscription_hub::clear_session( session_id_type id, session& s )
+{
+   for( const object_id_type& item : s.items )
+   {
+      auto sub = _subscribers.find( item );
+      if( sub == _subscribers.end() )
+         continue;
+      sub->second.erase( id );
+      if( sub->second.empty() )
+         _subscribers.erase( sub );
+   }
+   s.items.clear();
+   s.items.shrink_to_fit();
+   s.bloom_layers.clear();
+   s.bloom_items = 0;
+
+   _memory -= s.memory;
+   s.memory = 0;
+}
+
+void subscription_hub::set_filter( session_id_type session, subscription_filter_type filter )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   FC_ASSERT( itr != _sessions.end(), "unknown session ${s}", ("s",session) );
+   clear_session( session, itr->second );
+   itr->second.filter = filter;
+   if( filter == bloom_subscription_filter )
+      _bloom_sessions.insert( session );
+   else
+      _bloom_sessions.erase( session );
+}
+
+uint64_t subscription_hub::session_memory( session_id_type session )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _sessions.find( session );
+   return itr == _sessions.end() ? 0 : itr->second.memory;
+}
+
+uint64_t subscription_hub::memory()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _memory;
+}
+
+size_t subscription_hub::session_count()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _sessions.size();
+}
+
+size_t subscription_hub::subscribed_objects()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _subscribers.size();
+}
+
+void subscription_hub::visit_owning_accounts( const object& obj, const std::function<void(account_id_type)>& visit )
+{
+   using namespace graphene::chain;
+
+   if( obj.id.space() == protocol_ids )
+   {
+      switch( obj.id.type() )
+      {
+         case force_settlement_object_type:
+            visit( static_cast<const force_settlement_object&>( obj ).owner );
+            break;
+         case committee_member_object_type:
+            visit( static_cast<const committee_member_object&>( obj ).committee_member_account );
+            break;
+         case witness_object_type:
+            visit( static_cast<const witness_object&>( obj ).witness_account );
+            break;
+         case limit_order_object_type:
+            visit( static_cast<const limit_order_object&>( obj ).seller );
+            break;
+         case call_order_object_type:
+            visit( static_cast<const call_order_object&>( obj ).borrower );
+            break;
+         case withdraw_permission_object_type:
+         {
+            const auto& permission = static_cast<const withdraw_permission_object&>( obj );
+            visit( permission.withdraw_from_account );
+            visit( permission.authorized_account );
+            break;
+         }
+         case vesting_balance_object_type:
+            visit( static_cast<const vesting_balance_object&>( obj ).owner );
+            break;
+         case worker_object_type:
+            visit( static_cast<const worker_object&>( obj ).worker_account );
+            break;
+         default:
+            break;
+      }
+   }
+   else if( obj.id.space() == implementation_ids )
+   {
+      switch( obj.id.type() )
+      {
+         case impl_account_balance_object_type:
+            visit( static_cast<const account_balance_object&>( obj ).owner );
+            break;
+         case impl_account_statistics_object_type:
+            visit( static_cast<const account_statistics_object&>( obj ).owner );
+            break;
+         default:
+            break;
+      }
+   }
+}
+
+void subscription_hub::collect_subscribers( object_id_type id, session_set& matches )const
+{
+   auto itr = _subscribers.find( id );
+   if( itr != _subscribers.end() )
+      matches.insert( itr->second.begin(), itr->second.end() );
+}
+
+void subscription_hub::collect_bloom_subscribers( object_id_type id, const object* obj, session_set& matches )const
+{
+   for( session_id_type session : _bloom_sessions )
+   {
+      if( matches.count( session ) )
+         continue;
+      const auto& s = _sessions.at( session );
+      bool matched = s.bloom_contains( id );
+      if( !matched && obj )
+         visit_owning_accounts( *obj, [&]( account_id_type account ) { matched = matched || s.bloom_contains( account ); } );
+      if( matched )
+         matches.insert( session );
+   }
+}
+
+void subscription_hub::on_objects_changed( const std::vector<object_id_type>& ids )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _subscribers.empty() && _bloom_sessions.empty() )
+      return;
+
+   std::map< session_id_type, session_updates > updates;
+   session_set matches;
+   for( const object_id_type& id : ids )
+   {
+      matches.clear();
+      collect_subscribers( id, matches );
+
+      const object* obj = _db.find_object( id );
+      if( obj )
+         visit_owning_accounts( *obj, [&]( account_id_type account ) { collect_subscribers( account, matches ); } );
+      collect_bloom_subscribers( id, obj, matches );
+      if( matches.empty() )
+         continue;
+
+      // a removed object is reported by its id alone
+      const fc::variant update = obj ? obj->to_variant() : fc::variant( id );
+      const uint64_t size = send_queue::estimated_size( update );
+      for( session_id_type session : matches )
+      {
+         session_updates& u = updates[session];
+         u.updates.push_back( update );
+         u.sizes.push_back( size );
+      }
+   }
+   dispatch( updates );
+}
+
+void subscription_hub::on_objects_removed( const std::vector<const object*>& objs )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _subscribers.empty() && _bloom_sessions.empty() )
+      return;
+
+   std::map< session_id_type, session_updates > updates;
+   session_set matches;
+   for( const object* obj : objs )
+   {
+      matches.clear();
+      collect_subscribers( obj->id, matches );
+      visit_owning_accounts( *obj, [&]( account_id_type account ) { collect_subscribers( account, matches ); } );
+      collect_bloom_subscribers( obj->id, obj, matches );
+      if( matches.empty() )
+         continue;
+
+      const fc::variant update( obj->id );
+      const uint64_t size = send_queue::estimated_size( update );
+      for( session_id_type session : matches )
+      {
+         session_updates& u = updates[session];
+         u.updates.push_back( update );
+         u.sizes.push_back( size );
+      }
+   }
+   dispatch( updates );
+}
+
+void subscription_hub::on_pending_transaction( const chain::signed_transaction& trx )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _pending_transaction_sessions.empty() )
+      return;
+
+   const fc::variant update( trx );
+   const uint64_t size = send_queue::estimated_size( update );
+   for( session_id_type session : _pending_transaction_sessions )
+   {
+      auto itr = _sessions.find( session );
+      if( itr != _sessions.end() && itr->second.pending_transaction_callback )
+         itr->second.pending_transaction_callback( update, size );
+   }
+}
+
+void subscription_hub::dispatch( const std::map< session_id_type, session_updates >& updates )const
+{
+   for( const auto& item : updates )
+   {
+      auto itr = _sessions.find( item.first );
+      if( itr != _sessions.end() && itr->second.callback )
+         itr->second.callback( item.second.updates, item.second.sizes );
+   }
+}
+
+} } // graphene::app
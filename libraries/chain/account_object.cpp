@@ -27,6 +27,8 @@
 #include <graphene/chain/hardfork.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
 share_type cut_fee(share_type a, uint16_t p)
@@ -110,34 +112,51 @@ void account_statistics_object::pay_fee( share_type core_fee, share_type cashbac
       pending_vested_fees += core_fee;
 }
 
-set<account_id_type> account_member_index::get_account_members(const account_object& a)const
+template<typename T>
+static void sort_unique( vector<T>& v )
 {
-   set<account_id_type> result;
-   for( auto auth : a.owner.account_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.account_auths )
-      result.insert(auth.first);
-   return result;
+   std::sort( v.begin(), v.end() );
+   v.erase( std::unique( v.begin(), v.end() ), v.end() );
 }
-set<public_key_type> account_member_index::get_key_members(const account_object& a)const
+
+void account_member_index::get_members( const authority& owner, const authority& active,
+                                        const public_key_type& memo_key, members& result )
 {
-   set<public_key_type> result;
-   for( auto auth : a.owner.key_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.key_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   result.accounts.clear();
+   result.keys.clear();
+   result.addresses.clear();
+   for( const authority* auth : { &owner, &active } )
+   {
+      for( const auto& item : auth->account_auths )
+         result.accounts.push_back( item.first );
+      for( const auto& item : auth->key_auths )
+         result.keys.push_back( item.first );
+      for( const auto& item : auth->address_auths )
+         result.addresses.push_back( item.first );
+   }
+   result.keys.push_back( memo_key );
+   result.addresses.push_back( memo_key );
+   sort_unique( result.accounts );
+   sort_unique( result.keys );
+   sort_unique( result.addresses );
 }
-set<address> account_member_index::get_address_members(const account_object& a)const
+
+/** applies the difference between two sorted member lists to @ref memberships */
+template<typename Key>
+static void update_memberships( map< Key, set<account_id_type> >& memberships, const vector<Key>& before,
+                                const vector<Key>& after, account_id_type id )
 {
-   set<address> result;
-   for( auto auth : a.owner.address_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.address_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   auto b = before.begin();
+   auto a = after.begin();
+   while( b != before.end() || a != after.end() )
+   {
+      if( a == after.end() || ( b != before.end() && *b < *a ) )
+         memberships[*b++].erase( id );
+      else if( b == before.end() || *a < *b )
+         memberships[*a++].insert( id );
+      else
+         ++b, ++a;
+   }
 }
 
 void account_member_index::object_inserted(const object& obj)
@@ -145,17 +164,13 @@ void account_member_index::object_inserted(const object& obj)
     assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
     const account_object& a = static_cast<const account_object&>(obj);
 
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].insert(obj.id);
-
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].insert(obj.id);
-
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].insert(obj.id);
+    get_members( a.owner, a.active, a.options.memo_key, after_members );
+    for( const auto& item : after_members.accounts )
+       account_to_account_memberships[item].insert(a.id);
+    for( const auto& item : after_members.keys )
+       account_to_key_memberships[item].insert(a.id);
+    for( const auto& item : after_members.addresses )
+       account_to_address_memberships[item].insert(a.id);
 }
 
 void account_member_index::object_removed(const object& obj)
@@ -163,28 +178,22 @@ void account_member_index::object_removed(const object& obj)
     assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
     const account_object& a = static_cast<const account_object&>(obj);
 
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].erase( obj.id );
-
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].erase( obj.id );
-
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].erase( obj.id );
+    get_members( a.owner, a.active, a.options.memo_key, before_members );
+    for( const auto& item : before_members.keys )
+       account_to_key_memberships[item].erase(a.id);
+    for( const auto& item : before_members.addresses )
+       account_to_address_memberships[item].erase(a.id);
+    for( const auto& item : before_members.accounts )
+       account_to_account_memberships[item].erase(a.id);
 }
 
 void account_member_index::about_to_modify(const object& before)
 {
-   before_key_members.clear();
-   before_account_members.clear();
    assert( dynamic_cast<const account_object*>(&before) ); // for debug only
    const account_object& a = static_cast<const account_object&>(before);
-   before_key_members     = get_key_members(a);
-   before_address_members = get_address_members(a);
-   before_account_members = get_account_members(a);
+   before_owner    = a.owner;
+   before_active   = a.active;
+   before_memo_key = a.options.memo_key;
 }
 
 void account_member_index::object_modified(const object& after)
@@ -192,79 +201,160 @@ void account_member_index::object_modified(const object& after)
     assert( dynamic_cast<const account_object*>(&after) ); // for debug only
     const account_object& a = static_cast<const account_object&>(after);
 
-    {
-       set<account_id_type> after_account_members = get_account_members(a);
-       vector<account_id_type> removed; removed.reserve(before_account_members.size());
-       std::set_difference(before_account_members.begin(), before_account_members.end(),
-                           after_account_members.begin(), after_account_members.end(),
-                           std::inserter(removed, removed.end()));
+    if( a.owner == before_owner && a.active == before_active && a.options.memo_key == before_memo_key )
+       return;
+
+    get_members( before_owner, before_active, before_memo_key, before_members );
+    get_members( a.owner, a.active, a.options.memo_key, after_members );
+    update_memberships( account_to_account_memberships, before_members.accounts, after_members.accounts, a.id );
+    update_memberships( account_to_key_memberships, before_members.keys, after_members.keys, a.id );
+    update_memberships( account_to_address_memberships, before_members.addresses, after_members.addresses, a.id );
+}
+
+void account_referrer_index::object_inserted( const object& obj )
+{
+}
+void account_referrer_index::object_removed( const object& obj )
+{
+}
+void account_referrer_index::about_to_modify( const object& before )
+{
+}
+void account_referrer_index::object_modified( const object& after  )
+{
+}
 
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_account_memberships[*itr].erase(after.id);
+void account_authority_index::object_inserted( const object& obj )
+{
+   ++_generation;
+}
 
-       vector<object_id_type> added; added.reserve(after_account_members.size());
-       std::set_difference(after_account_members.begin(), after_account_members.end(),
-                           before_account_members.begin(), before_account_members.end(),
-                           std::inserter(added, added.end()));
+void account_authority_index::object_removed( const object& obj )
+{
+   ++_generation;
+}
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_account_memberships[*itr].insert(after.id);
-    }
+void account_authority_index::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>(before);
+   _before_owner = a.owner;
+   _before_active = a.active;
+}
 
+void account_authority_index::object_modified( const object& after  )
+{
+   const account_object& a = static_cast<const account_object&>(after);
+   if( !(a.owner == _before_owner) || !(a.active == _before_active) )
+      ++_generation;
+}
 
-    {
-       set<public_key_type> after_key_members = get_key_members(a);
+void account_holdings_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   if( b.balance > 0 )
+      adjust( b.owner, 1 );
+}
 
-       vector<public_key_type> removed; removed.reserve(before_key_members.size());
-       std::set_difference(before_key_members.begin(), before_key_members.end(),
-                           after_key_members.begin(), after_key_members.end(),
-                           std::inserter(removed, removed.end()));
+void account_holdings_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   if( b.balance > 0 )
+      adjust( b.owner, -1 );
+}
 
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_key_memberships[*itr].erase(after.id);
+void account_holdings_index::about_to_modify( const object& before )
+{
+   before_positive = static_cast<const account_balance_object&>(before).balance > 0;
+}
 
-       vector<public_key_type> added; added.reserve(after_key_members.size());
-       std::set_difference(after_key_members.begin(), after_key_members.end(),
-                           before_key_members.begin(), before_key_members.end(),
-                           std::inserter(added, added.end()));
+void account_holdings_index::object_modified( const object& after  )
+{
+   const account_balance_object& b = static_cast<const account_balance_object&>(after);
+   const bool after_positive = b.balance > 0;
+   if( after_positive != before_positive )
+      adjust( b.owner, after_positive ? 1 : -1 );
+}
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_key_memberships[*itr].insert(after.id);
-    }
+uint32_t account_holdings_index::positive_balance_count( account_id_type owner )const
+{
+   auto itr = positive_balances.find( owner );
+   return itr == positive_balances.end() ? 0 : itr->second;
+}
 
-    {
-       set<address> after_address_members = get_address_members(a);
+void account_holdings_index::adjust( account_id_type owner, int32_t delta )
+{
+   uint32_t& count = positive_balances[owner];
+   assert( delta > 0 || count > 0 );
+   count += delta;
+   if( count == 0 )
+      positive_balances.erase( owner );
+}
 
-       vector<address> removed; removed.reserve(before_address_members.size());
-       std::set_difference(before_address_members.begin(), before_address_members.end(),
-                           after_address_members.begin(), after_address_members.end(),
-                           std::inserter(removed, removed.end()));
+void account_pending_fees_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) ); // for debug only
+   object_modified( obj );
+}
 
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_address_memberships[*itr].erase(after.id);
+void account_pending_fees_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_statistics_object*>(&obj) ); // for debug only
+   pending.erase( static_cast<const account_statistics_object&>(obj).owner );
+}
 
-       vector<address> added; added.reserve(after_address_members.size());
-       std::set_difference(after_address_members.begin(), after_address_members.end(),
-                           before_address_members.begin(), before_address_members.end(),
-                           std::inserter(added, added.end()));
+void account_pending_fees_index::object_modified( const object& after  )
+{
+   const account_statistics_object& s = static_cast<const account_statistics_object&>(after);
+   if( s.pending_fees > 0 || s.pending_vested_fees > 0 )
+      pending.insert( s.owner );
+   else
+      pending.erase( s.owner );
+}
 
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_address_memberships[*itr].insert(after.id);
-    }
+void asset_holders_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   adjust( b.asset_type, b.balance > 0 ? 1 : 0, b.balance );
+}
 
+void asset_holders_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_balance_object*>(&obj) ); // for debug only
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   adjust( b.asset_type, b.balance > 0 ? -1 : 0, -b.balance );
 }
 
-void account_referrer_index::object_inserted( const object& obj )
+void asset_holders_index::about_to_modify( const object& before )
 {
+   before_balance = static_cast<const account_balance_object&>(before).balance;
 }
-void account_referrer_index::object_removed( const object& obj )
+
+void asset_holders_index::object_modified( const object& after  )
 {
+   const account_balance_object& b = static_cast<const account_balance_object&>(after);
+   const int32_t holders = ( b.balance > 0 ? 1 : 0 ) - ( before_balance > 0 ? 1 : 0 );
+   adjust( b.asset_type, holders, b.balance - before_balance );
 }
-void account_referrer_index::about_to_modify( const object& before )
+
+asset_holder_statistics asset_holders_index::get_statistics( asset_id_type asset )const
 {
+   auto itr = statistics.find( asset );
+   return itr == statistics.end() ? asset_holder_statistics() : itr->second;
 }
-void account_referrer_index::object_modified( const object& after  )
+
+void asset_holders_index::adjust( asset_id_type asset, int32_t holders, share_type amount )
 {
+   if( holders == 0 && amount == 0 )
+      return;
+   asset_holder_statistics& s = statistics[asset];
+   assert( holders > 0 || s.holders >= uint64_t(-holders) );
+   s.holders += holders;
+   s.total_in_balances += amount;
+   if( s.holders == 0 && s.total_in_balances == 0 )
+      statistics.erase( asset );
 }
 
 } } // graphene::chain
@@ -40,13 +40,13 @@ void_result asset_create_evaluator::do_evaluate( const asset_create_operation& o
    database& d = db();
 
    const auto& chain_parameters = d.get_global_properties().parameters;
-   FC_ASSERT( op.common_options.whitelist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
-   FC_ASSERT( op.common_options.blacklist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
+   FC_ASSERT( op.common_options->whitelist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
+   FC_ASSERT( op.common_options->blacklist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
 
    // Check that all authorities do exist
-   for( auto id : op.common_options.whitelist_authorities )
+   for( auto id : op.common_options->whitelist_authorities )
       d.get_object(id);
-   for( auto id : op.common_options.blacklist_authorities )
+   for( auto id : op.common_options->blacklist_authorities )
       d.get_object(id);
 
    auto& asset_indx = d.get_index_type<asset_index>().indices().get<by_symbol>();
@@ -130,7 +130,7 @@ object_id_type asset_create_evaluator::do_apply( const asset_create_operation& o
          a.issuer = op.issuer;
          a.symbol = op.symbol;
          a.precision = op.precision;
-         a.options = op.common_options;
+         a.options = *op.common_options;
          if( a.options.core_exchange_rate.base.asset_id.instance.value == 0 )
             a.options.core_exchange_rate.quote.asset_id = next_asset_id;
          else
@@ -232,7 +232,7 @@ void_result asset_update_evaluator::do_evaluate(const asset_update_operation& o)
 
    const asset_object& a = o.asset_to_update(d);
    auto a_copy = a;
-   a_copy.options = o.new_options;
+   a_copy.options = *o.new_options;
    a_copy.validate();
 
    if( o.new_issuer )
@@ -255,12 +255,12 @@ void_result asset_update_evaluator::do_evaluate(const asset_update_operation& o)
    if( (d.head_block_time() < HARDFORK_572_TIME) || (a.dynamic_asset_data_id(d).current_supply != 0) )
    {
       // new issuer_permissions must be subset of old issuer permissions
-      FC_ASSERT(!(o.new_options.issuer_permissions & ~a.options.issuer_permissions),
+      FC_ASSERT(!(o.new_options->issuer_permissions & ~a.options.issuer_permissions),
                 "Cannot reinstate previously revoked issuer permissions on an asset.");
    }
 
    // changed flags must be subset of old issuer permissions
-   FC_ASSERT(!((o.new_options.flags ^ a.options.flags) & ~a.options.issuer_permissions),
+   FC_ASSERT(!((o.new_options->flags ^ a.options.flags) & ~a.options.issuer_permissions),
              "Flag change is forbidden by issuer permissions");
 
    asset_to_update = &a;
@@ -268,11 +268,11 @@ void_result asset_update_evaluator::do_evaluate(const asset_update_operation& o)
 
    const auto& chain_parameters = d.get_global_properties().parameters;
 
-   FC_ASSERT( o.new_options.whitelist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
-   for( auto id : o.new_options.whitelist_authorities )
+   FC_ASSERT( o.new_options->whitelist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
+   for( auto id : o.new_options->whitelist_authorities )
       d.get_object(id);
-   FC_ASSERT( o.new_options.blacklist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
-   for( auto id : o.new_options.blacklist_authorities )
+   FC_ASSERT( o.new_options->blacklist_authorities.size() <= chain_parameters.maximum_asset_whitelist_authorities );
+   for( auto id : o.new_options->blacklist_authorities )
       d.get_object(id);
 
    return void_result();
@@ -283,7 +283,7 @@ void_result asset_update_evaluator::do_apply(const asset_update_operation& o)
    database& d = db();
 
    // If we are now disabling force settlements, cancel all open force settlement orders
-   if( o.new_options.flags & disable_force_settle && asset_to_update->can_force_settle() )
+   if( o.new_options->flags & disable_force_settle && asset_to_update->can_force_settle() )
    {
       const auto& idx = d.get_index_type<force_settlement_index>().indices().get<by_expiration>();
       // Funky iteration code because we're removing objects as we go. We have to re-initialize itr every loop instead
@@ -297,7 +297,7 @@ void_result asset_update_evaluator::do_apply(const asset_update_operation& o)
    d.modify(*asset_to_update, [&](asset_object& a) {
       if( o.new_issuer )
          a.issuer = *o.new_issuer;
-      a.options = o.new_options;
+      a.options = *o.new_options;
    });
 
    return void_result();
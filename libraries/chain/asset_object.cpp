@@ -46,7 +46,10 @@ share_type asset_bitasset_data_object::max_force_settlement_volume(share_type cu
 void graphene::chain::asset_bitasset_data_object::update_median_feeds(time_point_sec current_time)
 {
    current_feed_publication_time = current_time;
-   vector<std::reference_wrapper<const price_feed>> current_feeds;
+   // Feeds are republished every few blocks, so keep the scratch buffer around instead of reallocating it each time
+   static thread_local vector<std::reference_wrapper<const price_feed>> current_feeds;
+   current_feeds.clear();
+   current_feeds.reserve( feeds.size() );
    for( const pair<account_id_type, pair<time_point_sec,price_feed>>& f : feeds )
    {
       if( (current_time - f.second.first).to_seconds() < options.feed_lifetime_sec &&
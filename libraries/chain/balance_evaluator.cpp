@@ -23,6 +23,8 @@
  */
 #include <graphene/chain/balance_evaluator.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
 void_result balance_claim_evaluator::do_evaluate(const balance_claim_operation& op)
@@ -30,12 +32,9 @@ void_result balance_claim_evaluator::do_evaluate(const balance_claim_operation&
    database& d = db();
    balance = &op.balance_to_claim(d);
 
+   const key_addresses& owner_addresses = addresses_of( op.balance_owner_key );
    GRAPHENE_ASSERT(
-             op.balance_owner_key == balance->owner ||
-             pts_address(op.balance_owner_key, false, 56) == balance->owner ||
-             pts_address(op.balance_owner_key, true, 56) == balance->owner ||
-             pts_address(op.balance_owner_key, false, 0) == balance->owner ||
-             pts_address(op.balance_owner_key, true, 0) == balance->owner,
+             std::find( owner_addresses.begin(), owner_addresses.end(), balance->owner ) != owner_addresses.end(),
              balance_claim_owner_mismatch,
              "Balance owner key was specified as '${op}' but balance's actual owner is '${bal}'",
              ("op", op.balance_owner_key)
@@ -24,56 +24,422 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/io/json.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+
 namespace graphene { namespace chain {
 
 struct index_entry
 {
+   /** set in block_size when the stored block is a deflated record rather than the packed block */
+   static const uint32_t compressed_flag = 0x80000000;
+
    uint64_t      block_pos = 0;
    uint32_t      block_size = 0;
    block_id_type block_id;
+
+   uint32_t stored_size()const   { return block_size & ~compressed_flag; }
+   bool     is_compressed()const { return ( block_size & compressed_flag ) != 0; }
 };
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
+namespace {
+
+/** true for "blocks" and the "blocks.NNNNNN" of a segment, see block_database::segment_file_name() */
+bool is_blocks_file_name( const std::string& name )
+{
+   if( name == "blocks" )
+      return true;
+   return name.size() == 13 && name.compare( 0, 7, "blocks." ) == 0
+          && std::all_of( name.begin() + 7, name.end(), []( char c ) { return c >= '0' && c <= '9'; } );
+}
+
+/** calls @ref reader with the packed block of @ref e, whose stored record starts at @ref stored */
+void read_record( const index_entry& e, const char* stored,
+                  const std::function<void(const char* packed, size_t size)>& reader )
+{
+   const uint32_t stored_size = e.stored_size();
+   if( e.is_compressed() )
+   {
+      uint32_t packed_size = 0;
+      FC_ASSERT( stored_size > sizeof(packed_size) );
+      memcpy( &packed_size, stored, sizeof(packed_size) );
+      FC_ASSERT( packed_size > 0 );
+
+      vector<char> packed( packed_size );
+      uLongf inflated_size = packed_size;
+      FC_ASSERT( uncompress( (Bytef*)packed.data(), &inflated_size,
+                             (const Bytef*)stored + sizeof(packed_size), stored_size - sizeof(packed_size) ) == Z_OK
+                 && inflated_size == packed_size, "corrupt compressed block" );
+      reader( packed.data(), packed.size() );
+      return;
+   }
+
+   reader( stored, stored_size );
+}
+
+}
+
+const size_t block_database::index_entry_size = sizeof( index_entry );
+
+struct block_database::mapped_file
+{
+   mapped_file( const fc::path& path, uint64_t s )
+      : mapping( path.generic_string().c_str(), fc::read_only ),
+        region( mapping, fc::read_only, 0, s ),
+        size( s ) {}
+
+   const char* data()const { return (const char*)region.get_address(); }
+
+   fc::file_mapping  mapping;
+   fc::mapped_region region;
+   uint64_t          size;
+};
+
+block_database::~block_database()
+{
+   stop_writer();
+}
+
+void block_database::set_memory_mapped( bool enabled )
+{
+   FC_ASSERT( !is_open(), "the block database access mode can only be changed while it is closed" );
+   _memory_mapped = enabled;
+}
+
+void block_database::set_segment_size( uint32_t segment_size )
+{
+   FC_ASSERT( !is_open(), "the block database layout can only be changed while it is closed" );
+   _new_segment_size = segment_size;
+}
+
+void block_database::set_compression_level( int level )
+{
+   FC_ASSERT( level >= 0 && level <= 9, "invalid compression level ${l}", ("l",level) );
+   _compression_level = level;
+}
+
+void block_database::set_write_behind( uint32_t flush_interval )
+{
+   FC_ASSERT( !is_open(), "the block database write mode can only be changed while it is closed" );
+   _write_behind_interval = flush_interval;
+}
+
+void block_database::flush_through( uint32_t block_num )
+{
+   if( _write_behind_interval == 0 )
+      return;
+   {
+      std::lock_guard<std::mutex> lock( _queue_mutex );
+      _flush_through = std::max( _flush_through, block_num );
+   }
+   _queue_changed.notify_all();
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
-   if( !fc::exists( dbdir/"index" ) )
+   _dir        = dbdir;
+   _index_path = dbdir / "index";
+   const fc::path layout_path = dbdir / "layout";
+
+   if( !fc::exists( _index_path ) )
+   {
+     // a new database, drop block files left behind without an index
+     vector<fc::path> stale;
+     for( fc::directory_iterator itr( dbdir ); itr != fc::directory_iterator(); ++itr )
+     {
+        const fc::path file = *itr;
+        if( is_blocks_file_name( file.filename().generic_string() ) )
+           stale.push_back( file );
+     }
+     for( const auto& file : stale )
+        fc::remove( file );
+
+     _layout = block_storage_layout();
+     _layout.segment_size = _new_segment_size;
+     if( _layout.segment_size > 0 )
+        fc::json::save_to_file( _layout, layout_path );
+     else if( fc::exists( layout_path ) )
+        fc::remove( layout_path );
+
+     _block_num_to_pos.open( _index_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+   }
+   else
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     if( fc::exists( layout_path ) )
+        _layout = fc::json::from_file( layout_path ).as<block_storage_layout>();
+     else
+        _layout = block_storage_layout();
+
+     _block_num_to_pos.open( _index_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
    }
+
+   _first_segment = 0;
+   if( _layout.segment_size == 0 )
+      segment_stream( 0, true );
    else
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      // pruning deletes the oldest segments first, the oldest one left marks where it stopped
+      bool found = false;
+      uint32_t first = 0;
+      for( fc::directory_iterator itr( dbdir ); itr != fc::directory_iterator(); ++itr )
+      {
+         const fc::path file = *itr;
+         const std::string name = file.filename().generic_string();
+         if( name != "blocks" && is_blocks_file_name( name ) )
+         {
+            const uint32_t segment = std::stoul( name.substr( 7 ) );
+            if( !found || segment < first )
+            {
+               first = segment;
+               found = true;
+            }
+         }
+      }
+      _first_segment = first;
    }
+
+   recover_tail();
+
+   if( _write_behind_interval > 0 )
+      _writer = std::thread( [this]() { write_queued_blocks(); } );
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _block_num_to_pos.is_open();
 }
 
 void block_database::close()
 {
-  _blocks.close();
+  stop_writer();
+
+  for( auto& segment : _segments )
+     segment.second->close();
+  _segments.clear();
   _block_num_to_pos.close();
+  _last_entry = 0;
+
+  std::lock_guard<std::mutex> lock( _map_mutex );
+  std::atomic_store( &_index_map, mapped_file_ptr() );
+  _segment_maps.clear();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
+  drain_write_queue();
+  std::lock_guard<std::mutex> streams( _stream_mutex );
+  flush_streams();
+}
+
+void block_database::flush_streams()
+{
+  for( auto& segment : _segments )
+     segment.second->flush();
   _block_num_to_pos.flush();
 }
 
+void block_database::write_queued_blocks()
+{
+   uint32_t unflushed = 0;
+   std::unique_lock<std::mutex> lock( _queue_mutex );
+   try
+   {
+      while( true )
+      {
+         _queue_changed.wait( lock, [this]() { return _stop_writing || _flush_through > 0 || !_queued.empty(); } );
+         if( _queued.empty() && _flush_through == 0 )
+            break;
+
+         vector<queued_block_ptr> batch;
+         batch.reserve( _queued.size() );
+         for( const auto& item : _queued )
+            batch.push_back( item.second );
+         _writing = true;
+         lock.unlock();
+
+         // the streams are released between blocks so lookups are not held up by the whole batch
+         for( const auto& item : batch )
+         {
+            std::lock_guard<std::mutex> streams( _stream_mutex );
+            write_block( item->id, item->block );
+         }
+         unflushed += batch.size();
+
+         lock.lock();
+         // a block stored again at the same number while the batch was written stays queued
+         for( const auto& item : batch )
+         {
+            auto itr = _queued.find( item->num );
+            if( itr != _queued.end() && itr->second == item )
+               _queued.erase( itr );
+         }
+         const bool durable = _flush_through > 0 && ( _queued.empty() || _queued.begin()->first > _flush_through );
+         if( unflushed > 0 && ( unflushed >= _write_behind_interval || durable ) )
+         {
+            lock.unlock();
+            {
+               std::lock_guard<std::mutex> streams( _stream_mutex );
+               flush_streams();
+            }
+            unflushed = 0;
+            lock.lock();
+         }
+         if( durable )
+            _flush_through = 0;
+         _writing = false;
+         _queue_changed.notify_all();
+      }
+   }
+   catch( ... )
+   {
+      // the blocks that were not written stay queued, so lookups still find them
+      if( !lock.owns_lock() )
+         lock.lock();
+      _write_error = std::current_exception();
+      _writing = false;
+      _queue_changed.notify_all();
+   }
+}
+
+void block_database::drain_write_queue()const
+{
+   if( _write_behind_interval == 0 )
+      return;
+   std::unique_lock<std::mutex> lock( _queue_mutex );
+   _queue_changed.wait( lock, [this]() { return _write_error || ( _queued.empty() && !_writing ); } );
+   if( _write_error )
+      std::rethrow_exception( _write_error );
+}
+
+void block_database::stop_writer()
+{
+   if( !_writer.joinable() )
+      return;
+   {
+      std::lock_guard<std::mutex> lock( _queue_mutex );
+      _stop_writing = true;
+   }
+   _queue_changed.notify_all();
+   _writer.join();
+
+   std::lock_guard<std::mutex> lock( _queue_mutex );
+   if( _write_error )
+      elog( "${n} blocks could not be written to the block database", ("n", _queued.size()) );
+   _queued.clear();
+   _writing      = false;
+   _stop_writing = false;
+   _flush_through = 0;
+   _write_error  = std::exception_ptr();
+}
+
+block_database::queued_block_ptr block_database::find_queued( uint32_t block_num )const
+{
+   if( _write_behind_interval == 0 )
+      return queued_block_ptr();
+   std::lock_guard<std::mutex> lock( _queue_mutex );
+   auto itr = _queued.find( block_num );
+   return itr != _queued.end() ? itr->second : queued_block_ptr();
+}
+
+block_database::queued_block_ptr block_database::last_queued()const
+{
+   if( _write_behind_interval == 0 )
+      return queued_block_ptr();
+   std::lock_guard<std::mutex> lock( _queue_mutex );
+   return _queued.empty() ? queued_block_ptr() : _queued.rbegin()->second;
+}
+
+void block_database::prune_before( uint32_t block_num )
+{ try {
+   if( _layout.segment_size == 0 )
+      return;
+   // the segment holding block_num is kept
+   const uint32_t end = segment_of( block_num );
+   if( end <= _first_segment )
+      return;
+
+   std::lock_guard<std::mutex> streams( _stream_mutex );
+   for( uint32_t segment = _first_segment; segment < end; ++segment )
+   {
+      auto itr = _segments.find( segment );
+      if( itr != _segments.end() )
+      {
+         itr->second->close();
+         _segments.erase( itr );
+      }
+      {
+         // readers holding the mapping keep it until they are done
+         std::lock_guard<std::mutex> lock( _map_mutex );
+         _segment_maps.erase( segment );
+      }
+      _first_segment = segment + 1;
+      const fc::path path = segment_path( segment );
+      if( fc::exists( path ) )
+         fc::remove( path );
+   }
+   ilog( "Pruned the block log before block ${n}", ("n", end * _layout.segment_size) );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+bool block_database::is_pruned( uint32_t block_num )const
+{
+   return _layout.segment_size > 0 && segment_of( block_num ) < _first_segment;
+}
+
+uint32_t block_database::segment_of( uint32_t block_num )const
+{
+   return _layout.segment_size > 0 ? block_num / _layout.segment_size : 0;
+}
+
+std::string block_database::segment_file_name( uint32_t segment )
+{
+   char name[32];
+   snprintf( name, sizeof(name), "blocks.%06u", segment );
+   return name;
+}
+
+fc::path block_database::segment_path( uint32_t segment )const
+{
+   if( _layout.segment_size == 0 )
+      return _dir / "blocks";
+   return _dir / segment_file_name( segment );
+}
+
+std::fstream& block_database::segment_stream( uint32_t segment, bool create )const
+{
+   auto& stream = _segments[segment];
+   if( !stream )
+   {
+      const fc::path path = segment_path( segment );
+      auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+      if( !fc::exists( path ) )
+      {
+         FC_ASSERT( create, "blocks file ${f} is missing", ("f",path) );
+         mode |= std::fstream::trunc;
+      }
+
+      std::unique_ptr<std::fstream> s( new std::fstream );
+      s->exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      s->open( path.generic_string().c_str(), mode );
+      stream = std::move( s );
+   }
+   return *stream;
+}
+
 void block_database::store( const block_id_type& _id, const signed_block& b )
 {
    block_id_type id = _id;
@@ -82,49 +448,384 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
+
+   if( _write_behind_interval == 0 )
+   {
+      std::lock_guard<std::mutex> streams( _stream_mutex );
+      write_block( id, b );
+      return;
+   }
+
+   auto queued = std::make_shared<const queued_block>( queued_block{ block_header::num_from_id(id), id, b } );
+   {
+      std::lock_guard<std::mutex> lock( _queue_mutex );
+      if( _write_error )
+         std::rethrow_exception( _write_error );
+      _queued[queued->num] = queued;
+   }
+   _queue_changed.notify_all();
+}
+
+void block_database::write_block( const block_id_type& id, const signed_block& b )
+{
    auto num = block_header::num_from_id(id);
-   _block_num_to_pos.seekp( sizeof( index_entry ) * num );
+   // a queued block may fall behind the retention window before it is written
+   if( is_pruned( num ) )
+      return;
    index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
    e.block_size = vec.size();
+
+   if( _compression_level > 0 )
+   {
+      // [uint32 packed size][zlib stream], kept only when it is actually smaller than the block
+      const uint32_t packed_size = vec.size();
+      uLongf deflated_size = compressBound( packed_size );
+      vector<char> deflated( sizeof(packed_size) + deflated_size );
+      memcpy( deflated.data(), &packed_size, sizeof(packed_size) );
+      if( compress2( (Bytef*)deflated.data() + sizeof(packed_size), &deflated_size,
+                     (const Bytef*)vec.data(), packed_size, _compression_level ) == Z_OK
+          && sizeof(packed_size) + deflated_size < packed_size )
+      {
+         deflated.resize( sizeof(packed_size) + deflated_size );
+         vec = std::move( deflated );
+         e.block_size = vec.size() | index_entry::compressed_flag;
+      }
+   }
+
+   std::fstream& blocks = segment_stream( segment_of( num ), true );
+   blocks.seekp( 0, blocks.end );
+   e.block_pos  = blocks.tellp();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
+   blocks.write( vec.data(), vec.size() );
+   // mapped readers must never find an index entry that points past the end of the blocks file
+   if( _memory_mapped )
+      blocks.flush();
+   _block_num_to_pos.seekp( sizeof( index_entry ) * num );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   if( _memory_mapped )
+      _block_num_to_pos.flush();
+   if( num > _last_entry )
+      _last_entry = num;
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
-   index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
-      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+   drain_write_queue();
+   const uint32_t num = block_header::num_from_id(id);
+   {
+      std::lock_guard<std::mutex> streams( _stream_mutex );
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      index_entry e;
+      auto index_pos = sizeof(e)*num;
+      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      if ( _block_num_to_pos.tellg() <= index_pos )
+         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   if( e.block_id == id )
-   {
+      _block_num_to_pos.seekg( index_pos );
+      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+
+      if( e.block_id != id )
+         return;
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
+      _block_num_to_pos.seekp( sizeof(e)*num );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      if( _memory_mapped )
+         _block_num_to_pos.flush();
    }
+   if( num == _last_entry )
+      _last_entry = find_last_entry( num );
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+uint32_t block_database::remove_after( uint32_t block_num )
+{ try {
+   drain_write_queue();
+   const uint32_t last = _last_entry;
+   if( last <= block_num )
+      return 0;
+
+   // a chunk of entries at a time, so removing a long tail does not hold all of its entries at once
+   const uint32_t chunk = 4096;
+   vector<index_entry> entries( std::min( chunk, last - block_num ) );
+   uint32_t removed = 0;
+   for( uint32_t first = block_num + 1; first <= last; first += chunk )
+   {
+      const uint32_t count = read_index_entries( first, std::min( chunk, last - first + 1 ), entries.data() );
+      if( count == 0 )
+         break;
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         if( entries[i].block_size > 0 )
+            ++removed;
+         entries[i].block_size = 0;
+      }
+      std::lock_guard<std::mutex> streams( _stream_mutex );
+      _block_num_to_pos.seekp( sizeof(index_entry) * uint64_t( first ) );
+      _block_num_to_pos.write( (char*)entries.data(), count * sizeof(index_entry) );
+   }
+   if( _memory_mapped )
+   {
+      std::lock_guard<std::mutex> streams( _stream_mutex );
+      _block_num_to_pos.flush();
+   }
+   _last_entry = find_last_entry( block_num + 1 );
+   return removed;
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+block_database::mapped_file_ptr block_database::map_file( mapped_file_ptr& mapping, const fc::path& path, uint64_t required )const
+{
+   mapped_file_ptr current = std::atomic_load( &mapping );
+   if( current && current->size >= required )
+      return current;
+
+   // the file has grown since it was last mapped, only one thread remaps it
+   std::lock_guard<std::mutex> lock( _map_mutex );
+   current = std::atomic_load( &mapping );
+   if( current && current->size >= required )
+      return current;
+
+   const uint64_t size = fc::file_size( path );
+   if( size == 0 || ( current && current->size >= size ) )
+      return current;
+
+   current = std::make_shared<const mapped_file>( path, size );
+   std::atomic_store( &mapping, current );
+   return current;
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_pos = uint64_t( sizeof(e) ) * block_num;
+   if( _memory_mapped )
+   {
+      auto index = map_file( _index_map, _index_path, index_pos + sizeof(e) );
+      if( !index || index->size < index_pos + sizeof(e) )
+         return false;
+      memcpy( (char*)&e, index->data() + index_pos, sizeof(e) );
+      return true;
+   }
+
+   std::lock_guard<std::mutex> streams( _stream_mutex );
+   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+      return false;
+   _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
+   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   return true;
+}
+
+uint32_t block_database::read_index_entries( uint32_t first_block_num, uint32_t count, index_entry* entries )const
+{
+   const uint64_t index_pos = uint64_t( sizeof(index_entry) ) * first_block_num;
+   const uint64_t wanted    = uint64_t( sizeof(index_entry) ) * count;
+   if( _memory_mapped )
+   {
+      auto index = map_file( _index_map, _index_path, index_pos + wanted );
+      if( !index || index->size <= index_pos )
+         return 0;
+      const uint32_t available = uint32_t( std::min<uint64_t>( count, ( index->size - index_pos ) / sizeof(index_entry) ) );
+      memcpy( (char*)entries, index->data() + index_pos, available * sizeof(index_entry) );
+      return available;
+   }
+
+   std::lock_guard<std::mutex> streams( _stream_mutex );
+   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+   const int64_t size = _block_num_to_pos.tellg();
+   if( size <= int64_t(index_pos) )
+      return 0;
+   const uint32_t available = uint32_t( std::min<uint64_t>( count, ( size - index_pos ) / sizeof(index_entry) ) );
+   _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
+   _block_num_to_pos.read( (char*)entries, available * sizeof(index_entry) );
+   return available;
+}
+
+bool block_database::read_last_index_entry( index_entry& e )const
+{
+   const uint32_t last = _last_entry;
+   return last > 0 && read_index_entry( last, e ) && e.block_size > 0;
+}
+
+uint32_t block_database::find_last_entry( uint32_t end )const
+{
+   // read backwards a chunk of entries at a time rather than one entry per seek
+   const uint32_t chunk = 256;
+   vector<index_entry> entries( chunk );
+   while( end > 1 )
+   {
+      const uint32_t first = end > chunk ? end - chunk : 1;
+      const uint32_t count = read_index_entries( first, end - first, entries.data() );
+      for( uint32_t i = count; i > 0; --i )
+         if( entries[i-1].block_size > 0 )
+            return first + i - 1;
+      end = first;
+   }
+   return 0;
+}
+
+bool block_database::is_intact( const index_entry& e )const
+{
+   const uint32_t num = block_header::num_from_id( e.block_id );
+   if( is_pruned( num ) )
+      return true;
+   const fc::path path = segment_path( segment_of( num ) );
+   if( !fc::exists( path ) || fc::file_size( path ) < e.block_pos + e.stored_size() )
+      return false;
+   try
+   {
+      read_packed_block( e );
+      return true;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
+void block_database::recover_tail()
+{
+   // The index entry of a block is written after the block, so all a crash can leave behind is a torn entry at
+   // the end of the index, or entries at its end of blocks that did not make it to disk.  Checking the last
+   // block is enough to tell, the index is only truncated when it finds one of these.
+   const uint64_t size = fc::file_size( _index_path );
+   uint64_t entries = size / sizeof(index_entry);
+   bool truncate = size != entries * sizeof(index_entry);
+
+   uint32_t last = find_last_entry( uint32_t( entries ) );
+   index_entry e;
+   while( last > 0 && !( read_index_entry( last, e ) && e.block_id != block_id_type() && is_intact( e ) ) )
+   {
+      wlog( "Dropping block ${n} from the block database, it was not completely written", ("n",last) );
+      truncate = true;
+      entries = last;
+      last = find_last_entry( last );
+   }
+
+   if( truncate )
+   {
+      {
+         // the mapping may not outlive the part of the file it covers
+         std::lock_guard<std::mutex> lock( _map_mutex );
+         std::atomic_store( &_index_map, mapped_file_ptr() );
+      }
+      _block_num_to_pos.close();
+      fc::resize_file( _index_path, entries * sizeof(index_entry) );
+      _block_num_to_pos.open( _index_path.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   }
+   _last_entry = last;
+}
+
+void block_database::read_stored_block( const index_entry& e,
+                                        const std::function<void(const char* packed, size_t size)>& reader )const
+{
+   const uint32_t segment     = segment_of( block_header::num_from_id( e.block_id ) );
+   const uint32_t stored_size = e.stored_size();
+   // opening the stream of a pruned segment would create an empty file
+   FC_ASSERT( segment >= _first_segment, "block ${n} has been pruned", ("n", block_header::num_from_id( e.block_id )) );
+
+   mapped_file_ptr blocks;
+   vector<char>    data;
+   const char*     stored = nullptr;
+   if( _memory_mapped )
+   {
+      mapped_file_ptr* slot;
+      {
+         std::lock_guard<std::mutex> lock( _map_mutex );
+         slot = &_segment_maps[segment];
+      }
+      blocks = map_file( *slot, segment_path( segment ), e.block_pos + stored_size );
+      FC_ASSERT( blocks && blocks->size >= e.block_pos + stored_size, "block data is past the end of the blocks file" );
+      stored = blocks->data() + e.block_pos;
+   }
+   else
+   {
+      std::lock_guard<std::mutex> streams( _stream_mutex );
+      std::fstream& stream = segment_stream( segment );
+      data.resize( stored_size );
+      stream.seekg( e.block_pos );
+      if( stored_size )
+         stream.read( data.data(), stored_size );
+      stored = data.data();
+   }
+
+   read_record( e, stored, reader );
+}
+
+std::pair<uint64_t, uint64_t> block_database::segment_copy_span( uint32_t first_block_num, uint32_t last_block_num,
+                                                                const vector<char>& index )
+{ try {
+   FC_ASSERT( first_block_num > 0 && first_block_num <= last_block_num );
+   const uint64_t count = uint64_t( last_block_num ) - first_block_num + 1;
+   FC_ASSERT( index.size() >= count * sizeof( index_entry ), "the index holds ${n} bytes, ${c} entries need more",
+              ("n",index.size())("c",count) );
+
+   std::pair<uint64_t, uint64_t> span( std::numeric_limits<uint64_t>::max(), 0 );
+   for( uint64_t i = 0; i < count; ++i )
+   {
+      index_entry e;
+      memcpy( (char*)&e, index.data() + i * sizeof( index_entry ), sizeof( index_entry ) );
+      FC_ASSERT( e.block_pos <= std::numeric_limits<uint64_t>::max() - e.stored_size() );
+      span.first = std::min( span.first, e.block_pos );
+      span.second = std::max( span.second, e.block_pos + e.stored_size() );
+   }
+   return span;
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(last_block_num) ) }
+
+vector<signed_block> block_database::read_segment_copy( uint32_t first_block_num, uint32_t last_block_num,
+                                                       const vector<char>& index, const vector<char>& segment,
+                                                       uint64_t segment_offset )
+{ try {
+   FC_ASSERT( first_block_num > 0 && first_block_num <= last_block_num );
+   const uint64_t count = uint64_t( last_block_num ) - first_block_num + 1;
+   FC_ASSERT( index.size() >= count * sizeof( index_entry ), "the index holds ${n} bytes, ${c} entries need more",
+              ("n",index.size())("c",count) );
+
+   vector<signed_block> blocks;
+   blocks.reserve( count );
+   for( uint64_t i = 0; i < count; ++i )
+   {
+      index_entry e;
+      memcpy( (char*)&e, index.data() + i * sizeof( index_entry ), sizeof( index_entry ) );
+      const uint32_t num = first_block_num + i;
+      FC_ASSERT( e.stored_size() > 0 && block_header::num_from_id( e.block_id ) == num,
+                 "block ${n} is missing from the index", ("n",num) );
+      FC_ASSERT( e.block_pos >= segment_offset && e.block_pos - segment_offset + e.stored_size() <= segment.size(),
+                 "block ${n} is outside the copy of the segment", ("n",num) );
+
+      signed_block b;
+      read_record( e, segment.data() + ( e.block_pos - segment_offset ), [&]( const char* packed, size_t size ) {
+         fc::datastream<const char*> ds( packed, size );
+         fc::raw::unpack( ds, b );
+      });
+      FC_ASSERT( b.id() == e.block_id, "block ${n} is not the block its index entry names", ("n",num) );
+      blocks.push_back( std::move( b ) );
+   }
+   return blocks;
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(last_block_num) ) }
+
+signed_block block_database::read_block( const index_entry& e )const
+{
+   signed_block result;
+   read_stored_block( e, [&]( const char* packed, size_t size ) {
+      fc::datastream<const char*> ds( packed, size );
+      fc::raw::unpack( ds, result );
+   });
+   return result;
+}
+
 bool block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
 
+   if( auto queued = find_queued( block_header::num_from_id(id) ) )
+      return queued->id == id;
+
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size > 0;
 }
@@ -132,39 +833,73 @@ bool block_database::contains( const block_id_type& id )const
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
+   if( auto queued = find_queued( block_num ) )
+      return queued->id;
+
    index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
+vector<block_id_type> block_database::fetch_block_ids( uint32_t first_block_num, uint32_t count )const
+{
+   assert( first_block_num != 0 );
+   vector<index_entry> entries( count );
+   entries.resize( read_index_entries( first_block_num, count, entries.data() ) );
+
+   vector<block_id_type> result;
+   result.reserve( count );
+   for( const index_entry& e : entries )
+      result.push_back( e.block_id );
+
+   if( _write_behind_interval != 0 )
+   {
+      // the writer thread may not have caught up, queued blocks win over what the index says
+      std::lock_guard<std::mutex> lock( _queue_mutex );
+      for( auto itr = _queued.lower_bound( first_block_num );
+           itr != _queued.end() && itr->first - first_block_num < count; ++itr )
+      {
+         const uint32_t offset = itr->first - first_block_num;
+         if( offset > result.size() )
+            break;
+         if( offset == result.size() )
+            result.push_back( itr->second->id );
+         else
+            result[offset] = itr->second->id;
+      }
+   }
+
+   for( size_t i = 0; i < result.size(); ++i )
+      if( result[i] == block_id_type() )
+      {
+         // the index may have room reserved past the last block
+         result.resize( i );
+         break;
+      }
+   return result;
+}
+
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
+      if( auto queued = find_queued( block_header::num_from_id(id) ) )
+      {
+         if( queued->id != id )
+            return optional<signed_block>();
+         return queued->block;
+      }
+
       index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = read_block( e );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -181,19 +916,14 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
+      if( auto queued = find_queued( block_num ) )
+         return queued->block;
+
       index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = read_block( e );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -206,34 +936,83 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<signed_block> block_database::last()const
+vector<char> block_database::read_packed_block( const index_entry& e )const
+{
+   // the header at the front of the block is enough to check that the index entry is still current
+   vector<char> result;
+   read_stored_block( e, [&]( const char* packed, size_t size ) {
+      fc::datastream<const char*> ds( packed, size );
+      signed_block_header header;
+      fc::raw::unpack( ds, header );
+      FC_ASSERT( header.id() == e.block_id );
+      result.assign( packed, packed + size );
+   });
+   return result;
+}
+
+optional<vector<char>> block_database::fetch_packed_by_number( uint32_t block_num )const
 {
    try
    {
-      index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      if( auto queued = find_queued( block_num ) )
+         return fc::raw::pack( queued->block );
 
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<signed_block>();
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size == 0 )
+         return {};
+      return read_packed_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<vector<char>>();
+}
 
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
+optional<vector<char>> block_database::fetch_block_bytes( const block_id_type& id )const
+{
+   try
+   {
+      if( auto queued = find_queued( block_header::num_from_id(id) ) )
       {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
+         if( queued->id != id )
+            return {};
+         return fc::raw::pack( queued->block );
       }
 
-      if( e.block_size == 0 )
+      index_entry e;
+      if( !read_index_entry( block_header::num_from_id(id), e ) || e.block_size == 0 || e.block_id != id )
+         return {};
+      return read_packed_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<vector<char>>();
+}
+
+optional<signed_block> block_database::last()const
+{
+   try
+   {
+      // the queue is read first, a block the writer thread takes meanwhile is then found on disk
+      auto queued = last_queued();
+      index_entry e;
+      if( !read_last_index_entry( e ) )
+      {
+         if( queued )
+            return queued->block;
          return optional<signed_block>();
+      }
+      if( queued && queued->num >= block_header::num_from_id( e.block_id ) )
+         return queued->block;
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -248,24 +1027,16 @@ optional<block_id_type> block_database::last_id()const
 {
    try
    {
+      auto queued = last_queued();
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<block_id_type>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
+      if( !read_last_index_entry( e ) )
       {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
+         if( queued )
+            return queued->id;
          return optional<block_id_type>();
+      }
+      if( queued && queued->num >= block_header::num_from_id( e.block_id ) )
+         return queued->id;
 
       return e.block_id;
    }
@@ -33,10 +33,15 @@ namespace graphene { namespace chain {
 
 asset database::get_balance(account_id_type owner, asset_id_type asset_id) const
 {
-   auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
+   // a balance found counts as a read of it, one that is missing as a read of the whole index
+   auto& index = get_index_type_unlogged<account_balance_index>().indices().get<by_account_asset_hash>();
    auto itr = index.find(boost::make_tuple(owner, asset_id));
    if( itr == index.end() )
+   {
+      log_index_read<account_balance_index>();
       return asset(0, asset_id);
+   }
+   log_read( itr->id );
    return itr->get_balance();
 }
 
@@ -55,10 +60,11 @@ void database::adjust_balance(account_id_type account, asset delta )
    if( delta.amount == 0 )
       return;
 
-   auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
+   auto& index = get_index_type_unlogged<account_balance_index>().indices().get<by_account_asset_hash>();
    auto itr = index.find(boost::make_tuple(account, delta.asset_id));
    if(itr == index.end())
    {
+      log_index_read<account_balance_index>();
       FC_ASSERT( delta.amount > 0, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", 
                  ("a",account(*this).name)
                  ("b",to_pretty_string(asset(0,delta.asset_id)))
@@ -69,6 +75,7 @@ void database::adjust_balance(account_id_type account, asset delta )
          b.balance = delta.amount.value;
       });
    } else {
+      log_read( itr->id );
       if( delta.amount < 0 )
          FC_ASSERT( itr->get_balance() >= -delta, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", ("a",account(*this).name)("b",to_pretty_string(itr->get_balance()))("r",to_pretty_string(-delta)));
       modify(*itr, [delta](account_balance_object& b) {
@@ -26,6 +26,8 @@
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/hardfork.hpp>
 
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
@@ -35,11 +37,44 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/trace.hpp>
 
 #include <fc/smart_ref_impl.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+
 namespace graphene { namespace chain {
 
+namespace {
+   /** the skip flags _apply_transaction() reads, the other ones do not pick a profile */
+   const uint32_t transaction_skip_mask = database::skip_transaction_signatures | database::skip_authority_check |
+                                          database::skip_transaction_dupe_check | database::skip_tapos_check;
+
+   /** skip flags known at compile time, the checks they skip and do not skip are compiled in or out */
+   template<uint32_t Flags>
+   struct static_skip_flags
+   {
+      bool operator()( uint32_t flag )const { return (Flags & flag) != 0; }
+   };
+   /** skip flags of the profiles that are not instantiated, read at run time */
+   struct dynamic_skip_flags
+   {
+      uint32_t flags;
+      bool operator()( uint32_t flag )const { return (flags & flag) != 0; }
+   };
+
+   /** full checks, for pushed transactions and block production */
+   typedef static_skip_flags< database::skip_nothing > full_skip_flags;
+   /** the transactions of a block, whose signatures are checked with the block */
+   typedef static_skip_flags< database::skip_transaction_signatures > block_skip_flags;
+   /** the transactions of a replay with the default replay skip flags */
+   typedef static_skip_flags< database::skip_transaction_signatures | database::skip_authority_check |
+                              database::skip_transaction_dupe_check | database::skip_tapos_check > replay_skip_flags;
+}
+
 bool database::is_known_block( const block_id_type& id )const
 {
    return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
@@ -60,6 +95,11 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+vector<block_id_type> database::get_block_ids_for_nums( uint32_t first_block_num, uint32_t count )const
+{ try {
+   return _block_id_to_block.fetch_block_ids( first_block_num, count );
+} FC_CAPTURE_AND_RETHROW( (first_block_num)(count) ) }
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
    auto b = _fork_db.fetch_block( id );
@@ -78,12 +118,34 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
    return optional<signed_block>();
 }
 
-const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
+optional<vector<char>> database::fetch_packed_block_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return fc::raw::pack( results[0]->data );
+   return _block_id_to_block.fetch_packed_by_number(num);
+}
+
+optional<vector<char>> database::fetch_packed_block_by_id( const block_id_type& id )const
+{
+   auto b = _fork_db.fetch_block( id );
+   if( b )
+      return fc::raw::pack( b->data );
+   return _block_id_to_block.fetch_block_bytes( id );
+}
+
+signed_transaction database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
    auto itr = index.find(trx_id);
    FC_ASSERT(itr != index.end());
-   return itr->trx;
+   if( itr->trx.valid() )
+      return *itr->trx;
+
+   optional<signed_block> block = fetch_block_by_number( itr->block_num );
+   FC_ASSERT( block.valid() && itr->trx_in_block < block->transactions.size(),
+              "Block ${b} of transaction ${id} is not available", ("b",itr->block_num)("id",trx_id) );
+   return block->transactions[itr->trx_in_block];
 }
 
 std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of_fork) const
@@ -112,7 +174,21 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
+   state_write_lock write_lock( *this );
+   GRAPHENE_TRACE_SPAN( "push_block" );
+   graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_block_apply );
    //idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   const fc::time_point start = fc::time_point::now();
+   _block_timing = block_timing();
+   _block_timing.block_num = new_block.block_num();
+   _block_timing.transactions = new_block.transactions.size();
+   if( !(skip & skip_transaction_signatures) && !(checkpoint_skip_flags( new_block.block_num() ) & skip_transaction_signatures) )
+      precompute_signature_keys( new_block );
+   _block_timing.signatures = ( fc::time_point::now() - start ).count();
+   if( graphene::utilities::tracer::enabled() )
+      graphene::utilities::tracer::record( "signatures", start.time_since_epoch().count(),
+                                           start.time_since_epoch().count() + _block_timing.signatures );
+
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -122,18 +198,386 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
          result = _push_block(new_block);
       });
    });
+
+   _block_timing.total = ( fc::time_point::now() - start ).count();
+   if( graphene::utilities::allocation_stats::hooked() )
+   {
+      const graphene::utilities::allocation_snapshot allocations = graphene::utilities::allocation_stats::snapshot();
+      _block_timing.allocations = ( allocations - _allocations_at_last_block ).by_phase();
+      _allocations_at_last_block = allocations;
+   }
+   _last_block_timing = _block_timing;
+   _block_timing_statistics.add( _block_timing );
+   if( _slow_block_threshold.count() > 0 && _block_timing.total > _slow_block_threshold.count() )
+   {
+      ++_block_timing_statistics.slow_blocks;
+      _block_timing_statistics.last_slow_block = _block_timing;
+      wlog( "Slow block #${n} took ${t} us: ${b}", ("n", _block_timing.block_num)("t", _block_timing.total)("b", _block_timing) );
+   }
    return result;
 }
 
+void block_timing_statistics::add( const block_timing& timing )
+{
+   fork_db.add( timing.fork_db );
+   header.add( timing.header );
+   signatures.add( timing.signatures );
+   apply_transactions.add( timing.apply_transactions );
+   chain_updates.add( timing.chain_updates );
+   maintenance.add( timing.maintenance );
+   handlers.add( timing.handlers );
+   total.add( timing.total );
+}
+
+database::state_write_lock::state_write_lock( database& db )
+   : _db( db )
+{
+   // calls that modify the state call each other, only the outermost one takes the lock; another thread
+   // waits for it rather than counting itself in
+   if( _db._state_writer.load() == std::this_thread::get_id() )
+   {
+      ++_db._state_writers;
+      return;
+   }
+   _db._state_mutex.lock();
+   _db._state_writer = std::this_thread::get_id();
+   _db._state_writers = 1;
+}
+
+database::state_write_lock::~state_write_lock()
+{
+   if( --_db._state_writers > 0 )
+      return;
+   _db._state_writer = std::thread::id();
+   _db._state_mutex.unlock();
+}
+
+void database::set_signature_threads( uint32_t threads, graphene::utilities::executor* shared )
+{
+   wait_for_prevalidated_blocks();
+   _signature_threads.clear();
+   _signature_executor = threads > 0 ? shared : nullptr;
+   _signature_parallelism = _signature_executor ? threads : 0;
+   if( _signature_executor )
+      return;
+   for( uint32_t i = 0; i < threads; ++i )
+      _signature_threads.emplace_back( new fc::thread( "signature_keys_" + fc::to_string(i) ) );
+}
+
+size_t database::signature_workers()const
+{
+   return _signature_executor ? _signature_parallelism : _signature_threads.size();
+}
+
+fc::future<void> database::run_on_signature_thread( const char* type, const std::function<void()>& task,
+                                                    graphene::utilities::task_priority priority )
+{
+   if( !_signature_executor )
+   {
+      fc::thread& thread = *_signature_threads[ _next_prevalidation_thread++ % _signature_threads.size() ];
+      return thread.async( task, type );
+   }
+
+   fc::promise<void>::ptr p( new fc::promise<void>( type ) );
+   std::function<void()> run = [p, task, type]() {
+      try {
+         task();
+         p->set_value();
+      } catch( const fc::exception& e ) {
+         p->set_exception( e.dynamic_copy_exception() );
+      } catch( ... ) {
+         p->set_exception( std::make_shared<fc::unhandled_exception>(
+            FC_LOG_MESSAGE( warn, "unhandled exception in ${type}", ("type",type) ), std::current_exception() ) );
+      }
+   };
+   {
+      std::lock_guard<std::mutex> lock( _signature_backlog_mutex );
+      if( _signature_tasks_running >= _signature_parallelism )
+      {
+         _signature_backlog[priority].push_back( signature_task{ type, std::move( run ) } );
+         return fc::future<void>( p );
+      }
+      ++_signature_tasks_running;
+   }
+   post_signature_task( type, priority, run );
+   return fc::future<void>( p );
+}
+
+void database::post_signature_task( const char* type, graphene::utilities::task_priority priority,
+                                    const std::function<void()>& task )
+{
+   _signature_executor->async( type, [this, task]() {
+      task();
+      optional<signature_task> next;
+      graphene::utilities::task_priority next_priority = graphene::utilities::priority_high;
+      {
+         std::lock_guard<std::mutex> lock( _signature_backlog_mutex );
+         for( uint32_t i = 0; i < graphene::utilities::task_priority_count && !next; ++i )
+            if( !_signature_backlog[i].empty() )
+            {
+               next = std::move( _signature_backlog[i].front() );
+               _signature_backlog[i].pop_front();
+               next_priority = graphene::utilities::task_priority( i );
+            }
+         if( !next )
+            --_signature_tasks_running;
+      }
+      if( next )
+         post_signature_task( next->type, next_priority, next->run );
+   }, priority );
+}
+
+const flat_set<public_key_type>& database::recover_signature_keys( const signed_transaction& trx )const
+{
+   return trx.get_signature_keys( get_chain_id(), [this]( const signature_type& sig, const digest_type& d ) {
+      return _signature_key_cache.recover( sig, d );
+   } );
+}
+
+void database::run_on_signature_threads( size_t count, const std::function<void(size_t)>& task )
+{
+   if( _signature_executor )
+   {
+      _signature_executor->run_parallel( "run_on_signature_threads", count, task, _signature_parallelism );
+      return;
+   }
+   const size_t thread_count = std::min( _signature_threads.size(), count );
+   std::atomic<size_t> next(0);
+   vector< fc::future<void> > results;
+   results.reserve( thread_count );
+   for( size_t i = 0; i < thread_count; ++i )
+      results.push_back( _signature_threads[i]->async( [&]() {
+         for( size_t n = next++; n < count; n = next++ )
+            task( n );
+      }, "run_on_signature_threads" ) );
+
+   for( auto& r : results )
+      r.wait();
+}
+
+void database::precompute_signature_keys( size_t count, const std::function<const signed_transaction&(size_t)>& get )
+{
+   if( signature_workers() == 0 || count < 2 )
+      return;
+
+   run_on_signature_threads( count, [&]( size_t n ) {
+      // invalid signatures are reported again when the transaction is applied
+      try { recover_signature_keys( get( n ) ); } catch( ... ) {}
+   } );
+}
+
+bool database::prevalidate_transactions( const signed_block& b )
+{
+   if( signature_workers() == 0 || b.transactions.size() < 2 )
+      return false;
+
+   std::atomic<bool> valid(true);
+   run_on_signature_threads( b.transactions.size(), [&]( size_t n ) {
+      // the failing transaction is validated again in order, so the block fails with its error
+      try { validate_transaction_stateless( b.transactions[n] ); } catch( ... ) { valid = false; }
+   } );
+   return valid;
+}
+
+void database::validate_transaction_stateless( const signed_transaction& trx )const
+{
+   const bool confidential = std::any_of( trx.operations.begin(), trx.operations.end(), []( const operation& op ) {
+      return op.which() == operation::tag<transfer_to_blind_operation>::value
+          || op.which() == operation::tag<transfer_from_blind_operation>::value
+          || op.which() == operation::tag<blind_transfer_operation>::value;
+   } );
+   if( !confidential )
+   {
+      trx.validate();
+      return;
+   }
+
+   // the id covers everything validate() looks at, the signatures are not part of it
+   const transaction_id_type id = trx.id();
+   {
+      std::lock_guard<std::mutex> lock( _validated_trx_mutex );
+      if( _validated_trxs.count( id ) )
+         return;
+   }
+   trx.validate();
+
+   std::lock_guard<std::mutex> lock( _validated_trx_mutex );
+   if( !_validated_trxs.insert( id ).second )
+      return;
+   _validated_trx_order.push_back( id );
+   if( _validated_trx_order.size() > max_validated_trxs )
+   {
+      _validated_trxs.erase( _validated_trx_order.front() );
+      _validated_trx_order.pop_front();
+   }
+}
+
+bool database::prevalidate_block( const signed_block& b, uint32_t skip )
+{
+   if( signature_workers() == 0 )
+      return false;
+   // the checks apply_block() skips for blocks up to the last checkpoint are not worth doing ahead
+   skip |= checkpoint_skip_flags( b.block_num() );
+
+   std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+   while( !_prevalidations.empty() && _prevalidations.front().ready() )
+      _prevalidations.pop_front();
+   if( _prevalidations.size() >= max_prevalidated_blocks )
+      return false;
+
+   auto block = std::make_shared<const signed_block>( b );
+   _prevalidations.push_back( run_on_signature_thread( "prevalidate_block", [this, block, skip]() {
+      // whatever fails here fails again when the block is pushed
+      try {
+         if( !(skip & skip_merkle_check) && block->transaction_merkle_root == block->calculate_merkle_root() )
+         {
+            vector<char> body = fc::raw::pack( block->transactions );
+            std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+            _merkle_checked_blocks[ std::make_pair( block->block_num(), block->id() ) ] = std::move( body );
+         }
+         if( !(skip & skip_witness_signature) )
+            _signature_key_cache.recover( block->witness_signature, block->digest() );
+         if( !(skip & skip_transaction_signatures) )
+            for( const auto& trx : block->transactions )
+               try { recover_signature_keys( trx ); } catch( ... ) {}
+         for( const auto& trx : block->transactions )
+            try { validate_transaction_stateless( trx ); } catch( ... ) {}
+      } catch( ... ) {}
+   }, graphene::utilities::priority_normal ) );
+   return true;
+}
+
+void database::wait_for_prevalidated_blocks()
+{
+   std::deque< fc::future<void> > prevalidations;
+   {
+      std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+      prevalidations.swap( _prevalidations );
+   }
+   for( auto& p : prevalidations )
+      p.wait();
+}
+
+bool database::merkle_root_prevalidated( const signed_block& b )
+{
+   std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+   if( _merkle_checked_blocks.empty() )
+      return false;
+   const auto checked = _merkle_checked_blocks.find( std::make_pair( b.block_num(), b.id() ) );
+   // packing is much cheaper than hashing the transactions again
+   const bool found = checked != _merkle_checked_blocks.end() && checked->second == fc::raw::pack( b.transactions );
+   // blocks of other forks are kept for a switch to them until they can no longer be applied
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   _merkle_checked_blocks.erase( _merkle_checked_blocks.begin(),
+                                 _merkle_checked_blocks.lower_bound( std::make_pair( last_irreversible + 1, block_id_type() ) ) );
+   return found;
+}
+
+void database::prevalidate_transaction( const signed_transaction& trx, uint32_t skip )
+{
+   prevalidation_limits limits;
+   auto check = [&]() {
+      validate_transaction_stateless( trx );
+      const size_t size = fc::raw::pack_size( trx );
+      FC_ASSERT( limits.maximum_transaction_size == 0 || size <= limits.maximum_transaction_size,
+                 "Transaction is larger than the maximum transaction size",
+                 ("size",size)("max",limits.maximum_transaction_size) );
+      // as in _apply_transaction(), nothing expires before the first block
+      if( limits.head_block_num > 0 )
+      {
+         FC_ASSERT( trx.expiration <= limits.head_block_time + limits.maximum_time_until_expiration, "",
+                    ("trx.expiration",trx.expiration)("now",limits.head_block_time)
+                    ("max_til_exp",limits.maximum_time_until_expiration) );
+         FC_ASSERT( limits.head_block_time <= trx.expiration, "",
+                    ("now",limits.head_block_time)("trx.exp",trx.expiration) );
+      }
+      if( !(skip & skip_transaction_signatures) )
+         recover_signature_keys( trx );
+   };
+
+   fc::future<void> checked;
+   {
+      std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+      limits = _prevalidation_limits;
+      if( signature_workers() > 0 )
+         checked = run_on_signature_thread( "prevalidate_transaction", check, graphene::utilities::priority_normal );
+   }
+   if( checked.valid() )
+      checked.wait();
+   else
+      check();
+}
+
+void database::update_prevalidation_limits()
+{
+   const chain_parameters& parameters = get_global_properties().parameters;
+   std::lock_guard<std::mutex> lock( _prevalidation_mutex );
+   _prevalidation_limits.head_block_num = head_block_num();
+   _prevalidation_limits.head_block_time = head_block_time();
+   _prevalidation_limits.maximum_time_until_expiration = parameters.maximum_time_until_expiration;
+   _prevalidation_limits.maximum_transaction_size = parameters.maximum_transaction_size;
+}
+
+checksum_type database::calculate_merkle_root( const signed_block& b )
+{
+   // below this many hashes a step is done before the threads would have picked it up
+   const size_t min_parallel_hashes = 64;
+   return b.calculate_merkle_root( [this]( size_t count, const std::function<void(size_t)>& task ) {
+      if( signature_workers() == 0 || count < min_parallel_hashes )
+         for( size_t n = 0; n < count; ++n )
+            task( n );
+      else
+         run_on_signature_threads( count, task );
+   } );
+}
+
+void database::precompute_signature_keys( const signed_block& b )
+{
+   precompute_signature_keys( b.transactions.size(), [&b]( size_t n ) -> const signed_transaction& {
+      return b.transactions[n];
+   } );
+}
+
+void database::precompute_signature_keys( const std::deque<signed_transaction>& trxs )
+{
+   precompute_signature_keys( trxs.size(), [&trxs]( size_t n ) -> const signed_transaction& {
+      return trxs[n];
+   } );
+}
+
+void database::precompute_signature_keys( const vector<processed_transaction>& trxs )
+{
+   precompute_signature_keys( trxs.size(), [&trxs]( size_t n ) -> const signed_transaction& {
+      return trxs[n];
+   } );
+}
+
 bool database::_push_block(const signed_block& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
+   shared_ptr<fork_item> new_head;
+   // a block that was applied before, e.g. on the branch a failed fork switch returns to, has a correct merkle root
+   auto apply_fork_item = [&]( const item_ptr& item )
+   {
+      undo_database::session session = _undo_db.start_undo_session();
+      apply_block( item->data, item->merkle_checked ? skip | skip_merkle_check : skip );
+      _block_id_to_block.store( item->id, item->data );
+      session.commit();
+      record_state_diff( item->data );
+      if( !(skip & skip_merkle_check) )
+         item->merkle_checked = true;
+   };
    if( !(skip&skip_fork_db) )
    {
       /// TODO: if the block is greater than the head block and before the next maitenance interval
       // verify that the block signer is in the current set of active witnesses.
 
-      shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
+      const fc::time_point fork_db_start = fc::time_point::now();
+      new_head = _fork_db.push_block(new_block);
+      _block_timing.fork_db = ( fc::time_point::now() - fork_db_start ).count();
+      if( graphene::utilities::tracer::enabled() )
+         graphene::utilities::tracer::record( "fork_db", fork_db_start.time_since_epoch().count(),
+                                              fork_db_start.time_since_epoch().count() + _block_timing.fork_db );
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
       if( new_head->data.previous != head_block_id() )
       {
@@ -141,8 +585,20 @@ bool database::_push_block(const signed_block& new_block)
          //Only switch forks if new_head is actually higher than head
          if( new_head->data.block_num() > head_block_num() )
          {
-            wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
-            auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+            wlog( "Switching to fork: ${id}", ("id",new_head->id) );
+            auto branches = _fork_db.fetch_branch_from(new_head->id, head_block_id());
+
+            // blocks whose undo states were compacted can not be popped, a fork that goes back further is refused
+            // before anything is popped
+            if( _undo_db.enabled() && branches.second.size() > _undo_db.undoable_size() )
+            {
+               for( const auto& item : branches.first )
+                  _fork_db.remove( item->id );
+               _fork_db.set_head( branches.second.front() );
+               FC_THROW_EXCEPTION( undo_database_exception,
+                                   "The fork at block ${n} goes back ${d} blocks, only ${u} can be undone",
+                                   ("n",new_head->num)("d",branches.second.size())("u",_undo_db.undoable_size()) );
+            }
 
             // pop blocks until we hit the forked block
             while( head_block_id() != branches.second.back()->data.previous )
@@ -151,13 +607,10 @@ bool database::_push_block(const signed_block& new_block)
             // push all blocks on the new fork
             for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
             {
-                ilog( "pushing blocks from fork ${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->data.id()) );
+                ilog( "pushing blocks from fork ${n} ${id}", ("n",(*ritr)->num)("id",(*ritr)->id) );
                 optional<fc::exception> except;
                 try {
-                   undo_database::session session = _undo_db.start_undo_session();
-                   apply_block( (*ritr)->data, skip );
-                   _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
-                   session.commit();
+                   apply_fork_item( *ritr );
                 }
                 catch ( const fc::exception& e ) { except = e; }
                 if( except )
@@ -166,7 +619,7 @@ bool database::_push_block(const signed_block& new_block)
                    // remove the rest of branches.first from the fork_db, those blocks are invalid
                    while( ritr != branches.first.rend() )
                    {
-                      _fork_db.remove( (*ritr)->data.id() );
+                      _fork_db.remove( (*ritr)->id );
                       ++ritr;
                    }
                    _fork_db.set_head( branches.second.front() );
@@ -177,32 +630,37 @@ bool database::_push_block(const signed_block& new_block)
 
                    // restore all blocks from the good fork
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
-                   {
-                      auto session = _undo_db.start_undo_session();
-                      apply_block( (*ritr)->data, skip );
-                      _block_id_to_block.store( new_block.id(), (*ritr)->data );
-                      session.commit();
-                   }
+                      apply_fork_item( *ritr );
                    throw *except;
                 }
             }
+            // popping the old branch moved the head of the fork database back to the common ancestor
+            _fork_db.set_head( new_head );
             return true;
          }
          else return false;
       }
    }
 
+   const block_id_type new_block_id = new_block.id();
    try {
-      auto session = _undo_db.start_undo_session();
-      apply_block(new_block, skip);
-      _block_id_to_block.store(new_block.id(), new_block);
-      session.commit();
+      if( new_head && new_head->id == new_block_id )
+         apply_fork_item( new_head );
+      else
+      {
+         auto session = _undo_db.start_undo_session();
+         apply_block(new_block, skip);
+         _block_id_to_block.store(new_block_id, new_block);
+         session.commit();
+         record_state_diff( new_block );
+      }
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
-      _fork_db.remove(new_block.id());
+      _fork_db.remove(new_block_id);
       throw;
    }
 
+   maybe_write_checkpoint();
    return false;
 } FC_CAPTURE_AND_RETHROW( (new_block) ) }
 
@@ -217,6 +675,8 @@ bool database::_push_block(const signed_block& new_block)
  */
 processed_transaction database::push_transaction( const signed_transaction& trx, uint32_t skip )
 { try {
+   state_write_lock write_lock( *this );
+   graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_pending_push );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -225,8 +685,51 @@ processed_transaction database::push_transaction( const signed_transaction& trx,
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+vector<transaction_admission> database::push_transactions( const vector<signed_transaction>& trxs, uint32_t skip )
+{ try {
+   state_write_lock write_lock( *this );
+   graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_pending_push );
+   vector<transaction_admission> results( trxs.size() );
+   if( !(skip & skip_transaction_signatures) )
+      precompute_signature_keys( trxs.size(), [&trxs]( size_t n ) -> const signed_transaction& {
+         return trxs[n];
+      } );
+
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      if( !_pending_tx_session.valid() )
+         _pending_tx_session = _undo_db.start_undo_session();
+
+      // Every transaction gets a temporary session of its own which is merged into the batch session when it
+      // applies, so the changes of the whole batch are reported and merged into the pending session at once.
+      auto batch_session = _undo_db.start_undo_session();
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         try {
+            check_pending_pool_capacity();
+            auto temp_session = _undo_db.start_undo_session();
+            results[i].trx = _apply_pending_transaction( trxs[i] );
+            _pending_tx_skip |= skip;
+            temp_session.merge();
+         } catch( const fc::exception& e ) {
+            results[i].error = e;
+         }
+      }
+
+      notify_changed_objects( false );
+      batch_session.merge();
+
+      for( size_t i = 0; i < trxs.size(); ++i )
+         if( results[i].trx.valid() )
+            on_pending_transaction( trxs[i] );
+   } );
+   return results;
+} FC_CAPTURE_AND_RETHROW( (trxs.size()) ) }
+
 processed_transaction database::_push_transaction( const signed_transaction& trx )
 {
+   check_pending_pool_capacity();
+
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
    if( !_pending_tx_session.valid() )
@@ -238,10 +741,10 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    // apply the changes.
 
    auto temp_session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   auto processed_trx = _apply_pending_transaction( trx );
+   _pending_tx_skip |= get_node_properties().skip_flags;
 
-   notify_changed_objects();
+   notify_changed_objects( false );
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
 
@@ -250,8 +753,272 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    return processed_trx;
 }
 
+processed_transaction database::_apply_pending_transaction( const signed_transaction& trx )
+{
+   pending_transaction_footprint footprint;
+   footprint.applied_on = head_block_id();
+   const bool undo_enabled = _undo_db.enabled();
+   processed_transaction processed_trx = detail::with_read_log( *this, undo_enabled ? &footprint.reads : nullptr,
+                                                                undo_enabled ? &footprint.index_reads : nullptr,
+                                                                [&]() { return _apply_transaction( trx ); } );
+   if( undo_enabled )
+   {
+      for( vector<object_id_type>* ids : { &footprint.reads, &footprint.index_reads } )
+      {
+         std::sort( ids->begin(), ids->end() );
+         ids->erase( std::unique( ids->begin(), ids->end() ), ids->end() );
+      }
+
+      // trx is applied in an undo session of its own, whose undo state holds its changes alone
+      footprint.changes = undo_head_diff();
+      auto is_transaction_object = []( object_id_type id ) {
+         return id.space() == transaction_object::space_id && id.type() == transaction_object::type_id;
+      };
+      auto& objects = footprint.changes.objects;
+      const size_t object_count = objects.size();
+      objects.erase( std::remove_if( objects.begin(), objects.end(),
+                                     [&]( const std::pair<object_id_type, vector<char>>& item ) {
+                                        return is_transaction_object( item.first );
+                                     } ), objects.end() );
+      footprint.dupe_checked = objects.size() != object_count;
+      auto& next_ids = footprint.changes.next_ids;
+      next_ids.erase( std::remove_if( next_ids.begin(), next_ids.end(), is_transaction_object ), next_ids.end() );
+
+      const object_id_type dynamic_properties_id = dynamic_global_property_id_type();
+      footprint.reusable = std::none_of( objects.begin(), objects.end(),
+                                         [&]( const std::pair<object_id_type, vector<char>>& item ) {
+                                            return item.first == dynamic_properties_id;
+                                         } );
+   }
+   _pending_tx.push_back( processed_trx );
+   _pending_footprints.push_back( std::move( footprint ) );
+   return processed_trx;
+}
+
+void database::_restore_pending_transactions( vector<processed_transaction>&& pending,
+                                              vector<pending_transaction_footprint>&& footprints,
+                                              const block_id_type& previous_head )
+{
+   // What changed since the pending transactions were applied is known if the head is still previous_head or is a
+   // block on top of it, whose undo state has its changes.
+   bool reuse = _popped_tx.empty() && _undo_db.enabled() && footprints.size() == pending.size();
+   std::unordered_set<object_id_type> changed;
+   // the indexes that got new ids, and those with any object changed, as (space, type, 0)
+   flat_set<object_id_type> changed_indexes;
+   flat_set<object_id_type> changed_types;
+   auto type_of = []( object_id_type id ) { return object_id_type( id.space(), id.type(), 0 ); };
+   if( reuse && head_block_id() != previous_head )
+   {
+      const shared_ptr<fork_item> head = _fork_db.fetch_block( head_block_id() );
+      reuse = head && head->previous_id() == previous_head && _undo_db.size() > 0;
+      if( reuse )
+      {
+         const undo_state& block_changes = _undo_db.head();
+         for( const auto& id : block_changes.new_ids )
+            changed.insert( id );
+         for( const auto& item : block_changes.old_values )
+            changed.insert( item.first );
+         for( const auto& item : block_changes.removed )
+            changed.insert( item.first );
+         for( const auto& item : block_changes.old_index_next_ids )
+            changed_indexes.insert( item.first );
+         for( const auto& id : changed )
+            changed_types.insert( type_of( id ) );
+      }
+   }
+
+   if( !reuse )
+   {
+      precompute_signature_keys( _popped_tx );
+      precompute_signature_keys( pending );
+      for( const auto& tx : _popped_tx )
+      {
+         try {
+            if( !is_known_transaction( tx.id() ) ) {
+               // since push_transaction() takes a signed_transaction,
+               // the operation_results field will be ignored.
+               _push_transaction( tx );
+            }
+         } catch ( const fc::exception&  ) {
+         }
+      }
+      _popped_tx.clear();
+      for( const processed_transaction& tx : pending )
+      {
+         try
+         {
+            if( !is_known_transaction( tx.id() ) ) {
+               ++_pending_tx_reapplied;
+               _push_transaction( tx );
+            }
+         }
+         catch( const fc::exception& e )
+         {
+            /*
+            wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", head_block_id())("t",head_block_time()) );
+            wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
+            */
+         }
+      }
+      return;
+   }
+
+   // Every block changes the dynamic global properties, transactions read the head block time from them.  The
+   // expiration is checked again below and TaPoS reads its block summary by id, so what an evaluator made of the
+   // time is at most one block old.  A carried over footprint keeps the applied_on of its old head, so
+   // _assemble_block() evaluates every carried over transaction again before it goes into a block.  The
+   // transaction objects of the dupe check are created anew.
+   changed.erase( object_id_type( dynamic_global_property_id_type() ) );
+   changed_indexes.erase( object_id_type( transaction_object::space_id, transaction_object::type_id, 0 ) );
+
+   // a transaction that is not taken over may leave different objects behind than its footprint says, later
+   // transactions that read or changed any of them are applied again as well
+   auto add_changes = [&]( const pending_transaction_footprint& footprint ) {
+      for( const auto& item : footprint.changes.objects )
+      {
+         changed.insert( item.first );
+         changed_types.insert( type_of( item.first ) );
+      }
+      for( const auto& id : footprint.changes.next_ids )
+         changed_indexes.insert( type_of( id ) );
+   };
+   // lookups by id are tracked per object, any other read of an index per index
+   auto unchanged = [&]( const pending_transaction_footprint& footprint ) {
+      for( const auto& id : footprint.reads )
+         if( changed.count( id ) )
+            return false;
+      for( const auto& id : footprint.index_reads )
+         if( changed_types.count( id ) )
+            return false;
+      for( const auto& item : footprint.changes.objects )
+         if( changed.count( item.first ) )
+            return false;
+      for( const auto& id : footprint.changes.next_ids )
+         if( changed_indexes.count( type_of( id ) ) )
+            return false;
+      return true;
+   };
+   auto apply_again = [&]( const processed_transaction& tx, const pending_transaction_footprint& footprint ) {
+      add_changes( footprint );
+      ++_pending_tx_reapplied;
+      _push_transaction( tx );
+      add_changes( _pending_footprints.back() );
+   };
+
+   const fc::time_point_sec now = head_block_time();
+   for( size_t i = 0; i < pending.size(); ++i )
+   {
+      const processed_transaction& tx = pending[i];
+      pending_transaction_footprint& footprint = footprints[i];
+      try
+      {
+         const transaction_id_type trx_id = tx.id();
+         // the transactions of the block
+         if( is_known_transaction( trx_id ) )
+         {
+            add_changes( footprint );
+            continue;
+         }
+         if( !footprint.reusable || now > tx.expiration || !unchanged( footprint ) )
+         {
+            apply_again( tx, footprint );
+            continue;
+         }
+
+         if( !_pending_tx_session.valid() )
+            _pending_tx_session = _undo_db.start_undo_session();
+         auto temp_session = _undo_db.start_undo_session();
+         try
+         {
+            apply_diff( footprint.changes );
+            if( footprint.dupe_checked )
+               create<transaction_object>( [&]( transaction_object& transaction ) {
+                  transaction.trx_id = trx_id;
+                  transaction.expiration = tx.expiration;
+                  transaction.trx = tx;
+               } );
+         }
+         catch( const fc::exception& e )
+         {
+            // the footprint missed something, the transaction is evaluated instead
+            wlog( "Unable to carry over pending transaction ${id}: ${e}", ("id",trx_id)("e",e.to_detail_string()) );
+            temp_session.undo();
+            apply_again( tx, footprint );
+            continue;
+         }
+         _pending_tx.push_back( tx );
+         _pending_footprints.push_back( std::move( footprint ) );
+         _pending_tx_skip |= get_node_properties().skip_flags;
+         ++_pending_tx_carried_over;
+
+         notify_changed_objects( false );
+         temp_session.merge();
+         on_pending_transaction( tx );
+      }
+      catch( const fc::exception& )
+      {
+      }
+   }
+}
+
+void database::check_pending_pool_capacity()
+{
+   if( _max_pending_tx == 0 || _pending_tx.size() < _max_pending_tx )
+      return;
+   ++_pending_tx_rejected;
+   FC_THROW_EXCEPTION( pending_pool_full, "The pending transaction pool holds ${n} transactions already",
+                       ("n", _pending_tx.size()) );
+}
+
+pending_pool_statistics database::get_pending_pool_statistics()const
+{
+   pending_pool_statistics result;
+   result.transactions = _pending_tx.size();
+   for( const processed_transaction& tx : _pending_tx )
+      result.size += fc::raw::pack_size( tx );
+   result.capacity = _max_pending_tx;
+   result.rejected = _pending_tx_rejected;
+   result.postponed = _pending_tx_postponed;
+   result.carried_over = _pending_tx_carried_over;
+   result.reapplied = _pending_tx_reapplied;
+   return result;
+}
+
+namespace {
+   struct operation_fee_visitor
+   {
+      typedef asset result_type;
+      template<typename Op>
+      asset operator()( const Op& op )const { return op.fee; }
+   };
+}
+
+double database::core_fee_per_byte( const processed_transaction& trx )const
+{
+   // only ranks the transactions, in double because the fees of a transaction nobody validated yet may add up
+   // past share_type or overflow the exchange to core
+   double core_fees = 0;
+   operation_fee_visitor fee_of;
+   for( const operation& op : trx.operations )
+   {
+      const asset fee = op.visit( fee_of );
+      if( fee.asset_id == asset_id_type() )
+         core_fees += double( fee.amount.value );
+      else if( const asset_object* fee_asset = find( fee.asset_id ) )
+      {
+         const price& rate = fee_asset->options.core_exchange_rate;
+         if( rate.base.asset_id == fee.asset_id && rate.base.amount > 0 )
+            core_fees += double( fee.amount.value ) * double( rate.quote.amount.value ) / double( rate.base.amount.value );
+         else if( rate.quote.asset_id == fee.asset_id && rate.quote.amount > 0 )
+            core_fees += double( fee.amount.value ) * double( rate.base.amount.value ) / double( rate.quote.amount.value );
+      }
+   }
+   return core_fees / fc::raw::pack_size( trx );
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
+   state_write_lock write_lock( *this );
    auto session = _undo_db.start_undo_session();
    return _apply_transaction( trx );
 }
@@ -300,6 +1067,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   state_write_lock write_lock( *this );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -326,76 +1094,183 @@ signed_block database::_generate_block(
    if( !(skip & skip_witness_signature) )
       FC_ASSERT( witness_obj.signing_key == block_signing_private_key.get_public_key() );
 
+   signed_block pending_block = _assemble_block( when, witness_id );
+
+   _pending_tx_session.reset();
+
+   // We have temporarily broken the invariant that
+   // _pending_tx_session is the result of applying _pending_tx, as
+   // _pending_tx now consists of the set of postponed transactions.
+   // However, the push_block() call below will re-create the
+   // _pending_tx_session.
+
+   return _sign_and_push_block( std::move(pending_block), block_signing_private_key );
+} FC_CAPTURE_AND_RETHROW( (witness_id) ) }
+
+signed_block database::assemble_block(
+   fc::time_point_sec when,
+   witness_id_type witness_id,
+   uint32_t skip
+   )
+{ try {
+   state_write_lock write_lock( *this );
+   signed_block result;
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      uint32_t slot_num = get_slot_at_time( when );
+      FC_ASSERT( slot_num > 0 );
+      FC_ASSERT( get_scheduled_witness( slot_num ) == witness_id );
+
+      result = _assemble_block( when, witness_id );
+      // the pending state then only holds the transactions of the block, build it again from all of them
+      if( _last_block_assembly.reapplied )
+         detail::without_pending_transactions( *this, std::move(_pending_tx), [](){} );
+   } );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (witness_id) ) }
+
+signed_block database::sign_and_push_block(
+   signed_block candidate,
+   const fc::ecc::private_key& block_signing_private_key,
+   uint32_t skip
+   )
+{ try {
+   state_write_lock write_lock( *this );
+   signed_block result;
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      FC_ASSERT( candidate.previous == head_block_id(), "The block candidate does not build on the head block",
+                 ("previous", candidate.previous)("head", head_block_id()) );
+      if( !(skip & skip_witness_signature) )
+         FC_ASSERT( candidate.witness(*this).signing_key == block_signing_private_key.get_public_key() );
+      result = _sign_and_push_block( std::move(candidate), block_signing_private_key );
+   } );
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+signed_block database::_assemble_block(
+   fc::time_point_sec when,
+   witness_id_type witness_id
+   )
+{
+   uint32_t skip = get_node_properties().skip_flags;
+   _last_block_assembly = block_assembly();
+   _last_block_assembly.pending = _pending_tx.size();
    static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
    auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
    size_t total_block_size = max_block_header_size;
 
    signed_block pending_block;
 
-   //
-   // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
-   //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
-   //
-   _pending_tx_session.reset();
-   _pending_tx_session = _undo_db.start_undo_session();
-
    uint64_t postponed_tx_count = 0;
-   // pop pending state (reset to head block state)
+
+   // The pending state already is the result of applying _pending_tx in order on top of the head block.  If all
+   // of it fits into the block and it was admitted with at least the checks this block asks for, the block is
+   // assembled from it as it is, so generating a block does not apply every pending transaction again.  Pending
+   // transactions taken over from an earlier head block were applied at its time, so then they are applied again.
+   size_t pending_size = total_block_size;
    for( const processed_transaction& tx : _pending_tx )
+      pending_size += fc::raw::pack_size( tx );
+   const block_id_type head_id = head_block_id();
+   const bool applied_on_head = std::all_of( _pending_footprints.begin(), _pending_footprints.end(),
+                                             [&]( const pending_transaction_footprint& footprint ) {
+                                                return footprint.applied_on == head_id;
+                                             } );
+
+   if( pending_size < maximum_block_size && (_pending_tx_skip & ~skip) == 0 && applied_on_head )
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      pending_block.transactions.assign( _pending_tx.begin(), _pending_tx.end() );
+   }
+   else
+   {
+      _last_block_assembly.reapplied = true;
+      //
+      // The following code throws away existing pending_tx_session and
+      // rebuilds it by re-applying pending transactions.
+      //
+      // This rebuild is necessary because pending transactions' validity
+      // and semantics may have changed since they were received, because
+      // time-based semantics are evaluated based on the current block
+      // time.  These changes can only be reflected in the database when
+      // the value of the "when" variable is known, which means we need to
+      // re-apply pending transactions in this method.
+      //
+      _pending_tx_session.reset();
+      _pending_tx_session = _undo_db.start_undo_session();
 
-      // postpone transaction if it would make block too big
-      if( new_total_size >= maximum_block_size )
+      // When not everything fits, the block is packed greedily by fee per byte (ties keep arrival order).  A
+      // transaction that depends on one left out fails to apply here and stays pending for the next block.
+      vector<const processed_transaction*> candidates;
+      candidates.reserve( _pending_tx.size() );
+      for( const processed_transaction& tx : _pending_tx )
+         candidates.push_back( &tx );
+      if( pending_size >= maximum_block_size )
       {
-         postponed_tx_count++;
-         continue;
+         vector< std::pair<double,const processed_transaction*> > by_fee;
+         by_fee.reserve( candidates.size() );
+         for( const processed_transaction* tx : candidates )
+            by_fee.emplace_back( core_fee_per_byte( *tx ), tx );
+         std::stable_sort( by_fee.begin(), by_fee.end(), []( const std::pair<double,const processed_transaction*>& a,
+                                                             const std::pair<double,const processed_transaction*>& b ) {
+            return a.first > b.first;
+         } );
+         for( size_t i = 0; i < by_fee.size(); ++i )
+            candidates[i] = by_fee[i].second;
       }
 
-      try
+      // pop pending state (reset to head block state)
+      for( const processed_transaction* candidate : candidates )
       {
-         auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
-         temp_session.merge();
+         const processed_transaction& tx = *candidate;
+         size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         total_block_size += fc::raw::pack_size( ptx );
-         pending_block.transactions.push_back( ptx );
-      }
-      catch ( const fc::exception& e )
-      {
-         // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         // postpone transaction if it would make block too big
+         if( new_total_size >= maximum_block_size )
+         {
+            postponed_tx_count++;
+            continue;
+         }
+
+         try
+         {
+            auto temp_session = _undo_db.start_undo_session();
+            processed_transaction ptx = _apply_transaction( tx );
+            temp_session.merge();
+
+            // We have to recompute pack_size(ptx) because it may be different
+            // than pack_size(tx) (i.e. if one or more results increased
+            // their size)
+            total_block_size += fc::raw::pack_size( ptx );
+            pending_block.transactions.push_back( ptx );
+         }
+         catch ( const fc::exception& e )
+         {
+            // Do nothing, transaction will not be re-applied
+            _last_block_assembly.failed++;
+            wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
+            wlog( "The transaction was ${t}", ("t", tx) );
+         }
       }
    }
+   _pending_tx_postponed += postponed_tx_count;
+   _last_block_assembly.postponed = postponed_tx_count;
+   _last_block_assembly.included = pending_block.transactions.size();
    if( postponed_tx_count > 0 )
    {
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
    }
 
-   _pending_tx_session.reset();
-
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
-
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+   pending_block.transaction_merkle_root = calculate_merkle_root( pending_block );
    pending_block.witness = witness_id;
+   return pending_block;
+}
 
+signed_block database::_sign_and_push_block( signed_block pending_block,
+                                             const fc::ecc::private_key& block_signing_private_key )
+{
+   uint32_t skip = get_node_properties().skip_flags;
    if( !(skip & skip_witness_signature) )
       pending_block.sign( block_signing_private_key );
 
@@ -408,7 +1283,7 @@ signed_block database::_generate_block(
    push_block( pending_block, skip );
 
    return pending_block;
-} FC_CAPTURE_AND_RETHROW( (witness_id) ) }
+}
 
 /**
  * Removes the most recent block from the database and
@@ -416,29 +1291,138 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   state_write_lock write_lock( *this );
    _pending_tx_session.reset();
    auto head_id = head_block_id();
-   optional<signed_block> head_block = fetch_block_by_id( head_id );
-   GRAPHENE_ASSERT( head_block.valid(), pop_empty_chain, "there are no blocks to pop" );
+   // the fork database shares its copy of the block, only blocks older than it are read back from disk
+   shared_ptr<fork_item> head_item = _fork_db.fetch_block( head_id );
+   optional<signed_block> stored_block;
+   if( !head_item )
+   {
+      stored_block = _block_id_to_block.fetch_optional( head_id );
+      GRAPHENE_ASSERT( stored_block.valid(), pop_empty_chain, "there are no blocks to pop" );
+   }
+   const signed_block& head_block = head_item ? head_item->data : *stored_block;
+   // checked before the fork database and the block log are touched, the undo state of a compacted block is gone
+   FC_ASSERT( !_undo_db.enabled() || _undo_db.undoable_size() > 0,
+              "The undo state of block ${n} was compacted, it can not be popped", ("n",head_block.block_num()) );
 
+   popping_block( head_block ); //emit
    _fork_db.pop_block();
    _block_id_to_block.remove( head_id );
+   _state_diffs.erase( head_block_num() );
+   _state_hashes.erase( head_block_num() );
    pop_undo();
+   update_prevalidation_limits();
 
-   _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
+   _popped_tx.insert( _popped_tx.begin(), head_block.transactions.begin(), head_block.transactions.end() );
 
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::record_state_diff( const signed_block& b )
+{
+   if( _state_diff_history == 0 || !_undo_db.enabled() )
+      return;
+   // the committed session of the block is the newest undo state
+   const uint32_t block_num = b.block_num();
+   block_state_diff& diff = _state_diffs[block_num];
+   diff.block   = b;
+   diff.objects = undo_head_diff();
+   if( incremental_hash() )
+      diff.state_hash = state_hash();
+   while( !_state_diffs.empty() && _state_diffs.begin()->first + _state_diff_history <= block_num )
+      _state_diffs.erase( _state_diffs.begin() );
+}
+
+void database::set_state_hash_history( uint32_t blocks )
+{
+   _state_hash_history = blocks;
+   set_incremental_hash( blocks > 0 );
+   if( blocks == 0 )
+      _state_hashes.clear();
+}
+
+void database::record_state_hash( const signed_block& b )
+{
+   if( _state_hash_history == 0 )
+      return;
+   const uint32_t block_num = b.block_num();
+   block_state_hash& entry = _state_hashes[block_num];
+   entry.block_num  = block_num;
+   entry.block_id   = b.id();
+   entry.state_hash = state_hash();
+   while( !_state_hashes.empty() && _state_hashes.begin()->first + _state_hash_history <= block_num )
+      _state_hashes.erase( _state_hashes.begin() );
+}
+
+optional<block_state_hash> database::get_block_state_hash( uint32_t block_num )const
+{
+   auto itr = _state_hashes.find( block_num );
+   if( itr == _state_hashes.end() )
+      return optional<block_state_hash>();
+   return itr->second;
+}
+
+vector<block_state_diff> database::get_state_diffs( uint32_t first_block_num, uint32_t count )const
+{
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   vector<block_state_diff> result;
+   for( auto itr = _state_diffs.find( first_block_num );
+        itr != _state_diffs.end() && itr->first <= last_irreversible && result.size() < count; ++itr )
+   {
+      if( itr->first != first_block_num + result.size() )
+         break;
+      result.push_back( itr->second );
+   }
+   return result;
+}
+
+void database::apply_state_diff( const block_state_diff& diff )
+{ try {
+   state_write_lock write_lock( *this );
+   FC_ASSERT( diff.block.previous == head_block_id(), "The state diff does not build on the head block",
+              ("previous",diff.block.previous)("head",head_block_id()) );
+   const block_id_type block_id = diff.block.id();
+   clear_pending();
+   _applied_ops.clear();
+
+   auto session = _undo_db.start_undo_session();
+   apply_diff( diff.objects );
+   FC_ASSERT( head_block_id() == block_id, "The state diff does not lead to its block", ("block",block_id) );
+   if( incremental_hash() && diff.state_hash != fc::sha256() && state_hash() != diff.state_hash )
+      elog( "The state after block ${n} differs from the node the state diff came from, ${h} instead of ${d}",
+            ("n",diff.block.block_num())("h",state_hash())("d",diff.state_hash) );
+   _block_id_to_block.store( block_id, diff.block );
+   session.commit();
+
+   _fork_db.push_block( diff.block );
+   const dynamic_global_property_object& dgp = get_dynamic_global_properties();
+   _undo_db.set_max_size( dgp.head_block_number - dgp.last_irreversible_block_num + 1 );
+   _fork_db.set_max_size( dgp.head_block_number - dgp.last_irreversible_block_num + 1 );
+
+   update_prevalidation_limits();
+   applied_block( diff.block ); //emit
+   record_state_hash( diff.block );
+   notify_changed_objects( true );
+} FC_CAPTURE_AND_RETHROW( (diff.block.block_num()) ) }
+
 void database::clear_pending()
 { try {
+   state_write_lock write_lock( *this );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _pending_footprints.clear();
+   _pending_tx_skip = 0;
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
 uint32_t database::push_applied_operation( const operation& op )
 {
-   _applied_ops.emplace_back(op);
+   return push_applied_operation( operation( op ) );
+}
+uint32_t database::push_applied_operation( operation&& op )
+{
+   _applied_ops.emplace_back( std::move(op) );
    operation_history_object& oh = *(_applied_ops.back());
    oh.block_num    = _current_block_num;
    oh.trx_in_block = _current_trx_in_block;
@@ -473,8 +1457,9 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
       if( itr != _checkpoints.end() )
          FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
 
-      if( _checkpoints.rbegin()->first >= block_num )
-         skip = ~0;// WE CAN SKIP ALMOST EVERYTHING
+      // blocks up to the last checkpoint are applied like a replay.  The merkle root and the link to the previous
+      // block are still checked, so the contents of a branch that does not lead to the checkpoint fail there.
+      skip |= checkpoint_skip_flags( block_num );
    }
 
    detail::with_skip_flags( *this, skip, [&]()
@@ -490,35 +1475,76 @@ void database::_apply_block( const signed_block& next_block )
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
 
-   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
+   fc::time_point phase_start = fc::time_point::now();
+   // adds the time since the last phase ended to the phase of _block_timing, and traces it as a span
+   auto end_phase = [&]( int64_t block_timing::* phase, const char* name ) {
+      const fc::time_point now = fc::time_point::now();
+      _block_timing.*phase += ( now - phase_start ).count();
+      if( graphene::utilities::tracer::enabled() )
+         graphene::utilities::tracer::record( name, phase_start.time_since_epoch().count(),
+                                              now.time_since_epoch().count() );
+      phase_start = now;
+   };
+
+   FC_ASSERT( (skip & skip_merkle_check) || merkle_root_prevalidated( next_block ) ||
+              next_block.transaction_merkle_root == calculate_merkle_root( next_block ), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
 
    const witness_object& signing_witness = validate_block_header(skip, next_block);
+   end_phase( &block_timing::header, "header" );
    const auto& global_props = get_global_properties();
    const auto& dynamic_global_props = get<dynamic_global_property_object>(dynamic_global_property_id_type());
    bool maint_needed = (dynamic_global_props.next_maintenance_time <= next_block.timestamp);
 
    _current_block_num    = next_block_num;
    _current_trx_in_block = 0;
+   _applied_trx_ids.clear();
 
-   for( const auto& trx : next_block.transactions )
-   {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      apply_transaction( trx, skip | skip_transaction_signatures );
-      ++_current_trx_in_block;
+   // The stateless checks of all transactions run side by side first; only the state changes, which may
+   // depend on each other, are made one transaction after another.
+   _transactions_prevalidated = prevalidate_transactions( next_block );
+   _applying_block = true;
+   try {
+      // the profile of skip flags is picked once for all transactions of the block
+      const uint32_t trx_skip = skip | skip_transaction_signatures;
+      detail::with_skip_flags( *this, trx_skip, [&]()
+      {
+         switch( trx_skip & transaction_skip_mask )
+         {
+            case skip_transaction_signatures:
+               _apply_block_transactions( next_block, block_skip_flags() );
+               break;
+            case skip_transaction_signatures | skip_authority_check | skip_transaction_dupe_check | skip_tapos_check:
+               _apply_block_transactions( next_block, replay_skip_flags() );
+               break;
+            default:
+               _apply_block_transactions( next_block, dynamic_skip_flags{ trx_skip } );
+         }
+      });
+   } catch( ... ) {
+      _transactions_prevalidated = false;
+      _applying_block = false;
+      throw;
    }
+   _transactions_prevalidated = false;
+   _applying_block = false;
+   end_phase( &block_timing::apply_transactions, "apply_transactions" );
 
    update_global_dynamic_data(next_block);
    update_signing_witness(signing_witness, next_block);
    update_last_irreversible_block();
+   end_phase( &block_timing::chain_updates, "chain_updates" );
 
    // Are we at the maintenance interval?
    if( maint_needed )
-      perform_chain_maintenance(next_block, global_props);
+   {
+      const fc::time_point maintenance_start = phase_start;
+      {
+         graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_maintenance );
+         perform_chain_maintenance(next_block, global_props);
+      }
+      end_phase( &block_timing::maintenance, "maintenance" );
+      _maintenance_time += phase_start - maintenance_start;
+   }
 
    create_block_summary(next_block);
    clear_expired_transactions();
@@ -534,17 +1560,56 @@ void database::_apply_block( const signed_block& next_block )
    // to be called for header validation?
    update_maintenance_flag( maint_needed );
    update_witness_schedule();
+   if( !maint_needed && _maintenance_precount_blocks > 0 )
+   {
+      // the votes of the accounts changed so far are counted now instead of in the maintenance block
+      const uint32_t until_maintenance = ( dynamic_global_props.next_maintenance_time - next_block.timestamp ).to_seconds();
+      if( until_maintenance <= uint64_t( _maintenance_precount_blocks ) * global_props.parameters.block_interval )
+         _vote_ledger.update( *this, global_props );
+   }
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
+   end_phase( &block_timing::chain_updates, "chain_updates" );
 
-   // notify observers that the block has been applied
-   applied_block( next_block ); //emit
-   _applied_ops.clear();
+   update_prevalidation_limits();
+
+   {
+      graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_plugin );
+      // notify observers that the block has been applied
+      applied_block( next_block ); //emit
+      _applied_ops.clear();
+      // after the observers, the objects of the plugins are part of the state
+      record_state_hash( next_block );
+
+      notify_changed_objects( true );
+   }
+   end_phase( &block_timing::handlers, "handlers" );
+
+   if( _index_statistics_interval > 0 && next_block_num % _index_statistics_interval == 0 )
+      log_index_statistics();
 
-   notify_changed_objects();
+   // nothing holds references to the objects between blocks
+   get_mutable_index_type<account_statistics_index>().page_out();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
-void database::notify_changed_objects()
+void database::log_index_statistics()const
+{
+   for( const graphene::db::index_statistics& stats : get_index_statistics() )
+   {
+      uint64_t undo_bytes = 0;
+      for( uint64_t bytes : stats.undo_bytes )
+         undo_bytes += bytes;
+      if( stats.objects == 0 && undo_bytes == 0 )
+         continue;
+      ilog( "Index ${space}.${type}: ${n} objects of about ${bytes} bytes, ${allocated} allocated, ${undo} in undo, "
+            "${creates} created, ${modifies} modified, ${removes} removed",
+            ("space",stats.space_id)("type",stats.type_id)("n",stats.objects)("bytes",stats.estimated_bytes)
+            ("allocated",stats.allocated_bytes)("undo",undo_bytes)
+            ("creates",stats.creates)("modifies",stats.modifies)("removes",stats.removes) );
+   }
+}
+
+void database::notify_changed_objects( bool end_of_block )
 { try {
    if( _undo_db.enabled() ) 
    {
@@ -559,6 +1624,21 @@ void database::notify_changed_objects()
          changed_ids.push_back( item.first );
          removed.emplace_back( item.second.get() );
       }
+      if( _change_notification_interval.count() <= 0 )
+      {
+         changed_objects(changed_ids);
+         return;
+      }
+
+      _unreported_changes.insert( changed_ids.begin(), changed_ids.end() );
+      const fc::time_point now = fc::time_point::now();
+      if( !end_of_block && now < _last_change_notification + _change_notification_interval )
+         return;
+      _last_change_notification = now;
+      if( _unreported_changes.empty() )
+         return;
+      changed_ids.assign( _unreported_changes.begin(), _unreported_changes.end() );
+      _unreported_changes.clear();
       changed_objects(changed_ids);
    }
 } FC_CAPTURE_AND_RETHROW() }
@@ -573,34 +1653,151 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
+template<typename Skip>
+void database::_apply_block_transactions( const signed_block& next_block, const Skip& skipped )
+{
+   const auto& trxs = next_block.transactions;
+   const size_t ahead = std::min<size_t>( _transaction_prefetch_depth, trxs.size() );
+   for( size_t i = 0; i < ahead; ++i )
+      prefetch_transaction_objects( trxs[i] );
+   for( size_t i = 0; i < trxs.size(); ++i )
+   {
+      if( ahead > 0 && i + ahead < trxs.size() )
+         prefetch_transaction_objects( trxs[i + ahead] );
+      /* We do not need to push the undo state for each transaction
+       * because they either all apply and are valid or the
+       * entire block fails to apply.  We only need an "undo" state
+       * for transactions when validating broadcast transactions or
+       * when building a block.
+       */
+      _apply_transaction( trxs[i], skipped );
+      ++_current_trx_in_block;
+   }
+}
+
+namespace {
+
+/** asks the CPU to load the first cache lines of @ref obj, without waiting for them */
+template<typename T>
+void prefetch_object( const T& obj )
+{
+#if defined(__GNUC__)
+   const char* p = reinterpret_cast<const char*>( &obj );
+   for( size_t offset = 0; offset < std::min<size_t>( sizeof(T), 256 ); offset += 64 )
+      __builtin_prefetch( p + offset );
+#endif
+}
+
+/** prefetches the objects paying the fee of an operation touches */
+struct fee_object_prefetcher
+{
+   typedef void result_type;
+   const database& db;
+
+   template<typename Op>
+   void operator()( const Op& op )const
+   {
+      const account_id_type payer = op.fee_payer();
+      if( const account_object* account = db.find( payer ) )
+      {
+         prefetch_object( *account );
+         if( const account_statistics_object* statistics = db.find( account->statistics ) )
+            prefetch_object( *statistics );
+      }
+      const auto& balances = db.get_index_type<account_balance_index>().indices().get<by_account_asset_hash>();
+      auto balance = balances.find( boost::make_tuple( payer, op.fee.asset_id ) );
+      if( balance != balances.end() )
+         prefetch_object( *balance );
+      if( const asset_object* fee_asset = db.find( op.fee.asset_id ) )
+         if( const asset_dynamic_data_object* dynamic_data = db.find( fee_asset->dynamic_asset_data_id ) )
+            prefetch_object( *dynamic_data );
+   }
+};
+
+}
+
+void database::prefetch_transaction_objects( const signed_transaction& trx )const
+{
+   // the lookups walk the index nodes, the prefetches load the objects they end at meanwhile
+   fee_object_prefetcher prefetcher{ *this };
+   for( const operation& op : trx.operations )
+      op.visit( prefetcher );
+}
+
 processed_transaction database::_apply_transaction(const signed_transaction& trx)
-{ try {
-   uint32_t skip = get_node_properties().skip_flags;
+{
+   const uint32_t skip = get_node_properties().skip_flags;
+   switch( skip & transaction_skip_mask )
+   {
+      case skip_nothing:
+         return _apply_transaction( trx, full_skip_flags() );
+      case skip_transaction_signatures:
+         return _apply_transaction( trx, block_skip_flags() );
+      case skip_transaction_signatures | skip_authority_check | skip_transaction_dupe_check | skip_tapos_check:
+         return _apply_transaction( trx, replay_skip_flags() );
+      default:
+         return _apply_transaction( trx, dynamic_skip_flags{ skip } );
+   }
+}
 
-   if( true || !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
-      trx.validate();
+template<typename Skip>
+processed_transaction database::_apply_transaction( const signed_transaction& trx, const Skip& skipped )
+{ try {
+   if( !_transactions_prevalidated )   /* issue #505 explains why skip_validate is not honored here */
+      validate_transaction_stateless( trx );
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
-   FC_ASSERT( (skip & skip_transaction_dupe_check) ||
-              trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
+   // the id is only needed by the dupe check, replays skip it and the hashing with it
+   transaction_id_type trx_id;
+   if( !skipped( skip_transaction_dupe_check ) )
+   {
+      trx_id = trx.id();
+      FC_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
+   }
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( !(skip & (skip_transaction_signatures | skip_authority_check) ) )
+   if( !skipped( skip_transaction_signatures | skip_authority_check ) )
    {
       auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
       auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority( chain_id, get_active, get_owner, get_global_properties().parameters.max_authority_depth );
+      // fills the keys cached on trx from the shared signature key cache, verify_authority() then reuses them
+      const flat_set<public_key_type>& keys = recover_signature_keys( trx );
+      const uint8_t max_depth = chain_parameters.max_authority_depth;
+
+      // exchanges and other busy accounts sign many transactions with the same keys, which then need the same
+      // authority check over and over
+      authorized_signers signers;
+      vector<authority> other;
+      for( const auto& op : trx.operations )
+         operation_get_required_authorities( op, std::get<1>(signers), std::get<2>(signers), other );
+      std::get<0>(signers) = max_depth;
+      std::get<3>(signers) = keys;
+
+      if( _authorized_signers_generation != _account_authorities->generation() )
+      {
+         _authorized_signers.clear();
+         _authorized_signers_generation = _account_authorities->generation();
+      }
+      if( !other.empty() || _authorized_signers.find( signers ) == _authorized_signers.end() )
+      {
+         trx.verify_authority( chain_id, get_active, get_owner, max_depth );
+         if( other.empty() )
+         {
+            if( _authorized_signers.size() >= max_authorized_signers )
+               _authorized_signers.clear();
+            _authorized_signers.insert( std::move( signers ) );
+         }
+      }
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
    //expired, and TaPoS makes no sense as no blocks exist.
    if( BOOST_LIKELY(head_block_num() > 0) )
    {
-      if( !(skip & skip_tapos_check) )
+      if( !skipped( skip_tapos_check ) )
       {
          const auto& tapos_block_summary = block_summary_id_type( trx.ref_block_num )(*this);
 
@@ -616,11 +1813,21 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    }
 
    //Insert transaction into unique transactions database.
-   if( !(skip & skip_transaction_dupe_check) )
+   if( !skipped( skip_transaction_dupe_check ) )
    {
+      if( _applying_block )
+         _applied_trx_ids.push_back( trx_id );
       create<transaction_object>([&](transaction_object& transaction) {
          transaction.trx_id = trx_id;
-         transaction.trx = trx;
+         transaction.expiration = trx.expiration;
+         if( _applying_block )
+         {
+            transaction.block_num = _current_block_num;
+            transaction.trx_in_block = _current_trx_in_block;
+         }
+         // pending transactions are not in any block yet, so they always keep their body
+         if( !_applying_block || _keep_transaction_bodies )
+            transaction.trx = trx;
       });
    }
 
@@ -637,7 +1844,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    ptrx.operation_results = std::move(eval_state.operation_results);
 
    //Make sure the temp account has no non-zero balances
-   const auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
+   const auto& index = get_index_type_unlogged<account_balance_index>().indices().get<by_account_asset>();
    auto range = index.equal_range( boost::make_tuple( GRAPHENE_TEMP_ACCOUNT ) );
    std::for_each(range.first, range.second, [](const account_balance_object& b) { FC_ASSERT(b.balance == 0); });
 
@@ -656,8 +1863,36 @@ operation_result database::apply_operation(transaction_evaluation_state& eval_st
    if( !eval )
       assert( "No registered evaluator for this operation" && false );
    auto op_id = push_applied_operation( op );
+   if( !_operation_statistics_enabled )
+   {
+      auto result = eval->evaluate( eval_state, op, true );
+      set_applied_operation_result( op_id, result );
+      return result;
+   }
+
+   // the evaluator adds its times to _current_operation_statistics, operations of an executed proposal
+   // replace it until they are done
+   operation_statistics& stats = _operation_statistics[ u_which ];
+   ++stats.count;
+   const uint64_t created = _undo_db.created_objects();
+   const uint64_t modified = _undo_db.modified_objects();
+   const uint64_t removed = _undo_db.removed_objects();
+   struct statistics_scope
+   {
+      database& db;
+      operation_statistics* outer;
+      statistics_scope( database& d, operation_statistics& s ) : db( d ), outer( d._current_operation_statistics )
+      {
+         db._current_operation_statistics = &s;
+      }
+      ~statistics_scope() { db._current_operation_statistics = outer; }
+   } scope( *this, stats );
+
    auto result = eval->evaluate( eval_state, op, true );
    set_applied_operation_result( op_id, result );
+   stats.objects_created  += _undo_db.created_objects() - created;
+   stats.objects_modified += _undo_db.modified_objects() - modified;
+   stats.objects_removed  += _undo_db.removed_objects() - removed;
    return result;
 } FC_CAPTURE_AND_RETHROW(  ) }
 
@@ -668,7 +1903,7 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
    const witness_object& witness = next_block.witness(*this);
 
    if( !(skip&skip_witness_signature) ) 
-      FC_ASSERT( next_block.validate_signee( witness.signing_key ) );
+      FC_ASSERT( _signature_key_cache.recover( next_block.witness_signature, next_block.digest() ) == witness.signing_key );
 
    if( !(skip&skip_witness_schedule_check) )
    {
@@ -688,7 +1923,8 @@ void database::create_block_summary(const signed_block& next_block)
 {
    block_summary_id_type sid(next_block.block_num() & 0xffff );
    modify( sid(*this), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         // update_global_dynamic_data() has already hashed the block
+         p.block_id = head_block_id();
    });
 }
 
@@ -703,4 +1939,11 @@ bool database::before_last_checkpoint()const
    return (_checkpoints.size() > 0) && (_checkpoints.rbegin()->first >= head_block_num());
 }
 
+uint32_t database::checkpoint_skip_flags( uint32_t block_num )const
+{
+   if( _checkpoints.empty() || _checkpoints.rbegin()->second == block_id_type() || _checkpoints.rbegin()->first < block_num )
+      return skip_nothing;
+   return _replay_skip_flags;
+}
+
 } }
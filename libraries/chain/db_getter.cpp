@@ -94,7 +94,18 @@ node_property_object& database::node_properties()
 
 uint32_t database::last_non_undoable_block_num() const
 {
-   return head_block_num() - _undo_db.size();
+   return head_block_num() - _undo_db.undoable_size();
+}
+
+std::map< string, vector<observer_statistics> > database::get_observer_statistics()const
+{
+   std::map< string, vector<observer_statistics> > result;
+   result["applied_block"] = applied_block.statistics();
+   result["on_pending_transaction"] = on_pending_transaction.statistics();
+   result["changed_objects"] = changed_objects.statistics();
+   result["removed_objects"] = removed_objects.statistics();
+   result["popping_block"] = popping_block.statistics();
+   return result;
 }
 
 
@@ -37,6 +37,7 @@
 #include <graphene/chain/fba_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/market_object.hpp>
+#include <graphene/chain/member_name_index.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/special_authority_object.hpp>
@@ -179,17 +180,27 @@ void database::initialize_indexes()
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index> >();
-   add_index< primary_index<force_settlement_index> >();
+   auto asset_idx = add_index< primary_index<asset_index> >();
+   asset_idx->add_secondary_index<authorized_asset_cache_index>( std::ref(_authorized_asset_cache) );
+   auto settlement_idx = add_index< primary_index<force_settlement_index> >();
+   settlement_idx->add_secondary_index<force_settlement_schedule_index>( std::ref(_force_settlement_schedule) );
 
    auto acnt_index = add_index< primary_index<account_index> >();
    acnt_index->add_secondary_index<account_member_index>();
    acnt_index->add_secondary_index<account_referrer_index>();
-
-   add_index< primary_index<committee_member_index> >();
-   add_index< primary_index<witness_index> >();
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   acnt_index->add_secondary_index<vote_ledger_index>( std::ref(_vote_ledger) );
+   acnt_index->add_secondary_index<authorized_asset_cache_index>( std::ref(_authorized_asset_cache) );
+   _account_authorities = acnt_index->add_secondary_index<account_authority_index>();
+
+   auto committee_member_idx = add_index< primary_index<committee_member_index> >();
+   committee_member_idx->add_secondary_index<committee_member_name_index>( *this );
+   auto witness_idx = add_index< primary_index<witness_index> >();
+   witness_idx->add_secondary_index<witness_name_index>( *this );
+   auto limit_order_idx = add_index< primary_index<limit_order_index > >();
+   _limit_order_book = limit_order_idx->add_secondary_index<limit_order_book_index>();
+   limit_order_idx->add_secondary_index<margin_call_check_index>( std::ref(_margin_call_checks) );
+   auto call_order_idx = add_index< primary_index<call_order_index > >();
+   call_order_idx->add_secondary_index<margin_call_check_index>( std::ref(_margin_call_checks) );
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
@@ -202,12 +213,19 @@ void database::initialize_indexes()
 
    //Implementation object indexes
    add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
-   add_index< primary_index<asset_bitasset_data_index                     > >();
+   auto balance_idx = add_index< primary_index<account_balance_index     > >();
+   balance_idx->add_secondary_index<vote_ledger_index>( std::ref(_vote_ledger) );
+   balance_idx->add_secondary_index<account_holdings_index>();
+   balance_idx->add_secondary_index<asset_holders_index>();
+   auto bitasset_idx = add_index< primary_index<asset_bitasset_data_index > >();
+   bitasset_idx->add_secondary_index<margin_call_check_index>( std::ref(_margin_call_checks) );
+   bitasset_idx->add_secondary_index<force_settlement_schedule_index>( std::ref(_force_settlement_schedule) );
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<simple_index<account_statistics_object       >> >();
-   add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
+   auto statistics_idx = add_index< primary_index<account_statistics_index > >();
+   statistics_idx->add_secondary_index<vote_ledger_index>( std::ref(_vote_ledger) );
+   statistics_idx->add_secondary_index<account_pending_fees_index>();
+   add_index< primary_index<asset_dynamic_data_index                      > >();
    add_index< primary_index<flat_index<  block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
@@ -218,6 +236,15 @@ void database::initialize_indexes()
    add_index< primary_index< simple_index< fba_accumulator_object       > > >();
 }
 
+void database::disable_api_indexes()
+{
+   auto& acnt_index = dynamic_cast<primary_index<account_index>&>( get_mutable_index_type<account_index>() );
+   acnt_index.remove_secondary_index<account_member_index>();
+   acnt_index.remove_secondary_index<account_referrer_index>();
+   auto& prop_index = dynamic_cast<primary_index<proposal_index>&>( get_mutable_index_type<proposal_index>() );
+   prop_index.remove_secondary_index<required_approval_index>();
+}
+
 void database::init_genesis(const genesis_state_type& genesis_state)
 { try {
    FC_ASSERT( genesis_state.initial_timestamp != time_point_sec(), "Must initialize genesis timestamp." );
@@ -407,6 +434,35 @@ void database::init_genesis(const genesis_state_type& genesis_state)
    create<block_summary_object>([&](block_summary_object&) {});
 
    // Create initial accounts
+   //
+   // Plain accounts are created directly rather than through account_create_evaluator: with millions of
+   // initial accounts the evaluator dispatch and the applied operation history dominate the genesis time.
+   // The objects are the ones the evaluator creates for these operations.  Lifetime members still go
+   // through the evaluators, the registration count is brought up to date before each of them.
+   uint32_t accounts_not_counted = 0;
+   auto count_registered_accounts = [&]() {
+      if( accounts_not_counted == 0 )
+         return;
+      const auto& dynamic_properties = get_dynamic_global_properties();
+      const auto& global_properties = get_global_properties();
+      const uint32_t before = dynamic_properties.accounts_registered_this_interval;
+      modify(dynamic_properties, [&](dynamic_global_property_object& p) {
+         p.accounts_registered_this_interval += accounts_not_counted;
+      });
+      const uint32_t scale = global_properties.parameters.accounts_per_fee_scale;
+      if( scale != 0 )
+      {
+         const uint32_t scalings = (before + accounts_not_counted) / scale - before / scale;
+         if( scalings != 0 )
+            modify(global_properties, [scalings](global_property_object& p) {
+               for( uint32_t i = 0; i < scalings; ++i )
+                  p.parameters.current_fees->get<account_create_operation>().basic_fee <<= p.parameters.account_fee_scale_bitshifts;
+            });
+      }
+      accounts_not_counted = 0;
+   };
+
+   const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_name>();
    for( const auto& account : genesis_state.initial_accounts )
    {
       account_create_operation cop;
@@ -416,26 +472,50 @@ void database::init_genesis(const genesis_state_type& genesis_state)
       if( account.active_key == public_key_type() )
       {
          cop.active = cop.owner;
-         cop.options.memo_key = account.owner_key;
+         cop.options->memo_key = account.owner_key;
       }
       else
       {
          cop.active = authority(1, account.active_key, 1);
-         cop.options.memo_key = account.active_key;
+         cop.options->memo_key = account.active_key;
       }
-      account_id_type account_id(apply_operation(genesis_eval_state, cop).get<object_id_type>());
 
       if( account.is_lifetime_member )
       {
-          account_upgrade_operation op;
-          op.account_to_upgrade = account_id;
-          op.upgrade_to_lifetime_member = true;
-          apply_operation(genesis_eval_state, op);
+         count_registered_accounts();
+         account_id_type account_id(apply_operation(genesis_eval_state, cop).get<object_id_type>());
+
+         account_upgrade_operation op;
+         op.account_to_upgrade = account_id;
+         op.upgrade_to_lifetime_member = true;
+         apply_operation(genesis_eval_state, op);
+         continue;
       }
+
+      const account_object& referrer = cop.referrer(*this);
+      FC_ASSERT( referrer.is_member(head_block_time()), "The referrer must be either a lifetime or annual subscriber." );
+      FC_ASSERT( accounts_by_name.find(cop.name) == accounts_by_name.end(),
+                 "Initial account '${a}' is listed more than once", ("a", cop.name) );
+
+      const auto& params = get_global_properties().parameters;
+      create<account_object>([&](account_object& obj) {
+         obj.registrar = cop.registrar;
+         obj.referrer = cop.referrer;
+         obj.lifetime_referrer = referrer.lifetime_referrer;
+         obj.network_fee_percentage = params.network_percent_of_fee;
+         obj.lifetime_referrer_fee_percentage = params.lifetime_referrer_percent_of_fee;
+         obj.referrer_rewards_percentage = cop.referrer_percent;
+         obj.name = std::move(cop.name);
+         obj.owner = std::move(*cop.owner);
+         obj.active = std::move(*cop.active);
+         obj.options = std::move(*cop.options);
+         obj.statistics = create<account_statistics_object>([&](account_statistics_object& s){s.owner = obj.id;}).id;
+      });
+      ++accounts_not_counted;
    }
+   count_registered_accounts();
 
    // Helper function to get account ID by name
-   const auto& accounts_by_name = get_index_type<account_index>().indices().get<by_name>();
    auto get_account_id = [&accounts_by_name](const string& name) {
       auto itr = accounts_by_name.find(name);
       FC_ASSERT(itr != accounts_by_name.end(),
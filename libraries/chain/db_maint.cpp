@@ -46,29 +46,35 @@
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 
+#include <graphene/utilities/trace.hpp>
+
 namespace graphene { namespace chain {
 
+template<class Index>
+void database::store_vote_totals()
+{
+   using ObjectType = typename Index::object_type;
+   // only the objects whose votes changed move in the by_votes index
+   for( const ObjectType& o : get_index_type<Index>().indices() )
+   {
+      const uint64_t votes = _vote_tally_buffer[o.vote_id];
+      if( o.total_votes != votes )
+         modify( o, [votes]( ObjectType& obj ){
+            obj.total_votes = votes;
+         });
+   }
+}
+
 template<class Index>
 vector<std::reference_wrapper<const typename Index::object_type>> database::sort_votable_objects(size_t count) const
 {
    using ObjectType = typename Index::object_type;
-   const auto& all_objects = get_index_type<Index>().indices();
-   count = std::min(count, all_objects.size());
+   const auto& idx = get_index_type<Index>().indices().template get<by_votes>();
+   count = std::min(count, idx.size());
    vector<std::reference_wrapper<const ObjectType>> refs;
-   refs.reserve(all_objects.size());
-   std::transform(all_objects.begin(), all_objects.end(),
-                  std::back_inserter(refs),
-                  [](const ObjectType& o) { return std::cref(o); });
-   std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
-                   [this](const ObjectType& a, const ObjectType& b)->bool {
-      share_type oa_vote = _vote_tally_buffer[a.vote_id];
-      share_type ob_vote = _vote_tally_buffer[b.vote_id];
-      if( oa_vote != ob_vote )
-         return oa_vote > ob_vote;
-      return a.vote_id < b.vote_id;
-   });
-
-   refs.resize(count, refs.front());
+   refs.reserve(count);
+   for( auto itr = idx.begin(); refs.size() < count; ++itr )
+      refs.push_back(std::cref(*itr));
    return refs;
 }
 
@@ -116,41 +122,52 @@ void database::update_worker_votes()
 void database::pay_workers( share_type& budget )
 {
 //   ilog("Processing payroll! Available budget is ${b}", ("b", budget));
-   vector<std::reference_wrapper<const worker_object>> active_workers;
-   get_index_type<worker_index>().inspect_all_objects([this, &active_workers](const object& o) {
+   const auto now = head_block_time();
+   typedef std::pair<share_type, std::reference_wrapper<const worker_object>> staked_worker;
+   vector<staked_worker> active_workers;
+   get_index_type<worker_index>().inspect_all_objects([now, &active_workers](const object& o) {
       const worker_object& w = static_cast<const worker_object&>(o);
-      auto now = head_block_time();
-      if( w.is_active(now) && w.approving_stake() > 0 )
-         active_workers.emplace_back(w);
+      if( w.is_active(now) )
+      {
+         share_type stake = w.approving_stake();
+         if( stake > 0 )
+            active_workers.emplace_back(stake, std::cref(w));
+      }
    });
 
    // worker with more votes is preferred
    // if two workers exactly tie for votes, worker with lower ID is preferred
-   std::sort(active_workers.begin(), active_workers.end(), [this](const worker_object& wa, const worker_object& wb) {
-      share_type wa_vote = wa.approving_stake();
-      share_type wb_vote = wb.approving_stake();
-      if( wa_vote != wb_vote )
-         return wa_vote > wb_vote;
-      return wa.id < wb.id;
+   std::sort(active_workers.begin(), active_workers.end(), [](const staked_worker& wa, const staked_worker& wb) {
+      if( wa.first != wb.first )
+         return wa.first > wb.first;
+      return wa.second.get().id < wb.second.get().id;
    });
 
+   // every worker is paid for the same period, so scale daily pay by it only once per worker
+   const auto pay_period = now - get_dynamic_global_properties().last_budget_time;
+   const bool full_day = pay_period == fc::days(1);
+
    for( uint32_t i = 0; i < active_workers.size() && budget > 0; ++i )
    {
-      const worker_object& active_worker = active_workers[i];
+      const worker_object& active_worker = active_workers[i].second;
       share_type requested_pay = active_worker.daily_pay;
-      if( head_block_time() - get_dynamic_global_properties().last_budget_time != fc::days(1) )
+      if( !full_day )
       {
          fc::uint128 pay(requested_pay.value);
-         pay *= (head_block_time() - get_dynamic_global_properties().last_budget_time).count();
+         pay *= pay_period.count();
          pay /= fc::days(1).count();
          requested_pay = pay.to_uint64();
       }
 
       share_type actual_pay = std::min(budget, requested_pay);
       //ilog(" ==> Paying ${a} to worker ${w}", ("w", active_worker.id)("a", actual_pay));
-      modify(active_worker, [&](worker_object& w) {
-         w.worker.visit(worker_pay_visitor(actual_pay, *this));
-      });
+      // vesting balance workers keep no state of their own, so only their balance needs to change
+      if( active_worker.worker.which() == worker_type::tag<vesting_balance_worker_type>::value )
+         active_worker.worker.get<vesting_balance_worker_type>().pay_worker(actual_pay, *this);
+      else
+         modify(active_worker, [&](worker_object& w) {
+            w.worker.visit(worker_pay_visitor(actual_pay, *this));
+         });
 
       budget -= actual_pay;
    }
@@ -177,19 +194,11 @@ void database::update_active_witnesses()
    }
 
    const chain_property_object& cpo = get_chain_properties();
+   store_vote_totals<witness_index>();
    auto wits = sort_votable_objects<witness_index>(std::max(witness_count*2+1, (size_t)cpo.immutable_parameters.min_witness_count));
 
    const global_property_object& gpo = get_global_properties();
 
-   const auto& all_witnesses = get_index_type<witness_index>().indices();
-
-   for( const witness_object& wit : all_witnesses )
-   {
-      modify( wit, [&]( witness_object& obj ){
-              obj.total_votes = _vote_tally_buffer[wit.vote_id];
-              });
-   }
-
    // Update witness authority
    modify( get(GRAPHENE_WITNESS_ACCOUNT), [&]( account_object& a )
    {
@@ -256,15 +265,9 @@ void database::update_active_committee_members()
          stake_tally += _committee_count_histogram_buffer[++committee_member_count];
 
    const chain_property_object& cpo = get_chain_properties();
+   store_vote_totals<committee_member_index>();
    auto committee_members = sort_votable_objects<committee_member_index>(std::max(committee_member_count*2+1, (size_t)cpo.immutable_parameters.min_committee_member_count));
 
-   for( const committee_member_object& del : committee_members )
-   {
-      modify( del, [&]( committee_member_object& obj ){
-              obj.total_votes = _vote_tally_buffer[del.vote_id];
-              });
-   }
-
    // Update committee authorities
    if( !committee_members.empty() )
    {
@@ -512,11 +515,20 @@ void update_top_n_authorities( database& db )
                 break;
          }
 
+         // most intervals leave the top holders as they were; skip the modify, and with it the undo copy of
+         // the account and the reindexing of its authorities, when nothing would change
+         if( vc.is_empty() )
+            return;
+         authority new_auth;
+         vc.finish( new_auth );
+         const uint8_t flag = is_owner ? account_object::top_n_control_owner : account_object::top_n_control_active;
+         if( (acct.top_n_control_flags & flag) && new_auth == (is_owner ? acct.owner : acct.active) )
+            return;
+
          db.modify( acct, [&]( account_object& a )
          {
-            vc.finish( is_owner ? a.owner : a.active );
-            if( !vc.is_empty() )
-               a.top_n_control_flags |= (is_owner ? account_object::top_n_control_owner : account_object::top_n_control_active);
+            (is_owner ? a.owner : a.active) = new_auth;
+            a.top_n_control_flags |= flag;
          } );
       }
    } );
@@ -613,6 +625,8 @@ void create_buyback_orders( database& db )
 {
    const auto& bbo_idx = db.get_index_type< buyback_index >().indices().get<by_id>();
    const auto& bal_idx = db.get_index_type< account_balance_index >().indices().get< by_account_asset >();
+   const auto& holdings = dynamic_cast< const primary_index< account_balance_index >& >(
+         db.get_index_type< account_balance_index >() ).get_secondary_index< account_holdings_index >();
 
    for( const buyback_object& bbo : bbo_idx )
    {
@@ -622,6 +636,11 @@ void create_buyback_orders( database& db )
       const account_object& buyback_account = (*(asset_to_buy.buyback_account))(db);
       asset_id_type next_asset = asset_id_type();
 
+      // nothing to sell unless the account holds something besides the asset it buys
+      const uint32_t held_assets = holdings.positive_balance_count( buyback_account.id );
+      if( held_assets == 0 || (held_assets == 1 && db.get_balance( buyback_account.id, asset_to_buy.id ).amount > 0) )
+         continue;
+
       if( !buyback_account.allowed_assets.valid() )
       {
          wlog( "skipping buyback account ${b} at block ${n} because allowed_assets does not exist", ("b", buyback_account)("n", db.head_block_num()) );
@@ -720,89 +739,180 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 {
    const auto& gpo = get_global_properties();
 
-   distribute_fba_balances(*this);
-   create_buyback_orders(*this);
+   {
+      GRAPHENE_TRACE_SPAN( "fba_and_buyback" );
+      distribute_fba_balances(*this);
+      create_buyback_orders(*this);
+   }
 
    struct vote_tally_helper {
-      database& d;
+      const database& d;
       const global_property_object& props;
+      vote_tally& tally;
 
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+      vote_tally_helper(const database& d, const global_property_object& gpo, vote_tally& tally)
+         : d(d), props(gpo), tally(tally) {}
+
+      bool votes(const account_object& stake_account)const {
+         return vote_ledger::votes(d, props, stake_account);
+      }
+
+      /// The stake in balances and open orders, which processing the fees of other accounts leaves alone
+      uint64_t balance_stake(const account_object& stake_account)const {
+         return vote_ledger::balance_stake(d, stake_account);
+      }
+
+      /// The stake in the cashback vesting balance, which processing the fees of referred accounts may change
+      uint64_t cashback_stake(const account_object& stake_account)const {
+         return stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value : 0;
+      }
+
+      void add(const account_object& stake_account, uint64_t voting_stake) {
+         tally.add(vote_opinion(vote_ledger::opinion_account(d, stake_account).options), voting_stake);
+      }
+   };
+
+   // Fees are processed in account name order and may deposit cashback into the vesting balances of accounts
+   // that come later, so only that part of the stake is tallied in the same pass.  Everything else is read-only
+   // and is kept up to date by _vote_ledger between maintenance intervals.  A full count of it is split across
+   // the signature threads when there are any.
+   auto count_votes = [&](vector<vote_ledger::entry>* entries) {
+      vote_tally result(gpo);
+      const auto& account_idx = get_index_type<account_index>().indices().get<by_name>();
+      const size_t groups = std::min(signature_workers(), account_idx.size());
+      vector<const account_object*> accounts;
+      accounts.reserve(account_idx.size());
+      for( const account_object& a : account_idx )
+         accounts.push_back(&a);
+
+      auto count_group = [&](vote_tally& group_tally, vector<vote_ledger::entry>* group_entries,
+                             size_t begin, size_t end) {
+         vote_tally_helper helper(*this, gpo, group_tally);
+         for( size_t i = begin; i < end; ++i )
+         {
+            const account_object& a = *accounts[i];
+            if( !helper.votes(a) )
+               continue;
+            const uint64_t stake = helper.balance_stake(a);
+            const account_object& opinion_account = vote_ledger::opinion_account(*this, a);
+            group_tally.add(vote_opinion(opinion_account.options), stake);
+            if( group_entries != nullptr && stake > 0 )
+               group_entries->push_back({a.get_id(), opinion_account.get_id(), stake});
+         }
+      };
+
+      if( groups < 2 )
       {
-         d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
-         d._committee_count_histogram_buffer.resize(props.parameters.maximum_committee_count / 2 + 1);
-         d._total_voting_stake = 0;
+         count_group(result, entries, 0, accounts.size());
+         return result;
       }
 
-      void operator()(const account_object& stake_account) {
-         if( props.parameters.count_non_member_votes || stake_account.is_member(d.head_block_time()) )
+      vector<vote_tally> tallies(groups, vote_tally(gpo));
+      vector<vector<vote_ledger::entry>> group_entries(groups);
+      vector<std::exception_ptr> errors(groups);
+      run_on_signature_threads(groups, [&](size_t g) {
+         try {
+            count_group(tallies[g], entries != nullptr ? &group_entries[g] : nullptr,
+                        accounts.size() * g / groups, accounts.size() * (g + 1) / groups);
+         } catch( ... ) {
+            errors[g] = std::current_exception();
+         }
+      });
+      for( size_t g = 0; g < groups; ++g )
+      {
+         if( errors[g] )
+            std::rethrow_exception(errors[g]);
+         result.merge(tallies[g]);
+         if( entries != nullptr )
+            entries->insert(entries->end(), group_entries[g].begin(), group_entries[g].end());
+      }
+      return result;
+   };
+
+   vote_tally tally;
+   {
+      GRAPHENE_TRACE_SPAN( "count_votes" );
+      if( _vote_ledger.update(*this, gpo) )
+      {
+         tally = _vote_ledger.tally();
+         if( _check_vote_tally )
          {
-            // There may be a difference between the account whose stake is voting and the one specifying opinions.
-            // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
-            // specifying the opinions.
-            const account_object& opinion_account =
-                  (stake_account.options.voting_account ==
-                   GRAPHENE_PROXY_TO_SELF_ACCOUNT)? stake_account
-                                     : d.get(stake_account.options.voting_account);
-
-            const auto& stats = stake_account.statistics(d);
-            uint64_t voting_stake = stats.total_core_in_orders.value
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
-                  + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
-
-            for( vote_id_type id : opinion_account.options.votes )
+            vector<vote_ledger::entry> entries;
+            vote_tally recount = count_votes(&entries);
+            if( !(recount == tally) )
             {
-               uint32_t offset = id.instance();
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
+               elog( "Vote ledger does not match the full recount at block ${n}, using the recount",
+                     ("n", head_block_num()) );
+               ++_vote_tally_mismatches;
+               _vote_ledger.reset(*this, gpo, recount, entries);
+               tally = std::move(recount);
             }
+         }
+      }
+      else
+      {
+         vector<vote_ledger::entry> entries;
+         tally = count_votes(&entries);
+         _vote_ledger.reset(*this, gpo, tally, entries);
+      }
+   }
 
-            if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_witness_count
-               // are turned into votes for maximum_witness_count.
-               //
-               // in particular, this takes care of the case where a
-               // member was voting for a high number, then the
-               // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
-            }
-            if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_committee_count
-               // are turned into votes for maximum_committee_count.
-               //
-               // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
-            }
+   struct cashback_tally_helper {
+      vote_tally_helper helper;
 
-            d._total_voting_stake += voting_stake;
-         }
+      cashback_tally_helper(const database& d, const global_property_object& gpo, vote_tally& tally)
+         : helper(d, gpo, tally) {}
+
+      void operator()(const account_object& a) {
+         if( !helper.votes(a) )
+            return;
+         const uint64_t stake = helper.cashback_stake(a);
+         if( stake > 0 )
+            helper.add(a, stake);
       }
-   } tally_helper(*this, gpo);
+   } cashback_helper(*this, gpo, tally);
+   // Only the accounts that paid fees since the last maintenance have any to process.  They are still processed in
+   // the name order of the pass, which decides the cashback the tally above sees and the ids of new vesting balances.
    struct process_fees_helper {
       database& d;
       const global_property_object& props;
+      vector<const account_object*> pending;
+      size_t next = 0;
 
       process_fees_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo) {}
+         : d(d), props(gpo)
+      {
+         const auto& pending_fees = dynamic_cast< const primary_index< account_statistics_index >& >(
+               d.get_index_type< account_statistics_index >() ).get_secondary_index< account_pending_fees_index >();
+         pending.reserve( pending_fees.accounts_with_pending_fees().size() );
+         for( const account_id_type& id : pending_fees.accounts_with_pending_fees() )
+            pending.push_back( &id(d) );
+         std::sort( pending.begin(), pending.end(), []( const account_object* a, const account_object* b ) {
+            return a->name < b->name;
+         });
+      }
 
       void operator()(const account_object& a) {
-         a.statistics(d).process_fees(a, d);
+         if( next < pending.size() && pending[next] == &a )
+         {
+            ++next;
+            a.statistics(d).process_fees(a, d);
+         }
       }
    } fee_helper(*this, gpo);
 
-   perform_account_maintenance(std::tie(
-      tally_helper,
-      fee_helper
-      ));
+   {
+      GRAPHENE_TRACE_SPAN( "account_maintenance" );
+      perform_account_maintenance(std::tie(
+         cashback_helper,
+         fee_helper
+         ));
+   }
+
+   _vote_tally_buffer = std::move(tally.votes);
+   _witness_count_histogram_buffer = std::move(tally.witness_count_histogram);
+   _committee_count_histogram_buffer = std::move(tally.committee_count_histogram);
+   _total_voting_stake = tally.total_voting_stake;
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -814,10 +924,13 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
                 b(_committee_count_histogram_buffer),
                 c(_vote_tally_buffer);
 
-   update_top_n_authorities(*this);
-   update_active_witnesses();
-   update_active_committee_members();
-   update_worker_votes();
+   {
+      GRAPHENE_TRACE_SPAN( "update_elections" );
+      update_top_n_authorities(*this);
+      update_active_witnesses();
+      update_active_committee_members();
+      update_worker_votes();
+   }
 
    modify(gpo, [this](global_property_object& p) {
       // Remove scaling of account registration fee
@@ -878,6 +991,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
+   GRAPHENE_TRACE_SPAN( "process_budget" );
    process_budget();
 }
 
@@ -23,12 +23,18 @@
  */
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/db_with.hpp>
 
+#include <graphene/chain/account_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -43,6 +49,7 @@ database::database()
 
 database::~database()
 {
+   wait_for_prevalidated_blocks();
    clear_pending();
 }
 
@@ -60,44 +67,386 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
       return;
    }
 
-   const auto last_block_num = last_block->block_num();
-
    ilog( "Replaying blocks..." );
    _undo_db.disable();
-   for( uint32_t i = 1; i <= last_block_num; ++i )
+   replay_blocks( 1, last_block->block_num() );
+   _undo_db.enable();
+   auto end = fc::time_point::now();
+   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+namespace {
+   /** names the operation types for replay_statistics::operations_by_type and get_operation_statistics() */
+   struct operation_name_visitor
+   {
+      typedef string result_type;
+
+      template<typename Type>
+      result_type operator()( const Type& )const
+      {
+         string name = fc::get_typename<Type>::name();
+         size_t p = name.rfind(':');
+         return p != string::npos ? name.substr( p+1 ) : name;
+      }
+   };
+}
+
+void database::replay_blocks( uint32_t first, uint32_t last, bool keep_blocks_after_gap )
+{ try {
+   // a gap would make the replay drop every block after it
+   FC_ASSERT( !_block_id_to_block.is_pruned( first ),
+              "Block ${n} has been pruned from the block log, the chain can not be replayed from it", ("n",first) );
+   const uint32_t skip = _replay_skip_flags;
+
+   _replay_statistics = replay_statistics();
+   _replay_statistics.first_block = first;
+   _replay_statistics.skip_flags = skip;
+   vector<uint64_t> operation_counts;
+   const fc::microseconds maintenance_before = _maintenance_time;
+   operation_name_visitor operation_namer;
+   const fc::time_point start = fc::time_point::now();
+   fc::time_point interval_start = start;
+   uint64_t interval_transactions = 0;
+
+   // completes and logs the report, also when the replay stops at a gap
+   auto finish_statistics = [&]()
+   {
+      replay_statistics& stats = _replay_statistics;
+      stats.elapsed_time     = ( fc::time_point::now() - start ).count();
+      stats.maintenance_time = ( _maintenance_time - maintenance_before ).count();
+      for( size_t which = 0; which < operation_counts.size(); ++which )
+      {
+         if( operation_counts[which] == 0 ) continue;
+         operation op;
+         op.set_which( which );
+         stats.operations_by_type[ op.visit( operation_namer ) ] = operation_counts[which];
+      }
+      const double seconds = std::max( stats.elapsed_time, int64_t(1) ) / 1000000.0;
+      stats.blocks_per_second       = stats.blocks / seconds;
+      stats.transactions_per_second = stats.transactions / seconds;
+      stats.operations_per_second   = stats.operations / seconds;
+      ilog( "Replay statistics: ${s}", ("s", stats) );
+   };
+
+   // blocks queued for replay; merkle_checked is set once the transaction merkle root has been verified
+   struct replay_item
+   {
+      std::shared_ptr<signed_block> block;
+      bool                          merkle_checked = false;
+   };
+
+   std::unique_ptr<fc::thread> read_thread;
+   std::unique_ptr<fc::thread> digest_thread;
+   std::deque< fc::future<replay_item> > queued;
+   uint32_t next_to_queue = first;
+   if( _replay_prefetch_depth > 0 )
+   {
+      read_thread.reset( new fc::thread( "reindex_read" ) );
+      digest_thread.reset( new fc::thread( "reindex_digest" ) );
+   }
+
+   // keeps up to _replay_prefetch_depth blocks moving through the read and digest threads
+   auto fill_queue = [&]()
+   {
+      while( next_to_queue <= last && queued.size() < _replay_prefetch_depth )
+      {
+         const uint32_t num = next_to_queue++;
+         fc::future< std::shared_ptr<signed_block> > read = read_thread->async( [this,num]() {
+            std::shared_ptr<signed_block> result;
+            fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( num );
+            if( block.valid() )
+               result = std::make_shared<signed_block>( std::move( *block ) );
+            return result;
+         }, "reindex_read" );
+         queued.push_back( digest_thread->async( [read]() mutable {
+            replay_item item;
+            item.block = read.wait();
+            if( item.block )
+               item.merkle_checked = item.block->transaction_merkle_root == item.block->calculate_merkle_root();
+            return item;
+         }, "reindex_digest" ) );
+      }
+   };
+
+   // the block database may only be modified once the prefetch threads are done with it
+   auto drain_queue = [&]()
+   {
+      for( auto& f : queued )
+      {
+         try { f.wait(); } catch( const fc::exception& ) {}
+      }
+      queued.clear();
+   };
+
+   for( uint32_t i = first; i <= last; ++i )
    {
-      if( i % 2000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
-      if( !block.valid() )
+      if( i % 2000 == 0 )
+      {
+         const fc::time_point now = fc::time_point::now();
+         const double seconds = std::max( ( now - interval_start ).count(), int64_t(1) ) / 1000000.0;
+         std::cerr << "   " << double(i*100)/last << "%   "<<i << " of " <<last
+                   << "   " << uint64_t( 2000 / seconds ) << " blocks/s, "
+                   << uint64_t( ( _replay_statistics.transactions - interval_transactions ) / seconds ) << " trx/s   \n";
+         interval_start = now;
+         interval_transactions = _replay_statistics.transactions;
+      }
+
+      replay_item item;
+      const fc::time_point wait_start = fc::time_point::now();
+      if( _replay_prefetch_depth > 0 )
+      {
+         fill_queue();
+         item = queued.front().wait();
+         queued.pop_front();
+      }
+      else
       {
+         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
+         if( block.valid() )
+            item.block = std::make_shared<signed_block>( std::move( *block ) );
+      }
+      const fc::time_point apply_start = fc::time_point::now();
+      _replay_statistics.io_wait_time += ( apply_start - wait_start ).count();
+
+      if( !item.block )
+      {
+         drain_queue();
          wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-         uint32_t dropped_count = 0;
-         while( true )
+         if( !keep_blocks_after_gap )
          {
-            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-            if( !last_id.valid() )
-               break;
-            // we've caught up to the gap
-            if( block_header::num_from_id( *last_id ) <= i )
-               break;
-            _block_id_to_block.remove( *last_id );
-            dropped_count++;
+            const uint32_t dropped_count = _block_id_to_block.remove_after( i );
+            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
          }
-         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
          break;
       }
-      apply_block(*block, skip_witness_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_witness_schedule_check |
-                          skip_authority_check);
+
+      for( const auto& trx : item.block->transactions )
+      {
+         for( const auto& op : trx.operations )
+         {
+            if( operation_counts.size() <= size_t( op.which() ) )
+               operation_counts.resize( op.which() + 1 );
+            ++operation_counts[ op.which() ];
+         }
+         _replay_statistics.operations += trx.operations.size();
+      }
+      _replay_statistics.transactions += item.block->transactions.size();
+
+      // the phases of the block are collected the way push_block() does
+      _block_timing = block_timing();
+      if( !(skip & skip_transaction_signatures) )
+         precompute_signature_keys( *item.block );
+      _replay_statistics.signature_time += ( fc::time_point::now() - apply_start ).count();
+      apply_block( *item.block, skip | ( item.merkle_checked ? skip_merkle_check : 0 ) );
+      _replay_statistics.apply_time += ( fc::time_point::now() - apply_start ).count();
+      _replay_statistics.header_time       += _block_timing.header;
+      _replay_statistics.transaction_time  += _block_timing.apply_transactions;
+      _replay_statistics.chain_update_time += _block_timing.chain_updates;
+      _replay_statistics.handler_time      += _block_timing.handlers;
+      _replay_statistics.last_block = i;
+      ++_replay_statistics.blocks;
    }
-   _undo_db.enable();
+   drain_queue();
+   finish_statistics();
+} FC_CAPTURE_AND_RETHROW( (first)(last)(keep_blocks_after_gap) ) }
+
+void database::set_operation_statistics( bool enabled )
+{
+   _operation_statistics_enabled = enabled;
+   _operation_statistics.clear();
+   if( enabled )
+      _operation_statistics.resize( _operation_evaluators.size() );
+}
+
+flat_map<string,operation_statistics> database::get_operation_statistics()const
+{
+   flat_map<string,operation_statistics> result;
+   operation_name_visitor operation_namer;
+   for( size_t which = 0; which < _operation_statistics.size(); ++which )
+   {
+      if( _operation_statistics[which].count == 0 ) continue;
+      operation op;
+      op.set_which( which );
+      result[ op.visit( operation_namer ) ] = _operation_statistics[which];
+   }
+   return result;
+}
+
+state_snapshot_info database::export_state_snapshot( const fc::path& dir )
+{ try {
+   FC_ASSERT( !fc::exists( dir / "snapshot.json" ), "A snapshot already exists in ${d}", ("d",dir) );
+   state_snapshot_info info;
+   detail::without_pending_transactions( *this, std::move(_pending_tx), [&]()
+   {
+      info.block_num  = head_block_num();
+      info.block_id   = head_block_id();
+      info.chain_id   = get_chain_id();
+      info.state_hash = state_hash();
+      save_snapshot( dir / "object_database" );
+      // written last so that an interrupted export is never mistaken for a snapshot
+      fc::json::save_to_file( info, dir / "snapshot.json" );
+   });
+   ilog( "Exported state snapshot at block ${n} with state hash ${h}", ("n",info.block_num)("h",info.state_hash) );
+   return info;
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+std::unique_ptr<database> database::fork_state()const
+{ try {
+   std::unique_ptr<database> fork( new database );
+   fork->copy_objects_from( *this );
+   // lets clear_pending() on the copy undo what was pushed to it
+   fork->_undo_db.enable();
+   return fork;
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::open_object_paging( const fc::path& data_dir )
+{
+   get_mutable_index_type<account_statistics_index>().set_paging( data_dir / "database" / "account_statistics.pages",
+                                                                  _object_paging_idle_blocks );
+}
+
+state_snapshot_info database::restore_snapshot( const fc::path& data_dir, const fc::path& blockchain_dir,
+                                                 const fc::path& snapshot_dir, const fc::sha256& trusted_state_hash )
+{ try {
+   ilog( "Restoring chain state from snapshot ${s}", ("s",snapshot_dir) );
+   const auto info = fc::json::from_file( snapshot_dir / "snapshot.json" ).as<state_snapshot_info>();
+   FC_ASSERT( info.state_hash == trusted_state_hash, "Snapshot state hash does not match the trusted state hash",
+              ("snapshot",info.state_hash)("trusted",trusted_state_hash) );
+
+   wipe( data_dir, false );
+   object_database::open( data_dir );
+   open_object_paging( data_dir );
+   load_snapshot( snapshot_dir / "object_database" );
+
+   FC_ASSERT( find( global_property_id_type() ), "Snapshot does not contain a chain state" );
+   const fc::sha256 loaded_hash = state_hash();
+   FC_ASSERT( loaded_hash == info.state_hash, "Snapshot contents do not match its state hash",
+              ("expected",info.state_hash)("actual",loaded_hash) );
+   FC_ASSERT( head_block_num() == info.block_num && head_block_id() == info.block_id,
+              "Snapshot head block does not match its description", ("info",info)("head",head_block_id()) );
+   // snapshot.json is not covered by the state hash, the chain it names has to be the one of the state
+   FC_ASSERT( info.chain_id == get_chain_id(), "Snapshot describes chain ${s} but holds the state of chain ${c}",
+              ("s",info.chain_id)("c",get_chain_id()) );
+
+   _block_id_to_block.open( blockchain_dir / "database" / "block_num_to_block" );
+   if( info.block_num > 0 )
+      FC_ASSERT( _block_id_to_block.fetch_block_id( info.block_num ) == info.block_id,
+                 "Snapshot head block ${n} is not part of the chain in the block log", ("n",info.block_num) );
+   return info;
+} FC_CAPTURE_AND_RETHROW( (data_dir)(blockchain_dir)(snapshot_dir) ) }
+
+void database::reindex_from_snapshot( fc::path data_dir, const fc::path& snapshot_dir, const fc::sha256& trusted_state_hash )
+{ try {
+   const state_snapshot_info info = restore_snapshot( data_dir, data_dir, snapshot_dir, trusted_state_hash );
+
+   auto start = fc::time_point::now();
+   auto last_block = _block_id_to_block.last();
+   if( last_block.valid() && last_block->block_num() > info.block_num )
+   {
+      ilog( "Replaying blocks ${a} through ${b}...", ("a",info.block_num+1)("b",last_block->block_num()) );
+      _undo_db.disable();
+      replay_blocks( info.block_num + 1, last_block->block_num() );
+      _undo_db.enable();
+      // blocks after a gap have been dropped
+      last_block = _block_id_to_block.last();
+   }
+   if( last_block.valid() )
+      _fork_db.start_block( *last_block );
+   update_prevalidation_limits();
+
    auto end = fc::time_point::now();
-   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
-} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+   ilog( "Done restoring from snapshot, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+} FC_CAPTURE_AND_RETHROW( (data_dir)(snapshot_dir) ) }
+
+vector<replay_range_verification> database::verify_replay( const fc::path& blockchain_dir,
+                                                          const vector<fc::path>& snapshot_dirs,
+                                                          const optional<fc::sha256>& trusted_state_hash,
+                                                          const fc::path& work_dir,
+                                                          uint32_t thread_count )const
+{ try {
+   vector< std::pair<state_snapshot_info,fc::path> > snapshots;
+   for( const auto& dir : snapshot_dirs )
+      snapshots.emplace_back( fc::json::from_file( dir / "snapshot.json" ).as<state_snapshot_info>(), dir );
+   std::sort( snapshots.begin(), snapshots.end(), []( const std::pair<state_snapshot_info,fc::path>& a,
+                                                      const std::pair<state_snapshot_info,fc::path>& b ) {
+      return a.first.block_num < b.first.block_num;
+   });
+   FC_ASSERT( snapshots.size() >= 2, "At least two snapshots are needed to delimit a range of blocks" );
+   for( size_t i = 1; i < snapshots.size(); ++i )
+   {
+      FC_ASSERT( snapshots[i].first.block_num > snapshots[i-1].first.block_num,
+                 "Two snapshots were taken at block ${n}", ("n",snapshots[i].first.block_num) );
+      FC_ASSERT( snapshots[i].first.chain_id == snapshots[0].first.chain_id,
+                 "Snapshot ${d} belongs to a different chain", ("d",snapshots[i].second) );
+   }
+   if( trusted_state_hash.valid() )
+      FC_ASSERT( snapshots[0].first.state_hash == *trusted_state_hash,
+                 "Snapshot state hash does not match the trusted state hash",
+                 ("snapshot",snapshots[0].first.state_hash)("trusted",*trusted_state_hash) );
+
+   vector<replay_range_verification> results( snapshots.size() - 1 );
+   for( size_t i = 0; i < results.size(); ++i )
+   {
+      results[i].from_block          = snapshots[i].first.block_num;
+      results[i].to_block            = snapshots[i+1].first.block_num;
+      results[i].expected_state_hash = snapshots[i+1].first.state_hash;
+   }
+
+   const uint32_t prefetch_depth = _replay_prefetch_depth;
+   const uint32_t skip = _replay_skip_flags;
+   const uint32_t paging_idle_blocks = _object_paging_idle_blocks;
+   // every range gets a database of its own; the block log is shared, so nothing may be written to it
+   auto verify_range = [&]( size_t i )
+   {
+      replay_range_verification& result = results[i];
+      const fc::path range_dir = work_dir / ( "range-" + fc::to_string( uint64_t(i) ) );
+      const fc::time_point start = fc::time_point::now();
+      try
+      {
+         database db;
+         db.set_replay_prefetch_depth( prefetch_depth );
+         db.set_replay_skip_flags( skip );
+         db.set_object_paging( paging_idle_blocks );
+         db.restore_snapshot( range_dir, blockchain_dir, snapshots[i].second, snapshots[i].first.state_hash );
+         db._undo_db.disable();
+         db.replay_blocks( result.from_block + 1, result.to_block, true );
+         FC_ASSERT( db.head_block_num() == result.to_block,
+                    "The replay stopped at block ${n}", ("n",db.head_block_num()) );
+         result.actual_state_hash = db.state_hash();
+         result.matches = result.actual_state_hash == result.expected_state_hash;
+         // close() would rewind the head blocks out of the shared block log
+         db._block_id_to_block.close();
+      }
+      catch( const fc::exception& e )
+      {
+         result.error = e.to_string();
+      }
+      result.elapsed_time = ( fc::time_point::now() - start ).count();
+      fc::remove_all( range_dir );
+      if( result.matches )
+         ilog( "Blocks ${a} through ${b} reproduce state hash ${h}",
+               ("a",result.from_block+1)("b",result.to_block)("h",result.actual_state_hash) );
+      else
+         elog( "Blocks ${a} through ${b} do not reproduce the snapshot state: ${r}",
+               ("a",result.from_block+1)("b",result.to_block)("r",result) );
+   };
+
+   // each thread replays its share of the ranges one after the other
+   const size_t threads = std::max<size_t>( 1, std::min<size_t>( thread_count, results.size() ) );
+   vector< std::unique_ptr<fc::thread> > replay_threads;
+   vector< fc::future<void> > done;
+   for( size_t t = 0; t < threads; ++t )
+   {
+      replay_threads.emplace_back( new fc::thread( "verify_replay_" + fc::to_string( uint64_t(t) ) ) );
+      done.push_back( replay_threads.back()->async( [&verify_range,&results,threads,t]() {
+         for( size_t i = t; i < results.size(); i += threads )
+            verify_range( i );
+      }, "verify_replay" ) );
+   }
+   for( auto& f : done )
+      f.wait();
+   return results;
+} FC_CAPTURE_AND_RETHROW( (blockchain_dir)(snapshot_dirs)(work_dir)(thread_count) ) }
 
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
@@ -115,13 +464,41 @@ void database::open(
    try
    {
       object_database::open(data_dir);
+      open_object_paging( data_dir );
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+      if( _block_retention > 0 && _block_id_to_block.segment_size() == 0 )
+         wlog( "The block log has no segments and will not be pruned" );
 
       if( !find(global_property_id_type()) )
          init_genesis(genesis_loader());
 
       fc::optional<signed_block> last_block = _block_id_to_block.last();
+      // a saved state or checkpoint is only of use on the chain of the block log, otherwise the caller reindexes
+      if( head_block_num() > 0 )
+         FC_ASSERT( last_block.valid() && last_block->block_num() >= head_block_num()
+                    && _block_id_to_block.contains( head_block_id() ),
+                    "The head block ${n} ${id} of the saved state is not in the block log",
+                    ("n",head_block_num())("id",head_block_id()) );
+      if( last_block.valid() && head_block_num() > 0 && last_block->block_num() > head_block_num() )
+      {
+         // the object database was restored from a checkpoint which is older than the block log
+         ilog( "Applying blocks ${a} through ${b} from the block log", ("a",head_block_num()+1)("b",last_block->block_num()) );
+         _undo_db.disable();
+         for( uint32_t i = head_block_num() + 1; i <= last_block->block_num(); ++i )
+         {
+            fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( i );
+            FC_ASSERT( block.valid(), "Block ${i} is missing from the block log", ("i",i) );
+            apply_block( *block, skip_witness_signature |
+                                 skip_transaction_signatures |
+                                 skip_transaction_dupe_check |
+                                 skip_tapos_check |
+                                 skip_witness_schedule_check |
+                                 skip_authority_check );
+         }
+         _undo_db.enable();
+      }
+
       if( last_block.valid() )
       {
          _fork_db.start_block( *last_block );
@@ -131,11 +508,48 @@ void database::open(
               FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
          }
       }
+      update_prevalidation_limits();
       //idump((head_block_id())(head_block_num()));
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
+void database::set_checkpoint_interval( uint32_t interval, uint64_t max_changelog_size )
+{
+   _checkpoint_interval = interval;
+   _max_changelog_size  = max_changelog_size;
+   enable_changelog( interval > 0 );
+}
+
+void database::set_block_log_memory_mapped( bool enabled )
+{
+   _block_id_to_block.set_memory_mapped( enabled );
+}
+
+void database::set_block_log_storage( uint32_t segment_size, int compression_level )
+{
+   _block_id_to_block.set_segment_size( segment_size );
+   _block_id_to_block.set_compression_level( compression_level );
+}
+
+void database::set_block_log_write_behind( uint32_t flush_interval )
+{
+   _block_id_to_block.set_write_behind( flush_interval );
+}
+
+void database::maybe_write_checkpoint()
+{ try {
+   if( _checkpoint_interval == 0 || head_block_num() % _checkpoint_interval != 0 )
+      return;
+
+   // blocks must reach the disk before any state that depends on them
+   _block_id_to_block.flush();
+   if( changelog_size() > _max_changelog_size )
+      object_database::flush();
+   else
+      write_checkpoint();
+} FC_CAPTURE_AND_RETHROW() }
+
 void database::close(bool rewind)
 {
    // TODO:  Save pending tx's on close()
@@ -176,6 +590,8 @@ void database::close(bool rewind)
 
    object_database::flush();
    object_database::close();
+   // the objects may be reloaded without passing through the secondary indexes
+   _authorized_signers.clear();
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
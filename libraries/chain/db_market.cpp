@@ -167,30 +167,36 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    if( called_some && !find_object(order_id) ) // then we were filled by call order
       return true;
 
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-
-   // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
-   // determine whether or not this order has "changed the book" in a way that requires us to
-   // check orders. For now I just lookup the lower bound and check for equality... this is log(n) vs
-   // constant time check. Potential optimization.
-
+   // The best order on the other side of the book tells whether the new order crosses the spread at all, a maker
+   // order that does not cross matches nothing and costs no seek of the price index.
    auto max_price = ~new_order_object.sell_price;
-   auto limit_itr = limit_price_idx.lower_bound(max_price.max());
-   auto limit_end = limit_price_idx.upper_bound(max_price);
-
-   bool finished = false;
-   while( !finished && limit_itr != limit_end )
+   const limit_order_book_index::levels_type* opposite = _limit_order_book->get_levels( max_price.base.asset_id,
+                                                                                        max_price.quote.asset_id );
+   const uint64_t changes = _margin_call_checks.changes();
+   if( opposite != nullptr && !( opposite->begin()->first < max_price ) )
    {
-      auto old_limit_itr = limit_itr;
-      ++limit_itr;
-      // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-      finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
+      auto limit_itr = limit_price_idx.lower_bound( price_key( max_price.max() ) );
+      auto limit_end = limit_price_idx.upper_bound( price_key( max_price ) );
+
+      bool finished = false;
+      while( !finished && limit_itr != limit_end )
+      {
+         auto old_limit_itr = limit_itr;
+         ++limit_itr;
+         // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
+         finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      }
    }
 
-   //Possible optimization: only check calls if the new order completely filled some old order
+   // When no order, call order or bitasset changed since the calls were checked above, checking them again finds
+   // nothing to do.  Before #436 the outcome also depends on the block time, so they are always checked again.
    //Do I need to check both assets?
-   check_call_orders(sell_asset, allow_black_swan);
-   check_call_orders(receive_asset, allow_black_swan);
+   if( changes != _margin_call_checks.changes() || head_block_time() <= HARDFORK_436_TIME )
+   {
+      check_call_orders(sell_asset, allow_black_swan);
+      check_call_orders(receive_asset, allow_black_swan);
+   }
 
    const limit_order_object* updated_order_object = find< limit_order_object >( order_id );
    if( updated_order_object == nullptr )
@@ -299,8 +305,9 @@ bool database::fill_order( const limit_order_object& order, const asset& pays, c
    FC_ASSERT( order.amount_for_sale().asset_id == pays.asset_id );
    FC_ASSERT( pays.asset_id != receives.asset_id );
 
-   const account_object& seller = order.seller(*this);
-   const asset_object& recv_asset = receives.asset_id(*this);
+   // fills run for every matched order, so skip the virtual index lookups
+   const account_object& seller = get_typed<account_index>( order.seller );
+   const asset_object& recv_asset = get_typed<asset_index>( receives.asset_id );
 
    auto issuer_fees = pay_market_fees( recv_asset, receives );
    pay_order( seller, receives - issuer_fees, pays );
@@ -311,7 +318,7 @@ bool database::fill_order( const limit_order_object& order, const asset& pays, c
    // conditional because cheap integer comparison may allow us to avoid two expensive modify() and object lookups
    if( order.deferred_fee > 0 )
    {
-      modify( seller.statistics(*this), [&]( account_statistics_object& statistics )
+      modify( get_typed<account_statistics_index>( seller.statistics ), [&]( account_statistics_object& statistics )
       {
          statistics.pay_fee( order.deferred_fee, get_global_properties().parameters.cashback_vesting_threshold );
       } );
@@ -324,7 +331,7 @@ bool database::fill_order( const limit_order_object& order, const asset& pays, c
    }
    else
    {
-      modify( order, [&]( limit_order_object& b ) {
+      modify_non_key<limit_order_index>( order, [&]( limit_order_object& b ) {
                              b.for_sale -= pays.amount;
                              b.deferred_fee = 0;
                           });
@@ -352,20 +359,20 @@ bool database::fill_order( const call_order_object& order, const asset& pays, co
               o.collateral = 0;
             }
        });
-   const asset_object& mia = receives.asset_id(*this);
+   const asset_object& mia = get_typed<asset_index>( receives.asset_id );
    assert( mia.is_market_issued() );
 
-   const asset_dynamic_data_object& mia_ddo = mia.dynamic_asset_data_id(*this);
+   const asset_dynamic_data_object& mia_ddo = get_typed<asset_dynamic_data_index>( mia.dynamic_asset_data_id );
 
    modify( mia_ddo, [&]( asset_dynamic_data_object& ao ){
        //idump((receives));
         ao.current_supply -= receives.amount;
       });
 
-   const account_object& borrower = order.borrower(*this);
+   const account_object& borrower = get_typed<account_index>( order.borrower );
    if( collateral_freed || pays.asset_id == asset_id_type() )
    {
-      const account_statistics_object& borrower_statistics = borrower.statistics(*this);
+      const account_statistics_object& borrower_statistics = get_typed<account_statistics_index>( borrower.statistics );
       if( collateral_freed )
          adjust_balance(borrower.get_id(), *collateral_freed);
 
@@ -392,7 +399,7 @@ bool database::fill_order(const force_settlement_object& settle, const asset& pa
 { try {
    bool filled = false;
 
-   auto issuer_fees = pay_market_fees(get(receives.asset_id), receives);
+   auto issuer_fees = pay_market_fees(get_typed<asset_index>(receives.asset_id), receives);
 
    if( pays < settle.balance )
    {
@@ -427,9 +434,26 @@ bool database::fill_order(const force_settlement_object& settle, const asset& pa
  *  @return true if a margin call was executed.
  */
 bool database::check_call_orders(const asset_object& mia, bool enable_black_swan)
-{ try {
+{
     if( !mia.is_market_issued() ) return false;
 
+    // Before #436 the outcome also depends on the block time, so the cache is only used after it.
+    const bool use_cache = head_block_time() > HARDFORK_436_TIME;
+    if( use_cache && _margin_call_checks.is_unchanged( mia.id ) )
+       return false;
+
+    const uint64_t changes = _margin_call_checks.changes();
+    const bool result = match_call_orders( mia, enable_black_swan );
+    if( use_cache && !result && changes == _margin_call_checks.changes() )
+    {
+       const asset_bitasset_data_object& bitasset = mia.bitasset_data(*this);
+       _margin_call_checks.mark_checked( mia.id, bitasset.options.short_backing_asset, bitasset.id );
+    }
+    return result;
+}
+
+bool database::match_call_orders(const asset_object& mia, bool enable_black_swan)
+{ try {
     if( check_for_blackswan( mia, enable_black_swan ) ) 
        return false;
 
@@ -450,8 +474,8 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
 
     assert( max_price.base.asset_id == min_price.base.asset_id );
     // NOTE limit_price_index is sorted from greatest to least
-    auto limit_itr = limit_price_index.lower_bound( max_price );
-    auto limit_end = limit_price_index.upper_bound( min_price );
+    auto limit_itr = limit_price_index.lower_bound( price_key( max_price ) );
+    auto limit_end = limit_price_index.upper_bound( price_key( min_price ) );
 
     if( limit_itr == limit_end )
        return false;
@@ -548,7 +572,7 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
 
 void database::pay_order( const account_object& receiver, const asset& receives, const asset& pays )
 {
-   const auto& balances = receiver.statistics(*this);
+   const auto& balances = get_typed<account_statistics_index>( receiver.statistics );
    modify( balances, [&]( account_statistics_object& b ){
          if( pays.asset_id == asset_id_type() )
          {
@@ -586,7 +610,7 @@ asset database::pay_market_fees( const asset_object& recv_asset, const asset& re
    //Don't dirty undo state if not actually collecting any fees
    if( issuer_fees.amount > 0 )
    {
-      const auto& recv_dyn_data = recv_asset.dynamic_asset_data_id(*this);
+      const auto& recv_dyn_data = get_typed<asset_dynamic_data_index>( recv_asset.dynamic_asset_data_id );
       modify( recv_dyn_data, [&]( asset_dynamic_data_object& obj ){
                    //idump((issuer_fees));
          obj.accumulated_fees += issuer_fees.amount;
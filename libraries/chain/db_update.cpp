@@ -153,6 +153,10 @@ void database::update_last_irreversible_block()
       {
          _dpo.last_irreversible_block_num = new_last_irreversible_block_num;
       } );
+      // irreversible blocks can no longer be fetched from the fork database, make them durable
+      _block_id_to_block.flush_through( new_last_irreversible_block_num );
+      if( _block_retention > 0 && new_last_irreversible_block_num > _block_retention )
+         _block_id_to_block.prune_before( new_last_irreversible_block_num - _block_retention + 1 );
    }
 }
 
@@ -160,10 +164,11 @@ void database::clear_expired_transactions()
 { try {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
+   //The index is ordered by expiration, so only the expired entries at its front are visited.
    auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids, impl_transaction_object_type));
    const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.rbegin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.rbegin());
+   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->expiration) )
+      transaction_idx.remove(*dedupe_index.begin());
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_expired_proposals()
@@ -219,8 +224,8 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
 
     assert( highest_possible_bid.base.asset_id == lowest_possible_bid.base.asset_id );
     // NOTE limit_price_index is sorted from greatest to least
-    auto limit_itr = limit_price_index.lower_bound( highest_possible_bid );
-    auto limit_end = limit_price_index.upper_bound( lowest_possible_bid );
+    auto limit_itr = limit_price_index.lower_bound( price_key( highest_possible_bid ) );
+    auto limit_end = limit_price_index.upper_bound( price_key( lowest_possible_bid ) );
 
     auto call_min = price::min( bitasset.options.short_backing_asset, mia.id );
     auto call_max = price::max( bitasset.options.short_backing_asset, mia.id );
@@ -286,7 +291,8 @@ void database::clear_expired_orders()
 
    //Process expired force settlement orders
    auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
-   if( !settlement_index.empty() )
+   // Nothing below changes any settlement unless one is due or belongs to a globally settled asset
+   if( !settlement_index.empty() && !_force_settlement_schedule.is_idle( head_block_time() ) )
    {
       asset_id_type current_asset = settlement_index.begin()->settlement_asset_id();
       asset max_settlement_volume;
@@ -40,19 +40,62 @@
 namespace graphene { namespace chain {
 database& generic_evaluator::db()const { return trx_state->db(); }
 
+namespace {
+   /** adds the time until it goes out of scope to total, if there is one, and raises max to it, if given */
+   struct operation_timer
+   {
+      int64_t*       total;
+      int64_t*       max;
+      fc::time_point start;
+
+      operation_timer( int64_t* total, int64_t* max = nullptr ) : total( total ), max( max )
+      {
+         if( total != nullptr )
+            start = fc::time_point::now();
+      }
+      ~operation_timer()
+      {
+         if( total == nullptr )
+            return;
+         const int64_t elapsed = ( fc::time_point::now() - start ).count();
+         *total += elapsed;
+         if( max != nullptr && elapsed > *max )
+            *max = elapsed;
+      }
+   };
+}
+
    operation_result generic_evaluator::start_evaluate( transaction_evaluation_state& eval_state, const operation& op, bool apply )
    { try {
       trx_state   = &eval_state;
       //check_required_authorities(op);
-      auto result = evaluate( op );
+      operation_statistics* stats = db().current_operation_statistics();
+      if( stats == nullptr )
+      {
+         auto result = evaluate( op );
+
+         if( apply ) result = this->apply( op );
+         return result;
+      }
 
-      if( apply ) result = this->apply( op );
+      operation_result result;
+      {
+         operation_timer timer( &stats->evaluate_time, &stats->max_evaluate_time );
+         result = evaluate( op );
+      }
+      if( apply )
+      {
+         operation_timer timer( &stats->apply_time, &stats->max_apply_time );
+         result = this->apply( op );
+      }
       return result;
    } FC_CAPTURE_AND_RETHROW() }
 
    void generic_evaluator::prepare_fee(account_id_type account_id, asset fee)
    {
       const database& d = db();
+      operation_statistics* stats = d.current_operation_statistics();
+      operation_timer timer( stats != nullptr ? &stats->fee_time : nullptr );
       fee_from_account = fee;
       FC_ASSERT( fee.amount >= 0 );
       fee_paying_account = &account_id(d);
@@ -81,6 +124,8 @@ database& generic_evaluator::db()const { return trx_state->db(); }
 
    void generic_evaluator::convert_fee()
    {
+      operation_statistics* stats = db().current_operation_statistics();
+      operation_timer timer( stats != nullptr ? &stats->fee_time : nullptr );
       if( !trx_state->skip_fee ) {
          if( fee_asset->get_id() != asset_id_type() )
          {
@@ -26,6 +26,8 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <unordered_set>
+
 namespace graphene { namespace chain {
 fork_database::fork_database()
 {
@@ -34,6 +36,15 @@ void fork_database::reset()
 {
    _head.reset();
    _index.clear();
+   _unlinked_index.clear();
+   _memory_used = 0;
+}
+
+template<typename Index, typename Iterator>
+void fork_database::_erase( Index& index, Iterator itr )
+{
+   _memory_used -= (*itr)->size;
+   index.erase( itr );
 }
 
 void fork_database::pop_block()
@@ -45,9 +56,15 @@ void fork_database::pop_block()
 }
 
 void     fork_database::start_block(signed_block b)
+{
+   start_block( std::make_shared<const signed_block>( std::move(b) ) );
+}
+
+void     fork_database::start_block(shared_ptr<const signed_block> b)
 {
    auto item = std::make_shared<fork_item>(std::move(b));
-   _index.insert(item);
+   if( _index.insert(item).second )
+      _memory_used += item->size;
    _head = item;
 }
 
@@ -57,13 +74,18 @@ void     fork_database::start_block(signed_block b)
  */
 shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
 {
-   auto item = std::make_shared<fork_item>(b);
+   return push_block( std::make_shared<const signed_block>( b ) );
+}
+
+shared_ptr<fork_item>  fork_database::push_block(shared_ptr<const signed_block> b)
+{
+   auto item = std::make_shared<fork_item>(std::move(b));
    try {
       _push_block(item);
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",item->id)("num",item->num) );
       wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
       throw;
       _unlinked_index.insert( item );
@@ -89,7 +111,8 @@ void  fork_database::_push_block(const item_ptr& item)
       item->prev = *itr;
    }
 
-   _index.insert(item);
+   if( _index.insert(item).second )
+      _memory_used += item->size;
    if( !_head ) _head = item;
    else if( item->num > _head->num )
    {
@@ -98,10 +121,15 @@ void  fork_database::_push_block(const item_ptr& item)
 //      ilog( "min block in fork DB ${n}, max_size: ${m}", ("n",min_num)("m",_max_size) );
       auto& num_idx = _index.get<block_num>();
       while( num_idx.size() && (*num_idx.begin())->num < min_num )
-         num_idx.erase( num_idx.begin() );
-      
-      _unlinked_index.get<block_num>().erase(_head->num - _max_size);
+         _erase( num_idx, num_idx.begin() );
+
+      auto& unlinked_num_idx = _unlinked_index.get<block_num>();
+      auto unlinked_range = unlinked_num_idx.equal_range( _head->num - _max_size );
+      while( unlinked_range.first != unlinked_range.second )
+         _erase( unlinked_num_idx, unlinked_range.first++ );
    }
+   else // the head did not move, so the database has it applied and blocks off its branch may go
+      _enforce_memory_limit();
    //_push_next( item );
 }
 
@@ -119,7 +147,7 @@ void fork_database::_push_next( const item_ptr& new_item )
     while( itr != prev_idx.end() )
     {
        auto tmp = *itr;
-       prev_idx.erase( itr );
+       _erase( prev_idx, itr );
        _push_block( tmp );
 
        itr = prev_idx.find( new_item->id );
@@ -137,7 +165,7 @@ void fork_database::set_max_size( uint32_t s )
       while( itr != by_num_idx.end() )
       {
          if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
+            _erase( by_num_idx, itr );
          else
             break;
          itr = by_num_idx.begin();
@@ -149,7 +177,7 @@ void fork_database::set_max_size( uint32_t s )
       while( itr != by_num_idx.end() )
       {
          if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
+            _erase( by_num_idx, itr );
          else
             break;
          itr = by_num_idx.begin();
@@ -247,7 +275,59 @@ void fork_database::set_head(shared_ptr<fork_item> h)
 
 void fork_database::remove(block_id_type id)
 {
-   _index.get<block_id>().erase(id);
+   auto& index = _index.get<block_id>();
+   auto itr = index.find(id);
+   if( itr != index.end() )
+      _erase( index, itr );
+}
+
+void fork_database::set_max_memory( size_t bytes )
+{
+   _max_memory = bytes;
+   _enforce_memory_limit();
+}
+
+void fork_database::_enforce_memory_limit()
+{
+   if( _max_memory == 0 || _memory_used <= _max_memory )
+      return;
+
+   auto& unlinked_num_idx = _unlinked_index.get<block_num>();
+   while( _memory_used > _max_memory && !unlinked_num_idx.empty() )
+      _erase( unlinked_num_idx, unlinked_num_idx.begin() );
+   if( _memory_used <= _max_memory )
+      return;
+
+   // the branch of the head is what a fork switch or pop_block() walks back along, it is never dropped
+   std::unordered_set<const fork_item*> head_branch;
+   for( item_ptr item = _head; item; item = item->prev.lock() )
+      head_branch.insert( item.get() );
+
+   // a fork goes as a whole, from the block where it leaves the head's branch on, so every block kept can still
+   // be walked back to the head's branch; the fork that left it first goes first
+   auto& num_idx = _index.get<block_num>();
+   auto& id_idx = _index.get<block_id>();
+   auto& prev_idx = _index.get<by_previous>();
+   auto itr = num_idx.begin();
+   while( _memory_used > _max_memory && itr != num_idx.end() )
+   {
+      if( head_branch.count( itr->get() ) )
+      {
+         ++itr;
+         continue;
+      }
+      // the parent of the oldest block off the head's branch is on it, the block starts a fork
+      vector<block_id_type> fork( 1, (*itr)->id );
+      for( size_t i = 0; i < fork.size(); ++i )
+      {
+         auto children = prev_idx.equal_range( fork[i] );
+         for( auto child = children.first; child != children.second; ++child )
+            fork.push_back( (*child)->id );
+      }
+      for( const block_id_type& id : fork )
+         _erase( id_idx, id_idx.find( id ) );
+      itr = num_idx.begin();
+   }
 }
 
 } } // graphene::chain
@@ -28,6 +28,11 @@
 #include <fc/smart_ref_impl.hpp>   // required for gcc in release mode
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cctype>
+
 namespace graphene { namespace chain {
 
 chain_id_type genesis_state_type::compute_chain_id() const
@@ -35,4 +40,199 @@ chain_id_type genesis_state_type::compute_chain_id() const
    return initial_chain_id;
 }
 
+static const char binary_genesis_magic[] = "GPHGEN\x01\n";
+static const size_t binary_genesis_magic_size = sizeof(binary_genesis_magic) - 1;
+
+bool is_binary_genesis( const std::string& contents )
+{
+   return contents.compare( 0, binary_genesis_magic_size, binary_genesis_magic, binary_genesis_magic_size ) == 0;
+}
+
+std::string pack_binary_genesis( const genesis_state_type& genesis )
+{
+   std::string result( binary_genesis_magic, binary_genesis_magic_size );
+   result.resize( binary_genesis_magic_size + fc::raw::pack_size( genesis ) );
+   fc::datastream<char*> ds( &result[binary_genesis_magic_size], result.size() - binary_genesis_magic_size );
+   fc::raw::pack( ds, genesis );
+   return result;
+}
+
+genesis_state_type unpack_binary_genesis( const std::string& contents )
+{ try {
+   FC_ASSERT( is_binary_genesis( contents ), "Not a binary genesis file" );
+   genesis_state_type genesis;
+   fc::datastream<const char*> ds( contents.data() + binary_genesis_magic_size, contents.size() - binary_genesis_magic_size );
+   fc::raw::unpack( ds, genesis );
+   FC_ASSERT( ds.remaining() == 0, "Trailing data after the binary genesis state" );
+   return genesis;
+} FC_CAPTURE_AND_RETHROW() }
+
+namespace {
+
+   /** finds the extent of JSON values in a document without interpreting them */
+   class json_scanner
+   {
+      public:
+         explicit json_scanner( const std::string& json ) : _json( json ) {}
+
+         size_t pos()const { return _pos; }
+         void   seek( size_t pos ) { _pos = pos; }
+
+         void skip_space()
+         {
+            while( _pos < _json.size() && std::isspace( static_cast<unsigned char>( _json[_pos] ) ) )
+               ++_pos;
+         }
+
+         char peek()
+         {
+            skip_space();
+            FC_ASSERT( _pos < _json.size(), "Unexpected end of genesis JSON" );
+            return _json[_pos];
+         }
+
+         void expect( char c )
+         {
+            FC_ASSERT( peek() == c, "Expected '${c}' at offset ${p} of genesis JSON", ("c", std::string(1, c))("p", _pos) );
+            ++_pos;
+         }
+
+         /** moves past the value at the current position and returns where it started */
+         size_t skip_value()
+         {
+            skip_space();
+            const size_t begin = _pos;
+            uint32_t depth = 0;
+            do
+            {
+               FC_ASSERT( _pos < _json.size(), "Unexpected end of genesis JSON" );
+               const char c = _json[_pos];
+               if( c == '"' )
+                  skip_string();
+               else if( c == '{' || c == '[' )
+               {
+                  ++depth;
+                  ++_pos;
+               }
+               else if( c == '}' || c == ']' )
+               {
+                  FC_ASSERT( depth > 0, "Unexpected '${c}' at offset ${p} of genesis JSON", ("c", std::string(1, c))("p", _pos) );
+                  --depth;
+                  ++_pos;
+               }
+               else if( depth == 0 )
+               {
+                  // a number or literal ends at the next delimiter
+                  while( _pos < _json.size() && !std::isspace( static_cast<unsigned char>( _json[_pos] ) )
+                         && _json[_pos] != ',' && _json[_pos] != '}' && _json[_pos] != ']' )
+                     ++_pos;
+               }
+               else
+                  ++_pos;
+            } while( depth > 0 );
+            FC_ASSERT( _pos > begin, "Expected a value at offset ${p} of genesis JSON", ("p", begin) );
+            return begin;
+         }
+
+         /** converts each element of the array at the current position to T and appends it to result */
+         template<typename T>
+         void parse_array( std::vector<T>& result )
+         {
+            expect( '[' );
+            if( peek() == ']' )
+            {
+               ++_pos;
+               return;
+            }
+            const size_t first = _pos;
+            size_t count = 0;
+            do { skip_value(); ++count; } while( next_element() );
+            result.reserve( result.size() + count );
+
+            _pos = first;
+            do
+            {
+               const size_t begin = skip_value();
+               result.emplace_back( fc::json::from_string( _json.substr( begin, _pos - begin ) ).as<T>() );
+            } while( next_element() );
+         }
+
+         /** moves past the ',' before the next element or member, or the closing bracket */
+         bool next_element()
+         {
+            const char c = peek();
+            ++_pos;
+            if( c == ',' )
+               return true;
+            FC_ASSERT( c == ']' || c == '}', "Expected ',' at offset ${p} of genesis JSON", ("p", _pos - 1) );
+            return false;
+         }
+
+      private:
+         void skip_string()
+         {
+            for( ++_pos; _pos < _json.size(); ++_pos )
+            {
+               if( _json[_pos] == '\\' )
+                  ++_pos;
+               else if( _json[_pos] == '"' )
+               {
+                  ++_pos;
+                  return;
+               }
+            }
+            FC_THROW( "Unterminated string in genesis JSON" );
+         }
+
+         const std::string& _json;
+         size_t             _pos = 0;
+   };
+
+} // anonymous namespace
+
+genesis_state_type parse_genesis_json( const std::string& json )
+{ try {
+   json_scanner scanner( json );
+   genesis_state_type streamed;
+   // every member that is not streamed is copied here and converted as one small document
+   std::string others = "{";
+
+   scanner.expect( '{' );
+   if( scanner.peek() == '}' )
+      scanner.next_element();
+   else do
+   {
+      FC_ASSERT( scanner.peek() == '"', "Expected a member name at offset ${p} of genesis JSON", ("p", scanner.pos()) );
+      const size_t key_begin = scanner.skip_value();
+      const size_t key_end = scanner.pos();
+      const std::string key = fc::json::from_string( json.substr( key_begin, key_end - key_begin ) ).as_string();
+      scanner.expect( ':' );
+
+      if( key == "initial_accounts" )
+         scanner.parse_array( streamed.initial_accounts );
+      else if( key == "initial_balances" )
+         scanner.parse_array( streamed.initial_balances );
+      else if( key == "initial_vesting_balances" )
+         scanner.parse_array( streamed.initial_vesting_balances );
+      else
+      {
+         const size_t value_begin = scanner.skip_value();
+         if( others.size() > 1 )
+            others += ',';
+         others.append( json, key_begin, key_end - key_begin );
+         others += ':';
+         others.append( json, value_begin, scanner.pos() - value_begin );
+      }
+   } while( scanner.next_element() );
+   scanner.skip_space();
+   FC_ASSERT( scanner.pos() == json.size(), "Trailing data after the genesis JSON" );
+   others += '}';
+
+   genesis_state_type genesis = fc::json::from_string( others ).as<genesis_state_type>();
+   genesis.initial_accounts = std::move( streamed.initial_accounts );
+   genesis.initial_balances = std::move( streamed.initial_balances );
+   genesis.initial_vesting_balances = std::move( streamed.initial_vesting_balances );
+   return genesis;
+} FC_CAPTURE_AND_RETHROW() }
+
 } } // graphene::chain
@@ -24,7 +24,10 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/paged_index.hpp>
+#include <graphene/db/simple_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 
 namespace graphene { namespace chain {
    class database;
@@ -117,6 +120,10 @@ namespace graphene { namespace chain {
     *
     * Accounts are the primary unit of authority on the graphene system. Users must have an account in order to use
     * assets, trade in the markets, vote for committee_members, etc.
+    *
+    * The members read while paying fees and checking whitelists are declared first, so they share the leading cache
+    * lines of the object; names, authorities and vote sets follow. The serialized order is the one given to
+    * FC_REFLECT and does not depend on the declaration order.
     */
    class account_object : public graphene::db::abstract_object<account_object>
    {
@@ -149,6 +156,39 @@ namespace graphene { namespace chain {
          /// to referrer. The remainder of referral rewards goes to the registrar.
          uint16_t referrer_rewards_percentage = 0;
 
+         /// The reference implementation records the account's statistics in a separate object. This field contains the
+         /// ID of that object.
+         account_statistics_id_type statistics;
+
+         /**
+          * Vesting balance which receives cashback_reward deposits.
+          */
+         optional<vesting_balance_id_type> cashback_vb;
+
+         /**
+          * This flag is set when the top_n logic sets both authorities,
+          * and gets reset when authority or special_authority is set.
+          */
+         uint8_t top_n_control_flags = 0;
+         static const uint8_t top_n_control_owner  = 1;
+         static const uint8_t top_n_control_active = 2;
+
+         /**
+          * This is a set of all accounts which have 'whitelisted' this account. Whitelisting is only used in core
+          * validation for the purpose of authorizing accounts to hold and transact in whitelisted assets. This
+          * account cannot update this set, except by transferring ownership of the account, which will clear it. Other
+          * accounts may add or remove their IDs from this set.
+          */
+         flat_set<account_id_type> whitelisting_accounts;
+
+         /**
+          * This is a set of all accounts which have 'blacklisted' this account. Blacklisting is only used in core
+          * validation for the purpose of forbidding accounts from holding and transacting in whitelisted assets. This
+          * account cannot update this set, and it will be preserved even if the account is transferred. Other accounts
+          * may add or remove their IDs from this set.
+          */
+         flat_set<account_id_type> blacklisting_accounts;
+
          /// The account's name. This name must be unique among all account names on the graph. May not be empty.
          string name;
 
@@ -166,18 +206,6 @@ namespace graphene { namespace chain {
          typedef account_options  options_type;
          account_options options;
 
-         /// The reference implementation records the account's statistics in a separate object. This field contains the
-         /// ID of that object.
-         account_statistics_id_type statistics;
-
-         /**
-          * This is a set of all accounts which have 'whitelisted' this account. Whitelisting is only used in core
-          * validation for the purpose of authorizing accounts to hold and transact in whitelisted assets. This
-          * account cannot update this set, except by transferring ownership of the account, which will clear it. Other
-          * accounts may add or remove their IDs from this set.
-          */
-         flat_set<account_id_type> whitelisting_accounts;
-
          /**
           * Optionally track all of the accounts this account has whitelisted or blacklisted, these should
           * be made Immutable so that when the account object is cloned no deep copy is required.  This state is
@@ -193,30 +221,9 @@ namespace graphene { namespace chain {
          ///@}
 
 
-         /**
-          * This is a set of all accounts which have 'blacklisted' this account. Blacklisting is only used in core
-          * validation for the purpose of forbidding accounts from holding and transacting in whitelisted assets. This
-          * account cannot update this set, and it will be preserved even if the account is transferred. Other accounts
-          * may add or remove their IDs from this set.
-          */
-         flat_set<account_id_type> blacklisting_accounts;
-
-         /**
-          * Vesting balance which receives cashback_reward deposits.
-          */
-         optional<vesting_balance_id_type> cashback_vb;
-
          special_authority owner_special_authority = no_special_authority();
          special_authority active_special_authority = no_special_authority();
 
-         /**
-          * This flag is set when the top_n logic sets both authorities,
-          * and gets reset when authority or special_authority is set.
-          */
-         uint8_t top_n_control_flags = 0;
-         static const uint8_t top_n_control_owner  = 1;
-         static const uint8_t top_n_control_active = 2;
-
          /**
           * This is a set of assets which the account is allowed to have.
           * This is utilized to restrict buyback accounts to the assets that trade in their markets.
@@ -283,16 +290,50 @@ namespace graphene { namespace chain {
 
 
       protected:
-         set<account_id_type>  get_account_members( const account_object& a )const;
-         set<public_key_type>  get_key_members( const account_object& a )const;
-         set<address>          get_address_members( const account_object& a )const;
+         /** the accounts, keys and addresses referenced by an account, each list sorted and without duplicates */
+         struct members
+         {
+            vector<account_id_type> accounts;
+            vector<public_key_type> keys;
+            vector<address>         addresses;
+         };
+         /** fills @ref result, reusing the memory it already holds */
+         static void get_members( const authority& owner, const authority& active, const public_key_type& memo_key,
+                                  members& result );
 
-         set<account_id_type>  before_account_members;
-         set<public_key_type>  before_key_members;
-         set<address>          before_address_members;
+         /**
+          * Most modifications of an account leave its authorities and memo key alone, only those are kept before a
+          * modification so that the members are recomputed when one of them changed.
+          */
+         authority        before_owner;
+         authority        before_active;
+         public_key_type  before_memo_key;
+         members          before_members;
+         members          after_members;
    };
 
 
+   /**
+    *  @brief This secondary index counts the changes to the owner and active authorities of accounts, so that state
+    *  derived from those authorities can tell when it has gone stale.
+    */
+   class account_authority_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         /** changes whenever an account is added or removed or its owner or active authority changes */
+         uint64_t generation()const { return _generation; }
+
+      private:
+         authority _before_owner;
+         authority _before_active;
+         uint64_t  _generation = 0;
+   };
+
    /**
     *  @brief This secondary index will allow a reverse lookup of all accounts that have been referred by
     *  a particular account.
@@ -309,10 +350,86 @@ namespace graphene { namespace chain {
          map< account_id_type, set<account_id_type> > referred_by;
    };
 
+   /**
+    *  @brief This secondary index counts the positive balances held by each account, so that maintenance can
+    *  skip accounts which hold nothing without walking their balances.
+    */
+   class account_holdings_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         /** the number of assets in which the account holds a positive balance */
+         uint32_t positive_balance_count( account_id_type owner )const;
+
+      protected:
+         void adjust( account_id_type owner, int32_t delta );
+
+         /** accounts that hold nothing are not stored */
+         map< account_id_type, uint32_t > positive_balances;
+         bool before_positive = false;
+   };
+
+   /**
+    *  @brief This secondary index of the account statistics tracks the accounts whose fees wait to be paid out, so
+    *  that maintenance only processes the fees of accounts which paid any since the last maintenance.
+    */
+   class account_pending_fees_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         /** the owners of statistics with pending_fees or pending_vested_fees */
+         const set< account_id_type >& accounts_with_pending_fees()const { return pending; }
+
+      protected:
+         set< account_id_type > pending;
+   };
+
+   /** the holders of one asset, see asset_holders_index */
+   struct asset_holder_statistics
+   {
+      /** the number of accounts holding a positive balance */
+      uint64_t   holders = 0;
+      /** the sum of all balances, not counting orders, collateral or vesting balances */
+      share_type total_in_balances;
+   };
+
+   /**
+    *  @brief This secondary index keeps the number of holders and the total in balances of each asset, so that
+    *  neither needs a walk over all balances of the asset.
+    */
+   class asset_holders_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         asset_holder_statistics get_statistics( asset_id_type asset )const;
+
+      protected:
+         void adjust( asset_id_type asset, int32_t holders, share_type amount );
+
+         /** assets that nobody holds are not stored */
+         map< asset_id_type, asset_holder_statistics > statistics;
+         share_type before_balance;
+   };
+
    struct by_account_asset;
+   struct by_account_asset_hash;
    struct by_asset_balance;
    /**
     * @ingroup object_index
+    *
+    * by_account_asset_hash serves the point lookups of get_balance and adjust_balance; the ordered views remain for
+    * walking the balances of an account and the top holders of an asset.
     */
    typedef multi_index_container<
       account_balance_object,
@@ -325,6 +442,13 @@ namespace graphene { namespace chain {
                member<account_balance_object, asset_id_type, &account_balance_object::asset_type>
             >
          >,
+         hashed_unique< tag<by_account_asset_hash>,
+            composite_key<
+               account_balance_object,
+               member<account_balance_object, account_id_type, &account_balance_object::owner>,
+               member<account_balance_object, asset_id_type, &account_balance_object::asset_type>
+            >
+         >,
          ordered_unique< tag<by_asset_balance>,
             composite_key<
                account_balance_object,
@@ -338,7 +462,8 @@ namespace graphene { namespace chain {
                std::less< account_id_type >
             >
          >
-      >
+      >,
+      slab_allocator< account_balance_object >
    > account_balance_object_multi_index_type;
 
    /**
@@ -356,7 +481,8 @@ namespace graphene { namespace chain {
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_name>, member<account_object, string, &account_object::name> >
-      >
+      >,
+      slab_allocator< account_object >
    > account_multi_index_type;
 
    /**
@@ -364,6 +490,14 @@ namespace graphene { namespace chain {
     */
    typedef generic_index<account_object, account_multi_index_type> account_index;
 
+   /**
+    * @ingroup object_index
+    *
+    * The statistics of dormant accounts are paged out when object paging is enabled, see
+    * database::set_object_paging().  They are allocated on the heap so paging them out frees their memory.
+    */
+   typedef paged_index< account_statistics_object > account_statistics_index;
+
 }}
 
 FC_REFLECT_DERIVED( graphene::chain::account_object,
@@ -378,6 +512,8 @@ FC_REFLECT_DERIVED( graphene::chain::account_object,
                     (allowed_assets)
                     )
 
+FC_REFLECT( graphene::chain::asset_holder_statistics, (holders)(total_in_balances) )
+
 FC_REFLECT_DERIVED( graphene::chain::account_balance_object,
                     (graphene::db::object),
                     (owner)(asset_type)(balance) )
@@ -26,6 +26,7 @@
 #include <boost/multi_index/composite_key.hpp>
 #include <graphene/db/flat_index.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/simple_index.hpp>
 
 /**
  * @defgroup prediction_market Prediction Market
@@ -246,6 +247,7 @@ namespace graphene { namespace chain {
       >
    > asset_object_multi_index_type;
    typedef generic_index<asset_object, asset_object_multi_index_type> asset_index;
+   typedef simple_index<asset_dynamic_data_object> asset_dynamic_data_index;
 
 } } // graphene::chain
 
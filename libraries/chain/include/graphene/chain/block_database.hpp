@@ -22,13 +22,81 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <graphene/chain/protocol/block.hpp>
 
 namespace graphene { namespace chain {
+   struct index_entry;
+
+   /**
+    * Describes how the blocks of a block_database are laid out on disk.  It is written to the
+    * "layout" file when the database is created; databases without that file use the original
+    * layout, a single "blocks" file.
+    */
+   struct block_storage_layout
+   {
+      /** number of blocks per "blocks.NNNNNN" segment file, 0 stores every block in one "blocks" file */
+      uint32_t segment_size = 0;
+   };
+
    class block_database 
    {
       public:
+         ~block_database();
+
+         /**
+          * When enabled, lookups read the index and blocks files through read-only memory mappings
+          * instead of the shared streams, so they are reduced to pointer arithmetic and may be called
+          * from several threads at once.  Writes still go through the streams and are flushed as they
+          * happen so the mappings can see them.  Must be set before open().
+          */
+         void set_memory_mapped( bool enabled );
+         bool is_memory_mapped()const { return _memory_mapped; }
+
+         /**
+          * Split the blocks of a newly created database into one file per segment_size blocks, so old
+          * segments can be moved to other storage and linked back.  Has no effect on an existing
+          * database, whose layout is read from disk.  Must be set before open().
+          */
+         void set_segment_size( uint32_t segment_size );
+         uint32_t segment_size()const { return _layout.segment_size; }
+
+         /**
+          * zlib level (1-9) used to deflate blocks when they are stored, 0 stores them uncompressed.
+          * Every block records whether it was compressed, so the level may change between runs.
+          */
+         void set_compression_level( int level );
+
+         /**
+          * Hand stored blocks to a writer thread instead of writing them on the calling thread.  Lookups
+          * find queued blocks as if they were already written, remove() and flush() wait for the queue to
+          * drain first.  The files are flushed after every flush_interval written blocks, and once the
+          * blocks up to the one passed to flush_through() are written.  0 writes every block as it is
+          * stored.  Must be set before open().
+          */
+         void set_write_behind( uint32_t flush_interval );
+         uint32_t write_behind()const { return _write_behind_interval; }
+
+         /** asks the writer thread to flush the files as soon as block_num and the blocks before it are written */
+         void flush_through( uint32_t block_num );
+
+         /**
+          * Delete the segments whose blocks are all older than block_num.  Their index entries are kept,
+          * so fetch_block_id() and contains() still answer for pruned blocks while fetching them finds
+          * nothing.  A database without segments can not be pruned and is left alone.
+          */
+         void prune_before( uint32_t block_num );
+         /** @return true if block_num was stored in a segment that has been pruned */
+         bool is_pruned( uint32_t block_num )const;
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -36,15 +104,121 @@ namespace graphene { namespace chain {
 
          void store( const block_id_type& id, const signed_block& b );
          void remove( const block_id_type& id );
+         /**
+          * Removes every block after block_num like remove() would, with a write to the index per chunk of entries.
+          * @return the number of blocks removed
+          */
+         uint32_t remove_after( uint32_t block_num );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
+         /**
+          * @return the ids of up to count consecutive blocks starting at first_block_num, read from the
+          * index in one go.  The result stops short at the first block that is not stored.
+          */
+         vector<block_id_type>  fetch_block_ids( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /** @return the block as fc::raw packed it, read from disk without unpacking it */
+         optional<vector<char>> fetch_packed_by_number( uint32_t block_num )const;
+         /** @return the block as fc::raw packed it, read from disk without unpacking it, if it is the block with this id */
+         optional<vector<char>> fetch_block_bytes( const block_id_type& id )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+
+         /** bytes of the entry of one block in the "index" file, which holds the entry of block n at n times this */
+         static const size_t index_entry_size;
+         /** the name of the file of a segment in a database with segments */
+         static std::string segment_file_name( uint32_t segment );
+         /**
+          * Unpacks the blocks first_block_num to last_block_num from copies of the files of another database with
+          * segments, as a bootstrap downloads them from a mirror: @ref index holds their entries of its "index"
+          * file, @ref segment the bytes of the segment file they are all stored in from @ref segment_offset on.
+          * Checks every block is the one its entry names.
+          */
+         static vector<signed_block> read_segment_copy( uint32_t first_block_num, uint32_t last_block_num,
+                                                        const vector<char>& index, const vector<char>& segment,
+                                                        uint64_t segment_offset = 0 );
+         /** the bytes [first, second) of the segment file the blocks of read_segment_copy() are stored in */
+         static std::pair<uint64_t, uint64_t> segment_copy_span( uint32_t first_block_num, uint32_t last_block_num,
+                                                                 const vector<char>& index );
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         struct queued_block
+         {
+            uint32_t      num;
+            block_id_type id;
+            signed_block  block;
+         };
+         typedef std::shared_ptr<const queued_block> queued_block_ptr;
+
+         /** packs b and appends it to the files, the caller holds _stream_mutex */
+         void             write_block( const block_id_type& id, const signed_block& b );
+         void             flush_streams();
+         void             write_queued_blocks();
+         /** waits until the writer thread has written every queued block, and rethrows its error if it failed */
+         void             drain_write_queue()const;
+         void             stop_writer();
+         queued_block_ptr find_queued( uint32_t block_num )const;
+         queued_block_ptr last_queued()const;
+
+         struct mapped_file;
+         typedef std::shared_ptr<const mapped_file> mapped_file_ptr;
+
+         /** @return a mapping of at least required bytes, or the largest mapping available if the file is shorter */
+         mapped_file_ptr map_file( mapped_file_ptr& mapping, const fc::path& path, uint64_t required )const;
+         uint32_t        segment_of( uint32_t block_num )const;
+         fc::path        segment_path( uint32_t segment )const;
+         /** @param create makes the file of @ref segment when it is missing, which only writing may do */
+         std::fstream&   segment_stream( uint32_t segment, bool create = false )const;
+         bool            read_index_entry( uint32_t block_num, index_entry& e )const;
+         /** reads up to count consecutive index entries into entries, @return how many there were */
+         uint32_t        read_index_entries( uint32_t first_block_num, uint32_t count, index_entry* entries )const;
+         bool            read_last_index_entry( index_entry& e )const;
+         /** @return the number of the last stored block before block number end, 0 if there is none */
+         uint32_t        find_last_entry( uint32_t end )const;
+         /** @return true if the block of @ref e can be read back and is the block the entry names */
+         bool            is_intact( const index_entry& e )const;
+         /** drops the index entries of blocks a crash left incompletely written, and finds the last block */
+         void            recover_tail();
+         /** calls @ref reader with the packed block of @ref e, inflated if it was stored compressed */
+         void            read_stored_block( const index_entry& e,
+                                            const std::function<void(const char* packed, size_t size)>& reader )const;
+         signed_block    read_block( const index_entry& e )const;
+         /** @return the packed block of @ref e, after checking its header still matches the index */
+         vector<char>    read_packed_block( const index_entry& e )const;
+
+         mutable std::map<uint32_t, std::unique_ptr<std::fstream>> _segments;
+         mutable std::fstream                                      _block_num_to_pos;
+
+         fc::path                _dir;
+         fc::path                _index_path;
+         block_storage_layout    _layout;
+         uint32_t                _new_segment_size  = 0;
+         /** the segments before this one have been pruned */
+         std::atomic<uint32_t>   _first_segment{ 0 };
+         int                     _compression_level = 0;
+         /** the number of the last block in the index, so the tail needs no search */
+         std::atomic<uint32_t>   _last_entry{ 0 };
+
+         bool                                        _memory_mapped = false;
+         mutable std::mutex                          _map_mutex;
+         mutable mapped_file_ptr                     _index_map;
+         mutable std::map<uint32_t, mapped_file_ptr> _segment_maps;
+
+         /** serializes the use of the streams between the writer thread and lookups */
+         mutable std::mutex                          _stream_mutex;
+
+         uint32_t                                    _write_behind_interval = 0;
+         std::thread                                 _writer;
+         mutable std::mutex                          _queue_mutex;
+         mutable std::condition_variable             _queue_changed;
+         /** the last block stored at each number that the writer thread has not written yet */
+         std::map<uint32_t, queued_block_ptr>        _queued;
+         bool                                        _writing       = false;
+         bool                                        _stop_writing  = false;
+         uint32_t                                    _flush_through = 0;
+         std::exception_ptr                          _write_error;
    };
 } }
+
+FC_REFLECT( graphene::chain::block_storage_layout, (segment_size) )
@@ -26,21 +26,37 @@
 #include <graphene/chain/node_property_object.hpp>
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/signature_key_cache.hpp>
+#include <graphene/chain/vote_ledger.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
+#include <graphene/chain/observer_list.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/simple_index.hpp>
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/executor.hpp>
 #include <fc/signals.hpp>
 
 #include <graphene/chain/protocol/protocol.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
 
 namespace graphene { namespace chain {
    using graphene::db::abstract_object;
@@ -50,6 +66,217 @@ namespace graphene { namespace chain {
 
    struct budget_record;
 
+   /**
+    * Describes a state snapshot written by database::export_state_snapshot(), stored next to the
+    * object database files as snapshot.json.
+    */
+   struct state_snapshot_info
+   {
+      uint32_t      block_num = 0;
+      block_id_type block_id;
+      chain_id_type chain_id;
+      fc::sha256    state_hash;   ///< object_database::state_hash() at block_num
+   };
+
+   /**
+    * The result of replaying the blocks between two snapshots in database::verify_replay().  The range
+    * starts from the state of the snapshot at from_block and ends at to_block, where the state hash of the
+    * replayed state is compared with the one recorded by the snapshot taken there.
+    */
+   struct replay_range_verification
+   {
+      uint32_t      from_block = 0;
+      uint32_t      to_block   = 0;
+      fc::sha256    expected_state_hash;
+      fc::sha256    actual_state_hash;
+      bool          matches    = false;
+      string        error;              ///< why the range could not be replayed, empty if it was
+      int64_t       elapsed_time = 0;   ///< microseconds
+   };
+
+   /**
+    * Throughput report of the last database::replay_blocks() run, i.e. of reindex() or
+    * reindex_from_snapshot().  Times are in microseconds.  io_wait_time is spent waiting for blocks
+    * to be read from the block log, apply_time inside apply_block() and maintenance_time, which is a
+    * part of apply_time, in perform_chain_maintenance().  Undo history is disabled while replaying.
+    * The remaining times split apply_time like the phases of block_timing, signature_time is only
+    * spent when the replay skip flags leave transaction signatures to be checked.
+    */
+   struct replay_statistics
+   {
+      uint32_t                     first_block       = 0;
+      uint32_t                     last_block        = 0;
+      uint64_t                     blocks            = 0;
+      uint64_t                     transactions      = 0;
+      uint64_t                     operations        = 0;
+      flat_map<string,uint64_t>    operations_by_type;
+
+      int64_t                      elapsed_time      = 0;
+      int64_t                      io_wait_time      = 0;
+      int64_t                      apply_time        = 0;
+      int64_t                      maintenance_time  = 0;
+      int64_t                      signature_time    = 0;
+      int64_t                      header_time       = 0;
+      int64_t                      transaction_time  = 0;
+      int64_t                      chain_update_time = 0;
+      int64_t                      handler_time      = 0;
+      uint32_t                     skip_flags        = 0;
+
+      double                       blocks_per_second       = 0;
+      double                       transactions_per_second = 0;
+      double                       operations_per_second   = 0;
+   };
+
+   /**
+    * Cost of applying one operation type, see database::set_operation_statistics().  Times are in
+    * microseconds and include the operations executed by proposals of this type.  fee_time is the part of
+    * evaluate_time and apply_time spent in prepare_fee() and convert_fee().  The object counts are the
+    * calls to the undo database hooks.
+    */
+   struct operation_statistics
+   {
+      uint64_t    count             = 0;
+      int64_t     evaluate_time     = 0;
+      int64_t     max_evaluate_time = 0;
+      int64_t     apply_time        = 0;
+      int64_t     max_apply_time    = 0;
+      int64_t     fee_time          = 0;
+      uint64_t    objects_created   = 0;
+      uint64_t    objects_modified  = 0;
+      uint64_t    objects_removed   = 0;
+   };
+
+   /**
+    * Time spent in each phase of pushing one block, in microseconds.  signatures is the parallel key recovery
+    * before the block is applied, transactions includes the signature recovery left to it.  chain_updates
+    * covers the state updates from update_global_dynamic_data() to update_witness_schedule() apart from
+    * maintenance, handlers the applied_block and changed objects observers, i.e. the plugins.  Blocks applied
+    * while switching forks add up.  allocations are the heap allocations by phase since the previous block was
+    * pushed, those of the API calls and pending transactions in between included; they are only counted in a build
+    * with GRAPHENE_ALLOCATION_STATS, see graphene::utilities::allocation_stats.
+    */
+   struct block_timing
+   {
+      uint32_t    block_num     = 0;
+      uint32_t    transactions  = 0;
+      int64_t     fork_db       = 0;
+      int64_t     header        = 0;
+      int64_t     signatures    = 0;
+      int64_t     apply_transactions = 0;
+      int64_t     chain_updates = 0;
+      int64_t     maintenance   = 0;
+      int64_t     handlers      = 0;
+      int64_t     total         = 0;
+      std::map<std::string, graphene::utilities::allocation_counts> allocations;
+   };
+
+   /** Distribution of a duration, buckets[i] counts the durations of less than 2^i microseconds not counted before */
+   struct latency_histogram
+   {
+      uint64_t          count   = 0;
+      int64_t           total   = 0;
+      int64_t           max     = 0;
+      vector<uint64_t>  buckets;
+
+      void add( int64_t microseconds )
+      {
+         size_t bucket = 0;
+         while( bucket < 40 && (int64_t(1) << bucket) <= microseconds )
+            ++bucket;
+         if( buckets.size() <= bucket )
+            buckets.resize( bucket + 1 );
+         ++buckets[bucket];
+         ++count;
+         total += microseconds;
+         max = std::max( max, microseconds );
+      }
+   };
+
+   /** The block_timing phases of all pushed blocks, see database::get_block_timing_statistics() */
+   struct block_timing_statistics
+   {
+      latency_histogram  fork_db;
+      latency_histogram  header;
+      latency_histogram  signatures;
+      latency_histogram  apply_transactions;
+      latency_histogram  chain_updates;
+      latency_histogram  maintenance;
+      latency_histogram  handlers;
+      latency_histogram  total;
+      uint64_t           slow_blocks = 0;  ///< blocks that took longer than the slow block threshold
+      block_timing       last_slow_block;
+
+      void add( const block_timing& timing );
+   };
+
+   /** Size and counters of the pending transaction pool, see database::get_pending_pool_statistics() */
+   struct pending_pool_statistics
+   {
+      uint32_t    transactions  = 0;  ///< transactions currently pending
+      uint64_t    size          = 0;  ///< their packed size in bytes
+      uint32_t    capacity      = 0;  ///< the most transactions the pool takes, 0 for no limit
+      uint64_t    rejected      = 0;  ///< transactions refused because the pool was full
+      uint64_t    postponed     = 0;  ///< times a pending transaction was left for a later block for lack of space
+      uint64_t    carried_over  = 0;  ///< times a pending transaction was kept after a block without applying it again
+      uint64_t    reapplied     = 0;  ///< times a pending transaction was applied again after a block
+   };
+
+   /**
+    * What applying a pending transaction read and changed.  After a block that changed none of it, the changes are
+    * made again instead of applying the transaction again, see database::push_block().
+    */
+   struct pending_transaction_footprint
+   {
+      /** the head block the transaction was applied on */
+      block_id_type           applied_on;
+      /** the objects it looked up by id, sorted */
+      vector<object_id_type>  reads;
+      /** the indexes it read otherwise, as (space, type, 0) and sorted */
+      vector<object_id_type>  index_reads;
+      /** the objects it created, modified and removed, without its transaction_object */
+      db::object_diff         changes;
+      /** whether it created a transaction_object for the dupe check */
+      bool                    dupe_checked = false;
+      /** false if its changes cannot be made again, e.g. it changed objects that every block changes */
+      bool                    reusable = false;
+   };
+
+   /** How the transactions of the last block put together by this node were picked, see database::assemble_block() */
+   struct block_assembly
+   {
+      uint32_t    pending       = 0;  ///< pending transactions when the block was assembled
+      uint32_t    included      = 0;  ///< transactions that went into the block
+      uint32_t    postponed     = 0;  ///< pending transactions left for a later block for lack of space
+      uint32_t    failed        = 0;  ///< pending transactions that no longer applied
+      bool        reapplied     = false; ///< whether the transactions were applied again instead of taking the pending state
+   };
+
+   /** A block together with the objects applying it changed, see database::set_state_diff_history() */
+   struct block_state_diff
+   {
+      signed_block     block;
+      db::object_diff  objects;
+      /** object_database::state_hash() after the block, zero when the node recording it kept no state hashes */
+      fc::sha256       state_hash;
+   };
+
+   /** The state hash after a block, see database::set_state_hash_history() */
+   struct block_state_hash
+   {
+      uint32_t      block_num = 0;
+      block_id_type block_id;
+      fc::sha256    state_hash;
+   };
+
+   /** The outcome of one transaction passed to database::push_transactions() */
+   struct transaction_admission
+   {
+      optional<processed_transaction> trx;    ///< the transaction as applied to the pending state, if it was accepted
+      optional<fc::exception>         error;  ///< why the transaction was rejected otherwise
+   };
+
+   namespace detail { struct pending_transactions_restorer; }
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -102,6 +329,239 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
 
+         /**
+          * @brief Read and hash blocks ahead of the replay in reindex()
+          *
+          * With a depth > 0 one thread reads and unpacks up to depth blocks ahead of the block being applied
+          * and a second one checks their transaction merkle roots, so only apply_block() runs on the replay
+          * thread.  A depth of 0 replays serially.
+          */
+         void set_replay_prefetch_depth( uint32_t depth ) { _replay_prefetch_depth = depth; }
+
+         /**
+          * @brief Look up the objects the next transactions of a block pay their fees with ahead of applying them
+          *
+          * While a block is applied, the fee paying accounts, their statistics and balances and the dynamic data
+          * of the fee assets of the transactions depth ahead of the one being applied are found and prefetched into
+          * the cache, so their misses overlap with the work on the transactions before them.  0 (the default)
+          * applies the transactions without looking ahead.
+          */
+         void set_transaction_prefetch_depth( uint32_t depth ) { _transaction_prefetch_depth = depth; }
+
+         /**
+          * @brief The skip flags blocks are applied with by reindex() and reindex_from_snapshot()
+          *
+          * The default skips signatures, authorities and the other checks a block from our own block log has
+          * already passed.  Clearing flags replays with those checks, e.g. to measure their cost.
+          */
+         void set_replay_skip_flags( uint32_t skip ) { _replay_skip_flags = skip; }
+         uint32_t get_replay_skip_flags()const { return _replay_skip_flags; }
+
+         /**
+          * @brief Save the state at the head block to dir so other nodes can start from it
+          *
+          * Pending transactions are excluded.  The returned description, also written to dir/snapshot.json,
+          * carries the state hash that has to be published for reindex_from_snapshot().
+          */
+         state_snapshot_info export_state_snapshot( const fc::path& dir );
+
+         /**
+          * @brief Rebuild the object graph from a snapshot instead of from genesis and open the database
+          *
+          * The snapshot in snapshot_dir is only accepted if its recorded and recomputed state hashes equal
+          * trusted_state_hash and its head block is part of the chain in the block log.  Only the blocks after
+          * the snapshot are replayed.
+          */
+         void reindex_from_snapshot( fc::path data_dir, const fc::path& snapshot_dir, const fc::sha256& trusted_state_hash );
+
+         /**
+          * @brief Check that the block log reproduces the states recorded by a series of snapshots
+          *
+          * The snapshots are ordered by block number and every two consecutive ones delimit a range of blocks.
+          * Each range is replayed from its first snapshot in a database of its own under work_dir, up to
+          * thread_count ranges at a time, and the state hash after its last block is compared with the one of
+          * the snapshot taken there.  A snapshot exported at block 0 lets the ranges cover the chain from
+          * genesis.  The first snapshot has to match trusted_state_hash if one is given; every later one is
+          * vouched for by the range ending at it, so the chain is verified once every range matches.
+          *
+          * The block log in blockchain_dir is only read and this database is left alone, the replays use its
+          * prefetch depth and skip flags.
+          */
+         vector<replay_range_verification> verify_replay( const fc::path& blockchain_dir,
+                                                          const vector<fc::path>& snapshot_dirs,
+                                                          const optional<fc::sha256>& trusted_state_hash,
+                                                          const fc::path& work_dir,
+                                                          uint32_t thread_count )const;
+
+         /**
+          * @brief A private copy of the state to try transactions on
+          *
+          * The copy holds every chain object as it is now, the changes of the pending transactions included, but
+          * no block log, fork database or plugin indexes.  Transactions pushed to it, e.g. to estimate fees or see
+          * which orders would fill, and clear_pending() on it never touch this database, so several copies can be
+          * used at once, each on its own thread, and dropped when done.  Copying walks every object, so call it on
+          * the thread applying blocks or inside with_read_lock().
+          */
+         std::unique_ptr<database> fork_state()const;
+
+         /**
+          * @brief Recover the signature keys of a pushed block's transactions on this many threads
+          *
+          * push_block() then hands every transaction to a worker before applying the block, so applying it
+          * only walks the authorities.  The same workers validate the operations of every transaction of
+          * an applied block side by side before the block's state changes are made in order.  At maintenance
+          * they also tally the votes of their share of the accounts, and they run prevalidate_block().  0 (the
+          * default) does all of this on the calling thread.
+          *
+          * With @ref shared the work runs as up to this many tasks at a time on that executor instead of threads of
+          * its own, the executor must outlive its use here, call again without it first.
+          */
+         void set_signature_threads( uint32_t threads, graphene::utilities::executor* shared = nullptr );
+
+         /**
+          * @brief Check the merkle root and recover the signature keys of a block that will be pushed later
+          *
+          * Meant for the blocks received during sync, which arrive well before the blocks before them are
+          * applied.  The checks run on a signature thread without waiting and only depend on the block, so
+          * this may be called from any thread.  push_block() then finds the keys in the signature key cache and
+          * skips the merkle root of a block found correct here.  Anything wrong with the block is reported
+          * when it is pushed.
+          *
+          * @param skip the skip flags the block will be pushed with
+          * @return false if the block was not queued, because there are no signature threads or
+          *         max_prevalidated_blocks blocks are queued already
+          */
+         bool prevalidate_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /** waits until the blocks queued by prevalidate_block() are done */
+         void wait_for_prevalidated_blocks();
+         static const uint32_t max_prevalidated_blocks = 500;
+
+         /**
+          * @brief Make the checks of a transaction that do not depend on the state before it is pushed
+          *
+          * Meant for the transactions received from the network.  trx is validated, its size and expiration are
+          * checked against the chain parameters and the head block time after the last applied block, and its
+          * signature keys are recovered, which trx then keeps for push_transaction().  The checks run on a
+          * signature thread the caller waits for, or on the calling thread without signature threads, so this
+          * may be called from any thread.
+          *
+          * @param skip the skip flags trx will be pushed with
+          * @throws fc::exception if trx fails a check and is not worth pushing
+          */
+         void prevalidate_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
+
+         /**
+          * @brief Call @ref reader from a thread other than the one applying blocks
+          *
+          * push_block(), push_transaction(), generate_block() and the other calls that modify the state hold a
+          * lock that this waits for, so @ref reader sees the state between two of them and the state does not
+          * change until it returns.  Any number of readers run at once.  The thread modifying the state must not
+          * call this, it reads without a lock.
+          */
+         template<typename Reader>
+         auto with_read_lock( Reader&& reader )const -> decltype( reader() )
+         {
+            boost::shared_lock<boost::shared_mutex> lock( _state_mutex );
+            return reader();
+         }
+
+         /**
+          * @brief Recount all votes at every maintenance and compare the recount with the vote ledger
+          *
+          * Maintenance usually only recounts the accounts that changed since the last one, see vote_ledger.
+          * With this set a mismatch is logged, counted and the full recount is used instead.
+          */
+         void set_vote_tally_check( bool check ) { _check_vote_tally = check; }
+         /** number of maintenance intervals at which the vote ledger did not match the full recount */
+         uint32_t get_vote_tally_mismatches()const { return _vote_tally_mismatches; }
+         /**
+          * @brief Count the votes that changed in each of the last @ref blocks blocks before a maintenance interval
+          *
+          * The vote ledger then has little more than the changes of the maintenance block itself left to count, which
+          * keeps the maintenance block short.  Accounts that change after they were counted are counted again, so the
+          * totals are the same as without it.  0 leaves all counting to the maintenance block.
+          */
+         void set_maintenance_precount_blocks( uint32_t blocks ) { _maintenance_precount_blocks = blocks; }
+         /**
+          * Move the statistics of accounts that were not used during @ref idle_blocks blocks out of memory to a page
+          * file in the database directory, after every block, see paged_index.  0 keeps every object in memory.
+          * Must be set before open().
+          */
+         void set_object_paging( uint32_t idle_blocks ) { _object_paging_idle_blocks = idle_blocks; }
+
+         /** keep the recovered keys of up to this many signatures around, see signature_key_cache */
+         void set_signature_cache_size( size_t size ) { _signature_key_cache.set_capacity( size ); }
+         const signature_key_cache& get_signature_key_cache()const { return _signature_key_cache; }
+         /** the verdicts of is_authorized_asset() for whitelisted assets, kept current by the account and asset indexes */
+         authorized_asset_cache& get_authorized_asset_cache()const { return _authorized_asset_cache; }
+
+         /**
+          * trx.validate(), remembering the transactions with confidential operations that passed: checking
+          * their commitments is expensive, and the same transaction is validated on admission, again when it
+          * arrives in a block and whenever the pending state is rebuilt.  May be called from several threads, it
+          * does not look at the state; validate_transaction() applies the transaction to it instead.
+          */
+         void validate_transaction_stateless( const signed_transaction& trx )const;
+
+         /** limit the packed size of the reversible and forked blocks kept in the fork database, 0 for no limit */
+         void set_fork_db_max_memory( size_t bytes ) { _fork_db.set_max_memory( bytes ); }
+
+         /**
+          * @brief Limit the pending transaction pool to this many transactions, 0 (the default) for no limit
+          *
+          * Transactions pushed while the pool is full are refused with pending_pool_full.  Blocks generated
+          * from a pool that does not fit into one block take the transactions with the highest fee per byte
+          * first.
+          */
+         void set_max_pending_transactions( uint32_t count ) { _max_pending_tx = count; }
+         size_t pending_transaction_count()const { return _pending_tx.size(); }
+
+         /**
+          * Keep a copy of every transaction of a recent block in its transaction_object (the default).  Without
+          * the copies, get_recent_transaction() reads transactions back from the block log.
+          */
+         void set_keep_transaction_bodies( bool keep ) { _keep_transaction_bodies = keep; }
+         pending_pool_statistics get_pending_pool_statistics()const;
+
+         /**
+          * @brief Log the block_timing of every pushed block that takes longer than this, 0 (the default) never does
+          */
+         void set_slow_block_threshold( fc::microseconds threshold ) { _slow_block_threshold = threshold; }
+         /**
+          * @brief Log the object_database::get_index_statistics() every @ref blocks blocks, 0 (the default) never does
+          */
+         void set_index_statistics_interval( uint32_t blocks ) { _index_statistics_interval = blocks; }
+         /**
+          * @brief Report the objects changed by pending transactions at most once per @ref interval
+          *
+          * The changes are collected and emitted by changed_objects together, each object once, when a transaction
+          * is pushed after the interval has passed and at the end of every block, so an object changed by several
+          * pending transactions and then by the block including them is reported once.  An interval of at least the
+          * block interval reports once per block.  0 (the default) reports every push right away.
+          */
+         void set_change_notification_interval( fc::microseconds interval ) { _change_notification_interval = interval; }
+         /** @return the phases of the last pushed block */
+         const block_timing& get_last_block_timing()const { return _last_block_timing; }
+         /** @return the histograms of the phases of all pushed blocks since the database was created */
+         const block_timing_statistics& get_block_timing_statistics()const { return _block_timing_statistics; }
+         /** @return how the transactions of the last block generated or assembled here were picked */
+         const block_assembly& get_last_block_assembly()const { return _last_block_assembly; }
+
+         /** @return the throughput report of the last replay, which is also logged when the replay ends */
+         const replay_statistics& get_replay_statistics()const { return _replay_statistics; }
+
+         /**
+          * @brief Measure every applied operation by type, off by default
+          *
+          * Enabling starts the statistics over.  While they are disabled apply_operation() only tests a flag.
+          */
+         void set_operation_statistics( bool enabled );
+         bool operation_statistics_enabled()const { return _operation_statistics_enabled; }
+         /** @return the statistics of the operation types applied since they were enabled, by type name */
+         flat_map<string,operation_statistics> get_operation_statistics()const;
+         /** the statistics of the operation being applied, null while the statistics are disabled */
+         operation_statistics* current_operation_statistics()const { return _current_operation_statistics; }
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -111,6 +571,49 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Write an object database changelog checkpoint every interval blocks
+          *
+          * After a crash, open() loads the last full snapshot, replays the changelog and then applies the
+          * few blocks from the block log that are newer than the last checkpoint instead of replaying the
+          * entire chain.  Once the changelog grows beyond max_changelog_size bytes it is compacted into the
+          * snapshot with a full flush.  An interval of 0 disables checkpoints.
+          */
+         void set_checkpoint_interval( uint32_t interval, uint64_t max_changelog_size = 256*1024*1024 );
+
+         /**
+          * @brief Serve block log lookups from memory mapped files so they can run concurrently
+          *
+          * Must be called before open(), see block_database::set_memory_mapped().
+          */
+         void set_block_log_memory_mapped( bool enabled );
+
+         /**
+          * @brief Configure segmentation and compression of the block log
+          *
+          * The segment size only applies when a new block log is created, see block_database::set_segment_size().
+          * The compression level applies to blocks stored from now on.  Must be called before open().
+          */
+         void set_block_log_storage( uint32_t segment_size, int compression_level );
+
+         /**
+          * @brief Write new blocks to the block log on a separate thread
+          *
+          * The block log is flushed every flush_interval blocks and whenever the last irreversible block
+          * advances, 0 writes blocks on the calling thread.  Must be called before open(), see
+          * block_database::set_write_behind().
+          */
+         void set_block_log_write_behind( uint32_t flush_interval );
+
+         /**
+          * @brief Keep only the blocks of the last blocks irreversible blocks in the block log
+          *
+          * Older segments are deleted as the last irreversible block advances, the index still maps their
+          * numbers to ids.  Only a block log with segments can be pruned, and a pruned block log can not
+          * be replayed from the genesis state.  0 keeps every block.
+          */
+         void set_block_retention( uint32_t blocks ) { _block_retention = blocks; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -120,9 +623,15 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /** @return the ids of up to count consecutive blocks from first_block_num, stopping at the first one we don't have */
+         vector<block_id_type>      get_block_ids_for_nums( uint32_t first_block_num, uint32_t count )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
-         const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
+         /** @return the block as fc::raw packed it, irreversible blocks are read from disk without unpacking them */
+         optional<vector<char>>     fetch_packed_block_by_number( uint32_t num )const;
+         /** @return the block as fc::raw packed it, irreversible blocks are read from disk without unpacking them */
+         optional<vector<char>>     fetch_packed_block_by_id( const block_id_type& id )const;
+         signed_transaction         get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
          /**
@@ -137,7 +646,25 @@ namespace graphene { namespace chain {
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
+         /**
+          * Pushes a batch of transactions to the pending state in order.  A transaction that fails to apply is
+          * rejected on its own as with push_transaction(), the others are still accepted.  The batch shares a
+          * single undo session and a single changed_objects notification, on_pending_transaction is emitted
+          * for each accepted transaction.
+          *
+          * @return one result for each of trxs, in the same order
+          */
+         vector<transaction_admission> push_transactions( const vector<signed_transaction>& trxs, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
+         /**
+          * Recovers and caches the signature keys of every transaction on the signature threads, so applying
+          * them afterwards only checks authorities.  Does nothing without signature threads.
+          */
+         void precompute_signature_keys( const signed_block& b );
+         void precompute_signature_keys( const std::deque<signed_transaction>& trxs );
+         void precompute_signature_keys( const vector<processed_transaction>& trxs );
+         /** the signature keys of trx, recovered through the signature key cache */
+         const flat_set<public_key_type>& recover_signature_keys( const signed_transaction& trx )const;
          processed_transaction _push_transaction( const signed_transaction& trx );
 
          ///@throws fc::exception if the proposed transaction fails to apply.
@@ -155,9 +682,58 @@ namespace graphene { namespace chain {
             const fc::ecc::private_key& block_signing_private_key
             );
 
+         /**
+          * @brief Put together the block witness_id would produce at when, without signing or pushing it
+          *
+          * Lets a witness do the work of picking the transactions ahead of its slot, sign_and_push_block() then
+          * completes the block at the slot time.  The pending state is left as it was.
+          */
+         signed_block assemble_block(
+            const fc::time_point_sec when,
+            witness_id_type witness_id,
+            uint32_t skip
+            );
+         /** sign a block from assemble_block() and push it, the head block must still be the one it builds on */
+         signed_block sign_and_push_block(
+            signed_block candidate,
+            const fc::ecc::private_key& block_signing_private_key,
+            uint32_t skip
+            );
+
          void pop_block();
          void clear_pending();
 
+         /**
+          * @brief Remember the object changes of the last blocks blocks so followers can copy the state
+          *
+          * Every block pushed records the objects it created, modified and removed, including those of the
+          * plugins, taken from its undo state.  0 (the default) records nothing.
+          */
+         void set_state_diff_history( uint32_t blocks ) { _state_diff_history = blocks; }
+         /** @return the recorded state diffs of the consecutive irreversible blocks starting at first_block_num */
+         vector<block_state_diff> get_state_diffs( uint32_t first_block_num, uint32_t count )const;
+         /**
+          * @brief Make the head block the one of diff by applying its object changes instead of evaluating it
+          *
+          * The block is stored in the block log and announced through applied_block, which has no applied
+          * operations to offer.  diff must come from a node running the same plugins for their objects to
+          * be copied, the objects of indexes this node does not have are dropped.
+          */
+         void apply_state_diff( const block_state_diff& diff );
+
+         /**
+          * @brief Remember the state hash after each of the last blocks blocks
+          *
+          * This keeps the object_database::state_hash() current as objects change instead of hashing every object,
+          * which costs two object hashes per change.  Nodes on the same chain with the same plugins have the same
+          * hash after the same block, so comparing them finds a divergence at the block it happens.  Recorded state
+          * diffs carry the hash, and apply_state_diff() logs a replica that does not reach it.  0 (the default)
+          * keeps none and hashes the state on demand only.
+          */
+         void set_state_hash_history( uint32_t blocks );
+         /** @return the state hash after block_num, if it is one of the last blocks of set_state_hash_history() */
+         optional<block_state_hash> get_block_state_hash( uint32_t block_num )const;
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -168,8 +744,16 @@ namespace graphene { namespace chain {
           *  @return the op_id which can be used to set the result after it has finished being applied.
           */
          uint32_t  push_applied_operation( const operation& op );
+         /** virtual operations are usually built just for this call, those are moved instead of copied */
+         uint32_t  push_applied_operation( operation&& op );
          void      set_applied_operation_result( uint32_t op_id, const operation_result& r );
          const vector<optional< operation_history_object > >& get_applied_operations()const;
+         /**
+          * The ids of the transactions of the block being or last applied, in block order, so observers of
+          * applied_block need not hash them again.  Blocks applied without the dupe check leave some of them out;
+          * the list is then shorter than the block's transactions.
+          */
+         const vector<transaction_id_type>& get_applied_transaction_ids()const { return _applied_trx_ids; }
 
          string to_pretty_string( const asset& a )const;
 
@@ -181,24 +765,33 @@ namespace graphene { namespace chain {
           *  the write lock and may be in an "inconstant state" until after it is
           *  released.
           */
-         fc::signal<void(const signed_block&)>           applied_block;
+         observer_list<const signed_block&>              applied_block;
 
          /**
           * This signal is emitted any time a new transaction is added to the pending
           * block state.
           */
-         fc::signal<void(const signed_transaction&)>     on_pending_transaction;
+         observer_list<const signed_transaction&>        on_pending_transaction;
 
          /**
           *  Emitted After a block has been applied and committed.  The callback
           *  should not yield and should execute quickly.
           */
-         fc::signal<void(const vector<object_id_type>&)> changed_objects;
+         observer_list<const vector<object_id_type>&>    changed_objects;
 
          /** this signal is emitted any time an object is removed and contains a
           * pointer to the last value of every object that was removed.
           */
-         fc::signal<void(const vector<const object*>&)>  removed_objects;
+         observer_list<const vector<const object*>&>     removed_objects;
+
+         /**
+          *  Emitted by pop_block() before the changes of the popped head block are undone, the head state of the
+          *  undo database still holds the values the objects had before the block.
+          */
+         observer_list<const signed_block&>              popping_block;
+
+         /** the observers of each of the events above by the name of the event, with their calls and time */
+         std::map< string, vector<observer_statistics> > get_observer_statistics()const;
 
          //////////////////// db_witness_schedule.cpp ////////////////////
 
@@ -266,6 +859,12 @@ namespace graphene { namespace chain {
          void initialize_evaluators();
          /// Reset the object graph in-memory
          void initialize_indexes();
+         /**
+          * Drops the secondary indexes only the database_api reads, account_member_index, account_referrer_index and
+          * required_approval_index, to save their memory and upkeep on nodes that serve no queries.  Call it before
+          * open(); the API calls that need those indexes fail afterwards.
+          */
+         void disable_api_indexes();
          void init_genesis(const genesis_state_type& genesis_state = genesis_state_type());
 
          template<typename EvaluatorType>
@@ -370,6 +969,12 @@ namespace graphene { namespace chain {
          bool fill_order( const call_order_object& order, const asset& pays, const asset& receives );
          bool fill_order( const force_settlement_object& settle, const asset& pays, const asset& receives );
 
+         /**
+          * Margin calls the call orders of mia that the order book allows, and detects black swans.  Checking an
+          * asset again with none of its orders and feeds changed returns at once, see margin_call_check_cache.
+          *
+          * @return true if some call orders were filled or the asset was globally settled
+          */
          bool check_call_orders( const asset_object& mia, bool enable_black_swan = true );
 
          // helpers to fill_order
@@ -397,12 +1002,82 @@ namespace graphene { namespace chain {
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
-         void notify_changed_objects();
+         /** @param end_of_block whether a block was applied, which reports the changes collected so far as well */
+         void notify_changed_objects( bool end_of_block );
+         /** logs one line for every index that holds objects, see set_index_statistics_interval() */
+         void log_index_statistics()const;
+         /** starts paging the paged indexes to files in data_dir, after object_database::open() */
+         void open_object_paging( const fc::path& data_dir );
+         void maybe_write_checkpoint();
+         /**
+          * applies blocks first through last from the block log with the reindex skip flags, stopping at a gap;
+          * the blocks after the gap are dropped from the block log unless keep_blocks_after_gap
+          */
+         void replay_blocks( uint32_t first, uint32_t last, bool keep_blocks_after_gap = false );
+         /** loads the snapshot into data_dir and opens the block log in blockchain_dir, see reindex_from_snapshot() */
+         state_snapshot_info restore_snapshot( const fc::path& data_dir, const fc::path& blockchain_dir,
+                                               const fc::path& snapshot_dir, const fc::sha256& trusted_state_hash );
+         void precompute_signature_keys( size_t count, const std::function<const signed_transaction&(size_t)>& get );
+         /** throws pending_pool_full if one more transaction does not fit into the pending pool */
+         void check_pending_pool_capacity();
+         /** the fees of trx converted to the core asset at the core exchange rates, per packed byte */
+         double core_fee_per_byte( const processed_transaction& trx )const;
+         /** runs task(0) ... task(count - 1) spread over the signature threads and waits for all of them */
+         void run_on_signature_threads( size_t count, const std::function<void(size_t)>& task );
+         /** the signature threads, or the tasks at a time on the shared executor */
+         size_t signature_workers()const;
+         /**
+          * runs task on one of the signature threads, call with _prevalidation_mutex held; on the shared executor at
+          * most _signature_parallelism of them run at a time, the others wait in _signature_backlog
+          */
+         fc::future<void> run_on_signature_thread( const char* type, const std::function<void()>& task,
+                                                   graphene::utilities::task_priority priority );
+         /** posts @ref task to the shared executor and, once it is done, the next one of _signature_backlog */
+         void post_signature_task( const char* type, graphene::utilities::task_priority priority,
+                                   const std::function<void()>& task );
+         /** validates every transaction of b on the signature threads, true if all of them are valid */
+         bool prevalidate_transactions( const signed_block& b );
+         /**
+          * true if prevalidate_block() found the merkle root of b correct and b has the transactions it checked,
+          * forgets the irreversible blocks
+          */
+         bool merkle_root_prevalidated( const signed_block& b );
+         /** copies what prevalidate_transaction() checks against from the state */
+         void update_prevalidation_limits();
+         /** saves the object changes of b, which was just pushed, if set_state_diff_history() asks for them */
+         void record_state_diff( const signed_block& b );
+         /** keeps the state hash after b, which was just applied, if set_state_hash_history() asks for it */
+         void record_state_hash( const signed_block& b );
+         /** @return the checks apply_block() skips for a block with this number because a checkpoint vouches for it */
+         uint32_t checkpoint_skip_flags( uint32_t block_num )const;
+         /** the merkle root of b, hashed on the signature threads when a step has enough independent hashes */
+         checksum_type calculate_merkle_root( const signed_block& b );
 
       private:
+         friend struct detail::pending_transactions_restorer;
+
+         /**
+          * Applies trx to the pending state and adds it to _pending_tx with its footprint.  Must be called in an undo
+          * session of trx alone, whose changes become the footprint.
+          */
+         processed_transaction _apply_pending_transaction( const signed_transaction& trx );
+         /**
+          * Puts the pending transactions back after the pending state was cleared on top of previous_head.  If the
+          * head is still previous_head or a block on top of it, a transaction is taken over by making the changes of
+          * its footprint again, unless the block or a transaction before it that was not taken over changed
+          * something the transaction read or changed.  Every other transaction is applied again.
+          */
+         void _restore_pending_transactions( vector<processed_transaction>&& pending,
+                                             vector<pending_transaction_footprint>&& footprints,
+                                             const block_id_type& previous_head );
+
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
+         /** writes the votes of the current tally into the total_votes of every object of @ref Index */
+         template<class Index>
+         void store_vote_totals();
+         /** @return the @ref count objects of @ref Index with the most total_votes, see store_vote_totals() */
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
 
@@ -415,7 +1090,22 @@ namespace graphene { namespace chain {
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
       private:
          void                  _apply_block( const signed_block& next_block );
+         /** applies @ref trx with the profile of the current skip flags, see the templated overload */
          processed_transaction _apply_transaction( const signed_transaction& trx );
+         /**
+          * The common profiles of skip flags are instantiated with flags known at compile time, so the checks they
+          * skip are compiled out.  @ref skipped tells whether a skip flag is set.
+          */
+         template<typename Skip>
+         processed_transaction _apply_transaction( const signed_transaction& trx, const Skip& skipped );
+         template<typename Skip>
+         void                  _apply_block_transactions( const signed_block& next_block, const Skip& skipped );
+         /** see set_transaction_prefetch_depth() */
+         void                  prefetch_transaction_objects( const signed_transaction& trx )const;
+
+         /** picks the transactions of a block and records how in _last_block_assembly */
+         signed_block _assemble_block( fc::time_point_sec when, witness_id_type witness_id );
+         signed_block _sign_and_push_block( signed_block pending_block, const fc::ecc::private_key& block_signing_private_key );
 
          ///Steps involved in applying a new block
          ///@{
@@ -435,6 +1125,7 @@ namespace graphene { namespace chain {
          void update_maintenance_flag( bool new_maintenance_flag );
          void update_withdraw_permissions();
          bool check_for_blackswan( const asset_object& mia, bool enable_black_swan = true );
+         bool match_call_orders( const asset_object& mia, bool enable_black_swan );
 
          ///Steps performed only at maintenance intervals
          ///@{
@@ -455,6 +1146,15 @@ namespace graphene { namespace chain {
          ///@}
 
          vector< processed_transaction >        _pending_tx;
+         /** the footprint of every transaction of _pending_tx, in the same order */
+         vector< pending_transaction_footprint > _pending_footprints;
+         /** the skip flags of all pushes that added to _pending_tx, checks they skipped were not made */
+         uint32_t                               _pending_tx_skip = 0;
+         uint32_t                               _max_pending_tx = 0;
+         uint64_t                               _pending_tx_rejected = 0;
+         uint64_t                               _pending_tx_postponed = 0;
+         uint64_t                               _pending_tx_carried_over = 0;
+         uint64_t                               _pending_tx_reapplied = 0;
          fork_database                          _fork_db;
 
          /**
@@ -478,6 +1178,7 @@ namespace graphene { namespace chain {
 
          uint32_t                          _current_block_num    = 0;
          uint16_t                          _current_trx_in_block = 0;
+         vector<transaction_id_type>       _applied_trx_ids;
          uint16_t                          _current_op_in_trx    = 0;
          uint16_t                          _current_virtual_op   = 0;
 
@@ -488,6 +1189,119 @@ namespace graphene { namespace chain {
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
+         uint32_t                          _checkpoint_interval  = 0;
+         uint64_t                          _max_changelog_size   = 0;
+         uint32_t                          _replay_prefetch_depth = 0;
+         uint32_t                          _transaction_prefetch_depth = 0;
+         uint32_t                          _block_retention = 0;
+         uint32_t                          _state_diff_history = 0;
+         std::map<uint32_t, block_state_diff> _state_diffs;
+         uint32_t                          _state_hash_history = 0;
+         std::map<uint32_t, block_state_hash> _state_hashes;
+         uint32_t                          _replay_skip_flags = skip_witness_signature |
+                                                                skip_transaction_signatures |
+                                                                skip_transaction_dupe_check |
+                                                                skip_tapos_check |
+                                                                skip_witness_schedule_check |
+                                                                skip_authority_check;
+         replay_statistics                 _replay_statistics;
+
+         /** guards the members used by prevalidate_block() and prevalidate_transaction(), which run on other threads */
+         std::mutex                        _prevalidation_mutex;
+         std::deque< fc::future<void> >    _prevalidations;
+         uint32_t                          _next_prevalidation_thread = 0;
+         /** what prevalidate_transaction() checks against, as of the last applied block */
+         struct prevalidation_limits
+         {
+            uint32_t            head_block_num = 0;
+            fc::time_point_sec  head_block_time;
+            uint32_t            maximum_time_until_expiration = 0;
+            uint32_t            maximum_transaction_size = 0;
+         };
+         prevalidation_limits              _prevalidation_limits;
+         /**
+          * the packed transactions of the blocks prevalidate_block() found the merkle root of correct, by (block
+          * number, block id); the id only covers the header, a block with other transactions under it is checked again
+          */
+         std::map< std::pair<uint32_t, block_id_type>, vector<char> > _merkle_checked_blocks;
+         vector< std::unique_ptr<fc::thread> > _signature_threads;
+         /** when set, the signature work runs on it as up to _signature_parallelism tasks instead */
+         graphene::utilities::executor*         _signature_executor = nullptr;
+         uint32_t                               _signature_parallelism = 0;
+         struct signature_task
+         {
+            const char*             type;
+            std::function<void()>   run;
+         };
+         /** the run_on_signature_thread() tasks waiting for one of the _signature_parallelism to finish, by priority */
+         std::deque<signature_task>             _signature_backlog[graphene::utilities::task_priority_count];
+         uint32_t                               _signature_tasks_running = 0;
+         std::mutex                             _signature_backlog_mutex;
+
+         /** held by the outermost call that modifies the state, see with_read_lock() */
+         class state_write_lock
+         {
+            public:
+               explicit state_write_lock( database& db );
+               ~state_write_lock();
+            private:
+               database& _db;
+         };
+         mutable boost::shared_mutex       _state_mutex;
+         /** the thread holding _state_mutex for writing and how many state_write_locks it holds */
+         std::atomic<std::thread::id>      _state_writer{ std::thread::id() };
+         uint32_t                          _state_writers = 0;
+         mutable signature_key_cache       _signature_key_cache;
+         mutable authorized_asset_cache    _authorized_asset_cache;
+         /** ids of the transactions validate_transaction_stateless() remembers, oldest first */
+         mutable std::mutex                          _validated_trx_mutex;
+         mutable std::deque< transaction_id_type >   _validated_trx_order;
+         mutable std::set< transaction_id_type >     _validated_trxs;
+         static const size_t                         max_validated_trxs = 10000;
+         /**
+          * The signer sets _apply_transaction() found to satisfy the authorities required by a transaction, keyed by
+          * max_authority_depth, the required active and owner accounts and the signature keys.  The verdict depends
+          * on nothing else, so the set is kept until account authorities change.
+          */
+         typedef std::tuple< uint8_t, flat_set<account_id_type>, flat_set<account_id_type>,
+                             flat_set<public_key_type> >     authorized_signers;
+         const account_authority_index*              _account_authorities = nullptr;
+         uint64_t                                    _authorized_signers_generation = 0;
+         std::set< authorized_signers >              _authorized_signers;
+         static const size_t                         max_authorized_signers = 10000;
+         /** set while _apply_block() applies transactions that prevalidate_transactions() accepted */
+         bool                              _transactions_prevalidated = false;
+         /** set while _apply_block() applies the transactions of a block */
+         bool                              _applying_block = false;
+         bool                              _keep_transaction_bodies = true;
+         margin_call_check_cache           _margin_call_checks;
+         /** the price levels apply_order() looks at to tell whether a new order crosses the spread */
+         const limit_order_book_index*     _limit_order_book = nullptr;
+         force_settlement_schedule         _force_settlement_schedule;
+         vote_ledger                       _vote_ledger;
+         bool                              _check_vote_tally = false;
+         uint32_t                          _maintenance_precount_blocks = 0;
+         uint32_t                          _object_paging_idle_blocks = 0;
+         uint32_t                          _vote_tally_mismatches = 0;
+         /** the phases of the block being pushed */
+         block_timing                      _block_timing;
+         block_timing                      _last_block_timing;
+         block_assembly                    _last_block_assembly;
+         block_timing_statistics           _block_timing_statistics;
+         /** the allocations counted up to the end of the last pushed block */
+         graphene::utilities::allocation_snapshot _allocations_at_last_block;
+         fc::microseconds                  _slow_block_threshold;
+         uint32_t                          _index_statistics_interval = 0;
+         fc::microseconds                  _change_notification_interval;
+         /** the changes not reported yet while _change_notification_interval is set */
+         flat_set<object_id_type>          _unreported_changes;
+         fc::time_point                    _last_change_notification;
+         bool                              _operation_statistics_enabled = false;
+         vector<operation_statistics>      _operation_statistics;
+         operation_statistics*             _current_operation_statistics = nullptr;
+         /** total time spent in perform_chain_maintenance() since the database was created */
+         fc::microseconds                  _maintenance_time;
+
          node_property_object              _node_property_object;
    };
 
@@ -511,3 +1325,28 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::block_timing,
+            (block_num)(transactions)(fork_db)(header)(signatures)(apply_transactions)(chain_updates)
+            (maintenance)(handlers)(total)(allocations) )
+FC_REFLECT( graphene::chain::latency_histogram, (count)(total)(max)(buckets) )
+FC_REFLECT( graphene::chain::block_timing_statistics,
+            (fork_db)(header)(signatures)(apply_transactions)(chain_updates)(maintenance)(handlers)(total)
+            (slow_blocks)(last_slow_block) )
+FC_REFLECT( graphene::chain::operation_statistics,
+            (count)(evaluate_time)(max_evaluate_time)(apply_time)(max_apply_time)(fee_time)
+            (objects_created)(objects_modified)(objects_removed) )
+FC_REFLECT( graphene::chain::pending_pool_statistics,
+            (transactions)(size)(capacity)(rejected)(postponed)(carried_over)(reapplied) )
+FC_REFLECT( graphene::chain::block_assembly, (pending)(included)(postponed)(failed)(reapplied) )
+FC_REFLECT( graphene::chain::transaction_admission, (trx)(error) )
+FC_REFLECT( graphene::chain::block_state_diff, (block)(objects)(state_hash) )
+FC_REFLECT( graphene::chain::block_state_hash, (block_num)(block_id)(state_hash) )
+FC_REFLECT( graphene::chain::state_snapshot_info, (block_num)(block_id)(chain_id)(state_hash) )
+FC_REFLECT( graphene::chain::replay_range_verification,
+            (from_block)(to_block)(expected_state_hash)(actual_state_hash)(matches)(error)(elapsed_time) )
+FC_REFLECT( graphene::chain::replay_statistics,
+            (first_block)(last_block)(blocks)(transactions)(operations)(operations_by_type)
+            (elapsed_time)(io_wait_time)(apply_time)(maintenance_time)
+            (signature_time)(header_time)(transaction_time)(chain_update_time)(handler_time)(skip_flags)
+            (blocks_per_second)(transactions_per_second)(operations_per_second) )
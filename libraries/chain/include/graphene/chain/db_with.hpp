@@ -69,49 +69,61 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ),
+        _pending_footprints( std::move(db._pending_footprints) ), _previous_head( db.head_block_id() )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception&  ) {
-         }
-      }
-      _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& e )
-         {
-            /*
-            wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", _db.head_block_id())("t",_db.head_block_time()) );
-            wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
-            */
-         }
-      }
+      _db._restore_pending_transactions( std::move(_pending_transactions), std::move(_pending_footprints),
+                                         _previous_head );
    }
 
    database& _db;
    std::vector< processed_transaction > _pending_transactions;
+   std::vector< pending_transaction_footprint > _pending_footprints;
+   block_id_type _previous_head;
 };
 
+/**
+ * Class used to help the with_read_log implementation.
+ */
+struct read_log_restorer
+{
+   read_log_restorer( database& db, vector<object_id_type>* old_log, vector<object_id_type>* old_index_log )
+      : _db( db ), _old_log( old_log ), _old_index_log( old_index_log )
+   {}
+
+   ~read_log_restorer()
+   {
+      _db.set_read_log( _old_log );
+      _db.set_index_read_log( _old_index_log );
+   }
+
+   database& _db;
+   vector<object_id_type>* _old_log;         // initialized in ctor
+   vector<object_id_type>* _old_index_log;   // initialized in ctor
+};
+
+/**
+ * Log the objects looked up by id into log and the indexes read otherwise into index_log, see
+ * object_database::set_read_log(), while callback runs.
+ */
+template< typename Lambda >
+auto with_read_log(
+   database& db,
+   vector<object_id_type>* log,
+   vector<object_id_type>* index_log,
+   Lambda callback ) -> decltype( callback() )
+{
+   read_log_restorer restorer( db, db.get_read_log(), db.get_index_read_log() );
+   db.set_read_log( log );
+   db.set_index_read_log( index_log );
+   return callback();
+}
+
 /**
  * Set the skip_flags to the given value, call callback,
  * then reset skip_flags to their previous value after
@@ -25,6 +25,7 @@
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/transaction_evaluation_state.hpp>
 #include <graphene/chain/protocol/operations.hpp>
+#include <graphene/utilities/trace.hpp>
 
 namespace graphene { namespace chain {
 
@@ -130,6 +131,7 @@ namespace graphene { namespace chain {
    public:
       virtual operation_result evaluate(transaction_evaluation_state& eval_state, const operation& op, bool apply = true) override
       {
+         GRAPHENE_TRACE_SPAN( fc::get_typename<typename T::operation_type>::name() );
          T eval;
          return eval.start_evaluate(eval_state, op, apply);
       }
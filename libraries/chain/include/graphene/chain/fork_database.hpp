@@ -37,8 +37,8 @@ namespace graphene { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( shared_ptr<const signed_block> b )
+      :num(b->block_num()),id(b->id()),size(fc::raw::pack_size(*b)),block( std::move(b) ),data( *block ){}
 
       block_id_type previous_id()const { return data.previous; }
 
@@ -49,8 +49,14 @@ namespace graphene { namespace chain {
        * building on top of it.
        */
       bool                  invalid = false;
+      /// set once the block was applied, applying it again after a fork switch skips the merkle check
+      bool                  merkle_checked = false;
       block_id_type         id;
-      signed_block          data;
+      /// packed size of the block, which is what the item is charged against the memory limit
+      size_t                size;
+      /// the block itself, shared with whoever else holds on to it and never modified
+      shared_ptr<const signed_block> block;
+      const signed_block&   data;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -76,6 +82,7 @@ namespace graphene { namespace chain {
          void reset();
 
          void                             start_block(signed_block b);
+         void                             start_block(shared_ptr<const signed_block> b);
          void                             remove(block_id_type b);
          void                             set_head(shared_ptr<fork_item> h);
          bool                             is_known_block(const block_id_type& id)const;
@@ -86,6 +93,7 @@ namespace graphene { namespace chain {
           *  @return the new head block ( the longest fork )
           */
          shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(shared_ptr<const signed_block> b);
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
@@ -110,12 +118,27 @@ namespace graphene { namespace chain {
 
          void set_max_size( uint32_t s );
 
+         /**
+          * Limit the packed size of the blocks held, 0 for no limit.  Once it is exceeded the unlinked blocks and
+          * then the forks off the branch of the head block are dropped, each with all its blocks and the oldest
+          * first.  The head's branch is always kept so blocks can still be popped back to the last irreversible
+          * block.
+          */
+         void set_max_memory( size_t bytes );
+         /// packed size of all the blocks held in the fork database
+         size_t memory_used()const { return _memory_used; }
+
       private:
          /** @return a pointer to the newly pushed item */
          void _push_block(const item_ptr& b );
          void _push_next(const item_ptr& newly_inserted);
+         void _enforce_memory_limit();
+         template<typename Index, typename Iterator>
+         void _erase( Index& index, Iterator itr );
 
          uint32_t                 _max_size = 1024;
+         size_t                   _max_memory = 0;
+         size_t                   _memory_used = 0;
 
          fork_multi_index_type    _unlinked_index;
          fork_multi_index_type    _index;
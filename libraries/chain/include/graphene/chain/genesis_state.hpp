@@ -125,6 +125,23 @@ struct genesis_state_type {
    chain_id_type compute_chain_id() const;
 };
 
+/**
+ * The binary genesis format is a short magic followed by the fc::raw serialization of a genesis_state_type.
+ * Large allocations load much faster from it than from JSON.  The file carries initial_chain_id, which the
+ * writer sets to the hash of the JSON genesis it was produced from so both files start the same chain.
+ */
+bool is_binary_genesis( const std::string& contents );
+std::string pack_binary_genesis( const genesis_state_type& genesis );
+genesis_state_type unpack_binary_genesis( const std::string& contents );
+
+/**
+ * Parses a JSON genesis without building a variant tree for the whole document.  The elements of
+ * initial_accounts, initial_balances and initial_vesting_balances are converted one at a time, only the
+ * remaining small members go through fc::variant as a whole.  The result equals
+ * fc::json::from_string( json ).as<genesis_state_type>().
+ */
+genesis_state_type parse_genesis_json( const std::string& json );
+
 } } // namespace graphene::chain
 
 FC_REFLECT(graphene::chain::genesis_state_type::initial_account_type, (name)(owner_key)(active_key)(is_lifetime_member))
@@ -23,12 +23,70 @@
  */
 #pragma once
 
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/index.hpp>
+
+#include <map>
+#include <set>
+
 namespace graphene { namespace chain {
 
 class account_object;
 class asset_object;
 class database;
 
+/**
+ *  @brief Remembers whether accounts are authorized to transact in whitelisted assets
+ *
+ *  The verdict of detail::_is_authorized_asset() only depends on the account's allowed_assets, whitelisting and
+ *  blacklisting accounts, the asset's authority lists and whether HARDFORK_415_TIME has passed.  A verdict is
+ *  forgotten as soon as its account or asset object changes, which authorized_asset_cache_index reports, so
+ *  account_whitelist_operation, asset_update_operation and undoing either of them all take effect at once.
+ */
+class authorized_asset_cache
+{
+   public:
+      /** @return the remembered verdict in @ref authorized, or false if there is none */
+      bool find( account_id_type account, asset_id_type asset, bool after_hardfork_415, bool& authorized )const;
+      void store( account_id_type account, asset_id_type asset, bool after_hardfork_415, bool authorized );
+
+      void account_changed( account_id_type a );
+      void asset_changed( asset_id_type a );
+
+      size_t size()const { return _verdicts.size(); }
+
+   private:
+      struct verdict
+      {
+         bool after_hardfork_415 = false;
+         bool authorized = false;
+      };
+
+      std::map< std::pair<account_id_type, asset_id_type>, verdict >   _verdicts;
+      std::set< std::pair<asset_id_type, account_id_type> >            _by_asset;
+      /** the cache starts over once it holds this many verdicts */
+      static const size_t                                             max_verdicts = 100000;
+};
+
+/**
+ *  @brief Reports changes of accounts and assets to an authorized_asset_cache, added as a secondary index of the
+ *  account and asset indexes.
+ */
+class authorized_asset_cache_index : public secondary_index
+{
+   public:
+      explicit authorized_asset_cache_index( authorized_asset_cache& cache ) : _cache( cache ) {}
+
+      virtual void object_inserted( const object& obj ) override { changed( obj ); }
+      virtual void object_removed( const object& obj ) override  { changed( obj ); }
+      virtual void object_modified( const object& after  ) override { changed( after ); }
+
+   private:
+      void changed( const object& obj );
+
+      authorized_asset_cache& _cache;
+};
+
 namespace detail {
 
 bool _is_authorized_asset(const database& d, const account_object& acct, const asset_object& asset_obj);
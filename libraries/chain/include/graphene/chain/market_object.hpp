@@ -30,10 +30,56 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <set>
+
 namespace graphene { namespace chain {
 
 using namespace graphene::db;
 
+/**
+ *  @brief the position of a price in the indexes sorted by price, as plain integers
+ *
+ *  The key holds the asset ids and ratio = floor( base.amount * 2^64 / quote.amount ), which is computed once when
+ *  the price changes.  Prices with different ratios are ordered by the ratio alone, only equal ratios fall back to
+ *  cross multiplying the amounts, so keys sort exactly like price::operator< sorts the prices.
+ */
+struct price_key
+{
+   price_key() {}
+   explicit price_key( const price& p );
+
+   /** true when this key was computed from @ref p */
+   bool matches( const price& p )const
+   {
+      return base_amount == p.base.amount.value && quote_amount == p.quote.amount.value
+          && base_asset == p.base.asset_id.instance.value && quote_asset == p.quote.asset_id.instance.value;
+   }
+
+   uint64_t  base_asset   = 0;
+   uint64_t  quote_asset  = 0;
+   uint64_t  ratio_hi     = 0;
+   uint64_t  ratio_lo     = 0;
+   int64_t   base_amount  = 0;
+   int64_t   quote_amount = 0;
+};
+
+bool operator < ( const price_key& a, const price_key& b );
+bool operator < ( const price_key& a, const price& b );
+bool operator < ( const price& a, const price_key& b );
+
+/** sorts like std::less<price>, also accepting prices to search for */
+struct price_key_less
+{
+   template<typename A, typename B>
+   bool operator()( const A& a, const B& b )const { return a < b; }
+};
+/** sorts like std::greater<price>, also accepting prices to search for */
+struct price_key_greater
+{
+   template<typename A, typename B>
+   bool operator()( const A& a, const B& b )const { return b < a; }
+};
+
 /**
  *  @brief an offer to sell a amount of a asset at a specified exchange rate by a certain time
  *  @ingroup object
@@ -63,6 +109,17 @@ class limit_order_object : public abstract_object<limit_order_object>
 
       asset amount_for_sale()const   { return asset( for_sale, sell_price.base.asset_id ); }
       asset amount_to_receive()const { return amount_for_sale() * sell_price; }
+
+      /** the key of sell_price in by_price, recomputed only after sell_price changed */
+      const price_key& sell_price_key()const
+      {
+         if( !_sell_price_key.matches( sell_price ) )
+            _sell_price_key = price_key( sell_price );
+         return _sell_price_key;
+      }
+
+   private:
+      mutable price_key _sell_price_key;
 };
 
 struct by_id;
@@ -81,10 +138,10 @@ typedef multi_index_container<
       >,
       ordered_unique< tag<by_price>,
          composite_key< limit_order_object,
-            member< limit_order_object, price, &limit_order_object::sell_price>,
+            const_mem_fun< limit_order_object, const price_key&, &limit_order_object::sell_price_key >,
             member< object, object_id_type, &object::id>
          >,
-         composite_key_compare< std::greater<price>, std::less<object_id_type> >
+         composite_key_compare< price_key_greater, std::less<object_id_type> >
       >,
       ordered_unique< tag<by_account>,
          composite_key< limit_order_object,
@@ -97,6 +154,65 @@ typedef multi_index_container<
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/** the orders of one side of a market at one price */
+struct order_book_level
+{
+   share_type  for_sale;    ///< the sum of for_sale of the orders
+   uint32_t    orders = 0;
+};
+
+/** the new state of a price level of an order book, for_sale and orders are 0 once the level is gone */
+struct order_book_delta
+{
+   price       sell_price;
+   share_type  for_sale;
+   uint32_t    orders = 0;
+};
+
+/**
+ *  @brief This secondary index of limit_order_index keeps the depth of every market aggregated by price, so
+ *  order books can be read one price level at a time instead of one order at a time.
+ *
+ *  Once get_deltas() has been called it also remembers which levels changed, so that the order book changes of a
+ *  block are computed and serialized once for all the clients subscribed to them.
+ */
+class limit_order_book_index : public secondary_index
+{
+   public:
+      /** the price levels of orders selling base for quote, best price first */
+      typedef map< price, order_book_level, std::greater<price> > levels_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /** @return the levels of orders selling base for quote, nullptr if there are none */
+      const levels_type* get_levels( asset_id_type base, asset_id_type quote )const;
+
+      /** the variant of a vector<order_book_delta> for each market (lower asset id first) */
+      typedef map< pair<asset_id_type,asset_id_type>, fc::variant > deltas_type;
+      /**
+       *  @return the levels that changed before the block @ref block_id was applied, by market.  They are collected
+       *  on the first call for each block, later calls for the same block return the same deltas; a block of the
+       *  same number on another fork gets deltas of its own.  The deltas of blocks up to
+       *  @ref last_irreversible_block_num are dropped, the block asked for excepted.
+       */
+      const deltas_type& get_deltas( const block_id_type& block_id, uint32_t last_irreversible_block_num )const;
+
+   private:
+      void add( const price& p, share_type for_sale, int32_t orders );
+      void changed( const price& p ) { if( _track_changes ) _changed.insert( p ); }
+
+      map< pair<asset_id_type,asset_id_type>, levels_type > _levels;
+
+      mutable bool           _track_changes = false;
+      mutable set< price >   _changed;
+      mutable map< block_id_type, deltas_type >   _deltas;
+      price       _before_price;
+      share_type  _before_for_sale;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
@@ -120,6 +236,17 @@ class call_order_object : public abstract_object<call_order_object>
       share_type       collateral;  ///< call_price.base.asset_id, access via get_collateral
       share_type       debt;        ///< call_price.quote.asset_id, access via get_collateral
       price            call_price;  ///< Debt / Collateral
+
+      /** the key of call_price in by_price, recomputed only after call_price changed */
+      const price_key& call_price_key()const
+      {
+         if( !_call_price_key.matches( call_price ) )
+            _call_price_key = price_key( call_price );
+         return _call_price_key;
+      }
+
+   private:
+      mutable price_key _call_price_key;
 };
 
 /**
@@ -152,10 +279,10 @@ typedef multi_index_container<
          member< object, object_id_type, &object::id > >,
       ordered_unique< tag<by_price>,
          composite_key< call_order_object,
-            member< call_order_object, price, &call_order_object::call_price>,
+            const_mem_fun< call_order_object, const price_key&, &call_order_object::call_price_key >,
             member< object, object_id_type, &object::id>
          >,
-         composite_key_compare< std::less<price>, std::less<object_id_type> >
+         composite_key_compare< price_key_less, std::less<object_id_type> >
       >,
       ordered_unique< tag<by_account>,
          composite_key< call_order_object,
@@ -196,8 +323,105 @@ typedef multi_index_container<
 typedef generic_index<call_order_object, call_order_multi_index_type>                      call_order_index;
 typedef generic_index<force_settlement_object, force_settlement_object_multi_index_type>   force_settlement_index;
 
+/**
+ *  @brief Remembers the market issued assets for which database::check_call_orders() found nothing to do
+ *
+ *  A check only reads the call orders and bitasset data of the asset, and the limit orders selling it for its
+ *  backing asset.  An asset is forgotten as soon as one of these changes, which margin_call_check_index reports.
+ *  Until then checking the asset again can only find nothing to do either, so orders placed in any other market,
+ *  including bids for the asset, leave the cached result in place.
+ */
+class margin_call_check_cache
+{
+   public:
+      bool is_unchanged( asset_id_type mia )const { return _checked.find( mia ) != _checked.end(); }
+      void mark_checked( asset_id_type mia, asset_id_type backing, asset_bitasset_data_id_type bitasset );
+
+      void asset_changed( asset_id_type a );
+      /** a limit order selling @ref sold for @ref received changed */
+      void order_changed( asset_id_type sold, asset_id_type received );
+      void bitasset_changed( asset_bitasset_data_id_type b );
+
+      /** counts the reported changes, so a check can tell whether its own work changed anything */
+      uint64_t changes()const { return _changes; }
+
+   private:
+      /** checked assets and their backing assets */
+      flat_map<asset_id_type, asset_id_type>                 _checked;
+      flat_map<asset_bitasset_data_id_type, asset_id_type>   _bitasset_owner;
+      uint64_t                                               _changes = 0;
+};
+
+/**
+ *  @brief Reports changes of limit orders, call orders and bitasset data to a margin_call_check_cache, added as
+ *  a secondary index of each of these indexes.
+ */
+class margin_call_check_index : public secondary_index
+{
+   public:
+      explicit margin_call_check_index( margin_call_check_cache& cache ) : _cache( cache ) {}
+
+      virtual void object_inserted( const object& obj ) override { changed( obj ); }
+      virtual void object_removed( const object& obj ) override  { changed( obj ); }
+      virtual void object_modified( const object& after  ) override { changed( after ); }
+
+   private:
+      void changed( const object& obj );
+
+      margin_call_check_cache& _cache;
+};
+
+/**
+ *  @brief Tells database::clear_expired_orders() whether any force settlement needs its attention
+ *
+ *  A pending force settlement needs attention once its settlement date has passed, or once its asset has been
+ *  globally settled, at which point it is canceled.  Otherwise clearing expired orders leaves every settlement
+ *  untouched, so the schedule can answer in constant time instead of visiting each settled asset.
+ */
+class force_settlement_schedule
+{
+   public:
+      /** @return true if no pending settlement is due at @ref now and none belongs to a globally settled asset */
+      bool is_idle( time_point_sec now )const
+      { return _settled_pending == 0 && (_due.empty() || *_due.begin() > now); }
+
+      void settlement_added( const force_settlement_object& o );
+      void settlement_removed( const force_settlement_object& o );
+      void bitasset_changed( asset_bitasset_data_id_type id, const price& settlement_price );
+
+   private:
+      uint32_t pending( asset_id_type a )const;
+
+      std::multiset<time_point_sec>                          _due;
+      flat_map<asset_id_type, uint32_t>                      _pending;
+      /** globally settled bitassets and the assets they belong to */
+      flat_map<asset_bitasset_data_id_type, asset_id_type>   _settled;
+      flat_set<asset_id_type>                                _settled_assets;
+      /** number of pending settlements in globally settled assets */
+      uint32_t                                               _settled_pending = 0;
+};
+
+/**
+ *  @brief Reports force settlements and bitasset data to a force_settlement_schedule, added as a secondary index
+ *  of both indexes.
+ */
+class force_settlement_schedule_index : public secondary_index
+{
+   public:
+      explicit force_settlement_schedule_index( force_settlement_schedule& schedule ) : _schedule( schedule ) {}
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void object_modified( const object& after  ) override;
+
+   private:
+      force_settlement_schedule& _schedule;
+};
+
 } } // graphene::chain
 
+FC_REFLECT( graphene::chain::order_book_delta, (sell_price)(for_sale)(orders) )
+
 FC_REFLECT_DERIVED( graphene::chain::limit_order_object,
                     (graphene::db::object),
                     (expiration)(seller)(for_sale)(sell_price)(deferred_fee)
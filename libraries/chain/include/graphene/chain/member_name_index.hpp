@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+#include <graphene/db/object_database.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief This secondary index orders the witnesses or committee members by the name of their account, so
+    *  looking them up by name does not have to sort all of them on every call.
+    *
+    *  Account names never change, so the name is looked up once when the object is inserted.  The account must
+    *  exist by then, which holds because accounts are loaded before the objects referring to them.
+    */
+   template<typename ObjectType, account_id_type ObjectType::*Account>
+   class member_name_index : public secondary_index
+   {
+      public:
+         typedef object_id<ObjectType::space_id, ObjectType::type_id, ObjectType> id_type;
+
+         explicit member_name_index( const object_database& db ) : _db( db ) {}
+
+         virtual void object_inserted( const object& obj ) override
+         {
+            const ObjectType& member = static_cast<const ObjectType&>( obj );
+            by_name[ (member.*Account)( _db ).name ] = member.get_id();
+         }
+
+         /** the account may be gone already when undo removes both, so the entry is found by its value */
+         virtual void object_removed( const object& obj ) override
+         {
+            for( auto itr = by_name.begin(); itr != by_name.end(); ++itr )
+               if( object_id_type( itr->second ) == obj.id )
+               {
+                  by_name.erase( itr );
+                  return;
+               }
+         }
+
+         map< string, id_type > by_name;
+
+      private:
+         const object_database& _db;
+   };
+
+   typedef member_name_index< witness_object, &witness_object::witness_account >                   witness_name_index;
+   typedef member_name_index< committee_member_object, &committee_member_object::committee_member_account >
+                                                                                                     committee_member_name_index;
+
+} } // graphene::chain
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/utilities/trace.hpp>
+
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+/** calls of one observer of an observer_list and the time spent in them */
+struct observer_statistics
+{
+   std::string name;
+   uint64_t    calls = 0;
+   uint64_t    microseconds = 0;
+};
+
+namespace detail {
+   struct observer_slot_base
+   {
+      explicit observer_slot_base( std::string n )
+         : name( std::move(n) ), trace_name( graphene::utilities::tracer::intern( name ) ) {}
+
+      const std::string       name;
+      /** the name of the spans of this observer, names stay interned after the observer is gone */
+      const char* const       trace_name;
+      std::atomic<bool>       connected{true};
+      std::atomic<uint64_t>   calls{0};
+      std::atomic<uint64_t>   microseconds{0};
+   };
+}
+
+/**
+ *  @brief Handle of an observer connected to an observer_list
+ *
+ *  Like boost::signals2::connection the observer stays connected when the handle goes away, see
+ *  scoped_observer_connection.
+ */
+class observer_connection
+{
+   public:
+      observer_connection() {}
+      explicit observer_connection( std::shared_ptr<detail::observer_slot_base> slot ) : _slot( std::move(slot) ) {}
+
+      void disconnect()
+      {
+         if( _slot )
+            _slot->connected.store( false, std::memory_order_relaxed );
+         _slot.reset();
+      }
+      bool connected()const { return _slot && _slot->connected.load( std::memory_order_relaxed ); }
+
+   private:
+      std::shared_ptr<detail::observer_slot_base> _slot;
+};
+
+/** disconnects its observer when it goes away or is assigned another one */
+class scoped_observer_connection : public observer_connection
+{
+   public:
+      scoped_observer_connection() {}
+      scoped_observer_connection( const observer_connection& c ) : observer_connection( c ) {}
+      scoped_observer_connection( const scoped_observer_connection& ) = delete;
+      ~scoped_observer_connection() { disconnect(); }
+
+      scoped_observer_connection& operator = ( const observer_connection& c )
+      {
+         disconnect();
+         observer_connection::operator = ( c );
+         return *this;
+      }
+      scoped_observer_connection& operator = ( const scoped_observer_connection& ) = delete;
+};
+
+/**
+ *  @brief The observers of a database event, called one after another on the thread that emits it
+ *
+ *  Unlike boost::signals2 emitting takes no lock and copies nothing: the observers are connected at startup or when an
+ *  API session begins, which replaces the whole list, and an emission reads the list it finds.  A disconnected
+ *  observer is skipped at once and dropped from the list by the next connect().
+ *
+ *  The calls of every observer and the time spent in them are counted, see statistics().  Exceptions thrown by an
+ *  observer reach the emitter and skip the observers after it.
+ */
+template<typename... Args>
+class observer_list
+{
+   public:
+      typedef std::function<void(Args...)> observer_type;
+
+      /** @param name tells this observer apart in statistics() */
+      observer_connection connect( observer_type observer, std::string name = "unnamed" )
+      {
+         auto added = std::make_shared<slot>( std::move(name), std::move(observer) );
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto current = std::atomic_load( &_slots );
+         auto updated = std::make_shared<slot_list>();
+         updated->reserve( current->size() + 1 );
+         for( const auto& s : *current )
+            if( s->connected.load( std::memory_order_relaxed ) )
+               updated->push_back( s );
+         updated->push_back( added );
+         std::atomic_store( &_slots, std::shared_ptr<const slot_list>( std::move(updated) ) );
+         return observer_connection( added );
+      }
+
+      void operator()( Args... args )const
+      {
+         const std::shared_ptr<const slot_list> current = std::atomic_load( &_slots );
+         for( const auto& s : *current )
+         {
+            if( !s->connected.load( std::memory_order_relaxed ) )
+               continue;
+            const fc::time_point start = fc::time_point::now();
+            s->observer( args... );
+            const fc::time_point end = fc::time_point::now();
+            s->calls.fetch_add( 1, std::memory_order_relaxed );
+            s->microseconds.fetch_add( ( end - start ).count(), std::memory_order_relaxed );
+            if( graphene::utilities::tracer::enabled() )
+               graphene::utilities::tracer::record( s->trace_name, start.time_since_epoch().count(),
+                                                    end.time_since_epoch().count() );
+         }
+      }
+
+      /** the connected observers in the order they are called */
+      std::vector<observer_statistics> statistics()const
+      {
+         std::vector<observer_statistics> result;
+         for( const auto& s : *std::atomic_load( &_slots ) )
+         {
+            if( !s->connected.load( std::memory_order_relaxed ) )
+               continue;
+            observer_statistics stats;
+            stats.name = s->name;
+            stats.calls = s->calls.load( std::memory_order_relaxed );
+            stats.microseconds = s->microseconds.load( std::memory_order_relaxed );
+            result.push_back( std::move(stats) );
+         }
+         return result;
+      }
+
+   private:
+      struct slot : detail::observer_slot_base
+      {
+         slot( std::string n, observer_type o ) : observer_slot_base( std::move(n) ), observer( std::move(o) ) {}
+         const observer_type observer;
+      };
+      typedef std::vector< std::shared_ptr<slot> > slot_list;
+
+      std::shared_ptr<const slot_list>  _slots = std::make_shared<const slot_list>();
+      /** serializes connect(), emissions do not take it */
+      std::mutex                        _mutex;
+};
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::observer_statistics, (name)(calls)(microseconds) )
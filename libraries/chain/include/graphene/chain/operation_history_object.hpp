@@ -50,6 +50,7 @@ namespace graphene { namespace chain {
          static const uint8_t type_id  = operation_history_object_type;
 
          operation_history_object( const operation& o ):op(o){}
+         operation_history_object( operation&& o ):op(std::move(o)){}
          operation_history_object(){}
 
          operation         op;
@@ -102,6 +103,7 @@ namespace graphene { namespace chain {
    struct by_id;
 struct by_seq;
 struct by_op;
+struct by_operation;
 typedef multi_index_container<
    account_transaction_history_object,
    indexed_by<
@@ -117,6 +119,9 @@ typedef multi_index_container<
             member< account_transaction_history_object, account_id_type, &account_transaction_history_object::account>,
             member< account_transaction_history_object, operation_history_id_type, &account_transaction_history_object::operation_id>
          >
+      >,
+      ordered_non_unique< tag<by_operation>,
+         member< account_transaction_history_object, operation_history_id_type, &account_transaction_history_object::operation_id>
       >
    >
 > account_transaction_history_multi_index_type;
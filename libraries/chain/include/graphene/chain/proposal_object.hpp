@@ -63,15 +63,16 @@ class proposal_object : public abstract_object<proposal_object>
  *
  *  This is a secondary index on the proposal_index
  *
- *  @note the set of required approvals is constant
+ *  @note the set of required approvals is constant, the available approvals are followed as
+ *  proposal updates change them
  */
 class required_approval_index : public secondary_index
 {
    public:
       virtual void object_inserted( const object& obj ) override;
       virtual void object_removed( const object& obj ) override;
-      virtual void about_to_modify( const object& before ) override{};
-      virtual void object_modified( const object& after  ) override{};
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
 
       void remove( account_id_type a, proposal_id_type p );
 
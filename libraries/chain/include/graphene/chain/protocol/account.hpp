@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/chain/protocol/base.hpp>
+#include <graphene/chain/protocol/boxed.hpp>
 #include <graphene/chain/protocol/buyback.hpp>
 #include <graphene/chain/protocol/ext.hpp>
 #include <graphene/chain/protocol/special_authority.hpp>
@@ -91,10 +92,11 @@ namespace graphene { namespace chain {
       uint16_t        referrer_percent = 0;
 
       string          name;
-      authority       owner;
-      authority       active;
+      /// The authorities and options are boxed, so they are reached with ->
+      boxed<authority>       owner;
+      boxed<authority>       active;
 
-      account_options options;
+      boxed<account_options> options;
       extension< ext > extensions;
 
       account_id_type fee_payer()const { return registrar; }
@@ -137,12 +139,12 @@ namespace graphene { namespace chain {
       account_id_type account;
 
       /// New owner authority. If set, this operation requires owner authority to execute.
-      optional<authority> owner;
+      boxed_optional<authority> owner;
       /// New active authority. This can be updated by the current active authority.
-      optional<authority> active;
+      boxed_optional<authority> active;
 
       /// New account options
-      optional<account_options> new_options;
+      boxed_optional<account_options> new_options;
       extension< ext > extensions;
 
       account_id_type fee_payer()const { return account; }
@@ -280,6 +282,14 @@ FC_REFLECT( graphene::chain::account_update_operation,
             (fee)(account)(owner)(active)(new_options)(extensions)
           )
 
+namespace fc {
+   /** leaves out the authorities and options that are not updated, as for the optionals they replace */
+   inline void to_variant( const graphene::chain::account_update_operation& op, fc::variant& var )
+   {
+      to_variant_skipping_empty( op, var );
+   }
+}
+
 FC_REFLECT( graphene::chain::account_upgrade_operation,
             (fee)(account_to_upgrade)(upgrade_to_lifetime_member)(extensions) )
 
@@ -29,6 +29,8 @@
 #include <fc/array.hpp>
 #include <fc/crypto/ripemd160.hpp>
 
+#include <array>
+
 namespace fc { namespace ecc {
     class public_key;
     typedef fc::array<char,33>  public_key_data;
@@ -74,6 +76,15 @@ namespace graphene { namespace chain {
    inline bool operator != ( const address& a, const address& b ) { return a.addr != b.addr; }
    inline bool operator <  ( const address& a, const address& b ) { return a.addr <  b.addr; }
 
+   /** the address forms an address_auth or a balance owner can use to refer to a key: four PTS variants and the native address */
+   typedef std::array<address,5> key_addresses;
+
+   /**
+    * Deriving the addresses hashes the key five times, so they are remembered per thread for the keys seen
+    * recently.  The reference stays valid until the next call on the same thread.
+    */
+   const key_addresses& addresses_of( const public_key_type& k );
+
 } } // namespace graphene::chain
 
 namespace fc
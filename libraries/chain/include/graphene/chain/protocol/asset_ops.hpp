@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/chain/protocol/base.hpp>
+#include <graphene/chain/protocol/boxed.hpp>
 #include <graphene/chain/protocol/memo.hpp>
 
 namespace graphene { namespace chain { 
@@ -137,8 +138,8 @@ namespace graphene { namespace chain {
       ///
       /// @note common_options.core_exchange_rate technically needs to store the asset ID of this new asset. Since this
       /// ID is not known at the time this operation is created, create this price as though the new asset has instance
-      /// ID 1, and the chain will overwrite it with the new asset's ID.
-      asset_options              common_options;
+      /// ID 1, and the chain will overwrite it with the new asset's ID.  Boxed, so it is reached with ->.
+      boxed<asset_options>       common_options;
       /// Options only available for BitAssets. MUST be non-null if and only if the @ref market_issued flag is set in
       /// common_options.flags
       optional<bitasset_options> bitasset_opts;
@@ -283,7 +284,8 @@ namespace graphene { namespace chain {
 
       /// If the asset is to be given a new issuer, specify his ID here.
       optional<account_id_type>   new_issuer;
-      asset_options               new_options;
+      /// Boxed, so it is reached with ->
+      boxed<asset_options>        new_options;
       extensions_type             extensions;
 
       account_id_type fee_payer()const { return issuer; }
@@ -24,6 +24,8 @@
 #pragma once
 #include <graphene/chain/protocol/transaction.hpp>
 
+#include <functional>
+
 namespace graphene { namespace chain {
 
    struct block_header
@@ -52,6 +54,12 @@ namespace graphene { namespace chain {
    struct signed_block : public signed_block_header
    {
       checksum_type calculate_merkle_root()const;
+      /**
+       * The same root, with the hashing of the transaction digests and of each level of the tree handed to
+       * for_each( count, task ), which must call task( n ) once for every n < count in any order or concurrently.
+       */
+      checksum_type calculate_merkle_root(
+         const std::function<void( size_t, const std::function<void(size_t)>& )>& for_each )const;
       vector<processed_transaction> transactions;
    };
 
@@ -60,3 +68,7 @@ namespace graphene { namespace chain {
 FC_REFLECT( graphene::chain::block_header, (previous)(timestamp)(witness)(transaction_merkle_root)(extensions) )
 FC_REFLECT_DERIVED( graphene::chain::signed_block_header, (graphene::chain::block_header), (witness_signature) )
 FC_REFLECT_DERIVED( graphene::chain::signed_block, (graphene::chain::signed_block_header), (transactions) )
+
+GRAPHENE_JSON_DIRECT( graphene::chain::block_header )
+GRAPHENE_JSON_DIRECT( graphene::chain::signed_block_header )
+GRAPHENE_JSON_DIRECT( graphene::chain::signed_block )
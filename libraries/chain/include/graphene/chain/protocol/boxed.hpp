@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/io/raw.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace graphene { namespace chain {
+
+/**
+ *  A member that is kept on the heap, so a large member of a rarely used operation does not set the size of
+ *  every operation.
+ *
+ *  operation is a static_variant, as large as its largest alternative, and it is held by every transaction,
+ *  history object and fork database entry.  A boxed member takes one pointer in its operation.  It is packed,
+ *  converted to and from variants and compared as the T it holds, so the binary and JSON forms do not change.
+ *  A box that was never written holds no allocation and reads as a default constructed T; the members are
+ *  reached with -> and * instead of the dot.
+ */
+template< typename T >
+class boxed
+{
+   public:
+      boxed() {}
+      boxed( const T& value ) : _value( new T( value ) ) {}
+      boxed( T&& value ) : _value( new T( std::move( value ) ) ) {}
+      boxed( const boxed& other ) : _value( other._value ? new T( *other._value ) : nullptr ) {}
+      boxed( boxed&& other ) : _value( std::move( other._value ) ) {}
+
+      boxed& operator=( const boxed& other )
+      {
+         if( this != &other )
+            _value.reset( other._value ? new T( *other._value ) : nullptr );
+         return *this;
+      }
+      boxed& operator=( boxed&& other ) { _value = std::move( other._value ); return *this; }
+      boxed& operator=( const T& value ) { get() = value; return *this; }
+      boxed& operator=( T&& value ) { get() = std::move( value ); return *this; }
+
+      const T& operator*()const  { return _value ? *_value : default_value(); }
+      T&       operator*()       { return get(); }
+      const T* operator->()const { return &**this; }
+      T*       operator->()      { return &get(); }
+      operator const T&()const   { return **this; }
+
+   private:
+      T& get()
+      {
+         if( !_value )
+            _value.reset( new T() );
+         return *_value;
+      }
+
+      static const T& default_value()
+      {
+         static const T value = T();
+         return value;
+      }
+
+      std::unique_ptr<T> _value;
+};
+
+/**
+ *  An fc::optional whose value is kept on the heap, for the same reason as boxed.  It has the interface of
+ *  fc::optional that the operations use and is packed and converted to variants as one.  A reflected type with
+ *  boxed_optional members needs a to_variant() that calls to_variant_skipping_empty(), because the reflected
+ *  to_variant() leaves out empty fc::optional members only.
+ */
+template< typename T >
+class boxed_optional
+{
+   public:
+      typedef T value_type;
+
+      boxed_optional() {}
+      boxed_optional( const T& value ) : _value( new T( value ) ) {}
+      boxed_optional( T&& value ) : _value( new T( std::move( value ) ) ) {}
+      boxed_optional( const fc::optional<T>& value ) : _value( value.valid() ? new T( *value ) : nullptr ) {}
+      boxed_optional( const boxed_optional& other ) : _value( other._value ? new T( *other._value ) : nullptr ) {}
+      boxed_optional( boxed_optional&& other ) : _value( std::move( other._value ) ) {}
+
+      boxed_optional& operator=( const boxed_optional& other )
+      {
+         if( this != &other )
+            _value.reset( other._value ? new T( *other._value ) : nullptr );
+         return *this;
+      }
+      boxed_optional& operator=( boxed_optional&& other ) { _value = std::move( other._value ); return *this; }
+      boxed_optional& operator=( const T& value ) { _value.reset( new T( value ) ); return *this; }
+      boxed_optional& operator=( T&& value ) { _value.reset( new T( std::move( value ) ) ); return *this; }
+
+      bool valid()const { return bool( _value ); }
+      explicit operator bool()const { return valid(); }
+      bool operator!()const { return !valid(); }
+      void reset() { _value.reset(); }
+
+      const T& operator*()const  { assert( valid() ); return *_value; }
+      T&       operator*()       { assert( valid() ); return *_value; }
+      const T* operator->()const { assert( valid() ); return _value.get(); }
+      T*       operator->()      { assert( valid() ); return _value.get(); }
+
+   private:
+      std::unique_ptr<T> _value;
+};
+
+template< typename T > bool operator==( const boxed<T>& a, const boxed<T>& b ) { return *a == *b; }
+template< typename T > bool operator==( const boxed<T>& a, const T& b )        { return *a == b; }
+template< typename T > bool operator==( const T& a, const boxed<T>& b )        { return a == *b; }
+template< typename T > bool operator!=( const boxed<T>& a, const boxed<T>& b ) { return !( a == b ); }
+template< typename T > bool operator!=( const boxed<T>& a, const T& b )        { return !( a == b ); }
+template< typename T > bool operator!=( const T& a, const boxed<T>& b )        { return !( a == b ); }
+
+template< typename T >
+bool operator==( const boxed_optional<T>& a, const boxed_optional<T>& b )
+{
+   return a.valid() == b.valid() && ( !a.valid() || *a == *b );
+}
+template< typename T >
+bool operator!=( const boxed_optional<T>& a, const boxed_optional<T>& b ) { return !( a == b ); }
+
+template< typename Stream, typename T >
+void operator<<( Stream& s, const boxed<T>& value )
+{
+   fc::raw::pack( s, *value );
+}
+
+template< typename Stream, typename T >
+void operator>>( Stream& s, boxed<T>& value )
+{
+   fc::raw::unpack( s, *value );
+}
+
+template< typename Stream, typename T >
+void operator<<( Stream& s, const boxed_optional<T>& value )
+{
+   fc::raw::pack( s, value.valid() );
+   if( value.valid() )
+      fc::raw::pack( s, *value );
+}
+
+template< typename Stream, typename T >
+void operator>>( Stream& s, boxed_optional<T>& value )
+{
+   bool valid;
+   fc::raw::unpack( s, valid );
+   if( !valid )
+   {
+      value.reset();
+      return;
+   }
+   T temp;
+   fc::raw::unpack( s, temp );
+   value = std::move( temp );
+}
+
+} } // graphene::chain
+
+namespace fc {
+
+template< typename T >
+void to_variant( const graphene::chain::boxed<T>& value, fc::variant& var )
+{
+   to_variant( *value, var );
+}
+
+template< typename T >
+void from_variant( const fc::variant& var, graphene::chain::boxed<T>& value )
+{
+   from_variant( var, *value );
+}
+
+template< typename T >
+void to_variant( const graphene::chain::boxed_optional<T>& value, fc::variant& var )
+{
+   if( value.valid() )
+      to_variant( *value, var );
+   else
+      var = fc::variant();
+}
+
+template< typename T >
+void from_variant( const fc::variant& var, graphene::chain::boxed_optional<T>& value )
+{
+   if( var.is_null() )
+   {
+      value.reset();
+      return;
+   }
+   T temp;
+   from_variant( var, temp );
+   value = std::move( temp );
+}
+
+template< typename T >
+struct get_typename< graphene::chain::boxed<T> >
+{
+   static const char* name() { return get_typename<T>::name(); }
+};
+
+template< typename T >
+struct get_typename< graphene::chain::boxed_optional<T> >
+{
+   static const char* name()
+   {
+      static std::string _str = std::string( "fc::optional<" ) + get_typename<T>::name() + ">";
+      return _str.c_str();
+   }
+};
+
+template< typename T >
+struct graphene_boxed_to_variant_visitor
+{
+   graphene_boxed_to_variant_visitor( const T& v ) : value(v) {}
+
+   template<typename Member, class Class, Member (Class::*member)>
+   void operator()( const char* name )const
+   {
+      add( name, value.*member );
+   }
+
+   template< typename M >
+   void add( const char* name, const M& member )const { mvo( name, member ); }
+   template< typename M >
+   void add( const char* name, const fc::optional<M>& member )const
+   {
+      if( member.valid() )
+         mvo( name, *member );
+   }
+   template< typename M >
+   void add( const char* name, const graphene::chain::boxed_optional<M>& member )const
+   {
+      if( member.valid() )
+         mvo( name, *member );
+   }
+
+   const T& value;
+   mutable mutable_variant_object mvo;
+};
+
+/** the reflected to_variant() of @ref value, which also leaves out its empty boxed_optional members */
+template< typename T >
+void to_variant_skipping_empty( const T& value, fc::variant& var )
+{
+   graphene_boxed_to_variant_visitor<T> vtor( value );
+   fc::reflector<T>::visit( vtor );
+   var = vtor.mvo;
+}
+
+} // fc
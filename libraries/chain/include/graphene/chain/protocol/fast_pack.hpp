@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/asset.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cstring>
+#include <type_traits>
+
+namespace graphene { namespace chain {
+
+/**
+ *  Serializers for the small fixed layout types that make up most of the bytes hashed and stored per block.
+ *
+ *  fc::raw walks the reflected members and calls the stream for every one of them.  The functions here write
+ *  the same bytes straight into a buffer sized with packed_size(), so the result is interchangeable with
+ *  fc::raw::pack() and fc::raw::unpack() of the same types.  Like fc::raw, integers are written in host byte
+ *  order and object ids as their varint instance.  pack_to_vector() and hash() pick this path for the types with
+ *  has_fast_pack and fall back to fc::raw for all others.
+ */
+namespace fast_pack {
+
+   template<typename T> struct has_fast_pack : std::false_type {};
+   template<> struct has_fast_pack<object_id_type>      : std::true_type {};
+   template<> struct has_fast_pack<asset>               : std::true_type {};
+   template<> struct has_fast_pack<price>               : std::true_type {};
+   template<> struct has_fast_pack<block_header>        : std::true_type {};
+   template<> struct has_fast_pack<signed_block_header> : std::true_type {};
+
+   inline size_t varint_size( uint64_t value )
+   {
+      size_t size = 1;
+      while( value >>= 7 )
+         ++size;
+      return size;
+   }
+
+   inline char* write_varint( char* out, uint64_t value )
+   {
+      do
+      {
+         uint8_t b = uint8_t( value ) & 0x7f;
+         value >>= 7;
+         b |= uint8_t( value > 0 ) << 7;
+         *out++ = char( b );
+      } while( value );
+      return out;
+   }
+
+   inline const char* read_varint( const char* in, const char* end, uint64_t& value )
+   {
+      value = 0;
+      uint32_t shift = 0;
+      uint8_t b;
+      do
+      {
+         FC_ASSERT( in < end, "Unexpected end of packed data" );
+         FC_ASSERT( shift < 64, "Varint is too long" );
+         b = uint8_t( *in++ );
+         value |= uint64_t( b & 0x7f ) << shift;
+         shift += 7;
+      } while( b & 0x80 );
+      return in;
+   }
+
+   template<typename T>
+   inline char* write_raw( char* out, const T& value )
+   {
+      memcpy( out, &value, sizeof(value) );
+      return out + sizeof(value);
+   }
+
+   template<typename T>
+   inline const char* read_raw( const char* in, const char* end, T& value )
+   {
+      FC_ASSERT( size_t( end - in ) >= sizeof(value), "Unexpected end of packed data" );
+      memcpy( &value, in, sizeof(value) );
+      return in + sizeof(value);
+   }
+
+   template<uint8_t SpaceID, uint8_t TypeID, typename T>
+   inline size_t packed_size( const object_id<SpaceID,TypeID,T>& id ) { return varint_size( id.instance.value ); }
+   template<uint8_t SpaceID, uint8_t TypeID, typename T>
+   inline char* pack( char* out, const object_id<SpaceID,TypeID,T>& id ) { return write_varint( out, id.instance.value ); }
+   template<uint8_t SpaceID, uint8_t TypeID, typename T>
+   inline const char* unpack( const char* in, const char* end, object_id<SpaceID,TypeID,T>& id )
+   {
+      uint64_t instance;
+      in = read_varint( in, end, instance );
+      id.instance.value = static_cast<decltype( id.instance.value )>( instance );
+      return in;
+   }
+
+   inline size_t packed_size( const object_id_type& id ) { return sizeof(id.number); }
+   inline char* pack( char* out, const object_id_type& id ) { return write_raw( out, id.number ); }
+   inline const char* unpack( const char* in, const char* end, object_id_type& id ) { return read_raw( in, end, id.number ); }
+
+   inline size_t packed_size( const asset& a ) { return sizeof(a.amount.value) + packed_size( a.asset_id ); }
+   inline char* pack( char* out, const asset& a ) { return pack( write_raw( out, a.amount.value ), a.asset_id ); }
+   inline const char* unpack( const char* in, const char* end, asset& a )
+   {
+      return unpack( read_raw( in, end, a.amount.value ), end, a.asset_id );
+   }
+
+   inline size_t packed_size( const price& p ) { return packed_size( p.base ) + packed_size( p.quote ); }
+   inline char* pack( char* out, const price& p ) { return pack( pack( out, p.base ), p.quote ); }
+   inline const char* unpack( const char* in, const char* end, price& p ) { return unpack( unpack( in, end, p.base ), end, p.quote ); }
+
+   /** the extensions of a header are always empty so far, they still go through fc::raw when they are not */
+   inline size_t packed_size( const block_header& h )
+   {
+      return sizeof(h.previous._hash) + sizeof(uint32_t) + packed_size( h.witness ) + sizeof(h.transaction_merkle_root._hash)
+             + ( h.extensions.empty() ? 1 : fc::raw::pack_size( h.extensions ) );
+   }
+   inline char* pack( char* out, const block_header& h )
+   {
+      out = write_raw( out, h.previous._hash );
+      out = write_raw( out, h.timestamp.sec_since_epoch() );
+      out = pack( out, h.witness );
+      out = write_raw( out, h.transaction_merkle_root._hash );
+      if( h.extensions.empty() )
+      {
+         *out++ = 0;
+         return out;
+      }
+      const size_t size = fc::raw::pack_size( h.extensions );
+      fc::datastream<char*> ds( out, size );
+      fc::raw::pack( ds, h.extensions );
+      return out + size;
+   }
+   inline const char* unpack( const char* in, const char* end, block_header& h )
+   {
+      uint32_t timestamp;
+      in = read_raw( in, end, h.previous._hash );
+      in = read_raw( in, end, timestamp );
+      h.timestamp = fc::time_point_sec( timestamp );
+      in = unpack( in, end, h.witness );
+      in = read_raw( in, end, h.transaction_merkle_root._hash );
+      FC_ASSERT( in < end, "Unexpected end of packed data" );
+      h.extensions.clear();
+      if( *in == 0 )
+         return in + 1;
+      fc::datastream<const char*> ds( in, end - in );
+      fc::raw::unpack( ds, h.extensions );
+      return in + ds.tellp();
+   }
+
+   inline size_t packed_size( const signed_block_header& h )
+   {
+      return packed_size( static_cast<const block_header&>( h ) ) + sizeof(h.witness_signature.data);
+   }
+   inline char* pack( char* out, const signed_block_header& h )
+   {
+      return write_raw( pack( out, static_cast<const block_header&>( h ) ), h.witness_signature.data );
+   }
+   inline const char* unpack( const char* in, const char* end, signed_block_header& h )
+   {
+      return read_raw( unpack( in, end, static_cast<block_header&>( h ) ), end, h.witness_signature.data );
+   }
+
+   namespace detail {
+      template<typename T>
+      vector<char> pack_to_vector( const T& value, std::true_type )
+      {
+         vector<char> result( packed_size( value ) );
+         pack( result.data(), value );
+         return result;
+      }
+      template<typename T>
+      vector<char> pack_to_vector( const T& value, std::false_type ) { return fc::raw::pack( value ); }
+
+      template<typename Hash, typename T>
+      Hash hash( const T& value, std::true_type )
+      {
+         const size_t size = packed_size( value );
+         char buffer[256];
+         if( size <= sizeof(buffer) )
+         {
+            pack( buffer, value );
+            return Hash::hash( buffer, size );
+         }
+         vector<char> packed( size );
+         pack( packed.data(), value );
+         return Hash::hash( packed.data(), size );
+      }
+      template<typename Hash, typename T>
+      Hash hash( const T& value, std::false_type ) { return Hash::hash( value ); }
+   }
+
+   /** the bytes of fc::raw::pack( value ) */
+   template<typename T>
+   vector<char> pack_to_vector( const T& value )
+   {
+      return detail::pack_to_vector( value, has_fast_pack<T>() );
+   }
+
+   /** Hash::hash( value ), i.e. the hash of the bytes of fc::raw::pack( value ) */
+   template<typename Hash, typename T>
+   Hash hash( const T& value )
+   {
+      return detail::hash<Hash>( value, has_fast_pack<T>() );
+   }
+
+   /** the inverse of pack_to_vector(), the whole buffer has to be used */
+   template<typename T>
+   T unpack_from_vector( const vector<char>& data )
+   {
+      T result;
+      const char* end = data.data() + data.size();
+      FC_ASSERT( unpack( data.data(), end, result ) == end, "Trailing data after the packed value" );
+      return result;
+   }
+
+} } } // graphene::chain::fast_pack
@@ -60,9 +60,9 @@ namespace graphene { namespace chain {
       template<typename Operation>
       const typename Operation::fee_parameters_type& get()const
       {
-         auto itr = parameters.find( typename Operation::fee_parameters_type() );
-         FC_ASSERT( itr != parameters.end() );
-         return itr->template get<typename Operation::fee_parameters_type>();
+         const fee_parameters* params = find_parameters( fee_parameters::tag<typename Operation::fee_parameters_type>::value );
+         FC_ASSERT( params != nullptr );
+         return params->template get<typename Operation::fee_parameters_type>();
       }
       template<typename Operation>
       typename Operation::fee_parameters_type& get()
@@ -72,6 +72,23 @@ namespace graphene { namespace chain {
          return itr->template get<typename Operation::fee_parameters_type>();
       }
 
+      /**
+       *  The parameters for the operation with tag which, nullptr if there are none.  A complete schedule holds
+       *  one entry per operation in tag order, so the tag is also the position and no search is needed.
+       */
+      const fee_parameters* find_parameters( int which )const
+      {
+         if( which >= 0 && size_t(which) < parameters.size() )
+         {
+            const fee_parameters& candidate = *(parameters.begin() + which);
+            if( candidate.which() == which )
+               return &candidate;
+         }
+         fee_parameters key; key.set_which( which );
+         auto itr = parameters.find( key );
+         return itr == parameters.end() ? nullptr : &*itr;
+      }
+
       /**
        *  @note must be sorted by fee_parameters.which() and have no duplicates
        */
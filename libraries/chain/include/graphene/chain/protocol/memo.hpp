@@ -64,6 +64,8 @@ namespace graphene { namespace chain {
 
       std::string get_message(const fc::ecc::private_key& priv,
                               const fc::ecc::public_key& pub)const;
+      /// as above, given the ECDH shared secret of one of the two private keys and the other public key
+      std::string get_message(const fc::sha512& shared_secret)const;
    };
 
    /**
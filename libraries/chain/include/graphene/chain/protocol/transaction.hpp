@@ -25,6 +25,8 @@
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/chain/protocol/types.hpp>
 
+#include <graphene/db/json_encoder.hpp>
+
 #include <numeric>
 
 namespace graphene { namespace chain {
@@ -165,12 +167,28 @@ namespace graphene { namespace chain {
          uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH
          ) const;
 
-      flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
+      /**
+       * Recovers the public keys of all signatures.  The result is cached and reused as long as
+       * neither the signed digest nor the signatures change, so the keys can be recovered ahead of
+       * time, e.g. on another thread, and the later authority checks only compare them.
+       */
+      const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const;
+
+      /** as above, but keys that are not cached yet are recovered by calling recover( signature, digest ) */
+      const flat_set<public_key_type>& get_signature_keys(
+         const chain_id_type& chain_id,
+         const std::function<public_key_type( const signature_type&, const digest_type& )>& recover )const;
 
       vector<signature_type> signatures;
 
       /// Removes all operations and signatures
       void clear() { operations.clear(); signatures.clear(); }
+
+   private:
+      mutable bool                      _signees_valid = false;
+      mutable digest_type               _signees_digest;
+      mutable vector<signature_type>    _signees_signatures;
+      mutable flat_set<public_key_type> _signees;
    };
 
    void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
@@ -181,6 +199,18 @@ namespace graphene { namespace chain {
                           const flat_set<account_id_type>& active_aprovals = flat_set<account_id_type>(),
                           const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>());
 
+   /**
+    * The same checks as verify_authority(), returning false where it would throw.  Cheaper when failing is the
+    * usual outcome, as for proposals still collecting approvals, since no exception is built.
+    */
+   bool is_authorized( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
+                       const std::function<const authority*(account_id_type)>& get_active,
+                       const std::function<const authority*(account_id_type)>& get_owner,
+                       uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
+                       bool allow_committe = false,
+                       const flat_set<account_id_type>& active_aprovals = flat_set<account_id_type>(),
+                       const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>());
+
    /**
     *  @brief captures the result of evaluating the operations contained in the transaction
     *
@@ -211,3 +241,7 @@ namespace graphene { namespace chain {
 FC_REFLECT( graphene::chain::transaction, (ref_block_num)(ref_block_prefix)(expiration)(operations)(extensions) )
 FC_REFLECT_DERIVED( graphene::chain::signed_transaction, (graphene::chain::transaction), (signatures) )
 FC_REFLECT_DERIVED( graphene::chain::processed_transaction, (graphene::chain::signed_transaction), (operation_results) )
+
+GRAPHENE_JSON_DIRECT( graphene::chain::transaction )
+GRAPHENE_JSON_DIRECT( graphene::chain::signed_transaction )
+GRAPHENE_JSON_DIRECT( graphene::chain::processed_transaction )
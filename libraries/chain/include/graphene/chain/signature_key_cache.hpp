@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Bounded LRU map from (signature digest, signature) to the public key it recovers to
+    *
+    * Filled whenever the database recovers signature keys, e.g. when a transaction is admitted to the
+    * pending pool, so the same signatures do not have to go through ECDSA recovery again when the
+    * transaction is re-applied later (from a block, after a fork switch or when generating a block).
+    * recover() may be called from several threads at once.
+    */
+   class signature_key_cache
+   {
+      public:
+         explicit signature_key_cache( size_t capacity = 0 ) : _capacity( capacity ) {}
+
+         /** a capacity of 0 disables the cache, recover() then always recovers the key */
+         void   set_capacity( size_t capacity );
+         size_t capacity()const { return _capacity; }
+         size_t size()const;
+
+         public_key_type recover( const signature_type& sig, const digest_type& digest );
+
+         uint64_t hits()const   { return _hits; }
+         uint64_t misses()const { return _misses; }
+
+      private:
+         struct key_type
+         {
+            digest_type    digest;
+            signature_type sig;
+
+            bool operator == ( const key_type& other )const { return digest == other.digest && sig == other.sig; }
+         };
+
+         struct key_hash
+         {
+            size_t operator()( const key_type& k )const;
+         };
+
+         typedef std::list< std::pair<key_type, public_key_type> > lru_list;
+
+         void trim();
+
+         mutable std::mutex                                                 _mutex;
+         size_t                                                             _capacity;
+         lru_list                                                           _lru;   ///< most recently used first
+         std::unordered_map< key_type, lru_list::iterator, key_hash >      _entries;
+         uint64_t                                                           _hits   = 0;
+         uint64_t                                                           _misses = 0;
+   };
+
+} }
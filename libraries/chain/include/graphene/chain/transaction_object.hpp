@@ -43,6 +43,9 @@ namespace graphene { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * The transaction itself is only kept for pending transactions, and for transactions in blocks when the database
+    * is told to keep their bodies.  Otherwise database::get_recent_transaction() reads it back from its block.
     */
    class transaction_object : public abstract_object<transaction_object>
    {
@@ -50,10 +53,12 @@ namespace graphene { namespace chain {
          static const uint8_t space_id = implementation_ids;
          static const uint8_t type_id  = impl_transaction_object_type;
 
-         signed_transaction  trx;
-         transaction_id_type trx_id;
-
-         time_point_sec get_expiration()const { return trx.expiration; }
+         optional<signed_transaction> trx;
+         transaction_id_type          trx_id;
+         time_point_sec               expiration;
+         /** the block containing the transaction and its position there, 0 while the transaction is pending */
+         uint32_t                     block_num    = 0;
+         uint16_t                     trx_in_block = 0;
    };
 
    struct by_expiration;
@@ -64,11 +69,11 @@ namespace graphene { namespace chain {
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), std::hash<transaction_id_type> >,
-         ordered_non_unique< tag<by_expiration>, const_mem_fun<transaction_object, time_point_sec, &transaction_object::get_expiration > >
+         ordered_non_unique< tag<by_expiration>, member<transaction_object, time_point_sec, &transaction_object::expiration > >
       >
    > transaction_multi_index_type;
 
    typedef generic_index<transaction_object, transaction_multi_index_type> transaction_index;
 } }
 
-FC_REFLECT_DERIVED( graphene::chain::transaction_object, (graphene::db::object), (trx)(trx_id) )
+FC_REFLECT_DERIVED( graphene::chain::transaction_object, (graphene::db::object), (trx)(trx_id)(expiration)(block_num)(trx_in_block) )
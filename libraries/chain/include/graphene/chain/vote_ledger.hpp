@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/protocol/account.hpp>
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/index.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace graphene { namespace chain {
+
+class account_object;
+class database;
+class global_property_object;
+
+/**
+ *  @brief The part of an account's options that decides how the stake voting with it is counted
+ */
+struct vote_opinion
+{
+   vote_opinion() {}
+   explicit vote_opinion( const account_options& options );
+
+   flat_set<vote_id_type> votes;
+   uint16_t               num_witness = 0;
+   uint16_t               num_committee = 0;
+};
+
+/**
+ *  @brief Vote totals of some group of accounts, which end up in the vote tally buffers of the database
+ */
+struct vote_tally
+{
+   vote_tally() {}
+   explicit vote_tally( const global_property_object& props );
+
+   /** counts @ref voting_stake for the votes of @ref opinion */
+   void add( const vote_opinion& opinion, uint64_t voting_stake );
+   /** takes back a stake counted by add() */
+   void remove( const vote_opinion& opinion, uint64_t voting_stake );
+   void merge( const vote_tally& other );
+
+   bool operator == ( const vote_tally& other )const;
+
+   vector<uint64_t> votes;
+   vector<uint64_t> witness_count_histogram;
+   vector<uint64_t> committee_count_histogram;
+   uint64_t         total_voting_stake = 0;
+   uint16_t         maximum_witness_count = 0;
+   uint16_t         maximum_committee_count = 0;
+};
+
+/**
+ *  @brief Keeps the votes of the stake in balances and open orders counted between maintenance intervals
+ *
+ *  vote_ledger_index reports every account whose balance, open orders or options change, as well as the accounts
+ *  that let a changed account vote for them.  update() only recounts these, so a maintenance interval costs
+ *  O(changed accounts) instead of a pass over all accounts.  The stake in cashback vesting balances changes while
+ *  maintenance processes fees and is left to database::perform_chain_maintenance().
+ *
+ *  Until reset() fills it with a full count the ledger is not valid, and it becomes invalid again whenever the
+ *  rules of the count change, e.g. when only member votes count or the maximum witness count changes.
+ */
+class vote_ledger
+{
+   public:
+      /** the stake of @ref account as counted by a full recount */
+      struct entry
+      {
+         account_id_type account;
+         account_id_type opinion_account;
+         uint64_t        stake;
+      };
+
+      /** @return true if @ref stake_account's votes are counted at all */
+      static bool votes( const database& db, const global_property_object& props, const account_object& stake_account );
+      /** @return the stake of @ref stake_account in balances and open orders */
+      static uint64_t balance_stake( const database& db, const account_object& stake_account );
+      /** @return the account whose opinion the stake of @ref stake_account votes with */
+      static const account_object& opinion_account( const database& db, const account_object& stake_account );
+
+      /**
+       *  Recounts the changed accounts.
+       *  @return false if the ledger is not valid for @ref props, it must then be reset() from a full recount
+       */
+      bool update( const database& db, const global_property_object& props );
+      /** replaces the ledger with a full recount made from @ref entries */
+      void reset( const database& db, const global_property_object& props, const vote_tally& tally,
+                  const vector<entry>& entries );
+
+      const vote_tally& tally()const { return _tally; }
+
+      /** the options of @ref a may have changed, which changes the votes of the accounts voting with them as well */
+      void account_changed( account_id_type a );
+      void stake_changed( account_id_type a );
+
+   private:
+      struct contribution
+      {
+         account_id_type opinion_account;
+         uint64_t        stake = 0;
+      };
+      /** an opinion snapshot used by all contributions voting with the same account */
+      struct shared_opinion
+      {
+         vote_opinion opinion;
+         uint32_t     users = 0;
+         bool         out_of_range = false;
+      };
+
+      const vote_opinion& record( const database& db, account_id_type account, account_id_type opinion_account,
+                                  uint64_t stake );
+      void forget( uint64_t account );
+      void clear();
+
+      bool                                                          _valid = false;
+      vote_tally                                                    _tally;
+      /** by account instance, only accounts with some stake */
+      std::unordered_map<uint64_t, contribution>                    _contributions;
+      /** by opinion account instance */
+      std::unordered_map<uint64_t, shared_opinion>                  _opinions;
+      /** the accounts that let another account vote for them, by instance of that account */
+      std::unordered_map<uint64_t, std::unordered_set<uint64_t>>    _followers;
+      std::unordered_set<uint64_t>                                  _changed;
+      /** number of contributions with votes beyond the tally, which would count once the tally grows */
+      uint32_t                                                      _out_of_range = 0;
+};
+
+/**
+ *  @brief Reports changes of accounts, account balances and account statistics to a vote_ledger, added as a
+ *  secondary index of each of these indexes.
+ */
+class vote_ledger_index : public secondary_index
+{
+   public:
+      explicit vote_ledger_index( vote_ledger& ledger ) : _ledger( ledger ) {}
+
+      virtual void object_inserted( const object& obj ) override { changed( obj ); }
+      virtual void object_removed( const object& obj ) override  { changed( obj ); }
+      virtual void object_modified( const object& after  ) override { changed( after ); }
+
+   private:
+      void changed( const object& obj );
+
+      vote_ledger& _ledger;
+};
+
+} } // graphene::chain
@@ -25,6 +25,7 @@
 #include <graphene/chain/protocol/asset.hpp>
 #include <graphene/db/object.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
    using namespace graphene::db;
@@ -52,6 +53,7 @@ namespace graphene { namespace chain {
 
    struct by_account;
    struct by_vote_id;
+   struct by_votes;
    struct by_last_block;
    using witness_multi_index_type = multi_index_container<
       witness_object,
@@ -64,6 +66,18 @@ namespace graphene { namespace chain {
          >,
          ordered_unique< tag<by_vote_id>,
             member<witness_object, vote_id_type, &witness_object::vote_id>
+         >,
+         /// most votes first, ties go to the lower vote_id, see database::sort_votable_objects()
+         ordered_unique< tag<by_votes>,
+            composite_key<
+               witness_object,
+               member<witness_object, uint64_t, &witness_object::total_votes>,
+               member<witness_object, vote_id_type, &witness_object::vote_id>
+            >,
+            composite_key_compare<
+               std::greater< uint64_t >,
+               std::less< vote_id_type >
+            >
          >
       >
    >;
@@ -74,7 +74,7 @@ struct vesting_balance_worker_type
    /// The balance this worker pays into
    vesting_balance_id_type balance;
 
-   void pay_worker(share_type pay, database& db);
+   void pay_worker(share_type pay, database& db)const;
 };
 
 /**
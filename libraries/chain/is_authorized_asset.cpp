@@ -27,12 +27,68 @@
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
 
 namespace graphene { namespace chain {
 
+bool authorized_asset_cache::find( account_id_type account, asset_id_type asset, bool after_hardfork_415,
+                                   bool& authorized )const
+{
+   auto itr = _verdicts.find( std::make_pair( account, asset ) );
+   if( itr == _verdicts.end() || itr->second.after_hardfork_415 != after_hardfork_415 )
+      return false;
+   authorized = itr->second.authorized;
+   return true;
+}
+
+void authorized_asset_cache::store( account_id_type account, asset_id_type asset, bool after_hardfork_415,
+                                    bool authorized )
+{
+   if( _verdicts.size() >= max_verdicts )
+   {
+      _verdicts.clear();
+      _by_asset.clear();
+   }
+   verdict& v = _verdicts[ std::make_pair( account, asset ) ];
+   v.after_hardfork_415 = after_hardfork_415;
+   v.authorized = authorized;
+   _by_asset.insert( std::make_pair( asset, account ) );
+}
+
+void authorized_asset_cache::account_changed( account_id_type a )
+{
+   auto itr = _verdicts.lower_bound( std::make_pair( a, asset_id_type() ) );
+   while( itr != _verdicts.end() && itr->first.first == a )
+   {
+      _by_asset.erase( std::make_pair( itr->first.second, a ) );
+      itr = _verdicts.erase( itr );
+   }
+}
+
+void authorized_asset_cache::asset_changed( asset_id_type a )
+{
+   auto itr = _by_asset.lower_bound( std::make_pair( a, account_id_type() ) );
+   while( itr != _by_asset.end() && itr->first == a )
+   {
+      _verdicts.erase( std::make_pair( itr->second, a ) );
+      itr = _by_asset.erase( itr );
+   }
+}
+
+void authorized_asset_cache_index::changed( const object& obj )
+{
+   if( obj.id.space() == protocol_ids && obj.id.type() == account_object_type )
+      _cache.account_changed( obj.id );
+   else
+   {
+      assert( dynamic_cast<const asset_object*>(&obj) ); // for debug only
+      _cache.asset_changed( obj.id );
+   }
+}
+
 namespace detail {
 
-bool _is_authorized_asset(
+static bool check_authorized_asset(
    const database& d,
    const account_object& acct,
    const asset_object& asset_obj)
@@ -65,6 +121,21 @@ bool _is_authorized_asset(
    return false;
 }
 
+bool _is_authorized_asset(
+   const database& d,
+   const account_object& acct,
+   const asset_object& asset_obj)
+{
+   authorized_asset_cache& cache = d.get_authorized_asset_cache();
+   const bool after_hardfork_415 = d.head_block_time() > HARDFORK_415_TIME;
+   bool authorized;
+   if( cache.find( acct.id, asset_obj.id, after_hardfork_415, authorized ) )
+      return authorized;
+   authorized = check_authorized_asset( d, acct, asset_obj );
+   cache.store( acct.id, asset_obj.id, after_hardfork_415, authorized );
+   return authorized;
+}
+
 } // detail
 
 } } // graphene::chain
@@ -44,8 +44,8 @@ void_result limit_order_create_evaluator::do_evaluate(const limit_order_create_o
    FC_ASSERT( op.expiration >= d.head_block_time() );
 
    _seller        = this->fee_paying_account;
-   _sell_asset    = &op.amount_to_sell.asset_id(d);
-   _receive_asset = &op.min_to_receive.asset_id(d);
+   _sell_asset    = &d.get_typed<asset_index>( op.amount_to_sell.asset_id );
+   _receive_asset = &d.get_typed<asset_index>( op.min_to_receive.asset_id );
 
    if( _sell_asset->options.whitelist_markets.size() )
       FC_ASSERT( _sell_asset->options.whitelist_markets.find(_receive_asset->id) != _sell_asset->options.whitelist_markets.end() );
@@ -71,7 +71,7 @@ void limit_order_create_evaluator::pay_fee()
 
 object_id_type limit_order_create_evaluator::do_apply(const limit_order_create_operation& op)
 { try {
-   const auto& seller_stats = _seller->statistics(db());
+   const auto& seller_stats = db().get_typed<account_statistics_index>( _seller->statistics );
    db().modify(seller_stats, [&](account_statistics_object& bal) {
          if( op.amount_to_sell.asset_id == asset_id_type() )
          {
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/uint128.hpp>
+
+#include <limits>
+#include <tuple>
+
+namespace graphene { namespace chain {
+
+price_key::price_key( const price& p )
+: base_asset( p.base.asset_id.instance.value ),
+  quote_asset( p.quote.asset_id.instance.value ),
+  base_amount( p.base.amount.value ),
+  quote_amount( p.quote.amount.value )
+{
+   if( quote_amount <= 0 )
+   {
+      // no valid price is this high, ties are left to the exact comparison
+      ratio_hi = ratio_lo = std::numeric_limits<uint64_t>::max();
+   }
+   else if( base_amount > 0 )
+   {
+      const fc::uint128 ratio = fc::uint128( uint64_t(base_amount), 0 ) / fc::uint128( uint64_t(quote_amount) );
+      ratio_hi = ratio.hi;
+      ratio_lo = ratio.lo;
+   }
+}
+
+/** a.base/a.quote < b.base/b.quote for amounts of the same pair of assets */
+static bool ratio_less( int64_t a_base, int64_t a_quote, int64_t b_base, int64_t b_quote )
+{
+   return fc::uint128( uint64_t(b_quote) ) * fc::uint128( uint64_t(a_base) )
+        < fc::uint128( uint64_t(a_quote) ) * fc::uint128( uint64_t(b_base) );
+}
+
+bool operator < ( const price_key& a, const price_key& b )
+{
+   const auto ka = std::tie( a.base_asset, a.quote_asset, a.ratio_hi, a.ratio_lo );
+   const auto kb = std::tie( b.base_asset, b.quote_asset, b.ratio_hi, b.ratio_lo );
+   if( ka != kb )
+      return ka < kb;
+   return ratio_less( a.base_amount, a.quote_amount, b.base_amount, b.quote_amount );
+}
+
+bool operator < ( const price_key& a, const price& b )
+{
+   const uint64_t b_base_asset = b.base.asset_id.instance.value;
+   const uint64_t b_quote_asset = b.quote.asset_id.instance.value;
+   if( std::tie( a.base_asset, a.quote_asset ) != std::tie( b_base_asset, b_quote_asset ) )
+      return std::tie( a.base_asset, a.quote_asset ) < std::tie( b_base_asset, b_quote_asset );
+   return ratio_less( a.base_amount, a.quote_amount, b.base.amount.value, b.quote.amount.value );
+}
+
+bool operator < ( const price& a, const price_key& b )
+{
+   const uint64_t a_base_asset = a.base.asset_id.instance.value;
+   const uint64_t a_quote_asset = a.quote.asset_id.instance.value;
+   if( std::tie( a_base_asset, a_quote_asset ) != std::tie( b.base_asset, b.quote_asset ) )
+      return std::tie( a_base_asset, a_quote_asset ) < std::tie( b.base_asset, b.quote_asset );
+   return ratio_less( a.base.amount.value, a.quote.amount.value, b.base_amount, b.quote_amount );
+}
+
+void limit_order_book_index::add( const price& p, share_type for_sale, int32_t orders )
+{
+   auto market = std::make_pair( p.base.asset_id, p.quote.asset_id );
+   levels_type& levels = _levels[market];
+   order_book_level& level = levels[p];
+   level.for_sale += for_sale;
+   level.orders += orders;
+   changed( p );
+   if( level.orders == 0 )
+   {
+      levels.erase( p );
+      if( levels.empty() )
+         _levels.erase( market );
+   }
+}
+
+void limit_order_book_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) ); // for debug only
+   const limit_order_object& o = static_cast<const limit_order_object&>(obj);
+   add( o.sell_price, o.for_sale, 1 );
+}
+
+void limit_order_book_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) ); // for debug only
+   const limit_order_object& o = static_cast<const limit_order_object&>(obj);
+   add( o.sell_price, -o.for_sale, -1 );
+}
+
+void limit_order_book_index::about_to_modify( const object& before )
+{
+   const limit_order_object& o = static_cast<const limit_order_object&>(before);
+   _before_price = o.sell_price;
+   _before_for_sale = o.for_sale;
+}
+
+void limit_order_book_index::object_modified( const object& after )
+{
+   const limit_order_object& o = static_cast<const limit_order_object&>(after);
+   if( o.sell_price == _before_price )
+   {
+      _levels[ std::make_pair( o.sell_price.base.asset_id, o.sell_price.quote.asset_id ) ][ o.sell_price ].for_sale
+         += o.for_sale - _before_for_sale;
+      changed( o.sell_price );
+      return;
+   }
+   add( _before_price, -_before_for_sale, -1 );
+   add( o.sell_price, o.for_sale, 1 );
+}
+
+const limit_order_book_index::levels_type* limit_order_book_index::get_levels( asset_id_type base, asset_id_type quote )const
+{
+   auto itr = _levels.find( std::make_pair( base, quote ) );
+   if( itr == _levels.end() )
+      return nullptr;
+   return &itr->second;
+}
+
+const limit_order_book_index::deltas_type& limit_order_book_index::get_deltas( const block_id_type& block_id,
+                                                                              uint32_t last_irreversible_block_num )const
+{
+   for( auto itr = _deltas.begin(); itr != _deltas.end(); )
+   {
+      if( itr->first != block_id && block_header::num_from_id( itr->first ) <= last_irreversible_block_num )
+         itr = _deltas.erase( itr );
+      else
+         ++itr;
+   }
+   auto cached = _deltas.find( block_id );
+   if( _track_changes && cached != _deltas.end() )
+      return cached->second;
+   _track_changes = true;
+   deltas_type& result = _deltas[ block_id ];
+   result.clear();
+
+   map< pair<asset_id_type,asset_id_type>, vector<order_book_delta> > deltas;
+   for( const price& p : _changed )
+   {
+      order_book_delta delta;
+      delta.sell_price = p;
+      if( const levels_type* levels = get_levels( p.base.asset_id, p.quote.asset_id ) )
+      {
+         auto itr = levels->find( p );
+         if( itr != levels->end() )
+         {
+            delta.for_sale = itr->second.for_sale;
+            delta.orders = itr->second.orders;
+         }
+      }
+      deltas[ std::minmax( p.base.asset_id, p.quote.asset_id ) ].push_back( delta );
+   }
+   _changed.clear();
+
+   for( const auto& market : deltas )
+      result[ market.first ] = fc::variant( market.second );
+   return result;
+}
+
+void margin_call_check_cache::mark_checked( asset_id_type mia, asset_id_type backing, asset_bitasset_data_id_type bitasset )
+{
+   _checked[mia] = backing;
+   _bitasset_owner[bitasset] = mia;
+}
+
+void margin_call_check_cache::asset_changed( asset_id_type a )
+{
+   ++_changes;
+   _checked.erase( a );
+}
+
+void margin_call_check_cache::order_changed( asset_id_type sold, asset_id_type received )
+{
+   ++_changes;
+   auto itr = _checked.find( sold );
+   if( itr != _checked.end() && itr->second == received )
+      _checked.erase( itr );
+}
+
+void margin_call_check_cache::bitasset_changed( asset_bitasset_data_id_type b )
+{
+   ++_changes;
+   auto itr = _bitasset_owner.find( b );
+   if( itr != _bitasset_owner.end() )
+      _checked.erase( itr->second );
+}
+
+void margin_call_check_index::changed( const object& obj )
+{
+   if( obj.id.space() == protocol_ids && obj.id.type() == limit_order_object_type )
+   {
+      const limit_order_object& o = static_cast<const limit_order_object&>(obj);
+      _cache.order_changed( o.sell_price.base.asset_id, o.sell_price.quote.asset_id );
+   }
+   else if( obj.id.space() == protocol_ids && obj.id.type() == call_order_object_type )
+   {
+      const call_order_object& o = static_cast<const call_order_object&>(obj);
+      _cache.asset_changed( o.debt_type() );
+   }
+   else
+   {
+      assert( dynamic_cast<const asset_bitasset_data_object*>(&obj) ); // for debug only
+      _cache.bitasset_changed( obj.id );
+   }
+}
+
+void force_settlement_schedule::settlement_added( const force_settlement_object& o )
+{
+   _due.insert( o.settlement_date );
+   ++_pending[o.settlement_asset_id()];
+   if( _settled_assets.find( o.settlement_asset_id() ) != _settled_assets.end() )
+      ++_settled_pending;
+}
+
+void force_settlement_schedule::settlement_removed( const force_settlement_object& o )
+{
+   auto due_itr = _due.find( o.settlement_date );
+   assert( due_itr != _due.end() );
+   _due.erase( due_itr );
+
+   auto itr = _pending.find( o.settlement_asset_id() );
+   assert( itr != _pending.end() );
+   if( --itr->second == 0 )
+      _pending.erase( itr );
+   if( _settled_assets.find( o.settlement_asset_id() ) != _settled_assets.end() )
+      --_settled_pending;
+}
+
+void force_settlement_schedule::bitasset_changed( asset_bitasset_data_id_type id, const price& settlement_price )
+{
+   auto itr = _settled.find( id );
+   if( !settlement_price.is_null() && itr == _settled.end() )
+   {
+      // globally_settle_asset() prices the settlement in the settled asset
+      asset_id_type a = settlement_price.base.asset_id;
+      _settled[id] = a;
+      _settled_assets.insert( a );
+      _settled_pending += pending( a );
+   }
+   else if( settlement_price.is_null() && itr != _settled.end() )
+   {
+      _settled_pending -= pending( itr->second );
+      _settled_assets.erase( itr->second );
+      _settled.erase( itr );
+   }
+}
+
+uint32_t force_settlement_schedule::pending( asset_id_type a )const
+{
+   auto itr = _pending.find( a );
+   return itr == _pending.end() ? 0 : itr->second;
+}
+
+void force_settlement_schedule_index::object_inserted( const object& obj )
+{
+   if( obj.id.space() == protocol_ids )
+   {
+      assert( dynamic_cast<const force_settlement_object*>(&obj) ); // for debug only
+      _schedule.settlement_added( static_cast<const force_settlement_object&>(obj) );
+   }
+   else
+      object_modified( obj );
+}
+
+void force_settlement_schedule_index::object_removed( const object& obj )
+{
+   if( obj.id.space() == protocol_ids )
+   {
+      assert( dynamic_cast<const force_settlement_object*>(&obj) ); // for debug only
+      _schedule.settlement_removed( static_cast<const force_settlement_object&>(obj) );
+   }
+   else
+      _schedule.bitasset_changed( obj.id, price() );
+}
+
+void force_settlement_schedule_index::object_modified( const object& after )
+{
+   // the balance of a force settlement may change, but neither its asset nor its settlement date
+   if( after.id.space() == protocol_ids )
+      return;
+   assert( dynamic_cast<const asset_bitasset_data_object*>(&after) ); // for debug only
+   _schedule.bitasset_changed( after.id, static_cast<const asset_bitasset_data_object&>(after).settlement_price );
+}
+
+} } // graphene::chain
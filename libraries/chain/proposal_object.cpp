@@ -29,25 +29,22 @@ namespace graphene { namespace chain {
 
 bool proposal_object::is_authorized_to_execute(database& db) const
 {
-   transaction_evaluation_state dry_run_eval(&db);
-
+   // checked on every approval change, when most proposals are still short of approvals, so the check
+   // reports a failure by its result rather than building an exception
    try {
-      verify_authority( proposed_transaction.operations, 
-                        available_key_approvals,
-                        [&]( account_id_type id ){ return &id(db).active; },
-                        [&]( account_id_type id ){ return &id(db).owner;  },
-                        db.get_global_properties().parameters.max_authority_depth,
-                        true, /* allow committeee */
-                        available_active_approvals,
-                        available_owner_approvals );
+      return is_authorized( proposed_transaction.operations, 
+                            available_key_approvals,
+                            [&]( account_id_type id ){ return &id(db).active; },
+                            [&]( account_id_type id ){ return &id(db).owner;  },
+                            db.get_global_properties().parameters.max_authority_depth,
+                            true, /* allow committeee */
+                            available_active_approvals,
+                            available_owner_approvals );
    } 
    catch ( const fc::exception& e )
    {
-      //idump((available_active_approvals));
-      //wlog((e.to_detail_string()));
       return false;
    }
-   return true;
 }
 
 
@@ -92,4 +89,14 @@ void required_approval_index::object_removed( const object& obj )
        remove( a, p.id );
 }
 
+void required_approval_index::about_to_modify( const object& before )
+{
+    object_removed( before );
+}
+
+void required_approval_index::object_modified( const object& after )
+{
+    object_inserted( after );
+}
+
 } } // graphene::chain
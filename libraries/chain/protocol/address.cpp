@@ -23,9 +23,11 @@
  */
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/chain/protocol/address.hpp>
+#include <graphene/chain/protocol/types.hpp>
 #include <fc/crypto/elliptic.hpp>
 #include <fc/crypto/base58.hpp>
 #include <algorithm>
+#include <map>
 
 namespace graphene {
   namespace chain {
@@ -94,6 +96,25 @@ namespace graphene {
         return GRAPHENE_ADDRESS_PREFIX + fc::to_base58( bin_addr.data, sizeof( bin_addr ) );
    }
 
+   /** the table is simply dropped when it grows too large */
+   const key_addresses& addresses_of( const public_key_type& k )
+   {
+      static thread_local std::map<public_key_type,key_addresses> cache;
+      auto itr = cache.find( k );
+      if( itr != cache.end() )
+         return itr->second;
+
+      if( cache.size() >= 4096 )
+         cache.clear();
+      key_addresses& result = cache[k];
+      result[0] = address( pts_address( k, false, 56 ) );
+      result[1] = address( pts_address( k, true, 56 ) );
+      result[2] = address( pts_address( k, false, 0 ) );
+      result[3] = address( pts_address( k, true, 0 ) );
+      result[4] = address( k );
+      return result;
+   }
+
 } } // namespace graphene::chain
 
 namespace fc
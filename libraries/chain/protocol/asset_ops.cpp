@@ -94,17 +94,17 @@ void  asset_create_operation::validate()const
 {
    FC_ASSERT( fee.amount >= 0 );
    FC_ASSERT( is_valid_symbol(symbol) );
-   common_options.validate();
-   if( common_options.issuer_permissions & (disable_force_settle|global_settle) )
+   common_options->validate();
+   if( common_options->issuer_permissions & (disable_force_settle|global_settle) )
       FC_ASSERT( bitasset_opts.valid() );
    if( is_prediction_market )
    {
       FC_ASSERT( bitasset_opts.valid(), "Cannot have a User-Issued Asset implement a prediction market." );
-      FC_ASSERT( common_options.issuer_permissions & global_settle );
+      FC_ASSERT( common_options->issuer_permissions & global_settle );
    }
    if( bitasset_opts ) bitasset_opts->validate();
 
-   asset dummy = asset(1) * common_options.core_exchange_rate;
+   asset dummy = asset(1) * common_options->core_exchange_rate;
    FC_ASSERT(dummy.asset_id == asset_id_type(1));
    FC_ASSERT(precision <= 12);
 }
@@ -114,9 +114,9 @@ void asset_update_operation::validate()const
    FC_ASSERT( fee.amount >= 0 );
    if( new_issuer )
       FC_ASSERT(issuer != *new_issuer);
-   new_options.validate();
+   new_options->validate();
 
-   asset dummy = asset(1, asset_to_update) * new_options.core_exchange_rate;
+   asset dummy = asset(1, asset_to_update) * new_options->core_exchange_rate;
    FC_ASSERT(dummy.asset_id == asset_id_type());
 }
 
@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #include <graphene/chain/protocol/block.hpp>
+#include <graphene/chain/protocol/fast_pack.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <algorithm>
@@ -29,7 +30,7 @@
 namespace graphene { namespace chain {
    digest_type block_header::digest()const
    {
-      return digest_type::hash(*this);
+      return fast_pack::hash<digest_type>( *this );
    }
 
    uint32_t block_header::num_from_id(const block_id_type& id)
@@ -39,7 +40,7 @@ namespace graphene { namespace chain {
 
    block_id_type signed_block_header::id()const
    {
-      auto tmp = fc::sha224::hash( *this );
+      auto tmp = fast_pack::hash<fc::sha224>( *this );
       tmp._hash[0] = fc::endian_reverse_u32(block_num()); // store the block num in the ID, 160 bits is plenty for the hash
       static_assert( sizeof(tmp._hash[0]) == 4, "should be 4 bytes" );
       block_id_type result;
@@ -63,28 +64,39 @@ namespace graphene { namespace chain {
    }
 
    checksum_type signed_block::calculate_merkle_root()const
+   {
+      return calculate_merkle_root( []( size_t count, const std::function<void(size_t)>& task ) {
+         for( size_t n = 0; n < count; ++n )
+            task( n );
+      } );
+   }
+
+   checksum_type signed_block::calculate_merkle_root(
+      const std::function<void( size_t, const std::function<void(size_t)>& )>& for_each )const
    {
       if( transactions.size() == 0 ) 
          return checksum_type();
 
       vector<digest_type> ids;
       ids.resize( transactions.size() );
-      for( uint32_t i = 0; i < transactions.size(); ++i )
+      for_each( ids.size(), [&]( size_t i ) {
          ids[i] = transactions[i].merkle_digest();
+      } );
 
-      vector<digest_type>::size_type current_number_of_hashes = ids.size();
-      while( current_number_of_hashes > 1 )
+      // every level is written to a vector of its own, so the pairs of a level may be hashed concurrently
+      vector<digest_type> next;
+      while( ids.size() > 1 )
       {
          // hash ID's in pairs
-         uint32_t i_max = current_number_of_hashes - (current_number_of_hashes&1);
-         uint32_t k = 0;
-
-         for( uint32_t i = 0; i < i_max; i += 2 )
-            ids[k++] = digest_type::hash( std::make_pair( ids[i], ids[i+1] ) );
+         const size_t pairs = ids.size() / 2;
+         next.resize( pairs + (ids.size()&1) );
+         for_each( pairs, [&]( size_t k ) {
+            next[k] = digest_type::hash( std::make_pair( ids[2*k], ids[2*k+1] ) );
+         } );
 
-         if( current_number_of_hashes&1 )
-            ids[k++] = ids[i_max];
-         current_number_of_hashes = k;
+         if( ids.size()&1 )
+            next[pairs] = ids.back();
+         ids.swap( next );
       }
       return checksum_type::hash( ids[0] );
    }
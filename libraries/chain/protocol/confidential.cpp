@@ -55,7 +55,7 @@ void transfer_to_blind_operation::validate()const
 
    if( outputs.size() > 1 )
    {
-      for( auto out : outputs )
+      for( const auto& out : outputs )
       {
          auto info = fc::ecc::range_get_info( out.range_proof );
          FC_ASSERT( info.max_value <= GRAPHENE_MAX_SHARE_SUPPLY );
@@ -127,7 +127,7 @@ void blind_transfer_operation::validate()const
 
    if( outputs.size() > 1 )
    {
-      for( auto out : outputs )
+      for( const auto& out : outputs )
       {
          auto info = fc::ecc::range_get_info( out.range_proof );
          FC_ASSERT( info.max_value <= GRAPHENE_MAX_SHARE_SUPPLY );
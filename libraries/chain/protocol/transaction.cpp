@@ -102,6 +102,14 @@ void transaction::get_required_authorities( flat_set<account_id_type>& active, f
 
 
 
+namespace {
+   bool has_address( const public_key_type& k, const address& a )
+   {
+      const key_addresses& addresses = addresses_of( k );
+      return std::find( addresses.begin(), addresses.end(), a ) != addresses.end();
+   }
+}
+
 struct sign_state
 {
       /** returns true if we have a signature for this key or can 
@@ -120,40 +128,15 @@ struct sign_state
          return itr->second = true;
       }
 
-      optional<map<address,public_key_type>> available_address_sigs;
-      optional<map<address,public_key_type>> provided_address_sigs;
-
+      /** returns true if a is one of the addresses of a key we have or can produce a signature for */
       bool signed_by( const address& a ) {
-         if( !available_address_sigs ) {
-            available_address_sigs = std::map<address,public_key_type>();
-            provided_address_sigs = std::map<address,public_key_type>();
-            for( auto& item : available_keys ) {
-             (*available_address_sigs)[ address(pts_address(item, false, 56) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, true, 56) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, false, 0) ) ] = item;
-             (*available_address_sigs)[ address(pts_address(item, true, 0) ) ] = item;
-             (*available_address_sigs)[ address(item) ] = item;
-            }
-            for( auto& item : provided_signatures ) {
-             (*provided_address_sigs)[ address(pts_address(item.first, false, 56) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, true, 56) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, false, 0) ) ] = item.first;
-             (*provided_address_sigs)[ address(pts_address(item.first, true, 0) ) ] = item.first;
-             (*provided_address_sigs)[ address(item.first) ] = item.first;
-            }
-         }
-         auto itr = provided_address_sigs->find(a);
-         if( itr == provided_address_sigs->end() )
-         {
-            auto aitr = available_address_sigs->find(a);
-            if( aitr != available_address_sigs->end() ) {
-               auto pk = available_keys.find(aitr->second);
-               if( pk != available_keys.end() )
-                  return provided_signatures[aitr->second] = true;
-               return false;
-            }
-         }
-         return provided_signatures[itr->second] = true;
+         for( auto& item : provided_signatures )
+            if( has_address( item.first, a ) )
+               return item.second = true;
+         for( const auto& k : available_keys )
+            if( has_address( k, a ) )
+               return provided_signatures[k] = true;
+         return false;
       }
 
       bool check_authority( account_id_type id )
@@ -243,14 +226,20 @@ struct sign_state
 };
 
 
-void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs, 
-                       const std::function<const authority*(account_id_type)>& get_active,
-                       const std::function<const authority*(account_id_type)>& get_owner,
-                       uint32_t max_recursion_depth,
-                       bool  allow_committe,
-                       const flat_set<account_id_type>& active_aprovals,
-                       const flat_set<account_id_type>& owner_approvals )
-{ try {
+/**
+ * The checks of verify_authority().  With report set a failure throws the exception verify_authority() is
+ * documented to throw, otherwise it only returns false, which spares callers expecting failures the cost of
+ * building an exception that captures the operations.
+ */
+static bool check_authorities( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
+                               const std::function<const authority*(account_id_type)>& get_active,
+                               const std::function<const authority*(account_id_type)>& get_owner,
+                               uint32_t max_recursion_depth,
+                               bool  allow_committe,
+                               const flat_set<account_id_type>& active_aprovals,
+                               const flat_set<account_id_type>& owner_approvals,
+                               bool report )
+{
    flat_set<account_id_type> required_active;
    flat_set<account_id_type> required_owner;
    vector<authority> other;
@@ -258,9 +247,12 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
    for( const auto& op : ops )
       operation_get_required_authorities( op, required_active, required_owner, other );
 
-   if( !allow_committe )
-      GRAPHENE_ASSERT( required_active.find(GRAPHENE_COMMITTEE_ACCOUNT) == required_active.end(),
-                       invalid_committee_approval, "Committee account may only propose transactions" );
+   if( !allow_committe && required_active.find(GRAPHENE_COMMITTEE_ACCOUNT) != required_active.end() )
+   {
+      if( !report )
+         return false;
+      FC_THROW_EXCEPTION( invalid_committee_approval, "Committee account may only propose transactions" );
+   }
 
    sign_state s(sigs,get_active);
    s.max_recursion = max_recursion_depth;
@@ -271,44 +263,95 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
 
    for( const auto& auth : other )
    {
-      GRAPHENE_ASSERT( s.check_authority(&auth), tx_missing_other_auth, "Missing Authority", ("auth",auth)("sigs",sigs) );
+      if( s.check_authority(&auth) )
+         continue;
+      if( !report )
+         return false;
+      FC_THROW_EXCEPTION( tx_missing_other_auth, "Missing Authority", ("auth",auth)("sigs",sigs) );
    }
 
    // fetch all of the top level authorities
    for( auto id : required_active )
    {
-      GRAPHENE_ASSERT( s.check_authority(id) || 
-                       s.check_authority(get_owner(id)), 
-                       tx_missing_active_auth, "Missing Active Authority ${id}", ("id",id)("auth",*get_active(id))("owner",*get_owner(id)) );
+      if( s.check_authority(id) || s.check_authority(get_owner(id)) )
+         continue;
+      if( !report )
+         return false;
+      FC_THROW_EXCEPTION( tx_missing_active_auth, "Missing Active Authority ${id}",
+                          ("id",id)("auth",*get_active(id))("owner",*get_owner(id)) );
    }
 
    for( auto id : required_owner )
    {
-      GRAPHENE_ASSERT( owner_approvals.find(id) != owner_approvals.end() ||
-                       s.check_authority(get_owner(id)), 
-                       tx_missing_owner_auth, "Missing Owner Authority ${id}", ("id",id)("auth",*get_owner(id)) );
+      if( owner_approvals.find(id) != owner_approvals.end() || s.check_authority(get_owner(id)) )
+         continue;
+      if( !report )
+         return false;
+      FC_THROW_EXCEPTION( tx_missing_owner_auth, "Missing Owner Authority ${id}", ("id",id)("auth",*get_owner(id)) );
+   }
+
+   if( s.remove_unused_signatures() )
+   {
+      if( !report )
+         return false;
+      FC_THROW_EXCEPTION( tx_irrelevant_sig, "Unnecessary signature(s) detected" );
    }
+   return true;
+}
 
-   GRAPHENE_ASSERT(
-      !s.remove_unused_signatures(),
-      tx_irrelevant_sig,
-      "Unnecessary signature(s) detected"
-      );
+void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs, 
+                       const std::function<const authority*(account_id_type)>& get_active,
+                       const std::function<const authority*(account_id_type)>& get_owner,
+                       uint32_t max_recursion_depth,
+                       bool  allow_committe,
+                       const flat_set<account_id_type>& active_aprovals,
+                       const flat_set<account_id_type>& owner_approvals )
+{ try {
+   check_authorities( ops, sigs, get_active, get_owner, max_recursion_depth, allow_committe,
+                      active_aprovals, owner_approvals, true );
 } FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
 
+bool is_authorized( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
+                    const std::function<const authority*(account_id_type)>& get_active,
+                    const std::function<const authority*(account_id_type)>& get_owner,
+                    uint32_t max_recursion_depth,
+                    bool  allow_committe,
+                    const flat_set<account_id_type>& active_aprovals,
+                    const flat_set<account_id_type>& owner_approvals )
+{
+   return check_authorities( ops, sigs, get_active, get_owner, max_recursion_depth, allow_committe,
+                             active_aprovals, owner_approvals, false );
+}
+
 
-flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
+const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
+{
+   return get_signature_keys( chain_id, []( const signature_type& sig, const digest_type& d ) -> public_key_type {
+      return fc::ecc::public_key( sig, d );
+   } );
+}
+
+const flat_set<public_key_type>& signed_transaction::get_signature_keys(
+   const chain_id_type& chain_id,
+   const std::function<public_key_type( const signature_type&, const digest_type& )>& recover )const
 { try {
    auto d = sig_digest( chain_id );
+   if( _signees_valid && _signees_digest == d && _signees_signatures == signatures )
+      return _signees;
+
    flat_set<public_key_type> result;
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( recover( sig, d ) ).second,
          tx_duplicate_sig,
          "Duplicate Signature detected" );
    }
-   return result;
+   _signees            = std::move( result );
+   _signees_digest     = d;
+   _signees_signatures = signatures;
+   _signees_valid      = true;
+   return _signees;
 } FC_CAPTURE_AND_RETHROW() }
 
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/signature_key_cache.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace chain {
+
+size_t signature_key_cache::key_hash::operator()( const key_type& k )const
+{
+   // both parts are already uniformly distributed
+   uint64_t d, s;
+   memcpy( &d, k.digest.data(), sizeof(d) );
+   memcpy( &s, k.sig.begin() + 1, sizeof(s) );
+   return size_t( d ^ s );
+}
+
+void signature_key_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   trim();
+}
+
+size_t signature_key_cache::size()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _entries.size();
+}
+
+void signature_key_cache::trim()
+{
+   while( _entries.size() > _capacity )
+   {
+      _entries.erase( _lru.back().first );
+      _lru.pop_back();
+   }
+}
+
+public_key_type signature_key_cache::recover( const signature_type& sig, const digest_type& digest )
+{
+   if( _capacity == 0 )
+      return fc::ecc::public_key( sig, digest );
+
+   const key_type key{ digest, sig };
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      auto itr = _entries.find( key );
+      if( itr != _entries.end() )
+      {
+         _lru.splice( _lru.begin(), _lru, itr->second );
+         ++_hits;
+         return itr->second->second;
+      }
+      ++_misses;
+   }
+
+   // recover without holding the lock, it is the expensive part
+   const public_key_type result = fc::ecc::public_key( sig, digest );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _entries.find( key ) == _entries.end() )
+   {
+      _lru.emplace_front( key, result );
+      _entries[ key ] = _lru.begin();
+      trim();
+   }
+   return result;
+}
+
+} }
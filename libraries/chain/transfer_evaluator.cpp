@@ -23,6 +23,7 @@
  */
 #include <graphene/chain/transfer_evaluator.hpp>
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/is_authorized_asset.hpp>
@@ -33,9 +34,9 @@ void_result transfer_evaluator::do_evaluate( const transfer_operation& op )
    
    const database& d = db();
 
-   const account_object& from_account    = op.from(d);
-   const account_object& to_account      = op.to(d);
-   const asset_object&   asset_type      = op.amount.asset_id(d);
+   const account_object& from_account    = d.get_typed<account_index>( op.from );
+   const account_object& to_account      = d.get_typed<account_index>( op.to );
+   const asset_object&   asset_type      = d.get_typed<asset_index>( op.amount.asset_id );
 
    try {
 
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_ledger.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/global_property_object.hpp>
+
+namespace graphene { namespace chain {
+
+vote_opinion::vote_opinion( const account_options& options )
+   : votes( options.votes ), num_witness( options.num_witness ), num_committee( options.num_committee ) {}
+
+vote_tally::vote_tally( const global_property_object& props )
+   : votes( props.next_available_vote_id ),
+     witness_count_histogram( props.parameters.maximum_witness_count / 2 + 1 ),
+     committee_count_histogram( props.parameters.maximum_committee_count / 2 + 1 ),
+     maximum_witness_count( props.parameters.maximum_witness_count ),
+     maximum_committee_count( props.parameters.maximum_committee_count ) {}
+
+void vote_tally::add( const vote_opinion& opinion, uint64_t voting_stake )
+{
+   for( vote_id_type id : opinion.votes )
+   {
+      uint32_t offset = id.instance();
+      // if they somehow managed to specify an illegal offset, ignore it.
+      if( offset < votes.size() )
+         votes[offset] += voting_stake;
+   }
+
+   if( opinion.num_witness <= maximum_witness_count )
+   {
+      uint16_t offset = std::min( size_t(opinion.num_witness/2), witness_count_histogram.size() - 1 );
+      // votes for a number greater than maximum_witness_count
+      // are turned into votes for maximum_witness_count.
+      //
+      // in particular, this takes care of the case where a
+      // member was voting for a high number, then the
+      // parameter was lowered.
+      witness_count_histogram[offset] += voting_stake;
+   }
+   if( opinion.num_committee <= maximum_committee_count )
+   {
+      uint16_t offset = std::min( size_t(opinion.num_committee/2), committee_count_histogram.size() - 1 );
+      // votes for a number greater than maximum_committee_count
+      // are turned into votes for maximum_committee_count.
+      //
+      // same rationale as for witnesses
+      committee_count_histogram[offset] += voting_stake;
+   }
+
+   total_voting_stake += voting_stake;
+}
+
+void vote_tally::remove( const vote_opinion& opinion, uint64_t voting_stake )
+{
+   // all totals wrap around at 2^64, so adding the two's complement takes the stake out exactly
+   add( opinion, uint64_t(0) - voting_stake );
+}
+
+void vote_tally::merge( const vote_tally& other )
+{
+   for( size_t i = 0; i < votes.size(); ++i )
+      votes[i] += other.votes[i];
+   for( size_t i = 0; i < witness_count_histogram.size(); ++i )
+      witness_count_histogram[i] += other.witness_count_histogram[i];
+   for( size_t i = 0; i < committee_count_histogram.size(); ++i )
+      committee_count_histogram[i] += other.committee_count_histogram[i];
+   total_voting_stake += other.total_voting_stake;
+}
+
+bool vote_tally::operator == ( const vote_tally& other )const
+{
+   return votes == other.votes
+       && witness_count_histogram == other.witness_count_histogram
+       && committee_count_histogram == other.committee_count_histogram
+       && total_voting_stake == other.total_voting_stake;
+}
+
+bool vote_ledger::votes( const database& db, const global_property_object& props, const account_object& stake_account )
+{
+   return props.parameters.count_non_member_votes || stake_account.is_member( db.head_block_time() );
+}
+
+uint64_t vote_ledger::balance_stake( const database& db, const account_object& stake_account )
+{
+   const auto& stats = stake_account.statistics( db );
+   return stats.total_core_in_orders.value + db.get_balance( stake_account.get_id(), asset_id_type() ).amount.value;
+}
+
+const account_object& vote_ledger::opinion_account( const database& db, const account_object& stake_account )
+{
+   // There may be a difference between the account whose stake is voting and the one specifying opinions.
+   // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
+   // specifying the opinions.
+   if( stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT )
+      return stake_account;
+   return db.get( stake_account.options.voting_account );
+}
+
+bool vote_ledger::update( const database& db, const global_property_object& props )
+{
+   // member votes depend on the time, and the histograms on the maximum counts, so they cannot be kept
+   if( !_valid || !props.parameters.count_non_member_votes
+       || _tally.maximum_witness_count != props.parameters.maximum_witness_count
+       || _tally.maximum_committee_count != props.parameters.maximum_committee_count
+       || props.next_available_vote_id < _tally.votes.size()
+       || (props.next_available_vote_id > _tally.votes.size() && _out_of_range > 0) )
+   {
+      clear();
+      return false;
+   }
+   _tally.votes.resize( props.next_available_vote_id );
+
+   // an opinion snapshot goes away with its last user, so every changed contribution is taken out before any of
+   // them is counted again from the current options
+   for( uint64_t account : _changed )
+      forget( account );
+   for( uint64_t account : _changed )
+   {
+      const account_object* stake_account = db.find( account_id_type( account ) );
+      if( stake_account == nullptr )
+         continue;
+      const uint64_t stake = balance_stake( db, *stake_account );
+      if( stake > 0 )
+         _tally.add( record( db, stake_account->get_id(), opinion_account( db, *stake_account ).get_id(), stake ), stake );
+   }
+   _changed.clear();
+   return true;
+}
+
+void vote_ledger::reset( const database& db, const global_property_object& props, const vote_tally& tally,
+                         const vector<entry>& entries )
+{
+   clear();
+   if( !props.parameters.count_non_member_votes )
+      return;
+
+   _tally = tally;
+   for( const entry& e : entries )
+      if( e.stake > 0 )
+         record( db, e.account, e.opinion_account, e.stake );
+   _valid = true;
+}
+
+void vote_ledger::account_changed( account_id_type a )
+{
+   if( !_valid )
+      return;
+   _changed.insert( a.instance.value );
+   auto itr = _followers.find( a.instance.value );
+   if( itr != _followers.end() )
+      _changed.insert( itr->second.begin(), itr->second.end() );
+}
+
+void vote_ledger::stake_changed( account_id_type a )
+{
+   if( _valid )
+      _changed.insert( a.instance.value );
+}
+
+const vote_opinion& vote_ledger::record( const database& db, account_id_type account, account_id_type opinion_account,
+                                         uint64_t stake )
+{
+   shared_opinion& shared = _opinions[opinion_account.instance.value];
+   if( shared.users++ == 0 )
+   {
+      shared.opinion = vote_opinion( opinion_account(db).options );
+      shared.out_of_range = !shared.opinion.votes.empty()
+                            && shared.opinion.votes.rbegin()->instance() >= _tally.votes.size();
+   }
+   if( shared.out_of_range )
+      ++_out_of_range;
+
+   contribution& c = _contributions[account.instance.value];
+   c.opinion_account = opinion_account;
+   c.stake = stake;
+   if( opinion_account != account )
+      _followers[opinion_account.instance.value].insert( account.instance.value );
+   return shared.opinion;
+}
+
+void vote_ledger::forget( uint64_t account )
+{
+   auto itr = _contributions.find( account );
+   if( itr == _contributions.end() )
+      return;
+
+   const uint64_t opinion_account = itr->second.opinion_account.instance.value;
+   auto shared = _opinions.find( opinion_account );
+   assert( shared != _opinions.end() );
+   _tally.remove( shared->second.opinion, itr->second.stake );
+   if( shared->second.out_of_range )
+      --_out_of_range;
+   if( --shared->second.users == 0 )
+      _opinions.erase( shared );
+
+   if( opinion_account != account )
+   {
+      auto followers = _followers.find( opinion_account );
+      assert( followers != _followers.end() );
+      followers->second.erase( account );
+      if( followers->second.empty() )
+         _followers.erase( followers );
+   }
+   _contributions.erase( itr );
+}
+
+void vote_ledger::clear()
+{
+   _valid = false;
+   _tally = vote_tally();
+   _contributions.clear();
+   _opinions.clear();
+   _followers.clear();
+   _changed.clear();
+   _out_of_range = 0;
+}
+
+void vote_ledger_index::changed( const object& obj )
+{
+   if( obj.id.space() == protocol_ids )
+   {
+      assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+      _ledger.account_changed( obj.id );
+   }
+   else if( obj.id.type() == impl_account_balance_object_type )
+   {
+      const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+      if( b.asset_type == asset_id_type() )
+         _ledger.stake_changed( b.owner );
+   }
+   else
+   {
+      assert( dynamic_cast<const account_statistics_object*>(&obj) ); // for debug only
+      _ledger.stake_changed( static_cast<const account_statistics_object&>(obj).owner );
+   }
+}
+
+} } // graphene::chain
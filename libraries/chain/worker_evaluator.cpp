@@ -111,7 +111,7 @@ void refund_worker_type::pay_worker(share_type pay, database& db)
    });
 }
 
-void vesting_balance_worker_type::pay_worker(share_type pay, database& db)
+void vesting_balance_worker_type::pay_worker(share_type pay, database& db)const
 {
    db.modify(balance(db), [&](vesting_balance_object& b) {
       b.deposit(db.head_block_time(), asset(pay));
@@ -23,10 +23,12 @@
  */
 #pragma once
 #include <graphene/db/index.hpp>
+#include <graphene/db/slab_allocator.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace graphene { namespace chain {
 
@@ -34,10 +36,50 @@ namespace graphene { namespace chain {
    using namespace boost::multi_index;
 
    struct by_id{};
+
+   namespace detail {
+      /** true when @ref a and @ref b have the same key in the ordered index @ref idx */
+      template<typename Index, typename Object>
+      auto same_key( const Index& idx, const Object& a, const Object& b, int )
+         -> decltype( idx.key_comp(), bool() )
+      {
+         const auto& key = idx.key_extractor();
+         const auto& comp = idx.key_comp();
+         return !comp( key(a), key(b) ) && !comp( key(b), key(a) );
+      }
+      /** true when @ref a and @ref b have the same key in the hashed index @ref idx */
+      template<typename Index, typename Object>
+      auto same_key( const Index& idx, const Object& a, const Object& b, long )
+         -> decltype( idx.key_eq(), bool() )
+      {
+         const auto& key = idx.key_extractor();
+         return idx.key_eq()( key(a), key(b) );
+      }
+
+      template<size_t N, size_t Count>
+      struct same_keys
+      {
+         template<typename Container, typename Object>
+         static bool check( const Container& c, const Object& a, const Object& b )
+         {
+            return same_key( c.template get<N>(), a, b, 0 ) && same_keys<N+1,Count>::check( c, a, b );
+         }
+      };
+      template<size_t Count>
+      struct same_keys<Count,Count>
+      {
+         template<typename Container, typename Object>
+         static bool check( const Container&, const Object&, const Object& ) { return true; }
+      };
+   }
+
    /**
     *  Almost all objects can be tracked and managed via a boost::multi_index container that uses
     *  an unordered_unique key on the object ID.  This template class adapts the generic index interface
     *  to work with arbitrary boost multi_index containers on the same type.
+    *
+    *  Passing slab_allocator<ObjectType> as the allocator of the multi_index_container keeps the nodes
+    *  of the index in contiguous chunks.
     */
    template<typename ObjectType, typename MultiIndexType>
    class generic_index : public index
@@ -68,11 +110,32 @@ namespace graphene { namespace chain {
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
             assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
-            auto ok = _indices.modify( _indices.iterator_to( static_cast<const ObjectType&>(obj) ),
-                                       [&m]( ObjectType& o ){ m(o); } );
+            modify_typed( static_cast<const ObjectType&>(obj), [&m]( ObjectType& o ){ m(o); } );
+         }
+
+         /** like modify() without the std::function around @ref m */
+         template<typename Lambda>
+         void modify_typed( const ObjectType& obj, const Lambda& m )
+         {
+            auto ok = _indices.modify( _indices.iterator_to( obj ), m );
             FC_ASSERT( ok, "Could not modify object, most likely a index constraint was violated" );
          }
 
+         /**
+          * Modifies @ref obj where it is, without checking its position in the indices.  @ref m must not change any
+          * field the indices are keyed on, which is asserted in debug builds.
+          */
+         template<typename Lambda>
+         void modify_non_key( const ObjectType& obj, const Lambda& m )
+         {
+#ifndef NDEBUG
+            const ObjectType before = obj;
+#endif
+            m( const_cast<ObjectType&>( obj ) );
+            assert( (detail::same_keys< 0, boost::mpl::size<typename index_type::index_type_list>::value >
+                                      ::check( _indices, before, obj )) && "modify_non_key changed a key" );
+         }
+
          virtual void remove( const object& obj )override
          {
             _indices.erase( _indices.iterator_to( static_cast<const ObjectType&>(obj) ) );
@@ -95,6 +158,11 @@ namespace graphene { namespace chain {
 
          const index_type& indices()const { return _indices; }
 
+         virtual uint64_t allocated_bytes()const override
+         {
+            return graphene::db::allocator_stats<typename index_type::allocator_type>::reserved_bytes();
+         }
+
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _indices )
@@ -27,12 +27,57 @@
 #include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
+#include <algorithm>
 #include <fstream>
+#include <cstring>
 
 namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   /**
+    *  @class index_snapshot_header
+    *  @brief describes the on disk layout of a single saved index
+    *
+    *  The header occupies the first page of the file.  Packed objects follow starting at
+    *  data_offset (page aligned) and are stored back to back, the offset table holds one
+    *  uint64_t per object relative to data_offset and is stored after the object data so
+    *  that the whole file can be written in a single sequential pass.
+    *
+    *  Since format 2 the checksum covers the object data followed by the offset table, so a
+    *  file that was cut short or damaged is refused instead of loaded in part.
+    */
+   struct index_snapshot_header
+   {
+      static const uint32_t magic_value    = 0x504e5347; // "GSNP"
+      static const uint32_t current_format = 2;
+      static const uint32_t page_size      = 4096;
+
+      uint32_t       magic          = magic_value;
+      uint32_t       format         = current_format;
+      object_id_type next_id;
+      fc::sha256     object_version;
+      uint64_t       object_count   = 0;
+      uint64_t       data_offset    = page_size;
+      uint64_t       data_size      = 0;
+      uint64_t       table_offset   = 0;
+      fc::sha256     checksum;
+   };
+
+   /** writes the contents of the file or directory at p through to the disk, so they survive a power loss */
+   void sync_file( const fc::path& p );
+
+   /** adds size bytes to enc, which takes at most 4 GiB at a time */
+   inline void write_checksum( fc::sha256::encoder& enc, const char* data, uint64_t size )
+   {
+      for( uint64_t done = 0; done < size; )
+      {
+         const uint32_t chunk = uint32_t( std::min<uint64_t>( size - done, uint64_t(1) << 30 ) );
+         enc.write( data + done, chunk );
+         done += chunk;
+      }
+   }
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -49,6 +94,25 @@ namespace graphene { namespace db {
          virtual void on_modify( const object& obj ){}
    };
 
+   /** memory and change counts of an index, see object_database::get_index_statistics() */
+   struct index_statistics
+   {
+      uint8_t          space_id = 0;
+      uint8_t          type_id = 0;
+      uint64_t         objects = 0;
+      /** sum of object::memory_size() of the objects */
+      uint64_t         estimated_bytes = 0;
+      /** see index::allocated_bytes() */
+      uint64_t         allocated_bytes = 0;
+      /** objects created, modified and removed through the index since it was added, undo included */
+      uint64_t         creates = 0;
+      uint64_t         modifies = 0;
+      uint64_t         removes = 0;
+      uint32_t         secondary_indexes = 0;
+      /** object::memory_size() of the copies of objects of the index each undo state holds, oldest first */
+      vector<uint64_t> undo_bytes;
+   };
+
    /**
     *  @class index
     *  @brief abstract base class for accessing objects indexed in various ways.
@@ -96,6 +160,29 @@ namespace graphene { namespace db {
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
 
+         /**
+          *  Hint that count objects are about to be loaded, indexes backed by contiguous
+          *  storage may use this to avoid repeated reallocation.
+          */
+         virtual void reserve( size_t count ){}
+
+         /** @return bytes held by the allocator of this index, 0 if it uses the default heap allocator */
+         virtual uint64_t allocated_bytes()const { return 0; }
+
+         /** walks all objects, the undo bytes are filled in by object_database::get_index_statistics() */
+         virtual index_statistics get_statistics()const
+         {
+            index_statistics result;
+            result.space_id = object_space_id();
+            result.type_id = object_type_id();
+            result.allocated_bytes = allocated_bytes();
+            inspect_all_objects( [&result]( const object& o ) {
+               ++result.objects;
+               result.estimated_bytes += o.memory_size();
+            });
+            return result;
+         }
+
 
 
          /** @return the object with id or nullptr if not found */
@@ -151,6 +238,7 @@ namespace graphene { namespace db {
    {
       public:
          base_primary_index( object_database& db ):_db(db){}
+         virtual ~base_primary_index(){}
 
          /** called just before obj is modified */
          void save_undo( const object& obj );
@@ -158,32 +246,79 @@ namespace graphene { namespace db {
          /** called just after the object is added */
          void on_add( const object& obj );
 
+         /** called just after insert() put back an object, such as one restored by undo, which is not recorded again */
+         void on_insert( const object& obj );
+
          /** called just before obj is removed */
          void on_remove( const object& obj );
 
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
-         template<typename T>
-         void add_secondary_index()
+         template<typename T, typename... Args>
+         T* add_secondary_index( Args&&... args )
          {
-            _sindex.emplace_back( new T() );
+            _sindex.emplace_back( new T( std::forward<Args>(args)... ) );
+            return static_cast<T*>( _sindex.back().get() );
          }
 
          template<typename T>
          const T& get_secondary_index()const
+         {
+            const T* result = find_secondary_index<T>();
+            if( result != nullptr ) return *result;
+            FC_THROW_EXCEPTION( fc::assert_exception, "invalid index type" );
+         }
+
+         /** @return the secondary index of type T, or nullptr if none was added */
+         template<typename T>
+         const T* find_secondary_index()const
          {
             for( const auto& item : _sindex )
             {
                const T* result = dynamic_cast<const T*>(item.get());
-               if( result != nullptr ) return *result;
+               if( result != nullptr ) return result;
             }
-            FC_THROW_EXCEPTION( fc::assert_exception, "invalid index type" );
+            return nullptr;
+         }
+
+         /** drops the secondary index of type T, it is no longer told about changes to the objects */
+         template<typename T>
+         void remove_secondary_index()
+         {
+            for( auto itr = _sindex.begin(); itr != _sindex.end(); ++itr )
+               if( dynamic_cast<const T*>(itr->get()) != nullptr )
+               {
+                  _sindex.erase( itr );
+                  return;
+               }
          }
 
+         /**
+          *  When set, objects loaded by open() are not passed to the secondary indexes, which
+          *  allows several primary indexes to be loaded concurrently.  Call
+          *  rebuild_secondary_indexes() once loading is complete.
+          */
+         void defer_secondary_indexes( bool defer ) { _defer_secondary = defer; }
+
+         /** feeds every object currently in the index to the secondary indexes */
+         virtual void rebuild_secondary_indexes() = 0;
+
+         /**
+          *  Keep hash() as a running sum of the object hashes that is updated as objects are added, modified and
+          *  removed, instead of hashing every object on each call.  Enabling it hashes every object once.
+          */
+         virtual void track_hash( bool enable ) = 0;
+
       protected:
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         bool                                   _defer_secondary = false;
+         uint64_t                               _creates = 0;
+         uint64_t                               _modifies = 0;
+         uint64_t                               _removes = 0;
+         bool                                   _track_hash = false;
+         fc::uint128                            _tracked_hash;
 
       private:
          object_database& _db;
@@ -202,6 +337,7 @@ namespace graphene { namespace db {
    {
       public:
          typedef typename DerivedIndex::object_type object_type;
+         typedef DerivedIndex                       derived_index_type;
 
          primary_index( object_database& db )
          :base_primary_index(db),_next_id(object_type::space_id,object_type::type_id,0) {}
@@ -223,61 +359,143 @@ namespace graphene { namespace db {
          }
 
          virtual void open( const path& db )override
-         { 
+         {
             if( !fc::exists( db ) ) return;
+            const size_t file_size = fc::file_size(db);
+            if( file_size == 0 ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
-            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
+            fc::mapped_region mr( fm, fc::read_only, 0, file_size );
+            const char* data = (const char*)mr.get_address();
 
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            try {
-               vector<char> tmp;
-               while( true ) 
-               {
-                  fc::raw::unpack( ds, tmp );
-                  load( tmp );
-               }
-            } catch ( const fc::exception&  ){}
+            uint32_t magic = 0;
+            if( file_size >= sizeof(magic) )
+               memcpy( &magic, data, sizeof(magic) );
+            if( magic != index_snapshot_header::magic_value )
+            {
+               open_legacy( data, file_size );
+               return;
+            }
+
+            index_snapshot_header header;
+            fc::datastream<const char*> hds( data, std::min<size_t>( file_size, index_snapshot_header::page_size ) );
+            fc::raw::unpack( hds, header );
+            FC_ASSERT( header.format >= 1 && header.format <= index_snapshot_header::current_format,
+                       "Unsupported snapshot format", ("format",header.format)("file",db) );
+            FC_ASSERT( header.object_version == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            FC_ASSERT( header.data_offset + header.data_size <= file_size &&
+                       header.table_offset + header.object_count * sizeof(uint64_t) <= file_size,
+                       "Truncated snapshot", ("file",db)("header",header)("size",file_size) );
+            if( header.format >= 2 )
+            {
+               fc::sha256::encoder enc;
+               write_checksum( enc, data + header.data_offset, header.data_size );
+               write_checksum( enc, data + header.table_offset, header.object_count * sizeof(uint64_t) );
+               FC_ASSERT( enc.result() == header.checksum, "Corrupted snapshot, its checksum does not match",
+                          ("file",db) );
+            }
+
+            _next_id = header.next_id;
+            this->reserve( header.object_count );
+
+            const char* table = data + header.table_offset;
+            fc::datastream<const char*> ds( data + header.data_offset, header.data_size );
+            for( uint64_t i = 0; i < header.object_count; ++i )
+            {
+               uint64_t offset;
+               memcpy( &offset, table + i * sizeof(offset), sizeof(offset) );
+               FC_ASSERT( offset == ds.tellp(), "Corrupted snapshot offset table", ("file",db)("object",i) );
+               object_type obj;
+               fc::raw::unpack( ds, obj );
+               load_object( std::move(obj) );
+            }
          }
 
-         virtual void save( const path& db ) override 
+         virtual void save( const path& db ) override
          {
-            std::ofstream out( db.generic_string(), 
+            std::ofstream out( db.generic_string(),
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
+
+            index_snapshot_header header;
+            header.next_id        = _next_id;
+            header.object_version = get_object_version();
+
+            // reserve the first page for the header, it is rewritten once the sizes are known
+            vector<char> page( index_snapshot_header::page_size );
+            out.write( page.data(), page.size() );
+
+            const size_t flush_threshold = 1024*1024;
+            fc::sha256::encoder checksum;
+            vector<uint64_t> offsets;
+            vector<char>     buffer;
+            buffer.reserve( flush_threshold * 2 );
             this->inspect_all_objects( [&]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+                const auto& obj = static_cast<const object_type&>(o);
+                offsets.push_back( header.data_size + buffer.size() );
+                const size_t pos = buffer.size();
+                buffer.resize( pos + fc::raw::pack_size( obj ) );
+                fc::datastream<char*> ds( buffer.data() + pos, buffer.size() - pos );
+                fc::raw::pack( ds, obj );
+                if( buffer.size() >= flush_threshold )
+                {
+                   checksum.write( buffer.data(), buffer.size() );
+                   out.write( buffer.data(), buffer.size() );
+                   header.data_size += buffer.size();
+                   buffer.clear();
+                }
             });
+            checksum.write( buffer.data(), buffer.size() );
+            out.write( buffer.data(), buffer.size() );
+            header.data_size += buffer.size();
+
+            header.object_count = offsets.size();
+            header.table_offset = header.data_offset + header.data_size;
+            write_checksum( checksum, (const char*)offsets.data(), offsets.size() * sizeof(uint64_t) );
+            out.write( (const char*)offsets.data(), offsets.size() * sizeof(uint64_t) );
+            header.checksum = checksum.result();
+
+            auto packed_header = fc::raw::pack( header );
+            FC_ASSERT( packed_header.size() <= index_snapshot_header::page_size );
+            out.seekp( 0 );
+            out.write( packed_header.data(), packed_header.size() );
+            out.close();
+            FC_ASSERT( out, "Error writing index snapshot", ("file",db) );
+            sync_file( db );
          }
 
          virtual const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
-            return result;
+            return load_object( fc::raw::unpack<object_type>( data ) );
          }
 
 
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
+            ++_creates;
+            if( _track_hash ) _tracked_hash += result.hash();
             for( const auto& item : _sindex )
                item->object_inserted( result );
             on_add( result );
             return result;
          }
 
+         /** used by the undo database to restore removed objects, which the secondary indexes and observers must see again */
+         virtual const object& insert( object&& obj ) override
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            ++_creates;
+            if( _track_hash ) _tracked_hash += result.hash();
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            on_insert( result );
+            return result;
+         }
+
          virtual void  remove( const object& obj ) override
          {
+            ++_removes;
+            if( _track_hash ) _tracked_hash -= obj.hash();
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
@@ -286,13 +504,31 @@ namespace graphene { namespace db {
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
-            save_undo( obj );
-            for( const auto& item : _sindex )
-               item->about_to_modify( obj );
-            DerivedIndex::modify( obj, m );
-            for( const auto& item : _sindex )
-               item->object_modified( obj );
-            on_modify( obj );
+            modify_with( obj, [&]{ DerivedIndex::modify( obj, m ); } );
+         }
+
+         /** modify() without virtual dispatch or a std::function, DerivedIndex must be a generic_index */
+         template<typename Lambda>
+         void modify_typed( const object_type& obj, const Lambda& m )
+         {
+            modify_with( obj, [&]{ DerivedIndex::modify_typed( obj, m ); } );
+         }
+
+         /** like modify_typed() for a @ref m that changes no key of the indices, see generic_index::modify_non_key() */
+         template<typename Lambda>
+         void modify_non_key( const object_type& obj, const Lambda& m )
+         {
+            modify_with( obj, [&]{ DerivedIndex::modify_non_key( obj, m ); } );
+         }
+
+         virtual index_statistics get_statistics()const override
+         {
+            index_statistics result = DerivedIndex::get_statistics();
+            result.creates = _creates;
+            result.modifies = _modifies;
+            result.removes = _removes;
+            result.secondary_indexes = _sindex.size();
+            return result;
          }
 
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
@@ -300,6 +536,28 @@ namespace graphene { namespace db {
             _observers.emplace_back( o );
          }
 
+         virtual fc::uint128 hash()const override
+         {
+            return _track_hash ? _tracked_hash : DerivedIndex::hash();
+         }
+
+         virtual void track_hash( bool enable ) override
+         {
+            _track_hash = false;
+            if( enable )
+               _tracked_hash = DerivedIndex::hash();
+            _track_hash = enable;
+         }
+
+         virtual void rebuild_secondary_indexes() override
+         {
+            if( _sindex.empty() ) return;
+            this->inspect_all_objects( [&]( const object& o ) {
+               for( const auto& item : _sindex )
+                  item->object_inserted( o );
+            });
+         }
+
          virtual void object_from_variant( const fc::variant& var, object& obj )const override
          {
             object_id_type id = obj.id;
@@ -319,7 +577,58 @@ namespace graphene { namespace db {
          }
 
       private:
+         /** keeps the undo state and the secondary indexes current around @ref apply, which changes @ref obj */
+         template<typename Apply>
+         void modify_with( const object& obj, const Apply& apply )
+         {
+            save_undo( obj );
+            ++_modifies;
+            for( const auto& item : _sindex )
+               item->about_to_modify( obj );
+            if( _track_hash ) _tracked_hash -= obj.hash();
+            apply();
+            if( _track_hash ) _tracked_hash += obj.hash();
+            for( const auto& item : _sindex )
+               item->object_modified( obj );
+            on_modify( obj );
+         }
+
+         const object& load_object( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            if( _track_hash ) _tracked_hash += result.hash();
+            if( !_defer_secondary )
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            return result;
+         }
+
+         /** reads the original format of a length prefixed object following next_id and version */
+         void open_legacy( const char* data, size_t size )
+         {
+            fc::datastream<const char*> ds( data, size );
+            fc::sha256 open_ver;
+
+            fc::raw::unpack(ds, _next_id);
+            fc::raw::unpack(ds, open_ver);
+            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            try {
+               vector<char> tmp;
+               while( true )
+               {
+                  fc::raw::unpack( ds, tmp );
+                  load( tmp );
+               }
+            } catch ( const fc::exception&  ){}
+         }
+
          object_id_type _next_id;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::index_snapshot_header,
+            (magic)(format)(next_id)(object_version)(object_count)(data_offset)(data_size)(table_offset)(checksum) )
+FC_REFLECT( graphene::db::index_statistics,
+            (space_id)(type_id)(objects)(estimated_bytes)(allocated_bytes)(creates)(modifies)(removes)
+            (secondary_indexes)(undo_bytes) )
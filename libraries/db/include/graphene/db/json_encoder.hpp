@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/container/flat.hpp>
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/variant.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   class object;
+
+   /**
+    *  true for the reflected types json_encoder writes member by member, which must not have a to_variant() of
+    *  their own: the database objects, and the types declared with GRAPHENE_JSON_DIRECT
+    */
+   template<typename T>
+   struct json_direct : std::is_base_of<object, T> {};
+
+   /**
+    *  @brief Writes JSON straight from reflected types, as fc::json::to_string( fc::variant( value ) ) would
+    *
+    *  The members of the json_direct types and the elements of their containers are written as they are visited,
+    *  without the tree of variant objects, whose map nodes and copied keys are most of the cost of serializing a
+    *  large object.  Every other value, such as the IDs, keys and integers with a to_variant() of their own, is
+    *  turned into a variant and written by fc, so the output is the same.  Like the reflected to_variant(),
+    *  members that are empty optionals are left out.
+    */
+   class json_encoder
+   {
+      public:
+         explicit json_encoder( std::string& out ) : _out( out ) {}
+
+         template<typename T>
+         void write( const T& value )
+         {
+            write_value( value, std::integral_constant<bool, json_direct<T>::value>() );
+         }
+
+         template<typename T>
+         void write( const fc::optional<T>& value )
+         {
+            if( value.valid() )
+               write( *value );
+            else
+               _out += "null";
+         }
+
+         template<typename T>
+         void write( const std::vector<T>& values ) { write_array( values ); }
+         template<typename T>
+         void write( const fc::flat_set<T>& values ) { write_array( values ); }
+         template<typename T>
+         void write( const std::set<T>& values )     { write_array( values ); }
+         /** bytes are written as hex like fc does */
+         void write( const std::vector<char>& bytes ) { write_variant( bytes ); }
+         /** maps are written as arrays of [key,value] pairs like fc does */
+         template<typename K, typename V>
+         void write( const std::map<K,V>& values )   { write_array( values ); }
+         template<typename K, typename V>
+         void write( const fc::flat_map<K,V>& values ) { write_array( values ); }
+         template<typename K, typename V>
+         void write( const std::pair<K,V>& value )
+         {
+            _out += '[';
+            write( value.first );
+            _out += ',';
+            write( value.second );
+            _out += ']';
+         }
+
+         void write_raw( const std::string& json ) { _out += json; }
+
+      private:
+         template<typename T>
+         struct member_writer
+         {
+            member_writer( json_encoder& e, const T& v ) : encoder( e ), value( v ) {}
+
+            template<typename Member, class Class, Member (Class::*member)>
+            void operator()( const char* name )const
+            {
+               encoder.write_member( name, value.*member, first );
+            }
+
+            json_encoder& encoder;
+            const T&      value;
+            mutable bool  first = true;
+         };
+
+         template<typename T>
+         void write_value( const T& value, std::true_type )
+         {
+            _out += '{';
+            fc::reflector<T>::visit( member_writer<T>( *this, value ) );
+            _out += '}';
+         }
+
+         template<typename T>
+         void write_value( const T& value, std::false_type ) { write_variant( value ); }
+
+         template<typename T>
+         void write_variant( const T& value )
+         {
+            fc::variant v;
+            fc::to_variant( value, v );
+            _out += fc::json::to_string( v );
+         }
+
+         template<typename Container>
+         void write_array( const Container& values )
+         {
+            _out += '[';
+            bool first = true;
+            for( const auto& value : values )
+            {
+               if( !first )
+                  _out += ',';
+               first = false;
+               write( value );
+            }
+            _out += ']';
+         }
+
+         template<typename M>
+         void write_member( const char* name, const M& value, bool& first )
+         {
+            if( !first )
+               _out += ',';
+            first = false;
+            _out += '"';
+            _out += name;
+            _out += "\":";
+            write( value );
+         }
+
+         template<typename M>
+         void write_member( const char* name, const fc::optional<M>& value, bool& first )
+         {
+            if( value.valid() )
+               write_member( name, *value, first );
+         }
+
+         std::string& _out;
+   };
+
+} } // graphene::db
+
+/** lets json_encoder write the members of @ref TYPE, which must be reflected and have no to_variant() of its own */
+#define GRAPHENE_JSON_DIRECT( TYPE ) \
+   namespace graphene { namespace db { template<> struct json_direct< TYPE > : std::true_type {}; } }
@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 #pragma once
+#include <graphene/db/json_encoder.hpp>
 #include <graphene/db/object_id.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/crypto/city.hpp>
@@ -72,9 +73,16 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         virtual void               copy_from( const object& obj ) = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
+         /** appends the JSON of to_variant() to @ref out without building the variant, see json_encoder */
+         virtual void               to_json( std::string& out )const = 0;
          virtual vector<char>       pack()const = 0;
+         /** replaces this object with the result of pack() of an object of the same type */
+         virtual void               unpack_from( const vector<char>& data ) = 0;
+         /** estimated memory of the object: its size plus its packed size, which stands for what its members hold on the heap */
+         virtual uint64_t           memory_size()const = 0;
          virtual fc::uint128        hash()const = 0;
    };
 
@@ -94,12 +102,24 @@ namespace graphene { namespace db {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
 
+         /** assigns obj to this, reusing any memory already held by this object's members */
+         virtual void    copy_from( const object& obj )
+         {
+            static_cast<DerivedClass&>(*this) = static_cast<const DerivedClass&>(obj);
+         }
+
          virtual void    move_from( object& obj )
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this) ); }
+         virtual void    to_json( std::string& out )const { json_encoder( out ).write( static_cast<const DerivedClass&>(*this) ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual void    unpack_from( const vector<char>& data ) { fc::raw::unpack( data, static_cast<DerivedClass&>(*this) ); }
+         virtual uint64_t memory_size()const
+         {
+            return sizeof(DerivedClass) + fc::raw::pack_size( static_cast<const DerivedClass&>(*this) );
+         }
          virtual fc::uint128  hash()const  {  
              auto tmp = this->pack();
              return fc::city_hash_crc_128( tmp.data(), tmp.size() );
@@ -29,9 +29,39 @@
 #include <fc/log/logger.hpp>
 
 #include <map>
+#include <unordered_set>
 
 namespace graphene { namespace db {
 
+   /**
+    *  The objects changed by a span of history in packed form, an empty buffer means the object was
+    *  removed.  next_ids holds the next id of the indexes that gave out ids.
+    */
+   struct object_diff
+   {
+      vector<object_id_type>                             next_ids;
+      vector< std::pair<object_id_type, vector<char>> >  objects;
+   };
+
+   /** one index file of a saved snapshot, as described by its index_snapshot_header */
+   struct snapshot_manifest_entry
+   {
+      uint8_t        space_id = 0;
+      uint8_t        type_id = 0;
+      uint64_t       object_count = 0;
+      fc::sha256     checksum;
+   };
+
+   /**
+    *  Lists the index files of a snapshot, it is written once every one of them is on disk.  A snapshot
+    *  whose files do not match its manifest is refused as a whole instead of loaded with some indexes
+    *  from another flush.
+    */
+   struct snapshot_manifest
+   {
+      vector<snapshot_manifest_entry> indexes;
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -42,14 +72,82 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes() { _index.clear(); _index.resize(255); _typed_indexes.clear(); }
 
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the complete state of the object_database to disk, this could take a while.  The snapshot is
+          * written to object_database.new and swapped in once it is on disk, so a crash leaves the previous
+          * one in place and open() never sees a half written snapshot.
           */
          void flush();
+
+         /**
+          * Sets the number of worker threads used by open() and flush() to load and save indexes
+          * concurrently, 1 (the default) processes every index on the calling thread.
+          */
+         void set_io_threads( uint32_t threads ) { _io_threads = std::max<uint32_t>( threads, 1 ); }
+         uint32_t get_io_threads()const { return _io_threads; }
+
+         /**
+          * When the changelog is enabled every object that is created, modified or removed is
+          * remembered so that write_checkpoint() can append only those objects to
+          * object_database/changelog.  open() replays the changelog on top of the snapshot written
+          * by the last flush(), which truncates the changelog.
+          */
+         void enable_changelog( bool enable ) { _changelog_enabled = enable; _dirty.clear(); }
+         bool changelog_enabled()const { return _changelog_enabled; }
+
+         /** appends every object changed since the last checkpoint or flush to the changelog */
+         void write_checkpoint();
+         uint64_t changelog_size()const;
+
+         /**
+          * @return the objects created, modified and removed by the newest undo state, in id order.  The undo
+          * database must be enabled.
+          */
+         object_diff undo_head_diff()const;
+         /**
+          * Makes the changes of diff through the indexes, so the undo database and secondary indexes follow
+          * them.  Objects of types without an index here are skipped.
+          */
+         void        apply_diff( const object_diff& diff );
+
+         /**
+          * Writes every index and the manifest to dir in the same format flush() uses, without touching the
+          * changelog.  load_snapshot() loads such a copy into an empty object_database opened on another
+          * directory.
+          */
+         void save_snapshot( const fc::path& dir );
+         void load_snapshot( const fc::path& dir );
+
+         /**
+          * Fills the indexes of this object_database, which must hold no objects yet, with copies of the objects
+          * of other's indexes of the same types.  Types only other has an index for are skipped.
+          */
+         void copy_objects_from( const object_database& other );
+
+         /**
+          * Hash of the complete object state, built from index::hash() and the next id of every index.
+          * Nodes holding the same state compute the same hash, so it can be published to vouch for a snapshot.
+          */
+         fc::sha256 state_hash()const;
+         /**
+          * Keep the hash of every primary index current as its objects change, see base_primary_index::track_hash(),
+          * so state_hash() costs next to nothing instead of hashing every object.
+          */
+         void set_incremental_hash( bool enable );
+         bool incremental_hash()const { return _incremental_hash; }
+
+         /** memory held by the allocators of all indexes, see index::allocated_bytes() */
+         uint64_t allocated_bytes()const;
+         /**
+          * Object counts, estimated memory, change counts and undo memory of every index.  This walks all objects and
+          * all undo states, so it takes a while on a full chain.
+          */
+         vector<index_statistics> get_index_statistics()const;
+
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -68,8 +166,8 @@ namespace graphene { namespace db {
          /// @{
          template<typename IndexType>
          const IndexType& get_index_type()const {
-            static_assert( std::is_base_of<index,IndexType>::value, "Type must be an index type" );
-            return static_cast<const IndexType&>( get_index( IndexType::object_type::space_id, IndexType::object_type::type_id ) );
+            log_index_read<IndexType>();
+            return get_index_type_unlogged<IndexType>();
          }
          template<typename T>
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
@@ -80,16 +178,59 @@ namespace graphene { namespace db {
          const object& get_object( object_id_type id )const;
          const object* find_object( object_id_type id )const;
 
+         /**
+          * While a read log is set, get_object(), find_object() and the typed lookups append the id of every object
+          * they are asked for to it, duplicates included.  Objects found through the other indices of an index are
+          * not logged there; while an index read log is set, get_index_type() appends the index it is asked for to
+          * that one instead, as (space, type, 0).
+          */
+         void set_read_log( vector<object_id_type>* log ) { _read_log = log; }
+         vector<object_id_type>* get_read_log()const { return _read_log; }
+         void set_index_read_log( vector<object_id_type>* log ) { _index_read_log = log; }
+         vector<object_id_type>* get_index_read_log()const { return _index_read_log; }
+         /** logs @ref id as read, for an object found through one of the other indices of its index */
+         void log_read( object_id_type id )const
+         {
+            if( _read_log )
+               _read_log->push_back( id );
+         }
+         /** logs the whole of IndexType as read */
+         template<typename IndexType>
+         void log_index_read()const
+         {
+            if( _index_read_log )
+               _index_read_log->push_back( object_id_type( IndexType::object_type::space_id, IndexType::object_type::type_id, 0 ) );
+         }
+
+         /** adds @ref observer to every index, including those added later, so it sees every change including those of undo */
+         void add_index_observer( const shared_ptr<index_observer>& observer );
+
          /// These methods are mutators of the object_database. You must use these methods to make changes to the object_database,
          /// in order to maintain proper undo history.
          ///@{
 
-         const object& insert( object&& obj ) { return get_mutable_index(obj.id).insert( std::move(obj) ); }
+         const object& insert( object&& obj ) { mark_dirty( obj.id ); return get_mutable_index(obj.id).insert( std::move(obj) ); }
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
             get_mutable_index(obj.id).modify(obj,m);
          }
+         /**
+          * Typed modify for hot paths: calls @ref m directly instead of through a std::function.  IndexType is the
+          * index type passed to add_index() inside primary_index<>, e.g. limit_order_index.
+          */
+         template<typename IndexType, typename Lambda>
+         void modify_typed( const typename IndexType::object_type& obj, const Lambda& m ) {
+            get_mutable_primary_index<IndexType>( obj.id ).modify_typed( obj, m );
+         }
+         /**
+          * Like modify_typed() for a @ref m that changes no field IndexType is keyed on, so the object is not
+          * re-positioned in any of the indices.  Debug builds assert that the keys are unchanged.
+          */
+         template<typename IndexType, typename Lambda>
+         void modify_non_key( const typename IndexType::object_type& obj, const Lambda& m ) {
+            get_mutable_primary_index<IndexType>( obj.id ).modify_non_key( obj, m );
+         }
 
          ///@}
 
@@ -124,6 +265,28 @@ namespace graphene { namespace db {
          template<uint8_t SpaceID, uint8_t TypeID, typename T>
          const T* find( object_id<SpaceID,TypeID,T> id )const { return find<T>(id); }
 
+         /**
+          * Typed lookups for hot paths: the index is resolved at compile time through the cache filled
+          * by add_index() and find() is called without virtual dispatch.  IndexType must be the index
+          * type passed to add_index() inside primary_index<>, e.g. account_index.
+          */
+         template<typename IndexType>
+         const typename IndexType::object_type* find_typed( object_id_type id )const
+         {
+            const IndexType& idx = get_index_type_unlogged<IndexType>();
+            assert( id.space() == IndexType::object_type::space_id && id.type() == IndexType::object_type::type_id );
+            if( _read_log )
+               _read_log->push_back( id );
+            return static_cast<const typename IndexType::object_type*>( idx.IndexType::find( id ) );
+         }
+         template<typename IndexType>
+         const typename IndexType::object_type& get_typed( object_id_type id )const
+         {
+            auto obj = find_typed<IndexType>( id );
+            FC_ASSERT( obj != nullptr, "Unable to find Object", ("id",id) );
+            return *obj;
+         }
+
          template<uint8_t SpaceID, uint8_t TypeID, typename T>
          const T& get( object_id<SpaceID,TypeID,T> id )const { return get<T>(id); }
 
@@ -136,7 +299,13 @@ namespace graphene { namespace db {
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
             unique_ptr<index> indexptr( new IndexType(*this) );
             _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            cache_typed_index<typename IndexType::derived_index_type>( result );
+            for( const auto& observer : _index_observers )
+               result->add_observer( observer );
+            if( _incremental_hash )
+               result->track_hash( true );
+            return result;
          }
 
          void pop_undo();
@@ -146,11 +315,26 @@ namespace graphene { namespace db {
          /** public for testing purposes only... should be private in practice. */
          undo_database                          _undo_db;
      protected:
+         /** get_index_type() without the index read log, for lookups that log what they find themselves */
+         template<typename IndexType>
+         const IndexType& get_index_type_unlogged()const {
+            static_assert( std::is_base_of<index,IndexType>::value, "Type must be an index type" );
+            const index* cached = find_typed_index<IndexType>();
+            if( cached != nullptr )
+               return *static_cast<const IndexType*>( cached );
+            return static_cast<const IndexType&>( get_index( IndexType::object_type::space_id, IndexType::object_type::type_id ) );
+         }
          template<typename IndexType>
          IndexType&    get_mutable_index_type() {
             static_assert( std::is_base_of<index,IndexType>::value, "Type must be an index type" );
             return static_cast<IndexType&>( get_mutable_index( IndexType::object_type::space_id, IndexType::object_type::type_id ) );
          }
+         template<typename IndexType>
+         primary_index<IndexType>& get_mutable_primary_index( object_id_type id ) {
+            index& idx = get_mutable_index( id );
+            assert( nullptr != dynamic_cast<primary_index<IndexType>*>( &idx ) );
+            return static_cast<primary_index<IndexType>&>( idx );
+         }
          template<typename T>
          index& get_mutable_index()                   { return get_mutable_index(T::space_id,T::type_id); }
          index& get_mutable_index(object_id_type id)  { return get_mutable_index(id.space(),id.type());   }
@@ -163,11 +347,60 @@ namespace graphene { namespace db {
          void save_undo( const object& obj );
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
+         void mark_dirty( object_id_type id ) { if( _changelog_enabled ) _dirty.insert( id ); }
+         /** sets the next id of idx so that undoing the current undo state restores the old one */
+         void set_next_id_undoable( index& idx, object_id_type id );
 
+         /** every index type gets a process wide slot in _typed_indexes on first use */
+         static size_t next_typed_index_slot();
+         template<typename IndexType>
+         static size_t typed_index_slot()
+         {
+            static const size_t slot = next_typed_index_slot();
+            return slot;
+         }
+         template<typename IndexType>
+         void cache_typed_index( const IndexType* idx )
+         {
+            const size_t slot = typed_index_slot<IndexType>();
+            if( _typed_indexes.size() <= slot )
+               _typed_indexes.resize( slot + 1, nullptr );
+            _typed_indexes[slot] = idx;
+         }
+         template<typename IndexType>
+         const index* find_typed_index()const
+         {
+            const size_t slot = typed_index_slot<IndexType>();
+            return slot < _typed_indexes.size() ? _typed_indexes[slot] : nullptr;
+         }
+
+         fc::path changelog_path()const { return _data_dir / "object_database" / "changelog"; }
+         /** makes object_database the last complete snapshot again after flush() was interrupted */
+         void recover_snapshot();
+         void replay_changelog();
+
+         /** loads every index from root/space/type, see set_io_threads() */
+         void load_indexes( const fc::path& root );
+
+         /** calls f for every registered index and its file below root, using _io_threads workers, largest file first */
+         void for_each_index_parallel( const fc::path& root, const std::function<void(index&, const fc::path&)>& f );
+
+         uint32_t                                                  _io_threads = 1;
+         bool                                                      _changelog_enabled = false;
+         bool                                                      _incremental_hash = false;
+         std::unordered_set<object_id_type>                        _dirty;
+         vector<object_id_type>*                                   _read_log = nullptr;
+         vector<object_id_type>*                                   _index_read_log = nullptr;
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         vector< const index* >                                    _typed_indexes;
+         vector< shared_ptr<index_observer> >                      _index_observers;
    };
 
 } } // graphene::db
 
+FC_REFLECT( graphene::db::object_diff, (next_ids)(objects) )
+FC_REFLECT( graphene::db::snapshot_manifest_entry, (space_id)(type_id)(object_count)(checksum) )
+FC_REFLECT( graphene::db::snapshot_manifest, (indexes) )
+
 
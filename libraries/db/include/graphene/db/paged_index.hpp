@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+#include <graphene/db/slab_allocator.hpp>
+#include <fc/filesystem.hpp>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class paged_index
+    *  @brief A simple_index that moves the objects which have not been used for a while to a page file
+    *
+    *  Objects are only found by ID, as in simple_index.  Once set_paging() is called, every page_out() packs the
+    *  objects that were not created, modified or read back during the last idle_rounds calls into the page file
+    *  and frees them, find() reads them back transparently.  References to objects stay valid until the next
+    *  page_out(), so its caller has to make sure nobody holds one, the chain database calls it between blocks.
+    *
+    *  The page file is scratch space that is emptied by set_paging(), the objects are saved and loaded with the
+    *  rest of the object database as usual.  Objects are allocated with Allocator, but a slab_allocator never
+    *  returns the memory of freed objects, so it should not be used with paging.
+    *
+    *  find() locks the page file while paging is enabled, so read-only callers on several threads can page in; the
+    *  other reads of the slots take the same lock then.
+    */
+   template<typename T, typename Allocator = std::allocator<T> >
+   class paged_index : public index
+   {
+         struct object_deleter
+         {
+            void operator()( object* obj )const
+            {
+               Allocator alloc;
+               T* ptr = static_cast<T*>( obj );
+               alloc.destroy( ptr );
+               alloc.deallocate( ptr, 1 );
+            }
+         };
+         typedef unique_ptr<object, object_deleter> object_ptr;
+
+         template<typename... Args>
+         static object_ptr make_object( Args&&... args )
+         {
+            Allocator alloc;
+            T* ptr = alloc.allocate( 1 );
+            try {
+               alloc.construct( ptr, std::forward<Args>(args)... );
+            } catch( ... ) {
+               alloc.deallocate( ptr, 1 );
+               throw;
+            }
+            return object_ptr( ptr );
+         }
+
+         struct slot
+         {
+            object_ptr obj;
+            /** where the packed object is in the page file while it is paged out, size is 0 while it is not */
+            uint64_t   pos  = 0;
+            uint32_t   size = 0;
+            /** the page_out() round in which the object was last created, modified or paged in */
+            uint32_t   used = 0;
+
+            bool paged()const { return size > 0; }
+         };
+
+      public:
+         typedef T object_type;
+
+         ~paged_index()
+         {
+            close_page_file();
+         }
+
+         /**
+          *  Page out the objects that were not used during idle_rounds calls to page_out(), to page_file.  0 pages
+          *  every object back in and stops paging.
+          */
+         void set_paging( const fc::path& page_file, uint32_t idle_rounds )
+         {
+            std::lock_guard<std::mutex> lock( _page_mutex );
+            for( size_t instance = 0; instance < _slots.size(); ++instance )
+               page_in( instance );
+            close_page_file();
+
+            _idle_rounds = idle_rounds;
+            if( _idle_rounds == 0 )
+               return;
+            _page_path = page_file;
+            fc::create_directories( _page_path.parent_path() );
+            _page_file.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+            _page_file.open( _page_path.generic_string().c_str(),
+                             std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+         }
+         uint32_t paging_idle_rounds()const { return _idle_rounds; }
+
+         /** moves the objects that were not used during the last idle_rounds calls to the page file */
+         void page_out()
+         {
+            if( _idle_rounds == 0 )
+               return;
+            std::lock_guard<std::mutex> lock( _page_mutex );
+            ++_round;
+            vector<char> packed;
+            for( auto& s : _slots )
+            {
+               if( !s.obj || _round - s.used <= _idle_rounds )
+                  continue;
+               packed.resize( fc::raw::pack_size( static_cast<const T&>(*s.obj) ) );
+               fc::datastream<char*> ds( packed.data(), packed.size() );
+               fc::raw::pack( ds, static_cast<const T&>(*s.obj) );
+               _page_file.seekp( _page_end );
+               _page_file.write( packed.data(), packed.size() );
+               s.pos  = _page_end;
+               s.size = packed.size();
+               s.obj.reset();
+               _page_end   += packed.size();
+               _page_bytes += packed.size();
+               ++_paged_objects;
+            }
+            // objects read back leave their old copies behind, the file is rewritten once they take up most of it
+            if( _page_end > 2 * _page_bytes + compaction_threshold )
+               compact_page_file();
+         }
+
+         /** @return number of objects that are in the page file instead of memory */
+         size_t paged_objects()const { return _paged_objects; }
+
+         virtual const object&  create( const std::function<void(object&)>& constructor ) override
+         {
+             auto id = get_next_id();
+             auto instance = id.instance();
+             if( instance >= _slots.size() ) _slots.resize( instance + 1 );
+             slot& s = _slots[instance];
+             s.obj = make_object();
+             s.obj->id = id;
+             constructor( *s.obj );
+             s.obj->id = id; // just in case it changed
+             s.used = _round;
+             use_next_id();
+             return *s.obj;
+         }
+
+         virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         {
+            assert( obj.id.instance() < _slots.size() );
+            slot& s = _slots[obj.id.instance()];
+            assert( s.obj.get() == &obj );
+            modify_callback( *s.obj );
+            s.used = _round;
+         }
+
+         virtual const object& insert( object&& obj )override
+         {
+            auto instance = obj.id.instance();
+            assert( nullptr != dynamic_cast<T*>(&obj) );
+            if( _slots.size() <= instance ) _slots.resize( instance+1 );
+            slot& s = _slots[instance];
+            assert( !s.obj && !s.paged() );
+            s.obj = make_object( std::move( static_cast<T&>(obj) ) );
+            s.used = _round;
+            return *s.obj;
+         }
+
+         virtual void remove( const object& obj ) override
+         {
+            assert( nullptr != dynamic_cast<const T*>(&obj) );
+            const auto instance = obj.id.instance();
+            assert( _slots[instance].obj.get() == &obj );
+            _slots[instance].obj.reset();
+            while( !_slots.empty() && !_slots.back().obj && !_slots.back().paged() )
+               _slots.pop_back();
+         }
+
+         virtual const object* find( object_id_type id )const override
+         {
+            assert( id.space() == T::space_id );
+            assert( id.type() == T::type_id );
+
+            const auto instance = id.instance();
+            if( _idle_rounds == 0 )
+               return instance < _slots.size() ? _slots[instance].obj.get() : nullptr;
+            std::lock_guard<std::mutex> lock( _page_mutex );
+            if( instance >= _slots.size() ) return nullptr;
+            return page_in( instance );
+         }
+
+         /** paged out objects are read into a copy for the inspector, they stay in the page file */
+         virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( size_t instance = 0; ; ++instance )
+               {
+                  const object* obj = nullptr;
+                  bool paged = false;
+                  T copy;
+                  {
+                     auto lock = lock_slots();
+                     if( instance >= _slots.size() )
+                        break;
+                     const slot& s = _slots[instance];
+                     if( s.obj )
+                        obj = s.obj.get();
+                     else if( s.paged() )
+                     {
+                        copy = read_paged( s );
+                        paged = true;
+                     }
+                  }
+                  if( obj != nullptr )
+                     inspector( *obj );
+                  else if( paged )
+                     inspector( copy );
+               }
+            } FC_CAPTURE_AND_RETHROW()
+         }
+         virtual fc::uint128 hash()const override {
+            fc::uint128 result;
+            inspect_all_objects( [&result]( const object& o ) { result += o.hash(); } );
+            return result;
+         }
+
+         virtual uint64_t allocated_bytes()const override
+         {
+            return allocator_stats<Allocator>::reserved_bytes();
+         }
+
+         /** iterating pages every object in, until the next page_out() */
+         class const_iterator
+         {
+            public:
+               const_iterator( const paged_index& idx, size_t instance ):_index(&idx),_instance(instance)
+               {
+                  skip_empty();
+               }
+               friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._instance == b._instance; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._instance != b._instance; }
+               const T& operator*()const
+               {
+                  return static_cast<const T&>( *_index->find( object_id_type( T::space_id, T::type_id, _instance ) ) );
+               }
+               const_iterator operator++(int)     // postfix
+               {
+                  const_iterator result( *this );
+                  ++(*this);
+                  return result;
+               }
+               const_iterator& operator++()       // prefix
+               {
+                  ++_instance;
+                  skip_empty();
+                  return *this;
+               }
+               typedef std::forward_iterator_tag iterator_category;
+               typedef T value_type;
+               typedef std::ptrdiff_t difference_type;
+               typedef const T* pointer;
+               typedef const T& reference;
+            private:
+               void skip_empty()
+               {
+                  auto lock = _index->lock_slots();
+                  const auto& slots = _index->_slots;
+                  while( _instance < slots.size() && !slots[_instance].obj && !slots[_instance].paged() )
+                     ++_instance;
+               }
+
+               const paged_index* _index;
+               size_t             _instance;
+         };
+         const_iterator begin()const { return const_iterator( *this, 0 ); }
+         const_iterator end()const   { return const_iterator( *this, _slots.size() ); }
+
+         size_t size()const { return _slots.size(); }
+
+      private:
+         static const uint64_t compaction_threshold = 64*1024*1024;
+
+         /** while paging, the page_in() of a reader on another thread writes the slots, so they are read under the lock */
+         std::unique_lock<std::mutex> lock_slots()const
+         {
+            std::unique_lock<std::mutex> lock( _page_mutex, std::defer_lock );
+            if( _idle_rounds > 0 )
+               lock.lock();
+            return lock;
+         }
+
+         /** the caller holds _page_mutex */
+         const object* page_in( size_t instance )const
+         {
+            slot& s = _slots[instance];
+            if( s.paged() )
+            {
+               s.obj = make_object( read_paged( s ) );
+               _page_bytes -= s.size;
+               --_paged_objects;
+               s.size = 0;
+               s.used = _round;
+            }
+            return s.obj.get();
+         }
+
+         /** the caller holds _page_mutex */
+         T read_paged( const slot& s )const
+         {
+            vector<char> packed( s.size );
+            _page_file.seekg( s.pos );
+            _page_file.read( packed.data(), packed.size() );
+            return fc::raw::unpack<T>( packed );
+         }
+
+         /** copies the objects that are still paged out to a new page file, the caller holds _page_mutex */
+         void compact_page_file()
+         {
+            const fc::path compacted_path = _page_path.generic_string() + ".new";
+            std::fstream compacted;
+            compacted.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+            compacted.open( compacted_path.generic_string().c_str(),
+                            std::fstream::binary | std::fstream::out | std::fstream::trunc );
+            uint64_t end = 0;
+            vector<char> packed;
+            for( auto& s : _slots )
+            {
+               if( !s.paged() )
+                  continue;
+               packed.resize( s.size );
+               _page_file.seekg( s.pos );
+               _page_file.read( packed.data(), packed.size() );
+               compacted.write( packed.data(), packed.size() );
+               s.pos = end;
+               end += s.size;
+            }
+            compacted.close();
+            _page_file.close();
+            fc::rename( compacted_path, _page_path );
+            _page_file.open( _page_path.generic_string().c_str(),
+                             std::fstream::binary | std::fstream::in | std::fstream::out );
+            _page_end = end;
+         }
+
+         void close_page_file()
+         {
+            if( !_page_file.is_open() )
+               return;
+            _page_file.close();
+            fc::remove( _page_path );
+            _page_end   = 0;
+            _page_bytes = 0;
+         }
+
+         mutable vector< slot >  _slots;
+         uint32_t                _idle_rounds = 0;
+         uint32_t                _round = 0;
+         fc::path                _page_path;
+         mutable std::fstream    _page_file;
+         uint64_t                _page_end = 0;
+         /** bytes of the objects that are paged out, the rest of the file holds copies of objects read back */
+         mutable uint64_t        _page_bytes = 0;
+         mutable size_t          _paged_objects = 0;
+         mutable std::mutex      _page_mutex;
+   };
+
+} } // graphene::db
@@ -23,6 +23,8 @@
  */
 #pragma once
 #include <graphene/db/index.hpp>
+#include <graphene/db/slab_allocator.hpp>
+#include <memory>
 
 namespace graphene { namespace db {
 
@@ -33,10 +35,39 @@ namespace graphene { namespace db {
     *  This index is preferred in situations where the data will never be
     *  removed from main memory and when access by ID is the only kind
     *  of access that is necessary.
+    *
+    *  Objects are allocated with Allocator, use slab_allocator<T> to keep them in
+    *  contiguous chunks.
     */
-   template<typename T>
+   template<typename T, typename Allocator = std::allocator<T> >
    class simple_index : public index
    {
+         struct object_deleter
+         {
+            void operator()( object* obj )const
+            {
+               Allocator alloc;
+               T* ptr = static_cast<T*>( obj );
+               alloc.destroy( ptr );
+               alloc.deallocate( ptr, 1 );
+            }
+         };
+         typedef unique_ptr<object, object_deleter> object_ptr;
+
+         template<typename... Args>
+         static object_ptr make_object( Args&&... args )
+         {
+            Allocator alloc;
+            T* ptr = alloc.allocate( 1 );
+            try {
+               alloc.construct( ptr, std::forward<Args>(args)... );
+            } catch( ... ) {
+               alloc.deallocate( ptr, 1 );
+               throw;
+            }
+            return object_ptr( ptr );
+         }
+
       public:
          typedef T object_type;
 
@@ -45,7 +76,7 @@ namespace graphene { namespace db {
              auto id = get_next_id();
              auto instance = id.instance();
              if( instance >= _objects.size() ) _objects.resize( instance + 1 );
-             _objects[instance].reset(new T);
+             _objects[instance] = make_object();
              _objects[instance]->id = id;
              constructor( *_objects[instance] );
              _objects[instance]->id = id; // just in case it changed
@@ -65,7 +96,7 @@ namespace graphene { namespace db {
             assert( nullptr != dynamic_cast<T*>(&obj) );
             if( _objects.size() <= instance ) _objects.resize( instance+1 );
             assert( !_objects[instance] );
-            _objects[instance].reset( new T( std::move( static_cast<T&>(obj) ) ) );
+            _objects[instance] = make_object( std::move( static_cast<T&>(obj) ) );
             return *_objects[instance];
          }
 
@@ -106,13 +137,18 @@ namespace graphene { namespace db {
             return result;
          }
 
+         virtual uint64_t allocated_bytes()const override
+         {
+            return allocator_stats<Allocator>::reserved_bytes();
+         }
+
          class const_iterator
          {
             public:
-               const_iterator( const vector<unique_ptr<object>>& objects ):_objects(objects) {}
+               const_iterator( const vector<object_ptr>& objects ):_objects(objects) {}
                const_iterator(
-                  const vector<unique_ptr<object>>& objects,
-                  const vector<unique_ptr<object>>::const_iterator& a ):_itr(a),_objects(objects){}
+                  const vector<object_ptr>& objects,
+                  const typename vector<object_ptr>::const_iterator& a ):_itr(a),_objects(objects){}
                friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._itr == b._itr; }
                friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._itr != b._itr; }
                const T& operator*()const { return static_cast<const T&>(*_itr->get()); }
@@ -130,20 +166,20 @@ namespace graphene { namespace db {
                   return *this;
                }
                typedef std::forward_iterator_tag iterator_category;
-               typedef vector<unique_ptr<object> >::value_type value_type;
-               typedef vector<unique_ptr<object> >::difference_type difference_type;
-               typedef vector<unique_ptr<object> >::pointer pointer;
-               typedef vector<unique_ptr<object> >::reference reference;
+               typedef typename vector<object_ptr>::value_type value_type;
+               typedef typename vector<object_ptr>::difference_type difference_type;
+               typedef typename vector<object_ptr>::pointer pointer;
+               typedef typename vector<object_ptr>::reference reference;
             private:
-               vector<unique_ptr<object>>::const_iterator _itr;
-               const vector<unique_ptr<object>>& _objects;
+               typename vector<object_ptr>::const_iterator _itr;
+               const vector<object_ptr>& _objects;
          };
          const_iterator begin()const { return const_iterator(_objects, _objects.begin()); }
          const_iterator end()const   { return const_iterator(_objects, _objects.end());   }
 
          size_t size()const { return _objects.size(); }
       private:
-         vector< unique_ptr<object> > _objects;
+         vector< object_ptr > _objects;
    };
 
 } } // graphene::db
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @brief memory held by the slab pools that share a tag
+    */
+   struct slab_stats
+   {
+      uint64_t reserved_bytes    = 0; ///< bytes obtained from the system, including free blocks
+      uint64_t allocated_bytes   = 0; ///< bytes currently handed out
+      uint64_t allocated_objects = 0;
+   };
+
+   template<typename Tag>
+   slab_stats& get_slab_stats()
+   {
+      static slab_stats stats;
+      return stats;
+   }
+
+   /**
+    *  @class slab_pool
+    *  @brief hands out fixed size blocks carved from large contiguous chunks
+    *
+    *  Freed blocks go on an intrusive free list and are reused before a new chunk is
+    *  requested, chunks are never returned to the system.  The pool is intentionally leaked
+    *  so that objects destroyed during static destruction can still be released.
+    *
+    *  @note not thread safe, every allocation for one tag must happen on the same thread
+    */
+   template<size_t Size, size_t Align, typename Tag>
+   class slab_pool
+   {
+      struct free_block { free_block* next; };
+
+      public:
+         static const size_t block_size = ( ( Size < sizeof(free_block) ? sizeof(free_block) : Size ) + Align - 1 ) / Align * Align;
+
+         static slab_pool& instance()
+         {
+            static slab_pool* pool = new slab_pool();
+            return *pool;
+         }
+
+         void* allocate()
+         {
+            if( _free == nullptr )
+               grow();
+            free_block* b = _free;
+            _free = b->next;
+            auto& stats = get_slab_stats<Tag>();
+            stats.allocated_bytes += block_size;
+            ++stats.allocated_objects;
+            return b;
+         }
+
+         void deallocate( void* p )
+         {
+            free_block* b = static_cast<free_block*>( p );
+            b->next = _free;
+            _free = b;
+            auto& stats = get_slab_stats<Tag>();
+            stats.allocated_bytes -= block_size;
+            --stats.allocated_objects;
+         }
+
+      private:
+         void grow()
+         {
+            const size_t count = _next_chunk_blocks;
+            char* chunk = static_cast<char*>( ::operator new( count * block_size ) );
+            _chunks.push_back( chunk );
+            // thread the blocks in address order so consecutive allocations are adjacent
+            for( size_t i = count; i > 0; --i )
+            {
+               free_block* b = reinterpret_cast<free_block*>( chunk + (i-1) * block_size );
+               b->next = _free;
+               _free = b;
+            }
+            get_slab_stats<Tag>().reserved_bytes += count * block_size;
+            if( _next_chunk_blocks * block_size < max_chunk_bytes )
+               _next_chunk_blocks *= 2;
+         }
+
+         static const size_t max_chunk_bytes = 4*1024*1024;
+
+         free_block*     _free = nullptr;
+         size_t          _next_chunk_blocks = 64;
+         std::vector<char*> _chunks;
+   };
+
+   /**
+    *  @class slab_allocator
+    *  @brief a stateless allocator that serves single object allocations from a slab_pool
+    *
+    *  Containers rebind the allocator to their node type, the Tag is kept across rebinds so
+    *  that all memory used by one index is accounted to the same slab_stats.  Array
+    *  allocations such as hash buckets go to the global heap but are still counted.
+    */
+   template<typename T, typename Tag = T>
+   class slab_allocator
+   {
+      public:
+         typedef T              value_type;
+         typedef T*             pointer;
+         typedef const T*       const_pointer;
+         typedef T&             reference;
+         typedef const T&       const_reference;
+         typedef std::size_t    size_type;
+         typedef std::ptrdiff_t difference_type;
+
+         template<typename U>
+         struct rebind { typedef slab_allocator<U, Tag> other; };
+
+         slab_allocator(){}
+         template<typename U>
+         slab_allocator( const slab_allocator<U, Tag>& ){}
+
+         pointer allocate( size_type n, const void* = nullptr )
+         {
+            if( n == 1 )
+               return static_cast<pointer>( pool_type::instance().allocate() );
+            auto& stats = get_slab_stats<Tag>();
+            stats.reserved_bytes  += n * sizeof(T);
+            stats.allocated_bytes += n * sizeof(T);
+            return static_cast<pointer>( ::operator new( n * sizeof(T) ) );
+         }
+
+         void deallocate( pointer p, size_type n )
+         {
+            if( n == 1 )
+            {
+               pool_type::instance().deallocate( p );
+               return;
+            }
+            auto& stats = get_slab_stats<Tag>();
+            stats.reserved_bytes  -= n * sizeof(T);
+            stats.allocated_bytes -= n * sizeof(T);
+            ::operator delete( p );
+         }
+
+         template<typename U, typename... Args>
+         void construct( U* p, Args&&... args ) { ::new( (void*)p ) U( std::forward<Args>(args)... ); }
+         template<typename U>
+         void destroy( U* p ) { p->~U(); }
+
+         pointer       address( reference r )const       { return &r; }
+         const_pointer address( const_reference r )const { return &r; }
+         size_type     max_size()const { return size_type(-1) / sizeof(T); }
+
+         template<typename U>
+         bool operator == ( const slab_allocator<U, Tag>& )const { return true; }
+         template<typename U>
+         bool operator != ( const slab_allocator<U, Tag>& )const { return false; }
+
+      private:
+         typedef slab_pool< sizeof(T), alignof(T), Tag > pool_type;
+   };
+
+   /** reports the memory held by an allocator type, 0 for allocators that do not track it */
+   template<typename Allocator>
+   struct allocator_stats
+   {
+      static uint64_t reserved_bytes() { return 0; }
+   };
+
+   template<typename T, typename Tag>
+   struct allocator_stats< slab_allocator<T, Tag> >
+   {
+      static uint64_t reserved_bytes() { return get_slab_stats<Tag>().reserved_bytes; }
+   };
+
+} } // graphene::db
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <algorithm>
 #include <deque>
 #include <fc/exception/exception.hpp>
 
@@ -32,12 +33,180 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
+   namespace detail
+   {
+      inline object_id_type undo_key( const object_id_type& id ) { return id; }
+      template<typename V>
+      inline object_id_type undo_key( const std::pair<object_id_type,V>& entry ) { return entry.first; }
+   }
+
+   /**
+    *  @class undo_table
+    *  @brief open addressing hash table keyed by object id with densely stored entries
+    *
+    *  Entries live in a vector in insertion order and the hash slots only hold indexes into
+    *  it, so iteration is a linear scan.  clear() keeps all memory which lets the undo_database
+    *  reuse a table for the next session without touching the heap.
+    */
+   template<typename Entry>
+   class undo_table
+   {
+      public:
+         typedef Entry                                  value_type;
+         typedef typename vector<Entry>::iterator       iterator;
+         typedef typename vector<Entry>::const_iterator const_iterator;
+
+         iterator       begin()       { return _entries.begin(); }
+         iterator       end()         { return _entries.end();   }
+         const_iterator begin()const  { return _entries.begin(); }
+         const_iterator end()const    { return _entries.end();   }
+         size_t         size()const   { return _entries.size();  }
+         bool           empty()const  { return _entries.empty(); }
+
+         iterator find( object_id_type id )
+         {
+            const size_t slot = find_slot( id );
+            return slot == npos ? end() : begin() + (_slots[slot] - 1);
+         }
+         const_iterator find( object_id_type id )const
+         {
+            const size_t slot = find_slot( id );
+            return slot == npos ? end() : begin() + (_slots[slot] - 1);
+         }
+         size_t count( object_id_type id )const { return find_slot( id ) == npos ? 0 : 1; }
+
+         std::pair<iterator,bool> insert( const Entry& entry )
+         {
+            Entry copy( entry );
+            return insert( std::move(copy) );
+         }
+
+         std::pair<iterator,bool> insert( Entry&& entry )
+         {
+            const object_id_type id = detail::undo_key( entry );
+            size_t slot = find_slot( id );
+            if( slot != npos )
+               return std::make_pair( begin() + (_slots[slot] - 1), false );
+            if( (_entries.size() + 1) * 2 > _slots.size() )
+               rehash( std::max<size_t>( 16, _slots.size() * 2 ) );
+            _entries.push_back( std::move(entry) );
+            slot = home( id );
+            while( _slots[slot] != 0 ) slot = (slot + 1) & (_slots.size() - 1);
+            _slots[slot] = _entries.size();
+            return std::make_pair( end() - 1, true );
+         }
+
+         size_t erase( object_id_type id )
+         {
+            size_t slot = find_slot( id );
+            if( slot == npos ) return 0;
+            const size_t index = _slots[slot] - 1;
+            remove_slot( slot );
+
+            // keep the entries dense by moving the last one into the hole
+            const size_t last = _entries.size() - 1;
+            if( index != last )
+            {
+               size_t moved = slot_of_entry( last );
+               _entries[index] = std::move( _entries[last] );
+               _slots[moved] = index + 1;
+            }
+            _entries.pop_back();
+            return 1;
+         }
+
+         void clear()
+         {
+            for( size_t i = 0; i < _entries.size(); ++i )
+               _slots[slot_of_entry(i)] = 0;
+            _entries.clear();
+         }
+
+      protected:
+         static const size_t npos = size_t(-1);
+
+         size_t home( object_id_type id )const
+         {
+            return size_t( (id.number * 0x9E3779B97F4A7C15ull) >> 32 ) & (_slots.size() - 1);
+         }
+
+         size_t find_slot( object_id_type id )const
+         {
+            if( _slots.empty() ) return npos;
+            for( size_t slot = home( id ); _slots[slot] != 0; slot = (slot + 1) & (_slots.size() - 1) )
+               if( detail::undo_key( _entries[_slots[slot] - 1] ) == id )
+                  return slot;
+            return npos;
+         }
+
+         /** finds the slot that refers to _entries[index], which must be present */
+         size_t slot_of_entry( size_t index )const
+         {
+            size_t slot = home( detail::undo_key( _entries[index] ) );
+            while( _slots[slot] != index + 1 ) slot = (slot + 1) & (_slots.size() - 1);
+            return slot;
+         }
+
+         /** backward shift deletion, keeps every probe chain free of holes */
+         void remove_slot( size_t hole )
+         {
+            const size_t mask = _slots.size() - 1;
+            for( size_t next = (hole + 1) & mask; _slots[next] != 0; next = (next + 1) & mask )
+            {
+               const size_t h = home( detail::undo_key( _entries[_slots[next] - 1] ) );
+               const bool in_range = hole <= next ? ( hole < h && h <= next ) : ( hole < h || h <= next );
+               if( in_range ) continue;
+               _slots[hole] = _slots[next];
+               hole = next;
+            }
+            _slots[hole] = 0;
+         }
+
+         void rehash( size_t slot_count )
+         {
+            _slots.assign( slot_count, 0 );
+            for( size_t i = 0; i < _entries.size(); ++i )
+            {
+               size_t slot = home( detail::undo_key( _entries[i] ) );
+               while( _slots[slot] != 0 ) slot = (slot + 1) & (slot_count - 1);
+               _slots[slot] = i + 1;
+            }
+         }
+
+         vector<Entry>    _entries;
+         vector<uint32_t> _slots;
+   };
+
+   typedef undo_table<object_id_type> undo_id_set;
+
+   template<typename V>
+   class undo_id_map : public undo_table< std::pair<object_id_type, V> >
+   {
+      public:
+         V& operator[]( object_id_type id )
+         {
+            return this->insert( std::make_pair( id, V() ) ).first->second;
+         }
+   };
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      undo_id_map< unique_ptr<object> >  old_values;
+      undo_id_map< object_id_type >      old_index_next_ids;
+      undo_id_set                        new_ids;
+      undo_id_map< unique_ptr<object> >  removed;
+      /** number of later states that were folded into this one by undo_database compaction */
+      uint32_t                           merged_states = 0;
+
+      /** empties the state but keeps its memory for reuse */
+      void clear()
+      {
+         old_values.clear();
+         old_index_next_ids.clear();
+         new_ids.clear();
+         removed.clear();
+         merged_states = 0;
+      }
    };
 
 
@@ -117,6 +286,16 @@ namespace graphene { namespace db {
           * want to re-delete it if this state is undone.
           */
          void on_remove( const object& obj );
+         /**
+          * This should be called just before the next id of an index is set other than by creating an object, with
+          * the next id it had, so undoing the state sets it back.
+          */
+         void on_set_next_id( object_id_type old_next_id );
+
+         /** number of on_create(), on_modify() and on_remove() calls so far, counted while disabled as well */
+         uint64_t created_objects()const  { return _created_objects; }
+         uint64_t modified_objects()const { return _modified_objects; }
+         uint64_t removed_objects()const  { return _removed_objects; }
 
          /**
           *  Removes the last committed session,
@@ -127,21 +306,65 @@ namespace graphene { namespace db {
          void pop_commit();
 
          std::size_t size()const { return _stack.size(); }
-         void set_max_size(size_t new_max_size) { _max_size = new_max_size; }
+         /** releases committed states beyond the new maximum immediately */
+         void set_max_size(size_t new_max_size);
          size_t max_size()const { return _max_size; }
 
+         /**
+          * When non-zero, committed states older than depth are merged into a single state as soon as
+          * a session is committed.  The merged state keeps only the oldest copy of each object, which
+          * bounds memory during long stretches without irreversibility, but blocks inside it can no
+          * longer be popped one by one, so forks deeper than depth cannot be switched to.
+          */
+         void set_compaction_depth( size_t depth ) { _compaction_depth = depth; compact(); }
+         size_t compaction_depth()const { return _compaction_depth; }
+
+         /** number of states, from the newest, that can be undone individually */
+         size_t undoable_size()const;
+
+         /**
+          * Objects saved in discarded undo states are kept, up to this many per object type, and
+          * reused by later sessions.  Copying into a recycled object reuses the memory of its
+          * containers instead of allocating a fresh clone.
+          */
+         void set_max_recycled_objects( size_t max_per_type ) { _max_recycled = max_per_type; }
+
          const undo_state& head()const;
+         /** all undo states, oldest first */
+         const std::deque<undo_state>& states()const { return _stack; }
 
       private:
          void undo();
          void merge();
          void commit();
 
+         void               merge_into( undo_state& prev_state, undo_state& state );
+         void               compact();
+
+         unique_ptr<object> make_copy( const object& obj );
+         void               recycle( unique_ptr<object>&& obj );
+         void               recycle_state( undo_state& state );
+
+         /** appends a state to _stack, reusing a previously released one when possible */
+         void               push_state();
+         /** empties and keeps the state at the back or front of _stack for push_state() */
+         void               release_back();
+         void               release_front();
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
          object_database&        _db;
          size_t                  _max_size = 256;
+         size_t                  _compaction_depth = 0;
+
+         unordered_map<object_id_type, vector< unique_ptr<object> > > _recycled;
+         size_t                  _max_recycled = 1024;
+
+         uint64_t                _created_objects  = 0;
+         uint64_t                _modified_objects = 0;
+         uint64_t                _removed_objects  = 0;
+         vector<undo_state>      _spare_states;
    };
 
 } } // graphene::db
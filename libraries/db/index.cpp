@@ -25,19 +25,60 @@
 #include <graphene/db/index.hpp>
 #include <graphene/db/object_database.hpp>
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace graphene { namespace db {
+   void sync_file( const fc::path& p )
+   {
+#ifdef _WIN32
+      // directories can not be opened this way, NTFS keeps their entries in its journal
+      if( fc::is_directory( p ) )
+         return;
+      int fd = _open( p.generic_string().c_str(), _O_RDWR | _O_BINARY );
+      FC_ASSERT( fd >= 0, "Unable to open ${p} to write it to disk", ("p",p) );
+      const int result = _commit( fd );
+      _close( fd );
+#else
+      int fd = ::open( p.generic_string().c_str(), fc::is_directory( p ) ? O_RDONLY : O_RDWR );
+      FC_ASSERT( fd >= 0, "Unable to open ${p} to write it to disk", ("p",p) );
+      const int result = ::fsync( fd );
+      ::close( fd );
+#endif
+      FC_ASSERT( result == 0, "Unable to write ${p} to disk", ("p",p) );
+   }
+
    void base_primary_index::save_undo( const object& obj )
    { _db.save_undo( obj ); }
 
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      _db.mark_dirty( obj.id );
+      for( auto ob : _observers ) ob->on_add( obj );
+   }
+
+   void base_primary_index::on_insert( const object& obj )
+   {
+      _db.mark_dirty( obj.id );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   {
+      _db.save_undo_remove( obj );
+      _db.mark_dirty( obj.id );
+      for( auto ob : _observers ) ob->on_remove( obj );
+   }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   {
+      _db.mark_dirty( obj.id );
+      for( auto ob : _observers ) ob->on_modify(  obj );
+   }
 } } // graphene::chain
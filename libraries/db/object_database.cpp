@@ -26,9 +26,17 @@
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 
 namespace graphene { namespace db {
 
+   /** one entry of the changelog, the objects changed since the previous checkpoint */
+   typedef object_diff changelog_checkpoint;
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -38,16 +46,26 @@ object_database::object_database()
 
 object_database::~object_database(){}
 
+size_t object_database::next_typed_index_slot()
+{
+   static std::atomic<size_t> next_slot(0);
+   return next_slot++;
+}
+
 void object_database::close()
 {
 }
 
 const object* object_database::find_object( object_id_type id )const
 {
+   if( _read_log )
+      _read_log->push_back( id );
    return get_index(id.space(),id.type()).find( id );
 }
 const object& object_database::get_object( object_id_type id )const
 {
+   if( _read_log )
+      _read_log->push_back( id );
    return get_index(id.space(),id.type()).get( id );
 }
 
@@ -68,17 +86,389 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+void object_database::add_index_observer( const shared_ptr<index_observer>& observer )
+{
+   _index_observers.push_back( observer );
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->add_observer( observer );
+}
+
+namespace {
+   const char* const manifest_file_name = "manifest.json";
+
+   index_snapshot_header read_snapshot_header( const fc::path& file )
+   {
+      std::ifstream in( file.generic_string(), std::ifstream::binary );
+      vector<char> page( index_snapshot_header::page_size );
+      in.read( page.data(), page.size() );
+      fc::datastream<const char*> ds( page.data(), in.gcount() );
+      index_snapshot_header header;
+      fc::raw::unpack( ds, header );
+      FC_ASSERT( header.magic == index_snapshot_header::magic_value, "Not an index snapshot", ("file",file) );
+      return header;
+   }
+}
+
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
+   const fc::path dir     = _data_dir / "object_database";
+   const fc::path new_dir = _data_dir / "object_database.new";
+   const fc::path old_dir = _data_dir / "object_database.old";
+   if( fc::exists( new_dir ) )
+      fc::remove_all( new_dir );
+   save_snapshot( new_dir );
+
+   // a crash between the renames leaves only one of the directories, recover_snapshot() takes it back
+   if( fc::exists( dir ) )
+      fc::rename( dir, old_dir );
+   fc::rename( new_dir, dir );
+   sync_file( _data_dir );
+   // the changelog goes with the old snapshot, the new one contains everything it recorded
+   fc::remove_all( old_dir );
+   _dirty.clear();
+}
+
+void object_database::save_snapshot( const fc::path& dir )
+{
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      fc::create_directories( dir / fc::to_string(space) );
+   for_each_index_parallel( dir, []( index& idx, const fc::path& p ) { idx.save( p ); } );
+
+   snapshot_manifest manifest;
+   for( uint32_t space = 0; space < _index.size(); ++space )
+   {
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+      {
+         if( !_index[space][type] ) continue;
+         const auto header = read_snapshot_header( dir / fc::to_string(space) / fc::to_string(type) );
+         snapshot_manifest_entry entry;
+         entry.space_id     = space;
+         entry.type_id      = type;
+         entry.object_count = header.object_count;
+         entry.checksum     = header.checksum;
+         manifest.indexes.push_back( entry );
+      }
+      sync_file( dir / fc::to_string(space) );
+   }
+   fc::json::save_to_file( manifest, dir / manifest_file_name );
+   sync_file( dir / manifest_file_name );
+   sync_file( dir );
+}
+
+void object_database::load_snapshot( const fc::path& dir )
+{ try {
+   ilog( "Loading object database snapshot from ${d} ...", ("d", dir) );
+   load_indexes( dir );
+   // the snapshot replaces whatever a previous changelog recorded
+   if( fc::exists( changelog_path() ) )
+      fc::remove( changelog_path() );
+   _dirty.clear();
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void object_database::copy_objects_from( const object_database& other )
+{ try {
+   for( uint32_t space = 0; space < other._index.size() && space < _index.size(); ++space )
+      for( uint32_t type = 0; type < other._index[space].size() && type < _index[space].size(); ++type )
+      {
+         const auto& from = other._index[space][type];
+         const auto& to = _index[space][type];
+         if( !from || !to ) continue;
+         from->inspect_all_objects( [&to]( const object& o ) {
+            to->insert( std::move( *o.clone() ) );
+         });
+         to->set_next_id( from->get_next_id() );
+      }
+} FC_CAPTURE_AND_RETHROW() }
+
+fc::sha256 object_database::state_hash()const
+{
+   fc::sha256::encoder enc;
    for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+      {
+         const auto& idx = _index[space][type];
+         if( !idx ) continue;
+         const fc::uint128 h = idx->hash();
+         fc::raw::pack( enc, idx->get_next_id() );
+         fc::raw::pack( enc, h.high_bits() );
+         fc::raw::pack( enc, h.low_bits() );
+      }
+   return enc.result();
+}
+
+void object_database::set_incremental_hash( bool enable )
+{
+   _incremental_hash = enable;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         auto primary = dynamic_cast<base_primary_index*>( idx.get() );
+         if( primary )
+            primary->track_hash( enable );
+      }
+}
+
+uint64_t object_database::allocated_bytes()const
+{
+   uint64_t result = 0;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result += idx->allocated_bytes();
+   return result;
+}
+
+vector<index_statistics> object_database::get_index_statistics()const
+{
+   vector<index_statistics> result;
+   // position of each index in result
+   vector<vector<int32_t>> positions( _index.size() );
+   for( uint32_t space = 0; space < _index.size(); ++space )
+   {
+      positions[space].resize( _index[space].size(), -1 );
+      for( uint32_t type = 0; type < _index[space].size(); ++type )
+         if( _index[space][type] )
+         {
+            positions[space][type] = result.size();
+            result.push_back( _index[space][type]->get_statistics() );
+            result.back().undo_bytes.resize( _undo_db.states().size() );
+         }
+   }
+
+   auto add_undo_bytes = [&]( size_t state, object_id_type id, const object& obj ) {
+      if( id.space() < positions.size() && id.type() < positions[id.space()].size()
+          && positions[id.space()][id.type()] >= 0 )
+         result[ positions[id.space()][id.type()] ].undo_bytes[state] += obj.memory_size();
+   };
+   size_t state = 0;
+   for( const undo_state& s : _undo_db.states() )
+   {
+      for( const auto& item : s.old_values )
+         add_undo_bytes( state, item.first, *item.second );
+      for( const auto& item : s.removed )
+         add_undo_bytes( state, item.first, *item.second );
+      ++state;
+   }
+   return result;
+}
+
+void object_database::write_checkpoint()
+{ try {
+   if( !_changelog_enabled ) return;
+
+   changelog_checkpoint checkpoint;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            checkpoint.next_ids.push_back( idx->get_next_id() );
+
+   checkpoint.objects.reserve( _dirty.size() );
+   for( const auto& id : _dirty )
+   {
+      const object* obj = find_object( id );
+      checkpoint.objects.emplace_back( id, obj ? obj->pack() : vector<char>() );
+   }
+
+   fc::create_directories( _data_dir / "object_database" );
+   std::ofstream out( changelog_path().generic_string(),
+                      std::ofstream::binary | std::ofstream::out | std::ofstream::app );
+   FC_ASSERT( out );
+   fc::raw::pack( out, fc::raw::pack( checkpoint ) );
+   out.flush();
+   FC_ASSERT( out, "Error writing object database changelog" );
+   _dirty.clear();
+} FC_CAPTURE_AND_RETHROW() }
+
+uint64_t object_database::changelog_size()const
+{
+   return fc::exists( changelog_path() ) ? fc::file_size( changelog_path() ) : 0;
+}
+
+object_diff object_database::undo_head_diff()const
+{ try {
+   FC_ASSERT( _undo_db.enabled() && _undo_db.size() > 0, "There is no undo state to take the changes from" );
+   const undo_state& head = _undo_db.head();
+
+   object_diff diff;
+   diff.next_ids.reserve( head.old_index_next_ids.size() );
+   for( const auto& item : head.old_index_next_ids )
+      diff.next_ids.push_back( get_index( item.first.space(), item.first.type() ).get_next_id() );
+
+   // the removed objects are disjoint from the created and modified ones
+   diff.objects.reserve( head.new_ids.size() + head.old_values.size() + head.removed.size() );
+   for( const auto& id : head.new_ids )
+      diff.objects.emplace_back( id, get_object( id ).pack() );
+   for( const auto& item : head.old_values )
+      diff.objects.emplace_back( item.first, get_object( item.first ).pack() );
+   for( const auto& item : head.removed )
+      diff.objects.emplace_back( item.first, vector<char>() );
+   std::sort( diff.objects.begin(), diff.objects.end(),
+              []( const std::pair<object_id_type, vector<char>>& a, const std::pair<object_id_type, vector<char>>& b ) {
+                 return a.first < b.first;
+              } );
+   return diff;
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::set_next_id_undoable( index& idx, object_id_type id )
+{
+   const object_id_type old_next_id = idx.get_next_id();
+   if( old_next_id == id )
+      return;
+   _undo_db.on_set_next_id( old_next_id );
+   idx.set_next_id( id );
+}
+
+void object_database::apply_diff( const object_diff& diff )
+{ try {
+   auto find_index = [this]( object_id_type id ) -> index* {
+      if( id.space() >= _index.size() || id.type() >= _index[id.space()].size() )
+         return nullptr;
+      return _index[id.space()][id.type()].get();
+   };
+
+   // removed objects go first, so the objects taking over their unique keys can be modified or created
+   vector< const std::pair<object_id_type, vector<char>>* > changed;
+   changed.reserve( diff.objects.size() );
+   for( const auto& item : diff.objects )
+   {
+      index* idx = find_index( item.first );
+      if( !idx )
+         continue;
+      if( !item.second.empty() )
+      {
+         changed.push_back( &item );
+         continue;
+      }
+      if( const object* existing = idx->find( item.first ) )
+         idx->remove( *existing );
+   }
+
+   for( const auto* item : changed )
+   {
+      index& idx = *find_index( item->first );
+      if( const object* existing = idx.find( item->first ) )
+         idx.modify( *existing, [item]( object& obj ) { obj.unpack_from( item->second ); } );
+   }
+   // the objects are in id order, so every index creates them in the order it gave out their ids
+   for( const auto* item : changed )
+   {
+      index& idx = *find_index( item->first );
+      if( idx.find( item->first ) )
+         continue;
+      set_next_id_undoable( idx, item->first );
+      idx.create( [item]( object& obj ) { obj.unpack_from( item->second ); } );
+   }
+
+   for( const auto& id : diff.next_ids )
+      if( index* idx = find_index( id ) )
+         set_next_id_undoable( *idx, id );
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::replay_changelog()
+{ try {
+   const auto path = changelog_path();
+   if( !fc::exists( path ) || fc::file_size( path ) == 0 ) return;
+
+   ilog( "Replaying object database changelog..." );
+   fc::file_mapping fm( path.generic_string().c_str(), fc::read_only );
+   fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size( path ) );
+   fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+
+   const bool undo_enabled = _undo_db.enabled();
+   _undo_db.disable();
+   uint32_t count = 0;
+   try {
+      while( ds.remaining() > 0 )
+      {
+         changelog_checkpoint checkpoint;
+         try {
+            vector<char> data;
+            fc::raw::unpack( ds, data );
+            checkpoint = fc::raw::unpack<changelog_checkpoint>( data );
+         } catch( const fc::exception& ) {
+            // a checkpoint that was being written when the node stopped
+            wlog( "Ignoring truncated changelog entry after ${n} checkpoints", ("n",count) );
+            break;
+         }
+
+         for( const auto& id : checkpoint.next_ids )
+            get_mutable_index( id.space(), id.type() ).set_next_id( id );
+         for( const auto& item : checkpoint.objects )
+         {
+            index& idx = get_mutable_index( item.first.space(), item.first.type() );
+            const object* existing = idx.find( item.first );
+            if( existing )
+               idx.remove( *existing );
+            if( !item.second.empty() )
+               idx.load( item.second );
+         }
+         ++count;
+      }
+   } catch( ... ) {
+      if( undo_enabled ) _undo_db.enable();
+      throw;
+   }
+   if( undo_enabled ) _undo_db.enable();
+   _dirty.clear();
+   ilog( "Replayed ${n} changelog checkpoints", ("n",count) );
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::for_each_index_parallel( const fc::path& root, const std::function<void(index&, const fc::path&)>& f )
+{
+   struct work_item
    {
-      fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
-      const auto types = _index[space].size();
-      for( uint32_t type = 0; type  <  types; ++type )
+      index*   idx;
+      fc::path file;
+      uint64_t file_size;
+   };
+   vector<work_item> work;
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+         {
+            auto file = root / fc::to_string(space)/fc::to_string(type);
+            work.push_back( work_item{ _index[space][type].get(), file, fc::exists( file ) ? fc::file_size( file ) : 0 } );
+         }
+
+   if( _io_threads <= 1 || work.size() <= 1 )
+   {
+      for( const auto& item : work )
+         f( *item.idx, item.file );
+      return;
+   }
+
+   // hand out the biggest files first so the total time is bounded by the largest index
+   std::stable_sort( work.begin(), work.end(), []( const work_item& a, const work_item& b ) {
+      return a.file_size > b.file_size;
+   });
+
+   const uint32_t thread_count = std::min<uint32_t>( _io_threads, work.size() );
+   vector< unique_ptr<fc::thread> > threads;
+   vector< fc::future<void> >       results;
+   std::atomic<size_t>              next(0);
+   for( uint32_t i = 0; i < thread_count; ++i )
+   {
+      threads.emplace_back( new fc::thread( "object_database_io_" + fc::to_string(i) ) );
+      results.push_back( threads.back()->async( [&]() {
+         for( size_t n = next++; n < work.size(); n = next++ )
+            f( *work[n].idx, work[n].file );
+      }, "object_database_io" ) );
    }
+
+   std::exception_ptr error;
+   for( auto& r : results )
+   {
+      try {
+         r.wait();
+      } catch( ... ) {
+         if( !error ) error = std::current_exception();
+      }
+   }
+   if( error )
+      std::rethrow_exception( error );
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -86,6 +476,9 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   fc::remove_all(data_dir / "object_database.new");
+   fc::remove_all(data_dir / "object_database.old");
+   _dirty.clear();
    ilog("Done wiping object databse.");
 }
 
@@ -93,14 +486,89 @@ void object_database::open(const fc::path& data_dir)
 { try {
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    _data_dir = data_dir;
-   for( uint32_t space = 0; space < _index.size(); ++space )
-      for( uint32_t type = 0; type  < _index[space].size(); ++type )
-         if( _index[space][type] )
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+   recover_snapshot();
+   load_indexes( _data_dir / "object_database" );
+   replay_changelog();
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void object_database::recover_snapshot()
+{
+   const fc::path dir     = _data_dir / "object_database";
+   const fc::path new_dir = _data_dir / "object_database.new";
+   const fc::path old_dir = _data_dir / "object_database.old";
+   if( !fc::exists( dir ) )
+   {
+      // the new snapshot is complete once its manifest is written
+      if( fc::exists( new_dir / manifest_file_name ) )
+      {
+         wlog( "Taking the object database snapshot that was written when the node stopped" );
+         fc::rename( new_dir, dir );
+      }
+      else if( fc::exists( old_dir ) )
+      {
+         wlog( "Going back to the previous object database snapshot, the node stopped while writing a new one" );
+         fc::rename( old_dir, dir );
+      }
+   }
+   if( fc::exists( new_dir ) )
+      fc::remove_all( new_dir );
+   if( fc::exists( old_dir ) )
+      fc::remove_all( old_dir );
+}
+
+void object_database::load_indexes( const fc::path& root )
+{
+   const fc::path manifest_path = root / manifest_file_name;
+   if( fc::exists( manifest_path ) )
+   {
+      // every file must belong to this snapshot, the checksums of their contents are checked as they load
+      const auto manifest = fc::json::from_file( manifest_path ).as<snapshot_manifest>();
+      for( const auto& entry : manifest.indexes )
+      {
+         if( entry.space_id >= _index.size() || entry.type_id >= _index[entry.space_id].size()
+             || !_index[entry.space_id][entry.type_id] )
+            continue;
+         const fc::path file = root / fc::to_string(entry.space_id) / fc::to_string(entry.type_id);
+         FC_ASSERT( fc::exists( file ), "The snapshot is missing ${f}", ("f",file) );
+         const auto header = read_snapshot_header( file );
+         FC_ASSERT( header.object_count == entry.object_count && header.checksum == entry.checksum,
+                    "${f} does not belong to the snapshot of its manifest", ("f",file) );
+      }
+   }
+
+   if( _io_threads <= 1 )
+   {
+      for_each_index_parallel( root, []( index& idx, const fc::path& p ) { idx.open( p ); } );
+      return;
+   }
+
+   // secondary indexes are rebuilt on this thread once every primary index is loaded
+   auto set_deferred = [&]( bool defer ) {
+      for( const auto& space : _index )
+         for( const auto& idx : space )
+         {
+            base_primary_index* primary = dynamic_cast<base_primary_index*>( idx.get() );
+            if( primary ) primary->defer_secondary_indexes( defer );
+         }
+   };
+   set_deferred( true );
+   try {
+      for_each_index_parallel( root, []( index& idx, const fc::path& p ) { idx.open( p ); } );
+   } catch( ... ) {
+      set_deferred( false );
+      throw;
+   }
+   set_deferred( false );
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+      {
+         base_primary_index* primary = dynamic_cast<base_primary_index*>( idx.get() );
+         if( primary ) primary->rebuild_secondary_indexes();
+      }
+}
+
 
 void object_database::pop_undo()
 { try {
@@ -38,18 +38,19 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
-      _stack.pop_front();
+      release_front();
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
 void undo_database::on_create( const object& obj )
 {
+   ++_created_objects;
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -59,23 +60,25 @@ void undo_database::on_create( const object& obj )
 }
 void undo_database::on_modify( const object& obj )
 {
+   ++_modified_objects;
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   state.old_values[obj.id] = make_copy( obj );
 }
 void undo_database::on_remove( const object& obj )
 {
+   ++_removed_objects;
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    undo_state& state = _stack.back();
    if( state.new_ids.count(obj.id) )
    {
@@ -89,7 +92,76 @@ void undo_database::on_remove( const object& obj )
       return;
    }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed[obj.id] = make_copy( obj );
+}
+
+void undo_database::on_set_next_id( object_id_type old_next_id )
+{
+   if( _disabled ) return;
+
+   if( _stack.empty() )
+      push_state();
+   auto& state = _stack.back();
+   auto index_id = object_id_type( old_next_id.space(), old_next_id.type(), 0 );
+   if( state.old_index_next_ids.find( index_id ) == state.old_index_next_ids.end() )
+      state.old_index_next_ids[index_id] = old_next_id;
+}
+
+unique_ptr<object> undo_database::make_copy( const object& obj )
+{
+   auto itr = _recycled.find( object_id_type( obj.id.space(), obj.id.type(), 0 ) );
+   if( itr == _recycled.end() || itr->second.empty() )
+      return obj.clone();
+   unique_ptr<object> result = std::move( itr->second.back() );
+   itr->second.pop_back();
+   result->copy_from( obj );
+   return result;
+}
+
+void undo_database::recycle( unique_ptr<object>&& obj )
+{
+   if( !obj ) return;
+   auto& pool = _recycled[ object_id_type( obj->id.space(), obj->id.type(), 0 ) ];
+   if( pool.size() < _max_recycled )
+      pool.push_back( std::move(obj) );
+   else
+      obj.reset();
+}
+
+void undo_database::recycle_state( undo_state& state )
+{
+   for( auto& item : state.old_values )
+      recycle( std::move(item.second) );
+   for( auto& item : state.removed )
+      recycle( std::move(item.second) );
+   state.clear();
+}
+
+void undo_database::push_state()
+{
+   if( _spare_states.empty() )
+   {
+      _stack.emplace_back();
+      return;
+   }
+   _stack.emplace_back( std::move( _spare_states.back() ) );
+   _spare_states.pop_back();
+}
+
+void undo_database::release_back()
+{
+   recycle_state( _stack.back() );
+   if( _spare_states.size() < 16 )
+      _spare_states.emplace_back( std::move( _stack.back() ) );
+   _stack.pop_back();
+}
+
+void undo_database::release_front()
+{
+   recycle_state( _stack.front() );
+   if( _spare_states.size() < 16 )
+      _spare_states.emplace_back( std::move( _stack.front() ) );
+   _stack.pop_front();
 }
 
 void undo_database::undo()
@@ -117,9 +189,9 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
-   _stack.pop_back();
+   release_back();
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() }
@@ -128,8 +200,13 @@ void undo_database::merge()
 {
    FC_ASSERT( _active_sessions > 0 );
    FC_ASSERT( _stack.size() >=2 );
-   auto& state = _stack.back();
-   auto& prev_state = _stack[_stack.size()-2];
+   merge_into( _stack[_stack.size()-2], _stack.back() );
+   release_back();
+   --_active_sessions;
+}
+
+void undo_database::merge_into( undo_state& prev_state, undo_state& state )
+{
 
    // An object's relationship to a state can be:
    // in new_ids            : new
@@ -235,19 +312,53 @@ void undo_database::merge()
       // nop + del(was=Y) -> del(was=Y)
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
-   _stack.pop_back();
-   --_active_sessions;
+   // whatever was not moved into prev_state is superseded by prev_state's copy,
+   // the caller releases state
 }
+
 void undo_database::commit()
 {
    FC_ASSERT( _active_sessions > 0 );
    --_active_sessions;
+   compact();
+}
+
+void undo_database::set_max_size( size_t new_max_size )
+{
+   _max_size = new_max_size;
+   // states beyond the undo window can never be popped, release them now rather than
+   // when the next session starts; active sessions are always at the back of the stack
+   while( _stack.size() > _max_size && _stack.size() > _active_sessions )
+      release_front();
+}
+
+void undo_database::compact()
+{
+   if( _compaction_depth == 0 )
+      return;
+   // fold committed states older than _compaction_depth into the oldest state
+   while( _stack.size() > _active_sessions + _compaction_depth + 1 )
+   {
+      merge_into( _stack[0], _stack[1] );
+      _stack[0].merged_states += _stack[1].merged_states + 1;
+      recycle_state( _stack[1] );
+      _stack.erase( _stack.begin() + 1 );
+   }
+}
+
+size_t undo_database::undoable_size()const
+{
+   size_t result = 0;
+   for( auto itr = _stack.rbegin(); itr != _stack.rend() && itr->merged_states == 0; ++itr )
+      ++result;
+   return result;
 }
 
 void undo_database::pop_commit()
 {
    FC_ASSERT( _active_sessions == 0 );
    FC_ASSERT( !_stack.empty() );
+   FC_ASSERT( _stack.back().merged_states == 0, "Cannot pop an undo state that was compacted with older states" );
 
    disable();
    try {
@@ -271,7 +382,7 @@ void undo_database::pop_commit()
       for( auto& item : state.removed )
          _db.insert( std::move(*item.second) );
 
-      _stack.pop_back();
+      release_back();
    }
    catch ( const fc::exception& e )
    {
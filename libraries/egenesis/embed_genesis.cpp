@@ -166,7 +166,7 @@ struct egenesis_info
       else if( genesis_json.valid() )
       {
          // If genesis not exist, generate from genesis_json
-         genesis = fc::json::from_string( *genesis_json ).as< genesis_state_type >();
+         genesis = parse_genesis_json( *genesis_json );
       }
       else
       {
@@ -22,6 +22,9 @@
  * THE SOFTWARE.
  */
 #include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+
+#include <cstring>
 
 
 namespace graphene { namespace net {
@@ -45,6 +48,53 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_compact_block_transactions_message::type = core_message_type_enum::fetch_compact_block_transactions_message_type;
+  const core_message_type_enum compact_block_transactions_message::type      = core_message_type_enum::compact_block_transactions_message_type;
+
+  message block_message::from_packed_block( std::vector<char>&& packed_block, const block_id_type& block_id )
+  {
+    // a block_message packs as the block followed by its id
+    message result;
+    result.msg_type = block_message_type;
+    result.data = std::move( packed_block );
+    result.data.insert( result.data.end(), block_id.data(), block_id.data() + block_id.data_size() );
+    result.size = (uint32_t)result.data.size();
+    return result;
+  }
+
+  block_id_type block_message::block_id_of( const message& packed_block_message )
+  {
+    FC_ASSERT( packed_block_message.msg_type == block_message_type &&
+               packed_block_message.data.size() >= block_id_type::data_size() );
+    block_id_type block_id;
+    memcpy( block_id.data(), packed_block_message.data.data() + packed_block_message.data.size() - block_id.data_size(), block_id.data_size() );
+    return block_id;
+  }
+
+  compact_block_message::compact_block_message( const signed_block& block, const item_hash_t& item_hash,
+                                                const std::function<bool(const signed_transaction&)>& peer_has ) :
+    header( block ),
+    block_id( block.id() ),
+    item_hash( item_hash )
+  {
+    transactions.resize( block.transactions.size() );
+    for( size_t i = 0; i < block.transactions.size(); ++i )
+    {
+      const processed_transaction& trx = block.transactions[i];
+      transactions[i].short_id = short_id( trx.id() );
+      transactions[i].operation_results = trx.operation_results;
+      if( !peer_has( trx ) )
+        transactions[i].transaction = static_cast<const signed_transaction&>( trx );
+    }
+  }
+
+  uint64_t compact_block_message::short_id( const transaction_id_type& id )
+  {
+    uint64_t result;
+    memcpy( &result, id.data(), sizeof( result ) );
+    return result;
+  }
 
 } } // graphene::net
 
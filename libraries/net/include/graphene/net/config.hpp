@@ -68,6 +68,13 @@
  */
 #define GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS        5
 
+/**
+ * The message cache also drops its oldest messages once they take up more
+ * than this many bytes, however recent they are.  It can be changed with
+ * the "message_cache_size_in_bytes" advanced node parameter.
+ */
+#define GRAPHENE_NET_DEFAULT_MESSAGE_CACHE_SIZE_IN_BYTES     (64 * 1024 * 1024)
+
 /**
  * We prevent a peer from offering us a list of blocks which, if we fetched them
  * all, would result in a blockchain that extended into the future.
@@ -79,8 +86,49 @@
 
 #define GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * The transactions we have advertised to a peer are remembered in a rolling
+ * bloom filter of two generations, each holding up to this many items for up
+ * to GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES.  A false positive only means
+ * we don't advertise a transaction to a peer that will hear of it from
+ * others; blocks are remembered exactly, see advertised_inventory.
+ */
+#define GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION   16384
+#define GRAPHENE_NET_INVENTORY_FILTER_HASHES                 13
+#define GRAPHENE_NET_INVENTORY_FILTER_BITS_PER_ITEM          20
+
+/**
+ * New inventory is collected for this long before being advertised, so
+ * that items arriving close together go out in one inventory message per
+ * peer.  Blocks are always advertised right away.
+ */
+#define GRAPHENE_NET_DEFAULT_INVENTORY_ADVERTISEMENT_INTERVAL_MS 100
+
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * Blocks read from the blockchain to serve to peers are kept around until
+ * this many bytes of more recently served blocks push them out, so that
+ * several peers syncing from us at once don't each have them read again.
+ */
+#define GRAPHENE_NET_SERVED_BLOCKS_CACHE_SIZE_IN_BYTES       (16*1024*1024)
+
+/**
+ * During sync we keep enough blocks requested from each peer to cover this
+ * many seconds at the rate the peer has been delivering them, between
+ * GRAPHENE_NET_MIN_SYNC_WINDOW and the maximum blocks per peer.  More are
+ * requested once half of them have arrived, so the pipe never runs dry.
+ */
+#define GRAPHENE_NET_SYNC_PIPELINE_SECONDS                   2
+#define GRAPHENE_NET_MIN_SYNC_WINDOW                         20
+
+/**
+ * A sync block that a peer hasn't delivered after this many seconds, or after
+ * four times as long as its rate says it should have taken, is requested from
+ * another peer as well.
+ */
+#define GRAPHENE_NET_SYNC_REREQUEST_SECONDS                  5
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -103,3 +151,25 @@
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
+
+/**
+ * Each peer gets a token bucket for the transactions it sends us and one
+ * for the transaction ids it advertises to us, refilled at these rates and
+ * holding up to GRAPHENE_NET_PEER_TRX_BURST_SECONDS worth of tokens.  What
+ * a peer sends beyond that is dropped before it is deserialized or passed
+ * to the client.  A rate of zero disables the bucket.
+ */
+#define GRAPHENE_NET_DEFAULT_PEER_MAX_TRX_PER_SECOND           GRAPHENE_NET_MAX_TRX_PER_SECOND
+#define GRAPHENE_NET_DEFAULT_PEER_MAX_TRX_INVENTORY_PER_SECOND (2 * GRAPHENE_NET_MAX_TRX_PER_SECOND)
+#define GRAPHENE_NET_PEER_TRX_BURST_SECONDS                    5
+
+/**
+ * Once a peer has sent us GRAPHENE_NET_PEER_TRX_PENALTY_MIN_SAMPLES
+ * transactions, we look at how many of them the client rejected.  If more
+ * than GRAPHENE_NET_PEER_TRX_PENALTY_FAILED_PERCENT did, we stop fetching
+ * transactions from that peer for GRAPHENE_NET_PEER_TRX_PENALTY_SECONDS.
+ * Either way the counts start over.
+ */
+#define GRAPHENE_NET_PEER_TRX_PENALTY_MIN_SAMPLES              50
+#define GRAPHENE_NET_PEER_TRX_PENALTY_FAILED_PERCENT           50
+#define GRAPHENE_NET_PEER_TRX_PENALTY_SECONDS                  30
@@ -37,13 +37,19 @@
 #include <fc/io/enum_type.hpp>
 
 
+#include <functional>
 #include <vector>
 
 namespace graphene { namespace net {
+  struct message;
+
   using graphene::chain::signed_transaction;
   using graphene::chain::block_id_type;
   using graphene::chain::transaction_id_type;
   using graphene::chain::signed_block;
+  using graphene::chain::signed_block_header;
+  using graphene::chain::processed_transaction;
+  using graphene::chain::operation_result;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -86,6 +92,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_compact_block_transactions_message_type = 5019,
+    compact_block_transactions_message_type      = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -113,6 +122,10 @@ namespace graphene { namespace net {
       signed_block    block;
       block_id_type   block_id;
 
+      /** the message for a block that is already fc::raw packed, without unpacking and repacking it */
+      static message from_packed_block( std::vector<char>&& packed_block, const block_id_type& block_id );
+      /** the block_id of a message holding a block_message, read without unpacking the block */
+      static block_id_type block_id_of( const message& packed_block_message );
    };
 
   struct item_ids_inventory_message
@@ -400,6 +413,65 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /** one transaction of a compact_block_message */
+  struct compact_block_transaction
+  {
+    /** the first 8 bytes of the transaction id */
+    uint64_t                               short_id = 0;
+    std::vector<operation_result>          operation_results;
+    /** the transaction itself, if the peer might not have it */
+    fc::optional<signed_transaction>       transaction;
+  };
+
+  /**
+   * Sent instead of a block_message to a peer that asked for a block we relayed, if it said in its hello that it
+   * understands compact blocks.  The peer has seen most of the transactions already, so they are sent by short
+   * id, and the receiver takes them from its message cache.  It asks for the ones it does not have with a
+   * fetch_compact_block_transactions_message.  The operation results are part of the merkle root, so they are
+   * sent along.  The rebuilt block must have the merkle root of the header and the hash item_hash as a
+   * block_message, otherwise the receiver asks for every transaction.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    signed_block_header                    header;
+    block_id_type                          block_id;
+    /** the item the peer asked for, the hash of the block_message this stands for */
+    item_hash_t                            item_hash;
+    std::vector<compact_block_transaction> transactions;
+
+    compact_block_message() {}
+    /** includes the transactions with an id for which @ref peer_has returns false */
+    compact_block_message( const signed_block& block, const item_hash_t& item_hash,
+                           const std::function<bool(const signed_transaction&)>& peer_has );
+
+    static uint64_t short_id( const transaction_id_type& id );
+  };
+
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type         block_id;
+    std::vector<uint32_t> transaction_indexes;
+
+    fetch_compact_block_transactions_message() {}
+    fetch_compact_block_transactions_message( const block_id_type& block_id, std::vector<uint32_t> transaction_indexes ) :
+      block_id( block_id ),
+      transaction_indexes( std::move( transaction_indexes ) )
+    {}
+  };
+
+  /** the transactions asked for in a fetch_compact_block_transactions_message, none if the block is unknown */
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                      block_id;
+    std::vector<processed_transaction> transactions;
+  };
+
 
 } } // graphene::net
 
@@ -424,6 +496,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -508,6 +583,10 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(graphene::net::compact_block_transaction, (short_id)(operation_results)(transaction))
+FC_REFLECT(graphene::net::compact_block_message, (header)(block_id)(item_hash)(transactions))
+FC_REFLECT(graphene::net::fetch_compact_block_transactions_message, (block_id)(transaction_indexes))
+FC_REFLECT(graphene::net::compact_block_transactions_message, (block_id)(transactions))
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
@@ -29,6 +29,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -108,8 +110,8 @@ namespace graphene { namespace net {
      }
   };
 
-
-
+  /** an immutable message shared by everything that holds on to it, e.g. the send queues of several peers */
+  typedef std::shared_ptr<const message> message_ptr;
 
 } } // graphene::net
 
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
 #include <graphene/net/message.hpp>
 
 namespace graphene { namespace net {
@@ -47,11 +48,18 @@ namespace graphene { namespace net {
        ~message_oriented_connection();
        fc::tcp_socket& get_socket();
 
+       /**
+        * Read, decrypt and frame the incoming messages on @ref read_thread instead of the thread that owns
+        * the connection.  The delegate still gets them on the owning thread, in order.  Must be called
+        * before accept() or connect_to().
+        */
+       void set_read_thread(fc::thread* read_thread);
        void accept();
        void bind(const fc::ip::endpoint& local_endpoint);
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       /** closes the socket, on the read thread if there is one, so the read loop ends and reports it */
        void close_connection();
        void destroy_connection();
 
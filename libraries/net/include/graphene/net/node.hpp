@@ -79,6 +79,23 @@ namespace graphene { namespace net {
           */
          virtual bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode, 
                                     std::vector<fc::uint160_t>& contained_transaction_message_ids ) = 0;
+
+         /**
+          *  @brief Called when a block comes in during sync, usually long before handle_block() gets it
+          *
+          *  Lets the client start the checks that do not depend on the blockchain state.  Called on the
+          *  p2p thread, so it must neither block nor touch the blockchain state.
+          */
+         virtual void prevalidate_block( const graphene::net::block_message& blk_msg ) {}
+
+         /**
+          *  Lets the client make the checks of a transaction that do not depend on the blockchain state
+          *  before handle_transaction().  Called on the p2p thread, so it must not touch the blockchain
+          *  state, it may wait for other threads.
+          *
+          *  @throws exception if the transaction is invalid, it is then neither handled nor broadcast
+          */
+         virtual void prevalidate_transaction( const graphene::net::trx_message& trx_msg ) {}
          
          /**
           *  @brief Called when a new transaction comes in from the network
@@ -168,6 +185,12 @@ namespace graphene { namespace net {
          virtual void error_encountered(const std::string& message, const fc::oexception& error) = 0;
          virtual uint8_t get_current_block_interval_in_seconds() const = 0;
 
+         /**
+          *  @return true if key is the signing key of one of the active witnesses, whose nodes may then push
+          *          blocks to us without being asked, see node::set_witness_relay_key()
+          */
+         virtual bool is_active_witness_key( const fc::ecc::public_key& key ) { return false; }
+
    };
 
    /**
@@ -288,13 +311,36 @@ namespace graphene { namespace net {
 
         void set_total_bandwidth_limit(uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second);
 
+        /**
+         * Read, decrypt and split into messages the traffic of the peers on this many threads, each peer
+         * connected from now on going to the next one.  The messages are still handled on the node's
+         * thread, in the order each peer sent them.  Peers are read on the node's thread while a download
+         * bandwidth limit is set.
+         */
+        void set_io_threads(uint32_t thread_count);
+
         fc::variant_object network_get_info() const;
         fc::variant_object network_get_usage_stats() const;
+        /**
+         * Traffic by message type, queued bytes, message cache size, item fetch and block
+         * propagation latencies and how many received items were duplicates
+         */
+        fc::variant_object network_get_statistics() const;
 
         std::vector<potential_peer_record> get_potential_peers() const;
 
         void disable_peer_advertising();
         fc::variant_object get_call_statistics() const;
+
+        /**
+         * Witness relay: the nodes of the active witnesses keep direct connections to each other and push new
+         * blocks over them without waiting to be asked.  A node holding a witness's signing key proves it in its
+         * hello to the peers at its witness relay endpoints, and a peer whose key the delegate confirms with
+         * node_delegate::is_active_witness_key() is then sent every new block as soon as we have it.
+         */
+        void set_witness_relay_key( const fc::ecc::private_key& signing_key );
+        /** keeps a connection to ep open, and proves our witness relay key to peers connecting from its address */
+        void add_witness_relay_endpoint( const fc::ip::endpoint& ep );
       private:
         std::unique_ptr<detail::node_impl, detail::node_impl_deleter> my;
    };
@@ -27,6 +27,7 @@
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/rolling_item_filter.hpp>
 #include <graphene/net/config.hpp>
 
 #include <boost/tuple/tuple.hpp>
@@ -40,6 +41,7 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <map>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -61,6 +63,25 @@ namespace graphene { namespace net
       node_id_t        requesting_peer;
     };
 
+    /**
+     * Refills at rate tokens per second up to burst tokens; take() fails while
+     * the bucket is empty.  A rate of zero never runs out.
+     */
+    class token_bucket
+    {
+    public:
+      token_bucket() : _rate(0), _burst(0), _tokens(0) {}
+
+      void configure(uint32_t rate, uint32_t burst);
+      bool take(const fc::time_point& now = fc::time_point::now());
+
+    private:
+      uint32_t       _rate;
+      uint32_t       _burst;
+      double         _tokens;
+      fc::time_point _last_refill;
+    };
+
     class peer_connection;
     class peer_connection_delegate
     {
@@ -68,7 +89,7 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual message_ptr get_message_for_item(const item_id& item) = 0;
     };
 
     class peer_connection;
@@ -110,6 +131,20 @@ namespace graphene { namespace net
       fc::optional<fc::ip::endpoint> _remote_endpoint;
       message_oriented_connection    _message_connection;
 
+      /* messages are queued in one of these lanes, and a lane is only sent from while the
+       * lanes above it are empty, so a backed-up transaction lane never delays a block.
+       */
+      enum send_lane
+      {
+        block_lane,         /// blocks, block inventory and connection control messages
+        sync_lane,          /// item id inventories and replies for peers syncing with us
+        transaction_lane,   /// transactions, transaction inventory and anything we don't recognize
+        peer_exchange_lane, /// addresses, firewall checks and connection reports
+        number_of_send_lanes
+      };
+      static send_lane get_send_lane(const message& message_to_send);
+      static send_lane get_send_lane(const item_id& item_to_send);
+
       /* a base class for messages on the queue, to hide the fact that some
        * messages are complete messages and some are only hashes of messages.
        */
@@ -123,30 +158,37 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual message_ptr get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
         virtual size_t get_size_in_queue() = 0;
+        virtual send_lane get_send_lane() const = 0;
+        /** true for inventory we advertise on our own, which the peer can do without */
+        virtual bool is_unsolicited() const { return false; }
+        /** what to send instead when the peer asked for the item and its lane is full, null if nothing */
+        virtual message_ptr get_unavailable_reply() const { return message_ptr(); }
         virtual ~queued_message() {}
       };
 
-      /* when you queue up a 'real_queued_message', a full copy of the message is
-       * stored on the heap until it is sent
+      /* when you queue up a 'real_queued_message', the message is kept on the heap until
+       * it is sent.  The queues of all peers sending the same message share it
        */
       struct real_queued_message : queued_message
       {
-        message        message_to_send;
+        message_ptr    message_to_send;
         size_t         message_send_time_field_offset;
 
-        real_queued_message(message message_to_send,
+        real_queued_message(message_ptr message_to_send,
                             size_t message_send_time_field_offset = (size_t)-1) :
           message_to_send(std::move(message_to_send)),
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
+        send_lane get_send_lane() const override { return peer_connection::get_send_lane(*message_to_send); }
+        bool is_unsolicited() const override;
       };
 
       /* when you queue up a 'virtual_queued_message', we just queue up the hash of the
@@ -161,13 +203,20 @@ namespace graphene { namespace net
           item_to_send(std::move(item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
+        send_lane get_send_lane() const override { return peer_connection::get_send_lane(item_to_send); }
+        message_ptr get_unavailable_reply() const override;
       };
 
 
+      struct send_lane_queue
+      {
+        size_t total_size = 0;
+        std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > messages;
+      };
       size_t _total_queued_messages_size;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      send_lane_queue _send_lanes[number_of_send_lanes];
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -190,6 +239,20 @@ namespace graphene { namespace net
       fc::time_point get_connection_time()const { return _message_connection.get_connection_time(); }
       fc::time_point get_connection_terminated_time()const { return connection_terminated_time; }
 
+      /// traffic with this peer by message type, counting the message headers but not the padding
+      /// @{
+      struct message_traffic
+      {
+        uint64_t messages;
+        uint64_t bytes;
+        message_traffic() : messages(0), bytes(0) {}
+        void add(const message& traffic_message) { ++messages; bytes += sizeof(message_header) + traffic_message.size; }
+      };
+      typedef std::map<uint32_t, message_traffic> message_traffic_by_type;
+      message_traffic_by_type traffic_received_by_type;
+      message_traffic_by_type traffic_sent_by_type;
+      /// @}
+
       /// data about the peer node
       /// @{
       /** node_public_key from the hello message, zero-initialized before we get the hello */
@@ -214,6 +277,8 @@ namespace graphene { namespace net
       fc::ip::address inbound_address;
       uint16_t inbound_port;
       uint16_t outbound_port;
+      /// true if the peer said in its hello that it understands compact_block_message
+      bool supports_compact_blocks;
       /// @}
 
       typedef std::unordered_map<item_id, fc::time_point> item_to_time_map_type;
@@ -230,6 +295,10 @@ namespace graphene { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      uint32_t sync_window; /// how many sync blocks we keep requested from this peer at once, adapted to sync_blocks_per_second
+      double sync_blocks_per_second; /// smoothed rate this peer has been delivering the sync blocks we requested
+      fc::time_point last_sync_block_received_time; /// when the last requested sync block arrived, if more were still outstanding
+      uint32_t number_of_sync_blocks_received; /// counted into the peer's record in the peer database when the connection closes
       /// @}
 
       /// non-synchronization state data
@@ -250,17 +319,42 @@ namespace graphene { namespace net
                                                                           boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
                                                                                                                  boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
       timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      advertised_inventory inventory_advertised_to_peer; /// items we've advertised to or received from this peer, so we don't offer them again
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /// a compact block from this peer we're rebuilding, waiting for the transactions we asked for
+      struct waiting_compact_block
+      {
+        signed_block          block;
+        item_hash_t           item_hash;
+        std::vector<uint32_t> missing_transactions;
+        bool                  fetched_all = false; /// true once we've asked for every transaction of the block
+      };
+      std::map<block_id_type, waiting_compact_block> compact_blocks_waiting;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
       // blockchain catch up
       fc::time_point transaction_fetching_inhibited_until;
 
+      /// flood control for transactions, see GRAPHENE_NET_DEFAULT_PEER_MAX_TRX_PER_SECOND
+      /// @{
+      token_bucket transaction_bucket; /// transaction messages the peer may still send us
+      token_bucket transaction_inventory_bucket; /// transaction ids the peer may still advertise to us
+      uint32_t transactions_accepted; /// since the peer's failure ratio was last scored
+      uint32_t transactions_rejected;
+      uint64_t transactions_dropped; /// transaction messages and ids ignored because a bucket was empty
+      /// @}
+
       uint32_t last_known_fork_block_number;
 
+      /// witness relay, see node::set_witness_relay_key()
+      /// @{
+      fc::optional<fc::ecc::public_key> witness_relay_key; /// the active witness key the peer proved it holds
+      bool sent_witness_relay_signature = false; /// we proved ours to the peer, so it will take the blocks we push
+      /// @}
+
       fc::future<void> accept_or_connect_task_done;
 
       firewall_check_state_data *firewall_check_state;
@@ -277,6 +371,8 @@ namespace graphene { namespace net
       virtual ~peer_connection();
 
       fc::tcp_socket& get_socket();
+      /** read the messages of this peer on @ref read_thread, see message_oriented_connection::set_read_thread() */
+      void set_read_thread(fc::thread* read_thread);
       void accept_connection();
       void connect_to(const fc::ip::endpoint& remote_endpoint, fc::optional<fc::ip::endpoint> local_endpoint = fc::optional<fc::ip::endpoint>());
 
@@ -285,12 +381,16 @@ namespace graphene { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      /** queues a message that may be queued for other peers as well, without copying it */
+      void send_message(message_ptr message_to_send);
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      /** roughly how many bytes of messages are waiting in our queue to this peer */
+      size_t get_total_queued_messages_size() const;
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -303,6 +403,7 @@ namespace graphene { namespace net
       bool idle();
 
       bool is_transaction_fetching_inhibited() const;
+      void record_transaction_result(bool accepted);
       fc::sha512 get_shared_secret() const;
       void clear_old_inventory();
       bool is_inventory_advertised_to_us_list_full_for_transactions() const;
@@ -52,10 +52,17 @@ namespace graphene { namespace net {
     uint32_t                          number_of_successful_connection_attempts;
     uint32_t                          number_of_failed_connection_attempts;
     fc::optional<fc::exception>       last_error;
+    uint32_t                          average_round_trip_delay_ms; ///< zero until we have measured it
+    uint32_t                          total_connected_seconds;
+    uint32_t                          number_of_sync_blocks_received;
 
     potential_peer_record() :
       number_of_successful_connection_attempts(0),
-    number_of_failed_connection_attempts(0){}
+      number_of_failed_connection_attempts(0),
+      average_round_trip_delay_ms(0),
+      total_connected_seconds(0),
+      number_of_sync_blocks_received(0)
+    {}
 
     potential_peer_record(fc::ip::endpoint endpoint,
                           fc::time_point_sec last_seen_time = fc::time_point_sec(),
@@ -64,8 +71,17 @@ namespace graphene { namespace net {
       last_seen_time(last_seen_time),
       last_connection_disposition(last_connection_disposition),
       number_of_successful_connection_attempts(0),
-      number_of_failed_connection_attempts(0)
-    {}  
+      number_of_failed_connection_attempts(0),
+      average_round_trip_delay_ms(0),
+      total_connected_seconds(0),
+      number_of_sync_blocks_received(0)
+    {}
+
+    /**
+     * How much we'd like to connect to this peer, higher is better: peers that we have connected
+     * to reliably, stayed connected to for long, synced from and see a short round trip to come first
+     */
+    int64_t score() const;
   };
 
   namespace detail
@@ -92,6 +108,10 @@ namespace graphene { namespace net {
   }
 
 
+  /**
+   * The peers we know of, kept in memory in order of their score() and saved in a compact
+   * binary file.
+   */
   class peer_database
   {
   public:
@@ -99,6 +119,8 @@ namespace graphene { namespace net {
     ~peer_database();
 
     void open(const fc::path& databaseFilename);
+    /** adds the peers of a peer database saved as JSON by older versions and saves the database, false on failure */
+    bool import_json(const fc::path& json_filename);
     void close();
     void clear();
 
@@ -108,6 +130,7 @@ namespace graphene { namespace net {
     potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
     fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
 
+    /** iterates over the peers from the best score to the worst */
     typedef detail::peer_database_iterator iterator;
     iterator begin() const;
     iterator end() const;
@@ -119,4 +142,4 @@ namespace graphene { namespace net {
 } } // end namespace graphene::net
 
 FC_REFLECT_ENUM(graphene::net::potential_peer_last_connection_disposition, (never_attempted_to_connect)(last_connection_failed)(last_connection_rejected)(last_connection_handshaking_failed)(last_connection_succeeded))
-FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error) )
+FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error)(average_round_trip_delay_ms)(total_connected_seconds)(number_of_sync_blocks_received) )
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/time.hpp>
+
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   * A bloom filter remembering the items recently seen, used in place of an exact set
+   * where an occasional false positive is harmless.  Items are inserted into the current
+   * of two generations; once it is full or older than the generation duration it replaces
+   * the previous one, so an item is remembered for at least one generation's worth of
+   * items or time.  Unlike a timestamped set the memory used stays fixed.
+   */
+  class rolling_item_filter
+  {
+  public:
+    rolling_item_filter(uint32_t items_per_generation = GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION,
+                        const fc::microseconds& generation_duration = fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
+
+    void insert(const item_id& item);
+    bool contains(const item_id& item) const;
+    /** starts a new generation if the current one has outlived the generation duration */
+    void expire();
+    /** the number of items inserted into the two generations remembered */
+    size_t size() const;
+
+  private:
+    struct generation
+    {
+      std::vector<uint64_t> bits;
+      uint32_t              items;
+      fc::time_point        started;
+    };
+
+    void start_generation();
+    bool generation_contains(const generation& gen, const item_id& item) const;
+
+    uint32_t         _items_per_generation;
+    fc::microseconds _generation_duration;
+    generation       _generations[2];
+    unsigned         _current;
+  };
+
+  /**
+   * The items advertised to or received from a peer.  Transactions go into a rolling_item_filter, a false positive
+   * only keeps a transaction from a peer that gets it from another one; every other item, blocks above all, is kept
+   * exactly, since a block we wrongly think the peer has is never advertised to it.  The exact items are dropped
+   * after the generation duration of the filter.
+   */
+  class advertised_inventory
+  {
+  public:
+    advertised_inventory(uint32_t items_per_generation = GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION,
+                         const fc::microseconds& generation_duration = fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
+
+    void insert(const item_id& item);
+    bool contains(const item_id& item) const;
+    /** see rolling_item_filter::expire(), also forgets the exact items older than the generation duration */
+    void expire();
+    size_t size() const;
+
+  private:
+    rolling_item_filter                                      _transactions;
+    fc::microseconds                                         _duration;
+    std::unordered_set<item_id>                              _exact;
+    /** _exact in the order inserted, to expire them */
+    std::deque< std::pair<fc::time_point, item_id> >         _exact_by_time;
+  };
+
+} } // end namespace graphene::net
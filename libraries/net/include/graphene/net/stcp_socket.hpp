@@ -31,6 +31,9 @@ namespace graphene { namespace net {
 /**
  *  Uses ECDH to negotiate a aes key for communicating
  *  with other nodes on the network.
+ *
+ *  Writes are encrypted into a buffer that goes out to the TCP socket when it is full or on flush(), so a
+ *  message written in several pieces costs a single socket write.
  */
 class stcp_socket : public virtual fc::iostream
 {
@@ -56,18 +59,22 @@ class stcp_socket : public virtual fc::iostream
     using istream::get;
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
+
+    /** size of the buffers the data is en- and decrypted in, a multiple of the 16 byte aes block */
+    static const size_t buffer_length = 64 * 1024;
   private:
     void do_key_exchange();
+    /** writes the encrypted data collected by writesome() to the socket */
+    void write_buffered();
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
-    fc::array<char,8>    _buf;
-    //uint32_t             _buf_len;
     fc::tcp_socket       _sock;
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+    size_t                _write_buffer_used;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
@@ -32,6 +32,9 @@
 #include <graphene/net/stcp_socket.hpp>
 #include <graphene/net/config.hpp>
 
+#include <atomic>
+#include <deque>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -53,22 +56,32 @@ namespace graphene { namespace net {
       message_oriented_connection_delegate *_delegate;
       stcp_socket _sock;
       fc::future<void> _read_loop_done;
-      uint64_t _bytes_received;
+      // written by the read loop, which may run on another thread
+      std::atomic<uint64_t> _bytes_received;
       uint64_t _bytes_sent;
 
       fc::time_point _connected_time;
-      fc::time_point _last_message_received_time;
+      std::atomic<int64_t> _last_message_received_time; // microseconds since the epoch
       fc::time_point _last_message_sent_time;
 
       bool _send_message_in_progress;
 
-#ifndef NDEBUG
+      /** the thread that owns the connection and calls the delegate */
       fc::thread* _thread;
-#endif
+      /** the thread running the read loop, nullptr for _thread */
+      fc::thread* _read_thread;
+      /** set once the connection is destroyed, so what the read thread handed over afterwards is dropped */
+      std::shared_ptr<bool> _destroyed;
+
+      /** the number of received messages the read thread may get ahead of the delegate */
+      static const size_t max_undelivered_messages = 16;
 
       void read_loop();
       void start_read_loop();
+      void deliver_message(std::shared_ptr<message> received_message);
+      void deliver_connection_closed();
     public:
+      void set_read_thread(fc::thread* read_thread);
       fc::tcp_socket& get_socket();
       void accept();
       void connect_to(const fc::ip::endpoint& remote_endpoint);
@@ -97,10 +110,11 @@ namespace graphene { namespace net {
       _delegate(delegate),
       _bytes_received(0),
       _bytes_sent(0),
-      _send_message_in_progress(false)
-#ifndef NDEBUG
-      ,_thread(&fc::thread::current())
-#endif
+      _last_message_received_time(fc::time_point::min().time_since_epoch().count()),
+      _send_message_in_progress(false),
+      _thread(&fc::thread::current()),
+      _read_thread(nullptr),
+      _destroyed(std::make_shared<bool>(false))
     {
     }
     message_oriented_connection_impl::~message_oriented_connection_impl()
@@ -115,20 +129,58 @@ namespace graphene { namespace net {
       return _sock.get_socket();
     }
 
+    void message_oriented_connection_impl::set_read_thread(fc::thread* read_thread)
+    {
+      VERIFY_CORRECT_THREAD();
+      assert(!_read_loop_done.valid());
+      _read_thread = read_thread == _thread ? nullptr : read_thread;
+    }
+
     void message_oriented_connection_impl::accept()
     {
       VERIFY_CORRECT_THREAD();
       _sock.accept();
-      assert(!_read_loop_done.valid()); // check to be sure we never launch two read loops
-      _read_loop_done = fc::async([=](){ read_loop(); }, "message read_loop");
+      start_read_loop();
     }
 
     void message_oriented_connection_impl::connect_to(const fc::ip::endpoint& remote_endpoint)
     {
       VERIFY_CORRECT_THREAD();
       _sock.connect_to(remote_endpoint);
+      start_read_loop();
+    }
+
+    void message_oriented_connection_impl::start_read_loop()
+    {
+      VERIFY_CORRECT_THREAD();
       assert(!_read_loop_done.valid()); // check to be sure we never launch two read loops
-      _read_loop_done = fc::async([=](){ read_loop(); }, "message read_loop");
+      _connected_time = fc::time_point::now();
+      if (_read_thread)
+        _read_loop_done = _read_thread->async([=](){ read_loop(); }, "message read_loop");
+      else
+        _read_loop_done = fc::async([=](){ read_loop(); }, "message read_loop");
+    }
+
+    void message_oriented_connection_impl::deliver_message(std::shared_ptr<message> received_message)
+    {
+      VERIFY_CORRECT_THREAD();
+      try
+      {
+        _delegate->on_message(_self, *received_message);
+      }
+      catch ( const fc::canceled_exception& ) { throw; }
+      catch ( const fc::exception& e )
+      {
+        // the read loop sees the connection closing and reports it
+        wlog( "message transmission failed ${er}", ("er", e.to_detail_string() ) );
+        close_connection();
+      }
+    }
+
+    void message_oriented_connection_impl::deliver_connection_closed()
+    {
+      VERIFY_CORRECT_THREAD();
+      _delegate->on_connection_closed(_self);
     }
 
     void message_oriented_connection_impl::bind(const fc::ip::endpoint& local_endpoint)
@@ -140,15 +192,15 @@ namespace graphene { namespace net {
 
     void message_oriented_connection_impl::read_loop()
     {
-      VERIFY_CORRECT_THREAD();
+      assert(_read_thread ? _read_thread->is_current() : _thread->is_current());
       const int BUFFER_SIZE = 16;
       const int LEFTOVER = BUFFER_SIZE - sizeof(message_header);
       static_assert(BUFFER_SIZE >= sizeof(message_header), "insufficient buffer");
 
-      _connected_time = fc::time_point::now();
-
       fc::oexception exception_to_rethrow;
       bool call_on_connection_closed = false;
+      // messages handed to _thread that it may not have handled yet, oldest first
+      std::deque< fc::future<void> > undelivered_messages;
 
       try
       {
@@ -172,7 +224,25 @@ namespace graphene { namespace net {
           }
           m.data.resize(m.size); // truncate off the padding bytes
 
-          _last_message_received_time = fc::time_point::now();
+          _last_message_received_time = fc::time_point::now().time_since_epoch().count();
+
+          if (_read_thread)
+          {
+            auto received_message = std::make_shared<message>(std::move(m));
+            m = message();
+            std::shared_ptr<bool> destroyed = _destroyed;
+            undelivered_messages.push_back(_thread->async([this, destroyed, received_message](){
+                                                            if (!*destroyed)
+                                                              deliver_message(received_message);
+                                                          }, "deliver message"));
+            while (!undelivered_messages.empty() &&
+                   (undelivered_messages.front().ready() || undelivered_messages.size() > max_undelivered_messages))
+            {
+              undelivered_messages.front().wait();
+              undelivered_messages.pop_front();
+            }
+            continue;
+          }
 
           try
           {
@@ -220,7 +290,16 @@ namespace graphene { namespace net {
       }
 
       if (call_on_connection_closed)
-        _delegate->on_connection_closed(_self);
+      {
+        if (_read_thread)
+        {
+          // after the messages handed over before, which _thread handles in order
+          std::shared_ptr<bool> destroyed = _destroyed;
+          _thread->async([this, destroyed](){ if (!*destroyed) deliver_connection_closed(); }, "deliver connection closed");
+        }
+        else
+          _delegate->on_connection_closed(_self);
+      }
 
       if (exception_to_rethrow)
         throw *exception_to_rethrow;
@@ -255,17 +334,40 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
         if( message_to_send.size > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        // the socket encrypts blocks of 16 bytes, so the message is padded to a multiple of 16 bytes.  Only
+        // the first block (the header and the start of the data) and the last one are copied, the rest is
+        // encrypted straight from the message, which may be shared with the send queues of other peers
+        const size_t BLOCK_SIZE = 16;
+        const size_t LEFTOVER = BLOCK_SIZE - sizeof(message_header);
+        const size_t size = message_to_send.size;
+
+        char first_block[BLOCK_SIZE] = {};
+        memcpy(first_block, (const char*)&message_to_send, sizeof(message_header));
+        memcpy(first_block + sizeof(message_header), message_to_send.data.data(), std::min(size, LEFTOVER));
+        _sock.write(first_block, BLOCK_SIZE);
+        size_t bytes_written = BLOCK_SIZE;
+
+        if (size > LEFTOVER)
+        {
+          const size_t whole_blocks_size = BLOCK_SIZE * ((size - LEFTOVER) / BLOCK_SIZE);
+          if (whole_blocks_size)
+          {
+            _sock.write(message_to_send.data.data() + LEFTOVER, whole_blocks_size);
+            bytes_written += whole_blocks_size;
+          }
+          const size_t last_block_size = size - LEFTOVER - whole_blocks_size;
+          if (last_block_size)
+          {
+            char last_block[BLOCK_SIZE] = {};
+            memcpy(last_block, message_to_send.data.data() + LEFTOVER + whole_blocks_size, last_block_size);
+            _sock.write(last_block, BLOCK_SIZE);
+            bytes_written += BLOCK_SIZE;
+          }
+        }
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += bytes_written;
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
@@ -273,7 +375,12 @@ namespace graphene { namespace net {
     void message_oriented_connection_impl::close_connection()
     {
       VERIFY_CORRECT_THREAD();
-      _sock.close();
+      // the read loop may be inside a read of the socket on its own thread, closing it there cancels that read
+      // in turn rather than from under it
+      if (_read_thread && _read_loop_done.valid() && !_read_loop_done.ready())
+        _read_thread->async([this](){ _sock.close(); }, "close connection").wait();
+      else
+        _sock.close();
     }
 
     void message_oriented_connection_impl::destroy_connection()
@@ -290,6 +397,8 @@ namespace graphene { namespace net {
              "The task calling send_message() should have been canceled already");
       assert(!_send_message_in_progress);
 
+      *_destroyed = true;
+
       try
       {
         _read_loop_done.cancel_and_wait(__FUNCTION__);
@@ -313,7 +422,7 @@ namespace graphene { namespace net {
     uint64_t message_oriented_connection_impl::get_total_bytes_received() const
     {
       VERIFY_CORRECT_THREAD();
-      return _bytes_received;
+      return _bytes_received.load();
     }
 
     fc::time_point message_oriented_connection_impl::get_last_message_sent_time() const
@@ -325,7 +434,7 @@ namespace graphene { namespace net {
     fc::time_point message_oriented_connection_impl::get_last_message_received_time() const
     {
       VERIFY_CORRECT_THREAD();
-      return _last_message_received_time;
+      return fc::time_point(fc::microseconds(_last_message_received_time.load()));
     }
 
     fc::sha512 message_oriented_connection_impl::get_shared_secret() const
@@ -351,6 +460,11 @@ namespace graphene { namespace net {
     return my->get_socket();
   }
 
+  void message_oriented_connection::set_read_thread(fc::thread* read_thread)
+  {
+    my->set_read_thread(read_thread);
+  }
+
   void message_oriented_connection::accept()
   {
     my->accept();
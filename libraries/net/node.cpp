@@ -83,6 +83,9 @@
 
 #include <fc/git_revision.hpp>
 
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/trace.hpp>
+
 //#define ENABLE_DEBUG_ULOGS
 
 #ifdef DEFAULT_LOGGER
@@ -131,11 +134,11 @@ namespace graphene { namespace net {
 
       struct message_hash_index{};
       struct message_contents_hash_index{};
-      struct block_clock_index{};
+      struct arrival_index{};
       struct message_info
       {
         message_hash_type message_hash;
-        message           message_body;
+        message_ptr       message_body;
         uint32_t          block_clock_when_received;
 
         // for network performance stats
@@ -143,12 +146,12 @@ namespace graphene { namespace net {
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      message_ptr              message_body,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
           message_hash( message_hash ),
-          message_body( message_body ),
+          message_body( std::move( message_body ) ),
           block_clock_when_received( block_clock_when_received ),
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
@@ -156,36 +159,145 @@ namespace graphene { namespace net {
       };
       typedef boost::multi_index_container
         < message_info,
-            bmi::indexed_by< bmi::ordered_unique< bmi::tag<message_hash_index>,
-                                                  bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
+            bmi::indexed_by< bmi::hashed_unique< bmi::tag<message_hash_index>,
+                                                 bmi::member<message_info, message_hash_type, &message_info::message_hash>,
+                                                 std::hash<message_hash_type> >,
                              bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
                                                       bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
+                             bmi::sequenced< bmi::tag<arrival_index> > >
         > message_cache_container;
 
+      /* messages are kept in the order they arrived, which is also the order of their block clock, so
+       * each block starts a new generation at the back and old generations are popped off the front
+       */
       message_cache_container _message_cache;
 
       uint32_t block_clock;
+      size_t   _maximum_size_in_bytes;
+      size_t   _size_in_bytes;
+      uint64_t _hits;
+      uint64_t _misses;
+      uint64_t _evicted_for_size;
+
+      static size_t get_size_in_cache( const message_info& info ) { return sizeof(message_info) + info.message_body->data.size(); }
+      void pop_oldest();
 
     public:
       blockchain_tied_message_cache() :
-        block_clock( 0 )
+        block_clock( 0 ),
+        _maximum_size_in_bytes( GRAPHENE_NET_DEFAULT_MESSAGE_CACHE_SIZE_IN_BYTES ),
+        _size_in_bytes( 0 ),
+        _hits( 0 ),
+        _misses( 0 ),
+        _evicted_for_size( 0 )
       {}
       void block_accepted();
+      /** messages beyond this are evicted oldest first, even if they are recent enough to keep */
+      void set_maximum_size_in_bytes( size_t maximum_size_in_bytes );
+      size_t get_maximum_size_in_bytes() const { return _maximum_size_in_bytes; }
+      fc::variant_object get_statistics() const;
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      /** the cached message itself, which the send queues of all peers share */
+      message_ptr get_message( const message_hash_type& hash_of_message_to_lookup );
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+      message_ptr get_message_by_contents( uint32_t message_type, const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
+      fc::optional<signed_transaction> get_transaction_by_short_id( uint64_t short_id );
+      bool contains( const message_hash_type& hash_of_message_to_lookup ) const
+      {
+        return _message_cache.get<message_hash_index>().find( hash_of_message_to_lookup ) != _message_cache.get<message_hash_index>().end();
+      }
       size_t size() const { return _message_cache.size(); }
     };
 
+    /** a running summary of some delay we measure, reported by network_get_statistics() */
+    struct latency_statistics
+    {
+      uint64_t count;
+      int64_t  total_us;
+      int64_t  maximum_us;
+      int64_t  last_us;
+
+      latency_statistics() : count(0), total_us(0), maximum_us(0), last_us(0) {}
+      void record( const fc::microseconds& latency )
+      {
+        ++count;
+        total_us += latency.count();
+        maximum_us = std::max( maximum_us, latency.count() );
+        last_us = latency.count();
+      }
+      fc::variant_object get_statistics() const
+      {
+        fc::mutable_variant_object result;
+        result["count"] = count;
+        result["average_us"] = count ? total_us / int64_t(count) : 0;
+        result["maximum_us"] = maximum_us;
+        result["last_us"] = last_us;
+        return result;
+      }
+    };
+
+    /** traffic by message type, keyed by the name of the type where it is one of ours */
+    fc::variant_object get_message_traffic_statistics( const peer_connection::message_traffic_by_type& traffic_by_type )
+    {
+      fc::mutable_variant_object result;
+      for( const auto& type_and_traffic : traffic_by_type )
+      {
+        std::string type_name = fc::to_string( int64_t( type_and_traffic.first ) );
+        try
+        {
+          const char* name = fc::reflector<core_message_type_enum>::to_string( core_message_type_enum( type_and_traffic.first ) );
+          if( name )
+            type_name = name;
+        }
+        catch( const fc::exception& )
+        {
+        }
+        fc::mutable_variant_object traffic;
+        traffic["messages"] = type_and_traffic.second.messages;
+        traffic["bytes"] = type_and_traffic.second.bytes;
+        result[type_name] = traffic;
+      }
+      return result;
+    }
+
+    void blockchain_tied_message_cache::pop_oldest()
+    {
+      auto& arrival = _message_cache.get<arrival_index>();
+      _size_in_bytes -= get_size_in_cache( arrival.front() );
+      arrival.pop_front();
+    }
+
     void blockchain_tied_message_cache::block_accepted()
     {
       ++block_clock;
-      if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
+      if( block_clock <= cache_duration_in_blocks )
+        return;
+      const auto& arrival = _message_cache.get<arrival_index>();
+      while( !arrival.empty() && arrival.front().block_clock_when_received < block_clock - cache_duration_in_blocks )
+        pop_oldest();
+    }
+
+    void blockchain_tied_message_cache::set_maximum_size_in_bytes( size_t maximum_size_in_bytes )
+    {
+      _maximum_size_in_bytes = maximum_size_in_bytes;
+      while( _size_in_bytes > _maximum_size_in_bytes )
+      {
+        pop_oldest();
+        ++_evicted_for_size;
+      }
+    }
+
+    fc::variant_object blockchain_tied_message_cache::get_statistics() const
+    {
+      fc::mutable_variant_object result;
+      result["messages"] = _message_cache.size();
+      result["bytes"] = _size_in_bytes;
+      result["maximum_bytes"] = _maximum_size_in_bytes;
+      result["hits"] = _hits;
+      result["misses"] = _misses;
+      result["evicted_for_size"] = _evicted_for_size;
+      return result;
     }
 
     void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
@@ -193,19 +305,31 @@ namespace graphene { namespace net {
                                                      const message_propagation_data& propagation_data,
                                                      const fc::uint160_t& message_content_hash )
     {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
+      auto inserted = _message_cache.insert( message_info(hash_of_message_to_cache,
+                                                         std::make_shared<const message>( message_to_cache ),
+                                                         block_clock,
+                                                         propagation_data,
+                                                         message_content_hash ) );
+      if( !inserted.second )
+        return;
+      _size_in_bytes += get_size_in_cache( *inserted.first );
+      while( _size_in_bytes > _maximum_size_in_bytes )
+      {
+        pop_oldest();
+        ++_evicted_for_size;
+      }
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    message_ptr blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
+      {
+        ++_hits;
         return iter->message_body;
+      }
+      ++_misses;
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
@@ -221,6 +345,41 @@ namespace graphene { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    message_ptr blockchain_tied_message_cache::get_message_by_contents( uint32_t message_type,
+                                                                                  const fc::uint160_t& hash_of_message_contents_to_lookup ) const
+    {
+      auto range = _message_cache.get<message_contents_hash_index>().equal_range( hash_of_message_contents_to_lookup );
+      for( auto iter = range.first; iter != range.second; ++iter )
+        if( iter->message_body->msg_type == message_type )
+          return iter->message_body;
+      return message_ptr();
+    }
+
+    /** returns the transaction with an id starting with short_id, unless there is none or more than one */
+    fc::optional<signed_transaction> blockchain_tied_message_cache::get_transaction_by_short_id( uint64_t short_id )
+    {
+      fc::uint160_t lowest_id;
+      memcpy( lowest_id.data(), &short_id, sizeof(short_id) );
+      fc::optional<signed_transaction> result;
+      const auto& contents_index = _message_cache.get<message_contents_hash_index>();
+      for( auto iter = contents_index.lower_bound( lowest_id );
+           iter != contents_index.end() && compact_block_message::short_id( iter->message_contents_hash ) == short_id;
+           ++iter )
+      {
+        if( iter->message_body->msg_type != trx_message_type )
+          continue;
+        signed_transaction trx = iter->message_body->as<trx_message>().trx;
+        if( result && result->id() != trx.id() )
+        {
+          ++_misses;
+          return fc::optional<signed_transaction>();
+        }
+        result = std::move( trx );
+      }
+      ++( result ? _hits : _misses );
+      return result;
+    }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -300,7 +459,8 @@ namespace graphene { namespace net { namespace detail {
                                    (get_head_block_id) \
                                    (estimate_last_known_fork_from_git_revision_timestamp) \
                                    (error_encountered) \
-                                   (get_current_block_interval_in_seconds)
+                                   (get_current_block_interval_in_seconds) \
+                                   (is_active_witness_key)
 
 
 #define DECLARE_ACCUMULATOR(r, data, method_name) \
@@ -384,6 +544,8 @@ namespace graphene { namespace net { namespace detail {
       bool has_item( const net::item_id& id ) override;
       void handle_message( const message& ) override;
       bool handle_block( const graphene::net::block_message& block_message, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids ) override;
+      void prevalidate_block( const graphene::net::block_message& block_message ) override;
+      void prevalidate_transaction( const graphene::net::trx_message& transaction_message ) override;
       void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
@@ -400,6 +562,7 @@ namespace graphene { namespace net { namespace detail {
       item_hash_t get_head_block_id() const override;
       uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const override;
       void error_encountered(const std::string& message, const fc::oexception& error) override;
+      bool is_active_witness_key( const fc::ecc::public_key& key ) override;
       uint8_t get_current_block_interval_in_seconds() const override;
     };
 
@@ -414,8 +577,16 @@ namespace graphene { namespace net { namespace detail {
       std::unique_ptr<statistics_gathering_node_delegate_wrapper> _delegate;
       fc::sha256           _chain_id;
 
+      /// threads reading the messages of the peers, see set_io_threads()
+      // @{
+      std::vector<std::unique_ptr<fc::thread> > _io_threads;
+      uint32_t             _next_io_thread;
+      bool                 _download_rate_limited;
+      // @}
+
 #define NODE_CONFIGURATION_FILENAME      "node_config.json"
-#define POTENTIAL_PEER_DATABASE_FILENAME "peers.json"
+#define POTENTIAL_PEER_DATABASE_FILENAME "peers.dat"
+#define LEGACY_POTENTIAL_PEER_DATABASE_FILENAME "peers.json" // the JSON file older versions kept the peers in
       fc::path             _node_configuration_directory;
       node_configuration   _node_configuration;
 
@@ -449,6 +620,7 @@ namespace graphene { namespace net { namespace detail {
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
+      std::unordered_set<graphene::net::block_id_type> _sync_items_rerequested; /// sync blocks a slow peer was taking too long to deliver, which we've asked another peer for
       std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
       std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
       // @}
@@ -479,8 +651,13 @@ namespace graphene { namespace net { namespace detail {
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      fc::microseconds              _inventory_advertisement_interval; /// how long new transactions are collected before being advertised
+      bool                          _coalescing_inventory; /// true while the advertise loop is waiting out _inventory_advertisement_interval
       // @}
 
+      uint32_t _peer_max_transactions_per_second; /// refill rate of each peer's transaction_bucket
+      uint32_t _peer_max_transaction_inventory_per_second; /// refill rate of each peer's transaction_inventory_bucket
+
       fc::future<void>     _terminate_inactive_connections_loop_done;
       uint8_t _recent_block_interval_in_seconds; // a cached copy of the block interval, to avoid a thread hop to the blockchain to get the current value
 
@@ -530,6 +707,15 @@ namespace graphene { namespace net { namespace detail {
 
       blockchain_tied_message_cache _message_cache; /// cache message we have received and might be required to provide to other peers via inventory requests
 
+      /// blocks we've recently read from the delegate to serve to peers, most recently served first, so peers syncing
+      /// from us at the same time share one read of each block
+      // @{
+      typedef std::list<std::pair<item_hash_t, message_ptr> > served_block_list;
+      served_block_list _served_blocks;
+      std::unordered_map<item_hash_t, served_block_list::iterator> _served_blocks_by_id;
+      size_t _served_blocks_size; /// bytes in _served_blocks
+      // @}
+
       fc::rate_limiting_group _rate_limiter;
 
       uint32_t _last_reported_number_of_connections; // number of connections last reported to the client (to avoid sending duplicate messages)
@@ -577,6 +763,25 @@ namespace graphene { namespace net { namespace detail {
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
 
+      /// figures reported by network_get_statistics()
+      // @{
+      peer_connection::message_traffic_by_type _closed_connections_traffic_received; /// traffic of the connections no longer in the peer lists
+      peer_connection::message_traffic_by_type _closed_connections_traffic_sent;
+      latency_statistics _transaction_fetch_latency; /// from requesting an item to receiving it
+      latency_statistics _block_fetch_latency;
+      latency_statistics _block_first_seen_latency; /// from a block's timestamp to when we first received it
+      uint64_t _items_received; /// blocks and transactions received, during sync or normal operation
+      uint64_t _duplicate_items_received; /// of which we had already received the contents from someone else
+      latency_statistics _witness_relay_block_latency; /// from a block's timestamp to when a witness relay pushed it to us
+      uint64_t _witness_relay_blocks_pushed; /// blocks we pushed to witness relays
+      // @}
+
+      /// witness relay, see node::set_witness_relay_key()
+      // @{
+      fc::optional<fc::ecc::private_key> _witness_relay_key;
+      std::vector<fc::ip::endpoint>      _witness_relay_endpoints;
+      // @}
+
       std::list<fc::future<void> > _handle_message_calls_in_progress;
 
       node_impl(const std::string& user_agent);
@@ -591,6 +796,8 @@ namespace graphene { namespace net { namespace detail {
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
       void fetch_sync_items_loop();
+      void release_slow_sync_requests( const std::vector<peer_connection_ptr>& sync_peers );
+      void record_sync_block_received( peer_connection* peer, const fc::time_point& request_time );
       void trigger_fetch_sync_items_loop();
 
       bool is_item_in_any_peers_inventory(const item_id& item) const;
@@ -599,6 +806,7 @@ namespace graphene { namespace net { namespace detail {
 
       void advertise_inventory_loop();
       void trigger_advertise_inventory_loop();
+      bool new_inventory_contains_blocks() const;
 
       void terminate_inactive_connections_loop();
 
@@ -652,6 +860,17 @@ namespace graphene { namespace net { namespace detail {
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+
+      void on_fetch_compact_block_transactions_message( peer_connection* originating_peer,
+                                                        const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received );
+
+      void on_compact_block_transactions_message( peer_connection* originating_peer,
+                                                  const compact_block_transactions_message& compact_block_transactions_message_received );
+
+      void finish_compact_block( peer_connection* originating_peer, peer_connection::waiting_compact_block&& waiting_block );
+
       void on_item_ids_inventory_message( peer_connection* originating_peer,
                                           const item_ids_inventory_message& item_ids_inventory_message_received );
 
@@ -749,12 +968,27 @@ namespace graphene { namespace net { namespace detail {
       void                       set_allowed_peers( const std::vector<node_id_t>& allowed_peers );
       void                       clear_peer_database();
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
+      void                       set_io_threads( uint32_t thread_count );
+      /** a new peer connection, reading on the next of the io threads */
+      peer_connection_ptr        new_peer_connection();
+      void                       configure_transaction_buckets(peer_connection* peer);
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
-      message                    get_message_for_item(const item_id& item) override;
+      void                       set_witness_relay_key(const fc::ecc::private_key& signing_key);
+      void                       add_witness_relay_endpoint(const fc::ip::endpoint& ep);
+      bool                       is_witness_relay_address(const fc::ip::address& address) const;
+      /** sends a block we have just accepted or produced to the witness relays that don't have it yet */
+      void                       push_block_to_witness_relays(const message& block_message_to_push, const message_hash_type& message_hash,
+                                                              const message_propagation_data& propagation_data);
+      /** the block with the transactions peer has already seen replaced by their short ids */
+      compact_block_message      make_compact_block_for_peer(peer_connection* peer, const signed_block& block, const item_hash_t& item_hash);
+      message_ptr                get_message_for_item(const item_id& item) override;
+      /** the item from the delegate, or for a block, from _served_blocks if we have served it recently */
+      message_ptr                get_item_from_delegate(const item_id& item);
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
+      fc::variant_object         network_get_statistics() const;
 
       bool is_hard_fork_block(uint32_t block_number) const;
       uint32_t get_next_known_hard_fork_block_number(uint32_t block_number) const;
@@ -797,12 +1031,18 @@ namespace graphene { namespace net { namespace detail {
       _thread(std::make_shared<fc::thread>("p2p")),
 #endif // P2P_IN_DEDICATED_THREAD
       _delegate(nullptr),
+      _next_io_thread(0),
+      _download_rate_limited(false),
       _is_firewalled(firewalled_state::unknown),
       _potential_peer_database_updated(false),
       _sync_items_to_fetch_updated(false),
       _suspend_fetching_sync_blocks(false),
       _items_to_fetch_updated(false),
       _items_to_fetch_sequence_counter(0),
+      _inventory_advertisement_interval(fc::milliseconds(GRAPHENE_NET_DEFAULT_INVENTORY_ADVERTISEMENT_INTERVAL_MS)),
+      _coalescing_inventory(false),
+      _peer_max_transactions_per_second(GRAPHENE_NET_DEFAULT_PEER_MAX_TRX_PER_SECOND),
+      _peer_max_transaction_inventory_per_second(GRAPHENE_NET_DEFAULT_PEER_MAX_TRX_INVENTORY_PER_SECOND),
       _recent_block_interval_in_seconds(GRAPHENE_MAX_BLOCK_INTERVAL),
       _user_agent_string(user_agent),
       _desired_number_of_connections(GRAPHENE_NET_DEFAULT_DESIRED_CONNECTIONS),
@@ -811,6 +1051,7 @@ namespace graphene { namespace net { namespace detail {
       _peer_inactivity_timeout(GRAPHENE_NET_PEER_HANDSHAKE_INACTIVITY_TIMEOUT),
       _most_recent_blocks_accepted(_maximum_number_of_connections),
       _total_number_of_unfetched_items(0),
+      _served_blocks_size(0),
       _rate_limiter(0, 0),
       _last_reported_number_of_connections(0),
       _peer_advertising_disabled(false),
@@ -825,7 +1066,10 @@ namespace graphene { namespace net { namespace detail {
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _items_received(0),
+      _duplicate_items_received(0),
+      _witness_relay_blocks_pushed(0)
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -916,11 +1160,17 @@ namespace graphene { namespace net { namespace detail {
             dlog("Done processing \"add once\" node list");
           }
 
+          // likewise the witness relays, which we reconnect to whenever we lose them
+          for (const fc::ip::endpoint& relay_endpoint : _witness_relay_endpoints)
+            if (!is_connection_to_endpoint_in_progress(relay_endpoint))
+              connect_to_endpoint(relay_endpoint);
+
           while (is_wanting_new_connections())
           {
             bool initiated_connection_this_pass = false;
             _potential_peer_database_updated = false;
 
+            // the best scoring peers come first
             for (peer_database::iterator iter = _potential_peer_db.begin();
                  iter != _potential_peer_db.end() && is_wanting_new_connections();
                  ++iter)
@@ -1033,6 +1283,7 @@ namespace graphene { namespace net { namespace detail {
         _sync_items_to_fetch_updated = false;
         dlog( "beginning another iteration of the sync items loop" );
 
+        bool sync_requests_outstanding = false;
         if (!_suspend_fetching_sync_blocks)
         {
           std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
@@ -1041,30 +1292,49 @@ namespace graphene { namespace net { namespace detail {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            std::vector<peer_connection_ptr> sync_peers;
             for( const peer_connection_ptr& peer : _active_connections )
+              if( peer->we_need_sync_items_from_peer )
+                sync_peers.push_back( peer );
+
+            // release the blocks a slow peer is sitting on so the others can fetch them,
+            // if there is another peer to fetch them from
+            if( sync_peers.size() > 1 )
+              release_slow_sync_requests( sync_peers );
+
+            // give the blocks we need first to the peers delivering the fastest
+            std::stable_sort( sync_peers.begin(), sync_peers.end(),
+                              []( const peer_connection_ptr& a, const peer_connection_ptr& b ) {
+                                return a->sync_blocks_per_second > b->sync_blocks_per_second;
+                              } );
+
+            // for each peer that we're syncing with that has room in its window
+            for( const peer_connection_ptr& peer : sync_peers )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+              if( !peer->sync_items_requested_from_peer.empty() )
+                sync_requests_outstanding = true;
+              const size_t window = std::min<size_t>( peer->sync_window, _maximum_blocks_per_peer_during_syncing );
+              if( !peer->inhibit_fetching_sync_blocks &&
+                  !peer->item_ids_requested_from_peer &&
+                  peer->items_requested_from_peer.empty() &&
+                  peer->sync_items_requested_from_peer.size() <= window / 2 )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                const size_t blocks_to_request = window - peer->sync_items_requested_from_peer.size();
+                // loop through the items it has that we don't yet have on our blockchain
+                for( unsigned i = 0; i < peer->ids_of_items_to_get.size() && blocks_to_request > 0; ++i )
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
+                  item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
+                  // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                  if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                      sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                      _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() && // we've requested it in a previous iteration and we're still waiting for it to arrive
+                      peer->sync_items_requested_from_peer.find(item_id(block_message_type, item_to_potentially_request)) == peer->sync_items_requested_from_peer.end() ) // it's this peer that is slow to deliver it
                   {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
+                    // then schedule a request from this peer
+                    sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
+                    sync_items_to_request.insert( item_to_potentially_request );
+                    if (sync_item_requests_to_send[peer].size() >= blocks_to_request)
+                      break;
                   }
                 }
               }
@@ -1074,6 +1344,8 @@ namespace graphene { namespace net { namespace detail {
           // make all the requests we scheduled in the loop above
           for( auto sync_item_request : sync_item_requests_to_send )
             request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
+          if( !sync_item_requests_to_send.empty() )
+            sync_requests_outstanding = true;
           sync_item_requests_to_send.clear();
         }
         else
@@ -1083,12 +1355,79 @@ namespace graphene { namespace net { namespace detail {
         {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise = fc::promise<void>::ptr( new fc::promise<void>("graphene::net::retrigger_fetch_sync_items_loop") );
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          try
+          {
+            // while blocks are on their way, wake up now and then to notice peers that are slow to deliver them
+            if( sync_requests_outstanding )
+              _retrigger_fetch_sync_items_loop_promise->wait( fc::seconds(1) );
+            else
+              _retrigger_fetch_sync_items_loop_promise->wait();
+          }
+          catch (const fc::timeout_exception&)
+          {
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
     }
 
+    void node_impl::release_slow_sync_requests( const std::vector<peer_connection_ptr>& sync_peers )
+    {
+      VERIFY_CORRECT_THREAD();
+      const fc::time_point now = fc::time_point::now();
+
+      // forget about re-requested blocks nobody is delivering anymore
+      for( auto iter = _sync_items_rerequested.begin(); iter != _sync_items_rerequested.end(); )
+      {
+        bool still_requested = false;
+        for( const peer_connection_ptr& peer : sync_peers )
+          if( peer->sync_items_requested_from_peer.find(item_id(block_message_type, *iter)) != peer->sync_items_requested_from_peer.end() )
+          {
+            still_requested = true;
+            break;
+          }
+        if( still_requested )
+          ++iter;
+        else
+          iter = _sync_items_rerequested.erase( iter );
+      }
+
+      for( const peer_connection_ptr& peer : sync_peers )
+      {
+        if( peer->sync_items_requested_from_peer.empty() )
+          continue;
+        fc::microseconds allowed_time = fc::seconds(GRAPHENE_NET_SYNC_REREQUEST_SECONDS);
+        if( peer->sync_blocks_per_second > 0 )
+          allowed_time = std::max( allowed_time,
+                                   fc::microseconds( int64_t( 4 * 1000000 * peer->sync_items_requested_from_peer.size() / peer->sync_blocks_per_second ) ) );
+        for( const peer_connection::item_to_time_map_type::value_type& item_and_time : peer->sync_items_requested_from_peer )
+          if( item_and_time.second + allowed_time < now &&
+              _sync_items_rerequested.insert( item_and_time.first.item_hash ).second )
+          {
+            dlog( "sync block ${id} is taking too long to arrive from peer ${peer}, asking another peer for it",
+                  ("id", item_and_time.first.item_hash)("peer", peer->get_remote_endpoint()) );
+            _active_sync_requests.erase( item_and_time.first.item_hash );
+            peer->sync_window = std::max<uint32_t>( peer->sync_window / 2, GRAPHENE_NET_MIN_SYNC_WINDOW );
+          }
+      }
+    }
+
+    void node_impl::record_sync_block_received( peer_connection* peer, const fc::time_point& request_time )
+    {
+      VERIFY_CORRECT_THREAD();
+      const fc::time_point now = fc::time_point::now();
+      // with more blocks in the pipe, the time since the last block is how long this one took;
+      // otherwise the peer had nothing to do before we asked
+      fc::microseconds time_to_deliver = now - std::max( request_time, peer->last_sync_block_received_time );
+      double sample = 1000000.0 / std::max<int64_t>( time_to_deliver.count(), 1000 );
+      peer->sync_blocks_per_second = peer->sync_blocks_per_second > 0 ? 0.9 * peer->sync_blocks_per_second + 0.1 * sample : sample;
+      peer->last_sync_block_received_time = peer->sync_items_requested_from_peer.empty() ? fc::time_point() : now;
+      ++peer->number_of_sync_blocks_received;
+      peer->sync_window = std::min<uint32_t>( std::max<uint32_t>( uint32_t( peer->sync_blocks_per_second * GRAPHENE_NET_SYNC_PIPELINE_SECONDS ),
+                                                                  GRAPHENE_NET_MIN_SYNC_WINDOW ),
+                                              _maximum_blocks_per_peer_during_syncing );
+    }
+
     void node_impl::trigger_fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1240,6 +1579,25 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       while (!_advertise_inventory_loop_done.canceled())
       {
+        // let transactions pile up for a while so they go out in as few inventory messages as
+        // possible, but advertise blocks right away
+        if (_inventory_advertisement_interval > fc::microseconds(0) && !new_inventory_contains_blocks())
+        {
+          _coalescing_inventory = true;
+          _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
+          try
+          {
+            _retrigger_advertise_inventory_loop_promise->wait(_inventory_advertisement_interval);
+          }
+          catch (const fc::timeout_exception&)
+          {
+          }
+          _retrigger_advertise_inventory_loop_promise.reset();
+          _coalescing_inventory = false;
+          if (_advertise_inventory_loop_done.canceled())
+            break;
+        }
+
         dlog("beginning an iteration of advertise inventory");
         // swap inventory into local variable, clearing the node's copy
         std::unordered_set<item_id> inventory_to_advertise;
@@ -1253,7 +1611,6 @@ namespace graphene { namespace net { namespace detail {
         for (const peer_connection_ptr& peer : _active_connections)
         {
           // only advertise to peers who are in sync with us
-           wdump((peer->peer_needs_sync_items_from_us));
           if( !peer->peer_needs_sync_items_from_us )
           {
             std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
@@ -1261,19 +1618,13 @@ namespace graphene { namespace net { namespace detail {
             // or anything it has advertised to us
             // group the items we need to send by type, because we'll need to send one inventory message per type
             unsigned total_items_to_send_to_this_peer = 0;
-            wdump((inventory_to_advertise));
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) != peer->inventory_advertised_to_peer.end() )
-                 wdump((*peer->inventory_advertised_to_peer.find(item_to_advertise)));
-              if (peer->inventory_peer_advertised_to_us.find(item_to_advertise) != peer->inventory_peer_advertised_to_us.end() )
-                 wdump((*peer->inventory_peer_advertised_to_us.find(item_to_advertise)));
-
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
+              if (!peer->inventory_advertised_to_peer.contains(item_to_advertise) &&
                   peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
               {
                 items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
+                peer->inventory_advertised_to_peer.insert(item_to_advertise);
                 ++total_items_to_send_to_this_peer;
                 if (item_to_advertise.item_type == trx_message_type)
                   testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
@@ -1303,6 +1654,14 @@ namespace graphene { namespace net { namespace detail {
       } // while(!canceled)
     }
 
+    bool node_impl::new_inventory_contains_blocks() const
+    {
+      for (const item_id& item : _new_inventory)
+        if (item.item_type == block_message_type)
+          return true;
+      return false;
+    }
+
     void node_impl::trigger_advertise_inventory_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1747,9 +2106,26 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    static const char* message_span_name( uint32_t msg_type )
+    {
+      switch( msg_type )
+      {
+      case graphene::net::trx_message_type:
+        return "p2p_trx_message";
+      case graphene::net::block_message_type:
+        return "p2p_block_message";
+      case core_message_type_enum::compact_block_message_type:
+        return "p2p_compact_block_message";
+      default:
+        return "p2p_message";
+      }
+    }
+
     void node_impl::on_message( peer_connection* originating_peer, const message& received_message )
     {
       VERIFY_CORRECT_THREAD();
+      GRAPHENE_TRACE_SPAN( message_span_name( received_message.msg_type ) );
+      graphene::utilities::allocation_phase_scope allocation_phase( graphene::utilities::alloc_p2p );
       message_hash_type message_hash = received_message.id();
       dlog("handling message ${type} ${hash} size ${size} from peer ${endpoint}",
            ("type", graphene::net::core_message_type_enum(received_message.msg_type))("hash", message_hash)
@@ -1811,6 +2187,15 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer, received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1854,6 +2239,8 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1876,6 +2263,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as_bool();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -1897,7 +2286,8 @@ namespace graphene { namespace net { namespace detail {
       fc::sha256::encoder shared_secret_encoder;
       fc::sha512 shared_secret = originating_peer->get_shared_secret();
       shared_secret_encoder.write(shared_secret.data(), sizeof(shared_secret));
-      fc::ecc::public_key expected_node_public_key(hello_message_received.signed_shared_secret, shared_secret_encoder.result(), false);
+      fc::sha256 shared_secret_hash = shared_secret_encoder.result();
+      fc::ecc::public_key expected_node_public_key(hello_message_received.signed_shared_secret, shared_secret_hash, false);
 
       // store off the data provided in the hello message
       originating_peer->user_agent = hello_message_received.user_agent;
@@ -1910,6 +2300,27 @@ namespace graphene { namespace net { namespace detail {
 
       parse_hello_user_data_for_peer(originating_peer, hello_message_received.user_data);
 
+      if (hello_message_received.user_data.contains("witness_relay_signature"))
+      {
+        try
+        {
+          fc::ecc::public_key witness_key(hello_message_received.user_data["witness_relay_signature"].as<fc::ecc::compact_signature>(),
+                                          shared_secret_hash, false);
+          if (_delegate->is_active_witness_key(witness_key))
+          {
+            ilog("peer ${peer} is a witness relay", ("peer", originating_peer->get_remote_endpoint()));
+            originating_peer->witness_relay_key = witness_key;
+          }
+          else
+            dlog("peer ${peer} sent a witness relay signature for a key that isn't an active witness's",
+                 ("peer", originating_peer->get_remote_endpoint()));
+        }
+        catch (const fc::exception& e)
+        {
+          dlog("invalid witness relay signature from peer ${peer}: ${e}", ("peer", originating_peer->get_remote_endpoint())("e", e));
+        }
+      }
+
       // if they didn't provide a last known fork, try to guess it
       if (originating_peer->last_known_fork_block_number == 0 &&
           originating_peer->graphene_git_revision_unix_timestamp)
@@ -2054,7 +2465,8 @@ namespace graphene { namespace net { namespace detail {
             originating_peer->is_firewalled = firewalled_state::firewalled;
           }
 
-          if (!is_accepting_new_connections())
+          // witness relays are let in over the connection limits
+          if (!is_accepting_new_connections() && !originating_peer->witness_relay_key)
           {
             connection_rejected_message connection_rejected(_user_agent_string, core_protocol_version,
                                                             originating_peer->get_socket().remote_endpoint(),
@@ -2702,7 +3114,7 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
-    message node_impl::get_message_for_item(const item_id& item)
+    message_ptr node_impl::get_message_for_item(const item_id& item)
     {
       try
       {
@@ -2712,11 +3124,41 @@ namespace graphene { namespace net { namespace detail {
       {}
       try
       {
-        return _delegate->get_item(item);
+        return get_item_from_delegate(item);
       }
       catch (fc::key_not_found_exception&)
       {}
-      return item_not_available_message(item);
+      return std::make_shared<const message>(item_not_available_message(item));
+    }
+
+    message_ptr node_impl::get_item_from_delegate(const item_id& item)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (item.item_type != block_message_type)
+        return std::make_shared<const message>(_delegate->get_item(item));
+
+      auto index_iter = _served_blocks_by_id.find(item.item_hash);
+      if (index_iter != _served_blocks_by_id.end())
+      {
+        _served_blocks.splice(_served_blocks.begin(), _served_blocks, index_iter->second);
+        return index_iter->second->second;
+      }
+
+      message_ptr block = std::make_shared<const message>(_delegate->get_item(item));
+      // another task may have fetched it while we were waiting on the delegate
+      if (_served_blocks_by_id.find(item.item_hash) == _served_blocks_by_id.end())
+      {
+        _served_blocks.emplace_front(item.item_hash, block);
+        _served_blocks_by_id[item.item_hash] = _served_blocks.begin();
+        _served_blocks_size += block->size;
+        while (_served_blocks_size > GRAPHENE_NET_SERVED_BLOCKS_CACHE_SIZE_IN_BYTES && _served_blocks.size() > 1)
+        {
+          _served_blocks_size -= _served_blocks.back().second->size;
+          _served_blocks_by_id.erase(_served_blocks.back().first);
+          _served_blocks.pop_back();
+        }
+      }
+      return block;
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer, const fetch_items_message& fetch_items_message_received)
@@ -2727,20 +3169,29 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      message_ptr last_block_message_sent;
 
-      std::list<message> reply_messages;
+      std::list<message_ptr> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          message_ptr requested_message = _message_cache.get_message(item_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+               ("id", requested_message->id()));
           if (fetch_items_message_received.item_type == block_message_type)
+          {
             last_block_message_sent = requested_message;
+            // a block we're relaying: the peer has probably seen most of its transactions already
+            graphene::net::block_message block = requested_message->as<graphene::net::block_message>();
+            if (originating_peer->supports_compact_blocks && !block.block.transactions.empty())
+            {
+              reply_messages.push_back(std::make_shared<const message>(make_compact_block_for_peer(originating_peer, block.block, item_hash)));
+              continue;
+            }
+          }
+          reply_messages.push_back(requested_message);
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2751,10 +3202,10 @@ namespace graphene { namespace net { namespace detail {
         item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
         try
         {
-          message requested_message = _delegate->get_item(item_to_fetch);
+          message_ptr requested_message = get_item_from_delegate(item_to_fetch);
           dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
+               ("id", requested_message->id())
+               ("size", requested_message->size)
                ("endpoint", originating_peer->get_remote_endpoint()));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
@@ -2763,7 +3214,7 @@ namespace graphene { namespace net { namespace detail {
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<const message>(item_not_available_message(item_to_fetch)));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2772,15 +3223,15 @@ namespace graphene { namespace net { namespace detail {
       // if we sent them a block, update our record of the last block they've seen accordingly
       if (last_block_message_sent)
       {
-        graphene::net::block_message block = last_block_message_sent->as<graphene::net::block_message>();
-        originating_peer->last_block_delegate_has_seen = block.block_id;
-        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
+        block_id_type last_block_id_sent = block_message::block_id_of(*last_block_message_sent);
+        originating_peer->last_block_delegate_has_seen = last_block_id_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(last_block_id_sent);
       }
 
-      for (const message& reply : reply_messages)
+      for (const message_ptr& reply : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply->msg_type == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, block_message::block_id_of(*reply)));
         else
           originating_peer->send_message(reply);
       }
@@ -2821,6 +3272,156 @@ namespace graphene { namespace net { namespace detail {
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
+    void node_impl::on_compact_block_message( peer_connection* originating_peer, const compact_block_message& compact_block_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id block_item(block_message_type, compact_block_message_received.item_hash);
+      // witness relays push compact blocks without being asked
+      if ((originating_peer->items_requested_from_peer.find(block_item) == originating_peer->items_requested_from_peer.end() &&
+           !originating_peer->witness_relay_key) ||
+          originating_peer->compact_blocks_waiting.find(compact_block_message_received.block_id) != originating_peer->compact_blocks_waiting.end())
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      // take the transactions we've seen from our message cache, and ask for the rest
+      peer_connection::waiting_compact_block waiting_block;
+      static_cast<signed_block_header&>(waiting_block.block) = compact_block_message_received.header;
+      waiting_block.item_hash = compact_block_message_received.item_hash;
+      waiting_block.block.transactions.resize(compact_block_message_received.transactions.size());
+      for (uint32_t i = 0; i < compact_block_message_received.transactions.size(); ++i)
+      {
+        const compact_block_transaction& compact_trx = compact_block_message_received.transactions[i];
+        fc::optional<signed_transaction> trx = compact_trx.transaction;
+        if (!trx)
+          trx = _message_cache.get_transaction_by_short_id(compact_trx.short_id);
+        if (!trx)
+        {
+          waiting_block.missing_transactions.push_back(i);
+          continue;
+        }
+        processed_transaction& block_trx = waiting_block.block.transactions[i];
+        static_cast<signed_transaction&>(block_trx) = std::move(*trx);
+        block_trx.operation_results = compact_trx.operation_results;
+      }
+      dlog("received compact block ${block_id} from peer ${endpoint}, missing ${missing} of ${count} transactions",
+           ("block_id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint())
+           ("missing", waiting_block.missing_transactions.size())
+           ("count", compact_block_message_received.transactions.size()));
+
+      if (waiting_block.missing_transactions.empty())
+      {
+        finish_compact_block(originating_peer, std::move(waiting_block));
+        return;
+      }
+      originating_peer->send_message(fetch_compact_block_transactions_message(compact_block_message_received.block_id,
+                                                                              waiting_block.missing_transactions));
+      originating_peer->compact_blocks_waiting[compact_block_message_received.block_id] = std::move(waiting_block);
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message( peer_connection* originating_peer,
+                                                                 const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = fetch_compact_block_transactions_message_received.block_id;
+      compact_block_transactions_message reply;
+      reply.block_id = block_id;
+
+      message_ptr requested_message = _message_cache.get_message_by_contents(block_message_type, block_id);
+      if (!requested_message)
+      {
+        try
+        {
+          requested_message = get_item_from_delegate(item_id(block_message_type, block_id));
+        }
+        catch (fc::key_not_found_exception&)
+        {
+        }
+      }
+
+      // if we no longer have the block, the empty reply tells the peer to get it elsewhere
+      if (requested_message)
+      {
+        graphene::net::block_message block = requested_message->as<graphene::net::block_message>();
+        for (uint32_t index : fetch_compact_block_transactions_message_received.transaction_indexes)
+        {
+          if (index >= block.block.transactions.size())
+          {
+            reply.transactions.clear();
+            break;
+          }
+          reply.transactions.push_back(block.block.transactions[index]);
+        }
+      }
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_compact_block_transactions_message( peer_connection* originating_peer,
+                                                           const compact_block_transactions_message& compact_block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      auto waiting_iter = originating_peer->compact_blocks_waiting.find(compact_block_transactions_message_received.block_id);
+      if (waiting_iter == originating_peer->compact_blocks_waiting.end())
+      {
+        dlog("received transactions of compact block ${block_id} we're not waiting for",
+             ("block_id", compact_block_transactions_message_received.block_id));
+        return;
+      }
+      peer_connection::waiting_compact_block waiting_block = std::move(waiting_iter->second);
+      originating_peer->compact_blocks_waiting.erase(waiting_iter);
+
+      const std::vector<processed_transaction>& transactions = compact_block_transactions_message_received.transactions;
+      if (transactions.size() != waiting_block.missing_transactions.size())
+      {
+        on_item_not_available_message(originating_peer, item_not_available_message(item_id(block_message_type, waiting_block.item_hash)));
+        return;
+      }
+      for (size_t i = 0; i < transactions.size(); ++i)
+        waiting_block.block.transactions[waiting_block.missing_transactions[i]] = transactions[i];
+      waiting_block.missing_transactions.clear();
+      finish_compact_block(originating_peer, std::move(waiting_block));
+    }
+
+    void node_impl::finish_compact_block( peer_connection* originating_peer, peer_connection::waiting_compact_block&& waiting_block )
+    {
+      VERIFY_CORRECT_THREAD();
+      block_id_type block_id = waiting_block.block.id();
+      message block_message_to_process = graphene::net::block_message(waiting_block.block);
+      if (block_message_to_process.id() == waiting_block.item_hash)
+      {
+        process_block_message(originating_peer, block_message_to_process, waiting_block.item_hash);
+        return;
+      }
+
+      // one of the transactions we took from our cache isn't the one in the block (they can differ in their
+      // signatures, or in the rare short id collision), so we ask for all of them
+      if (!waiting_block.fetched_all)
+      {
+        dlog("compact block ${block_id} from peer ${endpoint} didn't match, fetching all of its transactions",
+             ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        waiting_block.fetched_all = true;
+        waiting_block.missing_transactions.resize(waiting_block.block.transactions.size());
+        for (uint32_t i = 0; i < waiting_block.missing_transactions.size(); ++i)
+          waiting_block.missing_transactions[i] = i;
+        originating_peer->send_message(fetch_compact_block_transactions_message(block_id, waiting_block.missing_transactions));
+        originating_peer->compact_blocks_waiting[block_id] = std::move(waiting_block);
+        return;
+      }
+
+      wlog("compact block ${block_id} from peer ${endpoint} doesn't match the block requested, disconnecting from peer",
+           ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+      fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that doesn't match the block I asked for, block_id: ${block_id}",
+                                                  ("block_id", block_id)));
+      disconnect_from_peer(originating_peer, "You sent me a compact block that doesn't match the block I asked for", true, detailed_error);
+    }
+
     void node_impl::on_item_ids_inventory_message(peer_connection* originating_peer, const item_ids_inventory_message& item_ids_inventory_message_received)
     {
       VERIFY_CORRECT_THREAD();
@@ -2830,14 +3431,32 @@ namespace graphene { namespace net { namespace detail {
 
       dlog( "received inventory of ${count} items from peer ${endpoint}",
            ( "count", item_ids_inventory_message_received.item_hashes_available.size() )("endpoint", originating_peer->get_remote_endpoint() ) );
+      const bool advertising_transactions = item_ids_inventory_message_received.item_type == graphene::net::trx_message_type;
+      if (advertising_transactions && originating_peer->is_transaction_fetching_inhibited())
+      {
+        // we won't fetch them from this peer anyway
+        originating_peer->transactions_dropped += item_ids_inventory_message_received.item_hashes_available.size();
+        return;
+      }
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
+        if (advertising_transactions && !originating_peer->transaction_inventory_bucket.take())
+        {
+          const std::vector<item_hash_t>& hashes = item_ids_inventory_message_received.item_hashes_available;
+          uint64_t ignored = hashes.size() - (&item_hash - hashes.data());
+          originating_peer->transactions_dropped += ignored;
+          dlog("peer ${endpoint} is advertising transactions faster than we allow, ignoring the last ${ignored} ids",
+               ("endpoint", originating_peer->get_remote_endpoint())("ignored", ignored));
+          break;
+        }
         bool we_advertised_this_item_to_a_peer = false;
         bool we_requested_this_item_from_a_peer = false;
         for (const peer_connection_ptr peer : _active_connections)
         {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
+          // the filter may have a false positive, so make sure we still have the item
+          if (peer->inventory_advertised_to_peer.contains(advertised_item_id) &&
+              _message_cache.contains(item_hash))
           {
             we_advertised_this_item_to_a_peer = true;
             break;
@@ -2939,6 +3558,24 @@ namespace graphene { namespace net { namespace detail {
         }
       }
 
+      // keep the peer's traffic in the totals after it is gone
+      if (_closing_connections.find(originating_peer_ptr) != _closing_connections.end() ||
+          _handshaking_connections.find(originating_peer_ptr) != _handshaking_connections.end() ||
+          _terminating_connections.find(originating_peer_ptr) != _terminating_connections.end() ||
+          _active_connections.find(originating_peer_ptr) != _active_connections.end())
+      {
+        for (const auto& type_and_traffic : originating_peer->traffic_received_by_type)
+        {
+          _closed_connections_traffic_received[type_and_traffic.first].messages += type_and_traffic.second.messages;
+          _closed_connections_traffic_received[type_and_traffic.first].bytes += type_and_traffic.second.bytes;
+        }
+        for (const auto& type_and_traffic : originating_peer->traffic_sent_by_type)
+        {
+          _closed_connections_traffic_sent[type_and_traffic.first].messages += type_and_traffic.second.messages;
+          _closed_connections_traffic_sent[type_and_traffic.first].bytes += type_and_traffic.second.bytes;
+        }
+      }
+
       _closing_connections.erase(originating_peer_ptr);
       _handshaking_connections.erase(originating_peer_ptr);
       _terminating_connections.erase(originating_peer_ptr);
@@ -2952,6 +3589,16 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            // remember how the connection went, for the peer's score
+            updated_peer_record->total_connected_seconds += (fc::time_point::now() - originating_peer->get_connection_time()).to_seconds();
+            updated_peer_record->number_of_sync_blocks_received += originating_peer->number_of_sync_blocks_received;
+            if (originating_peer->round_trip_delay > fc::microseconds(0))
+            {
+              uint32_t round_trip_delay_ms = (uint32_t)(originating_peer->round_trip_delay.count() / 1000);
+              updated_peer_record->average_round_trip_delay_ms = updated_peer_record->average_round_trip_delay_ms ?
+                                                                 (3 * updated_peer_record->average_round_trip_delay_ms + round_trip_delay_ms) / 4 :
+                                                                 std::max<uint32_t>(round_trip_delay_ms, 1);
+            }
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -2991,7 +3638,8 @@ namespace graphene { namespace net { namespace detail {
       if (!originating_peer->sync_items_requested_from_peer.empty())
       {
         for (auto sync_item_and_time : originating_peer->sync_items_requested_from_peer)
-          _active_sync_requests.erase(sync_item_and_time.first.item_hash);
+          if (_sync_items_rerequested.find(sync_item_and_time.first.item_hash) == _sync_items_rerequested.end()) // otherwise another peer is fetching it too
+            _active_sync_requests.erase(sync_item_and_time.first.item_hash);
         trigger_fetch_sync_items_loop();
       }
 
@@ -3307,6 +3955,9 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
+      // let the client check what it can while the blocks before this one are applied
+      _delegate->prevalidate_block( block_message_to_process );
+
       // add it to the front of _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
       _new_received_sync_items.push_front( block_message_to_process );
@@ -3339,6 +3990,7 @@ namespace graphene { namespace net { namespace detail {
           std::vector<fc::uint160_t> contained_transaction_message_ids;
           _delegate->handle_block(block_message_to_process, false, contained_transaction_message_ids);
           message_validated_time = fc::time_point::now();
+          _block_first_seen_latency.record(message_receive_time - fc::time_point(block_message_to_process.block.timestamp));
           ilog("Successfully pushed block ${num} (id:${id})",
                 ("num", block_message_to_process.block.block_num())
                 ("id", block_message_to_process.block_id));
@@ -3363,7 +4015,10 @@ namespace graphene { namespace net { namespace detail {
             trigger_advertise_inventory_loop();
         }
         else
+        {
           dlog( "Already received and accepted this block (presumably through sync mechanism), treating it as accepted" );
+          ++_duplicate_items_received;
+        }
 
         dlog( "client validated the block, advertising it to other peers" );
 
@@ -3472,6 +4127,8 @@ namespace graphene { namespace net { namespace detail {
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
+        _block_fetch_latency.record(fc::time_point::now() - item_iter->second);
+        ++_items_received;
         originating_peer->items_requested_from_peer.erase(item_iter);
         process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
         if (originating_peer->idle())
@@ -3485,9 +4142,21 @@ namespace graphene { namespace net { namespace detail {
                                                                                             block_message_to_process.block_id));
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
+          fc::time_point request_time = sync_item_iter->second;
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           _active_sync_requests.erase(block_message_to_process.block_id);
-          process_block_during_sync(originating_peer, block_message_to_process, message_hash);
+          record_sync_block_received(originating_peer, request_time);
+          ++_items_received;
+          // a block we asked two peers for is only processed the first time it arrives
+          if (_sync_items_rerequested.find(block_message_to_process.block_id) != _sync_items_rerequested.end() &&
+              (have_already_received_sync_item(block_message_to_process.block_id) ||
+               _delegate->has_item(item_id(block_message_type, block_message_to_process.block_id))))
+          {
+            dlog("already received sync block ${id} from another peer, ignoring this copy", ("id", block_message_to_process.block_id));
+            ++_duplicate_items_received;
+          }
+          else
+            process_block_during_sync(originating_peer, block_message_to_process, message_hash);
           if (originating_peer->idle())
           {
             // we have finished fetching a batch of items, so we either need to grab another batch of items
@@ -3498,10 +4167,29 @@ namespace graphene { namespace net { namespace detail {
             else
               trigger_fetch_sync_items_loop();
           }
+          else if (originating_peer->sync_items_requested_from_peer.size() <= originating_peer->sync_window / 2)
+            trigger_fetch_sync_items_loop(); // keep the peer's pipe full
           return;
         }
       }
 
+      if (originating_peer->witness_relay_key)
+      {
+        // a witness relay pushing us a new block.  While we are syncing with it, the block will come through sync
+        if (originating_peer->we_need_sync_items_from_peer)
+        {
+          dlog("ignoring block ${id} pushed by witness relay ${endpoint} while we are syncing with it",
+               ("id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+          return;
+        }
+        _witness_relay_block_latency.record(fc::time_point::now() - fc::time_point(block_message_to_process.block.timestamp));
+        ++_items_received;
+        // don't fetch it from anyone else
+        _items_to_fetch.get<item_id_index>().erase(item_id(block_message_type, message_hash));
+        process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
+        return;
+      }
+
       // if we get here, we didn't request the message, we must have a misbehaving peer
       wlog("received a block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
            ("endpoint", originating_peer->get_remote_endpoint())
@@ -3614,7 +4302,7 @@ namespace graphene { namespace net { namespace detail {
         {
           // we're not connected to them, so we need to set up a connection to them
           // to test.
-          peer_connection_ptr peer_for_testing(peer_connection::make_shared(this));
+          peer_connection_ptr peer_for_testing(new_peer_connection());
           peer_for_testing->firewall_check_state = new firewall_check_state_data;
           peer_for_testing->firewall_check_state->endpoint_to_test = check_firewall_message_received.endpoint_to_check;
           peer_for_testing->firewall_check_state->expected_node_id = check_firewall_message_received.node_id;
@@ -3798,10 +4486,24 @@ namespace graphene { namespace net { namespace detail {
       }
       else
       {
+        if (message_to_process.msg_type == trx_message_type)
+          _transaction_fetch_latency.record(message_receive_time - iter->second);
+        ++_items_received;
+        if (_message_cache.contains(message_hash))
+          ++_duplicate_items_received;
         originating_peer->items_requested_from_peer.erase( iter );
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
+        // drop transactions beyond the peer's rate before spending anything on them
+        if (message_to_process.msg_type == trx_message_type && !originating_peer->transaction_bucket.take(message_receive_time))
+        {
+          ++originating_peer->transactions_dropped;
+          dlog("peer ${endpoint} is sending transactions faster than we allow, dropping ${hash}",
+               ("endpoint", originating_peer->get_remote_endpoint())("hash", message_hash));
+          return;
+        }
+
         // Next: have the delegate process the message
         fc::time_point message_validated_time;
         try
@@ -3810,6 +4512,8 @@ namespace graphene { namespace net { namespace detail {
           {
             trx_message transaction_message_to_process = message_to_process.as<trx_message>();
             dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
+            // the stateless checks run here, so the delegate thread is left with what depends on the state
+            _delegate->prevalidate_transaction(transaction_message_to_process);
             _delegate->handle_transaction(transaction_message_to_process);
           }
           else
@@ -3825,8 +4529,12 @@ namespace graphene { namespace net { namespace detail {
           wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
           // record it so we don't try to fetch this item again
           _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(message_to_process.msg_type, message_hash ), fc::time_point::now()));
+          if (message_to_process.msg_type == trx_message_type)
+            originating_peer->record_transaction_result(false);
           return;
         }
+        if (message_to_process.msg_type == trx_message_type)
+          originating_peer->record_transaction_result(true);
 
         // finally, if the delegate validated the message, broadcast it to our other peers
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
@@ -4170,7 +4878,7 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       while ( !_accept_loop_complete.canceled() )
       {
-        peer_connection_ptr new_peer(peer_connection::make_shared(this));
+        peer_connection_ptr new_peer(new_peer_connection());
 
         try
         {
@@ -4204,7 +4912,8 @@ namespace graphene { namespace net { namespace detail {
       fc::sha256::encoder shared_secret_encoder;
       fc::sha512 shared_secret = peer->get_shared_secret();
       shared_secret_encoder.write(shared_secret.data(), sizeof(shared_secret));
-      fc::ecc::compact_signature signature = _node_configuration.private_key.sign_compact(shared_secret_encoder.result());
+      fc::sha256 shared_secret_hash = shared_secret_encoder.result();
+      fc::ecc::compact_signature signature = _node_configuration.private_key.sign_compact(shared_secret_hash);
 
       // in the hello messsage, we send three things:
       //  ip address
@@ -4226,6 +4935,14 @@ namespace graphene { namespace net { namespace detail {
         listening_port = _publicly_visible_listening_endpoint->port();
       }
 
+      fc::mutable_variant_object user_data(generate_hello_user_data());
+      // only the peers we were told are witness relays learn that we hold a witness key
+      if (_witness_relay_key && is_witness_relay_address(peer->get_socket().remote_endpoint().get_address()))
+      {
+        user_data["witness_relay_signature"] = _witness_relay_key->sign_compact(shared_secret_hash);
+        peer->sent_witness_relay_signature = true;
+      }
+
       hello_message hello(_user_agent_string,
                           core_protocol_version,
                           local_endpoint.get_address(),
@@ -4234,7 +4951,7 @@ namespace graphene { namespace net { namespace detail {
                           _node_public_key,
                           signature,
                           _chain_id,
-                          generate_hello_user_data());
+                          user_data);
 
       peer->send_message(message(hello));
     }
@@ -4411,6 +5128,10 @@ namespace graphene { namespace net { namespace detail {
       try
       {
         _potential_peer_db.open(potential_peer_database_file_name);
+        fc::path legacy_peer_database_file_name(_node_configuration_directory / LEGACY_POTENTIAL_PEER_DATABASE_FILENAME);
+        // the JSON file is kept, and imported again on the next start, until its peers are saved
+        if (fc::exists(legacy_peer_database_file_name) && _potential_peer_db.import_json(legacy_peer_database_file_name))
+          fc::remove(legacy_peer_database_file_name);
 
         // push back the time on all peers loaded from the database so we will be able to retry them immediately
         for (peer_database::iterator itr = _potential_peer_db.begin(); itr != _potential_peer_db.end(); ++itr)
@@ -4595,7 +5316,7 @@ namespace graphene { namespace net { namespace detail {
                            ("endpoint", remote_endpoint));
 
       dlog("node_impl::connect_to_endpoint(${endpoint})", ("endpoint", remote_endpoint));
-      peer_connection_ptr new_peer(peer_connection::make_shared(this));
+      peer_connection_ptr new_peer(new_peer_connection());
       new_peer->set_remote_endpoint(remote_endpoint);
       initiate_connect_to(new_peer);
     }
@@ -4797,6 +5518,11 @@ namespace graphene { namespace net { namespace detail {
         peer_details["lastrecv"] = peer->get_last_message_received_time().sec_since_epoch();
         peer_details["bytessent"] = peer->get_total_bytes_sent();
         peer_details["bytesrecv"] = peer->get_total_bytes_received();
+        peer_details["bytessent_by_type"] = get_message_traffic_statistics(peer->traffic_sent_by_type);
+        peer_details["bytesrecv_by_type"] = get_message_traffic_statistics(peer->traffic_received_by_type);
+        peer_details["queued_bytes"] = peer->get_total_queued_messages_size();
+        peer_details["transactions_dropped"] = peer->transactions_dropped;
+        peer_details["transaction_fetching_inhibited"] = peer->is_transaction_fetching_inhibited();
         peer_details["conntime"] = peer->get_connection_time();
         peer_details["pingtime"] = "";
         peer_details["pingwait"] = "";
@@ -4872,8 +5598,11 @@ namespace graphene { namespace net { namespace detail {
       message_hash_type hash_of_item_to_broadcast = item_to_broadcast.id();
 
       _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents );
+      if( item_to_broadcast.msg_type == graphene::net::block_message_type )
+        push_block_to_witness_relays( item_to_broadcast, hash_of_item_to_broadcast, propagation_data );
       _new_inventory.insert( item_id(item_to_broadcast.msg_type, hash_of_item_to_broadcast ) );
-      trigger_advertise_inventory_loop();
+      if( !_coalescing_inventory || item_to_broadcast.msg_type == graphene::net::block_message_type )
+        trigger_advertise_inventory_loop();
     }
 
     void node_impl::broadcast( const message& item_to_broadcast )
@@ -4924,6 +5653,21 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("inventory_advertisement_interval_ms"))
+        _inventory_advertisement_interval = fc::milliseconds(params["inventory_advertisement_interval_ms"].as<uint32_t>());
+      if (params.contains("message_cache_size_in_bytes"))
+        _message_cache.set_maximum_size_in_bytes(params["message_cache_size_in_bytes"].as<uint64_t>());
+      if (params.contains("peer_max_transactions_per_second") || params.contains("peer_max_transaction_inventory_per_second"))
+      {
+        if (params.contains("peer_max_transactions_per_second"))
+          _peer_max_transactions_per_second = params["peer_max_transactions_per_second"].as<uint32_t>();
+        if (params.contains("peer_max_transaction_inventory_per_second"))
+          _peer_max_transaction_inventory_per_second = params["peer_max_transaction_inventory_per_second"].as<uint32_t>();
+        for (const peer_connection_ptr& peer : _handshaking_connections)
+          configure_transaction_buckets(peer.get());
+        for (const peer_connection_ptr& peer : _active_connections)
+          configure_transaction_buckets(peer.get());
+      }
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4943,6 +5687,10 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["inventory_advertisement_interval_ms"] = _inventory_advertisement_interval.count() / 1000;
+      result["message_cache_size_in_bytes"] = uint64_t(_message_cache.get_maximum_size_in_bytes());
+      result["peer_max_transactions_per_second"] = _peer_max_transactions_per_second;
+      result["peer_max_transaction_inventory_per_second"] = _peer_max_transaction_inventory_per_second;
       return result;
     }
 
@@ -4989,6 +5737,35 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       _rate_limiter.set_upload_limit( upload_bytes_per_second );
       _rate_limiter.set_download_limit( download_bytes_per_second );
+      _download_rate_limited = download_bytes_per_second != 0;
+    }
+
+    void node_impl::set_io_threads( uint32_t thread_count )
+    {
+      VERIFY_CORRECT_THREAD();
+      // connections already reading on the threads keep them, new ones get the new threads
+      while( _io_threads.size() < thread_count )
+        _io_threads.emplace_back( new fc::thread( "p2p_io_" + fc::to_string( _io_threads.size() ) ) );
+    }
+
+    peer_connection_ptr node_impl::new_peer_connection()
+    {
+      VERIFY_CORRECT_THREAD();
+      peer_connection_ptr new_peer( peer_connection::make_shared( this ) );
+      // the rate limiter queues the reads it delays on this thread, so limited reads stay here
+      if( !_io_threads.empty() && !_download_rate_limited )
+        new_peer->set_read_thread( _io_threads[ _next_io_thread++ % _io_threads.size() ].get() );
+      configure_transaction_buckets( new_peer.get() );
+      return new_peer;
+    }
+
+    void node_impl::configure_transaction_buckets(peer_connection* peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      peer->transaction_bucket.configure(_peer_max_transactions_per_second,
+                                         _peer_max_transactions_per_second * GRAPHENE_NET_PEER_TRX_BURST_SECONDS);
+      peer->transaction_inventory_bucket.configure(_peer_max_transaction_inventory_per_second,
+                                                   _peer_max_transaction_inventory_per_second * GRAPHENE_NET_PEER_TRX_BURST_SECONDS);
     }
 
     void node_impl::disable_peer_advertising()
@@ -4997,6 +5774,73 @@ namespace graphene { namespace net { namespace detail {
       _peer_advertising_disabled = true;
     }
 
+    void node_impl::set_witness_relay_key(const fc::ecc::private_key& signing_key)
+    {
+      VERIFY_CORRECT_THREAD();
+      _witness_relay_key = signing_key;
+    }
+
+    void node_impl::add_witness_relay_endpoint(const fc::ip::endpoint& ep)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (std::find(_witness_relay_endpoints.begin(), _witness_relay_endpoints.end(), ep) == _witness_relay_endpoints.end())
+        _witness_relay_endpoints.push_back(ep);
+      trigger_p2p_network_connect_loop();
+    }
+
+    bool node_impl::is_witness_relay_address(const fc::ip::address& address) const
+    {
+      VERIFY_CORRECT_THREAD();
+      for (const fc::ip::endpoint& ep : _witness_relay_endpoints)
+        if (ep.get_address() == address)
+          return true;
+      return false;
+    }
+
+    compact_block_message node_impl::make_compact_block_for_peer(peer_connection* peer, const signed_block& block, const item_hash_t& item_hash)
+    {
+      VERIFY_CORRECT_THREAD();
+      return compact_block_message(block, item_hash, [peer](const signed_transaction& trx) {
+        item_id trx_item(trx_message_type, message(trx_message(trx)).id());
+        return peer->inventory_peer_advertised_to_us.find(trx_item) != peer->inventory_peer_advertised_to_us.end() ||
+               peer->inventory_advertised_to_peer.contains(trx_item);
+      });
+    }
+
+    void node_impl::push_block_to_witness_relays(const message& block_message_to_push, const message_hash_type& message_hash,
+                                                 const message_propagation_data& propagation_data)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (!_witness_relay_key)
+        return;
+      item_id block_item(block_message_type, message_hash);
+      fc::optional<graphene::net::block_message> block;
+      message_ptr full_block;
+      for (const peer_connection_ptr& peer : _active_connections)
+      {
+        if (!peer->witness_relay_key || !peer->sent_witness_relay_signature ||
+            peer->peer_needs_sync_items_from_us || peer->node_id == propagation_data.originating_peer ||
+            peer->inventory_peer_advertised_to_us.find(block_item) != peer->inventory_peer_advertised_to_us.end() ||
+            peer->inventory_advertised_to_peer.contains(block_item))
+          continue;
+        if (!block)
+          block = block_message_to_push.as<graphene::net::block_message>();
+        // the peer fetches the transactions it is missing like it does for a block it asked for
+        if (peer->supports_compact_blocks && !block->block.transactions.empty())
+          peer->send_message(message(make_compact_block_for_peer(peer.get(), block->block, message_hash)));
+        else
+        {
+          if (!full_block)
+            full_block = std::make_shared<const message>(block_message_to_push);
+          peer->send_message(full_block);
+        }
+        // it has the block now, so the inventory we advertise leaves it out
+        peer->inventory_advertised_to_peer.insert(block_item);
+        ++_witness_relay_blocks_pushed;
+        dlog("pushed block ${id} to witness relay ${endpoint}", ("id", block->block_id)("endpoint", peer->get_remote_endpoint()));
+      }
+    }
+
     fc::variant_object node_impl::get_call_statistics() const
     {
       VERIFY_CORRECT_THREAD();
@@ -5013,6 +5857,44 @@ namespace graphene { namespace net { namespace detail {
       info["firewalled"] = _is_firewalled;
       return info;
     }
+    fc::variant_object node_impl::network_get_statistics() const
+    {
+      VERIFY_CORRECT_THREAD();
+      peer_connection::message_traffic_by_type traffic_received = _closed_connections_traffic_received;
+      peer_connection::message_traffic_by_type traffic_sent = _closed_connections_traffic_sent;
+      size_t queued_bytes = 0;
+      for (const std::unordered_set<peer_connection_ptr>* connections : {&_handshaking_connections, &_active_connections, &_closing_connections, &_terminating_connections})
+        for (const peer_connection_ptr& peer : *connections)
+        {
+          for (const auto& type_and_traffic : peer->traffic_received_by_type)
+          {
+            traffic_received[type_and_traffic.first].messages += type_and_traffic.second.messages;
+            traffic_received[type_and_traffic.first].bytes += type_and_traffic.second.bytes;
+          }
+          for (const auto& type_and_traffic : peer->traffic_sent_by_type)
+          {
+            traffic_sent[type_and_traffic.first].messages += type_and_traffic.second.messages;
+            traffic_sent[type_and_traffic.first].bytes += type_and_traffic.second.bytes;
+          }
+          queued_bytes += peer->get_total_queued_messages_size();
+        }
+
+      fc::mutable_variant_object result;
+      result["traffic_received_by_type"] = get_message_traffic_statistics(traffic_received);
+      result["traffic_sent_by_type"] = get_message_traffic_statistics(traffic_sent);
+      result["queued_bytes"] = queued_bytes;
+      result["message_cache_size"] = _message_cache.size();
+      result["message_cache"] = _message_cache.get_statistics();
+      result["transaction_fetch_latency"] = _transaction_fetch_latency.get_statistics();
+      result["block_fetch_latency"] = _block_fetch_latency.get_statistics();
+      result["block_first_seen_latency"] = _block_first_seen_latency.get_statistics();
+      result["items_received"] = _items_received;
+      result["duplicate_items_received"] = _duplicate_items_received;
+      result["witness_relay_block_latency"] = _witness_relay_block_latency.get_statistics();
+      result["witness_relay_blocks_pushed"] = _witness_relay_blocks_pushed;
+      return result;
+    }
+
     fc::variant_object node_impl::network_get_usage_stats() const
     {
       VERIFY_CORRECT_THREAD();
@@ -5201,6 +6083,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(set_total_bandwidth_limit, upload_bytes_per_second, download_bytes_per_second);
   }
 
+  void node::set_io_threads(uint32_t thread_count)
+  {
+    INVOKE_IN_IMPL(set_io_threads, thread_count);
+  }
+
   void node::disable_peer_advertising()
   {
     INVOKE_IN_IMPL(disable_peer_advertising);
@@ -5211,6 +6098,16 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(get_call_statistics);
   }
 
+  void node::set_witness_relay_key( const fc::ecc::private_key& signing_key )
+  {
+    INVOKE_IN_IMPL(set_witness_relay_key, signing_key);
+  }
+
+  void node::add_witness_relay_endpoint( const fc::ip::endpoint& ep )
+  {
+    INVOKE_IN_IMPL(add_witness_relay_endpoint, ep);
+  }
+
   fc::variant_object node::network_get_info() const
   {
     INVOKE_IN_IMPL(network_get_info);
@@ -5221,6 +6118,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(network_get_usage_stats);
   }
 
+  fc::variant_object node::network_get_statistics() const
+  {
+    INVOKE_IN_IMPL(network_get_statistics);
+  }
+
   void node::close()
   {
     INVOKE_IN_IMPL(close);
@@ -5398,6 +6300,18 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_message_ids);
     }
 
+    void statistics_gathering_node_delegate_wrapper::prevalidate_block( const graphene::net::block_message& block_message )
+    {
+      // called on the calling thread on purpose, the delegate thread is busy applying blocks during sync
+      _node_delegate->prevalidate_block( block_message );
+    }
+
+    void statistics_gathering_node_delegate_wrapper::prevalidate_transaction( const graphene::net::trx_message& transaction_message )
+    {
+      // called on the calling thread on purpose, the delegate thread is busy applying blocks and transactions
+      _node_delegate->prevalidate_transaction( transaction_message );
+    }
+
     void statistics_gathering_node_delegate_wrapper::handle_transaction( const graphene::net::trx_message& transaction_message )
     {
       INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
@@ -5475,6 +6389,11 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_current_block_interval_in_seconds);
     }
 
+    bool statistics_gathering_node_delegate_wrapper::is_active_witness_key( const fc::ecc::public_key& key )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(is_active_witness_key, key);
+    }
+
 #undef INVOKE_AND_COLLECT_STATISTICS
 
   } // end namespace detail
@@ -29,6 +29,9 @@
 
 #include <fc/thread/thread.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -42,24 +45,30 @@
 
 namespace graphene { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    message_ptr peer_connection::real_queued_message::get_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
-        // patch the current time into the message.  Since this operates on the packed version of the structure,
-        // it won't work for anything after a variable-length field
+        // patch the current time into a copy of the message, the message itself may be shared.  Since this
+        // operates on the packed version of the structure, it won't work for anything after a variable-length field
+        std::shared_ptr<message> patched_message = std::make_shared<message>(*message_to_send);
         std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
-        assert(message_send_time_field_offset + packed_current_time.size() <= message_to_send.data.size());
-        memcpy(message_to_send.data.data() + message_send_time_field_offset,
+        assert(message_send_time_field_offset + packed_current_time.size() <= patched_message->data.size());
+        memcpy(patched_message->data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
+        return patched_message;
       }
       return message_to_send;
     }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
-      return message_to_send.data.size();
+      return message_to_send->data.size();
+    }
+    bool peer_connection::real_queued_message::is_unsolicited() const
+    {
+      return message_to_send->msg_type == item_ids_inventory_message_type;
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    message_ptr peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
     {
       return node->get_message_for_item(item_to_send);
     }
@@ -68,6 +77,58 @@ namespace graphene { namespace net
     {
       return sizeof(item_id);
     }
+    message_ptr peer_connection::virtual_queued_message::get_unavailable_reply() const
+    {
+      // virtual messages are the items a peer fetched from us, it waits for an answer
+      return std::make_shared<const message>(item_not_available_message(item_to_send));
+    }
+
+    peer_connection::send_lane peer_connection::get_send_lane(const item_id& item_to_send)
+    {
+      return item_to_send.item_type == block_message_type ? block_lane : transaction_lane;
+    }
+
+    peer_connection::send_lane peer_connection::get_send_lane(const message& message_to_send)
+    {
+      switch (message_to_send.msg_type)
+      {
+      case block_message_type:
+      case compact_block_message_type:
+      case fetch_compact_block_transactions_message_type:
+      case compact_block_transactions_message_type:
+      case hello_message_type:
+      case connection_accepted_message_type:
+      case connection_rejected_message_type:
+      case closing_connection_message_type:
+      case current_time_request_message_type:
+      case current_time_reply_message_type:
+        return block_lane;
+      case item_ids_inventory_message_type:
+      case fetch_items_message_type:
+      {
+        // both start with the item type, which is all we need to know
+        uint32_t item_type = 0;
+        if (message_to_send.data.size() < sizeof(item_type))
+          return transaction_lane;
+        fc::datastream<const char*> stream(message_to_send.data.data(), message_to_send.data.size());
+        fc::raw::unpack(stream, item_type);
+        return item_type == block_message_type ? block_lane : transaction_lane;
+      }
+      case blockchain_item_ids_inventory_message_type:
+      case fetch_blockchain_item_ids_message_type:
+      case item_not_available_message_type:
+        return sync_lane;
+      case address_request_message_type:
+      case address_message_type:
+      case check_firewall_message_type:
+      case check_firewall_reply_message_type:
+      case get_current_connections_request_message_type:
+      case get_current_connections_reply_message_type:
+        return peer_exchange_lane;
+      default:
+        return transaction_lane;
+      }
+    }
 
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
@@ -80,11 +141,18 @@ namespace graphene { namespace net
       their_state(their_connection_state::disconnected),
       we_have_requested_close(false),
       negotiation_status(connection_negotiation_status::disconnected),
+      supports_compact_blocks(false),
       number_of_unfetched_item_ids(0),
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
       inhibit_fetching_sync_blocks(false),
+      sync_window(GRAPHENE_NET_MIN_SYNC_WINDOW),
+      sync_blocks_per_second(0),
+      number_of_sync_blocks_received(0),
       transaction_fetching_inhibited_until(fc::time_point::min()),
+      transactions_accepted(0),
+      transactions_rejected(0),
+      transactions_dropped(0),
       last_known_fork_block_number(0),
       firewall_check_state(nullptr)
 #ifndef NDEBUG
@@ -182,6 +250,12 @@ namespace graphene { namespace net
       return _message_connection.get_socket();
     }
 
+    void peer_connection::set_read_thread(fc::thread* read_thread)
+    {
+      VERIFY_CORRECT_THREAD();
+      _message_connection.set_read_thread(read_thread);
+    }
+
     void peer_connection::accept_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -265,6 +339,7 @@ namespace graphene { namespace net
     void peer_connection::on_message( message_oriented_connection* originating_connection, const message& received_message )
     {
       VERIFY_CORRECT_THREAD();
+      traffic_received_by_type[received_message.msg_type].add(received_message);
       _node->on_message( this, received_message );
     }
 
@@ -285,16 +360,22 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      for (;;)
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // always send from the highest lane with anything in it, that may change while we're sending
+        send_lane_queue* lane = std::find_if(std::begin(_send_lanes), std::end(_send_lanes),
+                                             [](const send_lane_queue& queue) { return !queue.messages.empty(); });
+        if (lane == std::end(_send_lanes))
+          break;
+        lane->messages.front()->transmission_start_time = fc::time_point::now();
+        message_ptr message_to_send = lane->messages.front()->get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
           //     "to send message of type ${type} for peer ${endpoint}",
           //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+          _message_connection.send_message(*message_to_send);
+          traffic_sent_by_type[message_to_send->msg_type].add(*message_to_send);
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -324,9 +405,11 @@ namespace graphene { namespace net
         {
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        lane->messages.front()->transmission_finish_time = fc::time_point::now();
+        size_t message_size = lane->messages.front()->get_size_in_queue();
+        lane->total_size -= message_size;
+        _total_queued_messages_size -= message_size;
+        lane->messages.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
@@ -334,12 +417,35 @@ namespace graphene { namespace net
     void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
-      _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
-      if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
+      send_lane lane_number = message_to_send->get_send_lane();
+      send_lane_queue& lane = _send_lanes[lane_number];
+      size_t message_size = message_to_send->get_size_in_queue();
+      if (lane.total_size + message_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES &&
+          lane_number >= transaction_lane)
+      {
+        // the peer can get advertised items elsewhere, so a slow peer loses them instead of its connection;
+        // an item it asked for is answered either way, it would otherwise wait for it until it times out
+        if (message_to_send->is_unsolicited())
+        {
+          dlog("send lane ${lane} to peer ${endpoint} is full (${current} bytes), dropping an inventory message",
+               ("lane", (int)lane_number)("endpoint", get_remote_endpoint())("current", lane.total_size));
+          return;
+        }
+        if (message_ptr reply = message_to_send->get_unavailable_reply())
+        {
+          dlog("send lane ${lane} to peer ${endpoint} is full (${current} bytes), answering a fetch with item_not_available",
+               ("lane", (int)lane_number)("endpoint", get_remote_endpoint())("current", lane.total_size));
+          send_message(std::move(reply));
+          return;
+        }
+      }
+      lane.total_size += message_size;
+      _total_queued_messages_size += message_size;
+      lane.messages.emplace(std::move(message_to_send));
+      if (lane.total_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
-             ("max", GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)("current", _total_queued_messages_size));
+             ("max", GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)("current", lane.total_size));
         try
         {
           close_connection();
@@ -368,7 +474,15 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-      std::unique_ptr<queued_message> message_to_enqueue(new real_queued_message(message_to_send, message_send_time_field_offset));
+      std::unique_ptr<queued_message> message_to_enqueue(new real_queued_message(std::make_shared<const message>(message_to_send),
+                                                                                 message_send_time_field_offset));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
+    void peer_connection::send_message(message_ptr message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::unique_ptr<queued_message> message_to_enqueue(new real_queued_message(std::move(message_to_send)));
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -409,6 +523,12 @@ namespace graphene { namespace net
       return _message_connection.get_total_bytes_received();
     }
 
+    size_t peer_connection::get_total_queued_messages_size() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _total_queued_messages_size;
+    }
+
     fc::time_point peer_connection::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
@@ -456,6 +576,50 @@ namespace graphene { namespace net
       return transaction_fetching_inhibited_until > fc::time_point::now();
     }
 
+    void peer_connection::record_transaction_result(bool accepted)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (accepted)
+        ++transactions_accepted;
+      else
+        ++transactions_rejected;
+
+      uint32_t total = transactions_accepted + transactions_rejected;
+      if (total < GRAPHENE_NET_PEER_TRX_PENALTY_MIN_SAMPLES)
+        return;
+      if (uint64_t(transactions_rejected) * 100 > uint64_t(total) * GRAPHENE_NET_PEER_TRX_PENALTY_FAILED_PERCENT)
+      {
+        wlog("peer ${peer} sent us ${rejected} rejected transactions out of ${total}, not fetching transactions from it for ${seconds} seconds",
+             ("peer", get_remote_endpoint())("rejected", transactions_rejected)("total", total)
+             ("seconds", GRAPHENE_NET_PEER_TRX_PENALTY_SECONDS));
+        transaction_fetching_inhibited_until = fc::time_point::now() + fc::seconds(GRAPHENE_NET_PEER_TRX_PENALTY_SECONDS);
+      }
+      transactions_accepted = 0;
+      transactions_rejected = 0;
+    }
+
+    void token_bucket::configure(uint32_t rate, uint32_t burst)
+    {
+      _rate = rate;
+      _burst = burst;
+      _tokens = std::min<double>(_tokens, burst);
+    }
+
+    bool token_bucket::take(const fc::time_point& now)
+    {
+      if (_rate == 0)
+        return true;
+      if (now > _last_refill)
+      {
+        _tokens = std::min<double>(_burst, _tokens + double((now - _last_refill).count()) * _rate / 1000000);
+        _last_refill = now;
+      }
+      if (_tokens < 1)
+        return false;
+      _tokens -= 1;
+      return true;
+    }
+
     fc::sha512 peer_connection::get_shared_secret() const
     {
       VERIFY_CORRECT_THREAD();
@@ -467,20 +631,17 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
 
-      // expire old items from inventory_advertised_to_peer
-      auto oldest_inventory_to_keep_iter = inventory_advertised_to_peer.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      auto begin_iter = inventory_advertised_to_peer.get<timestamp_index>().begin();
-      unsigned number_of_elements_advertised_to_peer_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_advertised_to_peer.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+      // start a new generation of inventory_advertised_to_peer once the current one is old enough
+      inventory_advertised_to_peer.expire();
 
-      // also expire items from inventory_peer_advertised_to_us
-      oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
+      // expire old items from inventory_peer_advertised_to_us
+      auto oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
+      auto begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
       unsigned number_of_elements_peer_advertised_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
       inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
-      dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
+      dlog("Expiring old inventory for peer ${peer}: ${to_peer} items advertised to peer remembered, and removing ${to_us} advertised to us (${remain_to_us} left)",
            ("peer", get_remote_endpoint())
-           ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
+           ("to_peer", inventory_advertised_to_peer.size())
            ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", inventory_peer_advertised_to_us.size()));
     }
 
@@ -32,9 +32,13 @@
 #include <fc/io/raw_variant.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/filesystem.hpp>
 
 #include <graphene/net/peer_database.hpp>
 
+#include <fstream>
+
 
 
 namespace graphene { namespace net {
@@ -42,16 +46,66 @@ namespace graphene { namespace net {
   {
     using namespace boost::multi_index;
 
+    /** the version of the binary peer database file format, written at its start */
+    const uint32_t peer_database_file_version = 1;
+    const size_t maximum_peer_database_size = 1000;
+
+    template<typename Stream>
+    void pack_peer_record(Stream& s, const potential_peer_record& record)
+    {
+      fc::raw::pack(s, record.endpoint);
+      fc::raw::pack(s, record.last_seen_time);
+      fc::raw::pack(s, record.last_connection_disposition);
+      fc::raw::pack(s, record.last_connection_attempt_time);
+      fc::raw::pack(s, record.number_of_successful_connection_attempts);
+      fc::raw::pack(s, record.number_of_failed_connection_attempts);
+      fc::optional<fc::variant> last_error;
+      if (record.last_error)
+        last_error = fc::variant(*record.last_error);
+      fc::raw::pack(s, last_error);
+      fc::raw::pack(s, record.average_round_trip_delay_ms);
+      fc::raw::pack(s, record.total_connected_seconds);
+      fc::raw::pack(s, record.number_of_sync_blocks_received);
+    }
+
+    template<typename Stream>
+    void unpack_peer_record(Stream& s, potential_peer_record& record)
+    {
+      fc::raw::unpack(s, record.endpoint);
+      fc::raw::unpack(s, record.last_seen_time);
+      fc::raw::unpack(s, record.last_connection_disposition);
+      fc::raw::unpack(s, record.last_connection_attempt_time);
+      fc::raw::unpack(s, record.number_of_successful_connection_attempts);
+      fc::raw::unpack(s, record.number_of_failed_connection_attempts);
+      fc::optional<fc::variant> last_error;
+      fc::raw::unpack(s, last_error);
+      if (last_error)
+        record.last_error = last_error->as<fc::exception>();
+      fc::raw::unpack(s, record.average_round_trip_delay_ms);
+      fc::raw::unpack(s, record.total_connected_seconds);
+      fc::raw::unpack(s, record.number_of_sync_blocks_received);
+    }
+
+    template<typename Stream>
+    void pack_peer_records(Stream& s, const std::vector<potential_peer_record>& records)
+    {
+      fc::raw::pack(s, peer_database_file_version);
+      fc::raw::pack(s, fc::unsigned_int(records.size()));
+      for (const potential_peer_record& record : records)
+        pack_peer_record(s, record);
+    }
+
     class peer_database_impl
     {
     public:
-      struct last_seen_time_index {};
+      struct score_index {};
       struct endpoint_index {};
       typedef boost::multi_index_container<potential_peer_record, 
-                                           indexed_by<ordered_non_unique<tag<last_seen_time_index>, 
-                                                                         member<potential_peer_record, 
-                                                                                fc::time_point_sec, 
-                                                                                &potential_peer_record::last_seen_time> >,
+                                           indexed_by<ordered_non_unique<tag<score_index>, 
+                                                                         const_mem_fun<potential_peer_record,
+                                                                                       int64_t,
+                                                                                       &potential_peer_record::score>,
+                                                                         std::greater<int64_t> >,
                                                       hashed_unique<tag<endpoint_index>, 
                                                                     member<potential_peer_record, 
                                                                            fc::ip::endpoint, 
@@ -64,6 +118,9 @@ namespace graphene { namespace net {
 
     public:
       void open(const fc::path& databaseFilename);
+      bool import_json(const fc::path& json_filename);
+      void prune();
+      bool save() const;
       void close();
       void clear();
       void erase(const fc::ip::endpoint& endpointToErase);
@@ -79,9 +136,9 @@ namespace graphene { namespace net {
     class peer_database_iterator_impl
     {
     public:
-      typedef peer_database_impl::potential_peer_set::index<peer_database_impl::last_seen_time_index>::type::iterator last_seen_time_index_iterator;
-      last_seen_time_index_iterator _iterator;
-      peer_database_iterator_impl(const last_seen_time_index_iterator& iterator) :
+      typedef peer_database_impl::potential_peer_set::index<peer_database_impl::score_index>::type::iterator score_index_iterator;
+      score_index_iterator _iterator;
+      peer_database_iterator_impl(const score_index_iterator& iterator) :
         _iterator(iterator)
       {}
     };
@@ -95,26 +152,62 @@ namespace graphene { namespace net {
       {
         try
         {
-          std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >();
-          std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
-#define MAXIMUM_PEERDB_SIZE 1000
-          if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
+          std::string file_contents;
+          fc::read_file_contents(_peer_database_filename, file_contents);
+          fc::datastream<const char*> ds(file_contents.data(), file_contents.size());
+          uint32_t version;
+          fc::raw::unpack(ds, version);
+          FC_ASSERT(version == peer_database_file_version, "unknown peer database version ${version}", ("version", version));
+          fc::unsigned_int record_count;
+          fc::raw::unpack(ds, record_count);
+          for (uint32_t i = 0; i < record_count.value; ++i)
           {
-            // prune database to a reasonable size
-            auto iter = _potential_peer_set.begin();
-            std::advance(iter, MAXIMUM_PEERDB_SIZE);
-            _potential_peer_set.erase(iter, _potential_peer_set.end());
+            potential_peer_record record;
+            unpack_peer_record(ds, record);
+            _potential_peer_set.insert(record);
           }
         }
         catch (const fc::exception& e)
         {
           elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
                ("peer_database_filename", _peer_database_filename));
+          _potential_peer_set.clear();
         }
       }
+      prune();
     }
 
-    void peer_database_impl::close()
+    bool peer_database_impl::import_json(const fc::path& json_filename)
+    {
+      try
+      {
+        std::vector<potential_peer_record> peer_records = fc::json::from_file(json_filename).as<std::vector<potential_peer_record> >();
+        for (const potential_peer_record& record : peer_records)
+          if (_potential_peer_set.get<endpoint_index>().find(record.endpoint) == _potential_peer_set.get<endpoint_index>().end())
+            _potential_peer_set.insert(record);
+        prune();
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error importing peer database file ${json_filename}", ("json_filename", json_filename));
+        return false;
+      }
+      // the imported peers are on disk before the caller removes the JSON file
+      return save();
+    }
+
+    void peer_database_impl::prune()
+    {
+      // keep the database to a reasonable size, dropping the peers with the worst scores
+      if (_potential_peer_set.size() > maximum_peer_database_size)
+      {
+        auto iter = _potential_peer_set.get<score_index>().begin();
+        std::advance(iter, maximum_peer_database_size);
+        _potential_peer_set.get<score_index>().erase(iter, _potential_peer_set.get<score_index>().end());
+      }
+    }
+
+    bool peer_database_impl::save() const
     {
       std::vector<potential_peer_record> peer_records;
       peer_records.reserve(_potential_peer_set.size());
@@ -125,13 +218,35 @@ namespace graphene { namespace net {
         fc::path peer_database_filename_dir = _peer_database_filename.parent_path();
         if (!fc::exists(peer_database_filename_dir))
           fc::create_directories(peer_database_filename_dir);
-        fc::json::save_to_file(peer_records, _peer_database_filename);
+
+        fc::datastream<size_t> size_stream;
+        pack_peer_records(size_stream, peer_records);
+        std::vector<char> file_contents(size_stream.tellp());
+        fc::datastream<char*> ds(file_contents.data(), file_contents.size());
+        pack_peer_records(ds, peer_records);
+
+        // write a new file and move it over the old one, so a crash leaves one or the other intact
+        fc::path temporary_filename = _peer_database_filename.string() + ".tmp";
+        {
+          std::ofstream out(temporary_filename.string(), std::ios::binary | std::ios::trunc);
+          out.write(file_contents.data(), file_contents.size());
+          out.flush();
+          FC_ASSERT(out.good(), "unable to write ${filename}", ("filename", temporary_filename));
+        }
+        fc::rename(temporary_filename, _peer_database_filename);
       }
       catch (const fc::exception& e)
       {
         elog("error saving peer database to file ${peer_database_filename}", 
              ("peer_database_filename", _peer_database_filename));
+        return false;
       }
+      return true;
+    }
+
+    void peer_database_impl::close()
+    {
+      save();
       _potential_peer_set.clear();
     }
 
@@ -174,12 +289,12 @@ namespace graphene { namespace net {
 
     peer_database::iterator peer_database_impl::begin() const
     {
-      return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<last_seen_time_index>().begin()));
+      return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<score_index>().begin()));
     }
 
     peer_database::iterator peer_database_impl::end() const
     {
-      return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<last_seen_time_index>().end()));
+      return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<score_index>().end()));
     }
 
     size_t peer_database_impl::size() const
@@ -217,6 +332,21 @@ namespace graphene { namespace net {
 
   } // end namespace detail
 
+  int64_t potential_peer_record::score() const
+  {
+    int64_t result = 0;
+    if (last_connection_disposition == last_connection_succeeded)
+      result += 100;
+    result += 10 * std::min<int64_t>(number_of_successful_connection_attempts, 100);
+    result -= 20 * std::min<int64_t>(number_of_failed_connection_attempts, 100);
+    // up to a thousand for a week connected, and for a million sync blocks
+    result += std::min<int64_t>(total_connected_seconds / 600, 1000);
+    result += std::min<int64_t>(number_of_sync_blocks_received / 1000, 1000);
+    // and a tenth of a point off per millisecond of round trip
+    result -= std::min<int64_t>(average_round_trip_delay_ms, 10000) / 10;
+    return result;
+  }
+
   peer_database::peer_database() :
     my(new detail::peer_database_impl)
   {
@@ -230,6 +360,11 @@ namespace graphene { namespace net {
     my->open(databaseFilename);
   }
 
+  bool peer_database::import_json(const fc::path& json_filename)
+  {
+    return my->import_json(json_filename);
+  }
+
   void peer_database::close()
   {
     my->close();
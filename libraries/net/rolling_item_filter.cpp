@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/rolling_item_filter.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace graphene { namespace net {
+
+  namespace
+  {
+    // the item hashes are cryptographic hashes already, so the bit indexes are taken
+    // from the hash itself by double hashing
+    void item_hashes(const item_id& item, uint64_t& h1, uint64_t& h2)
+    {
+      static_assert(sizeof(item_hash_t) >= 2 * sizeof(uint64_t), "item hash too short for the filter");
+      memcpy(&h1, item.item_hash.data(), sizeof(h1));
+      memcpy(&h2, item.item_hash.data() + sizeof(h1), sizeof(h2));
+      h1 ^= uint64_t(item.item_type) * 0x9e3779b97f4a7c15ull;
+      h2 |= 1;
+    }
+  }
+
+  rolling_item_filter::rolling_item_filter(uint32_t items_per_generation, const fc::microseconds& generation_duration) :
+    _items_per_generation(items_per_generation),
+    _generation_duration(generation_duration),
+    _current(0)
+  {
+    const size_t words = (size_t(items_per_generation) * GRAPHENE_NET_INVENTORY_FILTER_BITS_PER_ITEM + 63) / 64;
+    for (generation& gen : _generations)
+    {
+      gen.bits.resize(words);
+      gen.items = 0;
+    }
+    _generations[_current].started = fc::time_point::now();
+  }
+
+  void rolling_item_filter::insert(const item_id& item)
+  {
+    if (_generations[_current].items >= _items_per_generation)
+      start_generation();
+    generation& gen = _generations[_current];
+    const uint64_t bit_count = gen.bits.size() * 64;
+    uint64_t h1, h2;
+    item_hashes(item, h1, h2);
+    for (unsigned i = 0; i < GRAPHENE_NET_INVENTORY_FILTER_HASHES; ++i)
+    {
+      const uint64_t bit = (h1 + i * h2) % bit_count;
+      gen.bits[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    ++gen.items;
+  }
+
+  bool rolling_item_filter::contains(const item_id& item) const
+  {
+    return generation_contains(_generations[_current], item) ||
+           generation_contains(_generations[1 - _current], item);
+  }
+
+  void rolling_item_filter::expire()
+  {
+    if (_generations[_current].started + _generation_duration <= fc::time_point::now())
+      start_generation();
+  }
+
+  size_t rolling_item_filter::size() const
+  {
+    return size_t(_generations[0].items) + _generations[1].items;
+  }
+
+  void rolling_item_filter::start_generation()
+  {
+    _current = 1 - _current;
+    generation& gen = _generations[_current];
+    std::fill(gen.bits.begin(), gen.bits.end(), 0);
+    gen.items = 0;
+    gen.started = fc::time_point::now();
+  }
+
+  bool rolling_item_filter::generation_contains(const generation& gen, const item_id& item) const
+  {
+    if (gen.items == 0)
+      return false;
+    const uint64_t bit_count = gen.bits.size() * 64;
+    uint64_t h1, h2;
+    item_hashes(item, h1, h2);
+    for (unsigned i = 0; i < GRAPHENE_NET_INVENTORY_FILTER_HASHES; ++i)
+    {
+      const uint64_t bit = (h1 + i * h2) % bit_count;
+      if (!(gen.bits[bit / 64] & (uint64_t(1) << (bit % 64))))
+        return false;
+    }
+    return true;
+  }
+
+  advertised_inventory::advertised_inventory(uint32_t items_per_generation, const fc::microseconds& generation_duration) :
+    _transactions(items_per_generation, generation_duration),
+    _duration(generation_duration)
+  {}
+
+  void advertised_inventory::insert(const item_id& item)
+  {
+    if (item.item_type == trx_message_type)
+    {
+      _transactions.insert(item);
+      return;
+    }
+    if (_exact.insert(item).second)
+      _exact_by_time.emplace_back(fc::time_point::now(), item);
+  }
+
+  bool advertised_inventory::contains(const item_id& item) const
+  {
+    if (item.item_type == trx_message_type)
+      return _transactions.contains(item);
+    return _exact.find(item) != _exact.end();
+  }
+
+  void advertised_inventory::expire()
+  {
+    _transactions.expire();
+    const fc::time_point oldest_to_keep = fc::time_point::now() - _duration;
+    while (!_exact_by_time.empty() && _exact_by_time.front().first <= oldest_to_keep)
+    {
+      _exact.erase(_exact_by_time.front().second);
+      _exact_by_time.pop_front();
+    }
+  }
+
+  size_t advertised_inventory::size() const
+  {
+    return _transactions.size() + _exact.size();
+  }
+
+} } // end namespace graphene::net
@@ -36,10 +36,12 @@
 
 namespace graphene { namespace net {
 
+const size_t stcp_socket::buffer_length;
+
 stcp_socket::stcp_socket()
-//:_buf_len(0)
+   : _write_buffer_used(0)
 #ifndef NDEBUG
-   : _read_buffer_in_use(false),
+   , _read_buffer_in_use(false),
      _write_buffer_in_use(false)
 #endif
 {
@@ -100,11 +102,10 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
     if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
+      _read_buffer.reset(new char[buffer_length], [](char* p){ delete[] p; });
 
-    len = std::min<size_t>(read_buffer_length, len);
+    len = std::min<size_t>(buffer_length, len);
 
     size_t s = _sock.readsome( _read_buffer, len, 0 );
     if( s % 16 ) 
@@ -141,23 +142,33 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
     if (!_write_buffer)
-      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
-    len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
+      _write_buffer.reset(new char[buffer_length], [](char* p){ delete[] p; });
+    if (_write_buffer_used == buffer_length)
+      write_buffered();
+    len = std::min<size_t>(buffer_length - _write_buffer_used, len);
     /**
      * every sizeof(crypt_buf) bytes the aes channel
      * has an error and doesn't decrypt properly...  disable
      * for now because we are going to upgrade to something
      * better.
      */
-    uint32_t ciphertext_len = _send_aes.encode( buffer, len, _write_buffer.get() );
+    uint32_t ciphertext_len = _send_aes.encode( buffer, len, _write_buffer.get() + _write_buffer_used );
     assert(ciphertext_len == len);
-    _sock.write( _write_buffer, ciphertext_len );
+    _write_buffer_used += ciphertext_len;
     return ciphertext_len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
+void stcp_socket::write_buffered()
+{
+  if (_write_buffer_used == 0)
+    return;
+  // if the write fails the connection is closed, so the buffered data is dropped either way
+  const size_t used = _write_buffer_used;
+  _write_buffer_used = 0;
+  _sock.write( _write_buffer, used );
+}
+
 size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset )
 {
   return writesome(buf.get() + offset, len);
@@ -165,6 +176,7 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
 
 void stcp_socket::flush()
 {
+  write_buffered();
   _sock.flush();
 }
 
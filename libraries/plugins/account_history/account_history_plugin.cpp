@@ -23,6 +23,7 @@
  */
 
 #include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/account_history_store.hpp>
 
 #include <graphene/app/impacted.hpp>
 
@@ -57,6 +58,14 @@ class account_history_plugin_impl
        */
       void update_account_histories( const signed_block& b );
 
+      /** moves the irreversible operations older than the newest _max_ops_in_memory ones to _store */
+      void move_history_to_store();
+
+      /** links @ref op into the history of @ref account_id, dropping the oldest entry beyond _max_ops_per_account */
+      void add_account_history( account_id_type account_id, const operation_history_object& op );
+      /** removes @ref op unless an account history entry still refers to it */
+      void remove_if_unreferenced( const operation_history_object& op );
+
       graphene::chain::database& database()
       {
          return _self.database();
@@ -64,6 +73,32 @@ class account_history_plugin_impl
 
       account_history_plugin& _self;
       flat_set<account_id_type> _tracked_accounts;
+      /** the number of entries kept per account, 0 keeps all of them */
+      uint32_t                  _max_ops_per_account = 0;
+
+      /** the packed tier, on disk or in memory, only used when history-memory-ops is set */
+      std::unique_ptr<account_history_store> _store;
+      uint32_t                              _max_ops_in_memory = 0;
+      /** the oldest operation that may still be in memory */
+      uint64_t                              _next_to_store = 0;
+};
+
+/**
+ *  Undoing a block brings back the operations move_history_to_store() removed while applying it, this moves them
+ *  again.  They are in the store already, so only the objects are removed.
+ */
+class restored_history_index : public secondary_index
+{
+   public:
+      restored_history_index( uint64_t& next_to_store ):_next_to_store(next_to_store){}
+
+      virtual void object_inserted( const object& obj ) override
+      {
+         _next_to_store = std::min<uint64_t>( _next_to_store, obj.id.instance() );
+      }
+
+   private:
+      uint64_t& _next_to_store;
 };
 
 account_history_plugin_impl::~account_history_plugin_impl()
@@ -95,17 +130,18 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
 
       // get the set of accounts this operation applies to
       flat_set<account_id_type> impacted;
-      vector<authority> other;
-      operation_get_required_authorities( op.op, impacted, impacted, other );
-
       if( op.op.which() == operation::tag< account_create_operation >::value )
+      {
+         // the history of a new account is started by its creation, not by the accounts in its authorities
+         vector<authority> other;
+         operation_get_required_authorities( op.op, impacted, impacted, other );
          impacted.insert( oho.result.get<object_id_type>() );
+         for( auto& a : other )
+            for( auto& item : a.account_auths )
+               impacted.insert( item.first );
+      }
       else
-         graphene::app::operation_get_impacted_accounts( op.op, impacted );
-
-      for( auto& a : other )
-         for( auto& item : a.account_auths )
-            impacted.insert( item.first );
+         graphene::app::operation_get_required_and_impacted_accounts( op.op, impacted );
 
       // for each operation this account applies to that is in the config link it into the history
       if( _tracked_accounts.size() == 0 )
@@ -114,19 +150,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          {
             // we don't do index_account_keys here anymore, because
             // that indexing now happens in observers' post_evaluate()
-
-            // add history
-            const auto& stats_obj = account_id(db).statistics(db);
-            const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-                obj.operation_id = oho.id;
-                obj.account = account_id;
-                obj.sequence = stats_obj.total_ops+1;
-                obj.next = stats_obj.most_recent_op;
-            });
-            db.modify( stats_obj, [&]( account_statistics_object& obj ){
-                obj.most_recent_op = ath.id;
-                obj.total_ops = ath.sequence;
-            });
+            add_account_history( account_id, oho );
          }
       }
       else
@@ -134,20 +158,99 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          for( auto account_id : _tracked_accounts )
          {
             if( impacted.find( account_id ) != impacted.end() )
-            {
-               // add history
-               const auto& stats_obj = account_id(db).statistics(db);
-               const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-                   obj.operation_id = oho.id;
-                   obj.next = stats_obj.most_recent_op;
-               });
-               db.modify( stats_obj, [&]( account_statistics_object& obj ){
-                   obj.most_recent_op = ath.id;
-               });
-            }
+               add_account_history( account_id, oho );
          }
       }
+
+      if( _max_ops_per_account > 0 )
+         remove_if_unreferenced( oho );
+   }
+
+   if( _store )
+      move_history_to_store();
+}
+
+void account_history_plugin_impl::add_account_history( account_id_type account_id, const operation_history_object& op )
+{
+   graphene::chain::database& db = database();
+   const auto& stats_obj = account_id(db).statistics(db);
+   const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
+       obj.operation_id = op.id;
+       obj.account = account_id;
+       obj.sequence = stats_obj.total_ops+1;
+       obj.next = stats_obj.most_recent_op;
+   });
+   db.modify( stats_obj, [&]( account_statistics_object& obj ){
+       obj.most_recent_op = ath.id;
+       obj.total_ops = ath.sequence;
+   });
+
+   if( _max_ops_per_account == 0 || ath.sequence <= _max_ops_per_account )
+      return;
+
+   // the sequence locates the entry that drops out and the one after it, whose next pointed at it
+   const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+   const uint32_t oldest = ath.sequence - _max_ops_per_account;
+   auto itr = by_seq_idx.find( boost::make_tuple( account_id, oldest ) );
+   if( itr == by_seq_idx.end() )
+      return;
+   auto newer = by_seq_idx.find( boost::make_tuple( account_id, oldest + 1 ) );
+   if( newer != by_seq_idx.end() )
+      db.modify( *newer, []( account_transaction_history_object& obj ){
+          obj.next = account_transaction_history_id_type();
+      });
+
+   const operation_history_object* dropped = db.find( itr->operation_id );
+   db.remove( *itr );
+   if( dropped != nullptr )
+      remove_if_unreferenced( *dropped );
+}
+
+void account_history_plugin_impl::remove_if_unreferenced( const operation_history_object& op )
+{
+   graphene::chain::database& db = database();
+   const auto& by_op_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_operation>();
+   const operation_history_id_type op_id = op.id;
+   if( by_op_idx.find( op_id ) == by_op_idx.end() )
+      db.remove( op );
+}
+
+void account_history_plugin_impl::move_history_to_store()
+{
+   graphene::chain::database& db = database();
+   const uint64_t next_op = db.get_index( operation_history_object::space_id, operation_history_object::type_id )
+                              .get_next_id().instance();
+   if( next_op <= _max_ops_in_memory )
+      return;
+   const uint64_t keep_from = next_op - _max_ops_in_memory;
+   const uint32_t last_irreversible = db.get_dynamic_global_properties().last_irreversible_block_num;
+   const auto& by_op_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_operation>();
+
+   vector< std::pair<account_id_type,uint32_t> > accounts;
+   vector< const account_transaction_history_object* > nodes;
+   for( ; _next_to_store < keep_from; ++_next_to_store )
+   {
+      const operation_history_object* op = db.find( operation_history_id_type( _next_to_store ) );
+      if( op == nullptr )
+         continue;
+      if( op->block_num > last_irreversible )
+         break;
+
+      accounts.clear();
+      nodes.clear();
+      const operation_history_id_type op_id = op->id;
+      for( auto itr = by_op_idx.lower_bound( op_id ); itr != by_op_idx.end() && itr->operation_id == op_id; ++itr )
+      {
+         accounts.emplace_back( itr->account, itr->sequence );
+         nodes.push_back( &*itr );
+      }
+      _store->append( *op, accounts );
+
+      for( const account_transaction_history_object* node : nodes )
+         db.remove( *node );
+      db.remove( *op );
    }
+   _store->flush();
 }
 } // end namespace detail
 
@@ -177,23 +280,65 @@ void account_history_plugin::plugin_set_program_options(
 {
    cli.add_options()
          ("track-account", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "Account ID to track history for (may specify multiple times)")
+         ("max-ops-per-account", boost::program_options::value<uint32_t>()->default_value(0),
+          "Keep only this many of the newest history entries of each account, and drop the operations no account "
+          "refers to any more (0 keeps all of them)")
+         ("history-memory-ops", boost::program_options::value<uint32_t>()->default_value(0),
+          "Keep only this many of the newest operations in memory and move older irreversible ones to the on-disk "
+          "store in <data-dir>/account_history (0 keeps all history in memory)")
+         ("history-segment-size", boost::program_options::value<uint32_t>()->default_value(100000),
+          "Number of account history entries per on-disk segment")
+         ("history-packed-in-memory", boost::program_options::value<bool>()->default_value(false),
+          "Keep the operations history-memory-ops moves out of memory packed in memory instead of on disk, they "
+          "are saved to <data-dir>/account_history/packed_history on shutdown; an unclean shutdown loses those moved "
+          "since the last one until the chain is replayed")
          ;
    cfg.add(cli);
 }
 
 void account_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
-   database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); } );
-   database().add_index< primary_index< simple_index< operation_history_object > > >();
+   database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); }, "account_history" );
+   auto op_index = database().add_index< primary_index< simple_index< operation_history_object > > >();
    database().add_index< primary_index< account_transaction_history_index > >();
 
    LOAD_VALUE_SET(options, "tracked-accounts", my->_tracked_accounts, graphene::chain::account_id_type);
+
+   if( options.count( "max-ops-per-account" ) )
+      my->_max_ops_per_account = options["max-ops-per-account"].as<uint32_t>();
+
+   if( options.count( "history-memory-ops" ) && options["history-memory-ops"].as<uint32_t>() > 0 )
+   {
+      my->_max_ops_in_memory = options["history-memory-ops"].as<uint32_t>();
+      my->_store.reset( new account_history_store( options["history-segment-size"].as<uint32_t>() ) );
+      if( options["history-packed-in-memory"].as<bool>() )
+      {
+         fc::create_directories( app().data_dir() / "account_history" );
+         my->_store->open_in_memory( app().data_dir() / "account_history" / "packed_history" );
+      }
+      else
+         my->_store->open( app().data_dir() / "account_history" );
+      if( my->_store->entry_count() > 0 )
+         my->_next_to_store = my->_store->last_operation() + 1;
+      op_index->add_secondary_index<detail::restored_history_index>( std::ref( my->_next_to_store ) );
+   }
 }
 
 void account_history_plugin::plugin_startup()
 {
 }
 
+void account_history_plugin::plugin_shutdown()
+{
+   if( my->_store )
+      my->_store->close();
+}
+
+const account_history_store* account_history_plugin::history_store()const
+{
+   return my->_store.get();
+}
+
 flat_set<account_id_type> account_history_plugin::tracked_accounts() const
 {
    return my->_tracked_accounts;
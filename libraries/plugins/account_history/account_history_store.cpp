@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_history/account_history_store.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+namespace graphene { namespace account_history {
+
+static_assert( sizeof(account_history_store::index_entry) == 32, "index entries are written to disk as they are" );
+
+namespace {
+
+struct by_account_order
+{
+   bool operator()( const account_history_store::index_entry& e, uint64_t account )const { return e.account < account; }
+   bool operator()( uint64_t account, const account_history_store::index_entry& e )const { return account < e.account; }
+};
+
+} // anonymous namespace
+
+account_history_store::account_history_store( uint32_t segment_size )
+   : _segment_size( std::max<uint32_t>( segment_size, 1 ) )
+{}
+
+account_history_store::~account_history_store()
+{
+   close();
+}
+
+fc::path account_history_store::segment_path( uint32_t segment, const char* extension )const
+{
+   char name[32];
+   snprintf( name, sizeof(name), "%08u.%s", segment, extension );
+   return _dir / name;
+}
+
+void account_history_store::open( const fc::path& dir )
+{ try {
+   close();
+   fc::create_directories( dir );
+   _dir = dir;
+
+   uint32_t count = 0;
+   while( fc::exists( segment_path( count, "idx" ) ) )
+      ++count;
+   for( uint32_t segment = 0; segment + 1 < count; ++segment )
+   {
+      map_segment( segment );
+      _entry_count += _segments.back()->end() - _segments.back()->begin();
+   }
+   if( !_segments.empty() )
+      for( const index_entry* e = _segments.back()->begin(); e != _segments.back()->end(); ++e )
+         _last_operation = std::max( _last_operation, e->operation );
+
+   open_active_segment();
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void account_history_store::open_in_memory( const fc::path& file )
+{ try {
+   close();
+   _in_memory  = true;
+   _arena_file = file;
+   if( fc::exists( file ) )
+      load_arena();
+} FC_CAPTURE_AND_RETHROW( (file) ) }
+
+void account_history_store::load_arena()
+{
+   std::ifstream in( _arena_file.string(), std::ios::binary );
+   uint64_t chunks = 0;
+   in.read( reinterpret_cast<char*>( &chunks ), sizeof(chunks) );
+   _arena.resize( chunks );
+   for( auto& chunk : _arena )
+   {
+      uint64_t size = 0;
+      in.read( reinterpret_cast<char*>( &size ), sizeof(size) );
+      chunk.reserve( std::max<uint64_t>( size, 1 << 20 ) );
+      chunk.resize( size );
+      in.read( chunk.data(), size );
+      _active_ops_size += size;
+   }
+   uint64_t entries = 0;
+   in.read( reinterpret_cast<char*>( &entries ), sizeof(entries) );
+   index_entry entry;
+   for( uint64_t i = 0; i < entries && in.read( reinterpret_cast<char*>( &entry ), sizeof(entry) ); ++i )
+   {
+      _active[entry.account].push_back( entry );
+      _last_operation = std::max( _last_operation, entry.operation );
+      ++_active_entries;
+   }
+   FC_ASSERT( in.good() && _active_entries == entries, "Account history file ${p} is truncated", ("p", _arena_file) );
+   _entry_count = _active_entries;
+}
+
+void account_history_store::save_arena()const
+{
+   const fc::path tmp_path( _arena_file.string() + ".tmp" );
+   {
+      std::ofstream out( tmp_path.string(), std::ios::binary | std::ios::trunc );
+      const uint64_t chunks = _arena.size();
+      out.write( reinterpret_cast<const char*>( &chunks ), sizeof(chunks) );
+      for( const auto& chunk : _arena )
+      {
+         const uint64_t size = chunk.size();
+         out.write( reinterpret_cast<const char*>( &size ), sizeof(size) );
+         out.write( chunk.data(), size );
+      }
+      const uint64_t entries = _active_entries;
+      out.write( reinterpret_cast<const char*>( &entries ), sizeof(entries) );
+      for( const auto& account : _active )
+         out.write( reinterpret_cast<const char*>( account.second.data() ), account.second.size() * sizeof(index_entry) );
+      out.flush();
+      FC_ASSERT( out.good(), "Unable to write account history ${p}", ("p", tmp_path) );
+   }
+   fc::rename( tmp_path, _arena_file );
+}
+
+void account_history_store::close()
+{
+   if( !is_open() )
+      return;
+   if( _in_memory )
+      save_arena();
+   flush();
+   _active_ops.close();
+   _active_idx.close();
+   _active.clear();
+   _segments.clear();
+   _arena.clear();
+   _in_memory = false;
+   _arena_file = fc::path();
+   _active_entries = 0;
+   _active_ops_size = 0;
+   _last_operation = 0;
+   _entry_count = 0;
+   _dir = fc::path();
+}
+
+void account_history_store::flush()
+{
+   if( !is_open() || _in_memory )
+      return;
+   // the payloads first, so that the index never points past the end of the .ops file
+   _active_ops.flush();
+   _active_idx.flush();
+   FC_ASSERT( _active_ops.good() && _active_idx.good(), "Unable to write account history segment ${s}",
+              ("s", _segments.size()) );
+}
+
+void account_history_store::open_active_segment()
+{
+   const uint32_t segment = _segments.size();
+   const fc::path ops_path = segment_path( segment, "ops" );
+   const fc::path idx_path = segment_path( segment, "idx" );
+
+   _active_ops_size = fc::exists( ops_path ) ? fc::file_size( ops_path ) : 0;
+   if( fc::exists( idx_path ) )
+   {
+      // drop the entries a crash left without their payload, or cut short
+      std::ifstream in( idx_path.string(), std::ios::binary );
+      index_entry entry;
+      uint64_t    entries = 0;
+      while( in.read( reinterpret_cast<char*>( &entry ), sizeof(entry) ) && entry.offset + entry.size <= _active_ops_size )
+      {
+         _active[entry.account].push_back( entry );
+         _last_operation = std::max( _last_operation, entry.operation );
+         ++entries;
+      }
+      in.close();
+      fc::resize_file( idx_path, entries * sizeof(index_entry) );
+      _active_entries = entries;
+      _entry_count += entries;
+   }
+
+   _active_ops.open( ops_path.string(), std::ios::binary | std::ios::app );
+   _active_idx.open( idx_path.string(), std::ios::binary | std::ios::app );
+   FC_ASSERT( _active_ops.is_open() && _active_idx.is_open(), "Unable to open account history segment ${p}",
+              ("p", ops_path) );
+
+   if( _active_entries >= _segment_size )
+      seal_active_segment();
+}
+
+void account_history_store::seal_active_segment()
+{
+   const uint32_t segment = _segments.size();
+   flush();
+   _active_ops.close();
+   _active_idx.close();
+
+   // the entries of each account are already in sequence order
+   const fc::path idx_path = segment_path( segment, "idx" );
+   const fc::path tmp_path = segment_path( segment, "idx.tmp" );
+   {
+      std::ofstream out( tmp_path.string(), std::ios::binary | std::ios::trunc );
+      for( const auto& account : _active )
+         out.write( reinterpret_cast<const char*>( account.second.data() ), account.second.size() * sizeof(index_entry) );
+      out.flush();
+      FC_ASSERT( out.good(), "Unable to write account history index ${p}", ("p", tmp_path) );
+   }
+   fc::rename( tmp_path, idx_path );
+
+   map_segment( segment );
+   _active.clear();
+   _active_entries = 0;
+   open_active_segment();
+}
+
+void account_history_store::map_segment( uint32_t segment )
+{
+   using namespace boost::interprocess;
+   std::unique_ptr<sealed_segment> s( new sealed_segment );
+   s->ops_file = file_mapping( segment_path( segment, "ops" ).string().c_str(), read_only );
+   s->ops      = mapped_region( s->ops_file, read_only );
+   s->idx_file = file_mapping( segment_path( segment, "idx" ).string().c_str(), read_only );
+   s->idx      = mapped_region( s->idx_file, read_only );
+
+   // the first payload is the oldest operation
+   operation_history_object first;
+   fc::datastream<const char*> ds( static_cast<const char*>( s->ops.get_address() ), s->ops.get_size() );
+   fc::raw::unpack( ds, first );
+   s->first_operation = first.id.instance();
+
+   _segments.push_back( std::move( s ) );
+}
+
+void account_history_store::append( const operation_history_object& op,
+                                    const vector< std::pair<account_id_type,uint32_t> >& accounts )
+{
+   FC_ASSERT( is_open() );
+   const uint64_t operation = op.id.instance();
+   if( accounts.empty() || ( _entry_count > 0 && operation <= _last_operation ) )
+      return;
+
+   const vector<char> data = fc::raw::pack( op );
+   uint64_t offset = _active_ops_size;
+   if( _in_memory )
+      offset = write_to_arena( data );
+   else
+      _active_ops.write( data.data(), data.size() );
+   for( const auto& item : accounts )
+   {
+      index_entry entry;
+      entry.account   = item.first.instance.value;
+      entry.operation = operation;
+      entry.offset    = offset;
+      entry.sequence  = item.second;
+      entry.size      = data.size();
+      if( !_in_memory )
+         _active_idx.write( reinterpret_cast<const char*>( &entry ), sizeof(entry) );
+      _active[entry.account].push_back( entry );
+   }
+   _active_ops_size += data.size();
+   _active_entries  += accounts.size();
+   _entry_count     += accounts.size();
+   _last_operation   = operation;
+
+   if( !_in_memory && _active_entries >= _segment_size )
+      seal_active_segment();
+}
+
+uint64_t account_history_store::write_to_arena( const vector<char>& data )
+{
+   // chunks are reserved up front so that appending never moves the operations stored before
+   const size_t chunk_size = 1 << 20;
+   if( _arena.empty() || _arena.back().capacity() - _arena.back().size() < data.size() )
+   {
+      _arena.emplace_back();
+      _arena.back().reserve( std::max( chunk_size, data.size() ) );
+   }
+   vector<char>& chunk = _arena.back();
+   const uint64_t offset = ( uint64_t( _arena.size() - 1 ) << 32 ) | chunk.size();
+   chunk.insert( chunk.end(), data.begin(), data.end() );
+   return offset;
+}
+
+operation_history_object account_history_store::read_operation( uint32_t segment, const index_entry& entry,
+                                                                std::ifstream& active_ops )const
+{
+   operation_history_object op;
+   if( segment < _segments.size() )
+   {
+      const sealed_segment& s = *_segments[segment];
+      FC_ASSERT( entry.offset + entry.size <= s.ops.get_size(), "Account history segment ${s} is truncated",
+                 ("s", segment) );
+      fc::datastream<const char*> ds( static_cast<const char*>( s.ops.get_address() ) + entry.offset, entry.size );
+      fc::raw::unpack( ds, op );
+      return op;
+   }
+
+   if( _in_memory )
+   {
+      const vector<char>& chunk = _arena[ entry.offset >> 32 ];
+      const size_t begin = entry.offset & 0xffffffff;
+      FC_ASSERT( begin + entry.size <= chunk.size() );
+      fc::datastream<const char*> ds( chunk.data() + begin, entry.size );
+      fc::raw::unpack( ds, op );
+      return op;
+   }
+
+   if( !active_ops.is_open() )
+      active_ops.open( segment_path( segment, "ops" ).string(), std::ios::binary );
+   vector<char> data( entry.size );
+   active_ops.seekg( entry.offset );
+   active_ops.read( data.data(), data.size() );
+   FC_ASSERT( active_ops.good(), "Unable to read account history segment ${s}", ("s", segment) );
+   fc::datastream<const char*> ds( data.data(), data.size() );
+   fc::raw::unpack( ds, op );
+   return op;
+}
+
+template< typename Key >
+vector<operation_history_object> account_history_store::read_history( account_id_type account, uint64_t start,
+                                                                      uint64_t stop, uint32_t limit,
+                                                                      uint64_t newest_operation, Key key )const
+{
+   vector<operation_history_object> result;
+   if( !is_open() || limit == 0 || start <= stop )
+      return result;
+
+   std::ifstream active_ops;
+   // walks back from start through the entries of the account in one segment, true once there is nothing older to read
+   auto collect = [&]( const index_entry* first, const index_entry* last, uint32_t segment ) -> bool
+   {
+      auto itr = std::upper_bound( first, last, start,
+                                   [&key]( uint64_t value, const index_entry& e ) { return value < key( e ); } );
+      while( itr != first )
+      {
+         --itr;
+         if( key( *itr ) <= stop || result.size() >= limit )
+            return true;
+         result.push_back( read_operation( segment, *itr, active_ops ) );
+      }
+      return result.size() >= limit;
+   };
+
+   const uint64_t account_instance = account.instance.value;
+   auto active = _active.find( account_instance );
+   if( active != _active.end() &&
+       collect( active->second.data(), active->second.data() + active->second.size(), _segments.size() ) )
+      return result;
+
+   // skip the segments that only hold newer operations, deep pages need not search every one of them
+   uint32_t segment = std::upper_bound( _segments.begin(), _segments.end(), newest_operation,
+                                        []( uint64_t op, const std::unique_ptr<sealed_segment>& s ) {
+                                           return op < s->first_operation;
+                                        } ) - _segments.begin();
+   while( segment-- > 0 )
+   {
+      const sealed_segment& s = *_segments[segment];
+      auto range = std::equal_range( s.begin(), s.end(), account_instance, by_account_order() );
+      if( collect( range.first, range.second, segment ) )
+         break;
+   }
+   return result;
+}
+
+vector<operation_history_object> account_history_store::get_account_history( account_id_type account, uint64_t start,
+                                                                             uint64_t stop, uint32_t limit )const
+{
+   return read_history( account, start, stop, limit, start,
+                        []( const index_entry& e ) -> uint64_t { return e.operation; } );
+}
+
+vector<operation_history_object> account_history_store::get_relative_account_history( account_id_type account,
+                                                                                      uint32_t start, uint32_t stop,
+                                                                                      uint32_t limit )const
+{
+   return read_history( account, start, stop, limit, std::numeric_limits<uint64_t>::max(),
+                        []( const index_entry& e ) -> uint64_t { return e.sequence; } );
+}
+
+} } // graphene::account_history
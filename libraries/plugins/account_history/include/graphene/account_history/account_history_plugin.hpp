@@ -53,10 +53,13 @@ namespace graphene { namespace account_history {
 enum account_history_object_type
 {
    key_account_object_type = 0,
-   bucket_object_type = 1 ///< used in market_history_plugin
+   bucket_object_type = 1, ///< used in market_history_plugin
+   market_ticker_object_type = 2 ///< used in market_history_plugin
 };
 
 
+class account_history_store;
+
 namespace detail
 {
     class account_history_plugin_impl;
@@ -74,8 +77,11 @@ class account_history_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       flat_set<account_id_type> tracked_accounts()const;
+      /** the on-disk tier holding the history older than the in-memory window, null without history-memory-ops */
+      const account_history_store* history_store()const;
 
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <fstream>
+#include <map>
+#include <memory>
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+/**
+ *  @brief Append-only on-disk tier of the account history
+ *
+ *  The account history plugin moves irreversible operations here once they drop out of the in-memory window set by
+ *  history-memory-ops.  The store is split into segments of about segment_size index entries, each of them two
+ *  files: NNNNNNNN.ops holds the packed operation_history_objects back to back and NNNNNNNN.idx holds one fixed-size
+ *  index_entry per account and operation.  When a segment is full its index is sorted by account and sequence and
+ *  both files are memory mapped for reading.  The index of the segment being written is kept in memory, per account.
+ *
+ *  Operations are appended in id order and the sequence of an account grows with the operation id, so the entries of
+ *  one account are in operation id order as well, and each segment is newer than the ones before it.
+ *
+ *  Opened with open_in_memory() the store keeps no segment files: the packed operations go to an arena of large
+ *  chunks and the index stays in the active segment, which is never sealed.  The operations are decoded when they
+ *  are read.  The arena and the index are written to one file on close() and read back by the next
+ *  open_in_memory(), what was appended after the last close() is lost if the process does not get there.
+ */
+class account_history_store
+{
+   public:
+      struct index_entry
+      {
+         uint64_t account;
+         uint64_t operation;
+         uint64_t offset;
+         uint32_t sequence;
+         uint32_t size;
+      };
+
+      explicit account_history_store( uint32_t segment_size = 100000 );
+      ~account_history_store();
+
+      void open( const fc::path& dir );
+      /** opens the store in memory, loading what the last close() saved to file */
+      void open_in_memory( const fc::path& file );
+      void close();
+      bool is_open()const { return _in_memory || _dir != fc::path(); }
+      bool is_in_memory()const { return _in_memory; }
+
+      /** writes the operations appended so far through to the segment files */
+      void flush();
+
+      /**
+       *  Adds @ref op to the history of each of the accounts, at the given sequence.  Operations that are not newer
+       *  than last_operation() are ignored, so an operation brought back to memory by undoing a block can be moved
+       *  again.
+       */
+      void append( const operation_history_object& op, const vector< std::pair<account_id_type,uint32_t> >& accounts );
+
+      /** the newest operation in the store, or 0 when it is empty */
+      uint64_t last_operation()const { return _last_operation; }
+      uint64_t entry_count()const { return _entry_count; }
+      uint32_t segment_count()const { return _segments.size() + 1; }
+
+      /** the operations of @ref account with stop < id <= start, newest first */
+      vector<operation_history_object> get_account_history( account_id_type account, uint64_t start, uint64_t stop,
+                                                            uint32_t limit )const;
+      /** the operations of @ref account with stop < sequence <= start, newest first */
+      vector<operation_history_object> get_relative_account_history( account_id_type account, uint32_t start,
+                                                                     uint32_t stop, uint32_t limit )const;
+
+   private:
+      struct sealed_segment
+      {
+         boost::interprocess::file_mapping   ops_file;
+         boost::interprocess::mapped_region  ops;
+         boost::interprocess::file_mapping   idx_file;
+         boost::interprocess::mapped_region  idx;
+         /** the oldest operation in the segment, segments are in operation order */
+         uint64_t                            first_operation = 0;
+
+         const index_entry* begin()const { return static_cast<const index_entry*>( idx.get_address() ); }
+         const index_entry* end()const   { return begin() + idx.get_size() / sizeof(index_entry); }
+      };
+
+      fc::path segment_path( uint32_t segment, const char* extension )const;
+      void     open_active_segment();
+      void     seal_active_segment();
+      void     map_segment( uint32_t segment );
+
+      /** walks the segments that may hold operations up to newest_operation, newest first */
+      template< typename Key >
+      vector<operation_history_object> read_history( account_id_type account, uint64_t start, uint64_t stop,
+                                                     uint32_t limit, uint64_t newest_operation, Key key )const;
+      operation_history_object         read_operation( uint32_t segment, const index_entry& entry,
+                                                       std::ifstream& active_ops )const;
+
+      /** appends data to _arena and returns its offset, the chunk number in the upper half */
+      uint64_t write_to_arena( const vector<char>& data );
+      void     load_arena();
+      void     save_arena()const;
+
+      uint32_t                                         _segment_size;
+      fc::path                                         _dir;
+      bool                                             _in_memory = false;
+      fc::path                                         _arena_file;
+      /** the packed operations of an in-memory store, a chunk is never reallocated once it is filled */
+      vector< vector<char> >                           _arena;
+      vector< std::unique_ptr<sealed_segment> >        _segments;
+
+      /** the segment being written, numbered _segments.size() */
+      std::map< uint64_t, vector<index_entry> >        _active;
+      uint32_t                                         _active_entries = 0;
+      uint64_t                                         _active_ops_size = 0;
+      std::ofstream                                    _active_ops;
+      std::ofstream                                    _active_idx;
+
+      uint64_t                                         _last_operation = 0;
+      uint64_t                                         _entry_count = 0;
+};
+
+} } // graphene::account_history
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/change_stream/change_stream_plugin.hpp>
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <fstream>
+
+namespace graphene { namespace change_stream {
+
+namespace detail
+{
+
+using graphene::chain::signed_block;
+using graphene::db::object;
+using graphene::db::object_id_type;
+using graphene::db::undo_state;
+
+class change_stream_plugin_impl
+{
+   public:
+      change_stream_plugin_impl( change_stream_plugin& _plugin )
+      :_self( _plugin ) {}
+
+      /** writes the objects b created, modified and removed, called while b is the head block */
+      void on_applied_block( const signed_block& b );
+      /** writes the values the objects had before b, called before b is popped */
+      void on_popping_block( const signed_block& b );
+
+      void write_record( const signed_block& b, bool undo,
+                         vector<std::pair<object_id_type, const object*>>& upserts,
+                         vector<object_id_type>& removed );
+
+      change_stream_plugin&     _self;
+      fc::path                  _file;
+      uint32_t                  _flush_interval = 1;
+      uint32_t                  _unflushed = 0;
+      std::ofstream             _stream;
+      graphene::chain::scoped_observer_connection _applied_block_conn;
+      graphene::chain::scoped_observer_connection _popping_block_conn;
+};
+
+void change_stream_plugin_impl::on_applied_block( const signed_block& b )
+{
+   const graphene::chain::database& db = _self.database();
+   if( !db._undo_db.enabled() || db._undo_db.size() == 0 )
+      return;
+   const graphene::db::object_diff diff = db.undo_head_diff();
+
+   // an object of the diff without a value was removed by the block
+   vector<std::pair<object_id_type, const object*>> upserts;
+   vector<object_id_type> removed;
+   upserts.reserve( diff.objects.size() );
+   for( const auto& item : diff.objects )
+   {
+      if( item.second.empty() )
+         removed.push_back( item.first );
+      else
+         upserts.emplace_back( item.first, db.find_object( item.first ) );
+   }
+
+   write_record( b, false, upserts, removed );
+}
+
+void change_stream_plugin_impl::on_popping_block( const signed_block& b )
+{
+   const graphene::chain::database& db = _self.database();
+   if( !db._undo_db.enabled() || db._undo_db.size() == 0 )
+      return;
+   const undo_state& state = db._undo_db.head();
+
+   vector<std::pair<object_id_type, const object*>> upserts;
+   upserts.reserve( state.old_values.size() + state.removed.size() );
+   for( const auto& item : state.old_values )
+      upserts.emplace_back( item.first, item.second.get() );
+   for( const auto& item : state.removed )
+      upserts.emplace_back( item.first, item.second.get() );
+
+   vector<object_id_type> removed( state.new_ids.begin(), state.new_ids.end() );
+
+   write_record( b, true, upserts, removed );
+}
+
+void change_stream_plugin_impl::write_record( const signed_block& b, bool undo,
+                                              vector<std::pair<object_id_type, const object*>>& upserts,
+                                              vector<object_id_type>& removed )
+{
+   std::sort( upserts.begin(), upserts.end(),
+              []( const std::pair<object_id_type, const object*>& l, const std::pair<object_id_type, const object*>& r )
+              { return l.first < r.first; } );
+
+   fc::variants objects;
+   objects.reserve( upserts.size() );
+   for( const auto& item : upserts )
+   {
+      if( item.second != nullptr )
+         objects.emplace_back( item.second->to_variant() );
+      else
+         removed.push_back( item.first );
+   }
+   std::sort( removed.begin(), removed.end() );
+
+   fc::mutable_variant_object record;
+   record( "block_num", b.block_num() )
+         ( "block_id", b.id() );
+   if( undo )
+      record( "undo", true );
+   record( "objects", std::move( objects ) )
+         ( "removed", removed );
+   _stream << fc::json::to_string( fc::variant( std::move( record ) ) ) << '\n';
+
+   if( ++_unflushed >= _flush_interval )
+   {
+      _stream.flush();
+      _unflushed = 0;
+   }
+   FC_ASSERT( _stream.good(), "Unable to write the change stream to ${file}", ("file",_file) );
+}
+
+} // end namespace detail
+
+change_stream_plugin::change_stream_plugin() :
+   my( new detail::change_stream_plugin_impl(*this) )
+{
+}
+
+change_stream_plugin::~change_stream_plugin()
+{
+}
+
+void change_stream_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("change-stream-file", boost::program_options::value<std::string>(),
+           "Append the objects every block changes to this file, one JSON line per block; may be a named pipe")
+         ("change-stream-flush-interval", boost::program_options::value<uint32_t>()->default_value(1),
+           "Number of blocks written to the change stream between flushes")
+         ;
+   cfg.add(cli);
+}
+
+void change_stream_plugin::plugin_initialize( const boost::program_options::variables_map& options )
+{ try {
+   if( !options.count( "change-stream-file" ) )
+      return;
+   my->_file = options["change-stream-file"].as<std::string>();
+   my->_flush_interval = std::max<uint32_t>( options["change-stream-flush-interval"].as<uint32_t>(), 1 );
+   my->_stream.open( my->_file.generic_string(), std::ios::out | std::ios::app );
+   FC_ASSERT( my->_stream.is_open(), "Unable to open the change stream ${file}", ("file",my->_file) );
+
+   graphene::chain::database& db = database();
+   my->_applied_block_conn = db.applied_block.connect( [this]( const signed_block& b ){ my->on_applied_block( b ); }, "change_stream" );
+   my->_popping_block_conn = db.popping_block.connect( [this]( const signed_block& b ){ my->on_popping_block( b ); }, "change_stream" );
+} FC_LOG_AND_RETHROW() }
+
+void change_stream_plugin::plugin_startup()
+{
+}
+
+void change_stream_plugin::plugin_shutdown()
+{
+   my->_applied_block_conn.disconnect();
+   my->_popping_block_conn.disconnect();
+   if( my->_stream.is_open() )
+      my->_stream.close();
+}
+
+} }
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/plugin.hpp>
+
+namespace graphene { namespace change_stream {
+namespace detail { class change_stream_plugin_impl; }
+
+/**
+ *  Writes the objects every block changed to a file, one JSON line per block, so that an external store can follow
+ *  the chain state without polling the API.
+ *
+ *  A line holds the number and id of the block, the new value of every object the block created or modified and the
+ *  ids of the objects it removed, each list ordered by object id.  When a block is popped, e.g. to switch forks, a
+ *  line with "undo" set puts back the values the objects had before the block.  Changes are only recorded while the
+ *  undo database is enabled, so blocks applied during a replay are not streamed.
+ */
+class change_stream_plugin : public graphene::app::plugin
+{
+   public:
+      change_stream_plugin();
+      virtual ~change_stream_plugin();
+
+      std::string plugin_name()const override { return "change_stream"; }
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg ) override;
+      virtual void plugin_initialize( const boost::program_options::variables_map& options ) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+   private:
+      friend class detail::change_stream_plugin_impl;
+      std::unique_ptr<detail::change_stream_plugin_impl> my;
+};
+
+} } //graphene::change_stream
@@ -10,6 +10,7 @@
 #include <graphene/chain/witness_object.hpp>
 
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/utilities/trace.hpp>
 
 #include <graphene/debug_witness/debug_api.hpp>
 #include <graphene/debug_witness/debug_witness.hpp>
@@ -29,6 +30,10 @@ class debug_api_impl
       //void debug_save_db( std::string db_path );
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
+      fc::variant debug_get_operation_statistics();
+      void debug_set_operation_statistics( bool enabled );
+      fc::variant debug_get_block_timing_statistics();
+      fc::variant debug_get_index_statistics();
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
 
       graphene::app::application& app;
@@ -121,6 +126,26 @@ void debug_api_impl::debug_stream_json_objects_flush()
    get_plugin()->flush_json_object_stream();
 }
 
+fc::variant debug_api_impl::debug_get_operation_statistics()
+{
+   return fc::variant( app.chain_database()->get_operation_statistics() );
+}
+
+void debug_api_impl::debug_set_operation_statistics( bool enabled )
+{
+   app.chain_database()->set_operation_statistics( enabled );
+}
+
+fc::variant debug_api_impl::debug_get_block_timing_statistics()
+{
+   return fc::variant( app.chain_database()->get_block_timing_statistics() );
+}
+
+fc::variant debug_api_impl::debug_get_index_statistics()
+{
+   return fc::variant( app.chain_database()->get_index_statistics() );
+}
+
 } // detail
 
 debug_api::debug_api( graphene::app::application& app )
@@ -153,5 +178,36 @@ void debug_api::debug_stream_json_objects_flush()
    my->debug_stream_json_objects_flush();
 }
 
+fc::variant debug_api::debug_get_operation_statistics()
+{
+   return my->debug_get_operation_statistics();
+}
+
+void debug_api::debug_set_operation_statistics( bool enabled )
+{
+   my->debug_set_operation_statistics( enabled );
+}
+
+fc::variant debug_api::debug_get_block_timing_statistics()
+{
+   return my->debug_get_block_timing_statistics();
+}
+
+fc::variant debug_api::debug_get_index_statistics()
+{
+   return my->debug_get_index_statistics();
+}
+
+std::string debug_api::debug_get_trace()
+{
+   return graphene::utilities::tracer::chrome_trace();
+}
+
+void debug_api::debug_set_trace_sampling( uint32_t one_in )
+{
+   graphene::utilities::tracer::clear();
+   graphene::utilities::tracer::set_sampling( one_in );
+}
+
 
 } } // graphene::debug_witness
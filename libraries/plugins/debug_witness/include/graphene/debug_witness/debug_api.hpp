@@ -82,6 +82,38 @@ class debug_api
        */
       void debug_stream_json_objects_flush();
 
+      /**
+       * Cost of the operations applied by type since the operation statistics were enabled.
+       */
+      fc::variant debug_get_operation_statistics();
+
+      /**
+       * Enable (and start over) or disable the operation statistics, see the operation-statistics option.
+       */
+      void debug_set_operation_statistics( bool enabled );
+
+      /**
+       * Histograms of the time spent in each phase of pushing a block, and the phases of the last slow block.
+       */
+      fc::variant debug_get_block_timing_statistics();
+
+      /**
+       * Object count, estimated memory, creates, modifies and removes and undo memory of every index.  This walks
+       * all objects.
+       */
+      fc::variant debug_get_index_statistics();
+
+      /**
+       * The spans recorded by the tracer, in Chrome trace event JSON.  Load it in chrome://tracing or Perfetto.
+       * Spans are only recorded when trace-sample-rate is nonzero or after debug_set_trace_sampling.
+       */
+      std::string debug_get_trace();
+
+      /**
+       * Trace one in every one_in root spans, or stop tracing when one_in is 0.  Clears the recorded spans.
+       */
+      void debug_set_trace_sampling( uint32_t one_in );
+
       std::shared_ptr< detail::debug_api_impl > my;
 };
 
@@ -93,4 +125,10 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_update_object)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
+       (debug_get_operation_statistics)
+       (debug_set_operation_statistics)
+       (debug_get_block_timing_statistics)
+       (debug_get_index_statistics)
+       (debug_get_trace)
+       (debug_set_trace_sampling)
      )
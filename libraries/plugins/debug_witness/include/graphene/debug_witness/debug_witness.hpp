@@ -59,9 +59,9 @@ private:
    std::map<chain::public_key_type, fc::ecc::private_key> _private_keys;
 
    std::shared_ptr< std::ofstream > _json_object_stream;
-   boost::signals2::scoped_connection _applied_block_conn;
-   boost::signals2::scoped_connection _changed_objects_conn;
-   boost::signals2::scoped_connection _removed_objects_conn;
+   graphene::chain::scoped_observer_connection _applied_block_conn;
+   graphene::chain::scoped_observer_connection _changed_objects_conn;
+   graphene::chain::scoped_observer_connection _removed_objects_conn;
 };
 
 } } //graphene::debug_witness_plugin
@@ -32,11 +32,18 @@
 #include <fc/api.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <deque>
+
 
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
 
 namespace detail {
+/// Number of blocks asked for in one get_packed_blocks call, the most the API hands out at once
+static const uint32_t blocks_per_request = 100;
+/// Number of get_packed_blocks calls kept waiting for an answer while syncing
+static const size_t max_outstanding_block_requests = 4;
+
 struct delayed_node_plugin_impl {
    std::string remote_endpoint;
    fc::http::websocket_client client;
@@ -45,6 +52,8 @@ struct delayed_node_plugin_impl {
    boost::signals2::scoped_connection client_connection_closed;
    graphene::chain::block_id_type last_received_remote_head;
    graphene::chain::block_id_type last_processed_remote_head;
+   /// apply the object changes the trusted node recorded instead of evaluating the blocks
+   bool replicate_state = false;
 };
 }
 
@@ -59,6 +68,8 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
 {
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>()->required(), "RPC endpoint of a trusted validating node (required)")
+         ("replicate-state", "Copy the object changes of every block from the trusted node, which must run with "
+                             "state-diff-history and the same plugins, instead of evaluating the blocks")
          ;
    cfg.add(cli);
 }
@@ -75,6 +86,7 @@ void delayed_node_plugin::connect()
 void delayed_node_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   my->replicate_state = options.count("replicate-state") > 0;
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -98,17 +110,92 @@ void delayed_node_plugin::sync_with_trusted_node()
          break;
       }
       pass_count++;
+
+      // Keep several batches in flight, so the next blocks are on their way while the current batch is applied.
+      // The blocks are irreversible on the trusted node, which already checked what is skipped here.
+      const uint32_t skip = graphene::chain::database::skip_witness_signature |
+                            graphene::chain::database::skip_transaction_signatures |
+                            graphene::chain::database::skip_tapos_check |
+                            graphene::chain::database::skip_witness_schedule_check |
+                            graphene::chain::database::skip_authority_check;
+      if( my->replicate_state )
+      {
+         synced_blocks += copy_state_from_trusted_node( remote_dpo.last_irreversible_block_num );
+         continue;
+      }
+
+      std::deque< fc::future< std::vector< fc::optional< std::vector<char> > > > > requests;
+      uint32_t next_block_num = db.head_block_num() + 1;
       while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
       {
-         fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
-         FC_ASSERT(block, "Trusted node claims it has blocks it doesn't actually have.");
-         ilog("Pushing block #${n}", ("n", block->block_num()));
-         db.push_block(*block);
-         synced_blocks++;
+         while( requests.size() < detail::max_outstanding_block_requests &&
+                next_block_num <= remote_dpo.last_irreversible_block_num )
+         {
+            uint32_t count = std::min( detail::blocks_per_request, remote_dpo.last_irreversible_block_num - next_block_num + 1 );
+            requests.push_back( fc::async( [this, next_block_num, count]() {
+               return my->database_api->get_packed_blocks( next_block_num, count );
+            }, "delayed_node fetch blocks" ) );
+            next_block_num += count;
+         }
+
+         auto blocks = requests.front().wait();
+         requests.pop_front();
+         ilog( "Pushing ${n} blocks after #${h}", ("n", blocks.size())("h", db.head_block_num()) );
+         for( const auto& packed : blocks )
+         {
+            FC_ASSERT( packed, "Trusted node claims it has blocks it doesn't actually have." );
+            graphene::chain::signed_block block = fc::raw::unpack<graphene::chain::signed_block>( *packed );
+            FC_ASSERT( block.block_num() == db.head_block_num() + 1, "Trusted node sent an unexpected block",
+                       ("expected", db.head_block_num() + 1)("received", block.block_num()) );
+            // push_block() would take a block of another fork as a fork switch
+            FC_ASSERT( block.previous == db.head_block_id(), "Trusted node sent a block that does not build on our head",
+                       ("head", db.head_block_id())("previous", block.previous) );
+            db.push_block( block, skip );
+            synced_blocks++;
+         }
       }
    }
 }
 
+uint32_t delayed_node_plugin::copy_state_from_trusted_node( uint32_t last_block_num )
+{
+   auto& db = database();
+   uint32_t copied_blocks = 0;
+   // (number of diffs asked for, the answer)
+   std::deque< std::pair< uint32_t, fc::future< std::vector< std::vector<char> > > > > requests;
+   uint32_t next_block_num = db.head_block_num() + 1;
+   while( last_block_num > db.head_block_num() )
+   {
+      while( requests.size() < detail::max_outstanding_block_requests && next_block_num <= last_block_num )
+      {
+         uint32_t count = std::min( detail::blocks_per_request, last_block_num - next_block_num + 1 );
+         requests.emplace_back( count, fc::async( [this, next_block_num, count]() {
+            return my->database_api->get_packed_state_diffs( next_block_num, count );
+         }, "delayed_node fetch state diffs" ) );
+         next_block_num += count;
+      }
+
+      const uint32_t requested = requests.front().first;
+      auto diffs = requests.front().second.wait();
+      requests.pop_front();
+      FC_ASSERT( !diffs.empty(), "Trusted node no longer holds the state diff of block ${n}, it needs a larger "
+                 "state-diff-history or this node a new snapshot", ("n", db.head_block_num() + 1) );
+      ilog( "Copying the state of ${n} blocks after #${h}", ("n", diffs.size())("h", db.head_block_num()) );
+      for( const auto& packed : diffs )
+      {
+         auto diff = fc::raw::unpack<graphene::chain::block_state_diff>( packed );
+         FC_ASSERT( diff.block.block_num() == db.head_block_num() + 1, "Trusted node sent an unexpected state diff",
+                    ("expected", db.head_block_num() + 1)("received", diff.block.block_num()) );
+         db.apply_state_diff( diff );
+         copied_blocks++;
+      }
+      // the later answers start past a gap, the caller asks again from the new head
+      if( diffs.size() < requested )
+         break;
+   }
+   return copied_blocks;
+}
+
 void delayed_node_plugin::mainloop()
 {
    while( true )
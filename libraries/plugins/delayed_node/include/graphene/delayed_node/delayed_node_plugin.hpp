@@ -46,6 +46,8 @@ protected:
    void connection_failed();
    void connect();
    void sync_with_trusted_node();
+   /** @return the number of blocks whose state diffs were applied to reach last_block_num */
+   uint32_t copy_state_from_trusted_node( uint32_t last_block_num );
 };
 
 } } //graphene::account_history
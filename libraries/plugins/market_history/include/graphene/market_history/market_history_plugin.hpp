@@ -28,6 +28,11 @@
 
 #include <fc/thread/future.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+
+#include <functional>
+#include <mutex>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -87,6 +92,50 @@ struct bucket_object : public abstract_object<bucket_object>
    share_type          quote_volume;
 };
 
+/** folds the trades of @ref newer, a bucket of the same market that opened later, into @ref into */
+inline void merge_bucket( bucket_object& into, const bucket_object& newer )
+{
+   if( into.high() < newer.high() )
+   {
+      into.high_base = newer.high_base;
+      into.high_quote = newer.high_quote;
+   }
+   if( into.low() > newer.low() )
+   {
+      into.low_base = newer.low_base;
+      into.low_quote = newer.low_quote;
+   }
+   into.close_base = newer.close_base;
+   into.close_quote = newer.close_quote;
+   into.base_volume += newer.base_volume;
+   into.quote_volume += newer.quote_volume;
+}
+
+/** adds a trade at @ref trade_price to @ref b, which it opens while @ref b holds no trades yet */
+inline void add_trade( bucket_object& b, const price& trade_price )
+{
+   const bool opening = b.base_volume == 0;
+   b.base_volume += trade_price.base.amount;
+   b.quote_volume += trade_price.quote.amount;
+   b.close_base = trade_price.base.amount;
+   b.close_quote = trade_price.quote.amount;
+   if( opening )
+   {
+      b.open_base = b.close_base;
+      b.open_quote = b.close_quote;
+   }
+   if( opening || b.high() < trade_price )
+   {
+      b.high_base = b.close_base;
+      b.high_quote = b.close_quote;
+   }
+   if( opening || b.low() > trade_price )
+   {
+      b.low_base = b.close_base;
+      b.low_quote = b.close_quote;
+   }
+}
+
 struct history_key {
   asset_id_type        base;
   asset_id_type        quote;
@@ -104,9 +153,73 @@ struct order_history_object : public abstract_object<order_history_object>
   history_key          key; 
   fc::time_point_sec   time;
   fill_order_operation op;
+
+  asset_id_type base()const     { return key.base; }
+  asset_id_type quote()const    { return key.quote; }
+  int64_t       sequence()const { return key.sequence; }
+  /** each trade is recorded as the fills of both of its sides, this is true for the one paying the base */
+  bool          pays_base()const { return op.pays.asset_id == key.base; }
+};
+
+/** the trades of one market during one slot of the 24 hour ticker window */
+struct ticker_slot
+{
+   uint32_t            period = 0; ///< the slot start divided by market_ticker_object::slot_seconds
+   share_type          base_volume;
+   share_type          quote_volume;
+   share_type          close_base;
+   share_type          close_quote;
+};
+
+/**
+ *  The rolling 24 hour trade volume and latest price of a market, kept up to date on each fill so that get_ticker
+ *  and get_24_volume need not page through the fill history.  The window advances in slots of slot_seconds, and
+ *  only slots that had trades are kept, oldest first.  Amounts are in the assets of base and quote, base < quote.
+ */
+struct market_ticker_object : public abstract_object<market_ticker_object>
+{
+   static const uint8_t space_id = ACCOUNT_HISTORY_SPACE_ID;
+   static const uint8_t type_id  = 2; // market_history_plugin type, referenced from account_history_plugin.hpp
+
+   static const uint32_t window_seconds = 86400;
+   static const uint32_t slot_seconds   = 900;
+
+   asset_id_type       base;
+   asset_id_type       quote;
+   share_type          last_base;
+   share_type          last_quote;
+   /** the latest price before the window, it is what percent_change compares last to */
+   share_type          prior_base;
+   share_type          prior_quote;
+   /** the totals of slots */
+   share_type          base_volume;
+   share_type          quote_volume;
+   vector<ticker_slot> slots;
+
+   /** whether @ref slot is out of the window at @ref now */
+   static bool expired( const ticker_slot& slot, fc::time_point_sec now )
+   {
+      return uint64_t( slot.period + 1 ) * slot_seconds + window_seconds <= now.sec_since_epoch();
+   }
+
+   /** drops the slots that are out of the window at @ref now */
+   void advance( fc::time_point_sec now )
+   {
+      auto itr = slots.begin();
+      for( ; itr != slots.end() && expired( *itr, now ); ++itr )
+      {
+         base_volume -= itr->base_volume;
+         quote_volume -= itr->quote_volume;
+         prior_base = itr->close_base;
+         prior_quote = itr->close_quote;
+      }
+      slots.erase( slots.begin(), itr );
+   }
 };
 
 struct by_key;
+struct by_market;
+struct by_market_time;
 typedef multi_index_container<
    bucket_object,
    indexed_by<
@@ -119,12 +232,44 @@ typedef multi_index_container<
    order_history_object,
    indexed_by<
       hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-      ordered_unique< tag<by_key>, member< order_history_object, history_key, &order_history_object::key > >
+      ordered_unique< tag<by_key>, member< order_history_object, history_key, &order_history_object::key > >,
+      /** one side of each trade of a market, newest first */
+      ordered_unique< tag<by_market_time>,
+         composite_key< order_history_object,
+            const_mem_fun< order_history_object, asset_id_type, &order_history_object::base >,
+            const_mem_fun< order_history_object, asset_id_type, &order_history_object::quote >,
+            const_mem_fun< order_history_object, bool, &order_history_object::pays_base >,
+            member< order_history_object, fc::time_point_sec, &order_history_object::time >,
+            const_mem_fun< order_history_object, int64_t, &order_history_object::sequence >
+         >,
+         composite_key_compare<
+            std::less< asset_id_type >,
+            std::less< asset_id_type >,
+            std::less< bool >,
+            std::greater< fc::time_point_sec >,
+            std::less< int64_t >
+         >
+      >
    >
 > order_history_multi_index_type;
 
 
+typedef multi_index_container<
+   market_ticker_object,
+   indexed_by<
+      hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_market>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::base >,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::quote >
+         >
+      >
+   >
+> market_ticker_multi_index_type;
+
+
 typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
+typedef generic_index<market_ticker_object, market_ticker_multi_index_type> market_ticker_index;
 typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
 
 
@@ -151,9 +296,24 @@ class market_history_plugin : public graphene::app::plugin
       virtual void plugin_initialize(
          const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       uint32_t                    max_history()const;
       const flat_set<uint32_t>&   tracked_buckets()const;
+      uint32_t                    fill_history_horizon()const;
+      /** the number of fills kept for each market, 0 for no limit */
+      uint32_t                    fill_history_size()const;
+      /**
+       * The smallest tracked size if @ref bucket_seconds is rolled up from it, or 0.  A rolled up bucket does not
+       * include the trades of the newest bucket of the smallest size yet, readers fold it in with merge_bucket().
+       */
+      uint32_t                    rollup_source( uint32_t bucket_seconds )const;
+
+      /**
+       * Calls @ref reader with the object database that holds the bucket and history indexes, which is the chain
+       * database or, with market-history-async, the store of the plugin, while the plugin does not write to it.
+       */
+      void read_history( const std::function<void(const graphene::db::object_database&)>& reader )const;
 
    private:
       friend class detail::market_history_plugin_impl;
@@ -165,6 +325,9 @@ class market_history_plugin : public graphene::app::plugin
 FC_REFLECT( graphene::market_history::history_key, (base)(quote)(sequence) )
 FC_REFLECT_DERIVED( graphene::market_history::order_history_object, (graphene::db::object), (key)(time)(op) )
 FC_REFLECT( graphene::market_history::bucket_key, (base)(quote)(seconds)(open) )
+FC_REFLECT( graphene::market_history::ticker_slot, (period)(base_volume)(quote_volume)(close_base)(close_quote) )
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::db::object),
+                    (base)(quote)(last_base)(last_quote)(prior_base)(prior_quote)(base_volume)(quote_volume)(slots) )
 FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::object), 
                     (key)
                     (high_base)(high_quote)
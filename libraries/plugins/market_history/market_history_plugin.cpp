@@ -33,6 +33,10 @@
 #include <graphene/chain/transaction_evaluation_state.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/app/applied_block_queue.hpp>
+#include <graphene/app/applied_operation_log.hpp>
+
+#include <fc/io/json.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/smart_ref_impl.hpp>
 
@@ -52,6 +56,16 @@ class market_history_plugin_impl
        * and will process/index all operations that were applied in the block.
        */
       void update_market_histories( const signed_block& b );
+      /** the same for an irreversible block handed to the worker thread by market-history-async */
+      void update_stored_market_histories( const graphene::app::applied_block_queue::applied_block_data& data );
+      /** brings the store up to the last irreversible block from the applied operations log, as far as it goes */
+      void rebuild_store( const graphene::app::applied_operation_log& log );
+      void update_market_histories( graphene::db::object_database& db, const signed_block& b,
+                                    const vector< optional< operation_history_object > >& hist );
+
+      void open_store();
+      void close_store();
+      fc::path store_block_num_path()const { return _store_dir / "last_block_num.json"; }
 
       graphene::chain::database& database()
       {
@@ -61,16 +75,34 @@ class market_history_plugin_impl
       market_history_plugin&     _self;
       flat_set<uint32_t>         _tracked_buckets;
       uint32_t                   _maximum_history_per_bucket_size = 1000;
+      /** fills older than this many seconds are dropped, 0 keeps them by count only */
+      uint32_t                   _fill_history_horizon = 0;
+      /** the newest fills kept of each market, 0 keeps them by age only */
+      uint32_t                   _fill_history_size = 200;
+      /** for each tracked size that is rolled up, the smallest size it is rolled up from */
+      flat_map<uint32_t,uint32_t> _rollup_sources;
+
+      /** with market-history-async the history is kept in _store, which the worker of _queue writes to */
+      std::unique_ptr<graphene::db::object_database>       _store;
+      std::unique_ptr<graphene::app::applied_block_queue>  _queue;
+      fc::path                                             _store_dir;
+      /** the last block in _store, earlier blocks replayed by the chain are skipped */
+      uint32_t                                             _store_block_num = 0;
+      mutable std::mutex                                   _store_mutex;
 };
 
 
 struct operation_process_fill_order
 {
-   market_history_plugin&    _plugin;
-   fc::time_point_sec        _now;
+   market_history_plugin&       _plugin;
+   graphene::db::object_database& _db;
+   fc::time_point_sec           _now;
+   /** the trades of the block by the bucket they go to, written by update_buckets() once the block is visited */
+   std::map<bucket_key, bucket_object>& _pending;
 
-   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n )
-   :_plugin(mhp),_now(n) {}
+   operation_process_fill_order( market_history_plugin& mhp, graphene::db::object_database& db, fc::time_point_sec n,
+                                 std::map<bucket_key, bucket_object>& pending )
+   :_plugin(mhp),_db(db),_now(n),_pending(pending) {}
 
    typedef void result_type;
 
@@ -82,11 +114,10 @@ struct operation_process_fill_order
    {
       //ilog( "processing ${o}", ("o",o) );
       const auto& buckets = _plugin.tracked_buckets();
-      auto& db         = _plugin.database();
-      const auto& bucket_idx = db.get_index_type<bucket_index>();
+      auto& db         = _db;
       const auto& history_idx = db.get_index_type<history_index>().indices().get<by_key>();
 
-      auto time = db.head_block_time();
+      auto time = _now;
 
       history_key hkey;
       hkey.base = o.pays.asset_id;
@@ -97,7 +128,7 @@ struct operation_process_fill_order
 
       auto itr = history_idx.lower_bound( hkey );
 
-      if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
+      if( itr != history_idx.end() && itr->key.base == hkey.base && itr->key.quote == hkey.quote )
          hkey.sequence = itr->key.sequence - 1;
       else
          hkey.sequence = 0;
@@ -108,104 +139,188 @@ struct operation_process_fill_order
          ho.op = o;
       });
 
-      hkey.sequence += 200;
-      itr = history_idx.lower_bound( hkey );
+      if( _plugin.fill_history_size() != 0 )
+      {
+         history_key oldest = hkey;
+         oldest.sequence += _plugin.fill_history_size();
+         itr = history_idx.lower_bound( oldest );
 
-      while( itr != history_idx.end() )
+         while( itr != history_idx.end() )
+         {
+            if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
+            {
+               db.remove( *itr );
+               itr = history_idx.lower_bound( oldest );
+            }
+            else break;
+         }
+      }
+
+      // the newest fills have the lowest sequence, so the ones past the horizon are at the end of the market
+      if( _plugin.fill_history_horizon() != 0 )
       {
-         if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
+         const fc::time_point_sec horizon = _now - _plugin.fill_history_horizon();
+         hkey.sequence = std::numeric_limits<int64_t>::max();
+         while( true )
          {
+            itr = history_idx.upper_bound( hkey );
+            if( itr == history_idx.begin() )
+               break;
+            --itr;
+            if( itr->key.base != hkey.base || itr->key.quote != hkey.quote || itr->time >= horizon )
+               break;
             db.remove( *itr );
-            itr = history_idx.lower_bound( hkey );
          }
-         else break;
       }
 
+      /** for every matched order there are two fill order operations created, one for
+       * each side.  We can filter the duplicates by only considering the fill operations where
+       * the base > quote
+       */
+      if( o.pays.asset_id > o.receives.asset_id )
+         return;
 
-      auto max_history = _plugin.max_history();
+      price trade_price = o.pays / o.receives;
+      update_ticker( trade_price );
       for( auto bucket : buckets )
       {
-          auto cutoff      = (fc::time_point() + fc::seconds( bucket * max_history));
+          // rolled up sizes are only updated when a bucket of the smallest size closes
+          if( _plugin.rollup_source( bucket ) != 0 )
+             continue;
 
-          bucket_key key;
-          key.base    = o.pays.asset_id;
-          key.quote   = o.receives.asset_id;
+          bucket_key key( o.pays.asset_id, o.receives.asset_id, bucket,
+                          fc::time_point() + fc::seconds((_now.sec_since_epoch() / bucket) * bucket) );
+          bucket_object& pending = _pending[key];
+          pending.key = key;
+          add_trade( pending, trade_price );
+      }
+   }
 
+   /** writes the trades of the block to their buckets, which are modified once per block rather than per fill */
+   void update_buckets()const
+   {
+      const auto& buckets = _plugin.tracked_buckets();
+      for( const auto& pending : _pending )
+      {
+         if( add_trades( pending.second ) && pending.first.seconds == *buckets.begin() )
+            roll_up_previous( pending.first );
+         remove_old_buckets( pending.first );
+      }
+   }
 
-          /** for every matched order there are two fill order operations created, one for
-           * each side.  We can filter the duplicates by only considering the fill operations where
-           * the base > quote
-           */
-          if( key.base > key.quote ) 
-          {
-             //ilog( "     skipping because base > quote" );
-             continue;
-          }
-
-          price trade_price = o.pays / o.receives;
-
-          key.seconds = bucket;
-          key.open    = fc::time_point() + fc::seconds((_now.sec_since_epoch() / key.seconds) * key.seconds);
-
-          const auto& by_key_idx = bucket_idx.indices().get<by_key>();
-          auto itr = by_key_idx.find( key );
-          if( itr == by_key_idx.end() )
-          { // create new bucket
-            /* const auto& obj = */
-            db.create<bucket_object>( [&]( bucket_object& b ){
-                 b.key = key;
-                 b.quote_volume += trade_price.quote.amount;
-                 b.base_volume += trade_price.base.amount;
-                 b.open_base = trade_price.base.amount;
-                 b.open_quote = trade_price.quote.amount;
-                 b.close_base = trade_price.base.amount;
-                 b.close_quote = trade_price.quote.amount;
-                 b.high_base = b.close_base;
-                 b.high_quote = b.close_quote;
-                 b.low_base = b.close_base;
-                 b.low_quote = b.close_quote;
-            });
-            //wlog( "    creating bucket ${b}", ("b",obj) );
-          }
-          else
-          { // update existing bucket
-             //wlog( "    before updating bucket ${b}", ("b",*itr) );
-             db.modify( *itr, [&]( bucket_object& b ){
-                  b.base_volume += trade_price.base.amount;
-                  b.quote_volume += trade_price.quote.amount;
-                  b.close_base = trade_price.base.amount;
-                  b.close_quote = trade_price.quote.amount;
-                  if( b.high() < trade_price ) 
-                  {
-                      b.high_base = b.close_base;
-                      b.high_quote = b.close_quote;
-                  }
-                  if( b.low() > trade_price ) 
-                  {
-                      b.low_base = b.close_base;
-                      b.low_quote = b.close_quote;
-                  }
-             });
-             //wlog( "    after bucket bucket ${b}", ("b",*itr) );
-          }
-
-          if( max_history != 0  )
-          {
-             key.open = fc::time_point_sec();
-             auto itr = by_key_idx.lower_bound( key );
-
-             while( itr != by_key_idx.end() && 
-                    itr->key.base == key.base && 
-                    itr->key.quote == key.quote && 
-                    itr->key.seconds == bucket && 
-                    itr->key.open < cutoff )
-             {
-              //  elog( "    removing old bucket ${b}", ("b", *itr) );
-                auto old_itr = itr;
-                ++itr;
-                db.remove( *old_itr );
-             }
-          }
+   void update_ticker( const price& trade_price )const
+   {
+      const auto& by_market_idx = _db.get_index_type<market_ticker_index>().indices().get<by_market>();
+      auto itr = by_market_idx.find( boost::make_tuple( trade_price.base.asset_id, trade_price.quote.asset_id ) );
+      const uint32_t period = _now.sec_since_epoch() / market_ticker_object::slot_seconds;
+      auto add_trade = [&]( market_ticker_object& t ) {
+         t.advance( _now );
+         if( t.slots.empty() || t.slots.back().period != period )
+         {
+            t.slots.emplace_back();
+            t.slots.back().period = period;
+         }
+         ticker_slot& slot = t.slots.back();
+         slot.base_volume += trade_price.base.amount;
+         slot.quote_volume += trade_price.quote.amount;
+         slot.close_base = trade_price.base.amount;
+         slot.close_quote = trade_price.quote.amount;
+         t.base_volume += trade_price.base.amount;
+         t.quote_volume += trade_price.quote.amount;
+         t.last_base = trade_price.base.amount;
+         t.last_quote = trade_price.quote.amount;
+      };
+
+      if( itr == by_market_idx.end() )
+         _db.create<market_ticker_object>( [&]( market_ticker_object& t ) {
+            t.base = trade_price.base.asset_id;
+            t.quote = trade_price.quote.asset_id;
+            add_trade( t );
+         });
+      else
+         _db.modify( *itr, add_trade );
+   }
+
+   /** adds the trades of @ref trades to the bucket at its key, returns true if this opened the bucket */
+   bool add_trades( const bucket_object& trades )const
+   {
+      const auto& by_key_idx = _db.get_index_type<bucket_index>().indices().get<by_key>();
+      auto itr = by_key_idx.find( trades.key );
+      if( itr == by_key_idx.end() )
+      {
+         create_bucket( trades.key, trades );
+         return true;
+      }
+      _db.modify( *itr, [&]( bucket_object& b ){ merge_bucket( b, trades ); } );
+      return false;
+   }
+
+   /** creates the bucket at @ref key holding the trades of @ref trades */
+   void create_bucket( const bucket_key& key, const bucket_object& trades )const
+   {
+      _db.create<bucket_object>( [&]( bucket_object& b ){
+           b.key = key;
+           b.open_base = trades.open_base;
+           b.open_quote = trades.open_quote;
+           b.close_base = trades.close_base;
+           b.close_quote = trades.close_quote;
+           b.high_base = trades.high_base;
+           b.high_quote = trades.high_quote;
+           b.low_base = trades.low_base;
+           b.low_quote = trades.low_quote;
+           b.base_volume = trades.base_volume;
+           b.quote_volume = trades.quote_volume;
+      });
+   }
+
+   /** folds the smallest bucket before the one just opened at @ref key into the sizes rolled up from it */
+   void roll_up_previous( const bucket_key& key )const
+   {
+      const auto& by_key_idx = _db.get_index_type<bucket_index>().indices().get<by_key>();
+      auto itr = by_key_idx.find( key );
+      if( itr == by_key_idx.begin() )
+         return;
+      --itr;
+      if( itr->key.base != key.base || itr->key.quote != key.quote || itr->key.seconds != key.seconds )
+         return;
+      const bucket_object& closed = *itr;
+
+      for( auto bucket : _plugin.tracked_buckets() )
+      {
+         if( _plugin.rollup_source( bucket ) != key.seconds )
+            continue;
+         bucket_key rolled( key.base, key.quote, bucket,
+                            fc::time_point() + fc::seconds((closed.key.open.sec_since_epoch() / bucket) * bucket) );
+         auto rolled_itr = by_key_idx.find( rolled );
+         if( rolled_itr == by_key_idx.end() )
+            create_bucket( rolled, closed );
+         else
+            _db.modify( *rolled_itr, [&]( bucket_object& b ){ merge_bucket( b, closed ); } );
+         remove_old_buckets( rolled );
+      }
+   }
+
+   /** keeps the newest max_history buckets of the market and size of @ref key */
+   void remove_old_buckets( bucket_key key )const
+   {
+      const auto max_history = _plugin.max_history();
+      if( max_history == 0 || key.open.sec_since_epoch() < uint64_t( key.seconds ) * max_history )
+         return;
+      const fc::time_point_sec cutoff = key.open - key.seconds * max_history;
+
+      const auto& by_key_idx = _db.get_index_type<bucket_index>().indices().get<by_key>();
+      key.open = fc::time_point_sec();
+      auto itr = by_key_idx.lower_bound( key );
+      while( itr != by_key_idx.end() && 
+             itr->key.base == key.base && 
+             itr->key.quote == key.quote && 
+             itr->key.seconds == key.seconds && 
+             itr->key.open < cutoff )
+      {
+       //  elog( "    removing old bucket ${b}", ("b", *itr) );
+         auto old_itr = itr;
+         ++itr;
+         _db.remove( *old_itr );
       }
    }
 };
@@ -214,17 +329,81 @@ market_history_plugin_impl::~market_history_plugin_impl()
 {}
 
 void market_history_plugin_impl::update_market_histories( const signed_block& b )
+{
+   graphene::chain::database& db = database();
+   update_market_histories( db, b, db.get_applied_operations() );
+}
+
+void market_history_plugin_impl::update_stored_market_histories(
+   const graphene::app::applied_block_queue::applied_block_data& data )
+{
+   std::lock_guard<std::mutex> lock( _store_mutex );
+   if( data.block.block_num() <= _store_block_num )
+      return;
+   update_market_histories( *_store, data.block, data.operations );
+   _store_block_num = data.block.block_num();
+}
+
+void market_history_plugin_impl::rebuild_store( const graphene::app::applied_operation_log& log )
+{
+   graphene::chain::database& db = database();
+   const uint32_t last = std::min( log.last_block_num(),
+                                   db.get_dynamic_global_properties().last_irreversible_block_num );
+   std::lock_guard<std::mutex> lock( _store_mutex );
+   if( _store_block_num >= last )
+      return;
+
+   ilog( "Rebuilding the market history from block ${from} to ${to} from the applied operations log",
+         ("from",_store_block_num + 1)("to",last) );
+   for( uint32_t block_num = _store_block_num + 1; block_num <= last; ++block_num )
+   {
+      const auto operations = log.fetch( block_num );
+      const auto block = db.fetch_block_by_number( block_num );
+      if( !operations.valid() || !block.valid() )
+      {
+         wlog( "Block ${n} is missing from the applied operations log or the block log, the market history stays "
+               "at block ${s}", ("n",block_num)("s",_store_block_num) );
+         return;
+      }
+      update_market_histories( *_store, *block, *operations );
+      _store_block_num = block_num;
+   }
+}
+
+void market_history_plugin_impl::update_market_histories( graphene::db::object_database& db, const signed_block& b,
+                                                          const vector< optional< operation_history_object > >& hist )
 {
    if( _maximum_history_per_bucket_size == 0 ) return;
    if( _tracked_buckets.size() == 0 ) return;
 
-   graphene::chain::database& db = database();
-   const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
+   std::map<bucket_key, bucket_object> pending_buckets;
+   operation_process_fill_order process( _self, db, b.timestamp, pending_buckets );
    for( const optional< operation_history_object >& o_op : hist )
    {
       if( o_op.valid() )
-         o_op->op.visit( operation_process_fill_order( _self, b.timestamp ) );
+         o_op->op.visit( process );
    }
+   process.update_buckets();
+}
+
+void market_history_plugin_impl::open_store()
+{
+   _store_dir = _self.app().data_dir() / "market_history";
+   _store.reset( new graphene::db::object_database );
+   _store->add_index< primary_index< bucket_index  > >();
+   _store->add_index< primary_index< history_index  > >();
+   _store->add_index< primary_index< market_ticker_index > >();
+   _store->open( _store_dir );
+   if( fc::exists( store_block_num_path() ) )
+      _store_block_num = fc::json::from_file( store_block_num_path() ).as<uint32_t>();
+}
+
+void market_history_plugin_impl::close_store()
+{
+   _queue->flush();
+   std::lock_guard<std::mutex> lock( _store_mutex );
+   _store->flush();
+   fc::json::save_to_file( _store_block_num, store_block_num_path() );
 }
 
 } // end namespace detail
@@ -258,15 +437,41 @@ void market_history_plugin::plugin_set_program_options(
            "Track market history by grouping orders into buckets of equal size measured in seconds specified as a JSON array of numbers")
          ("history-per-size", boost::program_options::value<uint32_t>()->default_value(1000), 
            "How far back in time to track history for each bucket size, measured in the number of buckets (default: 1000)")
+         ("market-history-rollup", boost::program_options::value<bool>()->default_value(true),
+           "Only update the smallest bucket size on each fill and roll it up into the larger sizes that are "
+           "multiples of it when it closes")
+         ("fill-history-horizon", boost::program_options::value<uint32_t>()->default_value(0),
+           "Drop fills older than this many seconds from the fill order history (0 keeps them by count only)")
+         ("fill-history-size", boost::program_options::value<uint32_t>()->default_value(200),
+           "Number of the newest fills kept in the fill order history of each market, both sides of a trade count, "
+           "0 keeps them by fill-history-horizon only")
+         ("market-history-async", boost::program_options::bool_switch()->default_value(false),
+           "Track market history on a worker thread in a separate store, as blocks become irreversible")
+         ("market-history-queue-size", boost::program_options::value<uint32_t>()->default_value(100),
+           "With market-history-async, the number of irreversible blocks that may wait for the worker thread before "
+           "applying blocks waits for it")
          ;
    cfg.add(cli);
 }
 
 void market_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
-   database().applied_block.connect( [&]( const signed_block& b){ my->update_market_histories(b); } );
-   database().add_index< primary_index< bucket_index  > >();
-   database().add_index< primary_index< history_index  > >();
+   if( options.count( "market-history-async" ) && options["market-history-async"].as<bool>() )
+   {
+      my->open_store();
+      my->_queue.reset( new graphene::app::applied_block_queue( "market_history",
+         [this]( const graphene::app::applied_block_queue::applied_block_data& data ) {
+            my->update_stored_market_histories( data );
+         }, options["market-history-queue-size"].as<uint32_t>() ) );
+      my->_queue->connect( database() );
+   }
+   else
+   {
+      database().applied_block.connect( [&]( const signed_block& b){ my->update_market_histories(b); }, "market_history" );
+      database().add_index< primary_index< bucket_index  > >();
+      database().add_index< primary_index< history_index  > >();
+      database().add_index< primary_index< market_ticker_index > >();
+   }
 
    if( options.count( "bucket-size" ) )
    {
@@ -275,10 +480,44 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
    }
    if( options.count( "history-per-size" ) )
       my->_maximum_history_per_bucket_size = options["history-per-size"].as<uint32_t>();
+   if( options.count( "fill-history-horizon" ) )
+      my->_fill_history_horizon = options["fill-history-horizon"].as<uint32_t>();
+   if( options.count( "fill-history-size" ) )
+      my->_fill_history_size = options["fill-history-size"].as<uint32_t>();
+   if( my->_fill_history_size == 0 && my->_fill_history_horizon == 0 )
+      wlog( "fill-history-size and fill-history-horizon are both 0, the fill order history is never pruned" );
+
+   if( !my->_tracked_buckets.empty() &&
+       ( !options.count( "market-history-rollup" ) || options["market-history-rollup"].as<bool>() ) )
+   {
+      const uint32_t smallest = *my->_tracked_buckets.begin();
+      for( auto bucket : my->_tracked_buckets )
+         if( bucket != smallest && smallest != 0 && bucket % smallest == 0 )
+            my->_rollup_sources[bucket] = smallest;
+   }
 } FC_CAPTURE_AND_RETHROW() }
 
 void market_history_plugin::plugin_startup()
 {
+   // blocks applied before the plugin ran with a store, or while the node ran without it, are only in the log
+   const auto log = app().applied_operations();
+   if( my->_store && log )
+      my->rebuild_store( *log );
+}
+
+void market_history_plugin::plugin_shutdown()
+{
+   if( my->_queue )
+      my->close_store();
+}
+
+void market_history_plugin::read_history( const std::function<void(const graphene::db::object_database&)>& reader )const
+{
+   std::lock_guard<std::mutex> lock( my->_store_mutex );
+   if( my->_store )
+      reader( *my->_store );
+   else
+      reader( *app().chain_database() );
 }
 
 const flat_set<uint32_t>& market_history_plugin::tracked_buckets() const
@@ -291,4 +530,20 @@ uint32_t market_history_plugin::max_history()const
    return my->_maximum_history_per_bucket_size;
 }
 
+uint32_t market_history_plugin::fill_history_horizon()const
+{
+   return my->_fill_history_horizon;
+}
+
+uint32_t market_history_plugin::fill_history_size()const
+{
+   return my->_fill_history_size;
+}
+
+uint32_t market_history_plugin::rollup_source( uint32_t bucket_seconds )const
+{
+   auto itr = my->_rollup_sources.find( bucket_seconds );
+   return itr == my->_rollup_sources.end() ? 0 : itr->second;
+}
+
 } }
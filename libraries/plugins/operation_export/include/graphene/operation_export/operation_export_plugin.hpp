@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/plugin.hpp>
+
+namespace graphene { namespace operation_export {
+namespace detail { class operation_export_plugin_impl; }
+
+/**
+ *  Writes the applied operations of every irreversible block to a file, one JSON line per operation with its block
+ *  number, transaction and operation index, result and impacted accounts, for nodes that feed an external history
+ *  database instead of keeping the history in memory with the account_history plugin.
+ *
+ *  The operations are written on a worker thread in batches of several blocks.  A batch that cannot be written is
+ *  kept and written again with backoff; once more blocks wait than the buffer holds, applying blocks waits for the
+ *  file.  The number of the last written block is kept next to the file, so blocks applied again by a replay are not
+ *  exported twice.
+ */
+class operation_export_plugin : public graphene::app::plugin
+{
+   public:
+      operation_export_plugin();
+      virtual ~operation_export_plugin();
+
+      std::string plugin_name()const override { return "operation_export"; }
+      virtual void plugin_set_program_options(
+         boost::program_options::options_description& cli,
+         boost::program_options::options_description& cfg ) override;
+      virtual void plugin_initialize( const boost::program_options::variables_map& options ) override;
+      virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
+
+   private:
+      friend class detail::operation_export_plugin_impl;
+      std::unique_ptr<detail::operation_export_plugin_impl> my;
+};
+
+} } //graphene::operation_export
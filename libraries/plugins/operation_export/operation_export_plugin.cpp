@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/operation_export/operation_export_plugin.hpp>
+
+#include <graphene/app/applied_block_queue.hpp>
+#include <graphene/app/impacted.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <fstream>
+
+namespace graphene { namespace operation_export {
+
+namespace detail
+{
+
+using namespace graphene::chain;
+using graphene::app::applied_block_queue;
+
+class operation_export_plugin_impl
+{
+   public:
+      operation_export_plugin_impl( operation_export_plugin& _plugin )
+      :_self( _plugin ) {}
+
+      /** adds the operations of an irreversible block to the buffer, called on the worker thread */
+      void export_block( const applied_block_queue::applied_block_data& data );
+      /**
+       * Writes the buffered blocks, retrying with backoff.  Gives up after the configured number of retries and
+       * keeps the buffer for the next batch, unless @ref wait asks to retry until the file takes the buffer.
+       */
+      void write_buffer( bool wait );
+      void append_buffer_to_file();
+
+      operation_export_plugin&                 _self;
+      fc::path                                 _file;
+      /// holds the number of the last block in _file
+      fc::path                                 _head_file;
+      uint32_t                                 _batch_blocks = 10;
+      uint32_t                                 _buffer_blocks = 1000;
+      uint32_t                                 _retries = 5;
+
+      /// lines of the blocks after _written_through up to _buffered_through
+      std::string                              _buffer;
+      uint32_t                                 _buffered_blocks = 0;
+      uint32_t                                 _buffered_through = 0;
+      uint32_t                                 _written_through = 0;
+
+      std::unique_ptr<applied_block_queue>     _queue;
+};
+
+void operation_export_plugin_impl::export_block( const applied_block_queue::applied_block_data& data )
+{
+   const uint32_t block_num = data.block.block_num();
+   if( block_num <= _buffered_through )
+      return;
+
+   flat_set<account_id_type> impacted;
+   for( const optional<operation_history_object>& o_op : data.operations )
+   {
+      if( !o_op.valid() )
+         continue;
+      const operation_history_object& op = *o_op;
+
+      impacted.clear();
+      graphene::app::operation_get_required_and_impacted_accounts( op.op, impacted );
+      if( op.op.which() == operation::tag< account_create_operation >::value )
+         impacted.insert( op.result.get<object_id_type>() );
+
+      fc::mutable_variant_object line;
+      line( "block_num", op.block_num )
+          ( "timestamp", data.block.timestamp )
+          ( "trx_in_block", op.trx_in_block )
+          ( "op_in_trx", op.op_in_trx )
+          ( "virtual_op", op.virtual_op )
+          ( "op", op.op )
+          ( "result", op.result )
+          ( "accounts", impacted );
+      _buffer += fc::json::to_string( fc::variant( std::move( line ) ) );
+      _buffer += '\n';
+   }
+   _buffered_through = block_num;
+   ++_buffered_blocks;
+
+   if( _buffered_blocks >= _batch_blocks )
+      write_buffer( _buffered_blocks >= _buffer_blocks );
+}
+
+void operation_export_plugin_impl::write_buffer( bool wait )
+{
+   int64_t delay_us = 100000;
+   for( uint32_t attempt = 0; ; ++attempt )
+   {
+      try
+      {
+         append_buffer_to_file();
+         return;
+      }
+      catch( const fc::exception& e )
+      {
+         if( !wait && attempt >= _retries )
+         {
+            elog( "Unable to export ${n} blocks to ${file}, keeping them for the next batch: ${e}",
+                  ("n",_buffered_blocks)("file",_file)("e",e.to_detail_string()) );
+            return;
+         }
+         wlog( "Unable to export ${n} blocks to ${file}, retrying: ${e}",
+               ("n",_buffered_blocks)("file",_file)("e",e.to_string()) );
+      }
+      fc::usleep( fc::microseconds( delay_us ) );
+      delay_us = std::min<int64_t>( delay_us * 2, 10000000 );
+   }
+}
+
+void operation_export_plugin_impl::append_buffer_to_file()
+{
+   if( _buffered_blocks == 0 )
+      return;
+
+   const uint64_t old_size = fc::exists( _file ) ? fc::file_size( _file ) : 0;
+   {
+      std::ofstream out( _file.generic_string(), std::ios::out | std::ios::app | std::ios::binary );
+      FC_ASSERT( out.is_open(), "Unable to open ${file}", ("file",_file) );
+      out.write( _buffer.data(), _buffer.size() );
+      out.flush();
+      if( !out.good() )
+      {
+         out.close();
+         // a partly written batch would be written again by the next attempt
+         fc::resize_file( _file, old_size );
+         FC_THROW( "Unable to write to ${file}", ("file",_file) );
+      }
+   }
+
+   const fc::path head_tmp = _head_file.generic_string() + ".tmp";
+   fc::json::save_to_file( _buffered_through, head_tmp );
+   fc::rename( head_tmp, _head_file );
+
+   _written_through = _buffered_through;
+   _buffer.clear();
+   _buffered_blocks = 0;
+}
+
+} // end namespace detail
+
+operation_export_plugin::operation_export_plugin() :
+   my( new detail::operation_export_plugin_impl(*this) )
+{
+}
+
+operation_export_plugin::~operation_export_plugin()
+{
+}
+
+void operation_export_plugin::plugin_set_program_options(
+   boost::program_options::options_description& cli,
+   boost::program_options::options_description& cfg
+   )
+{
+   cli.add_options()
+         ("operation-export-file", boost::program_options::value<std::string>(),
+           "Append the applied operations of every irreversible block to this file, one JSON line per operation")
+         ("operation-export-batch-blocks", boost::program_options::value<uint32_t>()->default_value(10),
+           "Number of blocks written to the operation export file at once")
+         ("operation-export-buffer-blocks", boost::program_options::value<uint32_t>()->default_value(1000),
+           "Number of blocks kept in memory while the operation export file cannot be written, before applying "
+           "blocks waits for it")
+         ("operation-export-retries", boost::program_options::value<uint32_t>()->default_value(5),
+           "Number of times a batch is written again before it is kept for the next batch")
+         ("operation-export-queue-size", boost::program_options::value<uint32_t>()->default_value(100),
+           "Number of irreversible blocks that may wait for the export thread before applying blocks waits for it")
+         ;
+   cfg.add(cli);
+}
+
+void operation_export_plugin::plugin_initialize( const boost::program_options::variables_map& options )
+{ try {
+   if( !options.count( "operation-export-file" ) )
+      return;
+   my->_file = options["operation-export-file"].as<std::string>();
+   my->_head_file = my->_file.generic_string() + ".head";
+   my->_batch_blocks = std::max<uint32_t>( options["operation-export-batch-blocks"].as<uint32_t>(), 1 );
+   my->_buffer_blocks = std::max( options["operation-export-buffer-blocks"].as<uint32_t>(), my->_batch_blocks );
+   my->_retries = options["operation-export-retries"].as<uint32_t>();
+   if( fc::exists( my->_head_file ) )
+   {
+      my->_written_through = fc::json::from_file( my->_head_file ).as<uint32_t>();
+      my->_buffered_through = my->_written_through;
+      ilog( "Exporting operations after block #${n} to ${file}", ("n",my->_written_through)("file",my->_file) );
+   }
+
+   my->_queue.reset( new graphene::app::applied_block_queue( "operation_export",
+      [this]( const graphene::app::applied_block_queue::applied_block_data& data ) {
+         my->export_block( data );
+      }, options["operation-export-queue-size"].as<uint32_t>() ) );
+   my->_queue->connect( database() );
+} FC_LOG_AND_RETHROW() }
+
+void operation_export_plugin::plugin_startup()
+{
+}
+
+void operation_export_plugin::plugin_shutdown()
+{
+   if( !my->_queue )
+      return;
+   // waits for the queued blocks, the worker is idle afterwards
+   my->_queue.reset();
+   my->write_buffer( false );
+   if( my->_buffered_blocks > 0 )
+      elog( "The operations of blocks #${first} to #${last} were not exported to ${file}",
+            ("first",my->_written_through + 1)("last",my->_buffered_through)("file",my->_file) );
+}
+
+} }
@@ -68,6 +68,9 @@ public:
 
    void set_block_production(bool allow) { _production_enabled = allow; }
 
+   /** time from the slot of each produced block until it was pushed and ready to broadcast */
+   const chain::latency_histogram& get_production_latency()const { return _production_latency; }
+
    virtual void plugin_initialize( const boost::program_options::variables_map& options ) override;
    virtual void plugin_startup() override;
    virtual void plugin_shutdown() override;
@@ -75,13 +78,18 @@ public:
 private:
    void schedule_production_loop();
    block_production_condition::block_production_condition_enum block_production_loop();
-   block_production_condition::block_production_condition_enum maybe_produce_block( fc::mutable_variant_object& capture );
+   block_production_condition::block_production_condition_enum maybe_produce_block( fc::mutable_variant_object& capture,
+                                                                                    graphene::app::block_production_attempt& attempt );
 
    boost::program_options::variables_map _options;
    bool _production_enabled = false;
    bool _consecutive_production_enabled = false;
    uint32_t _required_witness_participation = 33 * GRAPHENE_1_PERCENT;
    uint32_t _production_skip_flags = graphene::chain::database::skip_nothing;
+   fc::microseconds _block_assembly_lead_time;
+   /** when the production loop is due to wake up next, in NTP time */
+   fc::time_point _scheduled_wakeup;
+   chain::latency_histogram _production_latency;
 
    std::map<chain::public_key_type, fc::ecc::private_key> _private_keys;
    std::set<chain::witness_id_type> _witnesses;
@@ -89,3 +97,7 @@ private:
 };
 
 } } //graphene::witness_plugin
+
+FC_REFLECT_ENUM( graphene::witness_plugin::block_production_condition::block_production_condition_enum,
+                 (produced)(not_synced)(not_my_turn)(not_time_yet)(no_private_key)(low_participation)(lag)
+                 (consecutive)(exception_producing_block) )
@@ -23,6 +23,7 @@
  */
 #include <graphene/witness/witness.hpp>
 
+#include <graphene/app/chain_write_queue.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/time/time.hpp>
@@ -75,6 +76,9 @@ void witness_plugin::plugin_set_program_options(
          ("private-key", bpo::value<vector<string>>()->composing()->multitoken()->
           DEFAULT_VALUE_VECTOR(std::make_pair(chain::public_key_type(default_priv_key.get_public_key()), graphene::utilities::key_to_wif(default_priv_key))),
           "Tuple of [PublicKey, WIF private key] (may specify multiple times)")
+         ("block-assembly-lead-time", bpo::value<uint32_t>()->default_value(200), "Milliseconds before its slot that a "
+          "witness starts putting its block together, the block is then signed and broadcast at the slot time, "
+          "0 does all of it at the slot time")
          ;
    config_file_options.add(command_line_options);
 }
@@ -89,6 +93,9 @@ void witness_plugin::plugin_initialize(const boost::program_options::variables_m
    ilog("witness plugin:  plugin_initialize() begin");
    _options = &options;
    LOAD_VALUE_SET(options, "witness-id", _witnesses, chain::witness_id_type)
+   const uint32_t lead_time = options.at("block-assembly-lead-time").as<uint32_t>();
+   FC_ASSERT( lead_time < 1000, "block-assembly-lead-time must be less than a second" );
+   _block_assembly_lead_time = fc::milliseconds( lead_time );
 
    if( options.count("private-key") )
    {
@@ -128,6 +135,16 @@ void witness_plugin::plugin_startup()
    {
       ilog("Launching block production for ${n} witnesses.", ("n", _witnesses.size()));
       app().set_block_production(true);
+      // the p2p node proves it holds this key to the witness relays it was given
+      for( const chain::witness_id_type& witness : _witnesses )
+      {
+         auto private_key_itr = _private_keys.find( witness(d).signing_key );
+         if( private_key_itr != _private_keys.end() )
+         {
+            p2p_node().set_witness_relay_key( private_key_itr->second );
+            break;
+         }
+      }
       if( _production_enabled )
       {
          if( d.head_block_num() == 0 )
@@ -148,15 +165,16 @@ void witness_plugin::plugin_shutdown()
 
 void witness_plugin::schedule_production_loop()
 {
-   //Schedule for the next second's tick regardless of chain state
+   //Schedule for the next second's tick regardless of chain state, less the time needed to assemble a block
    // If we would wait less than 50ms, wait for the whole second.
-   fc::time_point ntp_now = graphene::time::now();
+   fc::time_point ntp_now = graphene::time::now() + _block_assembly_lead_time;
    fc::time_point fc_now = fc::time_point::now();
    int64_t time_to_next_second = 1000000 - (ntp_now.time_since_epoch().count() % 1000000);
    if( time_to_next_second < 50000 )      // we must sleep for at least 50ms
        time_to_next_second += 1000000;
 
    fc::time_point next_wakeup( fc_now + fc::microseconds( time_to_next_second ) );
+   _scheduled_wakeup = ntp_now - _block_assembly_lead_time + fc::microseconds( time_to_next_second );
 
    //wdump( (now.time_since_epoch().count())(next_wakeup.time_since_epoch().count()) );
    _block_production_task = fc::schedule([this]{block_production_loop();},
@@ -167,9 +185,11 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
 {
    block_production_condition::block_production_condition_enum result;
    fc::mutable_variant_object capture;
+   graphene::app::block_production_attempt attempt;
+   attempt.wakeup_drift = ( graphene::time::now() - _scheduled_wakeup ).count();
    try
    {
-      result = maybe_produce_block(capture);
+      result = maybe_produce_block(capture, attempt);
    }
    catch( const fc::canceled_exception& )
    {
@@ -185,7 +205,11 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} with timestamp ${t} at time ${c}", (capture));
+         ilog("Generated block #${n} with timestamp ${t} at time ${c}, ${l} us after its slot", (capture));
+         if( _production_latency.count % 100 == 0 )
+            ilog("Block production latency: ${h}", ("h", _production_latency));
+         if( database().operation_statistics_enabled() )
+            ilog("Operation statistics: ${s}", ("s", database().get_operation_statistics()));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block (see: --enable-stale-production)");
@@ -212,15 +236,23 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
          break;
    }
 
+   attempt.condition = fc::reflector<block_production_condition::block_production_condition_enum>::to_string( result );
+   app().get_block_production_statistics().add( attempt, result != block_production_condition::not_my_turn &&
+                                                         result != block_production_condition::not_time_yet &&
+                                                         result != block_production_condition::not_synced );
+
    schedule_production_loop();
    return result;
 }
 
-block_production_condition::block_production_condition_enum witness_plugin::maybe_produce_block( fc::mutable_variant_object& capture )
+block_production_condition::block_production_condition_enum witness_plugin::maybe_produce_block( fc::mutable_variant_object& capture,
+                                                                                                  graphene::app::block_production_attempt& attempt )
 {
    chain::database& db = database();
-   fc::time_point now_fine = graphene::time::now();
+   // with a lead time this runs that much before the slot, everything is checked as of the slot
+   fc::time_point now_fine = graphene::time::now() + _block_assembly_lead_time;
    fc::time_point_sec now = now_fine + fc::microseconds( 500000 );
+   attempt.slot_time = now;
 
    // If the next block production opportunity is in the present or future, we're synced.
    if( !_production_enabled )
@@ -258,6 +290,7 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    }
 
    fc::time_point_sec scheduled_time = db.get_slot_time( slot );
+   attempt.slot_time = scheduled_time;
    graphene::chain::public_key_type scheduled_key = scheduled_witness( db ).signing_key;
    auto private_key_itr = _private_keys.find( scheduled_key );
 
@@ -280,14 +313,46 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       return block_production_condition::lag;
    }
 
-   auto block = db.generate_block(
-      scheduled_time,
-      scheduled_witness,
-      private_key_itr->second,
-      _production_skip_flags
-      );
-   capture("n", block.block_num())("t", block.timestamp)("c", now);
-   fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+   graphene::chain::signed_block block;
+   auto& writes = app().write_queue();
+   fc::time_point generate_start = fc::time_point::now();
+   if( _block_assembly_lead_time.count() > 0 )
+   {
+      graphene::chain::signed_block candidate = db.assemble_block( scheduled_time, scheduled_witness, _production_skip_flags );
+      attempt.generate_time = ( fc::time_point::now() - generate_start ).count();
+      const fc::microseconds until_slot = fc::time_point( scheduled_time ) - graphene::time::now();
+      if( until_slot.count() > 0 )
+         fc::usleep( until_slot );
+      generate_start = fc::time_point::now();
+      // a late block of the previous slot may have arrived meanwhile, then the block is put together again
+      block = writes.run( graphene::app::chain_write_queue::production_write, [&]() -> graphene::chain::signed_block {
+         if( candidate.previous == db.head_block_id() )
+            return db.sign_and_push_block( std::move(candidate), private_key_itr->second, _production_skip_flags );
+         return db.generate_block( scheduled_time, scheduled_witness, private_key_itr->second, _production_skip_flags );
+      });
+   }
+   else
+      block = writes.run( graphene::app::chain_write_queue::production_write, [&]() {
+         return db.generate_block(
+            scheduled_time,
+            scheduled_witness,
+            private_key_itr->second,
+            _production_skip_flags
+            );
+      });
+   attempt.generate_time += ( fc::time_point::now() - generate_start ).count();
+   attempt.block_num = block.block_num();
+   attempt.block_size = fc::raw::pack_size( block );
+   attempt.assembly = db.get_last_block_assembly();
+
+   const int64_t latency = std::max<int64_t>( 0, ( graphene::time::now() - fc::time_point( scheduled_time ) ).count() );
+   _production_latency.add( latency );
+   capture("n", block.block_num())("t", block.timestamp)("c", now)("l", latency);
+   fc::async( [this,block](){
+      p2p_node().broadcast(net::block_message(block));
+      const int64_t broadcast_time = ( graphene::time::now() - fc::time_point( block.timestamp ) ).count();
+      app().get_block_production_statistics().broadcast( block.block_num(), std::max<int64_t>( 0, broadcast_time ) );
+   } );
 
    return block_production_condition::produced;
 }
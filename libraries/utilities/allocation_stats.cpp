@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/allocation_stats.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace graphene { namespace utilities {
+
+namespace {
+
+/** the counts of one thread, on a cache line of its own */
+struct alignas(64) thread_counts
+{
+   std::atomic<uint64_t> allocations[allocation_phase_count];
+   std::atomic<uint64_t> bytes[allocation_phase_count];
+};
+
+/** threads beyond these share the last slot */
+const size_t max_threads = 256;
+/** static and zero initialized, so the first allocations of the process may be counted already */
+thread_counts counts[max_threads];
+std::atomic<size_t> threads_counted{ 0 };
+
+// thread locals without constructors, which take no allocation to set up
+thread_local allocation_phase local_phase = alloc_other;
+thread_local thread_counts* local_counts = nullptr;
+
+}
+
+allocation_snapshot allocation_snapshot::operator - ( const allocation_snapshot& earlier )const
+{
+   allocation_snapshot result;
+   for( size_t i = 0; i < allocation_phase_count; ++i )
+   {
+      result.phases[i].allocations = phases[i].allocations - earlier.phases[i].allocations;
+      result.phases[i].bytes = phases[i].bytes - earlier.phases[i].bytes;
+   }
+   return result;
+}
+
+allocation_counts allocation_snapshot::total()const
+{
+   allocation_counts result;
+   for( const allocation_counts& c : phases )
+   {
+      result.allocations += c.allocations;
+      result.bytes += c.bytes;
+   }
+   return result;
+}
+
+std::map<std::string, allocation_counts> allocation_snapshot::by_phase()const
+{
+   std::map<std::string, allocation_counts> result;
+   for( size_t i = 0; i < allocation_phase_count; ++i )
+      if( phases[i].allocations > 0 )
+         result[ allocation_stats::phase_name( allocation_phase( i ) ) ] = phases[i];
+   return result;
+}
+
+bool allocation_stats::hooked()
+{
+#ifdef GRAPHENE_ALLOCATION_STATS
+   return true;
+#else
+   return false;
+#endif
+}
+
+allocation_phase allocation_stats::current_phase()
+{
+   return local_phase;
+}
+
+void allocation_stats::set_phase( allocation_phase phase )
+{
+   local_phase = phase;
+}
+
+allocation_snapshot allocation_stats::snapshot()
+{
+   allocation_snapshot result;
+   const size_t threads = std::min( threads_counted.load( std::memory_order_relaxed ), max_threads );
+   for( size_t t = 0; t < threads; ++t )
+      for( size_t i = 0; i < allocation_phase_count; ++i )
+      {
+         result.phases[i].allocations += counts[t].allocations[i].load( std::memory_order_relaxed );
+         result.phases[i].bytes += counts[t].bytes[i].load( std::memory_order_relaxed );
+      }
+   return result;
+}
+
+const char* allocation_stats::phase_name( allocation_phase phase )
+{
+   switch( phase )
+   {
+      case alloc_p2p:          return "p2p";
+      case alloc_pending_push: return "pending_push";
+      case alloc_block_apply:  return "block_apply";
+      case alloc_maintenance:  return "maintenance";
+      case alloc_plugin:       return "plugin";
+      case alloc_api:          return "api";
+      default:                 return "other";
+   }
+}
+
+void allocation_stats::count( size_t bytes )
+{
+   if( !local_counts )
+      local_counts = &counts[ std::min( threads_counted.fetch_add( 1, std::memory_order_relaxed ), max_threads - 1 ) ];
+   local_counts->allocations[local_phase].fetch_add( 1, std::memory_order_relaxed );
+   local_counts->bytes[local_phase].fetch_add( bytes, std::memory_order_relaxed );
+}
+
+} } // graphene::utilities
+
+#ifdef GRAPHENE_ALLOCATION_STATS
+
+void* operator new( std::size_t size )
+{
+   graphene::utilities::allocation_stats::count( size );
+   if( size == 0 )
+      size = 1;
+   for( ;; )
+   {
+      if( void* p = std::malloc( size ) )
+         return p;
+      std::new_handler handler = std::get_new_handler();
+      if( !handler )
+         throw std::bad_alloc();
+      handler();
+   }
+}
+
+void* operator new[]( std::size_t size )
+{
+   return ::operator new( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept
+{
+   try
+   {
+      return ::operator new( size );
+   }
+   catch( ... )
+   {
+      return nullptr;
+   }
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept
+{
+   return ::operator new( size, std::nothrow );
+}
+
+void operator delete( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept
+{
+   std::free( p );
+}
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/executor.hpp>
+
+#include <fc/log/logger.hpp>
+#include <fc/string.hpp>
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace graphene { namespace utilities {
+
+namespace {
+   /** the executor and worker the thread belongs to, if any */
+   thread_local const executor* current_executor = nullptr;
+   thread_local size_t          current_worker = 0;
+
+   void pin_to_core( uint32_t core )
+   {
+#ifdef __linux__
+      cpu_set_t cores;
+      CPU_ZERO( &cores );
+      CPU_SET( core, &cores );
+      if( pthread_setaffinity_np( pthread_self(), sizeof(cores), &cores ) != 0 )
+         wlog( "Could not pin an executor thread to core ${c}", ("c",core) );
+#else
+      wlog( "Pinning executor threads to cores is only supported on Linux" );
+#endif
+   }
+}
+
+executor::executor( uint32_t threads, bool pin_cores, metrics_registry* metrics )
+   : _next_worker( 0 ), _steals( 0 ), _metrics( metrics )
+{
+   const uint32_t cores = std::max( 1u, std::thread::hardware_concurrency() );
+   if( threads == 0 )
+      threads = cores;
+   for( uint32_t i = 0; i < threads; ++i )
+   {
+      _workers.emplace_back( new worker );
+      _workers.back()->thread.reset( new fc::thread( "executor_" + fc::to_string( uint64_t(i) ) ) );
+      _workers.back()->thread->async( [this, i, pin_cores, cores]() {
+         current_executor = this;
+         current_worker = i;
+         if( pin_cores )
+            pin_to_core( i % cores );
+      }, "executor_init" ).wait();
+   }
+
+   if( _metrics )
+   {
+      _steals_counter = &_metrics->counter( "graphene_executor_steals_total",
+                                            "Tasks an executor thread took from the queue of another" );
+      _metrics->add_gauge( "graphene_executor_threads", "Threads of the executor",
+                           [this]() { return double( thread_count() ); } );
+      _metrics->add_gauge( "graphene_executor_queued_tasks", "Tasks waiting for an executor thread",
+                           [this]() { return double( queued() ); } );
+   }
+}
+
+executor::~executor()
+{
+   // a thread drains its queues while they hold a task, see post()
+   auto busy = [this]() -> bool {
+      for( const auto& w : _workers )
+      {
+         std::lock_guard<std::mutex> lock( w->mutex );
+         if( w->draining )
+            return true;
+      }
+      return false;
+   };
+   while( busy() )
+      fc::usleep( fc::milliseconds( 1 ) );
+   // the fc threads quit before the workers they have been draining go
+   for( auto& w : _workers )
+      w->thread.reset();
+}
+
+bool executor::on_worker_thread()const
+{
+   return current_executor == this;
+}
+
+size_t executor::queued()const
+{
+   size_t result = 0;
+   for( const auto& w : _workers )
+   {
+      std::lock_guard<std::mutex> lock( w->mutex );
+      for( const auto& q : w->queues )
+         result += q.size();
+   }
+   return result;
+}
+
+void executor::post( const char* type, task_priority priority, std::function<void()> run )
+{
+   FC_ASSERT( priority < task_priority_count, "Unknown task priority", ("priority",int(priority)) );
+   const bool own = on_worker_thread();
+   const size_t n = own ? current_worker : _next_worker++ % _workers.size();
+   {
+      worker& w = *_workers[n];
+      std::lock_guard<std::mutex> lock( w.mutex );
+      w.queues[priority].push_back( queued_task{ type, fc::time_point::now(), std::move( run ) } );
+      if( wake( n ) || !own )
+         return;
+   }
+   // the thread posting to itself is busy, an idle one may steal the task
+   for( size_t k = 1; k < _workers.size(); ++k )
+   {
+      const size_t peer = ( n + k ) % _workers.size();
+      std::lock_guard<std::mutex> lock( _workers[peer]->mutex );
+      if( wake( peer ) )
+         return;
+   }
+}
+
+bool executor::wake( size_t n )
+{
+   worker& w = *_workers[n];
+   if( w.draining )
+      return false;
+   w.draining = true;
+   w.thread->async( [this, n]() { drain( n ); }, "executor_drain" );
+   return true;
+}
+
+void executor::drain( size_t n )
+{
+   queued_task task;
+   while( take( n, task ) )
+      run( task );
+}
+
+bool executor::take( size_t n, queued_task& task )
+{
+   worker& w = *_workers[n];
+   {
+      std::lock_guard<std::mutex> lock( w.mutex );
+      if( pop( w, task ) )
+         return true;
+   }
+   if( steal( n, task ) )
+      return true;
+   // a task posted while stealing did not wake the thread, it was still draining
+   std::lock_guard<std::mutex> lock( w.mutex );
+   if( pop( w, task ) )
+      return true;
+   w.draining = false;
+   return false;
+}
+
+bool executor::steal( size_t n, queued_task& task )
+{
+   for( size_t k = 1; k < _workers.size(); ++k )
+   {
+      worker& victim = *_workers[ ( n + k ) % _workers.size() ];
+      std::lock_guard<std::mutex> lock( victim.mutex );
+      if( pop( victim, task ) )
+      {
+         _steals.fetch_add( 1, std::memory_order_relaxed );
+         if( _steals_counter )
+            _steals_counter->add();
+         return true;
+      }
+   }
+   return false;
+}
+
+bool executor::pop( worker& w, queued_task& task )
+{
+   for( auto& q : w.queues )
+      if( !q.empty() )
+      {
+         task = std::move( q.front() );
+         q.pop_front();
+         return true;
+      }
+   return false;
+}
+
+void executor::run( const queued_task& task )
+{
+   const type_metrics& m = metrics_of( task.type );
+   const fc::time_point start = fc::time_point::now();
+   if( m.tasks )
+   {
+      m.tasks->add();
+      m.queue_seconds->observe( ( start - task.queued ).count() / 1000000.0 );
+   }
+   // async() and run_parallel() hand the exceptions of their tasks to the caller
+   try {
+      task.run();
+   } catch( const fc::exception& e ) {
+      elog( "Executor task ${type} failed: ${e}", ("type",task.type)("e",e.to_detail_string()) );
+   } catch( ... ) {
+      elog( "Executor task ${type} failed", ("type",task.type) );
+   }
+   if( m.tasks )
+      m.run_seconds->observe( ( fc::time_point::now() - start ).count() / 1000000.0 );
+}
+
+const executor::type_metrics& executor::metrics_of( const char* type )
+{
+   static const type_metrics none;
+   if( !_metrics )
+      return none;
+
+   std::lock_guard<std::mutex> lock( _metrics_mutex );
+   auto itr = _type_metrics.find( type );
+   if( itr != _type_metrics.end() )
+      return itr->second;
+
+   const std::string labels = std::string( "type=\"" ) + type + "\"";
+   type_metrics& m = _type_metrics[type];
+   m.tasks = &_metrics->counter( "graphene_executor_tasks_total", "Tasks run by the executor by type", labels );
+   m.queue_seconds = &_metrics->histogram( "graphene_executor_queue_seconds", "Time executor tasks waited for a thread by type",
+                                           metrics_registry::latency_buckets(), labels );
+   m.run_seconds = &_metrics->histogram( "graphene_executor_run_seconds", "Time executor tasks ran by type",
+                                         metrics_registry::latency_buckets(), labels );
+   return m;
+}
+
+void executor::run_parallel( const char* type, size_t count, const std::function<void(size_t)>& task,
+                             size_t parallelism, task_priority priority )
+{
+   const size_t threads = parallelism == 0 ? _workers.size() : std::min( parallelism - 1, _workers.size() );
+   const size_t helpers = count > 0 ? std::min( threads, count - 1 ) : 0;
+
+   std::atomic<size_t> next( 0 );
+   std::mutex error_mutex;
+   std::exception_ptr error;
+   auto work = [&]() {
+      for( size_t n = next++; n < count; n = next++ )
+      {
+         try {
+            task( n );
+         } catch( ... ) {
+            std::lock_guard<std::mutex> lock( error_mutex );
+            if( !error )
+               error = std::current_exception();
+         }
+      }
+   };
+
+   // a helper still queued once the calling thread is through is not waited for and returns without touching
+   // anything of this call, its thread may be the one waiting here when run_parallel() is nested in a task
+   auto claimed = std::make_shared< std::vector< std::atomic<bool> > >( helpers );
+   std::vector< fc::future<void> > done;
+   done.reserve( helpers );
+   for( size_t i = 0; i < helpers; ++i )
+      done.push_back( async( type, [claimed, i, &work]() {
+         if( !(*claimed)[i].exchange( true ) )
+            work();
+      }, priority ) );
+   work();
+   for( size_t i = 0; i < helpers; ++i )
+      if( (*claimed)[i].exchange( true ) )
+         done[i].wait();
+   if( error )
+      std::rethrow_exception( error );
+}
+
+} } // graphene::utilities
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/reflect/reflect.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace graphene { namespace utilities {
+
+/** what a thread is doing when it allocates, see allocation_phase_scope */
+enum allocation_phase
+{
+   alloc_other,
+   alloc_p2p,           ///< handling a message of the p2p network
+   alloc_pending_push,  ///< pushing a pending transaction
+   alloc_block_apply,   ///< applying a block, apart from maintenance and the plugins
+   alloc_maintenance,   ///< the maintenance interval
+   alloc_plugin,        ///< the applied_block and changed objects observers
+   alloc_api,           ///< serving an API call
+   allocation_phase_count
+};
+
+struct allocation_counts
+{
+   uint64_t allocations = 0;
+   uint64_t bytes       = 0;
+};
+
+/** the allocations of every phase */
+struct allocation_snapshot
+{
+   allocation_counts phases[allocation_phase_count];
+
+   /** the allocations since @ref earlier */
+   allocation_snapshot operator - ( const allocation_snapshot& earlier )const;
+   allocation_counts   total()const;
+   /** by the names of the phases, leaving out those without allocations */
+   std::map<std::string, allocation_counts> by_phase()const;
+};
+
+/**
+ *  @brief Counts the heap allocations of all threads by the phase each thread is in
+ *
+ *  The counting comes from replacing the global operator new, which is only compiled in with the cmake option
+ *  GRAPHENE_ALLOCATION_STATS; hooked() tells whether it was.  It calls malloc, so it counts on top of tcmalloc
+ *  just as well.  Every thread counts into a slot of its own, snapshot() sums them up, the slots of finished
+ *  threads included.  Freeing is not counted, operator delete is not told the size.
+ *
+ *  The phases nest, the innermost allocation_phase_scope of a thread wins, so a block pushed while handling a p2p
+ *  message counts as block_apply and its maintenance as maintenance.  Like the spans of the tracer, an fc task that
+ *  yields inside a scope lends its phase to the tasks that run on the thread meanwhile.
+ */
+class allocation_stats
+{
+   public:
+      /** true when operator new is replaced, otherwise snapshot() stays empty */
+      static bool hooked();
+      static allocation_phase current_phase();
+      static allocation_snapshot snapshot();
+      static const char* phase_name( allocation_phase phase );
+
+      /** called by the replaced operator new */
+      static void count( size_t bytes );
+
+   private:
+      friend class allocation_phase_scope;
+      static void set_phase( allocation_phase phase );
+};
+
+/** attributes the allocations of the thread to @ref phase until it is destroyed */
+class allocation_phase_scope
+{
+   public:
+      explicit allocation_phase_scope( allocation_phase phase ) : _previous( allocation_stats::current_phase() )
+      {
+         allocation_stats::set_phase( phase );
+      }
+      ~allocation_phase_scope() { allocation_stats::set_phase( _previous ); }
+
+      allocation_phase_scope( const allocation_phase_scope& ) = delete;
+      allocation_phase_scope& operator = ( const allocation_phase_scope& ) = delete;
+
+   private:
+      const allocation_phase _previous;
+};
+
+} } // graphene::utilities
+
+FC_REFLECT( graphene::utilities::allocation_counts, (allocations)(bytes) )
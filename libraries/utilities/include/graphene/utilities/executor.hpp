@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/utilities/metrics.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+/** the order in which an executor takes up queued tasks, the classes before it first */
+enum task_priority
+{
+   priority_high,    ///< work a block waits for, like recovering its signature keys
+   priority_normal,  ///< work done ahead, like prevalidating the blocks received during sync
+   priority_low,     ///< background work and API calls
+   task_priority_count
+};
+
+namespace detail {
+   template<typename R>
+   struct fulfil_promise
+   {
+      template<typename F>
+      static void run( const typename fc::promise<R>::ptr& p, F& f ) { p->set_value( f() ); }
+   };
+   template<>
+   struct fulfil_promise<void>
+   {
+      template<typename F>
+      static void run( const fc::promise<void>::ptr& p, F& f ) { f(); p->set_value(); }
+   };
+}
+
+/**
+ *  @brief A work-stealing pool of fc threads that the subsystems of a node share
+ *
+ *  Every thread has a queue per task_priority.  A task posted from one of the threads goes to its own queue,
+ *  any other is spread over the threads in turn; a thread takes the oldest task of the highest priority of its own
+ *  queues and once they are empty steals from the others, so a thread left with a long task does not hold up the
+ *  tasks queued behind it.  Within a priority the tasks run in the order they were queued, a lower priority waits
+ *  for the higher ones.
+ *
+ *  async() returns an fc::future, which may be waited on from any thread or fc task.  A task that waits on another
+ *  task of the executor holds its thread meanwhile, run_parallel() therefore also runs tasks on the calling thread.
+ *
+ *  With a metrics registry, every type of task counts its tasks and times their wait in the queue and their run
+ *  under graphene_executor_*{type="..."}.
+ */
+class executor
+{
+   public:
+      /** @param threads 0 for a thread per core; @param pin_cores binds thread n to core n modulo the cores */
+      explicit executor( uint32_t threads = 0, bool pin_cores = false, metrics_registry* metrics = nullptr );
+      /** runs the tasks still queued, their callers may be waiting for them */
+      ~executor();
+
+      executor( const executor& ) = delete;
+      executor& operator = ( const executor& ) = delete;
+
+      size_t thread_count()const { return _workers.size(); }
+      /** true on the threads of this executor */
+      bool   on_worker_thread()const;
+      /** the tasks queued and not yet taken up */
+      size_t queued()const;
+      /** the tasks a thread took from the queues of others */
+      uint64_t steals()const { return _steals.load( std::memory_order_relaxed ); }
+
+      /**
+       * Runs @ref f on one of the threads, @ref type names the kind of task in the metrics and must outlive the
+       * executor, a string literal does.  An exception thrown by @ref f is rethrown by waiting on the future.
+       */
+      template<typename F>
+      auto async( const char* type, F f, task_priority priority = priority_normal ) -> fc::future<decltype(f())>
+      {
+         typedef decltype(f()) result_type;
+         typename fc::promise<result_type>::ptr p( new fc::promise<result_type>( type ) );
+         post( type, priority, [p, f, type]() mutable {
+            try {
+               detail::fulfil_promise<result_type>::run( p, f );
+            } catch( const fc::exception& e ) {
+               p->set_exception( e.dynamic_copy_exception() );
+            } catch( ... ) {
+               p->set_exception( std::make_shared<fc::unhandled_exception>(
+                  FC_LOG_MESSAGE( warn, "unhandled exception in ${type}", ("type",type) ), std::current_exception() ) );
+            }
+         } );
+         return fc::future<result_type>( p );
+      }
+
+      /**
+       * Runs task(0) ... task(count - 1) on up to @ref parallelism threads, the calling one among them, and waits for
+       * all of them.  0 uses every thread of the executor besides the calling one.  The first exception thrown by a
+       * task is rethrown once all are done.  Only the threads that took up a share before the calling one ran out of
+       * tasks are waited for, so it may be called from a task of the executor.
+       */
+      void run_parallel( const char* type, size_t count, const std::function<void(size_t)>& task,
+                         size_t parallelism = 0, task_priority priority = priority_high );
+
+   private:
+      struct queued_task
+      {
+         const char*             type;
+         fc::time_point          queued;
+         std::function<void()>   run;
+      };
+      struct worker
+      {
+         std::unique_ptr<fc::thread>  thread;
+         mutable std::mutex           mutex;
+         std::deque<queued_task>      queues[task_priority_count];
+         /** a drain() is running or posted to the thread, guarded by mutex */
+         bool                         draining = false;
+      };
+      struct type_metrics
+      {
+         metrics_counter*    tasks = nullptr;
+         metrics_histogram*  queue_seconds = nullptr;
+         metrics_histogram*  run_seconds = nullptr;
+      };
+
+      void post( const char* type, task_priority priority, std::function<void()> run );
+      /** makes worker @ref n drain its queues unless it already does, call with its mutex held */
+      bool wake( size_t n );
+      /** runs the tasks of worker @ref n and those it steals, until there are none */
+      void drain( size_t n );
+      bool take( size_t n, queued_task& task );
+      bool steal( size_t n, queued_task& task );
+      static bool pop( worker& w, queued_task& task );
+      void run( const queued_task& task );
+      const type_metrics& metrics_of( const char* type );
+
+      std::vector< std::unique_ptr<worker> >  _workers;
+      std::atomic<uint32_t>                   _next_worker;
+      std::atomic<uint64_t>                   _steals;
+
+      metrics_registry*                       _metrics;
+      metrics_counter*                        _steals_counter = nullptr;
+      std::mutex                              _metrics_mutex;
+      std::map<std::string, type_metrics>     _type_metrics;
+};
+
+} } // graphene::utilities
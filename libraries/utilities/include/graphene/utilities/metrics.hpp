@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+/** a count that only goes up, any thread may add to it without a lock */
+class metrics_counter
+{
+   public:
+      void     add( uint64_t n = 1 ) { _value.fetch_add( n, std::memory_order_relaxed ); }
+      uint64_t value()const          { return _value.load( std::memory_order_relaxed ); }
+
+   private:
+      std::atomic<uint64_t> _value{0};
+};
+
+/** counts observed values into buckets with fixed upper bounds, any thread may observe without a lock */
+class metrics_histogram
+{
+   public:
+      /** @param upper_bounds ascending, values above the last one are only counted in the implicit +Inf bucket */
+      explicit metrics_histogram( std::vector<double> upper_bounds );
+
+      void observe( double value );
+
+      const std::vector<double>& upper_bounds()const { return _bounds; }
+      /** observations in bucket i alone, i == upper_bounds().size() is the +Inf bucket */
+      uint64_t bucket( size_t i )const { return _buckets[i].load( std::memory_order_relaxed ); }
+      uint64_t count()const            { return _count.load( std::memory_order_relaxed ); }
+      double   sum()const              { return _sum.load( std::memory_order_relaxed ); }
+
+   private:
+      std::vector<double>                        _bounds;
+      std::unique_ptr<std::atomic<uint64_t>[]>   _buckets;
+      std::atomic<uint64_t>                      _count{0};
+      std::atomic<double>                        _sum{0};
+};
+
+/**
+ *  @brief Named counters, histograms and gauges, rendered in the Prometheus text format
+ *
+ *  Looking a metric up takes a lock, so hot paths look their metrics up once and keep the reference, which stays
+ *  valid as long as the registry; recording into it is a relaxed atomic add.  Gauges are read by a callback when the
+ *  metrics are rendered, which suits values the owner already keeps, like queue sizes.
+ *
+ *  @ref labels is the inside of a Prometheus label set, e.g. method="get_objects", or empty.
+ */
+class metrics_registry
+{
+   public:
+      metrics_counter&   counter( const std::string& name, const std::string& help,
+                                  const std::string& labels = std::string() );
+      metrics_histogram& histogram( const std::string& name, const std::string& help,
+                                    const std::vector<double>& upper_bounds, const std::string& labels = std::string() );
+      void               add_gauge( const std::string& name, const std::string& help, std::function<double()> read,
+                                    const std::string& labels = std::string() );
+      /** writes further lines, already in the text format, after the registered metrics */
+      void               add_collector( std::function<void(std::ostream&)> collector );
+
+      std::string        render()const;
+
+      /** upper bounds in seconds for latencies from 100us to 10s */
+      static std::vector<double> latency_buckets();
+
+   private:
+      struct family
+      {
+         std::string                                                 help;
+         std::string                                                 type;
+         std::map< std::string, std::unique_ptr<metrics_counter> >   counters;
+         std::map< std::string, std::unique_ptr<metrics_histogram> > histograms;
+         std::map< std::string, std::function<double()> >            gauges;
+      };
+      family& get_family( const std::string& name, const std::string& help, const char* type );
+
+      mutable std::mutex                                 _mutex;
+      std::map< std::string, family >                    _families;
+      std::vector< std::function<void(std::ostream&)> >  _collectors;
+};
+
+} } // graphene::utilities
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace graphene { namespace utilities {
+
+/**
+ *  @brief Records scoped spans into a ring buffer per thread, to be written out as a Chrome trace
+ *
+ *  Tracing is off until set_sampling() turns it on, a span then costs a relaxed atomic load.  When it is on, each
+ *  span that is not nested in another span of its thread decides whether it is sampled, and the spans nested in it
+ *  follow that decision, so a sampled span always comes with its whole tree.  Spans are timed in microseconds of the
+ *  system clock, the same as fc::time_point::now().
+ *
+ *  The span names must outlive the tracer, they are kept as pointers; names which are not string literals can be
+ *  made permanent with intern().  Spans of fc tasks which yield to each other on one thread nest as they happen to
+ *  run, which is what a timeline of the thread shows anyway.
+ *
+ *  write_chrome_trace() writes the spans recorded by all threads in the Chrome trace event format, which
+ *  chrome://tracing and ui.perfetto.dev open.
+ */
+class tracer
+{
+   public:
+      /** traces one in every @ref one_in spans that are not nested in another, 0 turns tracing off */
+      static void     set_sampling( uint32_t one_in );
+      static uint32_t sampling() { return _sampling.load( std::memory_order_relaxed ); }
+      static bool     enabled()  { return sampling() != 0; }
+
+      /** the number of spans each thread keeps, for threads that record their first span afterwards */
+      static void     set_buffer_size( uint32_t spans );
+
+      /** @return a copy of @ref name that lives as long as the process */
+      static const char* intern( const std::string& name );
+
+      /** microseconds since the epoch */
+      static int64_t  now();
+      /** records a span timed by the caller, if the span this thread is in is sampled */
+      static void     record( const char* name, int64_t start, int64_t end );
+
+      /** writes the recorded spans as a Chrome trace JSON object */
+      static void        write_chrome_trace( std::ostream& out );
+      static std::string chrome_trace();
+      /** forgets every span recorded so far */
+      static void        clear();
+
+   private:
+      friend class trace_span;
+      /** @return true if the span beginning now is sampled */
+      static bool begin_span();
+      static void end_span( const char* name, int64_t start, bool sampled );
+
+      static std::atomic<uint32_t> _sampling;
+};
+
+/** a span from its construction to its destruction, see tracer */
+class trace_span
+{
+   public:
+      explicit trace_span( const char* name ) : _name( name )
+      {
+         if( tracer::enabled() )
+         {
+            _tracked = true;
+            _sampled = tracer::begin_span();
+            if( _sampled )
+               _start = tracer::now();
+         }
+      }
+      ~trace_span()
+      {
+         if( _tracked )
+            tracer::end_span( _name, _start, _sampled );
+      }
+
+      trace_span( const trace_span& ) = delete;
+      trace_span& operator = ( const trace_span& ) = delete;
+
+   private:
+      const char* _name;
+      int64_t     _start   = 0;
+      bool        _tracked = false;
+      bool        _sampled = false;
+};
+
+} } // graphene::utilities
+
+#define GRAPHENE_TRACE_SPAN_VARIABLE2( line ) graphene_trace_span_ ## line
+#define GRAPHENE_TRACE_SPAN_VARIABLE( line ) GRAPHENE_TRACE_SPAN_VARIABLE2( line )
+/** traces the rest of the enclosing scope as a span named @ref name */
+#define GRAPHENE_TRACE_SPAN( name ) \
+   graphene::utilities::trace_span GRAPHENE_TRACE_SPAN_VARIABLE( __LINE__ )( name )
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/metrics.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace graphene { namespace utilities {
+
+metrics_histogram::metrics_histogram( std::vector<double> upper_bounds )
+   : _bounds( std::move(upper_bounds) ), _buckets( new std::atomic<uint64_t>[ _bounds.size() + 1 ] )
+{
+   for( size_t i = 0; i <= _bounds.size(); ++i )
+      _buckets[i].store( 0, std::memory_order_relaxed );
+}
+
+void metrics_histogram::observe( double value )
+{
+   const size_t i = std::lower_bound( _bounds.begin(), _bounds.end(), value ) - _bounds.begin();
+   _buckets[i].fetch_add( 1, std::memory_order_relaxed );
+   _count.fetch_add( 1, std::memory_order_relaxed );
+   double sum = _sum.load( std::memory_order_relaxed );
+   while( !_sum.compare_exchange_weak( sum, sum + value, std::memory_order_relaxed ) )
+      ;
+}
+
+metrics_registry::family& metrics_registry::get_family( const std::string& name, const std::string& help,
+                                                        const char* type )
+{
+   family& f = _families[name];
+   if( f.type.empty() )
+   {
+      f.help = help;
+      f.type = type;
+   }
+   else if( f.type != type )
+      throw std::logic_error( "metric " + name + " is registered as a " + f.type );
+   return f;
+}
+
+metrics_counter& metrics_registry::counter( const std::string& name, const std::string& help, const std::string& labels )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   std::unique_ptr<metrics_counter>& result = get_family( name, help, "counter" ).counters[labels];
+   if( !result )
+      result.reset( new metrics_counter );
+   return *result;
+}
+
+metrics_histogram& metrics_registry::histogram( const std::string& name, const std::string& help,
+                                                const std::vector<double>& upper_bounds, const std::string& labels )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   std::unique_ptr<metrics_histogram>& result = get_family( name, help, "histogram" ).histograms[labels];
+   if( !result )
+      result.reset( new metrics_histogram( upper_bounds ) );
+   return *result;
+}
+
+void metrics_registry::add_gauge( const std::string& name, const std::string& help, std::function<double()> read,
+                                  const std::string& labels )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   get_family( name, help, "gauge" ).gauges[labels] = std::move(read);
+}
+
+void metrics_registry::add_collector( std::function<void(std::ostream&)> collector )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _collectors.push_back( std::move(collector) );
+}
+
+std::vector<double> metrics_registry::latency_buckets()
+{
+   return { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+}
+
+namespace {
+   std::string label_set( const std::string& labels, const std::string& more = std::string() )
+   {
+      if( labels.empty() && more.empty() )
+         return std::string();
+      if( labels.empty() || more.empty() )
+         return "{" + labels + more + "}";
+      return "{" + labels + "," + more + "}";
+   }
+}
+
+std::string metrics_registry::render()const
+{
+   std::ostringstream out;
+   out.precision( 17 );
+   // gauges and collectors are read without the lock, they may wait for threads that look up metrics meanwhile;
+   // the HELP and TYPE lines of each gauge family with its samples
+   std::vector< std::pair< std::string, std::vector< std::pair< std::string, std::function<double()> > > > > gauges;
+   std::vector< std::function<void(std::ostream&)> > collectors;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      for( const auto& item : _families )
+      {
+         const std::string& name = item.first;
+         const family& f = item.second;
+         if( !f.gauges.empty() )
+         {
+            gauges.emplace_back( "# HELP " + name + ' ' + f.help + "\n# TYPE " + name + ' ' + f.type + '\n',
+                                 std::vector< std::pair< std::string, std::function<double()> > >() );
+            for( const auto& gauge : f.gauges )
+               gauges.back().second.emplace_back( name + label_set( gauge.first ), gauge.second );
+            continue;
+         }
+         out << "# HELP " << name << ' ' << f.help << '\n'
+             << "# TYPE " << name << ' ' << f.type << '\n';
+         for( const auto& counter : f.counters )
+            out << name << label_set( counter.first ) << ' ' << counter.second->value() << '\n';
+         for( const auto& histogram : f.histograms )
+         {
+            const metrics_histogram& h = *histogram.second;
+            uint64_t cumulative = 0;
+            for( size_t i = 0; i < h.upper_bounds().size(); ++i )
+            {
+               cumulative += h.bucket(i);
+               std::ostringstream bound;
+               bound << h.upper_bounds()[i];
+               out << name << "_bucket" << label_set( histogram.first, "le=\"" + bound.str() + "\"" ) << ' '
+                   << cumulative << '\n';
+            }
+            cumulative += h.bucket( h.upper_bounds().size() );
+            out << name << "_bucket" << label_set( histogram.first, "le=\"+Inf\"" ) << ' ' << cumulative << '\n'
+                << name << "_sum" << label_set( histogram.first ) << ' ' << h.sum() << '\n'
+                << name << "_count" << label_set( histogram.first ) << ' ' << cumulative << '\n';
+         }
+      }
+      collectors = _collectors;
+   }
+   for( const auto& gauge_family : gauges )
+   {
+      out << gauge_family.first;
+      for( const auto& gauge : gauge_family.second )
+         out << gauge.first << ' ' << gauge.second() << '\n';
+   }
+   for( const auto& collector : collectors )
+      collector( out );
+   return out.str();
+}
+
+} } // graphene::utilities
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/trace.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+namespace {
+
+struct span_record
+{
+   const char* name     = nullptr;
+   int64_t     start    = 0;
+   int64_t     duration = 0;
+};
+
+struct thread_trace
+{
+   thread_trace( uint32_t capacity, uint64_t id ) : spans( capacity ), thread_id( id ) {}
+
+   /** guards spans and recorded between the thread and the writers of the trace */
+   std::mutex                 mutex;
+   std::vector<span_record>   spans;
+   /** spans recorded in all, the newest is at ( recorded - 1 ) % spans.size() */
+   uint64_t                   recorded = 0;
+   const uint64_t             thread_id;
+
+   // used by the thread itself only
+   uint32_t                   depth   = 0;
+   uint32_t                   roots   = 0;
+   bool                       sampled = false;
+};
+
+std::atomic<uint32_t> buffer_size{ 65536 };
+
+std::mutex& registry_mutex()
+{
+   static std::mutex m;
+   return m;
+}
+
+/** the buffers of all threads that ever recorded a span, those of finished threads are still written out */
+std::vector< std::shared_ptr<thread_trace> >& registry()
+{
+   static std::vector< std::shared_ptr<thread_trace> > threads;
+   return threads;
+}
+
+thread_trace& local_trace()
+{
+   static thread_local std::shared_ptr<thread_trace> local;
+   if( !local )
+   {
+      std::lock_guard<std::mutex> lock( registry_mutex() );
+      local = std::make_shared<thread_trace>( buffer_size.load( std::memory_order_relaxed ), registry().size() + 1 );
+      registry().push_back( local );
+   }
+   return *local;
+}
+
+/** decides whether a span that is not nested in another is sampled */
+bool sample_root( thread_trace& t )
+{
+   const uint32_t one_in = tracer::sampling();
+   return one_in != 0 && t.roots++ % one_in == 0;
+}
+
+void store( thread_trace& t, const char* name, int64_t start, int64_t duration )
+{
+   std::lock_guard<std::mutex> lock( t.mutex );
+   span_record& r = t.spans[ t.recorded % t.spans.size() ];
+   r.name     = name;
+   r.start    = start;
+   r.duration = duration;
+   ++t.recorded;
+}
+
+void write_json_string( std::ostream& out, const char* s )
+{
+   out << '"';
+   for( ; *s; ++s )
+   {
+      const unsigned char c = *s;
+      if( c == '"' || c == '\\' )
+         out << '\\' << char(c);
+      else if( c < 0x20 )
+         out << ' ';
+      else
+         out << char(c);
+   }
+   out << '"';
+}
+
+}
+
+std::atomic<uint32_t> tracer::_sampling{ 0 };
+
+void tracer::set_sampling( uint32_t one_in )
+{
+   _sampling.store( one_in, std::memory_order_relaxed );
+}
+
+void tracer::set_buffer_size( uint32_t spans )
+{
+   buffer_size.store( spans > 0 ? spans : 1, std::memory_order_relaxed );
+}
+
+const char* tracer::intern( const std::string& name )
+{
+   static std::mutex m;
+   static std::set<std::string> names;
+   std::lock_guard<std::mutex> lock( m );
+   return names.insert( name ).first->c_str();
+}
+
+int64_t tracer::now()
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+bool tracer::begin_span()
+{
+   thread_trace& t = local_trace();
+   if( t.depth++ == 0 )
+      t.sampled = sample_root( t );
+   return t.sampled;
+}
+
+void tracer::end_span( const char* name, int64_t start, bool sampled )
+{
+   thread_trace& t = local_trace();
+   if( t.depth > 0 )
+      --t.depth;
+   if( sampled )
+      store( t, name, start, now() - start );
+}
+
+void tracer::record( const char* name, int64_t start, int64_t end )
+{
+   if( !enabled() )
+      return;
+   thread_trace& t = local_trace();
+   if( t.depth > 0 ? t.sampled : sample_root( t ) )
+      store( t, name, start, end - start );
+}
+
+void tracer::write_chrome_trace( std::ostream& out )
+{
+   std::vector< std::shared_ptr<thread_trace> > threads;
+   {
+      std::lock_guard<std::mutex> lock( registry_mutex() );
+      threads = registry();
+   }
+
+   out << "{\"traceEvents\":[";
+   bool first = true;
+   for( const auto& t : threads )
+   {
+      std::lock_guard<std::mutex> lock( t->mutex );
+      const uint64_t size = t->spans.size();
+      for( uint64_t i = t->recorded > size ? t->recorded - size : 0; i < t->recorded; ++i )
+      {
+         const span_record& r = t->spans[ i % size ];
+         out << ( first ? "" : "," ) << "\n{\"name\":";
+         write_json_string( out, r.name );
+         out << ",\"cat\":\"graphene\",\"ph\":\"X\",\"ts\":" << r.start << ",\"dur\":" << r.duration
+             << ",\"pid\":1,\"tid\":" << t->thread_id << '}';
+         first = false;
+      }
+   }
+   out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::string tracer::chrome_trace()
+{
+   std::ostringstream out;
+   write_chrome_trace( out );
+   return out.str();
+}
+
+void tracer::clear()
+{
+   std::lock_guard<std::mutex> lock( registry_mutex() );
+   for( const auto& t : registry() )
+   {
+      std::lock_guard<std::mutex> thread_lock( t->mutex );
+      t->recorded = 0;
+   }
+}
+
+} } // graphene::utilities
@@ -54,6 +54,24 @@ struct plain_keys
    fc::sha512                    checksum;
 };
 
+/**
+ * A change appended to the journal kept next to the wallet file.  The wallet file is a snapshot and saving
+ * only appends what changed since; loading applies the journal records on top of the snapshot in order.
+ */
+struct wallet_journal_record
+{
+   enum kind_type
+   {
+      wallet_state = 0, ///< a wallet_data in JSON without keys, key labels and blind receipts, replacing the rest
+      key_batch    = 1, ///< the keys added since the previous batch, encrypted like wallet_data::cipher_keys
+      key_label    = 2, ///< a key_label, replacing the label of its key
+      receipt      = 3  ///< a blind_receipt, replacing the receipt with the same commitment
+   };
+
+   uint8_t      kind = wallet_state;
+   vector<char> data;
+};
+
 struct brain_key_info
 {
    string brain_priv_key;
@@ -179,6 +197,8 @@ struct wallet_data
 
    /** encrypted keys */
    vector<char>              cipher_keys;
+   /** keys saved to the journal since cipher_keys was written, each batch encrypted like cipher_keys */
+   vector< vector<char> >    cipher_key_batches;
 
    /** map an account to a set of extra keys that have been imported for that account */
    map<account_id_type, set<public_key_type> >  extra_keys;
@@ -262,6 +282,14 @@ struct operation_detail {
    operation_history_object op;
 };
 
+/** One payment of a transfer_many() batch */
+struct transfer_order {
+   string to;            ///< name or id of the receiving account
+   string amount;        ///< the amount in nominal units
+   string asset_symbol;  ///< symbol or id of the asset to send
+   string memo;          ///< encrypted for the receiver, no memo if empty
+};
+
 /**
  * This wallet assumes it is connected to the database server with a high-bandwidth, low-latency connection and
  * performs minimal caching. This API could be provided locally to be used by a web interface.
@@ -607,6 +635,9 @@ class wallet_api
       /**
        * This call will construct transaction(s) that will claim all balances controled
        * by wif_keys and deposit them into the given account.
+       *
+       * Thousands of keys can be imported at once: the claims are packed into as few transactions as the
+       * maximum transaction size allows, and when broadcasting all of them are sent in a single call.
        */
       vector< signed_transaction > import_balance( string account_name_or_id, const vector<string>& wif_keys, bool broadcast );
 
@@ -720,6 +751,22 @@ class wallet_api
          return std::make_pair(trx.id(),trx);
       }
 
+      /** Send many payments from one account with as few transactions as possible.
+       *
+       * The transfers are packed in order into transactions as large as the chain's maximum transaction
+       * size allows, each signed once.  When broadcasting, all transactions are sent to the node in one
+       * call; a transaction the node rejects does not keep the others from being broadcast, but the call
+       * fails afterwards listing the rejected ones.
+       *
+       * @param from the name or id of the account sending the funds
+       * @param transfers the payments to make
+       * @param broadcast true to broadcast the transactions on the network
+       * @returns the signed transactions, in the order of the payments they contain
+       */
+      vector<signed_transaction> transfer_many(string from,
+                                               vector<transfer_order> transfers,
+                                               bool broadcast = false);
+
 
       /**
        *  This method is used to convert a JSON transaction to its transactin ID.
@@ -1488,10 +1535,13 @@ FC_REFLECT( graphene::wallet::blind_confirmation, (trx)(outputs) )
 
 FC_REFLECT( graphene::wallet::plain_keys, (keys)(checksum) )
 
+FC_REFLECT( graphene::wallet::wallet_journal_record, (kind)(data) )
+
 FC_REFLECT( graphene::wallet::wallet_data,
             (chain_id)
             (my_accounts)
             (cipher_keys)
+            (cipher_key_batches)
             (extra_keys)
             (pending_account_registrations)(pending_witness_registrations)
             (labeled_keys)
@@ -1538,6 +1588,8 @@ FC_REFLECT_DERIVED( graphene::wallet::vesting_balance_object_with_info, (graphen
 FC_REFLECT( graphene::wallet::operation_detail, 
             (memo)(description)(op) )
 
+FC_REFLECT( graphene::wallet::transfer_order, (to)(amount)(asset_symbol)(memo) )
+
 FC_API( graphene::wallet::wallet_api,
         (help)
         (gethelp)
@@ -1575,6 +1627,7 @@ FC_API( graphene::wallet::wallet_api,
         (cancel_order)
         (transfer)
         (transfer2)
+        (transfer_many)
         (get_transaction_id)
         (create_asset)
         (update_asset)
@@ -23,12 +23,16 @@
  */
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <sstream>
 #include <string>
 #include <list>
+#include <thread>
 
 #include <boost/version.hpp>
 #include <boost/lexical_cast.hpp>
@@ -59,6 +63,7 @@
 #include <fc/crypto/hex.hpp>
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <graphene/app/api.hpp>
 #include <graphene/chain/asset_object.hpp>
@@ -439,11 +444,22 @@ public:
          data.checksum = _checksum;
          auto plain_txt = fc::raw::pack(data);
          _wallet.cipher_keys = fc::aes_encrypt( data.checksum, plain_txt );
+         _wallet.cipher_key_batches.clear();
       }
    }
 
+   void clear_chain_caches()
+   {
+      _global_properties_cache.reset();
+      _account_cache.clear();
+      _account_name_cache.clear();
+      _asset_cache.clear();
+      _asset_symbol_cache.clear();
+   }
+
    void on_block_applied( const variant& block_id )
    {
+      clear_chain_caches();
       fc::async([this]{resync();}, "Resync after block");
    }
 
@@ -470,6 +486,8 @@ public:
          if( !fc::exists( dest_parent ) )
             fc::create_directories( dest_parent );
          fc::copy( src_path, dest_path );
+         if( fc::exists( journal_filename( src_path.generic_string() ) ) )
+            fc::copy( journal_filename( src_path.generic_string() ), journal_filename( dest_path.generic_string() ) );
          disable_umask_protection();
       }
       catch(...)
@@ -557,17 +575,87 @@ public:
    }
    global_property_object get_global_properties() const
    {
-      return _remote_db->get_global_properties();
+      if( !_global_properties_cache )
+         _global_properties_cache = _remote_db->get_global_properties();
+      return *_global_properties_cache;
    }
    dynamic_global_property_object get_dynamic_global_properties() const
    {
       return _remote_db->get_dynamic_global_properties();
    }
+   void uncache_account( account_id_type id ) const
+   {
+      auto itr = _account_cache.find( id );
+      if( itr == _account_cache.end() )
+         return;
+      _account_name_cache.erase( itr->second.name );
+      _account_cache.erase( itr );
+   }
+   void cache_account( const account_object& account ) const
+   {
+      _account_name_cache[ account.name ] = account.id;
+      _account_cache[ account.id ] = account;
+   }
+   /** the accounts with the given ids in order, those not cached yet are fetched in one call */
+   vector< optional<account_object> > find_accounts( const vector<account_id_type>& ids ) const
+   {
+      vector<account_id_type> missing;
+      for( const auto& id : ids )
+         if( !_account_cache.count( id ) )
+            missing.push_back( id );
+      if( !missing.empty() )
+         for( const auto& account : _remote_db->get_accounts( missing ) )
+            if( account )
+               cache_account( *account );
+
+      vector< optional<account_object> > result;
+      result.reserve( ids.size() );
+      for( const auto& id : ids )
+      {
+         auto itr = _account_cache.find( id );
+         result.push_back( itr != _account_cache.end() ? optional<account_object>( itr->second ) : optional<account_object>() );
+      }
+      return result;
+   }
+   /** fetches the named accounts that are not cached yet with one call for names and one for ids */
+   void prefetch_accounts( const vector<string>& account_names_or_ids ) const
+   {
+      vector<account_id_type> ids;
+      vector<string> names;
+      for( const auto& name_or_id : account_names_or_ids )
+      {
+         if( name_or_id.empty() )
+            continue;
+         if( auto id = maybe_id<account_id_type>( name_or_id ) )
+            ids.push_back( *id );
+         else if( !_account_name_cache.count( name_or_id ) )
+            names.push_back( name_or_id );
+      }
+      if( !ids.empty() )
+         find_accounts( ids );
+      if( !names.empty() )
+         for( const auto& account : _remote_db->lookup_account_names( names ) )
+            if( account )
+               cache_account( *account );
+   }
+   optional<account_object> find_account_by_name( const string& name ) const
+   {
+      auto itr = _account_name_cache.find( name );
+      if( itr == _account_name_cache.end() )
+      {
+         auto rec = _remote_db->lookup_account_names( {name} ).front();
+         if( !rec || rec->name != name )
+            return optional<account_object>();
+         cache_account( *rec );
+         itr = _account_name_cache.find( name );
+      }
+      return _account_cache.at( itr->second );
+   }
    account_object get_account(account_id_type id) const
    {
       if( _wallet.my_accounts.get<by_id>().count(id) )
          return *_wallet.my_accounts.get<by_id>().find(id);
-      auto rec = _remote_db->get_accounts({id}).front();
+      auto rec = find_accounts({id}).front();
       FC_ASSERT(rec);
       return *rec;
    }
@@ -584,7 +672,7 @@ public:
          if( _wallet.my_accounts.get<by_name>().count(account_name_or_id) )
          {
             auto local_account = *_wallet.my_accounts.get<by_name>().find(account_name_or_id);
-            auto blockchain_account = _remote_db->lookup_account_names({account_name_or_id}).front();
+            auto blockchain_account = find_account_by_name( account_name_or_id );
             FC_ASSERT( blockchain_account );
             if (local_account.id != blockchain_account->id)
                elog("my account id ${id} different from blockchain id ${id2}", ("id", local_account.id)("id2", blockchain_account->id));
@@ -593,7 +681,7 @@ public:
 
             return *_wallet.my_accounts.get<by_name>().find(account_name_or_id);
          }
-         auto rec = _remote_db->lookup_account_names({account_name_or_id}).front();
+         auto rec = find_account_by_name( account_name_or_id );
          FC_ASSERT( rec && rec->name == account_name_or_id );
          return *rec;
       }
@@ -602,11 +690,51 @@ public:
    {
       return get_account(account_name_or_id).get_id();
    }
+   void cache_asset( const asset_object& asset ) const
+   {
+      _asset_symbol_cache[ asset.symbol ] = asset.id;
+      _asset_cache[ asset.id ] = asset;
+   }
+   /** fetches the assets with the given ids that are not cached yet in one call */
+   void prefetch_asset_ids( const vector<asset_id_type>& ids ) const
+   {
+      vector<asset_id_type> missing;
+      for( const auto& id : ids )
+         if( !_asset_cache.count( id ) )
+            missing.push_back( id );
+      if( !missing.empty() )
+         for( const auto& asset : _remote_db->get_assets( missing ) )
+            if( asset )
+               cache_asset( *asset );
+   }
+   /** fetches the assets that are not cached yet with one call for symbols and one for ids */
+   void prefetch_assets( const vector<string>& asset_symbols_or_ids ) const
+   {
+      vector<asset_id_type> ids;
+      vector<string> symbols;
+      for( const auto& symbol_or_id : asset_symbols_or_ids )
+      {
+         if( symbol_or_id.empty() )
+            continue;
+         if( auto id = maybe_id<asset_id_type>( symbol_or_id ) )
+            ids.push_back( *id );
+         else if( !_asset_symbol_cache.count( symbol_or_id ) )
+            symbols.push_back( symbol_or_id );
+      }
+      prefetch_asset_ids( ids );
+      if( !symbols.empty() )
+         for( const auto& asset : _remote_db->lookup_asset_symbols( symbols ) )
+            if( asset )
+               cache_asset( *asset );
+   }
    optional<asset_object> find_asset(asset_id_type id)const
    {
+      auto itr = _asset_cache.find( id );
+      if( itr != _asset_cache.end() )
+         return itr->second;
       auto rec = _remote_db->get_assets({id}).front();
       if( rec )
-         _asset_cache[id] = *rec;
+         cache_asset( *rec );
       return rec;
    }
    optional<asset_object> find_asset(string asset_symbol_or_id)const
@@ -619,13 +747,16 @@ public:
          return find_asset(*id);
       } else {
          // It's a symbol
+         auto itr = _asset_symbol_cache.find( asset_symbol_or_id );
+         if( itr != _asset_symbol_cache.end() )
+            return _asset_cache.at( itr->second );
          auto rec = _remote_db->lookup_asset_symbols({asset_symbol_or_id}).front();
          if( rec )
          {
             if( rec->symbol != asset_symbol_or_id )
                return optional<asset_object>();
 
-            _asset_cache[rec->get_id()] = *rec;
+            cache_asset( *rec );
          }
          return rec;
       }
@@ -646,12 +777,11 @@ public:
    asset_id_type get_asset_id(string asset_symbol_or_id) const
    {
       FC_ASSERT( asset_symbol_or_id.size() > 0 );
-      vector<optional<asset_object>> opt_asset;
       if( std::isdigit( asset_symbol_or_id.front() ) )
          return fc::variant(asset_symbol_or_id).as<asset_id_type>();
-      opt_asset = _remote_db->lookup_asset_symbols( {asset_symbol_or_id} );
-      FC_ASSERT( (opt_asset.size() > 0) && (opt_asset[0].valid()) );
-      return opt_asset[0]->id;
+      auto opt_asset = find_asset( asset_symbol_or_id );
+      FC_ASSERT( opt_asset.valid() );
+      return opt_asset->id;
    }
 
    string                            get_wallet_filename() const
@@ -719,12 +849,22 @@ public:
       if( ! fc::exists( wallet_filename ) )
          return false;
 
-      _wallet = fc::json::from_file( wallet_filename ).as< wallet_data >();
+      string snapshot;
+      fc::read_file_contents( fc::path( wallet_filename ), snapshot );
+      _wallet = fc::json::from_string( snapshot ).as< wallet_data >();
       if( _wallet.chain_id != _chain_id )
          FC_THROW( "Wallet chain ID does not match",
             ("wallet.chain_id", _wallet.chain_id)
             ("chain_id", _chain_id) );
 
+      const fc::sha256 snapshot_hash = fc::sha256::hash( snapshot );
+      _compact_wallet_on_save = wallet_filename != _wallet_filename;
+      replay_wallet_journal( wallet_filename, snapshot_hash );
+      _snapshot_hash = snapshot_hash;
+      _snapshot_bytes = snapshot.size();
+      _snapshot_connection_settings = wallet_connection_settings();
+      mark_wallet_persisted();
+
       size_t account_pagination = 100;
       vector< account_id_type > account_ids_to_send;
       size_t n = _wallet.my_accounts.size();
@@ -772,6 +912,21 @@ public:
       return true;
    }
    void save_wallet_file(string wallet_filename = "")
+   {
+      if( wallet_filename == "" )
+         wallet_filename = _wallet_filename;
+
+      // the journal only holds changes since the snapshot it belongs to, so anything else needs a new snapshot,
+      // as does a journal grown larger than the snapshot, which would make loading slower than a rewrite
+      if( wallet_filename != _wallet_filename || _compact_wallet_on_save || !fc::exists( wallet_filename )
+          || wallet_connection_settings() != _snapshot_connection_settings
+          || _journal_bytes > std::max<uint64_t>( _snapshot_bytes, 1024 * 1024 ) )
+         save_wallet_snapshot( wallet_filename );
+      else
+         append_wallet_journal();
+   }
+
+   void save_wallet_snapshot( const string& wallet_filename )
    {
       //
       // Serialize in memory, then save to disk
@@ -782,9 +937,6 @@ public:
 
       encrypt_keys();
 
-      if( wallet_filename == "" )
-         wallet_filename = _wallet_filename;
-
       wlog( "saving wallet to file ${fn}", ("fn", wallet_filename) );
 
       string data = fc::json::to_pretty_string( _wallet );
@@ -797,17 +949,261 @@ public:
          //
          // http://en.wikipedia.org/wiki/Most_vexing_parse
          //
-         fc::ofstream outfile{ fc::path( wallet_filename ) };
+         // The snapshot is written beside the wallet and renamed over it, so that a crash leaves either the old
+         // or the new wallet.  A journal left over from the old one no longer matches and is ignored on load.
+         //
+         const fc::path temp_filename( wallet_filename + ".tmp" );
+         fc::ofstream outfile{ temp_filename };
          outfile.write( data.c_str(), data.length() );
          outfile.flush();
          outfile.close();
+         fc::rename( temp_filename, fc::path( wallet_filename ) );
+         if( fc::exists( journal_filename( wallet_filename ) ) )
+            fc::remove( journal_filename( wallet_filename ) );
+         disable_umask_protection();
+      }
+      catch(...)
+      {
+         disable_umask_protection();
+         throw;
+      }
+
+      if( wallet_filename == _wallet_filename )
+      {
+         _snapshot_hash = fc::sha256::hash( data );
+         _snapshot_bytes = data.size();
+         _journal_bytes = 0;
+         _compact_wallet_on_save = false;
+         _snapshot_connection_settings = wallet_connection_settings();
+         mark_wallet_persisted();
+      }
+   }
+
+   /** appends what changed since the wallet was last loaded or saved to its journal */
+   void append_wallet_journal()
+   {
+      vector<char> out;
+      size_t record_count = 0;
+      auto add_record = [&]( uint8_t kind, vector<char> data ) {
+         wallet_journal_record record;
+         record.kind = kind;
+         record.data = std::move( data );
+         vector<char> payload = fc::raw::pack( record );
+         vector<char> check = fc::raw::pack( fc::sha256::hash( payload.data(), payload.size() ) );
+         vector<char> framed = fc::raw::pack( payload );
+         out.insert( out.end(), check.begin(), check.end() );
+         out.insert( out.end(), framed.begin(), framed.end() );
+         ++record_count;
+      };
+
+      map<public_key_type, string> new_keys;
+      if( !is_locked() )
+         for( const auto& key : _keys )
+            if( !_persisted_keys.count( key.first ) )
+               new_keys.insert( key );
+      vector<char> key_batch;
+      if( !new_keys.empty() )
+      {
+         plain_keys batch;
+         batch.keys = new_keys;
+         batch.checksum = _checksum;
+         key_batch = fc::aes_encrypt( batch.checksum, fc::raw::pack( batch ) );
+         add_record( wallet_journal_record::key_batch, key_batch );
+      }
+
+      string state = fc::json::to_string( wallet_state() );
+      fc::sha256 state_hash = fc::sha256::hash( state );
+      if( state_hash != _persisted_state_hash )
+         add_record( wallet_journal_record::wallet_state, vector<char>( state.begin(), state.end() ) );
+
+      vector<const key_label*> changed_labels;
+      for( const auto& label : _wallet.labeled_keys )
+      {
+         auto itr = _persisted_labels.find( label.key );
+         if( itr != _persisted_labels.end() && itr->second == label.label )
+            continue;
+         add_record( wallet_journal_record::key_label, fc::raw::pack( label ) );
+         changed_labels.push_back( &label );
+      }
+
+      vector< std::pair<commitment_type, fc::sha256> > changed_receipts;
+      for( const auto& receipt : _wallet.blind_receipts )
+      {
+         vector<char> packed = fc::raw::pack( receipt );
+         fc::sha256 receipt_hash = fc::sha256::hash( packed.data(), packed.size() );
+         auto itr = _persisted_receipts.find( receipt.commitment() );
+         if( itr != _persisted_receipts.end() && itr->second == receipt_hash )
+            continue;
+         add_record( wallet_journal_record::receipt, std::move( packed ) );
+         changed_receipts.emplace_back( receipt.commitment(), receipt_hash );
+      }
+
+      if( record_count == 0 )
+         return;
+
+      const string journal = journal_filename( _wallet_filename );
+      wlog( "saving ${n} changes to wallet journal ${fn}", ("n", record_count)("fn", journal) );
+      try
+      {
+         enable_umask_protection();
+         const bool new_journal = !fc::exists( journal );
+         std::ofstream outfile( journal, std::ios::binary | std::ios::app );
+         if( new_journal )
+            outfile.write( _snapshot_hash.data(), _snapshot_hash.data_size() );
+         outfile.write( out.data(), out.size() );
+         outfile.flush();
+         FC_ASSERT( outfile.good(), "Unable to write wallet journal ${fn}", ("fn", journal) );
+         outfile.close();
          disable_umask_protection();
+         if( new_journal )
+            _journal_bytes += _snapshot_hash.data_size();
       }
       catch(...)
       {
          disable_umask_protection();
+         // a partly written record must not be followed by more
+         _compact_wallet_on_save = true;
          throw;
       }
+
+      _journal_bytes += out.size();
+      for( const auto& key : new_keys )
+         _persisted_keys.insert( key.first );
+      if( !key_batch.empty() )
+         _wallet.cipher_key_batches.push_back( std::move( key_batch ) );
+      _persisted_state_hash = state_hash;
+      for( const key_label* label : changed_labels )
+         _persisted_labels[ label->key ] = label->label;
+      for( const auto& receipt : changed_receipts )
+         _persisted_receipts[ receipt.first ] = receipt.second;
+   }
+
+   string journal_filename( const string& wallet_filename )const
+   {
+      return wallet_filename + ".journal";
+   }
+
+   string wallet_connection_settings()const
+   {
+      return _wallet.ws_server + '\n' + _wallet.ws_user + '\n' + _wallet.ws_password;
+   }
+
+   /** the fields of _wallet that a wallet_state journal record replaces */
+   wallet_data wallet_state()const
+   {
+      wallet_data state;
+      state.chain_id = _wallet.chain_id;
+      state.my_accounts = _wallet.my_accounts;
+      state.extra_keys = _wallet.extra_keys;
+      state.pending_account_registrations = _wallet.pending_account_registrations;
+      state.pending_witness_registrations = _wallet.pending_witness_registrations;
+      state.ws_server = _wallet.ws_server;
+      state.ws_user = _wallet.ws_user;
+      state.ws_password = _wallet.ws_password;
+      return state;
+   }
+
+   /** records that everything in _wallet is on disk, so the next journal save starts from here */
+   void mark_wallet_persisted()
+   {
+      _persisted_state_hash = fc::sha256::hash( fc::json::to_string( wallet_state() ) );
+      _persisted_labels.clear();
+      for( const auto& label : _wallet.labeled_keys )
+         _persisted_labels[ label.key ] = label.label;
+      _persisted_receipts.clear();
+      for( const auto& receipt : _wallet.blind_receipts )
+      {
+         vector<char> packed = fc::raw::pack( receipt );
+         _persisted_receipts[ receipt.commitment() ] = fc::sha256::hash( packed.data(), packed.size() );
+      }
+      // while locked, the keys on disk are only known once the wallet is unlocked
+      _persisted_keys.clear();
+      for( const auto& key : _keys )
+         _persisted_keys.insert( key.first );
+      _persisted_keys_known = !is_locked();
+   }
+
+   void apply_journal_record( const wallet_journal_record& record )
+   {
+      switch( record.kind )
+      {
+         case wallet_journal_record::wallet_state:
+         {
+            auto state = fc::json::from_string( string( record.data.begin(), record.data.end() ) ).as< wallet_data >();
+            _wallet.chain_id = state.chain_id;
+            _wallet.my_accounts = state.my_accounts;
+            _wallet.extra_keys = state.extra_keys;
+            _wallet.pending_account_registrations = state.pending_account_registrations;
+            _wallet.pending_witness_registrations = state.pending_witness_registrations;
+            _wallet.ws_server = state.ws_server;
+            _wallet.ws_user = state.ws_user;
+            _wallet.ws_password = state.ws_password;
+            break;
+         }
+         case wallet_journal_record::key_batch:
+            _wallet.cipher_key_batches.push_back( record.data );
+            break;
+         case wallet_journal_record::key_label:
+         {
+            auto label = fc::raw::unpack< key_label >( record.data );
+            _wallet.labeled_keys.get<by_key>().erase( label.key );
+            _wallet.labeled_keys.get<by_label>().erase( label.label );
+            _wallet.labeled_keys.insert( label );
+            break;
+         }
+         case wallet_journal_record::receipt:
+         {
+            auto receipt = fc::raw::unpack< blind_receipt >( record.data );
+            _wallet.blind_receipts.get<by_commitment>().erase( receipt.commitment() );
+            _wallet.blind_receipts.insert( receipt );
+            break;
+         }
+         default:
+            FC_THROW( "Unknown wallet journal record kind ${k}", ("k", record.kind) );
+      }
+   }
+
+   /** applies the journal of the snapshot just loaded, up to the first incomplete or damaged record */
+   void replay_wallet_journal( const string& wallet_filename, const fc::sha256& snapshot_hash )
+   {
+      _journal_bytes = 0;
+      const string journal = journal_filename( wallet_filename );
+      if( !fc::exists( journal ) )
+         return;
+
+      string contents;
+      fc::read_file_contents( fc::path( journal ), contents );
+      if( contents.size() < snapshot_hash.data_size()
+          || memcmp( contents.data(), snapshot_hash.data(), snapshot_hash.data_size() ) != 0 )
+      {
+         wlog( "Ignoring wallet journal ${fn} left over from an older wallet file", ("fn", journal) );
+         _compact_wallet_on_save = true;
+         return;
+      }
+
+      fc::datastream<const char*> ds( contents.data() + snapshot_hash.data_size(),
+                                      contents.size() - snapshot_hash.data_size() );
+      size_t applied = 0;
+      try
+      {
+         while( ds.remaining() > 0 )
+         {
+            fc::sha256 check;
+            vector<char> payload;
+            fc::raw::unpack( ds, check );
+            fc::raw::unpack( ds, payload );
+            FC_ASSERT( fc::sha256::hash( payload.data(), payload.size() ) == check, "checksum mismatch" );
+            apply_journal_record( fc::raw::unpack< wallet_journal_record >( payload ) );
+            ++applied;
+         }
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Ignoring the end of wallet journal ${fn} after ${n} records: ${e}",
+               ("fn", journal)("n", applied)("e", e.to_detail_string()) );
+         _compact_wallet_on_save = true;
+      }
+      _journal_bytes = contents.size();
    }
 
    transaction_handle_type begin_builder_transaction()
@@ -838,7 +1234,7 @@ public:
       auto fee_asset_obj = get_asset(fee_asset);
       asset total_fee = fee_asset_obj.amount(0);
 
-      auto gprops = _remote_db->get_global_properties().parameters;
+      auto gprops = get_global_properties().parameters;
       if( fee_asset_obj.get_id() != asset_id_type() )
       {
          for( auto& op : _builder_transactions[handle].operations )
@@ -880,7 +1276,7 @@ public:
       if( review_period_seconds )
          op.review_period_seconds = review_period_seconds;
       trx.operations = {op};
-      _remote_db->get_global_properties().parameters.current_fees->set_fee( trx.operations.front() );
+      get_global_properties().parameters.current_fees->set_fee( trx.operations.front() );
 
       return trx = sign_transaction(trx, broadcast);
    }
@@ -901,7 +1297,7 @@ public:
       if( review_period_seconds )
          op.review_period_seconds = review_period_seconds;
       trx.operations = {op};
-      _remote_db->get_global_properties().parameters.current_fees->set_fee( trx.operations.front() );
+      get_global_properties().parameters.current_fees->set_fee( trx.operations.front() );
 
       return trx = sign_transaction(trx, broadcast);
    }
@@ -945,13 +1341,13 @@ public:
       account_create_op.name = name;
       account_create_op.owner = authority(1, owner, 1);
       account_create_op.active = authority(1, active, 1);
-      account_create_op.options.memo_key = active;
+      account_create_op.options->memo_key = active;
 
       signed_transaction tx;
 
       tx.operations.push_back( account_create_op );
 
-      auto current_fees = _remote_db->get_global_properties().parameters.current_fees;
+      auto current_fees = get_global_properties().parameters.current_fees;
       set_operation_fees( tx, current_fees );
 
       vector<public_key_type> paying_keys = registrar_account_object.active.get_keys();
@@ -992,7 +1388,7 @@ public:
       op.account_to_upgrade = account_obj.get_id();
       op.upgrade_to_lifetime_member = true;
       tx.operations = {op};
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      set_operation_fees( tx, get_global_properties().parameters.current_fees );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1067,7 +1463,7 @@ public:
          account_create_op.name = account_name;
          account_create_op.owner = authority(1, owner_pubkey, 1);
          account_create_op.active = authority(1, active_pubkey, 1);
-         account_create_op.options.memo_key = memo_pubkey;
+         account_create_op.options->memo_key = memo_pubkey;
 
          // current_fee_schedule()
          // find_account(pay_from_account)
@@ -1078,7 +1474,7 @@ public:
 
          tx.operations.push_back( account_create_op );
 
-         set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+         set_operation_fees( tx, get_global_properties().parameters.current_fees);
 
          vector<public_key_type> paying_keys = registrar_account_object.active.get_keys();
 
@@ -1143,7 +1539,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1172,7 +1568,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1193,7 +1589,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1217,7 +1613,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1239,7 +1635,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( publish_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1263,7 +1659,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( fund_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1285,7 +1681,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( reserve_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1306,7 +1702,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( settle_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1327,7 +1723,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( settle_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1345,7 +1741,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( whitelist_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1363,7 +1759,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( committee_member_create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1459,7 +1855,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( witness_create_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       _wallet.pending_witness_registrations[owner_account] = key_to_wif(witness_private_key);
@@ -1486,7 +1882,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( witness_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      set_operation_fees( tx, get_global_properties().parameters.current_fees );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1537,7 +1933,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      set_operation_fees( tx, get_global_properties().parameters.current_fees );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1602,7 +1998,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      set_operation_fees( tx, get_global_properties().parameters.current_fees );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1660,7 +2056,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( vesting_balance_withdraw_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      set_operation_fees( tx, get_global_properties().parameters.current_fees );
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1695,7 +2091,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1729,7 +2125,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1760,7 +2156,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1786,7 +2182,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back( account_update_op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1815,7 +2211,7 @@ public:
       /// TODO: fetch the accounts specified via other_auths as well.
 
       vector< optional<account_object> > approving_account_objects =
-            _remote_db->get_accounts( v_approving_account_ids );
+            find_accounts( v_approving_account_ids );
 
       /// TODO: recursively check one layer deeper in the authority tree for keys
 
@@ -1923,6 +2319,10 @@ public:
             elog("Caught exception while broadcasting tx ${id}:  ${e}", ("id", tx.id().str())("e", e.to_detail_string()) );
             throw;
          }
+         // until the next block, the cached account would still give the keys it had before the update
+         for( const operation& op : tx.operations )
+            if( op.which() == operation::tag<account_update_operation>::value )
+               uncache_account( op.get<account_update_operation>().account );
       }
 
       return tx;
@@ -1937,6 +2337,7 @@ public:
                                  bool   fill_or_kill = false,
                                  bool   broadcast = false)
    {
+      prefetch_assets( {symbol_to_sell, symbol_to_receive} );
       account_object seller   = get_account( seller_account );
 
       limit_order_create_operation op;
@@ -1949,7 +2350,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(op);
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction( tx, broadcast );
@@ -1970,7 +2371,7 @@ public:
 
       signed_transaction trx;
       trx.operations = {op};
-      set_operation_fees( trx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( trx, get_global_properties().parameters.current_fees);
       trx.validate();
       idump((broadcast));
 
@@ -1987,7 +2388,7 @@ public:
          op.fee_paying_account = get_object<limit_order_object>(order_id).seller;
          op.order = order_id;
          trx.operations = {op};
-         set_operation_fees( trx, _remote_db->get_global_properties().parameters.current_fees);
+         set_operation_fees( trx, get_global_properties().parameters.current_fees);
 
          trx.validate();
          return sign_transaction(trx, broadcast);
@@ -1997,6 +2398,7 @@ public:
                                string asset_symbol, string memo, bool broadcast = false)
    { try {
       FC_ASSERT( !self.is_locked() );
+      prefetch_accounts( {from, to} );
       fc::optional<asset_object> asset_obj = get_asset(asset_symbol);
       FC_ASSERT(asset_obj, "Could not find asset matching ${asset}", ("asset", asset_symbol));
 
@@ -2022,12 +2424,229 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(xfer_op);
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees( tx, get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction(tx, broadcast);
    } FC_CAPTURE_AND_RETHROW( (from)(to)(amount)(asset_symbol)(memo)(broadcast) ) }
 
+   /**
+    * runs work(begin, end) over [0, count) split into chunks of at least min_per_thread items, on the worker
+    * threads and this one; the calling thread blocks until all chunks are done
+    */
+   void run_in_parallel( size_t count, size_t min_per_thread, const std::function<void(size_t, size_t)>& work )
+   {
+      const size_t thread_count = std::min<size_t>( (count + min_per_thread - 1) / min_per_thread,
+                                                    std::max( 1u, std::min( 8u, std::thread::hardware_concurrency() ) ) );
+      if( thread_count <= 1 )
+      {
+         work( 0, count );
+         return;
+      }
+
+      while( _worker_threads.size() < thread_count - 1 )
+         _worker_threads.emplace_back( new fc::thread( "wallet_worker_" + fc::to_string( _worker_threads.size() ) ) );
+
+      const size_t chunk = (count + thread_count - 1) / thread_count;
+      vector< fc::future<void> > done;
+      for( size_t t = 1; t < thread_count; ++t )
+      {
+         const size_t begin = std::min( t * chunk, count );
+         const size_t end = std::min( begin + chunk, count );
+         done.push_back( _worker_threads[t - 1]->async( [&work, begin, end] { work( begin, end ); },
+                                                       "wallet parallel work" ) );
+      }
+      try
+      {
+         work( 0, std::min( chunk, count ) );
+      }
+      catch( ... )
+      {
+         // the workers reference this frame, let them finish before unwinding it
+         for( auto& f : done )
+            try { f.wait(); } catch( ... ) {}
+         throw;
+      }
+      for( auto& f : done )
+         f.wait();
+   }
+
+   /** encrypts the memos of a transfer_many() batch; each costs an ECDH and an AES pass */
+   void set_transfer_memos( vector<transfer_operation>& xfers, const vector<transfer_order>& orders,
+                            const fc::ecc::private_key& memo_key )
+   {
+      vector<size_t> with_memo;
+      for( size_t i = 0; i < orders.size(); ++i )
+         if( orders[i].memo.size() )
+            with_memo.push_back( i );
+
+      run_in_parallel( with_memo.size(), 32, [&]( size_t begin, size_t end ) {
+         for( size_t j = begin; j < end; ++j )
+         {
+            transfer_operation& xfer = xfers[ with_memo[j] ];
+            xfer.memo->set_message( memo_key, xfer.memo->to, orders[ with_memo[j] ].memo );
+         }
+      } );
+   }
+
+   /**
+    * the ECDH secret shared by a key of this wallet and a counterparty's key, which decrypts the memos between
+    * them; cached since the same counterparties recur throughout an account history
+    */
+   fc::sha512 get_memo_secret( const public_key_type& my_key, const public_key_type& their_key ) const
+   {
+      auto key = std::make_pair( my_key, their_key );
+      auto itr = _memo_secrets.find( key );
+      if( itr != _memo_secrets.end() )
+         return itr->second;
+      auto priv = wif_to_key( _keys.at( my_key ) );
+      FC_ASSERT( priv, "Unable to recover private key to decrypt memo. Wallet may be corrupted." );
+      return _memo_secrets[ key ] = priv->get_shared_secret( their_key );
+   }
+
+   /**
+    * prepares formatting of a page of account history: fetches the accounts and assets of the transfers in
+    * batches and derives the memo secrets not cached yet in parallel
+    */
+   void prepare_history( const vector<operation_history_object>& history )
+   {
+      vector<account_id_type> accounts;
+      vector<asset_id_type> assets;
+      flat_set< std::pair<public_key_type, public_key_type> > secrets;
+      for( const auto& o : history )
+      {
+         if( o.op.which() != operation::tag<transfer_operation>::value )
+            continue;
+         const auto& xfer = o.op.get<transfer_operation>();
+         accounts.push_back( xfer.from );
+         accounts.push_back( xfer.to );
+         assets.push_back( xfer.amount.asset_id );
+         if( !xfer.memo || is_locked() || xfer.memo->from == public_key_type() )
+            continue;
+         std::pair<public_key_type, public_key_type> key;
+         if( _keys.count( xfer.memo->to ) )
+            key = std::make_pair( xfer.memo->to, xfer.memo->from );
+         else if( _keys.count( xfer.memo->from ) )
+            key = std::make_pair( xfer.memo->from, xfer.memo->to );
+         else
+            continue;
+         if( !_memo_secrets.count( key ) )
+            secrets.insert( key );
+      }
+      find_accounts( accounts );
+      prefetch_asset_ids( assets );
+
+      vector< std::pair<public_key_type, public_key_type> > pairs( secrets.begin(), secrets.end() );
+      vector< optional<fc::ecc::private_key> > privs;
+      privs.reserve( pairs.size() );
+      for( const auto& p : pairs )
+         privs.push_back( wif_to_key( _keys.at( p.first ) ) );
+      vector<fc::sha512> derived( pairs.size() );
+      run_in_parallel( pairs.size(), 16, [&]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            if( privs[i] )
+               derived[i] = privs[i]->get_shared_secret( pairs[i].second );
+      } );
+      for( size_t i = 0; i < pairs.size(); ++i )
+         if( privs[i] )
+            _memo_secrets[ pairs[i] ] = derived[i];
+   }
+
+   vector<signed_transaction> transfer_many(string from, vector<transfer_order> transfers, bool broadcast = false)
+   { try {
+      FC_ASSERT( !self.is_locked() );
+      FC_ASSERT( !transfers.empty(), "No transfers given" );
+
+      vector<string> account_names{ from };
+      vector<string> asset_symbols;
+      for( const auto& order : transfers )
+      {
+         account_names.push_back( order.to );
+         asset_symbols.push_back( order.asset_symbol );
+      }
+      prefetch_accounts( account_names );
+      prefetch_assets( asset_symbols );
+
+      account_object from_account = get_account(from);
+
+      vector<transfer_operation> xfers;
+      xfers.reserve( transfers.size() );
+      bool any_memo = false;
+      for( const auto& order : transfers )
+      {
+         fc::optional<asset_object> asset_obj = find_asset(order.asset_symbol);
+         FC_ASSERT(asset_obj, "Could not find asset matching ${asset}", ("asset", order.asset_symbol));
+         account_object to_account = get_account(order.to);
+
+         transfer_operation xfer_op;
+         xfer_op.from = from_account.id;
+         xfer_op.to = to_account.id;
+         xfer_op.amount = asset_obj->amount_from_string(order.amount);
+         if( order.memo.size() )
+         {
+            xfer_op.memo = memo_data();
+            xfer_op.memo->from = from_account.options.memo_key;
+            xfer_op.memo->to = to_account.options.memo_key;
+            any_memo = true;
+         }
+         xfers.push_back( xfer_op );
+      }
+      if( any_memo )
+         set_transfer_memos( xfers, transfers, get_private_key(from_account.options.memo_key) );
+
+      const global_property_object gprops = get_global_properties();
+      const fee_schedule& fees = *gprops.parameters.current_fees;
+
+      // room for what sign_transaction() adds: the reference block and expiration are fixed size, and there is
+      // at most one signature per key of the paying account; 5 bytes cover any growth of the operation count
+      signed_transaction empty_tx;
+      const size_t base_size = fc::raw::pack_size( empty_tx ) + 5
+                             + 65 * (from_account.active.num_auths() + 1);
+      const size_t max_size = gprops.parameters.maximum_transaction_size;
+
+      vector<signed_transaction> trxs( 1 );
+      size_t tx_size = base_size;
+      for( const auto& xfer : xfers )
+      {
+         operation op = xfer;
+         fees.set_fee( op );
+         const size_t op_size = fc::raw::pack_size( op );
+         FC_ASSERT( base_size + op_size <= max_size, "Transfer to ${to} does not fit into a transaction",
+                    ("to", xfer.to) );
+         if( !trxs.back().operations.empty() && tx_size + op_size > max_size )
+         {
+            trxs.emplace_back();
+            tx_size = base_size;
+         }
+         trxs.back().operations.push_back( std::move( op ) );
+         tx_size += op_size;
+      }
+
+      for( auto& tx : trxs )
+      {
+         tx.validate();
+         tx = sign_transaction( tx, false );
+      }
+
+      if( broadcast )
+      {
+         auto admissions = _remote_net_broadcast->broadcast_transactions( trxs );
+         fc::variants rejected;
+         for( size_t i = 0; i < admissions.size(); ++i )
+         {
+            if( !admissions[i].error )
+               continue;
+            elog( "Transaction ${id} of transfer_many was rejected: ${e}",
+                  ("id", trxs[i].id().str())("e", admissions[i].error->to_detail_string()) );
+            rejected.push_back( fc::mutable_variant_object( "id", trxs[i].id() )( "error", admissions[i].error->to_string() ) );
+         }
+         FC_ASSERT( rejected.empty(), "${n} of ${total} transactions were rejected",
+                    ("n", rejected.size())("total", trxs.size())("rejected", rejected) );
+      }
+
+      return trxs;
+   } FC_CAPTURE_AND_RETHROW( (from)(transfers)(broadcast) ) }
+
    signed_transaction issue_asset(string to_account, string amount, string symbol,
                                   string memo, bool broadcast = false)
    {
@@ -2052,7 +2671,7 @@ public:
 
       signed_transaction tx;
       tx.operations.push_back(issue_op);
-      set_operation_fees(tx,_remote_db->get_global_properties().parameters.current_fees);
+      set_operation_fees(tx,get_global_properties().parameters.current_fees);
       tx.validate();
 
       return sign_transaction(tx, broadcast);
@@ -2082,7 +2701,7 @@ public:
             auto b = _remote_db->get_block_header(i.block_num);
             FC_ASSERT(b);
             ss << b->timestamp.to_iso_string() << " ";
-            i.op.visit(operation_printer(ss, *this, i.result));
+            ss << d.description;
             ss << " \n";
          }
 
@@ -2593,7 +3212,36 @@ public:
 #endif
    const string _wallet_filename_extension = ".wallet";
 
-   mutable map<asset_id_type, asset_object> _asset_cache;
+   /**
+    * Chain state looked up by the commands since the last block, dropped by on_block_applied().  Commands
+    * driven in bulk over RPC would otherwise spend most of their time in round trips for the same objects.
+    */
+   mutable optional<global_property_object>      _global_properties_cache;
+   mutable map<account_id_type, account_object>  _account_cache;
+   mutable map<string, account_id_type>          _account_name_cache;
+   mutable map<asset_id_type, asset_object>      _asset_cache;
+   mutable map<string, asset_id_type>            _asset_symbol_cache;
+
+   /**
+    * Persistence state, see save_wallet_file(): how the snapshot on disk looks, and what of _wallet its journal
+    * already holds
+    */
+   fc::sha256                              _snapshot_hash;
+   uint64_t                                _snapshot_bytes = 0;
+   string                                  _snapshot_connection_settings;
+   uint64_t                                _journal_bytes = 0;
+   bool                                    _compact_wallet_on_save = false;
+   fc::sha256                              _persisted_state_hash;
+   map<public_key_type, string>            _persisted_labels;
+   map<commitment_type, fc::sha256>        _persisted_receipts;
+   set<public_key_type>                    _persisted_keys;
+   bool                                    _persisted_keys_known = false;
+
+   /** memo secrets by (our key, their key), see get_memo_secret(); dropped when the wallet is locked */
+   mutable map< std::pair<public_key_type, public_key_type>, fc::sha512 > _memo_secrets;
+
+   /** workers for run_in_parallel(), started on first use */
+   vector< std::unique_ptr<fc::thread> >         _worker_threads;
 };
 
 std::string operation_printer::fee(const asset& a)const {
@@ -2657,14 +3305,10 @@ string operation_printer::operator()(const transfer_operation& op) const
          try {
             FC_ASSERT(wallet._keys.count(op.memo->to) || wallet._keys.count(op.memo->from), "Memo is encrypted to a key ${to} or ${from} not in this wallet.", ("to", op.memo->to)("from",op.memo->from));
             if( wallet._keys.count(op.memo->to) ) {
-               auto my_key = wif_to_key(wallet._keys.at(op.memo->to));
-               FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-               memo = op.memo->get_message(*my_key, op.memo->from);
+               memo = op.memo->get_message(wallet.get_memo_secret(op.memo->to, op.memo->from));
                out << " -- Memo: " << memo;
             } else {
-               auto my_key = wif_to_key(wallet._keys.at(op.memo->from));
-               FC_ASSERT(my_key, "Unable to recover private key to decrypt memo. Wallet may be corrupted.");
-               memo = op.memo->get_message(*my_key, op.memo->to);
+               memo = op.memo->get_message(wallet.get_memo_secret(op.memo->from, op.memo->to));
                out << " -- Memo: " << memo;
             }
          } catch (const fc::exception& e) {
@@ -2783,6 +3427,7 @@ vector<operation_detail> wallet_api::get_account_history(string name, int limit)
 
 
       vector<operation_history_object> current = my->_remote_hist->get_account_history(account_id, operation_history_id_type(), std::min(100,limit), start);
+      my->prepare_history( current );
       for( auto& o : current ) {
          std::stringstream ss;
          auto memo = o.op.visit(detail::operation_printer(ss, *my, o.result));
@@ -3131,6 +3776,12 @@ signed_transaction wallet_api::transfer(string from, string to, string amount,
 {
    return my->transfer(from, to, amount, asset_symbol, memo, broadcast);
 }
+
+vector<signed_transaction> wallet_api::transfer_many(string from, vector<transfer_order> transfers, bool broadcast)
+{
+   return my->transfer_many(from, transfers, broadcast);
+}
+
 signed_transaction wallet_api::create_asset(string issuer,
                                             string symbol,
                                             uint8_t precision,
@@ -3460,6 +4111,11 @@ string wallet_api::gethelp(const string& method)const
       ss << "example: transfer \"1.3.11\" \"1.3.4\" 1000.03 CORE \"memo\" true\n";
       ss << "example: transfer \"usera\" \"userb\" 1000.123 CORE \"memo\" true\n";
    }
+   else if( method == "transfer_many" )
+   {
+      ss << "usage: transfer_many FROM [{\"to\":TO, \"amount\":AMOUNT, \"asset_symbol\":SYMBOL, \"memo\":\"memo\"}, ...] BROADCAST\n\n";
+      ss << "example: transfer_many \"usera\" [{\"to\":\"userb\", \"amount\":\"10\", \"asset_symbol\":\"CORE\", \"memo\":\"\"}] true\n";
+   }
    else if( method == "create_account_with_brain_key" )
    {
       ss << "usage: create_account_with_brain_key BRAIN_KEY ACCOUNT_NAME REGISTRAR REFERRER BROADCAST\n\n";
@@ -3537,6 +4193,7 @@ void wallet_api::lock()
    for( auto key : my->_keys )
       key.second = key_to_wif(fc::ecc::private_key());
    my->_keys.clear();
+   my->_memo_secrets.clear();
    my->_checksum = fc::sha512();
    my->self.lock_changed(true);
 } FC_CAPTURE_AND_RETHROW() }
@@ -3548,6 +4205,18 @@ void wallet_api::unlock(string password)
    vector<char> decrypted = fc::aes_decrypt(pw, my->_wallet.cipher_keys);
    auto pk = fc::raw::unpack<plain_keys>(decrypted);
    FC_ASSERT(pk.checksum == pw);
+   for( const auto& batch : my->_wallet.cipher_key_batches )
+   {
+      auto batch_keys = fc::raw::unpack<plain_keys>( fc::aes_decrypt( pw, batch ) );
+      FC_ASSERT( batch_keys.checksum == pw );
+      pk.keys.insert( batch_keys.keys.begin(), batch_keys.keys.end() );
+   }
+   if( !my->_persisted_keys_known )
+   {
+      for( const auto& key : pk.keys )
+         my->_persisted_keys.insert( key.first );
+      my->_persisted_keys_known = true;
+   }
    my->_keys = std::move(pk.keys);
    my->_checksum = pk.checksum;
    my->self.lock_changed(false);
@@ -3558,6 +4227,8 @@ void wallet_api::set_password( string password )
    if( !is_new() )
       FC_ASSERT( !is_locked(), "The wallet must be unlocked before the password can be set" );
    my->_checksum = fc::sha512::hash( password.c_str(), password.size() );
+   // the journal's key batches are encrypted with the old password
+   my->_compact_wallet_on_save = true;
    lock();
 }
 
@@ -3573,55 +4244,72 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
    FC_ASSERT(!is_locked());
    const dynamic_global_property_object& dpo = _remote_db->get_dynamic_global_properties();
    account_object claimer = get_account( name_or_id );
-   uint32_t max_ops_per_tx = 30;
 
-   map< address, private_key_type > keys;  // local index of address -> private key
-   vector< address > addrs;
+   // deriving the public key and its five addresses dominates for large imports, so it runs on the workers
+   vector< string > plain_wif_keys;
    bool has_wildcard = false;
-   addrs.reserve( wif_keys.size() );
    for( const string& wif_key : wif_keys )
    {
       if( wif_key == "*" )
+         has_wildcard = true;
+      else
+         plain_wif_keys.push_back( wif_key );
+   }
+   vector< optional< private_key_type > > derived_keys( plain_wif_keys.size() );
+   vector< key_addresses > derived_addrs( plain_wif_keys.size() );
+   run_in_parallel( plain_wif_keys.size(), 64, [&]( size_t begin, size_t end ) {
+      for( size_t i = begin; i < end; ++i )
       {
-         if( has_wildcard )
-            continue;
-         for( const public_key_type& pub : _wallet.extra_keys[ claimer.id ] )
+         derived_keys[i] = wif_to_key( plain_wif_keys[i] );
+         if( derived_keys[i] )
+            derived_addrs[i] = addresses_of( derived_keys[i]->get_public_key() );
+      }
+   } );
+
+   map< address, private_key_type > keys;  // local index of address -> private key
+   vector< address > addrs;
+   addrs.reserve( plain_wif_keys.size() * std::tuple_size< key_addresses >::value );
+   if( has_wildcard )
+   {
+      for( const public_key_type& pub : _wallet.extra_keys[ claimer.id ] )
+      {
+         addrs.push_back( pub );
+         auto it = _keys.find( pub );
+         if( it != _keys.end() )
          {
-            addrs.push_back( pub );
-            auto it = _keys.find( pub );
-            if( it != _keys.end() )
-            {
-               fc::optional< fc::ecc::private_key > privkey = wif_to_key( it->second );
-               FC_ASSERT( privkey );
-               keys[ addrs.back() ] = *privkey;
-            }
-            else
-            {
-               wlog( "Somehow _keys has no private key for extra_keys public key ${k}", ("k", pub) );
-            }
+            fc::optional< fc::ecc::private_key > privkey = wif_to_key( it->second );
+            FC_ASSERT( privkey );
+            keys[ addrs.back() ] = *privkey;
+         }
+         else
+         {
+            wlog( "Somehow _keys has no private key for extra_keys public key ${k}", ("k", pub) );
          }
-         has_wildcard = true;
       }
-      else
+   }
+   for( size_t i = 0; i < plain_wif_keys.size(); ++i )
+   {
+      FC_ASSERT( derived_keys[i].valid(), "Invalid private key" );
+      // see chain/balance_evaluator.cpp
+      for( const address& a : derived_addrs[i] )
       {
-         optional< private_key_type > key = wif_to_key( wif_key );
-         FC_ASSERT( key.valid(), "Invalid private key" );
-         fc::ecc::public_key pk = key->get_public_key();
-         addrs.push_back( pk );
-         keys[addrs.back()] = *key;
-         // see chain/balance_evaluator.cpp
-         addrs.push_back( pts_address( pk, false, 56 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, true, 56 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, false, 0 ) );
-         keys[addrs.back()] = *key;
-         addrs.push_back( pts_address( pk, true, 0 ) );
-         keys[addrs.back()] = *key;
+         addrs.push_back( a );
+         keys[a] = *derived_keys[i];
       }
    }
 
-   vector< balance_object > balances = _remote_db->get_balance_objects( addrs );
+   // the node answers from its by_owner index; batches keep each reply to a reasonable size
+   const size_t addrs_per_lookup = 1000;
+   vector< balance_object > balances;
+   for( size_t start = 0; start < addrs.size(); start += addrs_per_lookup )
+   {
+      vector< address > batch( addrs.begin() + start, addrs.begin() + std::min( start + addrs_per_lookup, addrs.size() ) );
+      vector< balance_object > found = _remote_db->get_balance_objects( batch );
+      balances.insert( balances.end(), found.begin(), found.end() );
+      if( addrs.size() > addrs_per_lookup )
+         ilog( "import_balance: looked up ${n} of ${total} addresses, ${b} balances found",
+               ("n", std::min( start + addrs_per_lookup, addrs.size() ))("total", addrs.size())("b", balances.size()) );
+   }
    wdump((balances));
    addrs.clear();
 
@@ -3630,11 +4318,21 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
 
    struct claim_tx
    {
-      vector< balance_claim_operation > ops;
+      vector< operation > ops;
       set< address > addrs;
+      set< public_key_type > signers;
+      size_t size = 0;
    };
    vector< claim_tx > claim_txs;
 
+   // claims are packed into transactions up to the maximum size, counting a signature per distinct balance key
+   // plus room for the claimer's signatures, the reference block and expiration added by sign_transaction()
+   const global_property_object gprops = get_global_properties();
+   const fee_schedule& fees = *gprops.parameters.current_fees;
+   const size_t max_size = gprops.parameters.maximum_transaction_size;
+   signed_transaction empty_tx;
+   const size_t base_size = fc::raw::pack_size( empty_tx ) + 5 + 65 * (claimer.active.num_auths() + 1);
+
    for( const asset_id_type& a : bal_types )
    {
       balance_claim_operation op;
@@ -3648,10 +4346,22 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
                continue;
             op.balance_to_claim = b.id;
             op.balance_owner_key = keys[b.owner].get_public_key();
-            if( (claim_txs.empty()) || (claim_txs.back().ops.size() >= max_ops_per_tx) )
+
+            operation claim = op;
+            fees.set_fee( claim );
+            size_t claim_size = fc::raw::pack_size( claim );
+            if( claim_txs.empty() || !claim_txs.back().signers.count( op.balance_owner_key ) )
+               claim_size += 65;
+            if( claim_txs.empty() || claim_txs.back().size + claim_size > max_size )
+            {
                claim_txs.emplace_back();
-            claim_txs.back().ops.push_back(op);
-            claim_txs.back().addrs.insert(b.owner);
+               claim_txs.back().size = base_size;
+               claim_size = fc::raw::pack_size( claim ) + 65;
+            }
+            claim_txs.back().ops.push_back( std::move( claim ) );
+            claim_txs.back().addrs.insert( b.owner );
+            claim_txs.back().signers.insert( op.balance_owner_key );
+            claim_txs.back().size += claim_size;
          }
       }
    }
@@ -3661,10 +4371,7 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
    for( const claim_tx& ctx : claim_txs )
    {
       signed_transaction tx;
-      tx.operations.reserve( ctx.ops.size() );
-      for( const balance_claim_operation& op : ctx.ops )
-         tx.operations.emplace_back( op );
-      set_operation_fees( tx, _remote_db->get_global_properties().parameters.current_fees );
+      tx.operations = ctx.ops;
       tx.validate();
       signed_transaction signed_tx = sign_transaction( tx, false );
       for( const address& addr : ctx.addrs )
@@ -3673,8 +4380,24 @@ vector< signed_transaction > wallet_api_impl::import_balance( string name_or_id,
       // we may end up with duplicate signatures, so remove those
       boost::erase(signed_tx.signatures, boost::unique<boost::return_found_end>(boost::sort(signed_tx.signatures)));
       result.push_back( signed_tx );
-      if( broadcast )
-         _remote_net_broadcast->broadcast_transaction(signed_tx);
+      if( claim_txs.size() > 1 )
+         ilog( "import_balance: signed ${n} of ${total} claim transactions", ("n", result.size())("total", claim_txs.size()) );
+   }
+
+   if( broadcast && !result.empty() )
+   {
+      auto admissions = _remote_net_broadcast->broadcast_transactions( result );
+      fc::variants rejected;
+      for( size_t i = 0; i < admissions.size(); ++i )
+      {
+         if( !admissions[i].error )
+            continue;
+         elog( "Balance claim transaction ${id} was rejected: ${e}",
+               ("id", result[i].id().str())("e", admissions[i].error->to_detail_string()) );
+         rejected.push_back( fc::mutable_variant_object( "id", result[i].id() )( "error", admissions[i].error->to_string() ) );
+      }
+      FC_ASSERT( rejected.empty(), "${n} of ${total} transactions were rejected",
+                 ("n", rejected.size())("total", result.size())("rejected", rejected) );
    }
 
    return result;
@@ -3859,7 +4582,7 @@ blind_confirmation wallet_api::transfer_from_blind( string from_blind_account_ke
    transfer_from_blind_operation from_blind;
 
 
-   auto fees  = my->_remote_db->get_global_properties().parameters.current_fees;
+   auto fees  = my->get_global_properties().parameters.current_fees;
    fc::optional<asset_object> asset_obj = get_asset(symbol);
    FC_ASSERT(asset_obj.valid(), "Could not find asset matching ${asset}", ("asset", symbol));
    auto amount = asset_obj->amount_from_string(amount_in);
@@ -3937,7 +4660,7 @@ blind_confirmation wallet_api::blind_transfer_help( string from_key_or_label,
    blind_transfer_operation blind_tr;
    blind_tr.outputs.resize(2);
 
-   auto fees  = my->_remote_db->get_global_properties().parameters.current_fees;
+   auto fees  = my->get_global_properties().parameters.current_fees;
 
    auto amount = asset_obj->amount_from_string(amount_in);
 
@@ -4158,7 +4881,7 @@ blind_confirmation wallet_api::transfer_to_blind( string from_account_id_or_name
               [&]( const blind_output& a, const blind_output& b ){ return a.commitment < b.commitment; } );
 
    confirm.trx.operations.push_back( bop );
-   my->set_operation_fees( confirm.trx, my->_remote_db->get_global_properties().parameters.current_fees);
+   my->set_operation_fees( confirm.trx, my->get_global_properties().parameters.current_fees);
    confirm.trx.validate();
    confirm.trx = sign_transaction(confirm.trx, broadcast);
 
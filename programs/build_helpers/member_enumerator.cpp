@@ -60,6 +60,12 @@ struct class_processor
    template< typename T >
    void process_class( const fc::optional< T >* dummy );
 
+   template< typename T >
+   void process_class( const graphene::chain::boxed< T >* dummy );
+
+   template< typename T >
+   void process_class( const graphene::chain::boxed_optional< T >* dummy );
+
    template< typename T >
    static void process_class( std::map< std::string, std::vector< std::string > >& result );
 
@@ -179,6 +185,18 @@ void class_processor::process_class( const fc::optional< T >* dummy )
    process_class( (T*) nullptr );
 }
 
+template< typename T >
+void class_processor::process_class( const graphene::chain::boxed< T >* dummy )
+{
+   process_class( (T*) nullptr );
+}
+
+template< typename T >
+void class_processor::process_class( const graphene::chain::boxed_optional< T >* dummy )
+{
+   process_class( (T*) nullptr );
+}
+
 template< typename T >
 void class_processor::process_class( std::map< std::string, std::vector< std::string > >& result )
 {
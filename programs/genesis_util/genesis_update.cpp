@@ -23,6 +23,7 @@
  */
 
 #include <algorithm>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
@@ -65,6 +66,8 @@ int main( int argc, char** argv )
             ("help,h", "Print this help message and exit.")
             ("genesis-json,g", bpo::value<boost::filesystem::path>(), "File to read genesis state from")
             ("out,o", bpo::value<boost::filesystem::path>(), "File to output new genesis to")
+            ("out-binary,b", bpo::value<boost::filesystem::path>(), "File to also output the new genesis to in binary format, "
+                                                                   "it starts the same chain as the JSON output and loads much faster")
             ("dev-account-prefix", bpo::value<std::string>()->default_value("devacct"), "Prefix for dev accounts")
             ("dev-key-prefix", bpo::value<std::string>()->default_value("devkey-"), "Prefix for dev key")
             ("dev-account-count", bpo::value<uint32_t>()->default_value(0), "Prefix for dev accounts")
@@ -108,7 +111,7 @@ int main( int argc, char** argv )
          std::cerr << "update_genesis:  Reading genesis from file " << genesis_json_filename.preferred_string() << "\n";
          std::string genesis_json;
          read_file_contents( genesis_json_filename, genesis_json );
-         genesis = fc::json::from_string( genesis_json ).as< genesis_state_type >();
+         genesis = parse_genesis_json( genesis_json );
       }
       else
       {
@@ -167,7 +170,24 @@ int main( int argc, char** argv )
       }
 
       fc::path output_filename = options["out"].as<boost::filesystem::path>();
-      fc::json::save_to_file( genesis, output_filename );
+      const std::string genesis_json = fc::json::to_pretty_string( genesis );
+      {
+         std::ofstream out( output_filename.preferred_string(), std::ios::binary );
+         out.write( genesis_json.data(), genesis_json.size() );
+         FC_ASSERT( out.good(), "Unable to write ${f}", ("f", output_filename) );
+      }
+
+      if( options.count("out-binary") )
+      {
+         // the node takes the chain id of a JSON genesis from the hash of the file contents
+         genesis.initial_chain_id = fc::sha256::hash( genesis_json );
+         const std::string packed = pack_binary_genesis( genesis );
+         fc::path binary_filename = options["out-binary"].as<boost::filesystem::path>();
+         std::ofstream out( binary_filename.preferred_string(), std::ios::binary );
+         out.write( packed.data(), packed.size() );
+         FC_ASSERT( out.good(), "Unable to write ${f}", ("f", binary_filename) );
+         std::cerr << "update_genesis:  Wrote binary genesis for chain id " << genesis.initial_chain_id.str() << "\n";
+      }
    }
    catch ( const fc::exception& e )
    {
@@ -110,6 +110,8 @@ struct js_name<fc::array<T,N>>
 template<size_t N>   struct js_name<fc::array<char,N>>    { static std::string name(){ return  "bytes "+ fc::to_string(N); }; };
 template<size_t N>   struct js_name<fc::array<uint8_t,N>> { static std::string name(){ return  "bytes "+ fc::to_string(N); }; };
 template<typename T> struct js_name< fc::optional<T> >    { static std::string name(){ return "optional " + js_name<T>::name(); } };
+template<typename T> struct js_name< graphene::chain::boxed<T> >          { static std::string name(){ return js_name<T>::name(); } };
+template<typename T> struct js_name< graphene::chain::boxed_optional<T> > { static std::string name(){ return "optional " + js_name<T>::name(); } };
 template<typename T> struct js_name< fc::smart_ref<T> >   { static std::string name(){ return js_name<T>::name(); } };
 template<>           struct js_name< object_id_type >     { static std::string name(){ return "object_id_type"; } };
 template<typename T> struct js_name< fc::flat_set<T> >    { static std::string name(){ return "set " + js_name<T>::name(); } };
@@ -238,6 +240,20 @@ struct serializer<std::vector<T>,false>
    static void generate() {}
 };
 
+template<typename T>
+struct serializer<graphene::chain::boxed<T>,false>
+{
+   static void init() { serializer<T>::init(); }
+   static void generate() {}
+};
+
+template<typename T>
+struct serializer<graphene::chain::boxed_optional<T>,false>
+{
+   static void init() { serializer<T>::init(); }
+   static void generate() {}
+};
+
 template<typename T>
 struct serializer<fc::smart_ref<T>,false>
 {
@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <fc/network/http/websocket.hpp>
+#include <fc/rpc/websocket_api.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <graphene/app/api.hpp>
+#include <graphene/chain/protocol/protocol.hpp>
+#include <graphene/utilities/key_conversion.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace graphene::app;
+using namespace graphene::chain;
+using namespace graphene::utilities;
+using namespace std;
+namespace bpo = boost::program_options;
+
+namespace {
+
+/** what happened to one generated transaction, the times are microseconds since the first submission */
+struct tracked_transaction
+{
+   signed_transaction trx;
+   int64_t            submitted    = -1;
+   int64_t            included     = -1;
+   int64_t            irreversible = -1;
+   uint32_t           block_num    = 0;
+   bool               rejected     = false;
+};
+
+/**
+ * Keeps the transactions and records the confirmations, which the websocket delivers on its own thread while the
+ * main thread submits.
+ */
+class latency_tracker
+{
+   public:
+      explicit latency_tracker( vector<tracked_transaction>& trxs ) : _trxs( trxs ), _start( fc::time_point::now() ) {}
+
+      int64_t now()const { return ( fc::time_point::now() - _start ).count(); }
+
+      void submitted( size_t n )
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         _trxs[n].submitted = now();
+      }
+      void rejected( size_t n )
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         _trxs[n].rejected = true;
+         ++_done;
+      }
+      void included( size_t n, uint32_t block_num )
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         _trxs[n].included = now();
+         _trxs[n].block_num = block_num;
+         _awaiting_irreversibility.insert( std::make_pair( block_num, n ) );
+      }
+      /** marks the transactions of blocks up to last_irreversible_block_num */
+      void irreversible( uint32_t last_irreversible_block_num )
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         const int64_t t = now();
+         auto end = _awaiting_irreversibility.upper_bound( last_irreversible_block_num );
+         for( auto itr = _awaiting_irreversibility.begin(); itr != end; ++itr )
+         {
+            _trxs[itr->second].irreversible = t;
+            ++_done;
+         }
+         _awaiting_irreversibility.erase( _awaiting_irreversibility.begin(), end );
+      }
+      /** the number of transactions that were rejected or became irreversible */
+      size_t done()const
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         return _done;
+      }
+
+   private:
+      vector<tracked_transaction>&   _trxs;
+      const fc::time_point           _start;
+      mutable std::mutex             _mutex;
+      std::multimap<uint32_t,size_t> _awaiting_irreversibility;
+      size_t                         _done = 0;
+};
+
+void print_distribution( const char* name, vector<int64_t> micros )
+{
+   std::cout << std::setw(26) << std::left << name;
+   if( micros.empty() )
+   {
+      std::cout << "none\n";
+      return;
+   }
+   std::sort( micros.begin(), micros.end() );
+   auto percentile = [&micros]( double p ) {
+      return double( micros[ std::min<size_t>( micros.size() - 1, size_t( p * micros.size() ) ) ] ) / 1000;
+   };
+   std::cout << std::fixed << std::setprecision(1)
+             << "p50 " << percentile( 0.5 ) << " ms   p90 " << percentile( 0.9 ) << " ms   p99 " << percentile( 0.99 )
+             << " ms   max " << double( micros.back() ) / 1000 << " ms   (" << micros.size() << " transactions)\n";
+}
+
+fc::ecc::private_key generator_key( const string& name )
+{
+   return fc::ecc::private_key::regenerate( fc::sha256::hash( "load-generator " + name ) );
+}
+
+/**
+ * Finds or registers the sending accounts and gives each of them amount CORE, paid by the funding account, which
+ * must be a lifetime member to register accounts.
+ */
+vector<account_id_type> prepare_accounts( fc::api<database_api>& db, fc::api<network_broadcast_api>& net,
+                                          const chain_id_type& chain_id, const account_object& funder,
+                                          const fc::ecc::private_key& funder_key, const vector<string>& names,
+                                          share_type amount )
+{
+   const global_property_object global_props = db->get_global_properties();
+   const fee_schedule& fees = *global_props.parameters.current_fees;
+   auto broadcast = [&]( operation op ) {
+      fees.set_fee( op );
+      const auto props = db->get_dynamic_global_properties();
+      signed_transaction trx;
+      trx.operations.push_back( std::move( op ) );
+      trx.set_reference_block( props.head_block_id );
+      trx.set_expiration( props.time + fc::minutes( 10 ) );
+      trx.sign( funder_key, chain_id );
+      net->broadcast_transaction( trx );
+   };
+
+   auto lookup = [&]() {
+      vector<optional<account_object>> found;
+      for( size_t i = 0; i < names.size(); i += 100 )
+      {
+         const vector<string> chunk( names.begin() + i, names.begin() + std::min( names.size(), i + 100 ) );
+         const auto accounts = db->lookup_account_names( chunk );
+         found.insert( found.end(), accounts.begin(), accounts.end() );
+      }
+      return found;
+   };
+
+   auto found = lookup();
+   size_t registered = 0;
+   for( size_t i = 0; i < names.size(); ++i )
+   {
+      if( found[i] )
+         continue;
+      const public_key_type key = generator_key( names[i] ).get_public_key();
+      account_create_operation create;
+      create.registrar = funder.id;
+      create.referrer = funder.id;
+      create.name = names[i];
+      create.owner = authority( 1, key, 1 );
+      create.active = authority( 1, key, 1 );
+      create.options->memo_key = key;
+      create.options->voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+      broadcast( create );
+      ++registered;
+   }
+   if( registered )
+      std::cerr << "Registered " << registered << " accounts, waiting for them to be included\n";
+
+   vector<account_id_type> ids;
+   for( int attempt = 0; ids.size() < names.size(); ++attempt )
+   {
+      FC_ASSERT( attempt < 60, "The generator accounts did not show up within a minute" );
+      if( attempt > 0 )
+      {
+         fc::usleep( fc::seconds( 1 ) );
+         found = lookup();
+      }
+      ids.clear();
+      for( const auto& account : found )
+         if( account )
+            ids.push_back( account->id );
+   }
+
+   for( const account_id_type& id : ids )
+   {
+      transfer_operation fund;
+      fund.from = funder.id;
+      fund.to = id;
+      fund.amount = asset( amount );
+      broadcast( fund );
+   }
+   return ids;
+}
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Graphene load generator");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("server-rpc-endpoint,s", bpo::value<string>()->default_value("ws://127.0.0.1:8090"), "Server websocket RPC endpoint")
+            ("server-rpc-user,u", bpo::value<string>()->default_value(""), "Server Username")
+            ("server-rpc-password,p", bpo::value<string>()->default_value(""), "Server Password")
+            ("funding-account", bpo::value<string>()->default_value("nathan"), "Lifetime member paying for the accounts and their funds")
+            ("funding-key", bpo::value<string>(), "WIF private key of the funding account's active authority")
+            ("account-prefix", bpo::value<string>()->default_value("loadgen-"), "Names of the sending accounts, which are reused between runs")
+            ("accounts,a", bpo::value<uint32_t>()->default_value(100), "Number of sending accounts, each signing with its own key")
+            ("transactions,n", bpo::value<uint32_t>()->default_value(10000), "Number of transactions to submit")
+            ("rate,r", bpo::value<double>()->default_value(100), "Transactions submitted per second")
+            ("order-asset", bpo::value<string>(), "Symbol of an asset that limit orders buy with CORE, no orders without it")
+            ("order-percent", bpo::value<uint32_t>()->default_value(0), "Percentage of the transactions that place a limit order")
+            ("sign-threads", bpo::value<uint32_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "Threads signing the transactions before the run")
+            ("wait", bpo::value<uint32_t>()->default_value(120), "Seconds to wait for the last transactions to become irreversible")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const boost::program_options::error& e)
+      {
+         std::cerr << "load_generator:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") || !options.count("funding-key") )
+      {
+         std::cout << cli_options << "\n";
+         return options.count("help") ? 0 : 1;
+      }
+
+      const auto funder_key = wif_to_key( options["funding-key"].as<string>() );
+      FC_ASSERT( funder_key.valid(), "Invalid funding key" );
+      const uint32_t num_accounts = std::max( 1u, options["accounts"].as<uint32_t>() );
+      const uint32_t num_trxs = options["transactions"].as<uint32_t>();
+      const double rate = options["rate"].as<double>();
+      FC_ASSERT( rate > 0, "The rate must be positive" );
+      const uint32_t order_percent = options.count("order-asset") ? options["order-percent"].as<uint32_t>() : 0;
+
+      fc::http::websocket_client client;
+      auto con = client.connect( options["server-rpc-endpoint"].as<string>() );
+      auto apic = std::make_shared<fc::rpc::websocket_api_connection>( *con );
+      auto remote_api = apic->get_remote_api< login_api >( 1 );
+      FC_ASSERT( remote_api->login( options["server-rpc-user"].as<string>(), options["server-rpc-password"].as<string>() ) );
+      fc::api<database_api> db = remote_api->database();
+      fc::api<network_broadcast_api> net = remote_api->network_broadcast();
+
+      const chain_id_type chain_id = db->get_chain_id();
+      const auto funder = db->lookup_account_names( { options["funding-account"].as<string>() } ).front();
+      FC_ASSERT( funder.valid(), "No funding account ${a}", ("a",options["funding-account"].as<string>()) );
+      optional<asset_id_type> order_asset;
+      if( order_percent )
+      {
+         const auto found = db->lookup_asset_symbols( { options["order-asset"].as<string>() } ).front();
+         FC_ASSERT( found.valid(), "No asset ${a}", ("a",options["order-asset"].as<string>()) );
+         order_asset = found->id;
+      }
+
+      const auto params = db->get_global_properties().parameters;
+      const fee_schedule& fees = *params.current_fees;
+      // every transfer and order of an account is one satoshi bigger than its previous one, which keeps the
+      // transactions distinct, so an account pays that on top of the fees
+      const uint64_t per_account = num_trxs / num_accounts + 1;
+      const share_type max_fee = std::max( fees.calculate_fee( transfer_operation() ).amount,
+                                           fees.calculate_fee( limit_order_create_operation() ).amount );
+      const share_type funds = 2 * per_account * ( max_fee.value + per_account );
+
+      vector<string> names;
+      for( uint32_t i = 0; i < num_accounts; ++i )
+         names.push_back( options["account-prefix"].as<string>() + fc::to_string( i ) );
+      const vector<account_id_type> accounts = prepare_accounts( db, net, chain_id, *funder, *funder_key, names, funds );
+      vector<fc::ecc::private_key> keys;
+      for( const string& name : names )
+         keys.push_back( generator_key( name ) );
+
+      std::cerr << "Signing " << num_trxs << " transactions\n";
+      const auto props = db->get_dynamic_global_properties();
+      const fc::time_point_sec expiration = props.time + params.maximum_time_until_expiration;
+      vector<tracked_transaction> trxs( num_trxs );
+      {
+         const fc::time_point start = fc::time_point::now();
+         const uint32_t threads = std::max( 1u, options["sign-threads"].as<uint32_t>() );
+         vector<std::thread> signers;
+         for( uint32_t t = 0; t < threads; ++t )
+            signers.emplace_back( [&, t]() {
+               for( size_t n = t; n < num_trxs; n += threads )
+               {
+                  const size_t sender = n % num_accounts;
+                  const share_type amount = 1 + n / num_accounts;
+                  signed_transaction& trx = trxs[n].trx;
+                  if( order_asset && n % 100 < order_percent )
+                  {
+                     // far below any sensible price, the orders rest until they expire with the transaction
+                     limit_order_create_operation order;
+                     order.seller = accounts[sender];
+                     order.amount_to_sell = asset( amount );
+                     order.min_to_receive = asset( GRAPHENE_MAX_SHARE_SUPPLY / 1000, *order_asset );
+                     order.expiration = expiration;
+                     trx.operations.push_back( order );
+                  }
+                  else
+                  {
+                     transfer_operation transfer;
+                     transfer.from = accounts[sender];
+                     transfer.to = accounts[ ( sender + 1 ) % num_accounts ];
+                     transfer.amount = asset( amount );
+                     trx.operations.push_back( transfer );
+                  }
+                  for( auto& op : trx.operations )
+                     fees.set_fee( op );
+                  trx.set_reference_block( props.head_block_id );
+                  trx.set_expiration( expiration );
+                  trx.sign( keys[sender], chain_id );
+               }
+            } );
+         for( auto& signer : signers )
+            signer.join();
+         std::cerr << "Signed in " << double( ( fc::time_point::now() - start ).count() ) / 1000000 << " s\n";
+      }
+
+      latency_tracker tracker( trxs );
+
+      // blocks tell when to look at the last irreversible block again
+      std::atomic<bool> new_block( false );
+      db->set_block_applied_callback( [&new_block]( const variant& ) { new_block = true; } );
+      auto watch_irreversibility = [&]() {
+         if( !new_block.exchange( false ) )
+            return;
+         tracker.irreversible( db->get_dynamic_global_properties().last_irreversible_block_num );
+      };
+
+      std::cerr << "Submitting " << num_trxs << " transactions at " << rate << " per second\n";
+      vector<fc::future<void>> calls;
+      calls.reserve( num_trxs );
+      for( size_t n = 0; n < trxs.size(); ++n )
+      {
+         const int64_t due = int64_t( n * 1000000 / rate );
+         const int64_t ahead = due - tracker.now();
+         if( ahead > 0 )
+            fc::usleep( fc::microseconds( ahead ) );
+         watch_irreversibility();
+
+         tracker.submitted( n );
+         calls.push_back( fc::async( [&, n]() {
+            try
+            {
+               net->broadcast_transaction_with_callback( [&, n]( const variant& v ) {
+                  const auto confirmation = v.as<network_broadcast_api::transaction_confirmation>();
+                  tracker.included( n, confirmation.block_num );
+               }, trxs[n].trx );
+            }
+            catch( const fc::exception& e )
+            {
+               tracker.rejected( n );
+               wlog( "Transaction ${n} was rejected: ${e}", ("n",n)("e",e.to_string()) );
+            }
+         } ) );
+      }
+      const double submit_seconds = double( tracker.now() ) / 1000000;
+      for( auto& call : calls )
+         call.wait();
+
+      const fc::time_point deadline = fc::time_point::now() + fc::seconds( options["wait"].as<uint32_t>() );
+      while( tracker.done() < trxs.size() && fc::time_point::now() < deadline )
+      {
+         fc::usleep( fc::milliseconds( 50 ) );
+         watch_irreversibility();
+      }
+
+      vector<int64_t> inclusion, irreversibility;
+      size_t rejected = 0;
+      for( const tracked_transaction& t : trxs )
+      {
+         rejected += t.rejected;
+         if( t.included >= 0 )
+            inclusion.push_back( t.included - t.submitted );
+         if( t.irreversible >= 0 )
+            irreversibility.push_back( t.irreversible - t.submitted );
+      }
+      std::cout << "submitted " << trxs.size() << " in " << submit_seconds << " s ("
+                << double( trxs.size() ) / std::max( submit_seconds, 1e-6 ) << " per second), rejected " << rejected
+                << ", included " << inclusion.size() << ", irreversible " << irreversibility.size() << "\n";
+      print_distribution( "submit to inclusion", inclusion );
+      print_distribution( "submit to irreversibility", irreversibility );
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
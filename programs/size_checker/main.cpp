@@ -46,6 +46,25 @@ uint64_t get_wire_size()
    return fc::raw::pack( data ).size();
 }
 
+/** the bytes the boxed members of an operation allocate on the heap once they are written */
+struct boxed_heap_size_visitor
+{
+   template<typename Member, class Class, Member (Class::*member)>
+   void operator()( const char* name )const
+   {
+      size += heap_size( (const Member*) nullptr );
+   }
+
+   template< typename M >
+   static uint64_t heap_size( const M* ) { return 0; }
+   template< typename M >
+   static uint64_t heap_size( const graphene::chain::boxed<M>* ) { return sizeof( M ); }
+   template< typename M >
+   static uint64_t heap_size( const graphene::chain::boxed_optional<M>* ) { return sizeof( M ); }
+
+   mutable uint64_t size = 0;
+};
+
 struct size_check_type_visitor
 {
    typedef void result_type;
@@ -59,7 +78,12 @@ struct size_check_type_visitor
       fc::mutable_variant_object vo;
       vo["name"] = fc::get_typename<Type>::name();
       vo["mem_size"] = sizeof( Type );
+      boxed_heap_size_visitor heap;
+      fc::reflector<Type>::visit( heap );
+      vo["heap_size"] = heap.size;
       vo["wire_size"] = get_wire_size<Type>();
+      // bytes an instance of this type leaves unused inside an operation, which is sized for its largest alternative
+      vo["variant_slack"] = sizeof( graphene::chain::operation ) - sizeof( Type );
       g_op_types.push_back( vo );
    }
 };
@@ -105,6 +129,8 @@ int main( int argc, char** argv )
             std::cout << "\n";
       }
       std::cout << "]\n";
+      std::cerr << "Size of operation: " << sizeof( graphene::chain::operation )
+                << " (largest alternative " << g_op_types.front()["name"].as_string() << ")\n";
       std::cerr << "Size of block header: " << sizeof( block_header ) << " " << fc::raw::pack_size( block_header() ) << "\n";
    }
    catch ( const fc::exception& e ){ edump((e.to_detail_string())); }
@@ -26,6 +26,9 @@
 #include <graphene/witness/witness.hpp>
 #include <graphene/account_history/account_history_plugin.hpp>
 #include <graphene/market_history/market_history_plugin.hpp>
+#include <graphene/change_stream/change_stream_plugin.hpp>
+#include <graphene/operation_export/operation_export_plugin.hpp>
+#include <graphene/utilities/trace.hpp>
 
 #include <fc/exception/exception.hpp>
 #include <fc/thread/thread.hpp>
@@ -74,6 +77,8 @@ int main(int argc, char** argv) {
       auto witness_plug = node->register_plugin<witness_plugin::witness_plugin>();
       auto history_plug = node->register_plugin<account_history::account_history_plugin>();
       auto market_history_plug = node->register_plugin<market_history::market_history_plugin>();
+      auto change_stream_plug = node->register_plugin<change_stream::change_stream_plugin>();
+      auto operation_export_plug = node->register_plugin<operation_export::operation_export_plugin>();
 
       try
       {
@@ -176,6 +181,15 @@ int main(int argc, char** argv) {
          exit_promise->set_value(signal);
       }, SIGTERM);
 
+#ifndef WIN32
+      fc::set_signal_handler([data_dir](int signal) {
+         const fc::path trace_path = data_dir / ( "trace-" + std::to_string( fc::time_point::now().sec_since_epoch() ) + ".json" );
+         std::ofstream out( trace_path.string() );
+         graphene::utilities::tracer::write_chrome_trace( out );
+         ilog( "Caught SIGUSR2, wrote the recorded trace spans to ${p}", ("p", trace_path) );
+      }, SIGUSR2);
+#endif
+
       ilog("Started witness node on a chain with ${h} blocks.", ("h", node->chain_database()->head_block_num()));
       ilog("Chain ID is ${id}", ("id", node->chain_database()->get_chain_id()) );
 
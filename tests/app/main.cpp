@@ -26,17 +26,29 @@
 
 #include <graphene/chain/balance_object.hpp>
 
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/net/node.hpp>
+#include <graphene/net/peer_connection.hpp>
+#include <graphene/net/peer_database.hpp>
+#include <graphene/net/rolling_item_filter.hpp>
+
 #include <graphene/time/time.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
 #include <graphene/account_history/account_history_plugin.hpp>
 
+#include <fc/io/json.hpp>
+#include <fc/network/tcp_socket.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <boost/filesystem/path.hpp>
 
+#include <atomic>
+#include <fstream>
+
 #define BOOST_TEST_MODULE Test Application
 #include <boost/test/included/unit_test.hpp>
 
@@ -152,3 +164,336 @@ BOOST_AUTO_TEST_CASE( two_node_network )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( witness_relay_pushes_blocks )
+{
+   using namespace graphene::chain;
+   using namespace graphene::app;
+   try {
+      fc::temp_directory app_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory app2_dir( graphene::utilities::temp_directory_path() );
+      // the initial witnesses all sign with this key
+      const fc::ecc::private_key witness_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "nathan" ) ) );
+
+      graphene::app::application app1;
+      app1.register_plugin<graphene::account_history::account_history_plugin>();
+      boost::program_options::variables_map cfg;
+      cfg.emplace( "p2p-endpoint", boost::program_options::variable_value( string( "127.0.0.1:3941" ), false ) );
+      cfg.emplace( "witness-relay-endpoint", boost::program_options::variable_value( vector<string>{ "127.0.0.1:4041" }, false ) );
+      app1.initialize( app_dir.path(), cfg );
+
+      graphene::app::application app2;
+      app2.register_plugin<graphene::account_history::account_history_plugin>();
+      boost::program_options::variables_map cfg2;
+      cfg2.emplace( "p2p-endpoint", boost::program_options::variable_value( string( "127.0.0.1:4041" ), false ) );
+      app2.initialize( app2_dir.path(), cfg2 );
+
+      app1.startup();
+      app1.p2p_node()->set_witness_relay_key( witness_key );
+      app2.startup();
+      // the key is there before app2 says hello to its relay
+      app2.p2p_node()->set_witness_relay_key( witness_key );
+      app2.p2p_node()->add_witness_relay_endpoint( fc::ip::endpoint::from_string( "127.0.0.1:3941" ) );
+      fc::usleep( fc::milliseconds( 1000 ) );
+      BOOST_REQUIRE_EQUAL( app2.p2p_node()->get_connection_count(), 1 );
+
+      std::shared_ptr<chain::database> db1 = app1.chain_database();
+      auto block = db1->generate_block( db1->get_slot_time( 1 ), db1->get_scheduled_witness( 1 ), witness_key,
+                                        database::skip_nothing );
+      app1.p2p_node()->broadcast( graphene::net::block_message( block ) );
+      fc::usleep( fc::milliseconds( 500 ) );
+
+      // app1 pushed the block without waiting to be asked for it
+      BOOST_CHECK_EQUAL( app2.chain_database()->head_block_num(), 1u );
+      BOOST_CHECK( app2.chain_database()->head_block_id() == block.id() );
+      BOOST_CHECK_EQUAL( app1.p2p_node()->network_get_statistics()["witness_relay_blocks_pushed"].as_uint64(), 1u );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( advertised_inventory_keeps_blocks_exact )
+{
+   using graphene::net::item_id;
+   auto make_item = []( uint32_t type, uint32_t n ) {
+      graphene::net::item_hash_t hash = fc::ripemd160::hash( (const char*)&n, sizeof(n) );
+      return item_id( type, hash );
+   };
+
+   graphene::net::advertised_inventory inventory( 1000 );
+   for( uint32_t i = 0; i < 1000; ++i )
+   {
+      inventory.insert( make_item( graphene::net::trx_message_type, i ) );
+      inventory.insert( make_item( graphene::net::block_message_type, i ) );
+   }
+   BOOST_CHECK( inventory.contains( make_item( graphene::net::trx_message_type, 7 ) ) );
+   BOOST_CHECK( inventory.contains( make_item( graphene::net::block_message_type, 7 ) ) );
+
+   // the full transaction filter reports some transactions it never saw, never a block
+   uint32_t transaction_false_positives = 0;
+   for( uint32_t i = 1000; i < 200000; ++i )
+   {
+      if( inventory.contains( make_item( graphene::net::trx_message_type, i ) ) )
+         ++transaction_false_positives;
+      BOOST_REQUIRE( !inventory.contains( make_item( graphene::net::block_message_type, i ) ) );
+   }
+   BOOST_CHECK( transaction_false_positives > 0 );
+
+   // the blocks are forgotten with the generation they were advertised in
+   graphene::net::advertised_inventory short_lived( 1000, fc::microseconds( 0 ) );
+   short_lived.insert( make_item( graphene::net::block_message_type, 1 ) );
+   BOOST_CHECK_EQUAL( short_lived.size(), 1u );
+   short_lived.expire();
+   BOOST_CHECK( !short_lived.contains( make_item( graphene::net::block_message_type, 1 ) ) );
+   BOOST_CHECK_EQUAL( short_lived.size(), 0u );
+}
+
+BOOST_AUTO_TEST_CASE( peer_database_imports_legacy_json )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path db_file = data_dir.path() / "peers.dat";
+      const fc::path good_json = data_dir.path() / "peers.json";
+      const fc::path bad_json = data_dir.path() / "broken.json";
+      const fc::ip::endpoint peer = fc::ip::endpoint::from_string( "127.0.0.1:4141" );
+      fc::json::save_to_file( std::vector<graphene::net::potential_peer_record>{ graphene::net::potential_peer_record( peer ) },
+                              good_json );
+      {
+         std::ofstream out( bad_json.string() );
+         out << "[ { \"endpoint\": ";
+      }
+
+      // a file that cannot be read is reported, the caller keeps it
+      graphene::net::peer_database db;
+      db.open( db_file );
+      BOOST_CHECK( !db.import_json( bad_json ) );
+      BOOST_CHECK_EQUAL( db.size(), 0u );
+
+      // the imported peers are saved by the import itself
+      BOOST_CHECK( db.import_json( good_json ) );
+      BOOST_CHECK( db.lookup_entry_for_endpoint( peer ).valid() );
+      BOOST_REQUIRE( fc::exists( db_file ) );
+      graphene::net::peer_database reopened;
+      reopened.open( db_file );
+      BOOST_CHECK( reopened.lookup_entry_for_endpoint( peer ).valid() );
+      reopened.close();
+      db.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_rebuilds_the_block )
+{
+   using namespace graphene::chain;
+   using graphene::net::compact_block_message;
+
+   signed_block block;
+   block.timestamp = fc::time_point_sec( 1431700000 );
+   for( uint32_t i = 0; i < 3; ++i )
+   {
+      signed_transaction trx;
+      trx.set_expiration( block.timestamp + fc::seconds( 10 + i ) );
+      trx.operations.push_back( transfer_operation() );
+      processed_transaction processed( trx );
+      processed.operation_results.push_back( object_id_type( 1, 2, i ) );
+      block.transactions.push_back( processed );
+   }
+   block.transaction_merkle_root = block.calculate_merkle_root();
+   const graphene::net::item_hash_t item_hash = graphene::net::message( graphene::net::block_message( block ) ).id();
+
+   // the peer is missing the last transaction only
+   const transaction_id_type known = block.transactions[0].id();
+   const transaction_id_type also_known = block.transactions[1].id();
+   auto peer_has = [&]( const signed_transaction& trx ) { return trx.id() == known || trx.id() == also_known; };
+   const graphene::net::message sent( compact_block_message( block, item_hash, peer_has ) );
+   const compact_block_message compact = sent.as<compact_block_message>();
+   BOOST_CHECK( compact.block_id == block.id() );
+   BOOST_CHECK( compact.item_hash == item_hash );
+   BOOST_REQUIRE_EQUAL( compact.transactions.size(), 3u );
+   BOOST_CHECK( !compact.transactions[0].transaction.valid() );
+   BOOST_CHECK( !compact.transactions[1].transaction.valid() );
+   BOOST_REQUIRE( compact.transactions[2].transaction.valid() );
+
+   // the receiver fills the known transactions in by short id and gets the same block back
+   signed_block rebuilt;
+   static_cast<signed_block_header&>( rebuilt ) = compact.header;
+   for( size_t i = 0; i < compact.transactions.size(); ++i )
+   {
+      const auto& compact_trx = compact.transactions[i];
+      BOOST_CHECK_EQUAL( compact_trx.short_id, compact_block_message::short_id( block.transactions[i].id() ) );
+      processed_transaction trx( compact_trx.transaction.valid() ? *compact_trx.transaction
+                                                                 : static_cast<const signed_transaction&>( block.transactions[i] ) );
+      trx.operation_results = compact_trx.operation_results;
+      rebuilt.transactions.push_back( trx );
+   }
+   BOOST_CHECK( rebuilt.calculate_merkle_root() == compact.header.transaction_merkle_root );
+   BOOST_CHECK( rebuilt.id() == compact.block_id );
+   BOOST_CHECK( graphene::net::message( graphene::net::block_message( rebuilt ) ).id() == item_hash );
+}
+
+BOOST_AUTO_TEST_CASE( peer_transaction_flood_control )
+{
+   graphene::net::token_bucket bucket;
+   // a rate of zero never runs out
+   for( uint32_t i = 0; i < 1000; ++i )
+      BOOST_REQUIRE( bucket.take() );
+
+   bucket.configure( 10, 20 );
+   const fc::time_point now = fc::time_point::now();
+   for( uint32_t i = 0; i < 20; ++i )
+      BOOST_CHECK( bucket.take( now ) );
+   BOOST_CHECK( !bucket.take( now ) );
+   // a tenth of a second gives back one token
+   BOOST_CHECK( bucket.take( now + fc::milliseconds( 100 ) ) );
+   BOOST_CHECK( !bucket.take( now + fc::milliseconds( 100 ) ) );
+   // an idle minute refills no more than the burst
+   uint32_t taken = 0;
+   while( bucket.take( now + fc::seconds( 60 ) ) )
+      ++taken;
+   BOOST_CHECK_EQUAL( taken, 20u );
+}
+
+namespace {
+   struct null_peer_delegate : public graphene::net::peer_connection_delegate
+   {
+      virtual void on_message( graphene::net::peer_connection*, const graphene::net::message& ) override {}
+      virtual void on_connection_closed( graphene::net::peer_connection* ) override {}
+      virtual graphene::net::message_ptr get_message_for_item( const graphene::net::item_id& ) override
+      {
+         return graphene::net::message_ptr();
+      }
+   };
+}
+
+BOOST_AUTO_TEST_CASE( peer_rejected_transactions_inhibit_fetching )
+{
+   null_peer_delegate delegate;
+   graphene::net::peer_connection_ptr peer = graphene::net::peer_connection::make_shared( &delegate );
+
+   // a peer at the threshold is still fetched from, the rejections are only scored per full sample
+   for( uint32_t i = 0; i < GRAPHENE_NET_PEER_TRX_PENALTY_MIN_SAMPLES; ++i )
+      peer->record_transaction_result( i % 2 == 0 );
+   BOOST_CHECK( !peer->is_transaction_fetching_inhibited() );
+   for( uint32_t i = 0; i < GRAPHENE_NET_PEER_TRX_PENALTY_MIN_SAMPLES - 1; ++i )
+      peer->record_transaction_result( false );
+   BOOST_CHECK( !peer->is_transaction_fetching_inhibited() );
+
+   // once a sample has more rejected than the threshold allows, the peer is left alone for a while
+   peer->record_transaction_result( false );
+   BOOST_CHECK( peer->is_transaction_fetching_inhibited() );
+   BOOST_CHECK( peer->transaction_fetching_inhibited_until <=
+                fc::time_point::now() + fc::seconds( GRAPHENE_NET_PEER_TRX_PENALTY_SECONDS ) );
+   BOOST_CHECK_EQUAL( peer->transactions_accepted + peer->transactions_rejected, 0u );
+}
+
+BOOST_AUTO_TEST_CASE( message_cache_keeps_to_its_byte_cap )
+{
+   try {
+      using namespace graphene::chain;
+      auto make_message = []( uint32_t n ) {
+         signed_transaction trx;
+         trx.set_expiration( fc::time_point_sec( 1431700000 + n ) );
+         trx.operations.push_back( transfer_operation() );
+         return graphene::net::message( graphene::net::trx_message( trx ) );
+      };
+      auto cache_statistics = []( const graphene::net::node& node ) {
+         return node.network_get_statistics()["message_cache"].get_object();
+      };
+
+      graphene::net::node node( "message cache test" );
+      const uint64_t cap = 20000;
+      node.set_advanced_node_parameters( fc::mutable_variant_object( "message_cache_size_in_bytes", cap ) );
+      const uint32_t count = 1000;
+      for( uint32_t i = 0; i < count; ++i )
+         node.broadcast( make_message( i ) );
+      // broadcasting a message again does not cache it twice
+      node.broadcast( make_message( count - 1 ) );
+
+      fc::variant_object stats = cache_statistics( node );
+      BOOST_CHECK( stats["bytes"].as_uint64() <= cap );
+      BOOST_CHECK( stats["messages"].as_uint64() > 0 );
+      BOOST_CHECK( stats["evicted_for_size"].as_uint64() > 0 );
+      BOOST_CHECK_EQUAL( stats["messages"].as_uint64() + stats["evicted_for_size"].as_uint64(), count );
+
+      // a lower cap evicts right away
+      node.set_advanced_node_parameters( fc::mutable_variant_object( "message_cache_size_in_bytes", cap / 2 ) );
+      stats = cache_statistics( node );
+      BOOST_CHECK( stats["bytes"].as_uint64() <= cap / 2 );
+      BOOST_CHECK_EQUAL( stats["maximum_bytes"].as_uint64(), cap / 2 );
+      BOOST_CHECK_EQUAL( stats["messages"].as_uint64() + stats["evicted_for_size"].as_uint64(), count );
+      node.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+namespace {
+   struct counting_delegate : public graphene::net::message_oriented_connection_delegate
+   {
+      std::atomic<uint32_t> messages{ 0 };
+      std::atomic<uint32_t> closed{ 0 };
+      virtual void on_message( graphene::net::message_oriented_connection*, const graphene::net::message& ) override
+      {
+         ++messages;
+      }
+      virtual void on_connection_closed( graphene::net::message_oriented_connection* ) override { ++closed; }
+   };
+}
+
+BOOST_AUTO_TEST_CASE( message_connection_closes_against_read_thread )
+{
+   using namespace graphene::net;
+   try {
+      fc::thread io_thread( "test_p2p_io" );
+      counting_delegate reader_events, sender_events;
+      fc::tcp_server server;
+      server.listen( 0 );
+
+      message_oriented_connection reader( &reader_events );
+      reader.set_read_thread( &io_thread );
+      fc::future<void> accepted = fc::async( [&]() {
+         server.accept( reader.get_socket() );
+         reader.accept();
+      }, "test accept" );
+      message_oriented_connection sender( &sender_events );
+      sender.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+      accepted.wait();
+
+      // the peer keeps sending while the owning thread closes the connection its read thread reads
+      const message inventory( item_ids_inventory_message( trx_message_type, std::vector<item_hash_t>( 100 ) ) );
+      std::atomic<bool> stop( false );
+      fc::future<void> sending = fc::async( [&]() {
+         try {
+            while( !stop )
+            {
+               sender.send_message( inventory );
+               fc::yield();
+            }
+         } catch( const fc::exception& ) {}
+      }, "test send" );
+      for( int i = 0; i < 5000 && reader_events.messages < 10; ++i )
+         fc::usleep( fc::milliseconds( 1 ) );
+      BOOST_REQUIRE( reader_events.messages >= 10 );
+
+      reader.close_connection();
+      for( int i = 0; i < 5000 && reader_events.closed == 0; ++i )
+         fc::usleep( fc::milliseconds( 1 ) );
+      BOOST_CHECK_EQUAL( reader_events.closed.load(), 1u );
+      const uint32_t received = reader_events.messages;
+      fc::usleep( fc::milliseconds( 20 ) );
+      BOOST_CHECK_EQUAL( reader_events.messages.load(), received );
+
+      stop = true;
+      sending.wait();
+      reader.destroy_connection();
+      sender.destroy_connection();
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+namespace graphene { namespace benchmarks {
+
+   /// the largest resident set size of the process so far, 0 where it is not known
+   inline uint64_t peak_rss_kb()
+   {
+#ifndef WIN32
+      struct rusage usage;
+      if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+#ifdef __APPLE__
+         return usage.ru_maxrss / 1024;
+#else
+         return usage.ru_maxrss;
+#endif
+#endif
+      return 0;
+   }
+
+   /**
+    *  Writes one line of machine readable benchmark output to stdout and, when the GRAPHENE_BENCH_REPORT
+    *  environment variable names a file, appends it there.
+    */
+   inline void write_report( const std::string& json_line )
+   {
+      std::cout << json_line << std::endl;
+      if( const char* path = std::getenv( "GRAPHENE_BENCH_REPORT" ) )
+      {
+         std::ofstream out( path, std::ios::app );
+         out << json_line << '\n';
+      }
+   }
+
+} } // graphene::benchmarks
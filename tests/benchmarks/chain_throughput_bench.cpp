@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <graphene/utilities/allocation_stats.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+
+#include "../common/database_fixture.hpp"
+#include "bench_report.hpp"
+
+using namespace graphene::chain;
+
+/**
+ *  One line of the machine readable benchmark output.  The latencies are those of single transactions
+ *  holding one operation, or of whole blocks for the maintenance benchmark.  The allocations are those of the
+ *  measured pushes, in a build with GRAPHENE_ALLOCATION_STATS only.
+ */
+struct throughput_report
+{
+   std::string name;
+   uint64_t    operations  = 0;
+   double      ops_per_sec = 0;
+   int64_t     p50_us      = 0;
+   int64_t     p99_us      = 0;
+   int64_t     max_us      = 0;
+   uint64_t    peak_rss_kb = 0;
+   double      allocations_per_op     = 0;
+   double      allocated_bytes_per_op = 0;
+};
+
+FC_REFLECT( throughput_report, (name)(operations)(ops_per_sec)(p50_us)(p99_us)(max_us)(peak_rss_kb)
+                               (allocations_per_op)(allocated_bytes_per_op) )
+
+namespace {
+
+#ifdef NDEBUG
+   const uint32_t ops_per_benchmark = 20000;
+#else
+   const uint32_t ops_per_benchmark = 2000;
+#endif
+   /// a block is generated after this many measured transactions, outside of the measurement
+   const uint32_t ops_per_block = 500;
+
+   /**
+    *  Times operations pushed one per transaction and reports them as a throughput_report, see
+    *  graphene::benchmarks::write_report().
+    */
+   class throughput_meter
+   {
+      public:
+         throughput_meter( database_fixture& fixture, std::string name )
+            : _fixture( fixture ), _name( std::move( name ) ) {}
+
+         processed_transaction push( const operation& op )
+         {
+            signed_transaction& trx = _fixture.trx;
+            trx.operations.clear();
+            trx.operations.push_back( op );
+            const auto allocations = graphene::utilities::allocation_stats::snapshot();
+            const auto start = fc::time_point::now();
+            auto result = _fixture.db.push_transaction( trx, ~0 );
+            record( fc::time_point::now() - start );
+            const auto pushed = ( graphene::utilities::allocation_stats::snapshot() - allocations ).total();
+            _allocations.allocations += pushed.allocations;
+            _allocations.bytes += pushed.bytes;
+            trx.operations.clear();
+            if( ++_since_block == ops_per_block )
+            {
+               _fixture.generate_block();
+               _since_block = 0;
+            }
+            return result;
+         }
+
+         /// adds a latency measured by the caller
+         void record( fc::microseconds elapsed ) { _latencies.push_back( elapsed.count() ); }
+
+         throughput_report report()
+         {
+            throughput_report r;
+            r.name = _name;
+            r.operations = _latencies.size();
+            r.peak_rss_kb = graphene::benchmarks::peak_rss_kb();
+            if( !_latencies.empty() )
+            {
+               std::sort( _latencies.begin(), _latencies.end() );
+               int64_t total = 0;
+               for( int64_t l : _latencies )
+                  total += l;
+               r.ops_per_sec = double( _latencies.size() ) * 1000000 / std::max<int64_t>( total, 1 );
+               r.p50_us = _latencies[ ( _latencies.size() - 1 ) / 2 ];
+               r.p99_us = _latencies[ ( _latencies.size() - 1 ) * 99 / 100 ];
+               r.max_us = _latencies.back();
+               r.allocations_per_op = double( _allocations.allocations ) / _latencies.size();
+               r.allocated_bytes_per_op = double( _allocations.bytes ) / _latencies.size();
+            }
+
+            graphene::benchmarks::write_report( fc::json::to_string( r ) );
+            return r;
+         }
+
+      private:
+         database_fixture&    _fixture;
+         std::string          _name;
+         std::vector<int64_t> _latencies;
+         uint32_t             _since_block = 0;
+         graphene::utilities::allocation_counts _allocations;
+   };
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( chain_throughput )
+
+BOOST_FIXTURE_TEST_CASE( transfer_throughput, database_fixture )
+{
+   try {
+      ACTORS((alice)(bob));
+      transfer( committee_account, alice_id, asset(100000000) );
+      transfer( committee_account, bob_id, asset(100000000) );
+
+      throughput_meter meter( *this, "transfer" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         transfer_operation op;
+         op.from   = i % 2 ? alice_id : bob_id;
+         op.to     = i % 2 ? bob_id : alice_id;
+         op.amount = asset( 1 + i % 7 );
+         meter.push( op );
+      }
+      meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( limit_order_throughput, database_fixture )
+{
+   try {
+      const uint32_t book_depth = ops_per_benchmark / 4;
+      const uint32_t orders_per_trx = 50;
+
+      ACTORS((maker));
+      const auto& uia  = create_user_issued_asset( "BENCHUIA" );
+      const auto& core = asset_id_type()(db);
+      transfer( committee_account, maker_id, asset(100000000) );
+      issue_uia( maker, uia.amount(100000000) );
+
+      // a dense book of asks above 1.1 CORE/UIA and bids below 0.91 CORE/UIA, none of them crossing
+      auto book_order = [&]( uint32_t i ) {
+         limit_order_create_operation op;
+         op.seller = maker_id;
+         if( i % 2 == 0 )
+         {
+            op.amount_to_sell = uia.amount( 1000 );
+            op.min_to_receive = core.amount( 1100 + i );
+         }
+         else
+         {
+            op.amount_to_sell = core.amount( 1000 );
+            op.min_to_receive = uia.amount( 1100 + i );
+         }
+         return op;
+      };
+      for( uint32_t i = 0; i < 2 * book_depth; )
+      {
+         for( uint32_t n = 0; n < orders_per_trx && i < 2 * book_depth; ++n, ++i )
+            trx.operations.push_back( book_order( i ) );
+         db.push_transaction( trx, ~0 );
+         trx.operations.clear();
+      }
+      generate_block();
+
+      // new orders land between the existing ones and are cancelled again
+      throughput_meter create_meter( *this, "limit_order_create" );
+      throughput_meter cancel_meter( *this, "limit_order_cancel" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         auto processed = create_meter.push( book_order( ( i * 7919 ) % ( 2 * book_depth ) ) );
+         limit_order_cancel_operation cancel;
+         cancel.fee_paying_account = maker_id;
+         cancel.order = processed.operation_results[0].get<object_id_type>();
+         cancel_meter.push( cancel );
+      }
+      create_meter.report();
+      cancel_meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( account_throughput, database_fixture )
+{
+   try {
+      throughput_meter create_meter( *this, "account_create" );
+      vector<account_id_type> accounts;
+      accounts.reserve( ops_per_benchmark );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         auto processed = create_meter.push( make_account( "bench" + fc::to_string(i) ) );
+         accounts.push_back( processed.operation_results[0].get<object_id_type>() );
+      }
+      create_meter.report();
+
+      // every update votes for all witnesses and committee members
+      flat_set<vote_id_type> votes;
+      uint16_t num_witness = 0;
+      uint16_t num_committee = 0;
+      for( const witness_object& w : db.get_index_type<witness_index>().indices() )
+      {
+         votes.insert( w.vote_id );
+         ++num_witness;
+      }
+      for( const committee_member_object& c : db.get_index_type<committee_member_index>().indices() )
+      {
+         votes.insert( c.vote_id );
+         ++num_committee;
+      }
+
+      throughput_meter update_meter( *this, "account_update_votes" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         account_update_operation op;
+         op.account = accounts[i];
+         op.new_options = accounts[i](db).options;
+         op.new_options->votes = votes;
+         op.new_options->num_witness = num_witness;
+         op.new_options->num_committee = num_committee;
+         update_meter.push( op );
+      }
+      update_meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( proposal_throughput, database_fixture )
+{
+   try {
+      ACTORS((nathan));
+      transfer( committee_account, nathan_id, asset(100000000) );
+
+      throughput_meter create_meter( *this, "proposal_create" );
+      throughput_meter approve_meter( *this, "proposal_approve" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         transfer_operation payment;
+         payment.from   = nathan_id;
+         payment.to     = committee_account;
+         payment.amount = asset( 1 + i % 7 );
+
+         proposal_create_operation op;
+         op.fee_paying_account = nathan_id;
+         op.proposed_ops.emplace_back( payment );
+         op.expiration_time = db.head_block_time() + fc::hours(1);
+         auto processed = create_meter.push( op );
+
+         // the approval authorizes the proposal, which is then executed
+         proposal_update_operation approval;
+         approval.fee_paying_account = nathan_id;
+         approval.proposal = processed.operation_results[0].get<object_id_type>();
+         approval.active_approvals_to_add.insert( nathan_id );
+         approve_meter.push( approval );
+      }
+      create_meter.report();
+      approve_meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( feed_and_settle_throughput, database_fixture )
+{
+   try {
+      ACTORS((borrower)(feeder));
+      const auto& bitusd = create_bitasset( "USDBIT", feeder_id );
+      const auto& core   = asset_id_type()(db);
+
+      update_feed_producers( bitusd, {feeder.id} );
+      price_feed feed;
+      feed.settlement_price = bitusd.amount( 1 ) / core.amount( 1 );
+      publish_feed( bitusd, feeder, feed );
+
+      transfer( committee_account, borrower_id, asset(400000000) );
+      borrow( borrower, bitusd.amount(100000000), asset(400000000) );
+
+      // the feed moves slightly around 1 CORE/USD, far from margin calls
+      throughput_meter feed_meter( *this, "asset_publish_feed" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         asset_publish_feed_operation op;
+         op.publisher = feeder_id;
+         op.asset_id = bitusd.id;
+         op.feed = feed;
+         op.feed.settlement_price = bitusd.amount( 1000 ) / core.amount( 995 + i % 10 );
+         feed_meter.push( op );
+      }
+      feed_meter.report();
+
+      throughput_meter settle_meter( *this, "asset_settle" );
+      for( uint32_t i = 0; i < ops_per_benchmark; ++i )
+      {
+         asset_settle_operation op;
+         op.account = borrower_id;
+         op.amount = bitusd.amount( 100 );
+         settle_meter.push( op );
+      }
+      settle_meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( maintenance_throughput, database_fixture )
+{
+   try {
+      const uint32_t account_count = ops_per_benchmark * 5;
+      const uint32_t accounts_per_trx = 100;
+      const uint32_t intervals = 5;
+
+      vector<account_id_type> accounts;
+      accounts.reserve( account_count );
+      for( uint32_t i = 0; i < account_count; )
+      {
+         for( uint32_t n = 0; n < accounts_per_trx && i < account_count; ++n, ++i )
+            trx.operations.push_back( make_account( "voter" + fc::to_string(i) ) );
+         auto processed = db.push_transaction( trx, ~0 );
+         for( const auto& result : processed.operation_results )
+            accounts.push_back( result.get<object_id_type>() );
+         trx.operations.clear();
+         // also keeps the direct changes below from being undone with pending transactions
+         generate_block();
+      }
+
+      // every account votes for a few witnesses with some stake
+      const auto& witnesses = db.get_index_type<witness_index>().indices();
+      vector<vote_id_type> witness_votes;
+      for( const witness_object& w : witnesses )
+         witness_votes.push_back( w.vote_id );
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         db.modify( accounts[i](db), [&]( account_object& a ) {
+            for( uint32_t v = 0; v < 3; ++v )
+               a.options.votes.insert( witness_votes[(i + v) % witness_votes.size()] );
+            a.options.num_witness = a.options.votes.size();
+         });
+         db.adjust_balance( GRAPHENE_COMMITTEE_ACCOUNT, -asset( 1000 ) );
+         db.adjust_balance( accounts[i], asset( 1000 ) );
+      }
+
+      throughput_meter meter( *this, "maintenance_interval_" + fc::to_string( account_count ) + "_accounts" );
+      for( uint32_t i = 0; i < intervals; ++i )
+      {
+         generate_blocks( db.get_dynamic_global_properties().next_maintenance_time - db.get_global_properties().parameters.block_interval );
+         const auto start = fc::time_point::now();
+         generate_block();
+         meter.record( fc::time_point::now() - start );
+      }
+      meter.report();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -38,7 +38,7 @@ BOOST_AUTO_TEST_CASE( operation_sanity_check )
 {
    try {
       operation op = account_create_operation();
-      op.get<account_create_operation>().active.add_authority(account_id_type(), 123);
+      op.get<account_create_operation>().active->add_authority(account_id_type(), 123);
       operation tmp = std::move(op);
       wdump((tmp.which()));
    } catch (fc::exception& e) {
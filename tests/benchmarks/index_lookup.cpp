@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_CASE( index_lookup_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t account_count = 200000;
+      const uint32_t rounds = 50;
+#else
+      const uint32_t account_count = 20000;
+      const uint32_t rounds = 5;
+#endif
+
+      database db;
+      for( uint32_t i = 0; i < account_count; ++i )
+         db.create<account_object>( [&]( account_object& a ) { a.name = "bench" + fc::to_string(i); } );
+
+      uint64_t checksum = 0;
+      auto start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( uint32_t i = 0; i < account_count; ++i )
+            checksum += account_id_type(i)(db).name.size();
+      auto virtual_time = fc::time_point::now() - start_time;
+
+      uint64_t typed_checksum = 0;
+      start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( uint32_t i = 0; i < account_count; ++i )
+            typed_checksum += db.get_typed<account_index>( account_id_type(i) ).name.size();
+      auto typed_time = fc::time_point::now() - start_time;
+
+      BOOST_CHECK_EQUAL( checksum, typed_checksum );
+      const uint64_t lookups = uint64_t(account_count) * rounds;
+      ilog( "${n} lookups: db.get ${v} ns/lookup, get_typed ${t} ns/lookup",
+            ("n",lookups)
+            ("v",double(virtual_time.count()) * 1000 / lookups)
+            ("t",double(typed_time.count()) * 1000 / lookups) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( balance_lookup_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t account_count = 200000;
+      const uint32_t rounds = 50;
+#else
+      const uint32_t account_count = 20000;
+      const uint32_t rounds = 5;
+#endif
+      const uint32_t assets_per_account = 3;
+
+      database db;
+      for( uint32_t i = 0; i < account_count; ++i )
+         for( uint32_t a = 0; a < assets_per_account; ++a )
+            db.create<account_balance_object>( [&]( account_balance_object& b ) {
+               b.owner = account_id_type(i);
+               b.asset_type = asset_id_type(a);
+               b.balance = i + a;
+            });
+
+      const auto& balances = db.get_index_type<account_balance_index>().indices();
+      const auto& ordered = balances.get<by_account_asset>();
+      const auto& hashed = balances.get<by_account_asset_hash>();
+
+      int64_t ordered_sum = 0;
+      auto start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( uint32_t i = 0; i < account_count; ++i )
+            ordered_sum += ordered.find( boost::make_tuple( account_id_type(i), asset_id_type(i % assets_per_account) ) )->balance.value;
+      auto ordered_time = fc::time_point::now() - start_time;
+
+      int64_t hashed_sum = 0;
+      start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( uint32_t i = 0; i < account_count; ++i )
+            hashed_sum += hashed.find( boost::make_tuple( account_id_type(i), asset_id_type(i % assets_per_account) ) )->balance.value;
+      auto hashed_time = fc::time_point::now() - start_time;
+
+      BOOST_CHECK_EQUAL( ordered_sum, hashed_sum );
+      const uint64_t lookups = uint64_t(account_count) * rounds;
+      ilog( "${n} balance lookups: ordered ${o} ns/lookup, hashed ${h} ns/lookup",
+            ("n",lookups)
+            ("o",double(ordered_time.count()) * 1000 / lookups)
+            ("h",double(hashed_time.count()) * 1000 / lookups) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <atomic>
+#include <memory>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_CASE( merkle_root_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t transaction_count = 20000;
+      const uint32_t rounds = 20;
+#else
+      const uint32_t transaction_count = 2000;
+      const uint32_t rounds = 5;
+#endif
+      const uint32_t thread_count = 4;
+
+      signed_block block;
+      for( uint32_t i = 0; i < transaction_count; ++i )
+      {
+         processed_transaction trx;
+         trx.ref_block_prefix = i;
+         transfer_operation op;
+         op.amount = asset( i );
+         trx.operations.push_back( op );
+         block.transactions.push_back( trx );
+      }
+
+      vector< std::unique_ptr<fc::thread> > threads;
+      for( uint32_t i = 0; i < thread_count; ++i )
+         threads.emplace_back( new fc::thread( "merkle_bench" ) );
+      auto on_threads = [&]( size_t count, const std::function<void(size_t)>& task ) {
+         std::atomic<size_t> next(0);
+         vector< fc::future<void> > results;
+         for( const auto& t : threads )
+            results.push_back( t->async( [&]() {
+               for( size_t n = next++; n < count; n = next++ )
+                  task( n );
+            } ) );
+         for( auto& r : results )
+            r.wait();
+      };
+
+      checksum_type serial_root;
+      auto start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         serial_root = block.calculate_merkle_root();
+      auto serial_time = fc::time_point::now() - start_time;
+
+      checksum_type parallel_root;
+      start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         parallel_root = block.calculate_merkle_root( on_threads );
+      auto parallel_time = fc::time_point::now() - start_time;
+
+      BOOST_CHECK( serial_root == parallel_root );
+      ilog( "merkle root of ${n} transactions: ${s} us on one thread, ${p} us on ${t} threads",
+            ("n",transaction_count)("s",serial_time.count() / rounds)("p",parallel_time.count() / rounds)("t",thread_count) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/application.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/node.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "bench_report.hpp"
+
+using namespace graphene::chain;
+
+namespace graphene { namespace app { namespace detail {
+   genesis_state_type create_example_genesis();
+} } } // graphene::app::detail
+
+namespace {
+
+   uint32_t env_uint( const char* name, uint32_t default_value )
+   {
+      const char* value = std::getenv( name );
+      return value ? uint32_t( std::stoul( value ) ) : default_value;
+   }
+
+   struct link_properties
+   {
+      uint32_t latency_ms = 0;
+      /** bytes per second in each direction, 0 for no limit */
+      uint64_t bandwidth = 0;
+      /** percentage of the chunks read from a socket that are lost once, each costs a retransmission timeout */
+      uint32_t loss_percent = 0;
+   };
+
+   /**
+    * A TCP relay standing in for the network between two nodes.  Everything written to it reaches the target
+    * after the link's latency, no faster than its bandwidth, and in order, so a lost chunk holds up the ones
+    * behind it like a retransmission does.  All its tasks run on the thread passed in.
+    */
+   class simulated_link
+   {
+      public:
+         simulated_link( fc::thread& thread, const link_properties& props, const fc::ip::endpoint& target )
+            : _thread( thread ), _props( props ), _target( target ), _random( target.port() )
+         {
+            _thread.async( [this]() { _server.listen( 0 ); } ).wait();
+            _accept_done = _thread.async( [this]() { accept_loop(); }, "simulated_link accept" );
+         }
+
+         ~simulated_link()
+         {
+            _thread.async( [this]() {
+               _server.close();
+               for( const auto& s : _sockets )
+                  s->close();
+               if( _accept_done.valid() && !_accept_done.ready() )
+                  _accept_done.cancel_and_wait( "~simulated_link()" );
+               for( auto& task : _tasks )
+                  if( task.valid() && !task.ready() )
+                     task.cancel_and_wait( "~simulated_link()" );
+            } ).wait();
+         }
+
+         fc::ip::endpoint endpoint()const { return fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), _server.get_port() ); }
+
+      private:
+         struct direction
+         {
+            std::shared_ptr<fc::tcp_socket>                             to;
+            std::deque< std::pair<fc::time_point, std::vector<char>> >  queue;
+            fc::time_point                                              link_free;
+            fc::time_point                                              last_due;
+         };
+
+         void accept_loop()
+         {
+            while( true )
+            {
+               auto incoming = std::make_shared<fc::tcp_socket>();
+               _server.accept( *incoming );
+               auto outgoing = std::make_shared<fc::tcp_socket>();
+               outgoing->connect_to( _target );
+               _sockets.push_back( incoming );
+               _sockets.push_back( outgoing );
+               start_direction( incoming, outgoing );
+               start_direction( outgoing, incoming );
+            }
+         }
+
+         void start_direction( const std::shared_ptr<fc::tcp_socket>& from, const std::shared_ptr<fc::tcp_socket>& to )
+         {
+            auto dir = std::make_shared<direction>();
+            dir->to = to;
+            _tasks.push_back( _thread.async( [this, from, dir]() { read_loop( *from, *dir ); }, "simulated_link read" ) );
+            _tasks.push_back( _thread.async( [this, dir]() { write_loop( *dir ); }, "simulated_link write" ) );
+         }
+
+         void read_loop( fc::tcp_socket& from, direction& dir )
+         {
+            std::vector<char> buffer( 64 * 1024 );
+            try
+            {
+               while( true )
+               {
+                  const size_t n = from.readsome( buffer.data(), buffer.size() );
+                  const fc::time_point now = fc::time_point::now();
+                  dir.link_free = std::max( dir.link_free, now );
+                  if( _props.bandwidth )
+                     dir.link_free += fc::microseconds( int64_t( n * 1000000 / _props.bandwidth ) );
+                  fc::time_point due = dir.link_free + fc::milliseconds( _props.latency_ms );
+                  if( _props.loss_percent && std::uniform_int_distribution<uint32_t>( 0, 99 )( _random ) < _props.loss_percent )
+                     due += fc::milliseconds( std::max<uint32_t>( 200, 2 * _props.latency_ms ) );
+                  dir.last_due = std::max( dir.last_due, due );
+                  dir.queue.emplace_back( dir.last_due, std::vector<char>( buffer.begin(), buffer.begin() + n ) );
+               }
+            }
+            catch( const fc::exception& )
+            {
+               // the node closed the connection, closing the other side tells the other node
+               dir.to->close();
+            }
+         }
+
+         void write_loop( direction& dir )
+         {
+            try
+            {
+               while( true )
+               {
+                  if( dir.queue.empty() )
+                  {
+                     fc::usleep( fc::milliseconds( 1 ) );
+                     continue;
+                  }
+                  const fc::time_point due = dir.queue.front().first;
+                  const fc::time_point now = fc::time_point::now();
+                  if( now < due )
+                     fc::usleep( due - now );
+                  const std::vector<char> chunk = std::move( dir.queue.front().second );
+                  dir.queue.pop_front();
+                  dir.to->write( chunk.data(), chunk.size() );
+                  dir.to->flush();
+               }
+            }
+            catch( const fc::exception& )
+            {
+            }
+         }
+
+         fc::thread&                                   _thread;
+         const link_properties                         _props;
+         const fc::ip::endpoint                        _target;
+         std::mt19937                                  _random;
+         fc::tcp_server                                _server;
+         fc::future<void>                              _accept_done;
+         std::vector< fc::future<void> >               _tasks;
+         std::vector< std::shared_ptr<fc::tcp_socket> > _sockets;
+   };
+
+   /** one application with its p2p node, listening on an ephemeral port and connected only through links */
+   struct simulated_node
+   {
+      simulated_node( const fc::path& genesis_file, uint32_t links )
+      {
+         namespace bpo = boost::program_options;
+         bpo::options_description cli, cfg;
+         app.set_program_options( cli, cfg );
+         cli.add( cfg );
+         const std::vector<std::string> args = { "--p2p-endpoint", "127.0.0.1:0",
+                                                 "--genesis-json", genesis_file.generic_string() };
+         bpo::variables_map options;
+         bpo::store( bpo::command_line_parser( args ).options( cli ).run(), options );
+         app.initialize( dir.path(), options );
+         app.startup();
+         // the nodes must not find each other around the links
+         app.p2p_node()->disable_peer_advertising();
+         app.p2p_node()->set_advanced_node_parameters( fc::mutable_variant_object()
+               ( "desired_number_of_connections", links )
+               ( "maximum_number_of_connections", links ) );
+         db = app.chain_database();
+         connection = db->applied_block.connect( [this]( const signed_block& b ) {
+            std::lock_guard<std::mutex> guard( mutex );
+            arrivals.insert( std::make_pair( b.id(), fc::time_point::now() ) );
+         }, "network_simulation" );
+      }
+
+      ~simulated_node()
+      {
+         connection.disconnect();
+         app.shutdown();
+      }
+
+      fc::ip::endpoint endpoint() { return app.p2p_node()->get_actual_listening_endpoint(); }
+
+      fc::temp_directory                                dir{ graphene::utilities::temp_directory_path() };
+      graphene::app::application                        app;
+      std::shared_ptr<database>                         db;
+      observer_connection                               connection;
+      std::mutex                                        mutex;
+      /** when each block was first applied here */
+      std::map<block_id_type, fc::time_point>           arrivals;
+   };
+
+   fc::variant distribution( std::vector<int64_t> micros )
+   {
+      fc::mutable_variant_object result;
+      result( "count", micros.size() );
+      if( micros.empty() )
+         return fc::variant( result );
+      std::sort( micros.begin(), micros.end() );
+      auto ms = [&micros]( size_t permille ) {
+         return double( micros[ ( micros.size() - 1 ) * permille / 1000 ] ) / 1000;
+      };
+      result( "p50_ms", ms( 500 ) )( "p90_ms", ms( 900 ) )( "p99_ms", ms( 990 ) )( "max_ms", ms( 1000 ) );
+      return fc::variant( result );
+   }
+
+} // anonymous namespace
+
+/**
+ * Runs nodes in one process, each a graphene::app::application with its own p2p node, connected in a ring with
+ * chords through simulated links.  Nodes take turns producing blocks, each deciding from its own head whether the
+ * next slot is one of its witnesses', so slow propagation shows up as forks.  Configured through the environment:
+ *
+ *   GRAPHENE_SIM_NODES              nodes, 6 by default
+ *   GRAPHENE_SIM_PEERS              links each node opens to the nodes after it, 2 by default
+ *   GRAPHENE_SIM_LATENCY_MS         one way latency of a link, 50 by default
+ *   GRAPHENE_SIM_BANDWIDTH_KBPS     KiB per second in each direction of a link, 0 (no limit) by default
+ *   GRAPHENE_SIM_LOSS_PERCENT       chunks that need a retransmission, 0 by default
+ *   GRAPHENE_SIM_BLOCKS             slots to produce blocks for
+ *   GRAPHENE_SIM_BLOCK_INTERVAL_MS  wall clock time between slots, 1000 by default
+ *
+ * The report has the time from producing a block until each other node applied it, the time until all nodes had
+ * it, how many produced blocks did not make it into the final chain, and how fast a node joining at the end synced
+ * the chain through one link.
+ */
+BOOST_AUTO_TEST_CASE( network_simulation_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t default_blocks = 120;
+#else
+      const uint32_t default_blocks = 30;
+#endif
+      const uint32_t num_nodes = std::max<uint32_t>( 2, env_uint( "GRAPHENE_SIM_NODES", 6 ) );
+      const uint32_t peers = std::min( num_nodes - 1, std::max<uint32_t>( 1, env_uint( "GRAPHENE_SIM_PEERS", 2 ) ) );
+      const uint32_t num_blocks = env_uint( "GRAPHENE_SIM_BLOCKS", default_blocks );
+      const uint32_t interval_ms = env_uint( "GRAPHENE_SIM_BLOCK_INTERVAL_MS", 1000 );
+      link_properties props;
+      props.latency_ms = env_uint( "GRAPHENE_SIM_LATENCY_MS", 50 );
+      props.bandwidth = uint64_t( env_uint( "GRAPHENE_SIM_BANDWIDTH_KBPS", 0 ) ) * 1024;
+      props.loss_percent = env_uint( "GRAPHENE_SIM_LOSS_PERCENT", 0 );
+
+      genesis_state_type genesis = graphene::app::detail::create_example_genesis();
+      fc::temp_file genesis_file( graphene::utilities::temp_directory_path() );
+      fc::json::save_to_file( genesis, genesis_file.path() );
+      const fc::ecc::private_key key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "nathan" ) ) );
+
+      fc::thread link_thread( "network simulation" );
+      std::vector< std::unique_ptr<simulated_link> > links;
+      std::vector< std::unique_ptr<simulated_node> > nodes;
+      // every node has its own links plus the ones of the nodes before it
+      for( uint32_t i = 0; i < num_nodes; ++i )
+         nodes.emplace_back( new simulated_node( genesis_file.path(), 2 * peers ) );
+      for( uint32_t i = 0; i < num_nodes; ++i )
+         for( uint32_t p = 1; p <= peers; ++p )
+         {
+            links.emplace_back( new simulated_link( link_thread, props, nodes[ ( i + p ) % num_nodes ]->endpoint() ) );
+            nodes[i]->app.p2p_node()->connect_to_endpoint( links.back()->endpoint() );
+         }
+      fc::usleep( fc::seconds( 2 ) );
+
+      // the witnesses are spread over the nodes, which all hold the key of the example genesis
+      std::map<block_id_type, std::pair<uint32_t, fc::time_point>> produced;
+      const fc::time_point_sec first_slot = genesis.initial_timestamp;
+      const uint32_t block_interval = genesis.initial_parameters.block_interval;
+      for( uint32_t s = 1; s <= num_blocks; ++s )
+      {
+         const fc::time_point tick = fc::time_point::now() + fc::milliseconds( interval_ms );
+         const fc::time_point_sec when = first_slot + s * block_interval;
+         for( uint32_t i = 0; i < num_nodes; ++i )
+         {
+            database& db = *nodes[i]->db;
+            const uint32_t slot = db.get_slot_at_time( when );
+            if( slot == 0 || db.get_scheduled_witness( slot ).instance.value % num_nodes != i )
+               continue;
+            const signed_block block = db.generate_block( when, db.get_scheduled_witness( slot ), key, database::skip_nothing );
+            produced[ block.id() ] = std::make_pair( i, fc::time_point::now() );
+            nodes[i]->app.p2p_node()->broadcast( graphene::net::block_message( block ) );
+         }
+         fc::usleep( tick - fc::time_point::now() );
+      }
+      fc::usleep( fc::seconds( 2 ) );
+
+      std::vector<int64_t> propagation, complete;
+      uint32_t orphaned = 0;
+      const database& reference = *nodes[0]->db;
+      for( const auto& item : produced )
+      {
+         const auto in_chain = reference.fetch_block_by_number( block_header::num_from_id( item.first ) );
+         if( !in_chain || in_chain->id() != item.first )
+            ++orphaned;
+         int64_t last = 0;
+         bool everywhere = true;
+         for( uint32_t i = 0; i < num_nodes; ++i )
+         {
+            if( i == item.second.first )
+               continue;
+            std::lock_guard<std::mutex> guard( nodes[i]->mutex );
+            auto arrival = nodes[i]->arrivals.find( item.first );
+            if( arrival == nodes[i]->arrivals.end() )
+            {
+               everywhere = false;
+               continue;
+            }
+            const int64_t t = ( arrival->second - item.second.second ).count();
+            propagation.push_back( t );
+            last = std::max( last, t );
+         }
+         if( everywhere )
+            complete.push_back( last );
+      }
+      bool converged = true;
+      for( const auto& node : nodes )
+         converged = converged && node->db->head_block_id() == reference.head_block_id();
+
+      // a node joining late catches up through one link
+      const uint32_t sync_target = reference.head_block_num();
+      const fc::time_point sync_start = fc::time_point::now();
+      simulated_node late( genesis_file.path(), 1 );
+      links.emplace_back( new simulated_link( link_thread, props, nodes[0]->endpoint() ) );
+      late.app.p2p_node()->connect_to_endpoint( links.back()->endpoint() );
+      while( late.db->head_block_num() < sync_target && fc::time_point::now() < sync_start + fc::seconds( 120 ) )
+         fc::usleep( fc::milliseconds( 10 ) );
+      const double sync_seconds = double( ( fc::time_point::now() - sync_start ).count() ) / 1000000;
+
+      BOOST_CHECK( !produced.empty() );
+      BOOST_CHECK_EQUAL( late.db->head_block_num(), sync_target );
+      graphene::benchmarks::write_report( fc::json::to_string( fc::mutable_variant_object()
+            ( "name", "network_simulation" )
+            ( "nodes", num_nodes )( "peers", peers )
+            ( "latency_ms", props.latency_ms )( "bandwidth", props.bandwidth )( "loss_percent", props.loss_percent )
+            ( "block_interval_ms", interval_ms )
+            ( "produced", produced.size() )
+            ( "orphaned", orphaned )
+            ( "fork_rate", produced.empty() ? 0.0 : double( orphaned ) / produced.size() )
+            ( "converged", converged )
+            ( "propagation", distribution( propagation ) )
+            ( "complete_propagation", distribution( complete ) )
+            ( "sync_blocks", late.db->head_block_num() )
+            ( "sync_seconds", sync_seconds )
+            ( "sync_blocks_per_sec", sync_seconds > 0 ? late.db->head_block_num() / sync_seconds : 0.0 )
+            ( "network", nodes[0]->app.p2p_node()->network_get_statistics() )
+            ( "peak_rss_kb", graphene::benchmarks::peak_rss_kb() ) ) );
+
+      links.clear();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( order_matching_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t book_depth = 2000;
+#else
+      const uint32_t book_depth = 200;
+#endif
+      const uint32_t orders_per_trx = 50;
+
+      // the margin call checks are only cached after #436
+      generate_blocks( HARDFORK_436_TIME );
+      generate_block();
+
+      ACTORS((maker)(taker)(borrower)(feeder));
+      const auto& bitusd = create_bitasset( "USDBIT", feeder_id );
+      const auto& core   = asset_id_type()(db);
+
+      update_feed_producers( bitusd, {feeder.id} );
+      price_feed feed;
+      feed.settlement_price = bitusd.amount( 1 ) / core.amount( 1 );
+      publish_feed( bitusd, feeder, feed );
+
+      transfer( committee_account, borrower_id, asset(100000000) );
+      transfer( committee_account, maker_id, asset(100000000) );
+      transfer( committee_account, taker_id, asset(100000000) );
+      borrow( borrower, bitusd.amount(10000000), asset(40000000) );
+      transfer( borrower, maker, bitusd.amount(10000000) );
+
+      // like a market maker, send the orders in transactions of orders_per_trx operations each
+      auto place_orders = [&]( uint32_t count, const std::function<limit_order_create_operation(uint32_t)>& make_order )
+      {
+         auto start_time = fc::time_point::now();
+         for( uint32_t i = 0; i < count; )
+         {
+            for( uint32_t n = 0; n < orders_per_trx && i < count; ++n, ++i )
+               trx.operations.push_back( make_order( i ) );
+            db.push_transaction( trx, ~0 );
+            trx.operations.clear();
+         }
+         return fc::time_point::now() - start_time;
+      };
+      auto orders_per_sec = []( uint32_t count, fc::microseconds elapsed ) {
+         return double(count) * 1000000 / std::max<int64_t>( elapsed.count(), 1 );
+      };
+
+      // a dense book of asks above 1.1 CORE/USD and bids below 0.91 CORE/USD, none of them crossing
+      auto placing_time = place_orders( 2 * book_depth, [&]( uint32_t i ) {
+         limit_order_create_operation op;
+         op.seller = maker_id;
+         if( i % 2 == 0 )
+         {
+            op.amount_to_sell = bitusd.amount( 1000 );
+            op.min_to_receive = core.amount( 1100 + i );
+         }
+         else
+         {
+            op.amount_to_sell = core.amount( 1000 );
+            op.min_to_receive = bitusd.amount( 1100 + i );
+         }
+         return op;
+      });
+
+      // each taker order crosses the spread and fills a few of the cheapest asks
+      const uint32_t taker_orders = book_depth / 2;
+      auto taking_time = place_orders( taker_orders, [&]( uint32_t ) {
+         limit_order_create_operation op;
+         op.seller = taker_id;
+         op.amount_to_sell = core.amount( 3500 );
+         op.min_to_receive = bitusd.amount( 1000 );
+         return op;
+      });
+
+      const auto& limit_idx = db.get_index_type<limit_order_index>().indices();
+      ilog( "placed ${n} non-crossing orders in ${t} ms, ${r} orders/sec",
+            ("n",2 * book_depth)("t",placing_time.count() / 1000)("r",orders_per_sec( 2 * book_depth, placing_time )) );
+      ilog( "matched ${n} crossing orders in ${t} ms, ${r} orders/sec, ${o} orders left in the book",
+            ("n",taker_orders)("t",taking_time.count() / 1000)("r",orders_per_sec( taker_orders, taking_time ))
+            ("o",limit_idx.size()) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+
+#include "bench_report.hpp"
+
+using namespace graphene::chain;
+
+namespace {
+
+   std::string env( const char* name )
+   {
+      const char* value = std::getenv( name );
+      return value ? std::string( value ) : std::string();
+   }
+
+   /// copies the block log so the replay may drop blocks after a gap without touching the recording
+   void copy_directory( const boost::filesystem::path& from, const boost::filesystem::path& to )
+   {
+      boost::filesystem::create_directories( to );
+      for( boost::filesystem::directory_iterator itr( from ), end; itr != end; ++itr )
+      {
+         const auto target = to / itr->path().filename();
+         if( boost::filesystem::is_directory( itr->path() ) )
+            copy_directory( itr->path(), target );
+         else
+            boost::filesystem::copy_file( itr->path(), target );
+      }
+   }
+
+} // anonymous namespace
+
+/**
+ * Replays a recorded segment of a real chain, configured through the environment:
+ *
+ *   GRAPHENE_REPLAY_BLOCKS     a block_num_to_block directory of a node, required
+ *   GRAPHENE_REPLAY_SNAPSHOT   a snapshot written by export_state_snapshot() at the start of the segment
+ *   GRAPHENE_REPLAY_GENESIS    the genesis JSON to replay from block 1 instead, without a snapshot
+ *   GRAPHENE_REPLAY_SKIP       skip flags for the replay, database::set_replay_skip_flags() by default
+ *   GRAPHENE_REPLAY_THREADS    signature threads, 0 by default
+ *   GRAPHENE_REPLAY_LOOKAHEAD  transactions prefetched ahead, database::set_transaction_prefetch_depth(), 0 by default
+ *
+ * The report carries the replay_statistics with the time of each phase, the operation statistics, the memory
+ * held by the indexes and the state hash at the end, which has to be the same for every run of a segment.  A build
+ * with GRAPHENE_ALLOCATION_STATS adds the heap allocations of the replay by phase.
+ */
+BOOST_AUTO_TEST_CASE( recorded_replay_bench )
+{
+   try {
+      const std::string blocks_dir = env( "GRAPHENE_REPLAY_BLOCKS" );
+      if( blocks_dir.empty() )
+      {
+         BOOST_TEST_MESSAGE( "GRAPHENE_REPLAY_BLOCKS is not set, skipping the recorded replay" );
+         return;
+      }
+      const std::string snapshot_dir = env( "GRAPHENE_REPLAY_SNAPSHOT" );
+      const std::string genesis_file = env( "GRAPHENE_REPLAY_GENESIS" );
+      BOOST_REQUIRE_MESSAGE( !snapshot_dir.empty() || !genesis_file.empty(),
+                             "GRAPHENE_REPLAY_SNAPSHOT or GRAPHENE_REPLAY_GENESIS is required" );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      copy_directory( blocks_dir, data_dir.path() / "database" / "block_num_to_block" );
+
+      database db;
+      const std::string skip = env( "GRAPHENE_REPLAY_SKIP" );
+      if( !skip.empty() )
+         db.set_replay_skip_flags( uint32_t( std::stoul( skip, nullptr, 0 ) ) );
+      const std::string threads = env( "GRAPHENE_REPLAY_THREADS" );
+      if( !threads.empty() )
+         db.set_signature_threads( uint32_t( std::stoul( threads ) ) );
+      const std::string lookahead = env( "GRAPHENE_REPLAY_LOOKAHEAD" );
+      if( !lookahead.empty() )
+         db.set_transaction_prefetch_depth( uint32_t( std::stoul( lookahead ) ) );
+      db.set_operation_statistics( true );
+
+      const auto allocations = graphene::utilities::allocation_stats::snapshot();
+      if( !snapshot_dir.empty() )
+      {
+         const auto info = fc::json::from_file( fc::path( snapshot_dir ) / "snapshot.json" ).as<state_snapshot_info>();
+         db.reindex_from_snapshot( data_dir.path(), fc::path( snapshot_dir ), info.state_hash );
+      }
+      else
+      {
+         std::string genesis_json;
+         fc::read_file_contents( fc::path( genesis_file ), genesis_json );
+         genesis_state_type genesis = parse_genesis_json( genesis_json );
+         genesis.initial_chain_id = fc::sha256::hash( genesis_json );
+         db.reindex( data_dir.path(), genesis );
+      }
+
+      const replay_statistics& stats = db.get_replay_statistics();
+      BOOST_CHECK( stats.blocks > 0 );
+      graphene::benchmarks::write_report( fc::json::to_string( fc::mutable_variant_object()
+            ( "name", "recorded_replay" )
+            ( "replay", stats )
+            ( "operation_statistics", db.get_operation_statistics() )
+            ( "allocated_bytes", db.allocated_bytes() )
+            ( "heap_allocations", ( graphene::utilities::allocation_stats::snapshot() - allocations ).by_phase() )
+            ( "peak_rss_kb", graphene::benchmarks::peak_rss_kb() )
+            ( "head_block_num", db.head_block_num() )
+            ( "state_hash", db.state_hash() ) ) );
+      db.close();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/protocol.hpp>
+#include <graphene/chain/protocol/fast_pack.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/smart_ref_impl.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "bench_report.hpp"
+
+using namespace graphene::chain;
+
+/** Cost of serializing one value, the times are nanoseconds per call */
+struct serialization_report
+{
+   std::string name;
+   uint64_t    mem_size     = 0;
+   uint64_t    wire_size    = 0;
+   uint64_t    json_size    = 0;
+   double      pack_ns      = 0;
+   double      pack_size_ns = 0;
+   double      unpack_ns    = 0;
+   double      to_variant_ns = 0;
+   double      json_ns      = 0;
+};
+
+FC_REFLECT( serialization_report,
+            (name)(mem_size)(wire_size)(json_size)(pack_ns)(pack_size_ns)(unpack_ns)(to_variant_ns)(json_ns) )
+
+namespace {
+
+#ifdef NDEBUG
+   const uint32_t iterations = 20000;
+#else
+   const uint32_t iterations = 1000;
+#endif
+
+   /// keeps the compiler from dropping the measured calls
+   volatile uint64_t sink = 0;
+
+   template<typename T>
+   serialization_report measure_serialization( const std::string& name, const T& value, uint32_t count = iterations )
+   {
+      serialization_report r;
+      r.name = name;
+      r.mem_size = sizeof( T );
+      auto per_call = [count]( fc::time_point start ) {
+         return double( ( fc::time_point::now() - start ).count() ) * 1000 / count;
+      };
+
+      std::vector<char> packed;
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         packed = fc::raw::pack( value );
+         sink += packed.size();
+      }
+      r.pack_ns = per_call( start );
+      r.wire_size = packed.size();
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < count; ++i )
+         sink += fc::raw::pack_size( value );
+      r.pack_size_ns = per_call( start );
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         T copy = fc::raw::unpack<T>( packed );
+         sink += sizeof( copy );
+      }
+      r.unpack_ns = per_call( start );
+
+      fc::variant var;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < count; ++i )
+         fc::to_variant( value, var );
+      r.to_variant_ns = per_call( start );
+
+      std::string json;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         json = fc::json::to_string( var );
+         sink += json.size();
+      }
+      r.json_ns = per_call( start );
+      r.json_size = json.size();
+      return r;
+   }
+
+   void report( const serialization_report& r )
+   {
+      graphene::benchmarks::write_report( fc::json::to_string( r ) );
+   }
+
+   /** measures every operation type, as the operation static_variant in which they travel */
+   struct operation_serialization_visitor
+   {
+      typedef void result_type;
+
+      const operation& op;
+
+      template<typename Type>
+      void operator()( const Type& )const
+      {
+         report( measure_serialization( fc::get_typename<Type>::name(), op ) );
+      }
+   };
+
+   const private_key_type& sample_key()
+   {
+      static const private_key_type key = private_key_type::regenerate( fc::sha256::hash( std::string( "serialization" ) ) );
+      return key;
+   }
+
+   signed_transaction sample_transaction( uint32_t operations )
+   {
+      signed_transaction trx;
+      trx.ref_block_num = 1234;
+      trx.ref_block_prefix = 0x12345678;
+      trx.expiration = fc::time_point_sec( 1500000000 );
+      for( uint32_t i = 0; i < operations; ++i )
+      {
+         transfer_operation op;
+         op.fee = asset( 20 );
+         op.from = account_id_type( 100 + i );
+         op.to = account_id_type( 200 + i );
+         op.amount = asset( 1000 + i, asset_id_type( i % 3 ) );
+         trx.operations.push_back( op );
+      }
+      trx.sign( sample_key(), chain_id_type() );
+      return trx;
+   }
+
+   account_object sample_account()
+   {
+      account_object acct;
+      acct.id = account_id_type( 12345 );
+      acct.name = "serialization-sample";
+      acct.owner = authority( 1, public_key_type( sample_key().get_public_key() ), 1 );
+      acct.active = authority( 1, account_id_type( 17 ), 1, public_key_type( sample_key().get_public_key() ), 1 );
+      acct.options.memo_key = sample_key().get_public_key();
+      for( uint32_t i = 0; i < 30; ++i )
+         acct.options.votes.insert( vote_id_type( vote_id_type::witness, i ) );
+      acct.options.num_witness = 30;
+      return acct;
+   }
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( operation_serialization_bench )
+{
+   try {
+      operation op;
+      for( int32_t i = 0; i < op.count(); ++i )
+      {
+         op.set_which( i );
+         op.visit( operation_serialization_visitor{ op } );
+      }
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( protocol_serialization_bench )
+{
+   try {
+      const signed_transaction small_trx = sample_transaction( 1 );
+      const signed_transaction large_trx = sample_transaction( 50 );
+      report( measure_serialization( "signed_transaction_1_op", small_trx ) );
+      report( measure_serialization( "signed_transaction_50_ops", large_trx ) );
+
+      signed_block block;
+      block.previous = block_id_type( fc::sha256::hash( std::string( "previous" ) ) );
+      block.timestamp = fc::time_point_sec( 1500000000 );
+      block.witness = witness_id_type( 5 );
+      for( uint32_t i = 0; i < 100; ++i )
+         block.transactions.push_back( processed_transaction( sample_transaction( 2 ) ) );
+      block.transaction_merkle_root = block.calculate_merkle_root();
+      block.sign( sample_key() );
+      report( measure_serialization( "signed_block_100_trx", block, iterations / 100 + 1 ) );
+      report( measure_serialization( "block_header", block_header( block ) ) );
+
+      // the fast_pack serializers of the same values, the other fields stay 0
+      auto measure_fast_pack = [&]( const std::string& name, const signed_block_header& header ) {
+         serialization_report r;
+         r.name = name;
+         r.mem_size = sizeof( header );
+         r.wire_size = fast_pack::packed_size( header );
+         auto start = fc::time_point::now();
+         for( uint32_t i = 0; i < iterations; ++i )
+            sink += fast_pack::pack_to_vector( header ).size();
+         r.pack_ns = double( ( fc::time_point::now() - start ).count() ) * 1000 / iterations;
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i < iterations; ++i )
+            sink += fast_pack::packed_size( header );
+         r.pack_size_ns = double( ( fc::time_point::now() - start ).count() ) * 1000 / iterations;
+         const vector<char> packed = fast_pack::pack_to_vector( header );
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i < iterations; ++i )
+            sink += fast_pack::unpack_from_vector<signed_block_header>( packed ).timestamp.sec_since_epoch();
+         r.unpack_ns = double( ( fc::time_point::now() - start ).count() ) * 1000 / iterations;
+         report( r );
+      };
+      report( measure_serialization( "signed_block_header", signed_block_header( block ) ) );
+      measure_fast_pack( "signed_block_header_fast_pack", block );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( object_serialization_bench )
+{
+   try {
+      report( measure_serialization( "account_object", sample_account() ) );
+
+      account_statistics_object stats;
+      stats.owner = account_id_type( 12345 );
+      stats.total_core_in_orders = 1000000;
+      report( measure_serialization( "account_statistics_object", stats ) );
+
+      account_balance_object balance;
+      balance.owner = account_id_type( 12345 );
+      balance.balance = 1000000;
+      report( measure_serialization( "account_balance_object", balance ) );
+
+      asset_object asset_obj;
+      asset_obj.symbol = "SERIAL";
+      asset_obj.options.description = std::string( 200, 'd' );
+      report( measure_serialization( "asset_object", asset_obj ) );
+
+      limit_order_object order;
+      order.seller = account_id_type( 12345 );
+      order.for_sale = 1000;
+      order.sell_price = asset( 1000 ) / asset( 1100, asset_id_type( 1 ) );
+      report( measure_serialization( "limit_order_object", order ) );
+
+      witness_object witness;
+      witness.witness_account = account_id_type( 12345 );
+      witness.signing_key = sample_key().get_public_key();
+      witness.url = "https://example.com";
+      report( measure_serialization( "witness_object", witness ) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/protocol/transaction.hpp>
+#include <graphene/chain/protocol/transfer.hpp>
+#include <graphene/chain/pts_address.hpp>
+
+#include <fc/crypto/digest.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_CASE( sign_state_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t rounds = 2000;
+#else
+      const uint32_t rounds = 200;
+#endif
+      const uint32_t keys_per_account = 10;
+
+      // account 1 is controlled by addresses of its keys in all five forms, account 2 by a plain multi-sig
+      authority address_authority, key_authority;
+      flat_set<public_key_type> sigs;
+      for( uint32_t i = 0; i < keys_per_account; ++i )
+      {
+         public_key_type a = fc::ecc::private_key::regenerate( fc::sha256::hash( "address" + fc::to_string(i) ) ).get_public_key();
+         public_key_type k = fc::ecc::private_key::regenerate( fc::sha256::hash( "key" + fc::to_string(i) ) ).get_public_key();
+         switch( i % 5 )
+         {
+            case 0: address_authority.address_auths[ address( pts_address( a, false, 56 ) ) ] = 1; break;
+            case 1: address_authority.address_auths[ address( pts_address( a, true, 56 ) ) ] = 1; break;
+            case 2: address_authority.address_auths[ address( pts_address( a, false, 0 ) ) ] = 1; break;
+            case 3: address_authority.address_auths[ address( pts_address( a, true, 0 ) ) ] = 1; break;
+            default: address_authority.address_auths[ address( a ) ] = 1; break;
+         }
+         key_authority.key_auths[k] = 1;
+         sigs.insert( a );
+         sigs.insert( k );
+      }
+      address_authority.weight_threshold = keys_per_account;
+      key_authority.weight_threshold = keys_per_account;
+
+      auto get_active = [&]( account_id_type id ) -> const authority* {
+         if( id == account_id_type(1) ) return &address_authority;
+         if( id == account_id_type(2) ) return &key_authority;
+         return nullptr;
+      };
+      auto get_owner = get_active;
+
+      vector<operation> ops;
+      transfer_operation op;
+      op.from = account_id_type(1);
+      op.to = account_id_type(2);
+      ops.push_back( op );
+      op.from = account_id_type(2);
+      op.to = account_id_type(1);
+      ops.push_back( op );
+
+      auto start_time = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         verify_authority( ops, sigs, get_active, get_owner );
+      auto elapsed = fc::time_point::now() - start_time;
+
+      ilog( "${n} verify_authority calls with ${a} address and ${k} key authorities: ${t} us/call",
+            ("n",rounds)("a",keys_per_account)("k",keys_per_account)
+            ("t",double(elapsed.count()) / rounds) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
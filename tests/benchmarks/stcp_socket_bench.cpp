@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using graphene::net::stcp_socket;
+
+BOOST_AUTO_TEST_CASE( stcp_socket_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t megabytes = 256;
+#else
+      const uint32_t megabytes = 16;
+#endif
+      // about the size of a full block, written and flushed the way message_oriented_connection does
+      const size_t message_size = 64 * 1024;
+      const uint32_t messages = uint64_t(megabytes) * 1024 * 1024 / message_size;
+
+      fc::tcp_server server;
+      server.listen( 0 );
+      stcp_socket receiver;
+      fc::future<void> accepted = fc::async( [&]() {
+         server.accept( receiver.get_socket() );
+         receiver.accept();
+      }, "stcp_socket_bench accept" );
+      stcp_socket sender;
+      sender.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+      accepted.wait();
+
+      std::vector<char> sent( message_size ), received( message_size );
+      for( size_t i = 0; i < sent.size(); ++i )
+         sent[i] = char( i * 7 );
+
+      auto start_time = fc::time_point::now();
+      fc::future<void> read_done = fc::async( [&]() {
+         for( uint32_t i = 0; i < messages; ++i )
+            receiver.read( received.data(), received.size() );
+      }, "stcp_socket_bench read" );
+      for( uint32_t i = 0; i < messages; ++i )
+      {
+         sender.write( sent.data(), sent.size() );
+         sender.flush();
+      }
+      read_done.wait();
+      auto elapsed = fc::time_point::now() - start_time;
+
+      BOOST_CHECK( received == sent );
+      ilog( "${mb} MiB through one stcp_socket connection in messages of ${s} bytes: ${r} MiB/s",
+            ("mb",megabytes)("s",message_size)
+            ("r",double(megabytes) * 1000000 / elapsed.count()) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
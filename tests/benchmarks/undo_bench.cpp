@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_CASE( undo_session_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t object_count = 100000;
+      const uint32_t sessions = 200000;
+#else
+      const uint32_t object_count = 10000;
+      const uint32_t sessions = 20000;
+#endif
+      const uint32_t modifications_per_session = 8;
+
+      database db;
+      vector<const account_balance_object*> balances;
+      balances.reserve( object_count );
+      for( uint32_t i = 0; i < object_count; ++i )
+         balances.push_back( &db.create<account_balance_object>( [&]( account_balance_object& b ) {
+            b.owner = account_id_type(i);
+         }));
+
+      // one session per pending transaction, as in database::_push_transaction
+      auto start_time = fc::time_point::now();
+      for( uint32_t s = 0; s < sessions; ++s )
+      {
+         auto session = db._undo_db.start_undo_session();
+         for( uint32_t m = 0; m < modifications_per_session; ++m )
+            db.modify( *balances[(s * modifications_per_session + m) % object_count], []( account_balance_object& b ) {
+               b.balance += 1;
+            });
+         db.create<account_balance_object>( [&]( account_balance_object& b ) {
+            b.owner = account_id_type(object_count + s);
+         });
+         session.undo();
+      }
+      auto elapsed = fc::time_point::now() - start_time;
+
+      for( const auto* b : balances )
+         BOOST_CHECK_EQUAL( b->balance.value, 0 );
+      ilog( "${s} undo sessions with ${m} modifications each in ${t} ms, ${r} sessions/sec",
+            ("s",sessions)("m",modifications_per_session)
+            ("t",elapsed.count() / 1000)
+            ("r",double(sessions) * 1000000 / std::max<int64_t>( elapsed.count(), 1 )) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
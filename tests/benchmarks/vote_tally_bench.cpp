@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( vote_tally_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t account_count = 50000;
+#else
+      const uint32_t account_count = 5000;
+#endif
+      const uint32_t accounts_per_trx = 100;
+      const uint32_t threads = 4;
+
+      vector<account_id_type> accounts;
+      accounts.reserve( account_count );
+      for( uint32_t i = 0; i < account_count; )
+      {
+         for( uint32_t n = 0; n < accounts_per_trx && i < account_count; ++n, ++i )
+            trx.operations.push_back( make_account( "voter" + fc::to_string(i) ) );
+         auto processed = db.push_transaction( trx, ~0 );
+         for( const auto& result : processed.operation_results )
+            accounts.push_back( result.get<object_id_type>() );
+         trx.operations.clear();
+         // also keeps the direct changes below from being undone with pending transactions
+         generate_block();
+      }
+
+      // every account votes for a few witnesses with some stake
+      const auto& witnesses = db.get_index_type<witness_index>().indices();
+      vector<vote_id_type> witness_votes;
+      for( const witness_object& w : witnesses )
+         witness_votes.push_back( w.vote_id );
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         db.modify( accounts[i](db), [&]( account_object& a ) {
+            for( uint32_t v = 0; v < 3; ++v )
+               a.options.votes.insert( witness_votes[(i + v) % witness_votes.size()] );
+            a.options.num_witness = a.options.votes.size();
+         });
+         db.adjust_balance( GRAPHENE_COMMITTEE_ACCOUNT, -asset( 1000 ) );
+         db.adjust_balance( accounts[i], asset( 1000 ) );
+      }
+
+      auto time_maintenance = [&]() {
+         generate_blocks( db.get_dynamic_global_properties().next_maintenance_time - db.get_global_properties().parameters.block_interval );
+         auto start_time = fc::time_point::now();
+         generate_block();
+         return fc::time_point::now() - start_time;
+      };
+
+      auto serial_time = time_maintenance();
+      const uint64_t serial_votes = witnesses.begin()->total_votes;
+      db.set_signature_threads( threads );
+      auto parallel_time = time_maintenance();
+      db.set_signature_threads( 0 );
+
+      BOOST_CHECK_EQUAL( witnesses.begin()->total_votes, serial_votes );
+      ilog( "maintenance block with ${n} voting accounts: ${s} ms on one thread, ${p} ms with ${t} tally threads",
+            ("n",account_count)("s",serial_time.count() / 1000)("p",parallel_time.count() / 1000)("t",threads) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
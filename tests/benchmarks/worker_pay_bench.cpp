@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+#include <graphene/chain/worker_object.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( worker_pay_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t worker_count = 10000;
+#else
+      const uint32_t worker_count = 1000;
+#endif
+      const uint32_t workers_per_trx = 100;
+
+      ACTOR( nathan );
+      upgrade_to_lifetime_member( nathan_id );
+      transfer( committee_account, nathan_id, asset( 100000000 ) );
+      generate_block();
+
+      // a mix of all worker kinds, so maintenance pays into vesting balances as well as burning pay
+      for( uint32_t i = 0; i < worker_count; )
+      {
+         for( uint32_t n = 0; n < workers_per_trx && i < worker_count; ++n, ++i )
+         {
+            worker_create_operation op;
+            op.owner = nathan_id;
+            op.daily_pay = 1000 + i;
+            if( i % 3 == 0 )
+               op.initializer = refund_worker_initializer();
+            else if( i % 3 == 1 )
+               op.initializer = burn_worker_initializer();
+            else
+               op.initializer = vesting_balance_worker_initializer( 1 );
+            op.work_begin_date = db.head_block_time() + 10;
+            op.work_end_date = op.work_begin_date + fc::days(365);
+            trx.operations.push_back( op );
+         }
+         db.push_transaction( trx, ~0 );
+         trx.operations.clear();
+         generate_block();
+      }
+
+      db.modify( nathan_id(db), [&]( account_object& a ) {
+         for( const worker_object& w : db.get_index_type<worker_index>().indices() )
+            a.options.votes.insert( w.vote_for );
+      });
+      {
+         asset_reserve_operation op;
+         op.payer = account_id_type();
+         op.amount_to_reserve = asset( GRAPHENE_MAX_SHARE_SUPPLY/2 );
+         trx.operations.push_back( op );
+         db.push_transaction( trx, ~0 );
+         trx.operations.clear();
+      }
+
+      auto time_maintenance = [&]() {
+         generate_blocks( db.get_dynamic_global_properties().next_maintenance_time - db.get_global_properties().parameters.block_interval );
+         auto start_time = fc::time_point::now();
+         generate_block();
+         return fc::time_point::now() - start_time;
+      };
+
+      // the first maintenance counts the votes, the second one pays everybody who has them
+      time_maintenance();
+      auto elapsed = time_maintenance();
+
+      share_type vested = 0;
+      for( const worker_object& w : db.get_index_type<worker_index>().indices() )
+         if( w.worker.which() == worker_type::tag<vesting_balance_worker_type>::value )
+            vested += w.worker.get<vesting_balance_worker_type>().balance(db).balance.amount;
+      BOOST_CHECK( vested > 0 );
+      ilog( "maintenance block paying ${n} workers: ${t} ms", ("n",worker_count)("t",elapsed.count() / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -58,6 +58,11 @@ using std::cout;
 using std::cerr;
 
 database_fixture::database_fixture()
+   : database_fixture( boost::program_options::variables_map() )
+{
+}
+
+database_fixture::database_fixture( const boost::program_options::variables_map& plugin_options )
    : app(), db( *app.chain_database() )
 {
    try {
@@ -75,7 +80,9 @@ database_fixture::database_fixture()
    auto mhplugin = app.register_plugin<graphene::market_history::market_history_plugin>();
    init_account_pub_key = init_account_priv_key.get_public_key();
 
-   boost::program_options::variables_map options;
+   boost::program_options::variables_map options = plugin_options;
+   // a size rolled up from the smallest one, as with the default sizes of a node
+   options.emplace( "bucket-size", boost::program_options::variable_value( std::string( "[15,60]" ), false ) );
 
    genesis_state.initial_timestamp = time_point_sec( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
 
@@ -151,7 +158,7 @@ void database_fixture::verify_asset_supplies( const database& db )
    const asset_dynamic_data_object& core_asset_data = db.get_core_asset().dynamic_asset_data_id(db);
    BOOST_CHECK(core_asset_data.fee_pool == 0);
 
-   const simple_index<account_statistics_object>& statistics_index = db.get_index_type<simple_index<account_statistics_object>>();
+   const account_statistics_index& statistics_index = db.get_index_type<account_statistics_index>();
    const auto& balance_index = db.get_index_type<account_balance_index>().indices();
    const auto& settle_index = db.get_index_type<force_settlement_index>().indices();
    map<asset_id_type,share_type> total_balances;
@@ -347,8 +354,8 @@ account_create_operation database_fixture::make_account(
    create_account.name = name;
    create_account.owner = authority(123, key, 123);
    create_account.active = authority(321, key, 321);
-   create_account.options.memo_key = key;
-   create_account.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+   create_account.options->memo_key = key;
+   create_account.options->voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
 
    auto& active_committee_members = db.get_global_properties().active_committee_members;
    if( active_committee_members.size() > 0 )
@@ -359,9 +366,9 @@ account_create_operation database_fixture::make_account(
       votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
       votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
       votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
-      create_account.options.votes = flat_set<vote_id_type>(votes.begin(), votes.end());
+      create_account.options->votes = flat_set<vote_id_type>(votes.begin(), votes.end());
    }
-   create_account.options.num_committee = create_account.options.votes.size();
+   create_account.options->num_committee = create_account.options->votes.size();
 
    create_account.fee = db.current_fee_schedule().calculate_fee( create_account );
    return create_account;
@@ -386,8 +393,8 @@ account_create_operation database_fixture::make_account(
       create_account.name = name;
       create_account.owner = authority(123, key, 123);
       create_account.active = authority(321, key, 321);
-      create_account.options.memo_key = key;
-      create_account.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+      create_account.options->memo_key = key;
+      create_account.options->voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
 
       const vector<committee_member_id_type>& active_committee_members = db.get_global_properties().active_committee_members;
       if( active_committee_members.size() > 0 )
@@ -398,9 +405,9 @@ account_create_operation database_fixture::make_account(
          votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
          votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
          votes.insert(active_committee_members[rand() % active_committee_members.size()](db).vote_id);
-         create_account.options.votes = flat_set<vote_id_type>(votes.begin(), votes.end());
+         create_account.options->votes = flat_set<vote_id_type>(votes.begin(), votes.end());
       }
-      create_account.options.num_committee = create_account.options.votes.size();
+      create_account.options->num_committee = create_account.options->votes.size();
 
       create_account.fee = db.current_fee_schedule().calculate_fee( create_account );
       return create_account;
@@ -435,14 +442,14 @@ const asset_object& database_fixture::create_bitasset(
    creator.issuer = issuer;
    creator.fee = asset();
    creator.symbol = name;
-   creator.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+   creator.common_options->max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
    creator.precision = 2;
-   creator.common_options.market_fee_percent = market_fee_percent;
+   creator.common_options->market_fee_percent = market_fee_percent;
    if( issuer == GRAPHENE_WITNESS_ACCOUNT )
       flags |= witness_fed_asset;
-   creator.common_options.issuer_permissions = flags;
-   creator.common_options.flags = flags & ~global_settle;
-   creator.common_options.core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
+   creator.common_options->issuer_permissions = flags;
+   creator.common_options->flags = flags & ~global_settle;
+   creator.common_options->core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
    creator.bitasset_opts = bitasset_options();
    trx.operations.push_back(std::move(creator));
    trx.validate();
@@ -462,14 +469,14 @@ const asset_object& database_fixture::create_prediction_market(
    creator.issuer = issuer;
    creator.fee = asset();
    creator.symbol = name;
-   creator.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+   creator.common_options->max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
    creator.precision = GRAPHENE_BLOCKCHAIN_PRECISION_DIGITS;
-   creator.common_options.market_fee_percent = market_fee_percent;
-   creator.common_options.issuer_permissions = flags | global_settle;
-   creator.common_options.flags = flags & ~global_settle;
+   creator.common_options->market_fee_percent = market_fee_percent;
+   creator.common_options->issuer_permissions = flags | global_settle;
+   creator.common_options->flags = flags & ~global_settle;
    if( issuer == GRAPHENE_WITNESS_ACCOUNT )
-      creator.common_options.flags |= witness_fed_asset;
-   creator.common_options.core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
+      creator.common_options->flags |= witness_fed_asset;
+   creator.common_options->core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
    creator.bitasset_opts = bitasset_options();
    creator.is_prediction_market = true;
    trx.operations.push_back(std::move(creator));
@@ -485,12 +492,12 @@ const asset_object& database_fixture::create_user_issued_asset( const string& na
    creator.issuer = account_id_type();
    creator.fee = asset();
    creator.symbol = name;
-   creator.common_options.max_supply = 0;
+   creator.common_options->max_supply = 0;
    creator.precision = 2;
-   creator.common_options.core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
-   creator.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
-   creator.common_options.flags = charge_market_fee;
-   creator.common_options.issuer_permissions = charge_market_fee;
+   creator.common_options->core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
+   creator.common_options->max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+   creator.common_options->flags = charge_market_fee;
+   creator.common_options->issuer_permissions = charge_market_fee;
    trx.operations.push_back(std::move(creator));
    trx.validate();
    processed_transaction ptx = db.push_transaction(trx, ~0);
@@ -504,12 +511,12 @@ const asset_object& database_fixture::create_user_issued_asset( const string& na
    creator.issuer = issuer.id;
    creator.fee = asset();
    creator.symbol = name;
-   creator.common_options.max_supply = 0;
+   creator.common_options->max_supply = 0;
    creator.precision = 2;
-   creator.common_options.core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
-   creator.common_options.max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
-   creator.common_options.flags = flags;
-   creator.common_options.issuer_permissions = flags;
+   creator.common_options->core_exchange_rate = price({asset(1,asset_id_type(1)),asset(1)});
+   creator.common_options->max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+   creator.common_options->flags = flags;
+   creator.common_options->issuer_permissions = flags;
    trx.operations.clear();
    trx.operations.push_back(std::move(creator));
    set_expiration( db, trx );
@@ -618,8 +625,8 @@ const account_object& database_fixture::create_account(
       account_create_op.name = name;
       account_create_op.owner = authority(1234, public_key_type(key.get_public_key()), 1234);
       account_create_op.active = authority(5678, public_key_type(key.get_public_key()), 5678);
-      account_create_op.options.memo_key = key.get_public_key();
-      account_create_op.options.voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+      account_create_op.options->memo_key = key.get_public_key();
+      account_create_op.options->voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
       trx.operations.push_back( account_create_op );
 
       trx.validate();
@@ -162,6 +162,8 @@ struct database_fixture {
    uint32_t anon_acct_count;
 
    database_fixture();
+   /** with @ref plugin_options added to the options the built-in plugins are initialized with */
+   explicit database_fixture( const boost::program_options::variables_map& plugin_options );
    ~database_fixture();
 
    static fc::ecc::private_key generate_private_key(string seed);
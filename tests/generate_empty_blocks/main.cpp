@@ -33,6 +33,9 @@
 #include <fc/smart_ref_impl.hpp>
 
 #include <graphene/app/api.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/balance_object.hpp>
 #include <graphene/chain/protocol/protocol.hpp>
 #include <graphene/egenesis/egenesis.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -55,6 +58,146 @@ namespace graphene { namespace app { namespace detail {
 genesis_state_type create_example_genesis();
 } } } // graphene::app::detail
 
+namespace {
+
+/**
+ * The checks skipped while fabricating a chain.  Transactions are not signed, so the fabricated chain only replays
+ * with skip flags that include these, as the default replay flags do.
+ */
+const uint32_t fabricate_skip = database::skip_transaction_signatures |
+                                database::skip_authority_check |
+                                database::skip_transaction_dupe_check |
+                                database::skip_tapos_check |
+                                database::skip_fork_db |
+                                database::skip_undo_history_check |
+                                database::skip_witness_schedule_check;
+
+/**
+ * Fills blocks with a mix of transfers, limit orders and account registrations, all of them paid by nathan, who holds
+ * the whole stake of the example genesis.
+ */
+class chain_fabricator
+{
+   public:
+      struct mix
+      {
+         uint32_t transfers = 0;
+         uint32_t orders    = 0;
+         uint32_t accounts  = 0;
+      };
+
+      chain_fabricator( database& db, const fc::ecc::private_key& key, const mix& per_block )
+         : _db( db ), _key( key.get_public_key() ), _mix( per_block ) {}
+
+      /** claims nathan's genesis balance, makes him a lifetime member and gives him a user issued asset to trade */
+      void setup()
+      {
+         const auto& accounts_by_name = _db.get_index_type<account_index>().indices().get<by_name>();
+         auto nathan = accounts_by_name.find( "nathan" );
+         FC_ASSERT( nathan != accounts_by_name.end(), "Fabricating blocks needs the nathan account of the example genesis" );
+         _nathan = nathan->id;
+
+         const auto& balances = _db.get_index_type<balance_index>().indices().get<by_owner>();
+         vector<balance_object> owned( balances.lower_bound( boost::make_tuple( address( _key ) ) ),
+                                       balances.upper_bound( boost::make_tuple( address( _key ) ) ) );
+         for( const balance_object& balance : owned )
+         {
+            balance_claim_operation claim;
+            claim.deposit_to_account = _nathan;
+            claim.balance_to_claim = balance.id;
+            claim.balance_owner_key = _key;
+            claim.total_claimed = balance.balance;
+            push( claim );
+         }
+
+         account_upgrade_operation upgrade;
+         upgrade.account_to_upgrade = _nathan;
+         upgrade.upgrade_to_lifetime_member = true;
+         push( upgrade );
+
+         asset_create_operation create;
+         create.issuer = _nathan;
+         create.symbol = "FABRICATED";
+         create.precision = 5;
+         create.common_options->max_supply = GRAPHENE_MAX_SHARE_SUPPLY;
+         const asset_id_type next_asset = _db.get_index_type<asset_index>().get_next_id();
+         create.common_options->core_exchange_rate = price( asset( 1, next_asset ), asset( 1 ) );
+         create.common_options->flags = 0;
+         create.common_options->issuer_permissions = 0;
+         _asset = push( create ).operation_results[0].get<object_id_type>();
+
+         asset_issue_operation issue;
+         issue.issuer = _nathan;
+         issue.asset_to_issue = asset( GRAPHENE_MAX_SHARE_SUPPLY, _asset );
+         issue.issue_to_account = _nathan;
+         push( issue );
+
+         // transfers need somebody to go to before any account was registered
+         create_account();
+      }
+
+      /** pushes the transactions of one block, generate_block() then puts them into it */
+      void fill_block()
+      {
+         for( uint32_t i = 0; i < _mix.accounts; ++i )
+            create_account();
+         for( uint32_t i = 0; i < _mix.transfers; ++i )
+         {
+            transfer_operation transfer;
+            transfer.from = _nathan;
+            transfer.to = _accounts[ _counter % _accounts.size() ];
+            transfer.amount = asset( 1 + _counter );
+            push( transfer );
+         }
+         // the two sides of the book alternate at the same price, so every order fills the one before it
+         for( uint32_t i = 0; i < _mix.orders; ++i )
+         {
+            limit_order_create_operation order;
+            order.seller = _nathan;
+            const share_type amount = 1000 + _counter;
+            order.amount_to_sell = _counter % 2 ? asset( amount ) : asset( amount, _asset );
+            order.min_to_receive = _counter % 2 ? asset( amount, _asset ) : asset( amount );
+            order.expiration = fc::time_point_sec::maximum();
+            push( order );
+         }
+      }
+
+   private:
+      void create_account()
+      {
+         account_create_operation create;
+         create.registrar = _nathan;
+         create.referrer = _nathan;
+         create.name = "fabricated-" + fc::to_string( _accounts.size() );
+         create.owner = authority( 1, _key, 1 );
+         create.active = authority( 1, _key, 1 );
+         create.options->memo_key = _key;
+         create.options->voting_account = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         _accounts.push_back( push( create ).operation_results[0].get<object_id_type>() );
+      }
+
+      /** every operation gets a transaction of its own, the counter in the amounts keeps them distinct */
+      processed_transaction push( operation op )
+      {
+         ++_counter;
+         signed_transaction trx;
+         _db.current_fee_schedule().set_fee( op );
+         trx.operations.push_back( std::move( op ) );
+         trx.set_expiration( _db.head_block_time() + fc::hours( 1 ) );
+         return _db.push_transaction( trx, fabricate_skip );
+      }
+
+      database&                 _db;
+      public_key_type           _key;
+      mix                       _mix;
+      account_id_type           _nathan;
+      asset_id_type             _asset;
+      vector<account_id_type>   _accounts;
+      uint64_t                  _counter = 0;
+};
+
+} // anonymous namespace
+
 int main( int argc, char** argv )
 {
    try
@@ -67,6 +210,11 @@ int main( int argc, char** argv )
             ("genesis-time,t", bpo::value<uint32_t>()->default_value(0), "Timestamp for genesis state (0=use value from file/example)")
             ("num-blocks,n", bpo::value<uint32_t>()->default_value(1000000), "Number of blocks to generate")
             ("miss-rate,r", bpo::value<uint32_t>()->default_value(3), "Percentage of blocks to miss")
+            ("fabricate,f", "Generate the blocks as fast as possible, skipping the checks a replay skips, writing the "
+                            "block log behind and laying out data-dir as a node's, ready for --replay-blockchain")
+            ("transfers", bpo::value<uint32_t>()->default_value(0), "Transfers per block when fabricating")
+            ("orders", bpo::value<uint32_t>()->default_value(0), "Limit orders per block when fabricating")
+            ("accounts", bpo::value<uint32_t>()->default_value(0), "Account registrations per block when fabricating")
             ("verbose,v", "Enter verbose mode")
             ;
 
@@ -122,16 +270,38 @@ int main( int argc, char** argv )
       fc::ecc::private_key init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
       fc::ecc::private_key nathan_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("nathan")));
 
+      const bool fabricate = (options.count("fabricate") != 0);
+      chain_fabricator::mix mix;
+      mix.transfers = options["transfers"].as<uint32_t>();
+      mix.orders = options["orders"].as<uint32_t>();
+      mix.accounts = options["accounts"].as<uint32_t>();
+
       database db;
       fc::path db_path = data_dir / "db";
+      uint32_t skip = database::skip_nothing;
+      if( fabricate )
+      {
+         // the layout witness_node expects, replayed with --genesis-json pointing at the saved genesis
+         db_path = data_dir / "blockchain";
+         fc::create_directories( data_dir );
+         fc::json::save_to_file( genesis, data_dir / "genesis.json" );
+         db.set_block_log_write_behind( 1000 );
+         skip = fabricate_skip;
+      }
       db.open(db_path, [&]() { return genesis; } );
 
+      chain_fabricator fabricator( db, nathan_priv_key, mix );
+      if( fabricate )
+         fabricator.setup();
+
       uint32_t slot = 1;
       uint32_t missed = 0;
 
       for( uint32_t i = 1; i < num_blocks; ++i )
       {
-         signed_block b = db.generate_block(db.get_slot_time(slot), db.get_scheduled_witness(slot), nathan_priv_key, database::skip_nothing);
+         if( fabricate && i > 1 )
+            fabricator.fill_block();
+         signed_block b = db.generate_block(db.get_slot_time(slot), db.get_scheduled_witness(slot), nathan_priv_key, skip);
          FC_ASSERT( db.head_block_id() == b.id() );
          fc::sha256 h = b.digest();
          uint64_t rand = h._hash[0];
@@ -165,6 +335,9 @@ int main( int argc, char** argv )
       }
       std::cerr << "\n";
       db.close();
+      if( fabricate )
+         std::cerr << "Replay with: witness_node --data-dir " << data_dir.preferred_string() << " --genesis-json "
+                   << (data_dir / "genesis.json").preferred_string() << " --replay-blockchain\n";
    }
    catch ( const fc::exception& e )
    {
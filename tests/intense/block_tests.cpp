@@ -156,19 +156,19 @@ BOOST_FIXTURE_TEST_CASE( update_account_keys, database_fixture )
                   for( int owner_index=0; owner_index<num_owner_keys; owner_index++ )
                   {
                      int i = *(it++);
-                     create_op.owner.key_auths[ key_ids[ i ] ] = 1;
+                     create_op.owner->key_auths[ key_ids[ i ] ] = 1;
                      owner_privkey.push_back( &numbered_private_keys[i] );
                      owner_keyid.push_back( &key_ids[ i ] );
                   }
                   // size() < num_owner_keys is possible when some keys are duplicates
-                  create_op.owner.weight_threshold = create_op.owner.key_auths.size();
+                  create_op.owner->weight_threshold = create_op.owner->key_auths.size();
 
                   for( int active_index=0; active_index<num_active_keys; active_index++ )
-                     create_op.active.key_auths[ key_ids[ *(it++) ] ] = 1;
+                     create_op.active->key_auths[ key_ids[ *(it++) ] ] = 1;
                   // size() < num_active_keys is possible when some keys are duplicates
-                  create_op.active.weight_threshold = create_op.active.key_auths.size();
+                  create_op.active->weight_threshold = create_op.active->key_auths.size();
 
-                  create_op.options.memo_key = key_ids[ *(it++) ] ;
+                  create_op.options->memo_key = key_ids[ *(it++) ] ;
                   create_op.registrar = sam_account_object.id;
                   trx.operations.push_back( create_op );
                   // trx.sign( sam_key );
@@ -193,7 +193,7 @@ BOOST_FIXTURE_TEST_CASE( update_account_keys, database_fixture )
                      update_op.account = alice_account_id;
                      update_op.owner = authority();
                      update_op.active = authority();
-                     update_op.new_options = create_op.options;
+                     update_op.new_options = *create_op.options;
 
                      for( int owner_index=0; owner_index<num_owner_keys; owner_index++ )
                         update_op.owner->key_auths[ key_ids[ *(it++) ] ] = 1;
@@ -207,10 +207,10 @@ BOOST_FIXTURE_TEST_CASE( update_account_keys, database_fixture )
                      update_op.new_options->memo_key = key_ids[ *(it++) ] ;
 
                      trx.operations.push_back( update_op );
-                     for( int i=0; i<int(create_op.owner.weight_threshold); i++)
+                     for( int i=0; i<int(create_op.owner->weight_threshold); i++)
                      {
                         sign( trx, *owner_privkey[i] );
-                        if( i < int(create_op.owner.weight_threshold-1) )
+                        if( i < int(create_op.owner->weight_threshold-1) )
                         {
                            GRAPHENE_REQUIRE_THROW(db.push_transaction(trx), fc::exception);
                         }
@@ -33,23 +33,104 @@
 #include <graphene/db/simple_index.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <atomic>
+#include <memory>
+
+#include "../benchmarks/bench_report.hpp"
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
 
 //BOOST_FIXTURE_TEST_SUITE( performance_tests, database_fixture )
 
+namespace {
+
+   struct signed_digest
+   {
+      fc::sha256            digest;
+      signature_type        sig;
+   };
+
+   vector<signed_digest> make_signatures( uint32_t count )
+   {
+      fc::ecc::private_key key = fc::ecc::private_key::generate();
+      vector<signed_digest> result( count );
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         result[i].digest = fc::sha256::hash( "hello" + fc::to_string(i) );
+         result[i].sig = key.sign_compact( result[i].digest );
+      }
+      return result;
+   }
+
+   /// recovers every signature of batch spread over the threads, returns the recoveries per second
+   double recovery_rate( const vector< std::unique_ptr<fc::thread> >& threads, const vector<signed_digest>& batch,
+                         const std::function<void(const signed_digest&)>& recover )
+   {
+      std::atomic<size_t> next(0);
+      auto start = fc::time_point::now();
+      vector< fc::future<void> > results;
+      for( const auto& t : threads )
+         results.push_back( t->async( [&]() {
+            for( size_t n = next++; n < batch.size(); n = next++ )
+               recover( batch[n] );
+         } ) );
+      for( auto& r : results )
+         r.wait();
+      auto elapsed = fc::time_point::now() - start;
+      return batch.size() * 1000000.0 / std::max<int64_t>( elapsed.count(), 1 );
+   }
+
+}
+
 BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
 {
-   fc::ecc::private_key nathan_key = fc::ecc::private_key::generate();
-   auto digest = fc::sha256::hash("hello");
-   auto sig = nathan_key.sign_compact( digest );
-   auto start = fc::time_point::now();
-   for( uint32_t i = 0; i < 100000; ++i )
-      auto pub = fc::ecc::public_key( sig, digest );
-   auto end = fc::time_point::now();
-   auto elapsed = end-start;
-   wdump( ((100000.0*1000000.0) / elapsed.count()) );
+   const uint32_t max_threads = 8;
+   const vector<uint32_t> batch_sizes = { 1000, 10000 };
+
+   vector< std::unique_ptr<fc::thread> > all_threads;
+   for( uint32_t i = 0; i < max_threads; ++i )
+      all_threads.emplace_back( new fc::thread( "sigcheck_benchmark" ) );
+
+   for( uint32_t batch_size : batch_sizes )
+   {
+      const vector<signed_digest> batch = make_signatures( batch_size );
+      for( uint32_t thread_count = 1; thread_count <= max_threads; thread_count *= 2 )
+      {
+         vector< std::unique_ptr<fc::thread> > threads;
+         for( uint32_t i = 0; i < thread_count; ++i )
+            threads.emplace_back( std::move( all_threads[i] ) );
+
+         const double uncached = recovery_rate( threads, batch, []( const signed_digest& s ) {
+            fc::ecc::public_key( s.sig, s.digest );
+         } );
+
+         // the first pass only misses the cache, the second one only hits it
+         signature_key_cache cache( batch_size );
+         auto through_cache = [&cache]( const signed_digest& s ) { cache.recover( s.sig, s.digest ); };
+         const double cold = recovery_rate( threads, batch, through_cache );
+         const double warm = recovery_rate( threads, batch, through_cache );
+         BOOST_CHECK_EQUAL( cache.misses(), batch_size );
+         BOOST_CHECK_EQUAL( cache.hits(), batch_size );
+
+         graphene::benchmarks::write_report( fc::json::to_string( fc::mutable_variant_object()
+               ( "name", "sigcheck" )
+               ( "threads", thread_count )
+               ( "batch", batch_size )
+               ( "recoveries_per_second", uint64_t( uncached ) )
+               ( "cold_cache_per_second", uint64_t( cold ) )
+               ( "warm_cache_per_second", uint64_t( warm ) )
+               ( "cache_hits", cache.hits() )
+               ( "cache_misses", cache.misses() ) ) );
+
+         for( uint32_t i = 0; i < thread_count; ++i )
+            all_threads[i] = std::move( threads[i] );
+      }
+   }
 }
 /*
 BOOST_AUTO_TEST_CASE( transfer_benchmark )
@@ -953,7 +953,7 @@ BOOST_FIXTURE_TEST_CASE( max_authority_membership, database_fixture )
              anon_create_op.owner = owner_auth;
              anon_create_op.active = active_auth;
              anon_create_op.registrar = sam_account_object.id;
-             anon_create_op.options.memo_key = sam_account_object.options.memo_key;
+             anon_create_op.options->memo_key = sam_account_object.options.memo_key;
              anon_create_op.name = generate_anon_acct_name();
 
              tx.operations.push_back( anon_create_op );
@@ -1313,4 +1313,124 @@ BOOST_FIXTURE_TEST_CASE( nonminimal_sig_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( is_authorized_matches_verify_authority, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(roco)(styx)(thud) );
+
+      auto set_auth = [&]( account_id_type aid, const authority& auth )
+      {
+         signed_transaction tx;
+         account_update_operation op;
+         op.account = aid;
+         op.active = auth;
+         op.owner = auth;
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         PUSH_TX( db, tx, database::skip_transaction_signatures | database::skip_authority_check );
+      };
+      auto get_active = [&]( account_id_type aid ) -> const authority* { return &(aid(db).active); };
+      auto get_owner  = [&]( account_id_type aid ) -> const authority* { return &(aid(db).owner);  };
+
+      set_auth( roco_id, authority( 2, styx_id, 1, thud_id, 2 ) );
+      set_auth( styx_id, authority( 2, alice_id, 1, bob_id, 1 ) );
+      set_auth( thud_id, authority( 1, alice_id, 1 ) );
+
+      transfer_operation op;
+      op.from = roco_id;
+      op.to = bob_id;
+      op.amount = asset(1);
+      vector<operation> ops{ op };
+
+      auto check = [&]( const flat_set<public_key_type>& keys, const flat_set<account_id_type>& approvals ) -> bool
+      {
+         bool verified = true;
+         try {
+            verify_authority( ops, keys, get_active, get_owner, GRAPHENE_MAX_SIG_CHECK_DEPTH, false, approvals );
+         } catch( const fc::exception& ) {
+            verified = false;
+         }
+         BOOST_CHECK_EQUAL( verified, is_authorized( ops, keys, get_active, get_owner, GRAPHENE_MAX_SIG_CHECK_DEPTH,
+                                                     false, approvals ) );
+         return verified;
+      };
+
+      BOOST_CHECK( !check( {}, {} ) );
+      BOOST_CHECK( !check( { bob_public_key }, {} ) );
+      BOOST_CHECK( check( { alice_public_key }, {} ) );
+      BOOST_CHECK( check( { alice_public_key, bob_public_key }, {} ) );
+      // roco's own key was replaced above, signing with it is an irrelevant signature
+      BOOST_CHECK( !check( { alice_public_key, roco_public_key }, {} ) );
+      BOOST_CHECK( check( {}, { thud_id } ) );
+      BOOST_CHECK( !check( {}, { styx_id } ) );
+      BOOST_CHECK( check( {}, { roco_id } ) );
+
+      // the committee may only be the proposer
+      transfer_operation committee_op;
+      committee_op.from = GRAPHENE_COMMITTEE_ACCOUNT;
+      committee_op.to = bob_id;
+      committee_op.amount = asset(1);
+      ops = { committee_op };
+      BOOST_CHECK( !check( {}, { GRAPHENE_COMMITTEE_ACCOUNT } ) );
+   }
+   catch(fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( repeat_signers_follow_authority_changes, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( committee_account, alice_id, asset( 10000 ) );
+
+      uint32_t amount = 1;
+      auto transfer_signed_by = [&]( const fc::ecc::private_key& key )
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( amount++ );
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, key );
+         PUSH_TX( db, tx, database::skip_nothing );
+      };
+
+      // the second transfer signed by the same key reuses the first check
+      transfer_signed_by( alice_private_key );
+      transfer_signed_by( alice_private_key );
+      GRAPHENE_REQUIRE_THROW( transfer_signed_by( bob_private_key ), fc::exception );
+
+      {
+         signed_transaction tx;
+         account_update_operation op;
+         op.account = alice_id;
+         op.active = authority( 1, bob_public_key, 1 );
+         op.owner = op.active;
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         PUSH_TX( db, tx, database::skip_transaction_signatures | database::skip_authority_check );
+      }
+
+      // once alice's authorities change, her old key may no longer sign
+      GRAPHENE_REQUIRE_THROW( transfer_signed_by( alice_private_key ), fc::exception );
+      transfer_signed_by( bob_private_key );
+
+      generate_block();
+      GRAPHENE_REQUIRE_THROW( transfer_signed_by( alice_private_key ), fc::exception );
+      transfer_signed_by( bob_private_key );
+   }
+   catch(fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -29,10 +29,21 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/observer_list.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/signature_key_cache.hpp>
 
 #include <graphene/db/simple_index.hpp>
 
+#include <graphene/app/api_call_log.hpp>
+
+#include <graphene/market_history/market_history_plugin.hpp>
+
+#include <graphene/utilities/allocation_stats.hpp>
+#include <graphene/utilities/executor.hpp>
+#include <graphene/utilities/metrics.hpp>
+
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
 #include "../common/database_fixture.hpp"
@@ -178,6 +189,38 @@ BOOST_AUTO_TEST_CASE( price_test )
     BOOST_CHECK(dummy == dummy2);
 }
 
+BOOST_AUTO_TEST_CASE( price_key_order )
+{
+    const int64_t big = GRAPHENE_MAX_SHARE_SUPPLY;
+    vector<price> prices = {
+       price( asset(1), asset(2, asset_id_type(1)) ),
+       price( asset(2), asset(4, asset_id_type(1)) ),
+       price( asset(2), asset(2, asset_id_type(1)) ),
+       // these differ by less than the precision of the ratio and need the exact comparison
+       price( asset(big), asset(big - 1, asset_id_type(1)) ),
+       price( asset(big - 1), asset(big - 2, asset_id_type(1)) ),
+       price( asset(1), asset(big, asset_id_type(1)) ),
+       price::max( asset_id_type(0), asset_id_type(1) ),
+       price::min( asset_id_type(0), asset_id_type(1) ),
+       price::max( asset_id_type(1), asset_id_type(0) ),
+       price::min( asset_id_type(1), asset_id_type(0) ),
+       price( asset(3, asset_id_type(2)), asset(7, asset_id_type(1)) )
+    };
+    for( const price& a : prices )
+       for( const price& b : prices )
+       {
+          const price_key ka( a ), kb( b );
+          BOOST_CHECK_EQUAL( ka < kb, a < b );
+          BOOST_CHECK_EQUAL( ka < b, a < b );
+          BOOST_CHECK_EQUAL( a < kb, a < b );
+          BOOST_CHECK_EQUAL( price_key_greater()( ka, kb ), a > b );
+       }
+
+    price_key key( prices[0] );
+    BOOST_CHECK( key.matches( prices[0] ) );
+    BOOST_CHECK( !key.matches( prices[1] ) );
+}
+
 BOOST_AUTO_TEST_CASE( memo_test )
 { try {
    memo_data m;
@@ -408,6 +451,367 @@ BOOST_AUTO_TEST_CASE( merkle_root )
 
    block.transactions.push_back( tx[9] );
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
+
+   // the hashes of a step are independent, so any order gives the same root
+   auto backwards = []( size_t count, const std::function<void(size_t)>& task ) {
+      for( size_t n = count; n > 0; --n )
+         task( n - 1 );
+   };
+   BOOST_CHECK( block.calculate_merkle_root( backwards ) == c(dO) );
+}
+
+
+BOOST_AUTO_TEST_CASE( signature_key_cache )
+{
+   const chain_id_type& chain_id = db.get_chain_id();
+   auto alice_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "alice" ) ) );
+   auto bob_key   = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bob" ) ) );
+
+   signed_transaction trx;
+   transfer_operation op;
+   op.amount = asset( 1 );
+   trx.operations.push_back( op );
+   trx.sign( alice_key, chain_id );
+
+   const auto& keys = trx.get_signature_keys( chain_id );
+   BOOST_REQUIRE_EQUAL( keys.size(), 1 );
+   BOOST_CHECK( *keys.begin() == public_key_type( alice_key.get_public_key() ) );
+
+   // copies, e.g. into processed_transaction, keep the recovered keys
+   processed_transaction ptrx( trx );
+   BOOST_CHECK( ptrx.get_signature_keys( chain_id ) == trx.get_signature_keys( chain_id ) );
+
+   // changing the signed content invalidates the cached keys
+   trx.operations[0].get<transfer_operation>().amount = asset( 2 );
+   BOOST_CHECK( *trx.get_signature_keys( chain_id ).begin() != public_key_type( alice_key.get_public_key() ) );
+
+   trx.signatures.clear();
+   trx.sign( alice_key, chain_id );
+   trx.sign( bob_key, chain_id );
+   BOOST_CHECK_EQUAL( trx.get_signature_keys( chain_id ).size(), 2 );
+
+   // a duplicate signature is reported every time, it is never cached
+   trx.signatures.push_back( trx.signatures.back() );
+   GRAPHENE_REQUIRE_THROW( trx.get_signature_keys( chain_id ), tx_duplicate_sig );
+   GRAPHENE_REQUIRE_THROW( trx.get_signature_keys( chain_id ), tx_duplicate_sig );
+}
+
+
+BOOST_AUTO_TEST_CASE( signature_key_cache_lru )
+{
+   signature_key_cache cache( 2 );
+   vector<fc::ecc::private_key> keys;
+   vector<signature_type> sigs;
+   const digest_type d = digest_type::hash( string( "message" ) );
+   for( int i = 0; i < 3; ++i )
+   {
+      keys.push_back( fc::ecc::private_key::regenerate( fc::sha256::hash( "key" + fc::to_string( i ) ) ) );
+      sigs.push_back( keys.back().sign_compact( d ) );
+   }
+
+   BOOST_CHECK( cache.recover( sigs[0], d ) == public_key_type( keys[0].get_public_key() ) );
+   BOOST_CHECK( cache.recover( sigs[1], d ) == public_key_type( keys[1].get_public_key() ) );
+   BOOST_CHECK( cache.recover( sigs[0], d ) == public_key_type( keys[0].get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.hits(), 1 );
+   BOOST_CHECK_EQUAL( cache.misses(), 2 );
+
+   // sigs[1] is the least recently used entry and makes room for sigs[2]
+   cache.recover( sigs[2], d );
+   BOOST_CHECK_EQUAL( cache.size(), 2 );
+   cache.recover( sigs[0], d );
+   BOOST_CHECK_EQUAL( cache.hits(), 2 );
+   cache.recover( sigs[1], d );
+   BOOST_CHECK_EQUAL( cache.misses(), 4 );
+
+   // the digest is part of the key
+   const digest_type other = digest_type::hash( string( "other message" ) );
+   BOOST_CHECK( cache.recover( sigs[0], other ) != public_key_type( keys[0].get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.misses(), 5 );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( cache.size(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( market_ticker_window )
+{
+   using graphene::market_history::market_ticker_object;
+   using graphene::market_history::ticker_slot;
+   const uint32_t slot = market_ticker_object::slot_seconds;
+   const fc::time_point_sec start( 1000 * slot );
+
+   market_ticker_object ticker;
+   auto add_slot = [&]( fc::time_point_sec when, int64_t base, int64_t quote ) {
+      ticker_slot s;
+      s.period = when.sec_since_epoch() / slot;
+      s.base_volume = base;
+      s.quote_volume = quote;
+      s.close_base = base;
+      s.close_quote = quote;
+      ticker.slots.push_back( s );
+      ticker.base_volume += base;
+      ticker.quote_volume += quote;
+   };
+   add_slot( start, 10, 20 );
+   add_slot( start + 2 * slot, 30, 40 );
+
+   // both slots are still in the window until the first slot is a day old
+   ticker.advance( start + market_ticker_object::window_seconds );
+   BOOST_CHECK_EQUAL( ticker.slots.size(), 2 );
+   BOOST_CHECK_EQUAL( ticker.base_volume.value, 40 );
+
+   ticker.advance( start + slot + market_ticker_object::window_seconds );
+   BOOST_REQUIRE_EQUAL( ticker.slots.size(), 1 );
+   BOOST_CHECK_EQUAL( ticker.base_volume.value, 30 );
+   BOOST_CHECK_EQUAL( ticker.quote_volume.value, 40 );
+   BOOST_CHECK_EQUAL( ticker.prior_base.value, 10 );
+   BOOST_CHECK_EQUAL( ticker.prior_quote.value, 20 );
+
+   ticker.advance( start + 10 * market_ticker_object::window_seconds );
+   BOOST_CHECK( ticker.slots.empty() );
+   BOOST_CHECK_EQUAL( ticker.base_volume.value, 0 );
+   BOOST_CHECK_EQUAL( ticker.prior_base.value, 30 );
+}
+
+BOOST_AUTO_TEST_CASE( market_bucket_block_aggregation )
+{
+   using graphene::market_history::bucket_object;
+   const asset_id_type base;
+   const asset_id_type quote( 1 );
+   auto trade = [&]( int64_t b, int64_t q ) { return asset( b, base ) / asset( q, quote ); };
+
+   // a bucket that already holds the trades of earlier blocks
+   bucket_object stored;
+   stored.key.base = base;
+   stored.key.quote = quote;
+   graphene::market_history::add_trade( stored, trade( 10, 10 ) );
+   BOOST_CHECK_EQUAL( stored.open_base.value, 10 );
+   BOOST_CHECK_EQUAL( stored.low_base.value, 10 );
+
+   // the fills of one block added one by one, as against collected and merged once
+   bucket_object one_by_one = stored;
+   bucket_object block;
+   block.key = stored.key;
+   for( const price& p : { trade( 30, 10 ), trade( 5, 10 ), trade( 20, 10 ) } )
+   {
+      graphene::market_history::add_trade( one_by_one, p );
+      graphene::market_history::add_trade( block, p );
+   }
+   BOOST_CHECK_EQUAL( block.open_base.value, 30 );
+   graphene::market_history::merge_bucket( stored, block );
+
+   BOOST_CHECK_EQUAL( stored.open_base.value, 10 );
+   BOOST_CHECK_EQUAL( stored.high_base.value, 30 );
+   BOOST_CHECK_EQUAL( stored.low_base.value, 5 );
+   BOOST_CHECK_EQUAL( stored.close_base.value, 20 );
+   BOOST_CHECK_EQUAL( stored.base_volume.value, 65 );
+   BOOST_CHECK_EQUAL( stored.quote_volume.value, 40 );
+   BOOST_CHECK( stored.high() == one_by_one.high() );
+   BOOST_CHECK( stored.low() == one_by_one.low() );
+   BOOST_CHECK_EQUAL( stored.base_volume.value, one_by_one.base_volume.value );
+}
+
+BOOST_AUTO_TEST_CASE( order_history_time_index )
+{
+   using graphene::market_history::order_history_object;
+   using graphene::market_history::by_market_time;
+   const asset_id_type base( 1 ), quote( 2 ), other( 3 );
+
+   graphene::market_history::order_history_multi_index_type history;
+   int64_t next_id = 0;
+   // fills are recorded newest first, both sides of each trade, the way the plugin does
+   auto add_trade = [&]( asset_id_type b, asset_id_type q, int64_t sequence, uint32_t when ) {
+      for( int side = 0; side < 2; ++side )
+      {
+         order_history_object o;
+         o.id = object_id_type( 5, 0, next_id++ );
+         o.key.base = b;
+         o.key.quote = q;
+         o.key.sequence = sequence - side;
+         o.time = fc::time_point_sec( when );
+         o.op.pays = asset( 100, side == 0 ? b : q );
+         o.op.receives = asset( 50, side == 0 ? q : b );
+         history.insert( o );
+      }
+   };
+   add_trade( base, quote, 0, 100 );
+   add_trade( base, quote, -2, 200 );
+   add_trade( base, quote, -4, 200 );
+   add_trade( base, quote, -6, 300 );
+   add_trade( base, other, 0, 250 );
+
+   const auto& idx = history.get<by_market_time>();
+   // the trades before 300, newest first, one side each
+   auto itr = idx.upper_bound( boost::make_tuple( base, quote, true, fc::time_point_sec( 300 ) ) );
+   std::vector<int64_t> sequences;
+   for( ; itr != idx.end() && itr->base() == base && itr->quote() == quote && itr->pays_base(); ++itr )
+   {
+      BOOST_CHECK( itr->op.pays.asset_id == base );
+      sequences.push_back( itr->key.sequence );
+   }
+   BOOST_REQUIRE_EQUAL( sequences.size(), 3 );
+   BOOST_CHECK_EQUAL( sequences[0], -4 );
+   BOOST_CHECK_EQUAL( sequences[1], -2 );
+   BOOST_CHECK_EQUAL( sequences[2], 0 );
+
+   // a cursor of (time, sequence) resumes at the same trade
+   itr = idx.lower_bound( boost::make_tuple( base, quote, true, fc::time_point_sec( 200 ), int64_t( -2 ) ) );
+   BOOST_REQUIRE( itr != idx.end() );
+   BOOST_CHECK_EQUAL( itr->key.sequence, -2 );
+}
+
+BOOST_AUTO_TEST_CASE( observer_list_dispatch )
+{
+   observer_list<int> observers;
+   vector<int> seen;
+   observer_connection first = observers.connect( [&]( int i ) { seen.push_back( i ); }, "first" );
+   {
+      scoped_observer_connection second = observers.connect( [&]( int i ) { seen.push_back( -i ); }, "second" );
+      observers( 3 );
+      BOOST_CHECK( seen == vector<int>({ 3, -3 }) );
+      BOOST_REQUIRE_EQUAL( observers.statistics().size(), 2u );
+      BOOST_CHECK_EQUAL( observers.statistics()[1].name, "second" );
+      BOOST_CHECK_EQUAL( observers.statistics()[1].calls, 1u );
+   }
+
+   // the scoped connection is gone, the plain one stays until disconnected
+   observers( 4 );
+   BOOST_CHECK( seen == vector<int>({ 3, -3, 4 }) );
+   BOOST_REQUIRE_EQUAL( observers.statistics().size(), 1u );
+   BOOST_CHECK_EQUAL( observers.statistics()[0].calls, 2u );
+
+   first.disconnect();
+   BOOST_CHECK( !first.connected() );
+   observers( 5 );
+   BOOST_CHECK_EQUAL( seen.size(), 3u );
+   BOOST_CHECK( observers.statistics().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( metrics_registry_render )
+{
+   graphene::utilities::metrics_registry metrics;
+   metrics.counter( "calls_total", "Calls", "method=\"a\"" ).add( 2 );
+   // the same name and labels find the same counter
+   metrics.counter( "calls_total", "Calls", "method=\"a\"" ).add();
+   auto& latency = metrics.histogram( "latency_seconds", "Latency", { 0.1, 1 } );
+   latency.observe( 0.0625 );
+   latency.observe( 0.5 );
+   latency.observe( 4 );
+   metrics.add_gauge( "depth", "Depth", []() -> double { return 7; } );
+   BOOST_CHECK_THROW( metrics.counter( "depth", "Depth" ), std::logic_error );
+
+   const std::string text = metrics.render();
+   BOOST_CHECK( text.find( "# TYPE calls_total counter\ncalls_total{method=\"a\"} 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "latency_seconds_bucket{le=\"0.1\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "latency_seconds_bucket{le=\"1\"} 2\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "latency_seconds_bucket{le=\"+Inf\"} 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "latency_seconds_sum 4.5625\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "latency_seconds_count 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "# TYPE depth gauge\ndepth 7\n" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( allocation_phases_nest )
+{
+   using namespace graphene::utilities;
+   BOOST_CHECK_EQUAL( allocation_stats::current_phase(), alloc_other );
+   {
+      allocation_phase_scope block( alloc_block_apply );
+      {
+         allocation_phase_scope maintenance( alloc_maintenance );
+         BOOST_CHECK_EQUAL( allocation_stats::current_phase(), alloc_maintenance );
+
+         const allocation_snapshot before = allocation_stats::snapshot();
+         std::unique_ptr<std::vector<char>> v( new std::vector<char>( 1000 ) );
+         const allocation_snapshot allocated = allocation_stats::snapshot() - before;
+         if( allocation_stats::hooked() )
+         {
+            BOOST_CHECK_EQUAL( allocated.phases[alloc_maintenance].allocations, 2 );
+            BOOST_CHECK( allocated.phases[alloc_maintenance].bytes >= 1000 );
+            BOOST_CHECK_EQUAL( allocated.by_phase().count( "maintenance" ), 1 );
+         }
+         else
+            BOOST_CHECK_EQUAL( allocated.total().allocations, 0 );
+      }
+      BOOST_CHECK_EQUAL( allocation_stats::current_phase(), alloc_block_apply );
+   }
+   BOOST_CHECK_EQUAL( allocation_stats::current_phase(), alloc_other );
+}
+
+BOOST_AUTO_TEST_CASE( executor_runs_tasks )
+{
+   using namespace graphene::utilities;
+   metrics_registry metrics;
+   executor pool( 3, false, &metrics );
+   BOOST_CHECK_EQUAL( pool.thread_count(), 3 );
+   BOOST_CHECK( !pool.on_worker_thread() );
+
+   fc::future<int> answer = pool.async( "test_answer", []() { return 42; } );
+   BOOST_CHECK_EQUAL( answer.wait(), 42 );
+   fc::future<void> failed = pool.async( "test_failure", []() { FC_THROW( "task failed" ); }, priority_low );
+   BOOST_CHECK_THROW( failed.wait(), fc::exception );
+
+   // tasks posted from a worker go to its own queue, the idle threads steal them
+   fc::future<size_t> nested = pool.async( "test_nested", [&pool]() -> size_t {
+      if( !pool.on_worker_thread() )
+         return 0;
+      std::atomic<size_t> sum( 0 );
+      pool.run_parallel( "test_parallel", 100, [&sum]( size_t n ) { sum += n; } );
+      return sum;
+   } );
+   BOOST_CHECK_EQUAL( nested.wait(), 4950 );
+
+   std::vector<size_t> squares( 1000 );
+   pool.run_parallel( "test_parallel", squares.size(), [&squares]( size_t n ) { squares[n] = n * n; }, 2 );
+   BOOST_CHECK_EQUAL( squares[999], 999 * 999 );
+   BOOST_CHECK_THROW( pool.run_parallel( "test_parallel", 10, []( size_t n ) { FC_ASSERT( n != 7 ); } ), fc::exception );
+
+   // nested in the tasks of another, run_parallel() does not wait for helpers queued behind the threads waiting
+   executor small( 2 );
+   std::atomic<size_t> inner( 0 );
+   small.run_parallel( "test_outer", 8, [&small, &inner]( size_t ) {
+      small.run_parallel( "test_inner", 8, [&inner]( size_t ) { ++inner; } );
+   } );
+   BOOST_CHECK_EQUAL( inner.load(), 64 );
+
+   BOOST_CHECK_EQUAL( pool.queued(), 0 );
+   const std::string text = metrics.render();
+   BOOST_CHECK( text.find( "graphene_executor_tasks_total{type=\"test_answer\"} 1\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "graphene_executor_threads 3\n" ) != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( api_call_log_keeps_slow_calls )
+{
+   graphene::utilities::metrics_registry metrics;
+   graphene::app::api_call_log log( &metrics );
+   const fc::variants args{ fc::variant( std::string( 1000, 'x' ) ) };
+
+   // nothing is kept until there is a threshold
+   log.record( "get_objects", args, "127.0.0.1:5000", fc::seconds( 5 ), fc::milliseconds( 2 ), 100, false );
+   BOOST_CHECK( log.get_slow_calls().empty() );
+
+   log.set_threshold( fc::milliseconds( 10 ) );
+   log.set_max_slow_calls( 2 );
+   log.record( "get_objects", args, "127.0.0.1:5000", fc::milliseconds( 5 ), fc::milliseconds( 1 ), 100, false );
+   log.record( "get_objects", args, "127.0.0.1:5000", fc::milliseconds( 20 ), fc::milliseconds( 2 ), 5000, false );
+   log.record( "get_block", args, "127.0.0.1:5001", fc::milliseconds( 30 ), fc::optional<fc::microseconds>(), 300, false );
+   log.record( "no_such_method", args, "127.0.0.1:5002", fc::milliseconds( 40 ), fc::optional<fc::microseconds>(), 80, true );
+   BOOST_CHECK_EQUAL( log.slow_call_count(), 4 );
+
+   // the oldest slow calls make room for newer ones
+   const auto calls = log.get_slow_calls();
+   BOOST_REQUIRE_EQUAL( calls.size(), 2 );
+   BOOST_CHECK_EQUAL( calls[0].method, "get_block" );
+   BOOST_CHECK_EQUAL( calls[0].remote_endpoint, "127.0.0.1:5001" );
+   BOOST_CHECK_EQUAL( calls[0].duration, 30000 );
+   BOOST_CHECK_EQUAL( calls[0].encode_time, 0 );
+   BOOST_CHECK_EQUAL( calls[0].arguments.size(), graphene::app::api_call_log::max_argument_chars + 3 );
+   BOOST_CHECK( calls[1].failed );
+
+   // failed calls are not counted by method
+   const std::string text = metrics.render();
+   BOOST_CHECK( text.find( "graphene_api_slow_calls_total 4\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "graphene_api_response_bytes_count{method=\"get_objects\"} 3\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "graphene_api_encode_seconds_count{method=\"get_block\"} 0\n" ) != std::string::npos );
+   BOOST_CHECK( text.find( "no_such_method" ) == std::string::npos );
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -32,10 +32,36 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_object.hpp>
-
+#include <graphene/chain/transaction_object.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <graphene/account_history/account_history_store.hpp>
+#include <graphene/app/api.hpp>
+#include <graphene/app/api_reader_pool.hpp>
+#include <graphene/app/applied_block_queue.hpp>
+#include <graphene/app/applied_operation_log.hpp>
+#include <graphene/app/block_log_bootstrap.hpp>
+#include <graphene/app/confirmation_registry.hpp>
+#include <graphene/app/database_api.hpp>
+#include <graphene/app/impacted.hpp>
+#include <graphene/app/send_queue.hpp>
+#include <graphene/app/subscription_hub.hpp>
+
+#include <graphene/change_stream/change_stream_plugin.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
+#include <graphene/wallet/wallet.hpp>
+
+#include <graphene/utilities/executor.hpp>
+#include <graphene/utilities/key_conversion.hpp>
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
+#include <fc/network/http/server.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <set>
 
 #include "../common/database_fixture.hpp"
 
@@ -125,6 +151,521 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_mmap_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_memory_mapped( true );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( !bdb.last().valid() );
+
+      signed_block b;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+
+         // every store grows the files past the current mappings
+         auto fetch = bdb.fetch_by_number( b.block_num() );
+         FC_ASSERT( fetch.valid() );
+         FC_ASSERT( fetch->witness == b.witness );
+         FC_ASSERT( bdb.contains( b.id() ) );
+         FC_ASSERT( *bdb.last_id() == b.id() );
+      }
+
+      bdb.remove( b.id() );
+      FC_ASSERT( !bdb.contains( b.id() ) );
+      FC_ASSERT( bdb.last()->block_num() == 4 );
+      BOOST_CHECK_THROW( bdb.set_memory_mapped( false ), fc::exception );
+
+      bdb.close();
+      bdb.set_memory_mapped( false );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.last()->block_num() == 4 );
+      for( uint32_t i = 1; i < 5; ++i )
+      {
+         auto blk = bdb.fetch_by_number( i );
+         FC_ASSERT( blk.valid() );
+         FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
+         auto packed = bdb.fetch_packed_by_number( i );
+         FC_ASSERT( packed.valid() );
+         FC_ASSERT( *packed == fc::raw::pack( *blk ) );
+         auto bytes = bdb.fetch_block_bytes( blk->id() );
+         FC_ASSERT( bytes.valid() && *bytes == *packed );
+      }
+      // the removed block, and an id that doesn't match the block stored at its number
+      FC_ASSERT( !bdb.fetch_block_bytes( b.id() ).valid() );
+      signed_block other = *bdb.fetch_by_number( 3 );
+      other.witness = witness_id_type(9);
+      FC_ASSERT( !bdb.fetch_block_bytes( other.id() ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_segments_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_segment_size( 2 );
+      bdb.set_compression_level( 9 );
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+      }
+      FC_ASSERT( fc::exists( data_dir.path() / "blocks.000000" ) );
+      FC_ASSERT( fc::exists( data_dir.path() / "blocks.000002" ) );
+      FC_ASSERT( !fc::exists( data_dir.path() / "blocks" ) );
+      // packed blocks come out inflated
+      FC_ASSERT( *bdb.fetch_packed_by_number( 5 ) == fc::raw::pack( b ) );
+      FC_ASSERT( !bdb.fetch_packed_by_number( 6 ).valid() );
+
+      // the layout of an existing database wins over the configured one
+      bdb.close();
+      bdb.set_segment_size( 0 );
+      bdb.set_compression_level( 0 );
+      bdb.set_memory_mapped( true );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.segment_size() == 2 );
+      FC_ASSERT( bdb.last()->id() == b.id() );
+      for( uint32_t i = 1; i <= 5; ++i )
+      {
+         auto blk = bdb.fetch_by_number( i );
+         FC_ASSERT( blk.valid() );
+         FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
+      }
+
+      // reading a block of a missing segment fails rather than making an empty file for it
+      bdb.close();
+      bdb.set_memory_mapped( false );
+      fc::remove( data_dir.path() / "blocks.000001" );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( !bdb.fetch_by_number( 3 ).valid() );
+      FC_ASSERT( !fc::exists( data_dir.path() / "blocks.000001" ) );
+      FC_ASSERT( bdb.fetch_by_number( 5 ).valid() );
+      bdb.close();
+
+      // a new database only drops the block files of an earlier one
+      fc::temp_directory stale_dir( graphene::utilities::temp_directory_path() );
+      for( const char* name : { "blocks", "blocks.000007", "blocks.json", "blocks_backup" } )
+         std::ofstream( ( stale_dir.path() / name ).generic_string() ) << "x";
+      block_database fresh;
+      fresh.open( stale_dir.path() );
+      FC_ASSERT( fc::file_size( stale_dir.path() / "blocks" ) == 0 );
+      FC_ASSERT( !fc::exists( stale_dir.path() / "blocks.000007" ) );
+      FC_ASSERT( fc::exists( stale_dir.path() / "blocks.json" ) );
+      FC_ASSERT( fc::exists( stale_dir.path() / "blocks_backup" ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_segment_copy_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_segment_size( 4 );
+      bdb.set_compression_level( 9 );
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> chain;
+      signed_block b;
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         chain.push_back( b );
+      }
+      bdb.close();
+
+      // the files as a mirror serves them
+      auto read_file = [&]( const std::string& name ) -> vector<char> {
+         std::ifstream in( ( data_dir.path() / name ).generic_string(), std::ios::binary );
+         return vector<char>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+      };
+      const vector<char> index = read_file( "index" );
+      const vector<char> segment = read_file( block_database::segment_file_name( 1 ) );
+      const size_t entry = block_database::index_entry_size;
+
+      const vector<char> entries( index.begin() + 5 * entry, index.begin() + 8 * entry );
+      const vector<signed_block> blocks = block_database::read_segment_copy( 5, 7, entries, segment );
+      BOOST_REQUIRE_EQUAL( blocks.size(), 3 );
+      for( size_t i = 0; i < blocks.size(); ++i )
+         BOOST_CHECK( blocks[i].id() == chain[4 + i].id() );
+
+      // entries of other blocks, or too few of them, are refused
+      BOOST_CHECK_THROW( block_database::read_segment_copy( 4, 6, entries, segment ), fc::exception );
+      BOOST_CHECK_THROW( block_database::read_segment_copy( 5, 8, entries, segment ), fc::exception );
+      // as is a segment that ends before the blocks
+      BOOST_CHECK_THROW( block_database::read_segment_copy( 5, 7, entries, vector<char>( segment.begin(), segment.end() - 1 ) ),
+                         fc::exception );
+
+      // the part of the segment that holds the blocks is enough
+      const auto span = block_database::segment_copy_span( 5, 7, entries );
+      BOOST_REQUIRE( span.first < span.second && span.second <= segment.size() );
+      const vector<char> part( segment.begin() + span.first, segment.begin() + span.second );
+      BOOST_CHECK_EQUAL( block_database::read_segment_copy( 5, 7, entries, part, span.first ).size(), 3 );
+      BOOST_CHECK_THROW( block_database::read_segment_copy( 5, 7, entries, part ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_log_bootstrap_test )
+{
+   try {
+      fc::temp_directory good_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory bad_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory node_dir( graphene::utilities::temp_directory_path() );
+
+      // the bad mirror has the headers of the good one, so the same ids, but not their transactions
+      vector<signed_block> chain;
+      {
+         block_database good, bad;
+         for( block_database* bdb : { &good, &bad } )
+         {
+            bdb->set_segment_size( 4 );
+            bdb->set_compression_level( 9 );
+         }
+         good.open( good_dir.path() );
+         bad.open( bad_dir.path() );
+         signed_block b;
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.transactions.clear();
+            signed_transaction trx;
+            trx.ref_block_num = i;
+            b.transactions.push_back( processed_transaction( trx ) );
+            b.transaction_merkle_root = b.calculate_merkle_root();
+            good.store( b.id(), b );
+            signed_block stripped = b;
+            stripped.transactions.clear();
+            bad.store( stripped.id(), stripped );
+            chain.push_back( b );
+         }
+         good.close();
+         bad.close();
+      }
+
+      // a mirror serves the files of a directory, whole, and notes what was asked for
+      std::set<std::string> requested;
+      auto serve = [&]( const fc::path& dir, uint16_t port ) {
+         auto server = std::make_shared<fc::http::server>();
+         server->on_request( [&requested, dir]( const fc::http::request& request, const fc::http::server::response& response ) {
+            const std::string name = request.path.substr( request.path.rfind( '/' ) + 1 );
+            requested.insert( name );
+            std::ifstream in( ( dir / name ).generic_string(), std::ios::binary );
+            const std::string body( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+            response.set_status( in ? fc::http::reply::OK : fc::http::reply::NotFound );
+            response.set_length( body.size() );
+            response.write( body.data(), body.size() );
+         });
+         server->listen( fc::ip::endpoint::from_string( "127.0.0.1:" + fc::to_string( port ) ) );
+         return server;
+      };
+      const auto good_server = serve( good_dir.path(), 18471 );
+      const auto bad_server = serve( bad_dir.path(), 18472 );
+      const std::string good_mirror = "http://127.0.0.1:18471/block_num_to_block";
+      const std::string bad_mirror = "http://127.0.0.1:18472/block_num_to_block/";
+
+      const fc::path block_log_dir = node_dir.path() / "block_num_to_block";
+      const fc::path staging_dir( block_log_dir.generic_string() + ".bootstrap" );
+      fc::flat_map<uint32_t, block_id_type> checkpoints;
+      checkpoints[10] = chain[9].id();
+
+      // a checkpoint the mirrors do not reach leaves nothing behind
+      {
+         fc::flat_map<uint32_t, block_id_type> wrong;
+         wrong[10] = chain[8].id();
+         graphene::app::block_log_bootstrap bootstrap( { good_mirror }, 2 );
+         bootstrap.set_storage( 4, 9 );
+         BOOST_CHECK_THROW( bootstrap.run( block_log_dir, wrong ), fc::exception );
+         BOOST_CHECK( !fc::exists( staging_dir ) );
+         BOOST_CHECK( !fc::exists( block_log_dir ) );
+      }
+
+      // an interrupted bootstrap left the first blocks, the bad mirror is asked first for some segments
+      {
+         block_database staging;
+         staging.set_segment_size( 4 );
+         staging.set_compression_level( 9 );
+         staging.open( staging_dir );
+         for( uint32_t i = 0; i < 3; ++i )
+            staging.store( chain[i].id(), chain[i] );
+         staging.close();
+      }
+      requested.clear();
+      graphene::app::block_log_bootstrap bootstrap( { bad_mirror, good_mirror }, 2 );
+      bootstrap.set_storage( 4, 9 );
+      BOOST_CHECK_EQUAL( bootstrap.run( block_log_dir, checkpoints ), 10 );
+      BOOST_CHECK( !fc::exists( staging_dir ) );
+      // blocks 1 through 3 are all of segment 0
+      BOOST_CHECK( requested.count( block_database::segment_file_name( 0 ) ) == 0 );
+      BOOST_CHECK( requested.count( block_database::segment_file_name( 1 ) ) == 1 );
+
+      block_database result;
+      result.open( block_log_dir );
+      BOOST_REQUIRE( result.last_id().valid() );
+      BOOST_CHECK( *result.last_id() == chain[9].id() );
+      for( const signed_block& b : chain )
+      {
+         const auto stored = result.fetch_by_number( b.block_num() );
+         BOOST_REQUIRE( stored.valid() );
+         BOOST_CHECK( stored->id() == b.id() );
+         BOOST_CHECK_EQUAL( stored->transactions.size(), 1 );
+      }
+      result.close();
+
+      // a block log with blocks is left alone
+      BOOST_CHECK_EQUAL( bootstrap.run( block_log_dir, checkpoints ), 0 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_write_behind_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_write_behind( 3 );
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_THROW( bdb.set_write_behind( 0 ), fc::exception );
+
+      signed_block b;
+      vector<signed_block> chain;
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         chain.push_back( b );
+
+         // queued or written, a stored block is found right away
+         FC_ASSERT( bdb.contains( b.id() ) );
+         FC_ASSERT( bdb.fetch_by_number( b.block_num() )->witness == b.witness );
+         FC_ASSERT( *bdb.fetch_packed_by_number( b.block_num() ) == fc::raw::pack( b ) );
+         FC_ASSERT( *bdb.last_id() == b.id() );
+      }
+      bdb.flush_through( 5 );
+
+      // a block stored again at the same number replaces the one stored before
+      signed_block other = chain[7];
+      other.witness = witness_id_type(20);
+      bdb.store( other.id(), other );
+      FC_ASSERT( !bdb.contains( chain[7].id() ) );
+      FC_ASSERT( !bdb.fetch_optional( chain[7].id() ).valid() );
+      FC_ASSERT( !bdb.fetch_block_bytes( chain[7].id() ).valid() );
+      FC_ASSERT( bdb.fetch_block_id( 8 ) == other.id() );
+      bdb.store( chain[7].id(), chain[7] );
+
+      bdb.remove( chain[9].id() );
+      FC_ASSERT( !bdb.contains( chain[9].id() ) );
+      FC_ASSERT( bdb.last()->id() == chain[8].id() );
+
+      bdb.store( chain[9].id(), chain[9] );
+      bdb.close();
+
+      // everything queued is written before the database closes
+      bdb.set_write_behind( 0 );
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.last()->id() == chain.back().id() );
+      for( const signed_block& blk : chain )
+      {
+         auto fetch = bdb.fetch_optional( blk.id() );
+         FC_ASSERT( fetch.valid() );
+         FC_ASSERT( fetch->witness == blk.witness );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_fetch_block_ids_test )
+{
+   try {
+      // through the streams, through the mappings, and with blocks still queued for the writer
+      for( int mode = 0; mode < 3; ++mode )
+      {
+         fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+         block_database bdb;
+         bdb.set_memory_mapped( mode == 1 );
+         bdb.set_write_behind( mode == 2 ? 100 : 0 );
+         bdb.open( data_dir.path() );
+
+         vector<block_id_type> ids;
+         signed_block b;
+         for( uint32_t i = 0; i < 10; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+
+         FC_ASSERT( bdb.fetch_block_ids( 1, 10 ) == ids );
+         FC_ASSERT( bdb.fetch_block_ids( 3, 4 ) == vector<block_id_type>( ids.begin() + 2, ids.begin() + 6 ) );
+         // a range running past the last block stops short
+         FC_ASSERT( bdb.fetch_block_ids( 8, 2000 ) == vector<block_id_type>( ids.begin() + 7, ids.end() ) );
+         FC_ASSERT( bdb.fetch_block_ids( 11, 5 ).empty() );
+         for( uint32_t num = 1; num <= 10; ++num )
+            FC_ASSERT( bdb.fetch_block_ids( num, 1 ).front() == bdb.fetch_block_id( num ) );
+         bdb.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_torn_tail_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      vector<signed_block> chain;
+      signed_block b;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         chain.push_back( b );
+      }
+      bdb.close();
+
+      // a crash cut the last block short and tore the entry written after it
+      const fc::path blocks = data_dir.path() / "blocks";
+      fc::resize_file( blocks, fc::file_size( blocks ) - 3 );
+      const fc::path index = data_dir.path() / "index";
+      fc::resize_file( index, fc::file_size( index ) + 7 );
+
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.last()->id() == chain[3].id() );
+      FC_ASSERT( *bdb.last_id() == chain[3].id() );
+      FC_ASSERT( !bdb.contains( chain[4].id() ) );
+      bdb.store( chain[4].id(), chain[4] );
+      bdb.close();
+
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.last()->id() == chain[4].id() );
+      FC_ASSERT( bdb.fetch_by_number( 5 )->id() == chain[4].id() );
+
+      // the blocks after a gap go in a write per chunk of entries
+      BOOST_CHECK_EQUAL( bdb.remove_after( 2 ), 3u );
+      FC_ASSERT( *bdb.last_id() == chain[1].id() );
+      FC_ASSERT( !bdb.contains( chain[2].id() ) && !bdb.contains( chain[4].id() ) );
+      BOOST_CHECK_EQUAL( bdb.remove_after( 2 ), 0u );
+      bdb.remove( chain[1].id() );
+      FC_ASSERT( *bdb.last_id() == chain[0].id() );
+      bdb.close();
+
+      // a tail longer than a chunk
+      fc::temp_directory long_dir( graphene::utilities::temp_directory_path() );
+      block_database long_tail;
+      long_tail.open( long_dir.path() );
+      signed_block blk;
+      for( uint32_t i = 0; i < 10000; ++i )
+      {
+         if( i > 0 ) blk.previous = blk.id();
+         long_tail.store( blk.id(), blk );
+      }
+      BOOST_CHECK_EQUAL( long_tail.remove_after( 10 ), 9990u );
+      FC_ASSERT( long_tail.last()->block_num() == 10 );
+      FC_ASSERT( !long_tail.fetch_by_number( 4097 ).valid() && !long_tail.fetch_by_number( 10000 ).valid() );
+      long_tail.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_pruning_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_segment_size( 4 );
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> chain;
+      signed_block b;
+      for( uint32_t i = 0; i < 14; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         chain.push_back( b );
+      }
+
+      // blocks 1..7 sit in segments 0 and 1, segment 2 holds block 9 and is kept
+      bdb.prune_before( 9 );
+      FC_ASSERT( !fc::exists( data_dir.path() / "blocks.000000" ) );
+      FC_ASSERT( !fc::exists( data_dir.path() / "blocks.000001" ) );
+      FC_ASSERT( fc::exists( data_dir.path() / "blocks.000002" ) );
+      FC_ASSERT( bdb.is_pruned( 7 ) && !bdb.is_pruned( 8 ) );
+
+      auto check = [&]()
+      {
+         for( const signed_block& blk : chain )
+         {
+            // ids of pruned blocks are still known, their contents are not
+            FC_ASSERT( bdb.fetch_block_id( blk.block_num() ) == blk.id() );
+            FC_ASSERT( bdb.fetch_by_number( blk.block_num() ).valid() == ( blk.block_num() >= 8 ) );
+            FC_ASSERT( bdb.fetch_block_bytes( blk.id() ).valid() == ( blk.block_num() >= 8 ) );
+         }
+         FC_ASSERT( bdb.last()->id() == chain.back().id() );
+      };
+      check();
+      FC_ASSERT( !fc::exists( data_dir.path() / "blocks.000000" ) );
+
+      // pruning again below the first kept segment does nothing, and the first segment survives reopening
+      bdb.prune_before( 5 );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      FC_ASSERT( bdb.is_pruned( 7 ) && !bdb.is_pruned( 8 ) );
+      check();
+
+      // a database without segments keeps its blocks
+      fc::temp_directory single_dir( graphene::utilities::temp_directory_path() );
+      block_database single;
+      single.open( single_dir.path() );
+      for( const signed_block& blk : chain )
+         single.store( blk.id(), blk );
+      single.prune_before( 9 );
+      FC_ASSERT( !single.is_pruned( 1 ) );
+      FC_ASSERT( single.fetch_by_number( 1 ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -180,35 +721,205 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
-BOOST_AUTO_TEST_CASE( undo_block )
+BOOST_AUTO_TEST_CASE( pipelined_reindex )
 {
    try {
       fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type cutoff_id;
+      fc::sha256 replay_hash;
       {
          database db;
-         db.open(data_dir.path(), make_genesis);
-         fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
-         std::vector< time_point_sec > time_stack;
+         db.open(data_dir.path(), make_genesis );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 30 )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         cutoff_id = db.fetch_block_by_number( db.get_dynamic_global_properties().last_irreversible_block_num )->id();
+         db.close();
+      }
+      {
+         database db;
+         db.set_replay_prefetch_depth( 8 );
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == cutoff_id );
+
+         const replay_statistics& stats = db.get_replay_statistics();
+         BOOST_CHECK_EQUAL( stats.first_block, 1 );
+         BOOST_CHECK_EQUAL( stats.last_block, db.head_block_num() );
+         BOOST_CHECK_EQUAL( stats.blocks, db.head_block_num() );
+         BOOST_CHECK_EQUAL( stats.transactions, 0 );
+         BOOST_CHECK( stats.apply_time <= stats.elapsed_time );
+         BOOST_CHECK_EQUAL( stats.skip_flags, db.get_replay_skip_flags() );
+         BOOST_CHECK( stats.header_time + stats.transaction_time + stats.chain_update_time + stats.handler_time
+                      <= stats.apply_time );
+         replay_hash = db.state_hash();
+      }
+      {
+         // all checks a node does on blocks from the network give the same state
+         database db;
+         db.set_replay_skip_flags( database::skip_nothing );
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == cutoff_id );
+         BOOST_CHECK( db.state_hash() == replay_hash );
+         BOOST_CHECK_EQUAL( db.get_replay_statistics().skip_flags, uint32_t( database::skip_nothing ) );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
 
-         auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
-         for( uint32_t i = 0; i < 5; ++i )
-         {
-            now = db.get_slot_time(1);
-            time_stack.push_back( now );
-            auto b = db.generate_block( now, db.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
-         }
-         BOOST_CHECK( db.head_block_num() == 5 );
-         BOOST_CHECK( db.head_block_time() == now );
-         db.pop_block();
-         time_stack.pop_back();
-         now = time_stack.back();
-         BOOST_CHECK( db.head_block_num() == 4 );
-         BOOST_CHECK( db.head_block_time() == now );
-         db.pop_block();
-         time_stack.pop_back();
-         now = time_stack.back();
-         BOOST_CHECK( db.head_block_num() == 3 );
-         BOOST_CHECK( db.head_block_time() == now );
+BOOST_AUTO_TEST_CASE( reindex_from_snapshot )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      state_snapshot_info info;
+      block_id_type cutoff_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         for( uint32_t i = 0; i < 20; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         info = db.export_state_snapshot( snapshot_dir.path() );
+         BOOST_CHECK_EQUAL( info.block_num, 20 );
+         BOOST_CHECK( info.state_hash == db.state_hash() );
+
+         // the snapshot block has to become irreversible to survive close()
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 40 )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         cutoff_id = db.fetch_block_by_number( db.get_dynamic_global_properties().last_irreversible_block_num )->id();
+         db.close();
+      }
+      fc::sha256 snapshot_replay_hash;
+      {
+         database db;
+         BOOST_CHECK_THROW( db.reindex_from_snapshot( data_dir.path(), snapshot_dir.path(), fc::sha256() ), fc::exception );
+
+         // a description naming another chain is refused even though the state hash matches
+         const fc::path description = snapshot_dir.path() / "snapshot.json";
+         state_snapshot_info other_chain = info;
+         other_chain.chain_id = chain_id_type( fc::sha256::hash( string( "another chain" ) ) );
+         fc::json::save_to_file( other_chain, description );
+         BOOST_CHECK_THROW( db.reindex_from_snapshot( data_dir.path(), snapshot_dir.path(), info.state_hash ), fc::exception );
+         fc::json::save_to_file( info, description );
+
+         db.reindex_from_snapshot( data_dir.path(), snapshot_dir.path(), info.state_hash );
+         BOOST_CHECK( db.head_block_id() == cutoff_id );
+         snapshot_replay_hash = db.state_hash();
+         db.close();
+      }
+      {
+         database db;
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == cutoff_id );
+         BOOST_CHECK( db.state_hash() == snapshot_replay_hash );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( verify_replay_between_snapshots )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory work_dir( graphene::utilities::temp_directory_path() );
+      vector< std::unique_ptr<fc::temp_directory> > snapshot_dirs;
+      vector<fc::path> snapshot_paths;
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      state_snapshot_info first;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         for( uint32_t s = 0; s < 3; ++s )
+         {
+            for( uint32_t i = 0; i < 10; ++i )
+               db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+            snapshot_dirs.emplace_back( new fc::temp_directory( graphene::utilities::temp_directory_path() ) );
+            snapshot_paths.push_back( snapshot_dirs.back()->path() );
+            const state_snapshot_info info = db.export_state_snapshot( snapshot_paths.back() );
+            if( s == 0 )
+               first = info;
+         }
+         // the snapshot blocks have to become irreversible to survive close()
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 40 )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         db.close();
+      }
+
+      database db;
+      db.set_replay_prefetch_depth( 4 );
+      BOOST_CHECK_THROW( db.verify_replay( data_dir.path(), snapshot_paths, fc::sha256(), work_dir.path(), 2 ),
+                         fc::exception );
+      BOOST_CHECK_THROW( db.verify_replay( data_dir.path(), { snapshot_paths[0] }, first.state_hash, work_dir.path(), 2 ),
+                         fc::exception );
+
+      // the order of the snapshots does not matter
+      auto results = db.verify_replay( data_dir.path(), { snapshot_paths[2], snapshot_paths[0], snapshot_paths[1] },
+                                       first.state_hash, work_dir.path(), 2 );
+      BOOST_REQUIRE_EQUAL( results.size(), 2 );
+      BOOST_CHECK_EQUAL( results[0].from_block, 10 );
+      BOOST_CHECK_EQUAL( results[0].to_block, 20 );
+      BOOST_CHECK_EQUAL( results[1].from_block, 20 );
+      BOOST_CHECK_EQUAL( results[1].to_block, 30 );
+      for( const auto& r : results )
+      {
+         BOOST_CHECK( r.matches );
+         BOOST_CHECK( r.error.empty() );
+         BOOST_CHECK( r.actual_state_hash == r.expected_state_hash );
+      }
+
+      // a snapshot the block log does not lead to is reported, the other ranges are still checked
+      auto last = fc::json::from_file( snapshot_paths[2] / "snapshot.json" ).as<state_snapshot_info>();
+      last.state_hash = fc::sha256::hash( string( "not the state" ) );
+      fc::json::save_to_file( last, snapshot_paths[2] / "snapshot.json" );
+      results = db.verify_replay( data_dir.path(), snapshot_paths, optional<fc::sha256>(), work_dir.path(), 1 );
+      BOOST_REQUIRE_EQUAL( results.size(), 2 );
+      BOOST_CHECK( results[0].matches );
+      BOOST_CHECK( !results[1].matches );
+      BOOST_CHECK( results[1].error.empty() );
+
+      // the shared block log is left intact
+      database replayed;
+      replayed.reindex( data_dir.path(), make_genesis() );
+      BOOST_CHECK_GE( replayed.head_block_num(), 40 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( undo_block )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         fc::time_point_sec now( GRAPHENE_TESTING_GENESIS_TIMESTAMP );
+         std::vector< time_point_sec > time_stack;
+
+         auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+         for( uint32_t i = 0; i < 5; ++i )
+         {
+            now = db.get_slot_time(1);
+            time_stack.push_back( now );
+            auto b = db.generate_block( now, db.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+         }
+         BOOST_CHECK( db.head_block_num() == 5 );
+         BOOST_CHECK( db.head_block_time() == now );
+         db.pop_block();
+         time_stack.pop_back();
+         now = time_stack.back();
+         BOOST_CHECK( db.head_block_num() == 4 );
+         BOOST_CHECK( db.head_block_time() == now );
+         db.pop_block();
+         time_stack.pop_back();
+         now = time_stack.back();
+         BOOST_CHECK( db.head_block_num() == 3 );
+         BOOST_CHECK( db.head_block_time() == now );
          db.pop_block();
          time_stack.pop_back();
          now = time_stack.back();
@@ -228,6 +939,125 @@ BOOST_AUTO_TEST_CASE( undo_block )
    }
 }
 
+BOOST_AUTO_TEST_CASE( checkpoint_sync_skips_signatures )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      database db3;
+      db3.open(data_dir3.path(), make_genesis);
+
+      // only the last checkpoint matters for the blocks below it
+      flat_map<uint32_t,block_id_type> checkpoints;
+      checkpoints[10] = block_id_type( "0000000a00000000000000000000000000000001" );
+      db2.add_checkpoints( checkpoints );
+
+      auto bad_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("bad_key")) );
+      signed_block b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), bad_key, database::skip_witness_signature);
+
+      // the transactions must still match the merkle root
+      signed_block tampered = b;
+      tampered.transactions.emplace_back( signed_transaction() );
+      BOOST_CHECK_THROW( db2.push_block( tampered ), fc::exception );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 0 );
+
+      // the witness signature is not checked below the checkpoint
+      BOOST_CHECK_THROW( db3.push_block( b ), fc::exception );
+      db2.push_block( b );
+      BOOST_CHECK( db2.head_block_id() == b.id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_diff_replication )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.set_state_diff_history( 100 );
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      while( db1.get_dynamic_global_properties().last_irreversible_block_num < 20 )
+      {
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         FC_ASSERT( db1.head_block_num() < 100 );
+      }
+      const uint32_t lib = db1.get_dynamic_global_properties().last_irreversible_block_num;
+      // only irreversible blocks are handed out
+      BOOST_CHECK( db1.get_state_diffs( lib + 1, 10 ).empty() );
+
+      for( uint32_t next = 1; next <= lib; )
+      {
+         vector<block_state_diff> diffs = db1.get_state_diffs( next, 7 );
+         BOOST_REQUIRE( !diffs.empty() );
+         for( const block_state_diff& diff : diffs )
+         {
+            BOOST_CHECK_EQUAL( diff.block.block_num(), next );
+            db2.apply_state_diff( fc::raw::unpack<block_state_diff>( fc::raw::pack( diff ) ) );
+            ++next;
+         }
+      }
+      BOOST_CHECK( db2.head_block_id() == db1.get_block_id_for_num( lib ) );
+      BOOST_CHECK( db2.fetch_block_by_number( lib ).valid() );
+      BOOST_CHECK_THROW( db2.apply_state_diff( db1.get_state_diffs( lib, 1 ).front() ), fc::exception );
+
+      while( db1.head_block_num() > lib )
+         db1.pop_block();
+      BOOST_CHECK( db1.state_hash() == db2.state_hash() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( incremental_state_hash )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      database db;
+      db.set_state_hash_history( 5 );
+      db.open(data_dir.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      for( uint32_t i = 0; i < 10; ++i )
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      const uint32_t head = db.head_block_num();
+      auto recorded = db.get_block_state_hash( head );
+      BOOST_REQUIRE( recorded.valid() );
+      BOOST_CHECK( recorded->block_id == db.head_block_id() );
+      BOOST_CHECK( db.get_block_state_hash( head - 4 ).valid() );
+      BOOST_CHECK( !db.get_block_state_hash( head - 5 ).valid() );
+
+      // popping a block forgets its hash and takes the running hashes back with the undo state
+      const fc::sha256 before_head = db.get_block_state_hash( head - 1 )->state_hash;
+      db.pop_block();
+      BOOST_CHECK( !db.get_block_state_hash( head ).valid() );
+      BOOST_CHECK( db.state_hash() == before_head );
+
+      // the running hashes match hashing every object
+      db.set_incremental_hash( false );
+      BOOST_CHECK( db.state_hash() == before_head );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( fork_blocks )
 {
    try {
@@ -292,35 +1122,63 @@ BOOST_AUTO_TEST_CASE( fork_blocks )
    }
 }
 
-
-/**
- *  These test has been disabled, out of order blocks should result in the node getting disconnected.
- *  
-BOOST_AUTO_TEST_CASE( fork_db_tests )
+BOOST_AUTO_TEST_CASE( open_refuses_state_off_the_block_log )
 {
    try {
-     fork_database fdb;
-     signed_block prev;
-     signed_block skipped_block;
-     for( uint32_t i = 0; i < 2000; ++i )
-     {
-        signed_block b;
-        b.previous = prev.id();
-        if( b.block_num() == 1800 )
-           skipped_block = b;
-        else
-           fdb.push_block( b );
-        prev = b;
-     }
-     auto head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 1799 );
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
 
-     fdb.push_block(skipped_block);
-     head = fdb.head();
-     FC_ASSERT( head && head->data.block_num() == 2001, "", ("head",head->data.block_num()) );
-  } FC_LOG_AND_RETHROW() 
+      // two chains apart from block 1 on, the saved state of each is at its last irreversible block
+      uint32_t saved_head = 0;
+      {
+         database db1;
+         db1.open(data_dir1.path(), make_genesis);
+         database db2;
+         db2.open(data_dir2.path(), make_genesis);
+         uint32_t next_slot = 2;
+         while( db1.get_dynamic_global_properties().last_irreversible_block_num < 5 )
+         {
+            db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+            db2.generate_block(db2.get_slot_time(next_slot), db2.get_scheduled_witness(next_slot), init_account_priv_key, database::skip_nothing);
+            next_slot = 1;
+         }
+         saved_head = db1.get_dynamic_global_properties().last_irreversible_block_num;
+         db1.close();
+         db2.close();
+      }
+
+      // the state of db1 on the blocks of db2
+      const fc::path block_log = fc::path( "database" ) / "block_num_to_block";
+      const fc::path own_log = data_dir1.path() / "own_block_num_to_block";
+      fc::rename( data_dir1.path() / block_log, own_log );
+      fc::create_directories( data_dir1.path() / block_log );
+      for( fc::directory_iterator itr( data_dir2.path() / block_log ); itr != fc::directory_iterator(); ++itr )
+         fc::copy( *itr, data_dir1.path() / block_log / (*itr).filename() );
+      {
+         database db;
+         GRAPHENE_CHECK_THROW( db.open(data_dir1.path(), make_genesis), fc::exception );
+      }
+
+      // or without any blocks
+      fc::remove_all( data_dir1.path() / block_log );
+      {
+         database db;
+         GRAPHENE_CHECK_THROW( db.open(data_dir1.path(), make_genesis), fc::exception );
+      }
+
+      fc::remove_all( data_dir1.path() / block_log );
+      fc::rename( own_log, data_dir1.path() / block_log );
+      database db;
+      db.open(data_dir1.path(), make_genesis);
+      BOOST_CHECK_GE( db.head_block_num(), saved_head );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
 }
-BOOST_AUTO_TEST_CASE( out_of_order_blocks )
+
+BOOST_AUTO_TEST_CASE( fork_beyond_compacted_undo_states )
 {
    try {
       fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
@@ -330,77 +1188,404 @@ BOOST_AUTO_TEST_CASE( out_of_order_blocks )
       db1.open(data_dir1.path(), make_genesis);
       database db2;
       db2.open(data_dir2.path(), make_genesis);
-      BOOST_CHECK( db1.get_chain_id() == db2.get_chain_id() );
 
       auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
-      auto b1 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b2 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b3 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b4 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b5 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b6 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b7 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b8 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b9 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b10 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b11 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      auto b12 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
-      BOOST_CHECK_EQUAL(db1.head_block_num(), 12);
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 0);
-      PUSH_BLOCK( db2, b1 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 1);
-      PUSH_BLOCK( db2, b3 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 1);
-      PUSH_BLOCK( db2, b2 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 3);
-      PUSH_BLOCK( db2, b5 );
-      PUSH_BLOCK( db2, b6 );
-      PUSH_BLOCK( db2, b7 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 3);
-      PUSH_BLOCK( db2, b4 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 7);
-      PUSH_BLOCK( db2, b8 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 8);
-      PUSH_BLOCK( db2, b11 );
-      PUSH_BLOCK( db2, b10 );
-      PUSH_BLOCK( db2, b12 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 8);
-      PUSH_BLOCK( db2, b9 );
-      BOOST_CHECK_EQUAL(db2.head_block_num(), 12);
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db2, b );
+      }
+      // db1 keeps the newest undo state only
+      db1._undo_db.set_compaction_depth( 1 );
+      for( uint32_t i = 10; i < 13; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      BOOST_CHECK_EQUAL( db1._undo_db.undoable_size(), 1 );
+      const block_id_type db1_tip = db1.head_block_id();
+
+      uint32_t next_slot = 3;
+      for( uint32_t i = 10; i < 14; ++i )
+      {
+         auto b = db2.generate_block(db2.get_slot_time(next_slot), db2.get_scheduled_witness(next_slot), init_account_priv_key, database::skip_nothing);
+         next_slot = 1;
+         if( i < 13 )
+            PUSH_BLOCK( db1, b );
+         else
+            // the longer fork would pop three blocks of db1, only one of them can be undone
+            GRAPHENE_CHECK_THROW( PUSH_BLOCK( db1, b ), fc::exception );
+      }
+      BOOST_CHECK( db1.head_block_id() == db1_tip );
+      BOOST_CHECK( db1.fetch_block_by_number( 13 )->id() == db1_tip );
+      db1.pop_block();
+      BOOST_CHECK_EQUAL( db1.head_block_num(), 12 );
+      BOOST_CHECK( !db1.fetch_block_by_number( 13 ).valid() );
+      // the compacted block stays, in the block log as well
+      GRAPHENE_CHECK_THROW( db1.pop_block(), fc::exception );
+      BOOST_CHECK_EQUAL( db1.head_block_num(), 12 );
+      BOOST_CHECK( db1.fetch_block_by_number( 12 ).valid() );
+
+      // db1 goes on on its own chain
+      db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      BOOST_CHECK_EQUAL( db1.head_block_num(), 13 );
    } catch (fc::exception& e) {
       edump((e.to_detail_string()));
       throw;
    }
 }
- */
 
-BOOST_AUTO_TEST_CASE( undo_pending )
+
+BOOST_AUTO_TEST_CASE( prevalidated_block_transactions )
 {
    try {
-      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
-      {
-         database db;
-         db.open(data_dir.path(), make_genesis);
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
 
-         auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
-         public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
-         const graphene::db::index& account_idx = db.get_index(protocol_ids, account_object_type);
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.set_signature_threads( 2 );
+      db2.open(data_dir2.path(), make_genesis);
 
-         transfer_operation t;
-         t.to = account_id_type(1);
-         t.amount = asset( 10000000 );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+
+      auto create_accounts = [&]( const string& prefix ) {
+         for( uint32_t i = 0; i < 4; ++i )
          {
             signed_transaction trx;
-            set_expiration( db, trx );
-
-            trx.operations.push_back(t);
-            PUSH_TX( db, trx, ~0 );
-
-            auto b = db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, ~0);
+            set_expiration( db1, trx );
+            account_create_operation cop;
+            cop.name = prefix + fc::to_string(i);
+            cop.owner = authority(1, init_account_pub_key, 1);
+            cop.active = cop.owner;
+            trx.operations.push_back(cop);
+            PUSH_TX( db1, trx, skip_sigs );
          }
+      };
 
-         signed_transaction trx;
-         set_expiration( db, trx );
+      create_accounts( "nathan" );
+      auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip_sigs);
+      BOOST_CHECK_EQUAL( b.transactions.size(), 4 );
+      PUSH_BLOCK( db2, b, skip_sigs );
+      BOOST_CHECK( db2.head_block_id() == b.id() );
+      BOOST_CHECK_EQUAL( db2.get_index_type<account_index>().indices().get<by_name>().count( "nathan3" ), 1 );
+
+      // a single invalid transaction among valid ones still fails the whole block
+      create_accounts( "alice" );
+      b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip_sigs);
+      signed_block bad_block = b;
+      bad_block.transactions.emplace_back(signed_transaction());
+      bad_block.transactions.back().operations.emplace_back(transfer_operation());
+      bad_block.transaction_merkle_root = bad_block.calculate_merkle_root();
+      bad_block.sign( init_account_priv_key );
+      GRAPHENE_CHECK_THROW(PUSH_BLOCK( db2, bad_block, skip_sigs ), fc::exception);
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 1 );
+      BOOST_CHECK_EQUAL( db2.get_index_type<account_index>().indices().get<by_name>().count( "alice0" ), 0 );
+
+      PUSH_BLOCK( db2, b, skip_sigs );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK_EQUAL( db2.get_index_type<account_index>().indices().get<by_name>().count( "alice3" ), 1 );
+
+      // a block with the header of a prevalidated one, so its id, but other transactions has its merkle root checked
+      create_accounts( "bob" );
+      b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, skip_sigs);
+      BOOST_REQUIRE( db2.prevalidate_block( b, skip_sigs ) );
+      db2.wait_for_prevalidated_blocks();
+      signed_block other_body = b;
+      other_body.transactions.pop_back();
+      BOOST_CHECK( other_body.id() == b.id() );
+      GRAPHENE_CHECK_THROW(PUSH_BLOCK( db2, other_body, skip_sigs ), fc::exception);
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 2 );
+      PUSH_BLOCK( db2, b, skip_sigs );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( prevalidated_sync_blocks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      BOOST_CHECK( !db2.prevalidate_block( signed_block() ) );
+      db2.set_signature_threads( 2 );
+      db2.set_signature_cache_size( 100 );
+      db2.open(data_dir2.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      vector<signed_block> blocks;
+      for( uint32_t i = 0; i < 10; ++i )
+         blocks.push_back( db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+
+      // a block whose merkle root is wrong is not taken for checked
+      signed_block bad_block = blocks.back();
+      bad_block.transaction_merkle_root = checksum_type::hash( string("wrong") );
+      bad_block.sign( init_account_priv_key );
+
+      // sync blocks come in out of order
+      BOOST_CHECK( db2.prevalidate_block( bad_block ) );
+      for( auto itr = blocks.rbegin(); itr != blocks.rend(); ++itr )
+         BOOST_CHECK( db2.prevalidate_block( *itr ) );
+      db2.wait_for_prevalidated_blocks();
+      const uint64_t misses = db2.get_signature_key_cache().misses();
+      const uint64_t hits = db2.get_signature_key_cache().hits();
+
+      for( uint32_t i = 0; i + 1 < blocks.size(); ++i )
+         PUSH_BLOCK( db2, blocks[i] );
+      GRAPHENE_CHECK_THROW( PUSH_BLOCK( db2, bad_block ), fc::exception );
+      PUSH_BLOCK( db2, blocks.back() );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+
+      // every block signee came from the cache, the bad block failed before its signee was checked
+      BOOST_CHECK_EQUAL( db2.get_signature_key_cache().misses(), misses );
+      BOOST_CHECK_EQUAL( db2.get_signature_key_cache().hits(), hits + blocks.size() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( assembled_block_candidate )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      database db;
+      db.open(data_dir.path(), make_genesis);
+
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      auto create_account = [&]( const string& name, uint32_t skip ) {
+         signed_transaction trx;
+         set_expiration( db, trx );
+         account_create_operation cop;
+         cop.name = name;
+         cop.owner = authority(1, init_account_pub_key, 1);
+         cop.active = cop.owner;
+         trx.operations.push_back(cop);
+         PUSH_TX( db, trx, skip );
+      };
+      auto count_accounts = [&]( const string& name ) {
+         return db.get_index_type<account_index>().indices().get<by_name>().count( name );
+      };
+
+      // admitted with fewer checks than the block asks for, so assembling applies them again
+      create_account( "nathan0", skip_sigs | database::skip_tapos_check );
+      create_account( "nathan1", skip_sigs | database::skip_tapos_check );
+      signed_block candidate = db.assemble_block( db.get_slot_time(1), db.get_scheduled_witness(1), skip_sigs );
+      BOOST_CHECK_EQUAL( candidate.transactions.size(), 2 );
+      BOOST_CHECK( candidate.previous == db.head_block_id() );
+      BOOST_CHECK_EQUAL( db.head_block_num(), 0 );
+      BOOST_CHECK( db.get_last_block_assembly().reapplied );
+      BOOST_CHECK_EQUAL( db.get_last_block_assembly().pending, 2 );
+      BOOST_CHECK_EQUAL( db.get_last_block_assembly().included, 2 );
+      BOOST_CHECK_EQUAL( db.get_last_block_assembly().failed, 0 );
+
+      // the pending state is as before, and a transaction arriving now waits for the next block
+      BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().transactions, 2 );
+      BOOST_CHECK_EQUAL( count_accounts( "nathan1" ), 1 );
+      create_account( "alice", skip_sigs );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().transactions, 3 );
+
+      signed_block b = db.sign_and_push_block( candidate, init_account_priv_key, skip_sigs );
+      BOOST_CHECK( db.head_block_id() == b.id() );
+      BOOST_CHECK_EQUAL( b.transactions.size(), 2 );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().transactions, 1 );
+      BOOST_CHECK_EQUAL( count_accounts( "alice" ), 1 );
+
+      // a candidate that no longer builds on the head block is refused
+      signed_block stale = db.assemble_block( db.get_slot_time(1), db.get_scheduled_witness(1), skip_sigs );
+      BOOST_CHECK( !db.get_last_block_assembly().reapplied );
+      BOOST_CHECK_EQUAL( db.get_last_block_assembly().included, 1 );
+      db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, skip_sigs );
+      GRAPHENE_CHECK_THROW( db.sign_and_push_block( stale, init_account_priv_key, skip_sigs ), fc::exception );
+      BOOST_CHECK_EQUAL( db.head_block_num(), 2 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( fork_db_memory_limit )
+{
+   try {
+      fork_database fdb;
+      vector<signed_block> chain;
+      signed_block prev;
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         signed_block b;
+         b.previous = prev.id();
+         fdb.push_block( b );
+         chain.push_back( b );
+         prev = b;
+      }
+      const size_t chain_memory = fdb.memory_used();
+      BOOST_CHECK_EQUAL( chain_memory, 10 * fc::raw::pack_size( chain.back() ) );
+
+      // a fork off the middle of the chain does not move the head
+      signed_block fork1;
+      fork1.previous = chain[4].id();
+      fork1.timestamp = fc::time_point_sec( 1 );
+      fdb.push_block( fork1 );
+      signed_block fork2;
+      fork2.previous = fork1.id();
+      fork2.timestamp = fc::time_point_sec( 1 );
+      fdb.push_block( fork2 );
+      BOOST_CHECK( fdb.head()->id == chain.back().id() );
+      BOOST_CHECK_EQUAL( fdb.memory_used(), chain_memory + fc::raw::pack_size( fork1 ) + fc::raw::pack_size( fork2 ) );
+
+      // a later fork off the head's branch, the forks kept can be walked back to it
+      signed_block fork3;
+      fork3.previous = chain[6].id();
+      fork3.timestamp = fc::time_point_sec( 2 );
+      fdb.push_block( fork3 );
+      auto branches = fdb.fetch_branch_from( fork2.id(), chain.back().id() );
+      BOOST_CHECK_EQUAL( branches.first.size(), 2 );
+      BOOST_CHECK( branches.first.back()->previous_id() == chain[4].id() );
+
+      // the oldest fork goes first and as a whole, its newer block is no use without the older one
+      fdb.set_max_memory( chain_memory + fc::raw::pack_size( fork3 ) );
+      BOOST_CHECK( !fdb.is_known_block( fork1.id() ) );
+      BOOST_CHECK( !fdb.is_known_block( fork2.id() ) );
+      BOOST_REQUIRE( fdb.is_known_block( fork3.id() ) );
+      branches = fdb.fetch_branch_from( fork3.id(), chain.back().id() );
+      BOOST_REQUIRE_EQUAL( branches.first.size(), 1 );
+      BOOST_CHECK( branches.first.back()->previous_id() == chain[6].id() );
+      BOOST_CHECK( branches.second.back()->previous_id() == chain[6].id() );
+      for( const auto& item : branches.second )
+         BOOST_CHECK( fdb.is_known_block( item->id ) );
+
+      // the head's branch stays even when it alone is over the limit
+      fdb.set_max_memory( chain_memory / 2 );
+      BOOST_CHECK( !fdb.is_known_block( fork3.id() ) );
+      BOOST_CHECK_EQUAL( fdb.memory_used(), chain_memory );
+      for( const signed_block& b : chain )
+         BOOST_CHECK( fdb.is_known_block( b.id() ) );
+
+      fdb.pop_block();
+      BOOST_CHECK( fdb.head()->id == chain[8].id() );
+      fdb.remove( chain.back().id() );
+      BOOST_CHECK_EQUAL( fdb.memory_used(), chain_memory - fc::raw::pack_size( chain.back() ) );
+   } FC_LOG_AND_RETHROW()
+}
+
+
+/**
+ *  These test has been disabled, out of order blocks should result in the node getting disconnected.
+ *  
+BOOST_AUTO_TEST_CASE( fork_db_tests )
+{
+   try {
+     fork_database fdb;
+     signed_block prev;
+     signed_block skipped_block;
+     for( uint32_t i = 0; i < 2000; ++i )
+     {
+        signed_block b;
+        b.previous = prev.id();
+        if( b.block_num() == 1800 )
+           skipped_block = b;
+        else
+           fdb.push_block( b );
+        prev = b;
+     }
+     auto head = fdb.head();
+     FC_ASSERT( head && head->data.block_num() == 1799 );
+
+     fdb.push_block(skipped_block);
+     head = fdb.head();
+     FC_ASSERT( head && head->data.block_num() == 2001, "", ("head",head->data.block_num()) );
+  } FC_LOG_AND_RETHROW() 
+}
+BOOST_AUTO_TEST_CASE( out_of_order_blocks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      BOOST_CHECK( db1.get_chain_id() == db2.get_chain_id() );
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto b1 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b2 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b3 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b4 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b5 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b6 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b7 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b8 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b9 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b10 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b11 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      auto b12 = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      BOOST_CHECK_EQUAL(db1.head_block_num(), 12);
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 0);
+      PUSH_BLOCK( db2, b1 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 1);
+      PUSH_BLOCK( db2, b3 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 1);
+      PUSH_BLOCK( db2, b2 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 3);
+      PUSH_BLOCK( db2, b5 );
+      PUSH_BLOCK( db2, b6 );
+      PUSH_BLOCK( db2, b7 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 3);
+      PUSH_BLOCK( db2, b4 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 7);
+      PUSH_BLOCK( db2, b8 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 8);
+      PUSH_BLOCK( db2, b11 );
+      PUSH_BLOCK( db2, b10 );
+      PUSH_BLOCK( db2, b12 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 8);
+      PUSH_BLOCK( db2, b9 );
+      BOOST_CHECK_EQUAL(db2.head_block_num(), 12);
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+ */
+
+BOOST_AUTO_TEST_CASE( undo_pending )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+
+         auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+         public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+         const graphene::db::index& account_idx = db.get_index(protocol_ids, account_object_type);
+
+         transfer_operation t;
+         t.to = account_id_type(1);
+         t.amount = asset( 10000000 );
+         {
+            signed_transaction trx;
+            set_expiration( db, trx );
+
+            trx.operations.push_back(t);
+            PUSH_TX( db, trx, ~0 );
+
+            auto b = db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, ~0);
+         }
+
+         signed_transaction trx;
+         set_expiration( db, trx );
          account_id_type nathan_id = account_idx.get_next_id();
          account_create_operation cop;
          cop.registrar = GRAPHENE_TEMP_ACCOUNT;
@@ -723,83 +1908,1842 @@ BOOST_FIXTURE_TEST_CASE( limit_order_expiration, database_fixture )
    auto* nathan = &create_account("nathan");
    auto* committee = &account_id_type()(db);
 
-   transfer(*committee, *nathan, core->amount(50000));
+   transfer(*committee, *nathan, core->amount(50000));
+
+   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 50000 );
+
+   limit_order_create_operation op;
+   op.seller = nathan->id;
+   op.amount_to_sell = core->amount(500);
+   op.min_to_receive = test->amount(500);
+   op.expiration = db.head_block_time() + fc::seconds(10);
+   trx.operations.push_back(op);
+   auto ptrx = PUSH_TX( db, trx, ~0 );
+
+   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 49500 );
+
+   auto ptrx_id = ptrx.operation_results.back().get<object_id_type>();
+   auto limit_index = db.get_index_type<limit_order_index>().indices();
+   auto limit_itr = limit_index.begin();
+   BOOST_REQUIRE( limit_itr != limit_index.end() );
+   BOOST_REQUIRE( limit_itr->id == ptrx_id );
+   BOOST_REQUIRE( db.find_object(limit_itr->id) );
+   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 49500 );
+   auto id = limit_itr->id;
+
+   generate_blocks(op.expiration, false);
+   test = &get_asset("TEST");
+   core = &asset_id_type()(db);
+   nathan = &get_account("nathan");
+   committee = &account_id_type()(db);
+
+   BOOST_CHECK(db.find_object(id) == nullptr);
+   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 50000 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( double_sign_check, database_fixture )
+{ try {
+   generate_block();
+   const auto& alice = account_id_type()(db);
+   ACTOR(bob);
+   asset amount(1000);
+
+   set_expiration( db, trx );
+   transfer_operation t;
+   t.from = alice.id;
+   t.to = bob.id;
+   t.amount = amount;
+   trx.operations.push_back(t);
+   for( auto& op : trx.operations ) db.current_fee_schedule().set_fee(op);
+   trx.validate();
+
+   db.push_transaction(trx, ~0);
+
+   trx.operations.clear();
+   t.from = bob.id;
+   t.to = alice.id;
+   t.amount = amount;
+   trx.operations.push_back(t);
+   for( auto& op : trx.operations ) db.current_fee_schedule().set_fee(op);
+   trx.validate();
+
+   BOOST_TEST_MESSAGE( "Verify that not-signing causes an exception" );
+   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), fc::exception );
+
+   BOOST_TEST_MESSAGE( "Verify that double-signing causes an exception" );
+   sign( trx, bob_private_key );
+   sign( trx, bob_private_key );
+   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), tx_duplicate_sig );
+
+   BOOST_TEST_MESSAGE( "Verify that signing with an extra, unused key fails" );
+   trx.signatures.pop_back();
+   sign( trx, generate_private_key("bogus" ));
+   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), tx_irrelevant_sig );
+
+   BOOST_TEST_MESSAGE( "Verify that signing once with the proper key passes" );
+   trx.signatures.pop_back();
+   db.push_transaction(trx, 0);
+   sign( trx, bob_private_key );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( transaction_prefetch, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 100000 ) );
+   generate_block();
+
+   // looking ahead further than the block goes only reads what there is
+   db.set_transaction_prefetch_depth( 3 );
+   for( int64_t i = 1; i <= 5; ++i )
+      transfer( alice_id, bob_id, asset( i ) );
+   generate_block();
+   BOOST_CHECK_EQUAL( db.fetch_block_by_number( db.head_block_num() )->transactions.size(), 5 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 15 );
+   db.set_transaction_prefetch_depth( 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( push_transactions_batch, database_fixture )
+{ try {
+   generate_block();
+
+   vector<signed_transaction> trxs;
+   for( const string& name : { "alice", "bob", "alice", "carol" } )
+   {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      account_create_operation op = make_account( name );
+      tx.operations.push_back( op );
+      trxs.push_back( tx );
+   }
+   // the second "alice" differs from the first one only by its expiration
+   trxs[2].expiration += 1;
+
+   uint32_t notifications = 0;
+   auto connection = db.changed_objects.connect( [&]( const vector<object_id_type>& ) { ++notifications; } );
+   uint32_t pending = 0;
+   auto pending_connection = db.on_pending_transaction.connect( [&]( const signed_transaction& ) { ++pending; } );
+
+   vector<transaction_admission> results = db.push_transactions( trxs, ~0 );
+   BOOST_REQUIRE_EQUAL( results.size(), 4 );
+   BOOST_CHECK( results[0].trx.valid() && !results[0].error.valid() );
+   BOOST_CHECK( results[1].trx.valid() );
+   BOOST_CHECK( !results[2].trx.valid() && results[2].error.valid() );
+   BOOST_CHECK( results[3].trx.valid() );
+   BOOST_CHECK_EQUAL( notifications, 1 );
+   BOOST_CHECK_EQUAL( pending, 3 );
+
+   const auto& by_name = db.get_index_type<account_index>().indices().get<by_name>();
+   BOOST_CHECK_EQUAL( by_name.count( "alice" ), 1 );
+   BOOST_CHECK_EQUAL( by_name.count( "carol" ), 1 );
+
+   // the accepted transactions go into the next block like any other pending transaction
+   auto b = generate_block();
+   BOOST_CHECK_EQUAL( b.transactions.size(), 3 );
+   BOOST_CHECK_EQUAL( by_name.count( "bob" ), 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( generate_block_from_pending_state, database_fixture )
+{ try {
+   generate_block();
+
+   auto push_account = [&]( const string& name, uint32_t skip ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      tx.operations.push_back( make_account( name ) );
+      PUSH_TX( db, tx, skip );
+   };
+
+   // admitted with the same checks the block makes, the pending transactions are taken as they are
+   push_account( "alice", ~0 );
+   push_account( "bob", ~0 );
+   auto b = generate_block();
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), 2 );
+   BOOST_CHECK_EQUAL( b.transactions[0].operations[0].get<account_create_operation>().name, "alice" );
+   BOOST_CHECK_EQUAL( b.transactions[1].operations[0].get<account_create_operation>().name, "bob" );
+   BOOST_CHECK( db.get_dynamic_global_properties().head_block_id == b.id() );
+
+   // a transaction that skipped signature checks when it was pushed is checked again and left out
+   push_account( "carol", ~0 );
+   b = generate_block( ~0 & ~(database::skip_transaction_signatures | database::skip_authority_check) );
+   BOOST_CHECK_EQUAL( b.transactions.size(), 0 );
+   BOOST_CHECK_EQUAL( db.get_index_type<account_index>().indices().get<by_name>().count( "carol" ), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( pending_pool_limits, database_fixture )
+{ try {
+   generate_block();
+   ACTOR(bob);
+   generate_block();
+
+   auto make_transfer = [&]( share_type amount, share_type extra_fee ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      transfer_operation t;
+      t.from = account_id_type();
+      t.to = bob_id;
+      t.amount = asset( amount );
+      db.current_fee_schedule().set_fee( t );
+      t.fee.amount += extra_fee;
+      tx.operations.push_back( t );
+      return tx;
+   };
+
+   // a full pool refuses transactions until a block takes some of them
+   db.set_max_pending_transactions( 2 );
+   PUSH_TX( db, make_transfer( 1, 0 ), ~0 );
+   PUSH_TX( db, make_transfer( 2, 0 ), ~0 );
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( 3, 0 ), ~0 ), pending_pool_full );
+   pending_pool_statistics stats = db.get_pending_pool_statistics();
+   BOOST_CHECK_EQUAL( stats.transactions, 2 );
+   BOOST_CHECK_EQUAL( stats.capacity, 2 );
+   BOOST_CHECK_EQUAL( stats.rejected, 1 );
+   BOOST_CHECK( stats.size > 0 );
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().transactions, 0 );
+   db.set_max_pending_transactions( 0 );
+
+   // with room for only one of them, the transaction paying more per byte goes first
+   signed_transaction cheap = make_transfer( 10, 0 );
+   signed_transaction generous = make_transfer( 20, 1000 );
+   const size_t header_size = fc::raw::pack_size( signed_block_header() ) + 4;
+   db.modify( db.get_global_properties(), [&]( global_property_object& p ) {
+      p.parameters.maximum_block_size = header_size + fc::raw::pack_size( processed_transaction( generous ) ) * 3 / 2;
+   } );
+   PUSH_TX( db, cheap, ~0 );
+   PUSH_TX( db, generous, ~0 );
+   auto b = generate_block();
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), 1 );
+   BOOST_CHECK( b.transactions[0].id() == generous.id() );
+   BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().postponed, 1 );
+
+   // the other one stays pending for the next block
+   b = generate_block();
+   BOOST_REQUIRE_EQUAL( b.transactions.size(), 1 );
+   BOOST_CHECK( b.transactions[0].id() == cheap.id() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( transaction_bodies_from_block_log, database_fixture )
+{ try {
+   db.set_keep_transaction_bodies( false );
+   generate_block();
+
+   signed_transaction tx;
+   set_expiration( db, tx );
+   tx.operations.push_back( make_account( "alice" ) );
+   PUSH_TX( db, tx, ~0 );
+
+   const auto& by_trx_id = db.get_index_type<transaction_index>().indices().get<by_trx_id>();
+   // a pending transaction keeps its body, it is not in any block yet
+   BOOST_REQUIRE( by_trx_id.find( tx.id() ) != by_trx_id.end() );
+   BOOST_CHECK( by_trx_id.find( tx.id() )->trx.valid() );
+
+   auto b = generate_block();
+   auto itr = by_trx_id.find( tx.id() );
+   BOOST_REQUIRE( itr != by_trx_id.end() );
+   BOOST_CHECK( !itr->trx.valid() );
+   BOOST_CHECK_EQUAL( itr->block_num, b.block_num() );
+   BOOST_CHECK_EQUAL( itr->trx_in_block, 0 );
+   BOOST_CHECK( itr->expiration == tx.expiration );
+   BOOST_CHECK( db.get_recent_transaction( tx.id() ).id() == tx.id() );
+   // it is still rejected as a duplicate
+   GRAPHENE_REQUIRE_THROW( PUSH_TX( db, tx, database::skip_transaction_signatures | database::skip_authority_check ),
+                           fc::exception );
+
+   // the entry goes away once the transaction has expired
+   generate_blocks( tx.expiration + db.get_global_properties().parameters.block_interval );
+   BOOST_CHECK( by_trx_id.find( tx.id() ) == by_trx_id.end() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( vote_tally_on_signature_threads, database_fixture )
+{ try {
+   db.set_signature_threads( 3 );
+   generate_block();
+
+   const auto& active_witnesses = db.get_global_properties().active_witnesses;
+   witness_id_type all_voted = *active_witnesses.begin();
+   witness_id_type odd_voted = *active_witnesses.rbegin();
+
+   // voter i holds 1000 * (i+1), the last one lets voter 0 vote for it
+   const uint32_t voter_count = 12;
+   vector<account_id_type> voters;
+   uint64_t all_votes = 0, odd_votes = 0;
+   for( uint32_t i = 0; i < voter_count; ++i )
+   {
+      voters.push_back( create_account( "voter" + fc::to_string(i) ).id );
+      transfer( committee_account, voters.back(), asset( 1000 * (i+1) ) );
+      all_votes += 1000 * (i+1);
+
+      account_update_operation op;
+      op.account = voters.back();
+      op.new_options = voters.back()(db).options;
+      if( i + 1 == voter_count )
+         op.new_options->voting_account = voters.front();
+      else
+      {
+         op.new_options->votes.insert( all_voted(db).vote_id );
+         if( i % 2 == 1 )
+         {
+            op.new_options->votes.insert( odd_voted(db).vote_id );
+            odd_votes += 1000 * (i+1);
+         }
+         op.new_options->num_witness = op.new_options->votes.size();
+      }
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( all_voted(db).total_votes, all_votes );
+   BOOST_CHECK_EQUAL( odd_voted(db).total_votes, odd_votes );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( vote_ledger_matches_recount, database_fixture )
+{ try {
+   db.set_vote_tally_check( true );
+   generate_block();
+
+   const auto& active_witnesses = db.get_global_properties().active_witnesses;
+   witness_id_type first = *active_witnesses.begin();
+   witness_id_type last = *active_witnesses.rbegin();
+
+   auto set_options = [&]( account_id_type voter, account_id_type proxy, const flat_set<vote_id_type>& votes ) {
+      account_update_operation op;
+      op.account = voter;
+      op.new_options = voter(db).options;
+      op.new_options->voting_account = proxy;
+      op.new_options->votes = votes;
+      op.new_options->num_witness = votes.size();
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   };
+
+   account_id_type alice = create_account( "alice" ).id;
+   account_id_type bob = create_account( "bob" ).id;
+   account_id_type carol = create_account( "carol" ).id;
+   transfer( committee_account, alice, asset( 1000 ) );
+   transfer( committee_account, bob, asset( 2000 ) );
+   transfer( committee_account, carol, asset( 4000 ) );
+   set_options( alice, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { first(db).vote_id } );
+   set_options( bob, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { first(db).vote_id, last(db).vote_id } );
+   set_options( carol, alice, {} );
+
+   // the first maintenance fills the ledger from a full count
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( first(db).total_votes, 7000 );
+   BOOST_CHECK_EQUAL( last(db).total_votes, 2000 );
+
+   // stake, proxy and opinion changes are picked up by the next one
+   transfer( committee_account, alice, asset( 500 ) );
+   transfer( bob, carol, asset( 1000 ) );
+   set_options( alice, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { last(db).vote_id } );
+   set_options( bob, alice, {} );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( first(db).total_votes, 0 );
+   BOOST_CHECK_EQUAL( last(db).total_votes, 7500 );
+
+   // proxies are not followed further, carol keeps voting with alice's now empty opinion
+   set_options( alice, bob, {} );
+   set_options( bob, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { first(db).vote_id } );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( first(db).total_votes, 2500 );
+   BOOST_CHECK_EQUAL( last(db).total_votes, 0 );
+
+   BOOST_CHECK_EQUAL( db.get_vote_tally_mismatches(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( vote_ledger_precount, database_fixture )
+{ try {
+   db.set_vote_tally_check( true );
+   // every block of the interval counts its changes ahead of the maintenance block
+   db.set_maintenance_precount_blocks( db.get_global_properties().parameters.maintenance_interval );
+   generate_block();
+
+   witness_id_type first = *db.get_global_properties().active_witnesses.begin();
+   account_id_type alice = create_account( "alice" ).id;
+   transfer( committee_account, alice, asset( 1000 ) );
+   account_update_operation op;
+   op.account = alice;
+   op.new_options = alice(db).options;
+   op.new_options->votes = { first(db).vote_id };
+   op.new_options->num_witness = 1;
+   trx.operations.push_back( op );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+
+   // the first maintenance fills the ledger from a full count
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( first(db).total_votes, 1000 );
+
+   // alice is counted by the precount of this block and again after her second change
+   transfer( committee_account, alice, asset( 500 ) );
+   generate_block();
+   transfer( committee_account, alice, asset( 250 ) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( first(db).total_votes, 1750 );
+
+   BOOST_CHECK_EQUAL( db.get_vote_tally_mismatches(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( active_witnesses_follow_vote_order, database_fixture )
+{ try {
+   generate_block();
+
+   witness_id_type favourite = *db.get_global_properties().active_witnesses.rbegin();
+   account_id_type voter = create_account( "voter" ).id;
+   transfer( committee_account, voter, asset( 10000 ) );
+
+   account_update_operation op;
+   op.account = voter;
+   op.new_options = voter(db).options;
+   op.new_options->votes.insert( favourite(db).vote_id );
+   op.new_options->num_witness = 1;
+   trx.operations.push_back( op );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+
+   const auto& by_vote = db.get_index_type<witness_index>().indices().get<by_votes>();
+   BOOST_CHECK( by_vote.begin()->id == favourite );
+   BOOST_CHECK_EQUAL( by_vote.begin()->total_votes, 10000 );
+
+   // the active witnesses are the front of the index
+   const auto& active_witnesses = db.get_global_properties().active_witnesses;
+   auto itr = by_vote.begin();
+   for( size_t i = 0; i < active_witnesses.size(); ++i, ++itr )
+      BOOST_CHECK( active_witnesses.count( itr->id ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( operation_statistics_by_type, database_fixture )
+{ try {
+   ACTOR( alice );
+   BOOST_CHECK( db.get_operation_statistics().empty() );
+
+   db.set_operation_statistics( true );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+
+   const auto stats = db.get_operation_statistics();
+   BOOST_REQUIRE( stats.count( "transfer_operation" ) );
+   const operation_statistics& transfers = stats.at( "transfer_operation" );
+   // pushed, then applied again for the block
+   BOOST_CHECK( transfers.count >= 4 );
+   BOOST_CHECK( transfers.max_evaluate_time <= transfers.evaluate_time );
+   BOOST_CHECK( transfers.fee_time <= transfers.evaluate_time + transfers.apply_time );
+   // the first transfer creates alice's balance object, each one pays the fee from the committee statistics
+   BOOST_CHECK( transfers.objects_created >= 1 );
+   BOOST_CHECK( transfers.objects_modified >= transfers.count );
+   BOOST_CHECK( !stats.count( "account_create_operation" ) );
+
+   db.set_operation_statistics( false );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   BOOST_CHECK( db.get_operation_statistics().empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( block_timing_histograms, database_fixture )
+{ try {
+   generate_block();
+   const uint64_t blocks_before = db.get_block_timing_statistics().total.count;
+
+   // every block is slower than a microsecond
+   db.set_slow_block_threshold( fc::microseconds( 1 ) );
+   generate_blocks( 3 );
+   const block_timing_statistics& stats = db.get_block_timing_statistics();
+   BOOST_CHECK_EQUAL( stats.total.count, blocks_before + 3 );
+   BOOST_CHECK_EQUAL( stats.handlers.count, stats.total.count );
+   BOOST_CHECK_EQUAL( stats.slow_blocks, 3 );
+   BOOST_CHECK_EQUAL( stats.last_slow_block.block_num, db.head_block_num() );
+
+   uint64_t bucketed = 0;
+   for( uint64_t n : stats.total.buckets )
+      bucketed += n;
+   BOOST_CHECK_EQUAL( bucketed, stats.total.count );
+
+   const block_timing& last = db.get_last_block_timing();
+   BOOST_CHECK_EQUAL( last.block_num, db.head_block_num() );
+   BOOST_CHECK( last.header + last.apply_transactions + last.chain_updates + last.handlers <= last.total );
+
+   db.set_slow_block_threshold( fc::microseconds( 0 ) );
+   generate_block();
+   BOOST_CHECK_EQUAL( db.get_block_timing_statistics().slow_blocks, 3 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( applied_block_queue_waits_for_irreversibility, database_fixture )
+{ try {
+   vector<uint32_t> handled;
+   graphene::app::applied_block_queue queue( "test_queue",
+      [&handled]( const graphene::app::applied_block_queue::applied_block_data& data ) {
+         handled.push_back( data.block.block_num() );
+      }, 2 );
+   queue.connect( db );
+
+   const uint32_t first = db.head_block_num() + 1;
+   generate_blocks( 30 );
+   queue.flush();
+   BOOST_CHECK_EQUAL( queue.queued_blocks(), 0 );
+
+   const uint32_t irreversible = db.get_dynamic_global_properties().last_irreversible_block_num;
+   BOOST_REQUIRE( irreversible >= first );
+   BOOST_REQUIRE_EQUAL( handled.size(), irreversible - first + 1 );
+   for( uint32_t i = 0; i < handled.size(); ++i )
+      BOOST_CHECK_EQUAL( handled[i], first + i );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( market_history_rolls_up_buckets, database_fixture )
+{
+   try {
+      using graphene::market_history::bucket_object;
+      ACTORS( (seller)(buyer) );
+      const asset_id_type test_id = create_user_issued_asset( "ROLLUP" ).id;
+      issue_uia( seller, asset( 100000, test_id ) );
+      transfer( account_id_type(), buyer_id, asset( 100000 ) );
+      generate_block();
+
+      // a trade at a different price in every block, over several buckets of both sizes
+      for( uint32_t i = 0; i < 30; ++i )
+      {
+         create_sell_order( seller_id, asset( 10 + i % 7, test_id ), asset( 10 ) );
+         create_sell_order( buyer_id, asset( 10 ), asset( 10 + i % 7, test_id ) );
+         generate_block();
+      }
+
+      graphene::app::history_api hist( app );
+      const vector<bucket_object> small = hist.get_market_history( asset_id_type(), test_id, 15,
+                                                                   fc::time_point_sec(), db.head_block_time() );
+      const vector<bucket_object> rolled = hist.get_market_history( asset_id_type(), test_id, 60,
+                                                                    fc::time_point_sec(), db.head_block_time() );
+      BOOST_REQUIRE( small.size() > 4 );
+      BOOST_REQUIRE( rolled.size() > 1 );
+
+      // every rolled up bucket, the one still open included, holds exactly the trades of its small buckets
+      auto next = small.begin();
+      for( const bucket_object& r : rolled )
+      {
+         BOOST_REQUIRE( next != small.end() );
+         BOOST_CHECK( r.key.open.sec_since_epoch() % 60 == 0 );
+         bucket_object expected = *next;
+         ++next;
+         while( next != small.end() && next->key.open < r.key.open + 60 )
+         {
+            graphene::market_history::merge_bucket( expected, *next );
+            ++next;
+         }
+         BOOST_CHECK( r.base_volume == expected.base_volume );
+         BOOST_CHECK( r.quote_volume == expected.quote_volume );
+         BOOST_CHECK( r.open_base == expected.open_base && r.open_quote == expected.open_quote );
+         BOOST_CHECK( r.close_base == expected.close_base && r.close_quote == expected.close_quote );
+         BOOST_CHECK( r.high() == expected.high() );
+         BOOST_CHECK( r.low() == expected.low() );
+      }
+      BOOST_CHECK( next == small.end() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( applied_operation_log_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   typedef graphene::app::applied_operation_log::operation_list operation_list;
+
+   auto make_operations = []( uint32_t block_num ) {
+      operation_list ops( 2 );
+      ops[0] = operation_history_object();
+      ops[0]->block_num = block_num;
+      ops[0]->op = transfer_operation();
+      return ops;
+   };
+
+   graphene::app::applied_operation_log log;
+   log.open( data_dir.path(), 2 );
+   BOOST_CHECK_EQUAL( log.last_block_num(), 0u );
+   for( uint32_t block_num : { 1, 2, 3, 6 } )
+      log.append( block_num, make_operations( block_num ) );
+   // appending a block that is already stored leaves it alone
+   log.append( 2, operation_list() );
+   BOOST_CHECK_EQUAL( log.last_block_num(), 6u );
+   BOOST_CHECK( fc::exists( data_dir.path() / "ops.000003" ) );
+
+   // the layout of an existing log wins over the requested one
+   log.close();
+   log.open( data_dir.path(), 100 );
+   BOOST_CHECK_EQUAL( log.last_block_num(), 6u );
+   for( uint32_t block_num : { 1, 2, 3, 6 } )
+   {
+      auto ops = log.fetch( block_num );
+      BOOST_REQUIRE( ops.valid() );
+      BOOST_REQUIRE_EQUAL( ops->size(), 2u );
+      BOOST_CHECK_EQUAL( (*ops)[0]->block_num, block_num );
+      BOOST_CHECK( !(*ops)[1].valid() );
+   }
+   BOOST_CHECK( !log.fetch( 0 ).valid() );
+   BOOST_CHECK( !log.fetch( 4 ).valid() );
+   BOOST_CHECK( !log.fetch( 7 ).valid() );
+   log.close();
+
+   // an entry whose operations did not reach the segment is dropped on open, with the skipped ones before it
+   const fc::path segment = data_dir.path() / "ops.000003";
+   fc::resize_file( segment, fc::file_size( segment ) - 1 );
+   log.open( data_dir.path() );
+   BOOST_CHECK_EQUAL( log.last_block_num(), 3u );
+   BOOST_CHECK( !log.fetch( 6 ).valid() );
+   BOOST_CHECK( log.fetch( 3 ).valid() );
+   log.append( 6, make_operations( 6 ) );
+   BOOST_CHECK_EQUAL( log.last_block_num(), 6u );
+   BOOST_REQUIRE( log.fetch( 6 ).valid() );
+   BOOST_CHECK_EQUAL( (*log.fetch( 6 ))[0]->block_num, 6u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( subscription_hub_matches_sessions, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   generate_block();
+
+   auto hub = graphene::app::subscription_hub::get( db );
+   BOOST_CHECK( hub == graphene::app::subscription_hub::get( db ) );
+
+   vector<fc::variant> alice_updates, bob_updates;
+   auto alice_session = hub->add_session( [&]( const vector<fc::variant>& u, const vector<uint64_t>& sizes ) {
+      BOOST_CHECK_EQUAL( u.size(), sizes.size() );
+      alice_updates.insert( alice_updates.end(), u.begin(), u.end() );
+   });
+   auto bob_session = hub->add_session( [&]( const vector<fc::variant>& u, const vector<uint64_t>& ) {
+      bob_updates.insert( bob_updates.end(), u.begin(), u.end() );
+   });
+   hub->subscribe( alice_session, alice_id );
+   hub->subscribe( bob_session, bob_id );
+   BOOST_CHECK( hub->is_subscribed( alice_session, alice_id ) );
+   BOOST_CHECK( !hub->is_subscribed( alice_session, bob_id ) );
+   BOOST_CHECK_EQUAL( hub->subscribed_objects(), 2 );
+
+   // the balance of alice is owned by her account, so it matches her subscription
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   const auto& balance = *db.get_index_type<account_balance_index>().indices().get<by_account_asset>()
+                            .find( boost::make_tuple( alice_id, asset_id_type() ) );
+   BOOST_CHECK( std::any_of( alice_updates.begin(), alice_updates.end(), [&]( const fc::variant& v ) {
+      return v.is_object() && v.get_object()["id"].as<object_id_type>() == balance.id;
+   }));
+   BOOST_CHECK( bob_updates.empty() );
+
+   alice_updates.clear();
+   hub->clear_subscriptions( alice_session );
+   BOOST_CHECK_EQUAL( hub->subscribed_objects(), 1 );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   BOOST_CHECK( alice_updates.empty() );
+
+   // both sessions are handed the same variant of a pending transaction, with its size
+   vector<fc::variant> alice_trxs, bob_trxs;
+   hub->set_pending_transaction_callback( alice_session, [&]( const fc::variant& trx, uint64_t size ) {
+      BOOST_CHECK_EQUAL( size, graphene::app::send_queue::estimated_size( trx ) );
+      alice_trxs.push_back( trx );
+   });
+   hub->set_pending_transaction_callback( bob_session, [&]( const fc::variant& trx, uint64_t ) {
+      bob_trxs.push_back( trx );
+   });
+   transfer( committee_account, bob_id, asset( 1000 ) );
+   BOOST_REQUIRE_EQUAL( alice_trxs.size(), 1 );
+   BOOST_REQUIRE_EQUAL( bob_trxs.size(), 1 );
+   BOOST_CHECK( &alice_trxs[0].get_object()["operations"].get_array() ==
+                &bob_trxs[0].get_object()["operations"].get_array() );
+   hub->set_pending_transaction_callback( bob_session, graphene::app::subscription_hub::transaction_callback_type() );
+   transfer( committee_account, bob_id, asset( 1000 ) );
+   BOOST_CHECK_EQUAL( alice_trxs.size(), 2 );
+   BOOST_CHECK_EQUAL( bob_trxs.size(), 1 );
+
+   hub->remove_session( alice_session );
+   hub->remove_session( bob_session );
+   BOOST_CHECK_EQUAL( hub->session_count(), 0 );
+   BOOST_CHECK_EQUAL( hub->subscribed_objects(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( subscribe_to_balances_follows_accounts, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol) );
+   const asset_id_type uia = create_user_issued_asset( "BALS" ).id;
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+
+   graphene::app::database_api api( db );
+   vector<graphene::app::account_balances> updates;
+   api.subscribe_to_balances( [&]( const fc::variant& v ) {
+      auto balances = v.as<vector<graphene::app::account_balances>>();
+      updates.insert( updates.end(), balances.begin(), balances.end() );
+   }, { alice_id, bob_id }, { asset_id_type() } );
+
+   // only the followed accounts and assets are sent, with their new amounts
+   transfer( alice_id, bob_id, asset( 300 ) );
+   transfer( committee_account, carol_id, asset( 100 ) );
+   issue_uia( alice_id, asset( 30, uia ) );
+   fc::usleep( fc::milliseconds(10) );
+   const auto amount_of = [&]( account_id_type account ) {
+      optional<asset> last;
+      for( const auto& u : updates )
+         if( u.account == account )
+            for( const asset& a : u.balances )
+            {
+               BOOST_CHECK( a.asset_id == asset_id_type() );
+               last = a;
+            }
+      return last;
+   };
+   BOOST_REQUIRE( amount_of( alice_id ).valid() );
+   BOOST_CHECK( *amount_of( alice_id ) == asset( get_balance( alice_id, asset_id_type() ) ) );
+   BOOST_REQUIRE( amount_of( bob_id ).valid() );
+   BOOST_CHECK( *amount_of( bob_id ) == asset( 300 ) );
+   BOOST_CHECK( !amount_of( carol_id ).valid() );
+
+   // the balances changed by a block come again once it is applied
+   updates.clear();
+   generate_block();
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_REQUIRE( amount_of( bob_id ).valid() );
+   BOOST_CHECK( *amount_of( bob_id ) == asset( 300 ) );
+
+   api.unsubscribe_from_balances();
+   updates.clear();
+   transfer( alice_id, bob_id, asset( 100 ) );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK( updates.empty() );
+
+   // a new subscription replaces the old one, and cancel_all_subscriptions ends it
+   api.subscribe_to_balances( [&]( const fc::variant& v ) {
+      auto balances = v.as<vector<graphene::app::account_balances>>();
+      updates.insert( updates.end(), balances.begin(), balances.end() );
+   }, { carol_id }, {} );
+   transfer( alice_id, bob_id, asset( 100 ) );
+   transfer( committee_account, carol_id, asset( 100 ) );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK( !amount_of( bob_id ).valid() );
+   BOOST_REQUIRE( amount_of( carol_id ).valid() );
+   BOOST_CHECK( *amount_of( carol_id ) == asset( 200 ) );
+   api.cancel_all_subscriptions();
+   updates.clear();
+   transfer( committee_account, carol_id, asset( 100 ) );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK( updates.empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( subscription_filters_account_memory )
+{ try {
+   using graphene::app::subscription_hub;
+   database db;
+   subscription_hub hub( db );
+   auto exact = hub.add_session( subscription_hub::callback_type() );
+   auto bloom = hub.add_session( subscription_hub::callback_type() );
+   hub.set_filter( bloom, graphene::app::bloom_subscription_filter );
+
+   // more objects than the first bloom layer holds
+   const uint32_t count = subscription_hub::bloom_layer_capacity * 3;
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      hub.subscribe( exact, account_id_type( i ) );
+      hub.subscribe( bloom, account_id_type( i ) );
+   }
+   hub.subscribe( exact, account_id_type( 0 ) );
+   BOOST_CHECK_EQUAL( hub.subscribed_objects(), count );
+
+   uint32_t false_positives = 0;
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      BOOST_CHECK( hub.is_subscribed( exact, account_id_type( i ) ) );
+      BOOST_CHECK( hub.is_subscribed( bloom, account_id_type( i ) ) );
+      BOOST_CHECK( !hub.is_subscribed( exact, account_id_type( count + i ) ) );
+      false_positives += hub.is_subscribed( bloom, account_id_type( count + i ) );
+   }
+   BOOST_CHECK_LE( false_positives, 2 );
+
+   const uint64_t exact_memory = hub.session_memory( exact );
+   const uint64_t bloom_memory = hub.session_memory( bloom );
+   BOOST_CHECK_GT( exact_memory, 0 );
+   BOOST_CHECK_GT( bloom_memory, 0 );
+   BOOST_CHECK_LT( bloom_memory, exact_memory );
+   BOOST_CHECK_EQUAL( hub.memory(), exact_memory + bloom_memory );
+
+   hub.set_filter( bloom, graphene::app::exact_subscription_filter );
+   BOOST_CHECK_EQUAL( hub.session_memory( bloom ), 0 );
+   BOOST_CHECK( !hub.is_subscribed( bloom, account_id_type( 1 ) ) );
+   hub.remove_session( exact );
+   BOOST_CHECK_EQUAL( hub.memory(), 0 );
+   BOOST_CHECK_EQUAL( hub.subscribed_objects(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( api_reader_pool_reads_between_blocks, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+
+   auto readers = std::make_shared<graphene::app::api_reader_pool>( db, 2 );
+   BOOST_CHECK_EQUAL( readers->thread_count(), 2 );
+   BOOST_CHECK_EQUAL( readers->run( [&]() { return db.head_block_num(); } ), db.head_block_num() );
+   BOOST_CHECK_THROW( readers->run( [&]() -> uint32_t { FC_ASSERT( false ); } ), fc::exception );
+
+   graphene::app::database_api api( db, nullptr, readers );
+   for( int i = 0; i < 3; ++i )
+   {
+      const auto accounts = api.lookup_accounts( "alice", 1 );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 1 );
+      BOOST_CHECK( accounts.at( "alice" ) == alice_id );
+      BOOST_CHECK_EQUAL( api.get_account_balances( alice_id, flat_set<asset_id_type>() ).size(), 1 );
+      const auto packed = api.get_packed_objects( { alice_id, account_id_type( 1000000 ) } );
+      BOOST_REQUIRE_EQUAL( packed.size(), 2 );
+      BOOST_CHECK( *packed[0] == alice_id(db).pack() );
+      BOOST_CHECK( !packed[1].valid() );
+      const auto blocks = api.get_packed_blocks( db.head_block_num(), 2 );
+      BOOST_CHECK( *blocks[0] == fc::raw::pack( *db.fetch_block_by_number( db.head_block_num() ) ) );
+      BOOST_CHECK( !blocks[1].valid() );
+      generate_block();
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( api_reader_pool_quotas, database_fixture )
+{ try {
+   using graphene::app::api_reader_pool;
+   BOOST_CHECK( api_reader_pool::classify( "get_full_accounts" ) == api_reader_pool::heavy_call );
+   BOOST_CHECK( api_reader_pool::classify( "get_objects" ) == api_reader_pool::light_call );
+
+   api_reader_pool readers( db, 1 );
+   api_reader_pool::limits limits;
+   limits.client_cpu_ms = 5;
+   readers.set_limits( limits );
+
+   // a call running past the quota of its client refuses the next ones of that client only
+   api_reader_pool::client greedy, other;
+   BOOST_CHECK_EQUAL( readers.run( greedy, "get_objects", [&]() { fc::usleep( fc::milliseconds( 50 ) ); return 1; } ), 1 );
+   BOOST_CHECK_EQUAL( greedy.calls_running(), 0 );
+   BOOST_CHECK_THROW( readers.run( greedy, "get_objects", []() { return 1; } ), fc::exception );
+   BOOST_CHECK_EQUAL( readers.run( other, "get_objects", []() { return 2; } ), 2 );
+
+   // the calls of a batch run on the calling thread
+   {
+      api_reader_pool::inline_scope batch;
+      const fc::thread* caller = &fc::thread::current();
+      BOOST_CHECK( readers.run( other, "get_full_accounts", []() { return &fc::thread::current(); } ) == caller );
+
+      // while a call of the batch yields, another task of the thread, such as the next connection's, takes its turn
+      fc::future<const fc::thread*> elsewhere = fc::async( [&]() {
+         BOOST_CHECK( !api_reader_pool::inline_scope::active() );
+         return readers.run( other, "get_objects", []() { return &fc::thread::current(); } );
+      }, "other_connection" );
+      BOOST_CHECK( elsewhere.wait() != caller );
+      BOOST_CHECK( api_reader_pool::inline_scope::active() );
+   }
+   BOOST_CHECK( readers.run( other, "get_objects", []() { return &fc::thread::current(); } ) != &fc::thread::current() );
+
+   // a batch takes one turn, its calls run on one reader thread rather than on the one applying blocks
+   const fc::thread* batch_thread = nullptr;
+   readers.run_batch( other, api_reader_pool::heavy_call, [&]() {
+      batch_thread = &fc::thread::current();
+      BOOST_CHECK_EQUAL( other.calls_running(), 1 );
+      BOOST_CHECK( readers.run( other, "get_full_accounts", []() { return &fc::thread::current(); } ) == batch_thread );
+      BOOST_CHECK( readers.run( other, "get_objects", []() { return &fc::thread::current(); } ) == batch_thread );
+   } );
+   BOOST_CHECK( batch_thread != nullptr );
+   BOOST_CHECK( batch_thread != &fc::thread::current() );
+   BOOST_CHECK_EQUAL( other.calls_running(), 0 );
+   // and is refused as a whole once its client used up its time
+   BOOST_CHECK_THROW( readers.run_batch( greedy, api_reader_pool::light_call, []() {} ), fc::exception );
+   BOOST_CHECK_EQUAL( readers.calls_running(), 0 );
+   BOOST_CHECK_EQUAL( readers.calls_waiting(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( stream_blocks_follows_head, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   generate_blocks( 5 );
+
+   vector<graphene::app::streamed_block> received;
+   auto api = std::make_shared<graphene::app::database_api>( db );
+   api->stream_blocks( [&]( const fc::variant& v ) {
+      auto batch = v.as< vector<graphene::app::streamed_block> >();
+      received.insert( received.end(), batch.begin(), batch.end() );
+   }, 1, 0, true );
+
+   const uint32_t head = db.head_block_num();
+   for( int i = 0; i < 100 && received.size() < head; ++i )
+      fc::usleep( fc::milliseconds(1) );
+   BOOST_REQUIRE_EQUAL( received.size(), head );
+   for( uint32_t i = 0; i < head; ++i )
+   {
+      BOOST_CHECK_EQUAL( received[i].block_num, i + 1 );
+      BOOST_CHECK( received[i].block.id() == db.fetch_block_by_number( i + 1 )->id() );
+   }
+
+   // applied blocks follow with their operations
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+   for( int i = 0; i < 100 && received.size() == head; ++i )
+      fc::usleep( fc::milliseconds(1) );
+   BOOST_REQUIRE_EQUAL( received.size(), head + 1 );
+   BOOST_CHECK_EQUAL( received.back().block_num, head + 1 );
+   BOOST_CHECK( std::any_of( received.back().applied_operations.begin(), received.back().applied_operations.end(),
+                             []( const operation_history_object& o ) { return o.op.which() == operation::tag<transfer_operation>::value; } ) );
+
+   api->cancel_block_stream();
+   generate_block();
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK_EQUAL( received.size(), head + 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( batched_order_books_and_tickers, database_fixture )
+{ try {
+   using graphene::app::order_book;
+   using graphene::app::market_ticker;
+   ACTORS( (seller)(buyer) );
+   const asset_id_type first_id = create_user_issued_asset( "FIRSTUIA" ).id;
+   const asset_id_type second_id = create_user_issued_asset( "SECONDUIA" ).id;
+   issue_uia( seller, asset( 100000, first_id ) );
+   issue_uia( seller, asset( 100000, second_id ) );
+   transfer( account_id_type(), buyer_id, asset( 100000 ) );
+   create_sell_order( seller_id, asset( 100, first_id ), asset( 200 ) );
+   create_sell_order( seller_id, asset( 300, second_id ), asset( 100 ) );
+   create_sell_order( buyer_id, asset( 50 ), asset( 200, second_id ) );
+   // a trade in the first market, for its ticker
+   create_sell_order( seller_id, asset( 10, first_id ), asset( 10 ) );
+   create_sell_order( buyer_id, asset( 10 ), asset( 10, first_id ) );
+   generate_block();
+
+   graphene::app::database_api api( db );
+   const vector<std::pair<string,string>> markets = {
+      { GRAPHENE_SYMBOL, "FIRSTUIA" }, { "SECONDUIA", GRAPHENE_SYMBOL }, { GRAPHENE_SYMBOL, "FIRSTUIA" } };
+
+   // one result per market in the order asked, the same as asking for each on its own
+   const vector<order_book> books = api.get_order_books( markets, 10 );
+   BOOST_REQUIRE_EQUAL( books.size(), markets.size() );
+   for( size_t i = 0; i < markets.size(); ++i )
+   {
+      const order_book single = api.get_order_book( markets[i].first, markets[i].second, 10 );
+      BOOST_CHECK_EQUAL( books[i].base, markets[i].first );
+      BOOST_CHECK_EQUAL( books[i].quote, markets[i].second );
+      BOOST_REQUIRE_EQUAL( books[i].bids.size(), single.bids.size() );
+      BOOST_REQUIRE_EQUAL( books[i].asks.size(), single.asks.size() );
+      for( size_t j = 0; j < single.bids.size(); ++j )
+         BOOST_CHECK( books[i].bids[j].price == single.bids[j].price && books[i].bids[j].base == single.bids[j].base );
+      for( size_t j = 0; j < single.asks.size(); ++j )
+         BOOST_CHECK( books[i].asks[j].price == single.asks[j].price && books[i].asks[j].base == single.asks[j].base );
+   }
+   BOOST_CHECK( !books[0].asks.empty() );
+   BOOST_CHECK( !books[1].bids.empty() || !books[1].asks.empty() );
+
+   const vector<market_ticker> tickers = api.get_tickers( markets );
+   BOOST_REQUIRE_EQUAL( tickers.size(), markets.size() );
+   for( size_t i = 0; i < markets.size(); ++i )
+   {
+      const market_ticker single = api.get_ticker( markets[i].first, markets[i].second );
+      BOOST_CHECK_EQUAL( tickers[i].base, markets[i].first );
+      BOOST_CHECK_EQUAL( tickers[i].quote, markets[i].second );
+      BOOST_CHECK( tickers[i].latest == single.latest );
+      BOOST_CHECK( tickers[i].base_volume == single.base_volume );
+      BOOST_CHECK( tickers[i].lowest_ask == single.lowest_ask );
+      BOOST_CHECK( tickers[i].highest_bid == single.highest_bid );
+   }
+
+   // an unknown asset or too many markets fail the whole call
+   GRAPHENE_CHECK_THROW( api.get_order_books( { { GRAPHENE_SYMBOL, "NOSUCHUIA" } } ), fc::exception );
+   GRAPHENE_CHECK_THROW( api.get_tickers( vector<std::pair<string,string>>( 101, markets[0] ) ), fc::exception );
+   GRAPHENE_CHECK_THROW( api.get_order_books( markets, 51 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( wallet_transfer_many_packs_transfers, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( account_id_type(), alice_id, asset( 10000 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+   generate_block();
+
+   // an in-process connection to the node, as the cli wallet would get over a websocket
+   graphene::app::api_access_info access;
+   access.password_hash_b64 = "*";
+   access.password_salt_b64 = "*";
+   access.allowed_apis = { "database_api", "network_broadcast_api", "history_api" };
+   app.set_api_access_info( "wallet", std::move( access ) );
+   auto login = std::make_shared<graphene::app::login_api>( app );
+   BOOST_REQUIRE( login->login( "wallet", "" ) );
+   graphene::wallet::wallet_data data;
+   data.chain_id = db.get_chain_id();
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   graphene::wallet::wallet_api wallet( data, fc::api<graphene::app::login_api>( login ) );
+   wallet.set_wallet_filename( ( data_dir.path() / "wallet.json" ).generic_string() );
+   wallet.set_password( "password" );
+   wallet.unlock( "password" );
+   BOOST_REQUIRE( wallet.import_key( "alice", graphene::utilities::key_to_wif( alice_private_key ) ) );
+
+   // enough memos for the worker threads, and more than fit into one transaction
+   vector<graphene::wallet::transfer_order> orders;
+   for( uint32_t i = 0; i < 100; ++i )
+      orders.push_back( { "bob", fc::to_string( uint64_t( i + 1 ) ), GRAPHENE_SYMBOL, "payment " + fc::to_string( uint64_t( i ) ) } );
+   const vector<signed_transaction> trxs = wallet.transfer_many( "alice", orders, false );
+   BOOST_REQUIRE( trxs.size() > 1 );
+
+   // the transfers are in order, each transaction fits and is signed
+   const uint32_t max_size = db.get_global_properties().parameters.maximum_transaction_size;
+   size_t next = 0;
+   for( const signed_transaction& trx : trxs )
+   {
+      BOOST_CHECK( fc::raw::pack_size( trx ) <= max_size );
+      BOOST_CHECK( !trx.signatures.empty() );
+      for( const operation& op : trx.operations )
+      {
+         BOOST_REQUIRE( next < orders.size() );
+         const transfer_operation& xfer = op.get<transfer_operation>();
+         BOOST_CHECK( xfer.from == alice_id );
+         BOOST_CHECK( xfer.to == bob_id );
+         BOOST_CHECK( xfer.amount == asset( int64_t( ( next + 1 ) * GRAPHENE_BLOCKCHAIN_PRECISION ) ) );
+         BOOST_REQUIRE( xfer.memo.valid() );
+         BOOST_CHECK_EQUAL( xfer.memo->get_message( bob_private_key, xfer.memo->from ), orders[next].memo );
+         ++next;
+      }
+   }
+   BOOST_CHECK_EQUAL( next, orders.size() );
+
+   // the chain takes them all
+   for( const signed_transaction& trx : trxs )
+      PUSH_TX( db, trx );
+   generate_block();
+   // the wallet resyncs in a task after every block, let it run before the wallet goes away
+   fc::usleep( fc::milliseconds( 10 ) );
+   BOOST_CHECK( get_balance( bob_id, asset_id_type() ) == int64_t( 5050 * GRAPHENE_BLOCKCHAIN_PRECISION ) );
+
+   // an unknown receiver fails the whole batch
+   orders.push_back( { "nobody", "1", GRAPHENE_SYMBOL, "" } );
+   GRAPHENE_CHECK_THROW( wallet.transfer_many( "alice", orders, false ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( wallet_journal_keeps_changes, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   generate_block();
+
+   graphene::app::api_access_info access;
+   access.password_hash_b64 = "*";
+   access.password_salt_b64 = "*";
+   access.allowed_apis = { "database_api", "network_broadcast_api", "history_api" };
+   app.set_api_access_info( "wallet", std::move( access ) );
+   auto login = std::make_shared<graphene::app::login_api>( app );
+   BOOST_REQUIRE( login->login( "wallet", "" ) );
+   graphene::wallet::wallet_data data;
+   data.chain_id = db.get_chain_id();
+
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const string filename = ( data_dir.path() / "wallet.json" ).generic_string();
+   const string journal = filename + ".journal";
+   const string copy = ( data_dir.path() / "copy.json" ).generic_string();
+   const string alice_wif = graphene::utilities::key_to_wif( alice_private_key );
+   const string bob_wif = graphene::utilities::key_to_wif( bob_private_key );
+   const auto open_wallet = [&]( const string& file ) {
+      auto wallet = std::make_shared<graphene::wallet::wallet_api>( data, fc::api<graphene::app::login_api>( login ) );
+      wallet->set_wallet_filename( file );
+      BOOST_REQUIRE( wallet->load_wallet_file( file ) );
+      return wallet;
+   };
+   const auto replace_file = []( const string& from, const string& to ) {
+      if( fc::exists( to ) )
+         fc::remove( to );
+      fc::copy( from, to );
+   };
+
+   // the first save writes the snapshot, the later ones append to its journal
+   {
+      graphene::wallet::wallet_api wallet( data, fc::api<graphene::app::login_api>( login ) );
+      wallet.set_wallet_filename( filename );
+      wallet.set_password( "password" );
+      wallet.unlock( "password" );
+      BOOST_REQUIRE( wallet.import_key( "alice", alice_wif ) );
+      BOOST_CHECK( !fc::exists( journal ) );
+      BOOST_REQUIRE( wallet.import_key( "bob", bob_wif ) );
+      BOOST_REQUIRE( fc::exists( journal ) );
+      BOOST_REQUIRE( wallet.set_key_label( bob_public_key, "bob key" ) );
+      wallet.save_wallet_file();
+   }
+   {
+      auto wallet = open_wallet( filename );
+      BOOST_CHECK( wallet->is_locked() );
+      wallet->unlock( "password" );
+      const auto keys = wallet->dump_private_keys();
+      BOOST_CHECK_EQUAL( keys.size(), 2 );
+      BOOST_CHECK_EQUAL( keys.at( alice_public_key ), alice_wif );
+      BOOST_CHECK_EQUAL( keys.at( bob_public_key ), bob_wif );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( bob_public_key ), "bob key" );
+   }
+
+   // bob's key is only in a key batch of the journal, a snapshot written while locked keeps it
+   {
+      auto wallet = open_wallet( filename );
+      wallet->save_wallet_file( copy );
+   }
+   {
+      auto wallet = open_wallet( copy );
+      wallet->unlock( "password" );
+      BOOST_CHECK_EQUAL( wallet->dump_private_keys().size(), 2 );
+   }
+   // as does one written after unlocking and locking again folded the batch into the other keys
+   {
+      auto wallet = open_wallet( filename );
+      wallet->unlock( "password" );
+      wallet->lock();
+      wallet->save_wallet_file( copy );
+   }
+   {
+      auto wallet = open_wallet( copy );
+      wallet->unlock( "password" );
+      BOOST_CHECK_EQUAL( wallet->dump_private_keys().size(), 2 );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( bob_public_key ), "bob key" );
+   }
+
+   // a cut off last record is left out, the records before it still count and the next save compacts
+   const string intact = journal + ".intact";
+   replace_file( journal, intact );
+   fc::resize_file( journal, fc::file_size( journal ) - 5 );
+   {
+      auto wallet = open_wallet( filename );
+      wallet->unlock( "password" );
+      BOOST_CHECK_EQUAL( wallet->dump_private_keys().size(), 2 );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( bob_public_key ), "" );
+      wallet->save_wallet_file();
+      BOOST_CHECK( !fc::exists( journal ) );
+   }
+
+   // the intact journal belongs to the older snapshot, so none of it counts beside the new one
+   replace_file( intact, journal );
+   {
+      auto wallet = open_wallet( filename );
+      wallet->unlock( "password" );
+      BOOST_CHECK_EQUAL( wallet->dump_private_keys().size(), 2 );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( bob_public_key ), "" );
+      wallet->save_wallet_file();
+      BOOST_CHECK( !fc::exists( journal ) );
+
+      BOOST_REQUIRE( wallet->set_key_label( bob_public_key, "bob key 2" ) );
+      wallet->save_wallet_file();
+      BOOST_REQUIRE( wallet->set_key_label( alice_public_key, "alice key" ) );
+      wallet->save_wallet_file();
+   }
+
+   // a record that fails its checksum is left out as well
+   {
+      std::fstream file( journal, std::ios::in | std::ios::out | std::ios::binary );
+      file.seekg( -1, std::ios::end );
+      const char last = file.get();
+      file.seekp( -1, std::ios::end );
+      file.put( last ^ 0x5a );
+   }
+   {
+      auto wallet = open_wallet( filename );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( bob_public_key ), "bob key 2" );
+      BOOST_CHECK_EQUAL( wallet->get_key_label( alice_public_key ), "" );
+      wallet->unlock( "password" );
+      BOOST_CHECK_EQUAL( wallet->dump_private_keys().size(), 2 );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( serialized_object_cache_follows_changes, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+
+   graphene::app::database_api api( db );
+   auto cache = graphene::app::serialized_object_cache::get( db );
+   auto before = cache->get_statistics();
+   api.get_objects( { alice_id } );
+   BOOST_CHECK( api.get_objects( { alice_id } )[0].as<account_object>().name == "alice" );
+   auto stats = cache->get_statistics();
+   BOOST_CHECK_EQUAL( stats.misses - before.misses, 1 );
+   BOOST_CHECK_EQUAL( stats.hits - before.hits, 1 );
+
+   auto alice_balance = [&]() {
+      return api.get_full_accounts( { "alice" }, false ).at( "alice" ).balances.at( 0 ).balance.value;
+   };
+   BOOST_CHECK_EQUAL( alice_balance(), 1000 );
+   BOOST_CHECK_EQUAL( alice_balance(), 1000 );
+   stats = cache->get_statistics();
+   BOOST_CHECK_EQUAL( stats.bundle_misses - before.bundle_misses, 1 );
+   BOOST_CHECK_EQUAL( stats.bundle_hits - before.bundle_hits, 1 );
+
+   // a pending transaction changes the bundle, and so does undoing it
+   transfer( committee_account, alice_id, asset( 500 ) );
+   BOOST_CHECK_EQUAL( alice_balance(), 1500 );
+   db.clear_pending();
+   BOOST_CHECK_EQUAL( alice_balance(), 1000 );
+   BOOST_CHECK( cache->get_statistics().invalidations > stats.invalidations );
+
+   // the least recently used objects make room
+   cache->set_capacity( 2 );
+   api.get_objects( { alice_id, bob_id, committee_account } );
+   stats = cache->get_statistics();
+   BOOST_CHECK_EQUAL( stats.entries, 2 );
+   BOOST_CHECK_EQUAL( stats.capacity, 2 );
+   before = stats;
+   BOOST_CHECK( api.get_objects( { committee_account } )[0].as<account_object>().id == committee_account );
+   BOOST_CHECK_EQUAL( cache->get_statistics().hits - before.hits, 1 );
+   api.get_objects( { alice_id } );
+   BOOST_CHECK_EQUAL( cache->get_statistics().misses - before.misses, 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( serialized_object_cache_sees_undo_restore, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   const asset_id_type uia = create_user_issued_asset( "RESTORE" ).id;
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   const limit_order_id_type order = create_sell_order( alice_id, asset( 100 ), asset( 100, uia ) )->id;
+   generate_block();
+
+   graphene::app::database_api api( db );
+   auto cache = graphene::app::serialized_object_cache::get( db );
+   auto orders = [&]() {
+      return api.get_full_accounts( { "alice" }, false ).at( "alice" ).limit_orders.size();
+   };
+   BOOST_CHECK_EQUAL( orders(), 1 );
+
+   // the bundle made while the order is cancelled must not outlive the undo that puts the order back
+   cancel_limit_order( order(db) );
+   BOOST_CHECK_EQUAL( orders(), 0 );
+   BOOST_CHECK_EQUAL( orders(), 0 );
+   const auto before = cache->get_statistics();
+   db.clear_pending();
+   BOOST_REQUIRE( db.find( order ) != nullptr );
+   BOOST_CHECK( cache->get_statistics().invalidations > before.invalidations );
+   BOOST_CHECK_EQUAL( orders(), 1 );
+   BOOST_CHECK( api.get_objects( { order } )[0].as<limit_order_object>().id == order );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( lookup_members_by_account_name, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   upgrade_to_lifetime_member( alice_id );
+   upgrade_to_lifetime_member( bob_id );
+   trx.clear();
+   const witness_id_type bob_witness = create_witness( bob_id, bob_private_key ).id;
+   const committee_member_id_type alice_member = create_committee_member( alice_id(db) ).id;
+   generate_block();
+
+   graphene::app::database_api api( db );
+   const auto witnesses = api.lookup_witness_accounts( "b", 2 );
+   BOOST_REQUIRE_EQUAL( witnesses.size(), 2 );
+   BOOST_CHECK( witnesses.begin()->first == "bob" );
+   BOOST_CHECK( witnesses.begin()->second == bob_witness );
+   BOOST_CHECK( std::next( witnesses.begin() )->first == "init0" );
+   BOOST_CHECK_EQUAL( api.lookup_witness_accounts( "", 1000 ).size(), db.get_index_type<witness_index>().indices().size() );
+
+   const auto members = api.lookup_committee_member_accounts( "", 1 );
+   BOOST_REQUIRE_EQUAL( members.size(), 1 );
+   BOOST_CHECK( members.at( "alice" ) == alice_member );
+
+   // the block created the accounts as well, undo removes them before or after their members
+   db.pop_block();
+   BOOST_CHECK_EQUAL( api.lookup_witness_accounts( "bob", 1 ).count( "bob" ), 0 );
+   BOOST_CHECK_EQUAL( api.lookup_committee_member_accounts( "", 1 ).count( "alice" ), 0 );
+   BOOST_CHECK_EQUAL( api.lookup_witness_accounts( "", 1000 ).size(), db.get_index_type<witness_index>().indices().size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( required_and_impacted_accounts_in_one_visit )
+{
+   auto separately = []( const operation& op ) {
+      flat_set<account_id_type> result;
+      vector<authority> other;
+      operation_get_required_authorities( op, result, result, other );
+      graphene::app::operation_get_impacted_accounts( op, result );
+      for( const auto& a : other )
+         for( const auto& item : a.account_auths )
+            result.insert( item.first );
+      return result;
+   };
+   auto combined = []( const operation& op ) {
+      flat_set<account_id_type> result;
+      graphene::app::operation_get_required_and_impacted_accounts( op, result );
+      return result;
+   };
+
+   transfer_operation top;
+   top.from = account_id_type(5);
+   top.to = account_id_type(6);
+   BOOST_CHECK( combined( top ) == separately( top ) );
+   BOOST_CHECK_EQUAL( combined( top ).size(), 2u );
+
+   proposal_create_operation pop;
+   pop.fee_paying_account = account_id_type(7);
+   pop.proposed_ops.emplace_back( top );
+   BOOST_CHECK( combined( pop ) == separately( pop ) );
+   BOOST_CHECK_EQUAL( combined( pop ).size(), 3u );
+
+   account_update_operation uop;
+   uop.account = account_id_type(8);
+   uop.active = authority( 1, account_id_type(9), 1 );
+   BOOST_CHECK( combined( uop ) == separately( uop ) );
+}
+
+BOOST_FIXTURE_TEST_CASE( account_holdings_follow_balances, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_object& uia = create_user_issued_asset( "HOLD" );
+   const auto& holdings = dynamic_cast< const primary_index< account_balance_index >& >(
+         db.get_index_type< account_balance_index >() ).get_secondary_index< account_holdings_index >();
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( alice_id ), 0 );
+
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   issue_uia( alice, uia.amount( 500 ) );
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( alice_id ), 2 );
+
+   generate_block();
+   transfer( alice_id, bob_id, uia.amount( 500 ) );
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( alice_id ), 1 );
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( bob_id ), 1 );
+
+   // undoing the transfer restores the counts
+   generate_block();
+   db.pop_block();
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( alice_id ), 2 );
+   BOOST_CHECK_EQUAL( holdings.positive_balance_count( bob_id ), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( asset_holders_follow_balances, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia_id = create_user_issued_asset( "HOLDERS" ).id;
+   const auto& holders = dynamic_cast< const primary_index< account_balance_index >& >(
+         db.get_index_type< account_balance_index >() ).get_secondary_index< asset_holders_index >();
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).holders, 0u );
+
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   issue_uia( alice, asset( 500, uia_id ) );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).holders, 1u );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).total_in_balances.value, 500 );
+
+   generate_block();
+   transfer( alice_id, bob_id, asset( 200, uia_id ) );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).holders, 2u );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).total_in_balances.value, 500 );
+
+   generate_block();
+   transfer( alice_id, bob_id, asset( 300, uia_id ) );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).holders, 1u );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).total_in_balances.value, 500 );
+
+   // undoing the transfer restores the statistics
+   generate_block();
+   db.pop_block();
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).holders, 2u );
+   BOOST_CHECK_EQUAL( holders.get_statistics( uia_id ).total_in_balances.value, 500 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( proposals_of_nested_approvers, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol)(nathan) );
+   auto set_active = [&]( account_id_type aid, account_id_type member ) {
+      account_update_operation op;
+      op.account = aid;
+      op.active = authority( 1, member, 1 );
+      trx.operations = { op };
+      PUSH_TX( db, trx, database::skip_transaction_signatures | database::skip_authority_check );
+      trx.clear();
+   };
+   // carol is controlled by bob, who is controlled by alice
+   set_active( bob_id, alice_id );
+   set_active( carol_id, bob_id );
+
+   transfer_operation top;
+   top.from = carol_id;
+   top.to = nathan_id;
+   top.amount = asset( 1 );
+   proposal_create_operation pop;
+   pop.proposed_ops.emplace_back( top );
+   pop.fee_paying_account = nathan_id;
+   pop.expiration_time = db.head_block_time() + fc::days(1);
+   trx.operations = { pop };
+   PUSH_TX( db, trx, database::skip_transaction_signatures | database::skip_authority_check );
+   trx.clear();
+   const proposal_id_type pid = db.get_index_type<proposal_index>().indices().begin()->id;
+
+   graphene::app::database_api api( db );
+   auto proposals_of = [&]( account_id_type id ) {
+      vector<proposal_id_type> ids;
+      for( const auto& p : api.get_proposed_transactions( id ) )
+         ids.push_back( p.id );
+      return ids;
+   };
+   BOOST_CHECK( proposals_of( carol_id ) == vector<proposal_id_type>{ pid } );
+   BOOST_CHECK( proposals_of( bob_id ) == vector<proposal_id_type>{ pid } );
+   BOOST_CHECK( proposals_of( alice_id ) == vector<proposal_id_type>{ pid } );
+   BOOST_CHECK( proposals_of( nathan_id ).empty() );
+
+   // approvals added by an update are followed as well
+   proposal_update_operation uop;
+   uop.proposal = pid;
+   uop.fee_paying_account = nathan_id;
+   uop.active_approvals_to_add.insert( nathan_id );
+   trx.operations = { uop };
+   PUSH_TX( db, trx, database::skip_transaction_signatures | database::skip_authority_check );
+   trx.clear();
+   BOOST_CHECK( proposals_of( nathan_id ) == vector<proposal_id_type>{ pid } );
+
+   uop.active_approvals_to_add.clear();
+   uop.active_approvals_to_remove.insert( nathan_id );
+   trx.operations = { uop };
+   PUSH_TX( db, trx, database::skip_transaction_signatures | database::skip_authority_check );
+   trx.clear();
+   BOOST_CHECK( proposals_of( nathan_id ).empty() );
+   BOOST_CHECK( proposals_of( carol_id ) == vector<proposal_id_type>{ pid } );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( full_key_references, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   const balance_id_type pts_balance = db.create<balance_object>( [&]( balance_object& b ) {
+      b.owner = pts_address( alice_public_key, true, 56 );
+      b.balance = asset( 100 );
+   }).id;
+   const vesting_balance_id_type vesting = db.create<vesting_balance_object>( [&]( vesting_balance_object& v ) {
+      v.owner = alice_id;
+      v.balance = asset( 50 );
+   }).id;
+
+   graphene::app::database_api api( db );
+   const auto refs = api.get_full_key_references( { alice_public_key, bob_public_key } );
+   BOOST_REQUIRE_EQUAL( refs.size(), 2 );
+   BOOST_REQUIRE_EQUAL( refs[0].accounts.size(), 1 );
+   BOOST_CHECK( refs[0].accounts[0] == alice_id );
+   BOOST_REQUIRE_EQUAL( refs[0].balances.size(), 1 );
+   BOOST_CHECK( refs[0].balances[0].id == pts_balance );
+   BOOST_REQUIRE_EQUAL( refs[0].vesting_balances.size(), 1 );
+   BOOST_CHECK( refs[0].vesting_balances[0].id == vesting );
+
+   BOOST_REQUIRE_EQUAL( refs[1].accounts.size(), 1 );
+   BOOST_CHECK( refs[1].accounts[0] == bob_id );
+   BOOST_CHECK( refs[1].balances.empty() );
+   BOOST_CHECK( refs[1].vesting_balances.empty() );
+
+   // get_key_references agrees on the accounts
+   const auto accounts = api.get_key_references( { alice_public_key } );
+   BOOST_REQUIRE_EQUAL( accounts.size(), 1 );
+   BOOST_CHECK( std::find( accounts[0].begin(), accounts[0].end(), alice_id ) != accounts[0].end() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( balances_for_accounts, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   const asset_id_type uia = create_user_issued_asset( "BALQ" ).id;
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   issue_uia( bob_id, asset( 30, uia ) );
+
+   graphene::app::database_api api( db );
+   auto all = api.get_balances_for_accounts( { bob_id, alice_id }, {} );
+   BOOST_REQUIRE_EQUAL( all.size(), 2 );
+   BOOST_CHECK( all[0].account == bob_id );
+   BOOST_REQUIRE_EQUAL( all[0].balances.size(), 1 );
+   BOOST_CHECK( all[0].balances[0] == asset( 30, uia ) );
+   BOOST_CHECK( all[1].account == alice_id );
+   BOOST_REQUIRE_EQUAL( all[1].balances.size(), 1 );
+   BOOST_CHECK( all[1].balances[0] == asset( 1000 ) );
+
+   // the asked for assets come back in their order, with 0 for the ones an account does not hold
+   auto some = api.get_balances_for_accounts( { alice_id, bob_id }, { asset_id_type(), uia } );
+   BOOST_REQUIRE_EQUAL( some.size(), 2 );
+   BOOST_REQUIRE_EQUAL( some[0].balances.size(), 2 );
+   BOOST_CHECK( some[0].balances[0] == asset( 1000 ) );
+   BOOST_CHECK( some[0].balances[1] == asset( 0, uia ) );
+   BOOST_REQUIRE_EQUAL( some[1].balances.size(), 2 );
+   BOOST_CHECK( some[1].balances[0] == asset( 0 ) );
+   BOOST_CHECK( some[1].balances[1] == asset( 30, uia ) );
+   for( size_t i = 0; i < some.size(); ++i )
+      BOOST_CHECK( some[i].balances == api.get_account_balances( some[i].account, { asset_id_type(), uia } ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( potential_signatures_follow_authorities, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   db.modify( alice_id(db), [&]( account_object& a ) {
+      a.active.account_auths[bob_id] = 1;
+   });
+
+   graphene::app::database_api api( db );
+   signed_transaction trx;
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset( 1 );
+   trx.operations.push_back( op );
+
+   auto keys = api.get_potential_signatures( trx );
+   BOOST_CHECK_EQUAL( keys.size(), 2 );
+   BOOST_CHECK( keys.count( alice_public_key ) );
+   BOOST_CHECK( keys.count( bob_public_key ) );
+   // answered again from the cache
+   BOOST_CHECK( api.get_potential_signatures( trx ) == keys );
+
+   // a new active authority of an account below is seen at once
+   const public_key_type bob_new_key = generate_private_key( "bob new" ).get_public_key();
+   db.modify( bob_id(db), [&]( account_object& a ) {
+      a.active = authority( 1, bob_new_key, 1 );
+   });
+   keys = api.get_potential_signatures( trx );
+   BOOST_CHECK_EQUAL( keys.size(), 2 );
+   BOOST_CHECK( keys.count( alice_public_key ) );
+   BOOST_CHECK( keys.count( bob_new_key ) );
+
+   // the walk agrees once the transaction carries a signature
+   trx.sign( alice_private_key, db.get_chain_id() );
+   BOOST_CHECK( api.get_potential_signatures( trx ).count( alice_public_key ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( full_accounts_paged, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   const asset_id_type uia1 = create_user_issued_asset( "PAGEA" ).id;
+   const asset_id_type uia2 = create_user_issued_asset( "PAGEB" ).id;
+   issue_uia( alice_id, asset( 10, uia1 ) );
+   issue_uia( alice_id, asset( 10, uia2 ) );
+   vector<vesting_balance_id_type> vesting;
+   for( int i = 0; i < 3; ++i )
+      vesting.push_back( db.create<vesting_balance_object>( [&]( vesting_balance_object& v ) {
+         v.owner = alice_id;
+         v.balance = asset( 50 );
+      }).id );
+
+   graphene::app::database_api api( db );
+
+   graphene::app::full_account_query query;
+   query.summary = true;
+   auto summary = api.get_full_accounts_paged( { "alice" }, query, false );
+   BOOST_REQUIRE_EQUAL( summary.size(), 1 );
+   BOOST_CHECK_EQUAL( summary["alice"].counts.balances, 3 );
+   BOOST_CHECK_EQUAL( summary["alice"].counts.vesting_balances, 3 );
+   BOOST_CHECK( summary["alice"].account.balances.empty() );
+   BOOST_CHECK( summary["alice"].account.account.id == alice_id );
+
+   // two of each section, then the rest of the sections that were cut short
+   query.summary = false;
+   query.limit = 2;
+   auto first = api.get_full_accounts_paged( { "alice" }, query, false );
+   const auto& page = first["alice"];
+   BOOST_CHECK_EQUAL( page.account.balances.size(), 2 );
+   BOOST_CHECK_EQUAL( page.account.vesting_balances.size(), 2 );
+   BOOST_REQUIRE( page.next_page.balances.valid() );
+   BOOST_REQUIRE( page.next_page.vesting_balances.valid() );
+   BOOST_CHECK( !page.next_page.limit_orders.valid() );
+   BOOST_CHECK( *page.next_page.vesting_balances == vesting[2] );
+
+   query.start["alice"] = page.next_page;
+   auto second = api.get_full_accounts_paged( { "alice" }, query, false );
+   const auto& rest = second["alice"];
+   BOOST_REQUIRE_EQUAL( rest.account.balances.size(), 1 );
+   BOOST_CHECK( rest.account.balances[0].asset_type == uia2 );
+   BOOST_REQUIRE_EQUAL( rest.account.vesting_balances.size(), 1 );
+   BOOST_CHECK( rest.account.vesting_balances[0].id == vesting[2] );
+   BOOST_CHECK( !rest.next_page.balances.valid() );
+   BOOST_CHECK( !rest.next_page.vesting_balances.valid() );
+
+   // the cap of a call cuts the sections short and turns away get_full_accounts
+   graphene::app::database_api::set_max_full_account_objects( 3 );
+   query.start.clear();
+   query.limit = 100;
+   auto capped = api.get_full_accounts_paged( { "alice" }, query, false );
+   BOOST_CHECK_EQUAL( capped["alice"].account.balances.size() + capped["alice"].account.vesting_balances.size(), 3 );
+   BOOST_CHECK( capped["alice"].next_page.vesting_balances.valid() );
+   GRAPHENE_CHECK_THROW( api.get_full_accounts( { "alice" }, false ), fc::exception );
+   graphene::app::database_api::set_max_full_account_objects( graphene::app::database_api::default_max_full_account_objects );
+   BOOST_CHECK_EQUAL( api.get_full_accounts( { "alice" }, false )["alice"].balances.size(), 3 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( api_pages_continue_at_cursor, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+   const asset_id_type uia1 = create_user_issued_asset( "CURSA" ).id;
+   const asset_id_type uia2 = create_user_issued_asset( "CURSB" ).id;
+   issue_uia( alice_id, asset( 10, uia1 ) );
+   issue_uia( alice_id, asset( 10, uia2 ) );
+   vector<limit_order_id_type> orders;
+   for( int i = 1; i <= 4; ++i )
+      orders.push_back( create_sell_order( alice_id, asset( 100 ), asset( 100 * i, uia1 ) )->id );
+
+   graphene::app::database_api api( db );
+
+   auto balances = api.get_account_balances_page( alice_id, 2, "" );
+   BOOST_REQUIRE_EQUAL( balances.items.size(), 2 );
+   BOOST_CHECK( balances.items[0].asset_id == asset_id_type() );
+   BOOST_REQUIRE( !balances.next.empty() );
+   balances = api.get_account_balances_page( alice_id, 2, balances.next );
+   BOOST_REQUIRE_EQUAL( balances.items.size(), 1 );
+   BOOST_CHECK( balances.items[0].asset_id == uia2 );
+   BOOST_CHECK( balances.next.empty() );
+
+   // the best price first, and the page after a cursor whose order is gone continues with the order after it
+   auto page = api.get_limit_orders_page( asset_id_type(), uia1, 2, "" );
+   BOOST_REQUIRE_EQUAL( page.items.size(), 2 );
+   BOOST_CHECK( page.items[0].id == orders[0] );
+   BOOST_CHECK( page.items[1].id == orders[1] );
+   cancel_limit_order( orders[2](db) );
+   page = api.get_limit_orders_page( asset_id_type(), uia1, 2, page.next );
+   BOOST_REQUIRE_EQUAL( page.items.size(), 1 );
+   BOOST_CHECK( page.items[0].id == orders[3] );
+   BOOST_CHECK( page.next.empty() );
+
+   GRAPHENE_CHECK_THROW( api.get_limit_orders_page( asset_id_type(), uia1, 2, "zz" ), fc::exception );
+   GRAPHENE_CHECK_THROW( api.get_limit_orders_page( uia1, asset_id_type(), 2,
+                                                    api.get_limit_orders_page( asset_id_type(), uia1, 1, "" ).next ),
+                         fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( direct_json_matches_variants, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
 
-   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 50000 );
+   graphene::app::database_api api( db );
+   const vector<object_id_type> ids = { alice_id, alice_id(db).statistics, account_id_type( 1000000 ), asset_id_type() };
+   std::string objects;
+   api.get_objects_json( ids, objects );
+   BOOST_CHECK_EQUAL( objects, fc::json::to_string( api.get_objects( ids ) ) );
 
-   limit_order_create_operation op;
-   op.seller = nathan->id;
-   op.amount_to_sell = core->amount(500);
-   op.min_to_receive = test->amount(500);
-   op.expiration = db.head_block_time() + fc::seconds(10);
-   trx.operations.push_back(op);
-   auto ptrx = PUSH_TX( db, trx, ~0 );
+   std::string block;
+   api.get_block_json( db.head_block_num(), block );
+   BOOST_CHECK_EQUAL( block, fc::json::to_string( fc::variant( api.get_block( db.head_block_num() ) ) ) );
 
-   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 49500 );
+   std::string accounts;
+   api.get_full_accounts_json( { "alice" }, false, accounts );
+   BOOST_CHECK_EQUAL( accounts, fc::json::to_string( fc::variant( api.get_full_accounts( { "alice" }, false ) ) ) );
+} FC_LOG_AND_RETHROW() }
 
-   auto ptrx_id = ptrx.operation_results.back().get<object_id_type>();
-   auto limit_index = db.get_index_type<limit_order_index>().indices();
-   auto limit_itr = limit_index.begin();
-   BOOST_REQUIRE( limit_itr != limit_index.end() );
-   BOOST_REQUIRE( limit_itr->id == ptrx_id );
-   BOOST_REQUIRE( db.find_object(limit_itr->id) );
-   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 49500 );
-   auto id = limit_itr->id;
+BOOST_FIXTURE_TEST_CASE( change_notifications_coalesce_until_block, database_fixture )
+{ try {
+   ACTORS( (alice) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+   const object_id_type alice_balance = db.get_index_type<account_balance_index>().indices().get<by_account_asset>()
+                                           .find( boost::make_tuple( alice_id, asset_id_type() ) )->id;
+
+   vector< vector<object_id_type> > notifications;
+   auto connection = db.changed_objects.connect( [&]( const vector<object_id_type>& ids ) { notifications.push_back( ids ); } );
+   db.set_change_notification_interval( fc::hours(1) );
+
+   // the first push of the interval is reported, the next one waits for the block
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   BOOST_CHECK_EQUAL( notifications.size(), 1 );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   BOOST_CHECK_EQUAL( notifications.size(), 1 );
+   generate_block();
+   BOOST_REQUIRE_EQUAL( notifications.size(), 2 );
+   BOOST_CHECK_EQUAL( std::count( notifications[1].begin(), notifications[1].end(), alice_balance ), 1 );
 
-   generate_blocks(op.expiration, false);
-   test = &get_asset("TEST");
-   core = &asset_id_type()(db);
-   nathan = &get_account("nathan");
-   committee = &account_id_type()(db);
+   db.set_change_notification_interval( fc::microseconds() );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   BOOST_CHECK_EQUAL( notifications.size(), 3 );
+} FC_LOG_AND_RETHROW() }
 
-   BOOST_CHECK(db.find_object(id) == nullptr);
-   BOOST_CHECK_EQUAL( get_balance(*nathan, *core), 50000 );
+BOOST_AUTO_TEST_CASE( send_queue_coalesces_and_overflows )
+{ try {
+   using graphene::app::send_queue;
+   vector<fc::variant> sent;
+   bool overflowed = false;
+   auto queue = std::make_shared<send_queue>( [&]() { overflowed = true; } );
+   const send_queue::callback_type callback = [&]( const fc::variant& v ) { sent.push_back( v ); };
+   auto update = []( const string& id, int64_t value ) {
+      return fc::variant( fc::mutable_variant_object( "id", id )( "value", value ) );
+   };
+
+   // the sending task only runs once this one yields, so the second updates replace the first
+   queue->push_objects( callback, { update( "1.2.5", 1 ), update( "1.2.6", 1 ) } );
+   queue->push_objects( callback, { update( "1.2.5", 2 ), fc::variant( "1.2.6" ) } );
+   BOOST_CHECK( queue->queued_bytes() > 0 );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_REQUIRE_EQUAL( sent.size(), 1 );
+   const auto& updates = sent[0].get_array();
+   BOOST_REQUIRE_EQUAL( updates.size(), 2 );
+   BOOST_CHECK_EQUAL( updates[0]["value"].as_int64(), 2 );
+   BOOST_CHECK_EQUAL( updates[1].as_string(), "1.2.6" );
+   BOOST_CHECK_EQUAL( queue->queued_bytes(), 0 );
+
+   // a consumer that falls behind loses what waits for it
+   const uint64_t limit = send_queue::max_bytes();
+   send_queue::set_max_bytes( 100 );
+   queue->push( callback, fc::variant( string( 60, 'x' ) ) );
+   BOOST_CHECK( !overflowed );
+   queue->push( callback, fc::variant( string( 60, 'x' ) ) );
+   send_queue::set_max_bytes( limit );
+   BOOST_CHECK( overflowed );
+   BOOST_CHECK_EQUAL( queue->queued_bytes(), 0 );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK_EQUAL( sent.size(), 1 );
 } FC_LOG_AND_RETHROW() }
 
-BOOST_FIXTURE_TEST_CASE( double_sign_check, database_fixture )
+BOOST_AUTO_TEST_CASE( account_history_store_segments )
 { try {
-   generate_block();
-   const auto& alice = account_id_type()(db);
-   ACTOR(bob);
-   asset amount(1000);
+   using graphene::account_history::account_history_store;
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const account_id_type alice( 10 ), bob( 11 );
 
-   set_expiration( db, trx );
-   transfer_operation t;
-   t.from = alice.id;
-   t.to = bob.id;
-   t.amount = amount;
-   trx.operations.push_back(t);
-   for( auto& op : trx.operations ) db.current_fee_schedule().set_fee(op);
-   trx.validate();
+   // operation n concerns alice, every third one bob as well
+   auto append = [&]( account_history_store& store, uint64_t first, uint64_t last ) {
+      for( uint64_t n = first; n <= last; ++n )
+      {
+         operation_history_object op;
+         op.id = operation_history_id_type( n );
+         op.block_num = n;
+         vector< std::pair<account_id_type,uint32_t> > accounts;
+         accounts.emplace_back( alice, n + 1 );
+         if( n % 3 == 0 )
+            accounts.emplace_back( bob, n / 3 + 1 );
+         store.append( op, accounts );
+      }
+      store.flush();
+   };
+   auto ids = []( const vector<operation_history_object>& ops ) {
+      vector<uint64_t> result;
+      for( const auto& op : ops )
+         result.push_back( op.id.instance() );
+      return result;
+   };
 
-   db.push_transaction(trx, ~0);
+   {
+      account_history_store store( 4 );
+      store.open( data_dir.path() );
+      append( store, 0, 9 );
+      BOOST_CHECK_EQUAL( store.entry_count(), 14 );
+      BOOST_CHECK_GT( store.segment_count(), 2 );
+   }
 
-   trx.operations.clear();
-   t.from = bob.id;
-   t.to = alice.id;
-   t.amount = amount;
-   trx.operations.push_back(t);
-   for( auto& op : trx.operations ) db.current_fee_schedule().set_fee(op);
-   trx.validate();
+   account_history_store store( 4 );
+   store.open( data_dir.path() );
+   BOOST_CHECK_EQUAL( store.entry_count(), 14 );
+   BOOST_CHECK_EQUAL( store.last_operation(), 9 );
+   // operations already in the store are not added again
+   append( store, 8, 12 );
+   BOOST_CHECK_EQUAL( store.entry_count(), 18 );
+
+   const vector<uint64_t> alice_newest = { 12, 11, 10, 9, 8 };
+   BOOST_CHECK( ids( store.get_account_history( alice, std::numeric_limits<uint64_t>::max(), 0, 5 ) ) == alice_newest );
+   const vector<uint64_t> alice_middle = { 6, 5, 4 };
+   BOOST_CHECK( ids( store.get_account_history( alice, 6, 3, 10 ) ) == alice_middle );
+   const vector<uint64_t> bob_all = { 12, 9, 6, 3 };
+   BOOST_CHECK( ids( store.get_account_history( bob, std::numeric_limits<uint64_t>::max(), 0, 10 ) ) == bob_all );
+   const vector<uint64_t> bob_relative = { 6, 3 };
+   BOOST_CHECK( ids( store.get_relative_account_history( bob, 3, 1, 10 ) ) == bob_relative );
+   BOOST_CHECK( store.get_account_history( account_id_type( 12 ), std::numeric_limits<uint64_t>::max(), 0, 10 ).empty() );
+} FC_LOG_AND_RETHROW() }
 
-   BOOST_TEST_MESSAGE( "Verify that not-signing causes an exception" );
-   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), fc::exception );
+BOOST_AUTO_TEST_CASE( account_history_store_in_memory )
+{ try {
+   using graphene::account_history::account_history_store;
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path file = data_dir.path() / "packed_history";
+   const account_id_type alice( 10 );
 
-   BOOST_TEST_MESSAGE( "Verify that double-signing causes an exception" );
-   sign( trx, bob_private_key );
-   sign( trx, bob_private_key );
-   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), tx_duplicate_sig );
+   auto append = [&]( account_history_store& store, uint64_t first, uint64_t last ) {
+      for( uint64_t n = first; n <= last; ++n )
+      {
+         operation_history_object op;
+         op.id = operation_history_id_type( n );
+         op.block_num = n;
+         transfer_operation t;
+         t.memo = memo_data();
+         t.memo->message.resize( 100 * n );
+         op.op = t;
+         vector< std::pair<account_id_type,uint32_t> > accounts;
+         accounts.emplace_back( alice, n + 1 );
+         store.append( op, accounts );
+      }
+   };
 
-   BOOST_TEST_MESSAGE( "Verify that signing with an extra, unused key fails" );
-   trx.signatures.pop_back();
-   sign( trx, generate_private_key("bogus" ));
-   GRAPHENE_REQUIRE_THROW( db.push_transaction(trx, 0), tx_irrelevant_sig );
+   {
+      account_history_store store( 4 );
+      store.open_in_memory( file );
+      BOOST_CHECK( store.is_in_memory() );
+      append( store, 0, 9 );
+      BOOST_CHECK_EQUAL( store.entry_count(), 10 );
+      // the size of the segments does not apply, there are no segment files
+      BOOST_CHECK_EQUAL( store.segment_count(), 1 );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "00000000.idx" ) );
+      BOOST_CHECK( !fc::exists( file ) );
+   }
+   BOOST_REQUIRE( fc::exists( file ) );
+
+   account_history_store store( 4 );
+   store.open_in_memory( file );
+   BOOST_CHECK_EQUAL( store.entry_count(), 10 );
+   BOOST_CHECK_EQUAL( store.last_operation(), 9 );
+   append( store, 8, 12 );
+   BOOST_CHECK_EQUAL( store.entry_count(), 13 );
+
+   const auto ops = store.get_account_history( alice, std::numeric_limits<uint64_t>::max(), 0, 20 );
+   BOOST_REQUIRE_EQUAL( ops.size(), 13 );
+   for( size_t i = 0; i < ops.size(); ++i )
+   {
+      const uint64_t n = 12 - i;
+      BOOST_CHECK_EQUAL( ops[i].id.instance(), n );
+      BOOST_CHECK_EQUAL( ops[i].block_num, n );
+      BOOST_CHECK_EQUAL( ops[i].op.get<transfer_operation>().memo->message.size(), 100 * n );
+   }
+} FC_LOG_AND_RETHROW() }
 
-   BOOST_TEST_MESSAGE( "Verify that signing once with the proper key passes" );
-   trx.signatures.pop_back();
-   db.push_transaction(trx, 0);
-   sign( trx, bob_private_key );
+/** the built-in plugins with account history cut at the 3 newest entries of an account */
+struct history_limit_fixture : database_fixture
+{
+   static boost::program_options::variables_map limit_options()
+   {
+      boost::program_options::variables_map options;
+      options.emplace( "max-ops-per-account", boost::program_options::variable_value( uint32_t(3), false ) );
+      return options;
+   }
+   history_limit_fixture() : database_fixture( limit_options() ) {}
+};
+
+BOOST_FIXTURE_TEST_CASE( max_ops_per_account_prunes_history, history_limit_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol) );
+   transfer( committee_account, alice_id, asset( 10000 ) );
+   transfer( committee_account, bob_id, asset( 10000 ) );
+   generate_block();
+
+   graphene::app::history_api hist( app );
+   const auto amounts = [&]( const vector<operation_history_object>& ops ) {
+      vector<int64_t> result;
+      for( const auto& o : ops )
+         result.push_back( o.op.get<transfer_operation>().amount.amount.value );
+      return result;
+   };
+   const auto entry_count = [&]( account_id_type account ) {
+      const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+      return std::distance( by_seq_idx.lower_bound( boost::make_tuple( account ) ),
+                            by_seq_idx.upper_bound( boost::make_tuple( account ) ) );
+   };
+
+   // an operation in the histories of alice and bob
+   transfer( alice_id, bob_id, asset( 1 ) );
+   generate_block();
+   const operation_history_id_type shared = hist.get_account_history( alice_id, operation_history_id_type(), 1 )[0].id;
+   BOOST_CHECK( hist.get_account_history( bob_id, operation_history_id_type(), 1 )[0].id == shared );
 
+   // alice drops it, bob still has it among his 3 newest
+   for( int64_t amount = 2; amount <= 4; ++amount )
+      transfer( alice_id, carol_id, asset( amount ) );
+   generate_block();
+   BOOST_CHECK( amounts( hist.get_account_history( alice_id ) ) == vector<int64_t>( { 4, 3, 2 } ) );
+   BOOST_CHECK( amounts( hist.get_relative_account_history( alice_id ) ) == vector<int64_t>( { 4, 3, 2 } ) );
+   BOOST_CHECK_EQUAL( entry_count( alice_id ), 3 );
+   const uint32_t alice_ops = alice_id(db).statistics(db).total_ops;
+   BOOST_CHECK( hist.get_relative_account_history( alice_id, 0, 100, alice_ops - 3 ).empty() );
+   const auto& oldest = *db.get_index_type<account_transaction_history_index>().indices().get<by_seq>()
+                           .lower_bound( boost::make_tuple( alice_id ) );
+   BOOST_CHECK_EQUAL( oldest.sequence, alice_ops - 2 );
+   BOOST_CHECK( oldest.next == account_transaction_history_id_type() );
+   BOOST_REQUIRE( db.find( shared ) != nullptr );
+   BOOST_CHECK( hist.get_account_history( bob_id ).back().id == shared );
+
+   // once bob drops it too, the operation goes
+   for( int64_t amount = 5; amount <= 7; ++amount )
+      transfer( bob_id, carol_id, asset( amount ) );
+   generate_block();
+   BOOST_CHECK( amounts( hist.get_account_history( bob_id ) ) == vector<int64_t>( { 7, 6, 5 } ) );
+   BOOST_CHECK_EQUAL( entry_count( bob_id ), 3 );
+   BOOST_CHECK( db.find( shared ) == nullptr );
+   BOOST_CHECK( amounts( hist.get_account_history( carol_id ) ) == vector<int64_t>( { 7, 6, 5 } ) );
+   BOOST_CHECK( amounts( hist.get_relative_account_history( carol_id ) ) == vector<int64_t>( { 7, 6, 5 } ) );
 } FC_LOG_AND_RETHROW() }
 
 BOOST_FIXTURE_TEST_CASE( change_block_interval, database_fixture )
@@ -1237,6 +4181,116 @@ BOOST_AUTO_TEST_CASE( genesis_reserve_ids )
    }
 }
 
+BOOST_AUTO_TEST_CASE( large_binary_genesis )
+{
+   try {
+      genesis_state_type genesis = make_genesis();
+      const size_t plain_accounts = 500;
+      for( size_t i = 0; i < plain_accounts; ++i )
+      {
+         auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( "genesis-" + fc::to_string(i) ) ).get_public_key();
+         genesis.initial_accounts.emplace_back( "plain" + fc::to_string(i), key, i % 2 ? key : public_key_type(), false );
+      }
+      genesis.initial_chain_id = fc::sha256::hash( fc::json::to_string( genesis ) );
+
+      const std::string packed = pack_binary_genesis( genesis );
+      BOOST_REQUIRE( is_binary_genesis( packed ) );
+      BOOST_CHECK( !is_binary_genesis( fc::json::to_string( genesis ) ) );
+      genesis_state_type unpacked = unpack_binary_genesis( packed );
+      BOOST_CHECK( unpacked.initial_chain_id == genesis.initial_chain_id );
+      BOOST_CHECK( fc::json::to_string( unpacked ) == fc::json::to_string( genesis ) );
+      GRAPHENE_REQUIRE_THROW( unpack_binary_genesis( packed + "x" ), fc::exception );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db;
+      db.open( data_dir.path(), [&unpacked]{ return unpacked; } );
+
+      BOOST_CHECK( db.get_chain_id() == genesis.initial_chain_id );
+      BOOST_CHECK_EQUAL( db.get_dynamic_global_properties().accounts_registered_this_interval,
+                         genesis.initial_accounts.size() );
+
+      const auto& committee = account_id_type()(db);
+      const auto& accounts_by_name = db.get_index_type<account_index>().indices().get<by_name>();
+      for( const auto& initial : genesis.initial_accounts )
+      {
+         auto itr = accounts_by_name.find( initial.name );
+         BOOST_REQUIRE( itr != accounts_by_name.end() );
+         const account_object& acct = *itr;
+         BOOST_CHECK( acct.statistics(db).owner == acct.id );
+         BOOST_CHECK( acct.owner == authority( 1, initial.owner_key, 1 ) );
+         BOOST_CHECK( acct.is_lifetime_member() == initial.is_lifetime_member );
+         if( initial.is_lifetime_member )
+            continue;
+         BOOST_CHECK( acct.registrar == GRAPHENE_TEMP_ACCOUNT );
+         BOOST_CHECK( acct.referrer == committee.id );
+         BOOST_CHECK( acct.lifetime_referrer == committee.lifetime_referrer );
+         BOOST_CHECK_EQUAL( acct.network_fee_percentage, db.get_global_properties().parameters.network_percent_of_fee );
+         if( initial.active_key == public_key_type() )
+         {
+            BOOST_CHECK( acct.active == acct.owner );
+            BOOST_CHECK( acct.options.memo_key == initial.owner_key );
+         }
+         else
+            BOOST_CHECK( acct.active == authority( 1, initial.active_key, 1 ) );
+      }
+
+      // the chain runs on top of the directly created accounts
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")));
+      db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.head_block_num(), 1u );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( streamed_genesis_json )
+{
+   try {
+      genesis_state_type genesis = make_genesis();
+      for( uint32_t i = 0; i < 50; ++i )
+      {
+         auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( "genesis-" + fc::to_string(i) ) ).get_public_key();
+         genesis.initial_accounts.emplace_back( "name\\\"" + fc::to_string(i), key, key, i % 3 == 0 );
+         genesis_state_type::initial_balance_type bal;
+         bal.owner = address( key );
+         bal.asset_symbol = "CORE";
+         bal.amount = 1000 + i;
+         genesis.initial_balances.push_back( bal );
+         genesis_state_type::initial_vesting_balance_type vest;
+         vest.owner = bal.owner;
+         vest.asset_symbol = "CORE";
+         vest.amount = 2000 + i;
+         vest.begin_timestamp = genesis.initial_timestamp;
+         vest.vesting_duration_seconds = 3600 * i;
+         vest.begin_balance = 3000 + i;
+         genesis.initial_vesting_balances.push_back( vest );
+      }
+
+      const std::string compact = fc::json::to_string( genesis );
+      const std::string pretty = fc::json::to_pretty_string( genesis );
+      BOOST_CHECK( fc::json::to_string( parse_genesis_json( compact ) ) == compact );
+      BOOST_CHECK( fc::json::to_string( parse_genesis_json( pretty ) ) == compact );
+
+      // members may come in any order and the streamed arrays may be missing or empty
+      genesis_state_type partial = parse_genesis_json( "{ \"initial_balances\" : [ ],\"initial_active_witnesses\":3 }" );
+      BOOST_CHECK_EQUAL( partial.initial_active_witnesses, 3u );
+      BOOST_CHECK( partial.initial_accounts.empty() );
+      BOOST_CHECK( partial.initial_balances.empty() );
+
+      GRAPHENE_REQUIRE_THROW( parse_genesis_json( compact.substr( 0, compact.size() - 1 ) ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( parse_genesis_json( compact + "}" ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( parse_genesis_json( "{\"initial_accounts\":[{},]}" ), fc::exception );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
 {
    try
@@ -1257,4 +4311,491 @@ BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( forked_state_leaves_chain_alone, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( committee_account, alice_id, asset( 10000 ) );
+      generate_block();
+
+      std::unique_ptr<database> first = db.fork_state();
+      std::unique_ptr<database> second = db.fork_state();
+      BOOST_CHECK( first->head_block_id() == db.head_block_id() );
+      BOOST_CHECK_EQUAL( first->get_balance( alice_id, asset_id_type() ).amount.value, 10000 );
+
+      transfer_operation t;
+      t.from = alice_id;
+      t.to = bob_id;
+      t.amount = asset( 3000 );
+      signed_transaction trx;
+      set_expiration( db, trx );
+      trx.operations.push_back( t );
+      PUSH_TX( *first, trx, ~0 );
+
+      // only the copy the transfer was pushed to sees it
+      BOOST_CHECK_EQUAL( first->get_balance( bob_id, asset_id_type() ).amount.value, 3000 );
+      BOOST_CHECK_EQUAL( second->get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 10000 );
+
+      first->clear_pending();
+      BOOST_CHECK_EQUAL( first->get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+      BOOST_CHECK_EQUAL( first->get_balance( alice_id, asset_id_type() ).amount.value, 10000 );
+
+      // the chain keeps going and the copies keep their head block
+      PUSH_TX( db, trx, ~0 );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 3000 );
+      BOOST_CHECK_EQUAL( second->get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+      BOOST_CHECK( second->head_block_num() + 1 == db.head_block_num() );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( simulate_transactions_chain_in_order, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( committee_account, alice_id, asset( 10000 ) );
+      generate_block();
+
+      auto make_transfer = [&]( account_id_type from, account_id_type to, int64_t amount,
+                                const fc::ecc::private_key& key ) {
+         transfer_operation t;
+         t.from = from;
+         t.to = to;
+         t.amount = asset( amount );
+         signed_transaction trx;
+         set_expiration( db, trx );
+         trx.operations.push_back( t );
+         for( auto& op : trx.operations )
+            db.current_fee_schedule().set_fee( op );
+         sign( trx, key );
+         return trx;
+      };
+      // bob can only pay alice back with what the first transfer gives him
+      vector<signed_transaction> batch;
+      batch.push_back( make_transfer( alice_id, bob_id, 3000, alice_private_key ) );
+      batch.push_back( make_transfer( bob_id, alice_id, 1000, bob_private_key ) );
+      batch.push_back( make_transfer( alice_id, bob_id, 100000, alice_private_key ) );
+      // needs bob's signature
+      batch.push_back( make_transfer( bob_id, alice_id, 1, alice_private_key ) );
+
+      graphene::app::database_api api( db );
+      const auto results = api.simulate_transactions( batch );
+      BOOST_REQUIRE_EQUAL( results.size(), 4 );
+      BOOST_CHECK( results[0].success );
+      BOOST_CHECK( results[1].success );
+      BOOST_CHECK( !results[2].success );
+      BOOST_CHECK( !results[2].error.empty() );
+      BOOST_CHECK( !results[3].success );
+
+      BOOST_REQUIRE_EQUAL( results[0].fees.size(), 1 );
+      BOOST_CHECK( results[0].fees[0] == batch[0].operations[0].get<transfer_operation>().fee );
+      BOOST_CHECK( results[0].required_fees[0] == db.current_fee_schedule().calculate_fee( batch[0].operations[0] ) );
+      BOOST_CHECK_EQUAL( results[0].trx.operation_results.size(), 1 );
+      BOOST_REQUIRE_EQUAL( results[0].applied_operations.size(), 1 );
+      BOOST_CHECK( results[0].applied_operations[0].op.which() == operation::tag<transfer_operation>::value );
+      const auto& impacted = results[0].impacted_objects;
+      BOOST_CHECK( std::is_sorted( impacted.begin(), impacted.end() ) );
+      const object_id_type alice_balance = db.get_index_type<account_balance_index>().indices().get<by_account_asset>()
+                                           .find( boost::make_tuple( alice_id, asset_id_type() ) )->id;
+      BOOST_CHECK( std::binary_search( impacted.begin(), impacted.end(), alice_balance ) );
+
+      // nothing reached the chain
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 10000 );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+      BOOST_CHECK( db._pending_tx.empty() );
+
+      // the copy of the state is reused without what the earlier call applied to it
+      const auto again = api.simulate_transactions( batch );
+      BOOST_REQUIRE_EQUAL( again.size(), 4 );
+      BOOST_CHECK( again[0].success && again[1].success && !again[2].success && !again[3].success );
+      vector<signed_transaction> bob_pays{ make_transfer( bob_id, alice_id, 4000, bob_private_key ) };
+      BOOST_CHECK( !api.simulate_transactions( bob_pays )[0].success );
+
+      // another API shares the copy, so what became pending since it was made is not part of it
+      graphene::app::database_api other( db );
+      transfer( committee_account, bob_id, asset( 5000 ) );
+      BOOST_CHECK( !other.simulate_transactions( bob_pays )[0].success );
+
+      // and copied again for a new head block
+      generate_block();
+      BOOST_CHECK( api.simulate_transactions( bob_pays )[0].success );
+      BOOST_CHECK( other.simulate_transactions( bob_pays )[0].success );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_carried_over, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol)(dave) );
+   transfer( committee_account, alice_id, asset( 100000 ) );
+   transfer( committee_account, carol_id, asset( 100000 ) );
+   transfer( committee_account, bob_id, asset( 1 ) );
+   transfer( committee_account, dave_id, asset( 1 ) );
+   generate_block();
+
+   auto make_transfer = [&]( account_id_type from, account_id_type to, share_type amount ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      transfer_operation t;
+      t.from = from;
+      t.to = to;
+      t.amount = asset( amount );
+      db.current_fee_schedule().set_fee( t );
+      tx.operations.push_back( t );
+      return tx;
+   };
+   const uint32_t skip = database::skip_transaction_signatures | database::skip_authority_check;
+
+   // a block with a transfer of alice's arrives while another one of hers and one of carol's are pending
+   PUSH_TX( db, make_transfer( alice_id, bob_id, 1 ), skip );
+   signed_block candidate = db.assemble_block( db.get_slot_time(1), db.get_scheduled_witness(1), skip );
+   db.clear_pending();
+   PUSH_TX( db, make_transfer( alice_id, bob_id, 10 ), skip );
+   PUSH_TX( db, make_transfer( carol_id, dave_id, 100 ), skip );
+   const pending_pool_statistics before = db.get_pending_pool_statistics();
+   db.sign_and_push_block( candidate, init_account_priv_key, skip );
+
+   // the block changed the balance alice's pending transfer changes, carol's is taken over as it was
+   const pending_pool_statistics after = db.get_pending_pool_statistics();
+   BOOST_CHECK_EQUAL( after.transactions, 2 );
+   BOOST_CHECK_EQUAL( after.reapplied - before.reapplied, 1 );
+   BOOST_CHECK_EQUAL( after.carried_over - before.carried_over, 1 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 12 );
+   BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 101 );
+   BOOST_CHECK( db.is_known_transaction( candidate.transactions[0].id() ) );
+
+   // the transaction taken over was applied on the previous head, so the next block applies the pool again
+   generate_block( skip );
+   BOOST_CHECK( db.get_last_block_assembly().reapplied );
+   BOOST_CHECK_EQUAL( db.get_last_block_assembly().included, 2 );
+   BOOST_CHECK_EQUAL( db.get_pending_pool_statistics().transactions, 0 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 12 );
+   BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 101 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( prevalidate_transaction_checks, database_fixture )
+{ try {
+   ACTOR( bob );
+   generate_block();
+
+   auto make_transfer = [&]( fc::time_point_sec expiration ) {
+      signed_transaction tx;
+      transfer_operation t;
+      t.from = account_id_type();
+      t.to = bob_id;
+      t.amount = asset( 1 );
+      tx.operations.push_back( t );
+      tx.expiration = expiration;
+      return tx;
+   };
+   const auto max_expiration = db.get_global_properties().parameters.maximum_time_until_expiration;
+
+   for( uint32_t threads : { 0, 2 } )
+   {
+      db.set_signature_threads( threads );
+
+      signed_transaction good = make_transfer( db.head_block_time() + 30 );
+      sign( good, init_account_priv_key );
+      db.prevalidate_transaction( good );
+      // the keys stay with the transaction
+      BOOST_CHECK_EQUAL( good.get_signature_keys( db.get_chain_id() ).size(), 1 );
+
+      GRAPHENE_CHECK_THROW( db.prevalidate_transaction( make_transfer( db.head_block_time() - 1 ) ), fc::exception );
+      GRAPHENE_CHECK_THROW( db.prevalidate_transaction( make_transfer( db.head_block_time() + max_expiration + 1 ) ),
+                            fc::exception );
+      signed_transaction empty = make_transfer( db.head_block_time() + 30 );
+      empty.operations.clear();
+      GRAPHENE_CHECK_THROW( db.prevalidate_transaction( empty ), fc::exception );
+      signed_transaction duplicate_signature = good;
+      duplicate_signature.signatures.push_back( good.signatures[0] );
+      GRAPHENE_CHECK_THROW( db.prevalidate_transaction( duplicate_signature ), fc::exception );
+      // without signature checks the signatures are left alone
+      db.prevalidate_transaction( duplicate_signature, database::skip_transaction_signatures );
+   }
+   db.set_signature_threads( 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( prevalidation_leaves_state_alone, database_fixture )
+{ try {
+   ACTOR( bob );
+   generate_block();
+
+   vector<signed_transaction> trxs;
+   for( int64_t amount : { 1, 2 } )
+   {
+      signed_transaction tx;
+      transfer_operation t;
+      t.from = account_id_type();
+      t.to = bob_id;
+      t.amount = asset( amount );
+      tx.operations.push_back( t );
+      set_expiration( db, tx );
+      sign( tx, init_account_priv_key );
+      trxs.push_back( tx );
+   }
+   signed_block b;
+   b.previous = db.head_block_id();
+   b.timestamp = db.get_slot_time( 1 );
+   b.transactions.assign( trxs.begin(), trxs.end() );
+   b.transaction_merkle_root = b.calculate_merkle_root();
+
+   const size_t undo_states = db._undo_db.size();
+   const uint64_t created = db._undo_db.created_objects();
+   const uint64_t modified = db._undo_db.modified_objects();
+   const uint64_t removed = db._undo_db.removed_objects();
+   const size_t pending = db.pending_transaction_count();
+
+   db.set_signature_threads( 2 );
+   BOOST_CHECK( db.prevalidate_block( b ) );
+   db.wait_for_prevalidated_blocks();
+   for( const auto& tx : trxs )
+      db.prevalidate_transaction( tx );
+   db.set_signature_threads( 0 );
+   for( const auto& tx : trxs )
+      db.prevalidate_transaction( tx );
+
+   // the checks, on the signature threads or not, only read the transactions
+   BOOST_CHECK_EQUAL( db._undo_db.size(), undo_states );
+   BOOST_CHECK_EQUAL( db._undo_db.created_objects(), created );
+   BOOST_CHECK_EQUAL( db._undo_db.modified_objects(), modified );
+   BOOST_CHECK_EQUAL( db._undo_db.removed_objects(), removed );
+   BOOST_CHECK_EQUAL( db.pending_transaction_count(), pending );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 0 );
+   const auto& by_trx_id = db.get_index_type<transaction_index>().indices().get<by_trx_id>();
+   BOOST_CHECK( by_trx_id.find( trxs[0].id() ) == by_trx_id.end() );
+
+   // and applying them afterwards applies each of them once
+   db.set_signature_threads( 2 );
+   for( const auto& tx : trxs )
+      PUSH_TX( db, tx );
+   generate_block();
+   db.set_signature_threads( 0 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 3 );
+   BOOST_CHECK_EQUAL( db.pending_transaction_count(), 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( signature_work_on_shared_executor, database_fixture )
+{ try {
+   ACTOR( bob );
+   generate_block();
+
+   auto make_transfers = [&]( int64_t first, size_t count ) {
+      vector<signed_transaction> result;
+      for( size_t i = 0; i < count; ++i )
+      {
+         signed_transaction tx;
+         transfer_operation t;
+         t.from = account_id_type();
+         t.to = bob_id;
+         t.amount = asset( first + int64_t(i) );
+         tx.operations.push_back( t );
+         set_expiration( db, tx );
+         sign( tx, init_account_priv_key );
+         result.push_back( tx );
+      }
+      return result;
+   };
+
+   // at most two of the four prevalidations are on the executor at a time, the others wait for them
+   graphene::utilities::executor pool( 2 );
+   db.set_signature_threads( 2, &pool );
+
+   const auto trxs = make_transfers( 1, 3 );
+   signed_block b;
+   b.previous = db.head_block_id();
+   b.timestamp = db.get_slot_time( 1 );
+   b.transactions.assign( trxs.begin(), trxs.end() );
+   b.transaction_merkle_root = b.calculate_merkle_root();
+   for( uint32_t i = 0; i < 4; ++i )
+      BOOST_CHECK( db.prevalidate_block( b ) );
+   db.wait_for_prevalidated_blocks();
+   for( const auto& tx : trxs )
+      db.prevalidate_transaction( tx );
+   BOOST_CHECK_EQUAL( pool.queued(), 0 );
+
+   for( const auto& tx : make_transfers( 10, 3 ) )
+      PUSH_TX( db, tx );
+   generate_block();
+   db.set_signature_threads( 0 );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 10 + 11 + 12 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_index_reads, database_fixture )
+{ try {
+   ACTORS( (carol)(dave) );
+   transfer( committee_account, carol_id, asset( 100000 ) );
+   transfer( committee_account, dave_id, asset( 1 ) );
+   generate_block();
+
+   const uint32_t skip = database::skip_transaction_signatures | database::skip_authority_check;
+   auto make_create = [&]( const string& name, uint32_t earlier ) {
+      signed_transaction tx;
+      set_expiration( db, tx );
+      tx.expiration -= earlier;
+      account_create_operation op = make_account( name );
+      db.current_fee_schedule().set_fee( op );
+      tx.operations.push_back( op );
+      return tx;
+   };
+   signed_transaction carol_transfer;
+   set_expiration( db, carol_transfer );
+   transfer_operation t;
+   t.from = carol_id;
+   t.to = dave_id;
+   t.amount = asset( 100 );
+   db.current_fee_schedule().set_fee( t );
+   carol_transfer.operations.push_back( t );
+
+   // the block creates an account while accounts with its name and another one are pending; the pending ones
+   // looked their names up by name, not by id
+   PUSH_TX( db, make_create( "gamma", 0 ), skip );
+   signed_block candidate = db.assemble_block( db.get_slot_time(1), db.get_scheduled_witness(1), skip );
+   db.clear_pending();
+   PUSH_TX( db, make_create( "beta", 0 ), skip );
+   PUSH_TX( db, make_create( "gamma", 1 ), skip );
+   PUSH_TX( db, carol_transfer, skip );
+   const pending_pool_statistics before = db.get_pending_pool_statistics();
+   db.sign_and_push_block( candidate, init_account_priv_key, skip );
+
+   // the account creations are applied again and the second gamma fails, the transfer is taken over
+   const pending_pool_statistics after = db.get_pending_pool_statistics();
+   BOOST_CHECK_EQUAL( after.transactions, 2 );
+   BOOST_CHECK_EQUAL( after.reapplied - before.reapplied, 2 );
+   BOOST_CHECK_EQUAL( after.carried_over - before.carried_over, 1 );
+   const auto& by_name = db.get_index_type<account_index>().indices().get<by_name>();
+   BOOST_CHECK_EQUAL( by_name.count( "gamma" ), 1 );
+   BOOST_CHECK_EQUAL( by_name.count( "beta" ), 1 );
+   BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 101 );
+
+   generate_block( skip );
+   BOOST_CHECK_EQUAL( db.get_last_block_assembly().included, 2 );
+   BOOST_CHECK_EQUAL( db.get_index_type<account_index>().indices().get<by_name>().count( "beta" ), 1 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( confirmation_registry_dispatch, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( committee_account, alice_id, asset( 10000 ) );
+      generate_block();
+
+      graphene::app::confirmation_registry registry( db );
+      auto make_transfer = [&]( int64_t amount, fc::time_point_sec expiration ) {
+         transfer_operation t;
+         t.from = alice_id;
+         t.to = bob_id;
+         t.amount = asset( amount );
+         signed_transaction trx;
+         trx.operations.push_back( t );
+         trx.set_expiration( expiration );
+         return trx;
+      };
+      const signed_transaction included = make_transfer( 100, db.head_block_time() + fc::minutes( 1 ) );
+      const signed_transaction never = make_transfer( 200, db.head_block_time() + db.get_global_properties().parameters.block_interval );
+
+      // two connections wait for the same transaction, one of them is gone before the block
+      auto first = std::make_shared<int>( 1 );
+      auto second = std::make_shared<int>( 2 );
+      vector<graphene::app::transaction_confirmation> confirmations;
+      auto record = [&]( const fc::variant& v ) {
+         confirmations.push_back( v.as<graphene::app::transaction_confirmation>() );
+      };
+      registry.watch( included, first, record );
+      registry.watch( included, second, record );
+      registry.watch( never, first, record );
+      BOOST_CHECK_EQUAL( registry.size(), 3 );
+      second.reset();
+
+      PUSH_TX( db, included, ~0 );
+      generate_block();
+      fc::usleep( fc::milliseconds( 1 ) );
+      BOOST_REQUIRE_EQUAL( confirmations.size(), 1 );
+      BOOST_CHECK( confirmations[0].id == included.id() );
+      BOOST_CHECK_EQUAL( confirmations[0].block_num, db.head_block_num() );
+      BOOST_CHECK_EQUAL( confirmations[0].trx_num, 0 );
+      // the transaction that was not pushed waits until it expires
+      BOOST_CHECK_EQUAL( registry.size(), 1 );
+
+      generate_block();
+      BOOST_CHECK_EQUAL( registry.size(), 0 );
+      BOOST_CHECK_EQUAL( confirmations.size(), 1 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( change_stream_writes_block_changes, database_fixture )
+{
+   try {
+      ACTORS( (alice) );
+      generate_block();
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path file = data_dir.path() / "changes.json";
+      auto plugin = app.register_plugin<graphene::change_stream::change_stream_plugin>();
+      boost::program_options::variables_map options;
+      options.emplace( "change-stream-file", boost::program_options::variable_value( file.generic_string(), false ) );
+      options.emplace( "change-stream-flush-interval", boost::program_options::variable_value( uint32_t(1), false ) );
+      plugin->plugin_set_app( &app );
+      plugin->plugin_initialize( options );
+      plugin->plugin_startup();
+
+      transfer( account_id_type(), alice_id, asset( 1000 ) );
+      generate_block();
+      const uint32_t head = db.head_block_num();
+      const graphene::db::object_diff diff = db.undo_head_diff();
+      const object_id_type alice_balance = db.get_index_type<account_balance_index>().indices().get<by_account_asset>()
+                                           .find( boost::make_tuple( alice_id, asset_id_type() ) )->id;
+      db.pop_block();
+      plugin->plugin_shutdown();
+
+      std::ifstream in( file.generic_string() );
+      vector<fc::variant_object> records;
+      for( std::string line; std::getline( in, line ); )
+         records.push_back( fc::json::from_string( line ).get_object() );
+      BOOST_REQUIRE_EQUAL( records.size(), 2 );
+
+      // the applied line lists what undo_head_diff() holds for the block
+      const fc::variant_object& applied = records[0];
+      BOOST_CHECK_EQUAL( applied["block_num"].as_uint64(), head );
+      BOOST_CHECK( !applied.contains( "undo" ) );
+      vector<object_id_type> streamed;
+      for( const fc::variant& obj : applied["objects"].get_array() )
+         streamed.push_back( obj["id"].as<object_id_type>() );
+      for( const fc::variant& id : applied["removed"].get_array() )
+         streamed.push_back( id.as<object_id_type>() );
+      std::sort( streamed.begin(), streamed.end() );
+      vector<object_id_type> expected;
+      for( const auto& item : diff.objects )
+         expected.push_back( item.first );
+      BOOST_CHECK( streamed == expected );
+      BOOST_CHECK( std::find( streamed.begin(), streamed.end(), alice_balance ) != streamed.end() );
+
+      // popping the block writes an undo line for it
+      const fc::variant_object& undone = records[1];
+      BOOST_CHECK_EQUAL( undone["block_num"].as_uint64(), head );
+      BOOST_CHECK( undone["undo"].as_bool() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
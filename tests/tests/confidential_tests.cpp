@@ -130,6 +130,37 @@ BOOST_AUTO_TEST_CASE( confidential_test )
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( validated_confidential_transactions )
+{ try {
+   const asset_object& core = asset_id_type()(db);
+   auto owner_key = fc::ecc::private_key::generate();
+   auto blind = fc::sha256::hash("blind");
+
+   transfer_to_blind_operation to_blind;
+   to_blind.amount = core.amount(1000);
+   to_blind.from   = account_id_type();
+   to_blind.blinding_factor = blind;
+   blind_output out;
+   out.owner = authority( 1, public_key_type(owner_key.get_public_key()), 1 );
+   out.commitment = fc::ecc::blind( blind, 1000 );
+   to_blind.outputs = {out};
+
+   signed_transaction valid_trx;
+   valid_trx.operations = {to_blind};
+   set_expiration( db, valid_trx );
+
+   // the second validation is answered from the cache, with the same result
+   db.validate_transaction_stateless( valid_trx );
+   db.validate_transaction_stateless( valid_trx );
+
+   // a transaction differing in what validate() checks is a different transaction
+   signed_transaction invalid_trx = valid_trx;
+   invalid_trx.operations.front().get<transfer_to_blind_operation>().amount = core.amount(999);
+   GRAPHENE_REQUIRE_THROW( db.validate_transaction_stateless( invalid_trx ), fc::exception );
+   GRAPHENE_REQUIRE_THROW( db.validate_transaction_stateless( invalid_trx ), fc::exception );
+   db.validate_transaction_stateless( valid_trx );
+
+} FC_LOG_AND_RETHROW() }
 
 
 BOOST_AUTO_TEST_SUITE_END()
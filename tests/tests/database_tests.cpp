@@ -27,6 +27,10 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/chain/proposal_object.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
@@ -59,3 +63,392 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( index_snapshot_roundtrip )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      vector<account_balance_id_type> ids;
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         for( uint32_t i = 0; i < 100; ++i )
+         {
+            ids.push_back( db.create<account_balance_object>( [&]( account_balance_object& obj ){
+               obj.owner = account_id_type(i);
+               obj.balance = i * 1000;
+            }).id );
+         }
+         db.flush();
+      }
+
+      database db;
+      db.object_database::open( data_dir.path() );
+      for( uint32_t i = 0; i < ids.size(); ++i )
+      {
+         const auto& obj = ids[i](db);
+         BOOST_CHECK( obj.owner == account_id_type(i) );
+         BOOST_CHECK_EQUAL( obj.balance.value, int64_t(i) * 1000 );
+      }
+      const auto& next = db.create<account_balance_object>( []( account_balance_object& obj ){
+         obj.owner = account_id_type(1000);
+      });
+      BOOST_CHECK( next.id.instance() == ids.size() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_recovery )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path dir = data_dir.path() / "object_database";
+      account_balance_id_type id;
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         id = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 42; } ).id;
+         db.flush();
+      }
+      BOOST_CHECK( fc::exists( dir / "manifest.json" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "object_database.new" ) );
+
+      // a flush that stopped between its renames, with a new snapshot that never got its manifest
+      fc::rename( dir, data_dir.path() / "object_database.old" );
+      fc::create_directories( data_dir.path() / "object_database.new" / "1" );
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( id(db).balance.value, 42 );
+      }
+      BOOST_CHECK( fc::exists( dir / "manifest.json" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "object_database.old" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "object_database.new" ) );
+
+      // a damaged index is refused instead of loaded in part
+      const fc::path file = dir / fc::to_string( uint32_t( account_balance_object::space_id ) )
+                                / fc::to_string( uint32_t( account_balance_object::type_id ) );
+      {
+         std::fstream f( file.generic_string(), std::fstream::in | std::fstream::out | std::fstream::binary );
+         f.seekg( graphene::db::index_snapshot_header::page_size + 1 );
+         const char c = f.get();
+         f.seekp( graphene::db::index_snapshot_header::page_size + 1 );
+         f.put( ~c );
+      }
+      database db;
+      BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ), fc::exception );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( slab_allocator_reuse )
+{
+   try {
+      typedef slab_allocator<account_balance_object, account_balance_object> allocator_type;
+      allocator_type alloc;
+      const auto& stats = get_slab_stats<account_balance_object>();
+      const uint64_t objects_before = stats.allocated_objects;
+
+      account_balance_object* a = alloc.allocate( 1 );
+      account_balance_object* b = alloc.allocate( 1 );
+      BOOST_CHECK( a != b );
+      BOOST_CHECK_EQUAL( stats.allocated_objects, objects_before + 2 );
+      BOOST_CHECK( stats.reserved_bytes >= stats.allocated_bytes );
+
+      // freed blocks are handed out again before the pool grows
+      alloc.deallocate( b, 1 );
+      const uint64_t reserved = stats.reserved_bytes;
+      account_balance_object* c = alloc.allocate( 1 );
+      BOOST_CHECK( c == b );
+      BOOST_CHECK_EQUAL( stats.reserved_bytes, reserved );
+
+      alloc.deallocate( a, 1 );
+      alloc.deallocate( c, 1 );
+      BOOST_CHECK_EQUAL( stats.allocated_objects, objects_before );
+
+      database db;
+      db.create<account_balance_object>( []( account_balance_object& ){} );
+      BOOST_CHECK( db.get_index_type<account_balance_index>().allocated_bytes() > 0 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( undo_compaction )
+{
+   try {
+      database db;
+      db._undo_db.set_compaction_depth( 2 );
+      const auto& bal = db.create<account_balance_object>( []( account_balance_object& ){} );
+      for( int i = 0; i < 5; ++i )
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( bal, []( account_balance_object& b ){ b.balance += 1; } );
+         session.commit();
+      }
+      BOOST_CHECK_EQUAL( db._undo_db.size(), 3 );
+      BOOST_CHECK_EQUAL( db._undo_db.undoable_size(), 2 );
+
+      db._undo_db.pop_commit();
+      db._undo_db.pop_commit();
+      BOOST_CHECK_EQUAL( bal.balance.value, 3 );
+      // the remaining state covers several sessions and cannot be popped on its own
+      BOOST_CHECK_THROW( db._undo_db.pop_commit(), fc::exception );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( undo_head_diff_roundtrip )
+{
+   try {
+      database source;
+      database copy;
+      for( database* db : { &source, &copy } )
+         for( uint32_t i = 0; i < 3; ++i )
+            db->create<account_balance_object>( [i]( account_balance_object& obj ){
+               obj.owner = account_id_type(i);
+               obj.balance = 10;
+            });
+
+      {
+         auto session = source._undo_db.start_undo_session();
+         source.modify( account_balance_id_type(0)(source), []( account_balance_object& b ){ b.balance = 20; } );
+         source.remove( account_balance_id_type(1)(source) );
+         // removed objects hand their unique keys over
+         source.create<account_balance_object>( []( account_balance_object& obj ){
+            obj.owner = account_id_type(1);
+            obj.balance = 30;
+         });
+         session.commit();
+      }
+      const graphene::db::object_diff diff = source.undo_head_diff();
+      BOOST_CHECK_EQUAL( diff.objects.size(), 3 );
+      BOOST_CHECK_EQUAL( diff.next_ids.size(), 1 );
+
+      auto session = copy._undo_db.start_undo_session();
+      copy.apply_diff( fc::raw::unpack<graphene::db::object_diff>( fc::raw::pack( diff ) ) );
+      BOOST_CHECK_EQUAL( account_balance_id_type(0)(copy).balance.value, 20 );
+      BOOST_CHECK( !copy.find( account_balance_id_type(1) ) );
+      BOOST_CHECK_EQUAL( account_balance_id_type(3)(copy).balance.value, 30 );
+      BOOST_CHECK( copy.state_hash() == source.state_hash() );
+
+      // the changes went through the undo database
+      session.undo();
+      BOOST_CHECK_EQUAL( account_balance_id_type(0)(copy).balance.value, 10 );
+      BOOST_CHECK( copy.find( account_balance_id_type(1) ) );
+      BOOST_CHECK( !copy.find( account_balance_id_type(3) ) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( disable_api_indexes )
+{
+   try {
+      database db;
+      const auto& accounts = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() );
+      const auto& proposals = dynamic_cast<const primary_index<proposal_index>&>( db.get_index_type<proposal_index>() );
+      BOOST_CHECK( accounts.find_secondary_index<account_member_index>() != nullptr );
+
+      db.disable_api_indexes();
+      BOOST_CHECK( accounts.find_secondary_index<account_member_index>() == nullptr );
+      BOOST_CHECK( accounts.find_secondary_index<account_referrer_index>() == nullptr );
+      BOOST_CHECK( proposals.find_secondary_index<required_approval_index>() == nullptr );
+      BOOST_CHECK_THROW( accounts.get_secondary_index<account_member_index>(), fc::assert_exception );
+      // the indexes evaluation needs stay
+      BOOST_CHECK( accounts.find_secondary_index<account_authority_index>() != nullptr );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( account_member_index_modify )
+{
+   try {
+      database db;
+      const auto& accounts = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() );
+      const auto& members = accounts.get_secondary_index<account_member_index>();
+      const public_key_type key1 = fc::ecc::private_key::regenerate( fc::sha256::hash( string("key1") ) ).get_public_key();
+      const public_key_type key2 = fc::ecc::private_key::regenerate( fc::sha256::hash( string("key2") ) ).get_public_key();
+
+      const auto& acct = db.create<account_object>( [&]( account_object& a ) {
+         a.owner = authority( 1, key1, 1 );
+         a.active = authority( 1, account_id_type(5), 1 );
+         a.options.memo_key = key1;
+      });
+      BOOST_CHECK_EQUAL( members.account_to_key_memberships.at( key1 ).count( acct.id ), 1u );
+      BOOST_CHECK_EQUAL( members.account_to_account_memberships.at( account_id_type(5) ).count( acct.id ), 1u );
+
+      // a change that leaves the authorities alone keeps the memberships
+      db.modify( acct, []( account_object& a ) { a.name = "renamed"; } );
+      BOOST_CHECK_EQUAL( members.account_to_key_memberships.at( key1 ).count( acct.id ), 1u );
+      BOOST_CHECK_EQUAL( members.account_to_account_memberships.at( account_id_type(5) ).count( acct.id ), 1u );
+
+      // key1 is still the memo key after it leaves the owner authority
+      db.modify( acct, [&]( account_object& a ) {
+         a.owner = authority( 1, key2, 1 );
+         a.active = authority( 1, account_id_type(6), 1 );
+      });
+      BOOST_CHECK_EQUAL( members.account_to_key_memberships.at( key1 ).count( acct.id ), 1u );
+      BOOST_CHECK_EQUAL( members.account_to_key_memberships.at( key2 ).count( acct.id ), 1u );
+      BOOST_CHECK_EQUAL( members.account_to_account_memberships.at( account_id_type(5) ).count( acct.id ), 0u );
+      BOOST_CHECK_EQUAL( members.account_to_account_memberships.at( account_id_type(6) ).count( acct.id ), 1u );
+
+      db.modify( acct, [&]( account_object& a ) { a.options.memo_key = key2; } );
+      BOOST_CHECK_EQUAL( members.account_to_key_memberships.at( key1 ).count( acct.id ), 0u );
+      BOOST_CHECK_EQUAL( members.account_to_address_memberships.at( address( key1 ) ).count( acct.id ), 0u );
+      BOOST_CHECK_EQUAL( members.account_to_address_memberships.at( address( key2 ) ).count( acct.id ), 1u );
+
+      db.remove( acct );
+      BOOST_CHECK( members.account_to_key_memberships.at( key2 ).empty() );
+      BOOST_CHECK( members.account_to_account_memberships.at( account_id_type(6) ).empty() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( modify_non_key )
+{
+   try {
+      database db;
+      db._undo_db.enable();
+      const auto& by_price = db.get_index_type<limit_order_index>().indices().get<by_price>();
+      const auto& cheap = db.create<limit_order_object>( []( limit_order_object& o ) {
+         o.for_sale = 10;
+         o.sell_price = price( asset( 1 ), asset( 1, asset_id_type(1) ) );
+      });
+      const auto& dear = db.create<limit_order_object>( []( limit_order_object& o ) {
+         o.for_sale = 20;
+         o.sell_price = price( asset( 2 ), asset( 1, asset_id_type(1) ) );
+      });
+      BOOST_CHECK( by_price.begin()->id == dear.id );
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify_non_key<limit_order_index>( cheap, []( limit_order_object& o ) { o.for_sale = 5; } );
+         BOOST_CHECK_EQUAL( cheap.for_sale.value, 5 );
+
+         // changing a key needs the re-keying modify
+         db.modify_typed<limit_order_index>( cheap, []( limit_order_object& o ) {
+            o.sell_price = price( asset( 3 ), asset( 1, asset_id_type(1) ) );
+         });
+         BOOST_CHECK( by_price.begin()->id == cheap.id );
+      }
+      // both went through the undo database
+      BOOST_CHECK_EQUAL( cheap.for_sale.value, 10 );
+      BOOST_CHECK( by_price.begin()->id == dear.id );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( index_statistics )
+{
+   try {
+      database db;
+      db._undo_db.enable();
+      auto session = db._undo_db.start_undo_session();
+      const auto& bal = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 5; } );
+      db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(1); } );
+      session.commit();
+      const uint64_t bal_bytes = bal.memory_size();
+      auto session2 = db._undo_db.start_undo_session();
+      db.modify( bal, []( account_balance_object& b ){ b.balance += 1; } );
+      db.remove( bal );
+
+      const auto stats = db.get_index_statistics();
+      auto itr = std::find_if( stats.begin(), stats.end(), []( const graphene::db::index_statistics& s ){
+         return s.space_id == account_balance_object::space_id && s.type_id == account_balance_object::type_id;
+      });
+      BOOST_REQUIRE( itr != stats.end() );
+      BOOST_CHECK_EQUAL( itr->objects, 1 );
+      BOOST_CHECK_EQUAL( itr->creates, 2 );
+      BOOST_CHECK_EQUAL( itr->modifies, 1 );
+      BOOST_CHECK_EQUAL( itr->removes, 1 );
+      BOOST_CHECK( itr->estimated_bytes >= sizeof(account_balance_object) );
+      BOOST_CHECK( itr->secondary_indexes > 0 );
+      // the first state only created objects, the second holds the removed balance
+      BOOST_REQUIRE_EQUAL( itr->undo_bytes.size(), db._undo_db.states().size() );
+      BOOST_CHECK_EQUAL( itr->undo_bytes.front(), 0 );
+      BOOST_CHECK_EQUAL( itr->undo_bytes.back(), bal_bytes );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( paged_index_pages_idle_objects )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      database db;
+      db._undo_db.enable();
+      auto& idx = const_cast<account_statistics_index&>( db.get_index_type<account_statistics_index>() );
+      idx.set_paging( data_dir.path() / "account_statistics.pages", 1 );
+
+      const auto idle_id = db.create<account_statistics_object>( []( account_statistics_object& s ) {
+         s.total_core_in_orders = 7;
+      }).id;
+      const auto& busy = db.create<account_statistics_object>( []( account_statistics_object& s ) {
+         s.total_core_in_orders = 3;
+      });
+      const auto busy_id = busy.id;
+
+      idx.page_out();
+      BOOST_CHECK_EQUAL( idx.paged_objects(), 0u );
+      db.modify( busy, []( account_statistics_object& s ) { s.total_core_in_orders += 1; } );
+      idx.page_out();
+      BOOST_CHECK_EQUAL( idx.paged_objects(), 1u );
+
+      // inspecting leaves the object paged out, finding it reads it back
+      share_type total;
+      idx.inspect_all_objects( [&total]( const graphene::db::object& o ) {
+         total += static_cast<const account_statistics_object&>( o ).total_core_in_orders;
+      });
+      BOOST_CHECK_EQUAL( total.value, 11 );
+      BOOST_CHECK_EQUAL( idx.paged_objects(), 1u );
+      const auto& idle = db.get<account_statistics_object>( idle_id );
+      BOOST_CHECK_EQUAL( idle.total_core_in_orders.value, 7 );
+      BOOST_CHECK_EQUAL( idx.paged_objects(), 0u );
+
+      // an object paged out in between is restored by undo through find()
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( idle, []( account_statistics_object& s ) { s.total_core_in_orders = 9; } );
+         idx.page_out();
+         idx.page_out();
+         idx.page_out();
+         BOOST_CHECK_EQUAL( idx.paged_objects(), 2u );
+      }
+      BOOST_CHECK_EQUAL( db.get<account_statistics_object>( idle_id ).total_core_in_orders.value, 7 );
+      BOOST_CHECK_EQUAL( db.get<account_statistics_object>( busy_id ).total_core_in_orders.value, 4 );
+
+      idx.set_paging( fc::path(), 0 );
+      BOOST_CHECK_EQUAL( idx.paged_objects(), 0u );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "account_statistics.pages" ) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
@@ -339,7 +339,7 @@ BOOST_AUTO_TEST_CASE( cashback_test )
       op.referrer = referrer_name ## _id; \
       op.referrer_percent = referrer_rate*GRAPHENE_1_PERCENT; \
       op.name = BOOST_PP_STRINGIZE(actor_name); \
-      op.options.memo_key = actor_name ## _private_key.get_public_key(); \
+      op.options->memo_key = actor_name ## _private_key.get_public_key(); \
       op.active = authority(1, public_key_type(actor_name ## _private_key.get_public_key()), 1); \
       op.owner = op.active; \
       op.fee = fees->calculate_fee(op); \
@@ -602,6 +602,36 @@ BOOST_AUTO_TEST_CASE( account_create_fee_scaling )
    BOOST_CHECK_EQUAL(db.get_global_properties().parameters.current_fees->get<account_create_operation>().basic_fee, 1);
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( pending_fees_index )
+{ try {
+   ACTORS((alice)(bob));
+   transfer( committee_account, alice_id, _core(1000000) );
+   enable_fees();
+   generate_block();
+
+   const auto& pending_fees = dynamic_cast< const primary_index< account_statistics_index >& >(
+         db.get_index_type< account_statistics_index >() ).get_secondary_index< account_pending_fees_index >();
+   auto pending = [&]( account_id_type id ) { return pending_fees.accounts_with_pending_fees().count( id ) > 0; };
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK( pending_fees.accounts_with_pending_fees().empty() );
+
+   transfer( alice_id, bob_id, _core(1000) );
+   BOOST_CHECK( pending( alice_id ) );
+   BOOST_CHECK( !pending( bob_id ) );
+   const share_type paid = alice_id(db).statistics(db).pending_fees + alice_id(db).statistics(db).pending_vested_fees;
+   BOOST_REQUIRE( paid > 0 );
+   const share_type lifetime_before = alice_id(db).statistics(db).lifetime_fees_paid;
+
+   // the pending transaction is undone and applied again in the block
+   generate_block();
+   BOOST_CHECK( pending( alice_id ) );
+
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK( pending_fees.accounts_with_pending_fees().empty() );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).pending_fees.value, 0 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).lifetime_fees_paid.value, ( lifetime_before + paid ).value );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( fee_refund_test )
 {
    try
@@ -943,4 +973,28 @@ BOOST_AUTO_TEST_CASE( stealth_fba_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( fee_parameters_lookup )
+{
+   fee_schedule schedule = fee_schedule::get_default();
+   schedule.get<transfer_operation>().fee = 123;
+   schedule.get<account_create_operation>().basic_fee = 456;
+   BOOST_CHECK_EQUAL( schedule.get<transfer_operation>().fee, 123u );
+   BOOST_CHECK_EQUAL( schedule.get<account_create_operation>().basic_fee, 456u );
+
+   transfer_operation top;
+   BOOST_CHECK_EQUAL( schedule.calculate_fee( top ).amount.value, 123 );
+
+   // a schedule without some operations is searched instead of indexed
+   fee_schedule partial;
+   for( const fee_parameters& p : schedule.parameters )
+      if( p.which() != operation::tag<transfer_operation>::value )
+         partial.parameters.insert( p );
+   BOOST_CHECK( partial.find_parameters( operation::tag<transfer_operation>::value ) == nullptr );
+   BOOST_CHECK_EQUAL( partial.get<account_create_operation>().basic_fee, 456u );
+   BOOST_CHECK_THROW( partial.get<transfer_operation>(), fc::exception );
+   // operations without parameters are charged the defaults
+   BOOST_CHECK_EQUAL( partial.calculate_fee( top ).amount.value,
+                      int64_t( transfer_operation::fee_parameters_type().fee ) );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -36,6 +36,7 @@
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/witness_object.hpp>
 
+#include <fc/bitutil.hpp>
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -229,6 +230,49 @@ BOOST_AUTO_TEST_CASE( margin_call_limit_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( margin_call_after_unchanged_checks )
+{ try {
+      generate_blocks( HARDFORK_436_TIME );
+      generate_block();
+
+      ACTORS((borrower)(borrower2)(feedproducer));
+
+      const auto& bitusd = create_bitasset("USDBIT", feedproducer_id);
+      const auto& core   = asset_id_type()(db);
+
+      transfer(committee_account, borrower_id, asset(1000000));
+      transfer(committee_account, borrower2_id, asset(1000000));
+      update_feed_producers( bitusd, {feedproducer.id} );
+
+      price_feed current_feed;
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(100);
+      publish_feed( bitusd, feedproducer, current_feed );
+
+      borrow( borrower, bitusd.amount(1000), asset(2000) );
+      borrow( borrower2, bitusd.amount(1000), asset(4000) );
+
+      // nothing changes between these checks, the second one is answered from the cache
+      BOOST_CHECK( !db.check_call_orders( bitusd ) );
+      BOOST_CHECK( !db.check_call_orders( bitusd ) );
+
+      // the new feed puts borrower below the maintenance collateral ratio, there is nobody to buy from yet
+      current_feed.settlement_price = bitusd.amount( 100 ) / core.amount(150);
+      publish_feed( bitusd, feedproducer, current_feed );
+      BOOST_CHECK( !db.check_call_orders( bitusd ) );
+      BOOST_CHECK( db.find( borrower.id(db).id ) );
+
+      // a new limit order selling bitusd changes the book, so the call is matched against it
+      auto order = create_sell_order( borrower2, bitusd.amount(1000), core.amount(1100) );
+      BOOST_CHECK( order == nullptr );
+      BOOST_CHECK_EQUAL( get_balance( borrower2, core ), 1000000 - 4000 + 1100 );
+      BOOST_CHECK_EQUAL( get_balance( borrower, bitusd ), 1000 );
+      BOOST_CHECK_EQUAL( get_balance( borrower, core ), 1000000 - 1100 );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 /**
  *  This test sets up the minimum condition for a black swan to occur but does
  *  not test the full range of cases that may be possible during a black swan.
@@ -284,6 +328,44 @@ BOOST_AUTO_TEST_CASE( black_swan )
  * Black swan occurs when price feed falls, triggered by settlement
  * order.
  */
+BOOST_AUTO_TEST_CASE( pending_settlement_canceled_by_black_swan )
+{ try {
+      ACTORS((borrower)(settler)(feeder));
+
+      const auto& bitusd = create_bitasset("USDBIT", feeder_id);
+      const auto& core   = asset_id_type()(db);
+      const auto& settlements = db.get_index_type<force_settlement_index>().indices().get<by_expiration>();
+
+      transfer( committee_account, borrower_id, asset(1000000) );
+      update_feed_producers( bitusd, {feeder.id} );
+
+      price_feed feed;
+      feed.settlement_price = bitusd.amount( 1 ) / core.amount( 5 );
+      publish_feed( bitusd, feeder, feed );
+
+      borrow( borrower, bitusd.amount(100), asset(1000) );
+      transfer( borrower, settler, bitusd.amount(100) );
+      force_settle( settler, bitusd.amount(100) );
+      BOOST_CHECK_EQUAL( get_balance( settler, bitusd ), 0 );
+
+      // the settlement is not due yet, so blocks leave it alone
+      generate_block();
+      BOOST_CHECK_EQUAL( settlements.size(), 1 );
+
+      feed.settlement_price = bitusd.amount( 1 ) / core.amount( 50 );
+      publish_feed( bitusd, feeder, feed );
+      BOOST_CHECK( bitusd.bitasset_data(db).has_settlement() );
+
+      // the black swan cancels it at the next block, long before its settlement date
+      generate_block();
+      BOOST_CHECK( settlements.empty() );
+      BOOST_CHECK_EQUAL( get_balance( settler, bitusd ), 100 );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( black_swan_issue_346 )
 { try {
       ACTORS((buyer)(seller)(borrower)(borrower2)(settler)(feeder));
@@ -456,10 +538,10 @@ BOOST_AUTO_TEST_CASE( create_account_test )
       REQUIRE_THROW_WITH_VALUE(op, name, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
       REQUIRE_THROW_WITH_VALUE(op, name, "aaaa.");
       REQUIRE_THROW_WITH_VALUE(op, name, ".aaaa");
-      REQUIRE_THROW_WITH_VALUE(op, options.voting_account, account_id_type(999999999));
+      REQUIRE_THROW_WITH_VALUE(op, options->voting_account, account_id_type(999999999));
 
       auto auth_bak = op.owner;
-      op.owner.add_authority(account_id_type(9999999999), 10);
+      op.owner->add_authority(account_id_type(9999999999), 10);
       trx.operations.back() = op;
       op.owner = auth_bak;
       GRAPHENE_REQUIRE_THROW(PUSH_TX( db, trx, ~0 ), fc::exception);
@@ -641,7 +723,7 @@ BOOST_AUTO_TEST_CASE( update_mia )
 
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
-      std::swap(op.new_options.flags, op.new_options.issuer_permissions);
+      std::swap(op.new_options->flags, op.new_options->issuer_permissions);
       op.new_issuer = account_id_type();
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
@@ -690,12 +772,12 @@ BOOST_AUTO_TEST_CASE( create_uia )
       creator.issuer = account_id_type();
       creator.fee = asset();
       creator.symbol = "TEST";
-      creator.common_options.max_supply = 100000000;
+      creator.common_options->max_supply = 100000000;
       creator.precision = 2;
-      creator.common_options.market_fee_percent = GRAPHENE_MAX_MARKET_FEE_PERCENT/100; /*1%*/
-      creator.common_options.issuer_permissions = UIA_ASSET_ISSUER_PERMISSION_MASK;
-      creator.common_options.flags = charge_market_fee;
-      creator.common_options.core_exchange_rate = price({asset(2),asset(1,asset_id_type(1))});
+      creator.common_options->market_fee_percent = GRAPHENE_MAX_MARKET_FEE_PERCENT/100; /*1%*/
+      creator.common_options->issuer_permissions = UIA_ASSET_ISSUER_PERMISSION_MASK;
+      creator.common_options->flags = charge_market_fee;
+      creator.common_options->core_exchange_rate = price({asset(2),asset(1,asset_id_type(1))});
       trx.operations.push_back(std::move(creator));
       PUSH_TX( db, trx, ~0 );
 
@@ -716,8 +798,8 @@ BOOST_AUTO_TEST_CASE( create_uia )
       auto op = trx.operations.back().get<asset_create_operation>();
       op.symbol = "TESTFAIL";
       REQUIRE_THROW_WITH_VALUE(op, issuer, account_id_type(99999999));
-      REQUIRE_THROW_WITH_VALUE(op, common_options.max_supply, -1);
-      REQUIRE_THROW_WITH_VALUE(op, common_options.max_supply, 0);
+      REQUIRE_THROW_WITH_VALUE(op, common_options->max_supply, -1);
+      REQUIRE_THROW_WITH_VALUE(op, common_options->max_supply, 0);
       REQUIRE_THROW_WITH_VALUE(op, symbol, "A");
       REQUIRE_THROW_WITH_VALUE(op, symbol, "qqq");
       REQUIRE_THROW_WITH_VALUE(op, symbol, "11");
@@ -725,8 +807,8 @@ BOOST_AUTO_TEST_CASE( create_uia )
       REQUIRE_THROW_WITH_VALUE(op, symbol, "AAA.");
       REQUIRE_THROW_WITH_VALUE(op, symbol, "AB CD");
       REQUIRE_THROW_WITH_VALUE(op, symbol, "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
-      REQUIRE_THROW_WITH_VALUE(op, common_options.core_exchange_rate, price({asset(-100), asset(1)}));
-      REQUIRE_THROW_WITH_VALUE(op, common_options.core_exchange_rate, price({asset(100),asset(-1)}));
+      REQUIRE_THROW_WITH_VALUE(op, common_options->core_exchange_rate, price({asset(-100), asset(1)}));
+      REQUIRE_THROW_WITH_VALUE(op, common_options->core_exchange_rate, price({asset(100),asset(-1)}));
    } catch(fc::exception& e) {
       edump((e.to_detail_string()));
       throw;
@@ -754,15 +836,15 @@ BOOST_AUTO_TEST_CASE( update_uia )
 
       //Cannot convert to an MIA
       BOOST_TEST_MESSAGE( "Make sure we can't convert UIA to MIA" );
-      REQUIRE_THROW_WITH_VALUE(op, new_options.issuer_permissions, ASSET_ISSUER_PERMISSION_MASK);
-      REQUIRE_THROW_WITH_VALUE(op, new_options.core_exchange_rate, price(asset(5), asset(5)));
+      REQUIRE_THROW_WITH_VALUE(op, new_options->issuer_permissions, ASSET_ISSUER_PERMISSION_MASK);
+      REQUIRE_THROW_WITH_VALUE(op, new_options->core_exchange_rate, price(asset(5), asset(5)));
 
       BOOST_TEST_MESSAGE( "Test updating core_exchange_rate" );
-      op.new_options.core_exchange_rate = price(asset(3), test.amount(5));
+      op.new_options->core_exchange_rate = price(asset(3), test.amount(5));
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
-      REQUIRE_THROW_WITH_VALUE(op, new_options.core_exchange_rate, price());
-      op.new_options.core_exchange_rate = test.options.core_exchange_rate;
+      REQUIRE_THROW_WITH_VALUE(op, new_options->core_exchange_rate, price());
+      op.new_options->core_exchange_rate = test.options.core_exchange_rate;
       op.new_issuer = nathan.id;
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
@@ -770,31 +852,31 @@ BOOST_AUTO_TEST_CASE( update_uia )
       BOOST_TEST_MESSAGE( "Test setting flags" );
       op.issuer = nathan.id;
       op.new_issuer.reset();
-      op.new_options.flags = transfer_restricted | white_list;
+      op.new_options->flags = transfer_restricted | white_list;
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
 
       BOOST_TEST_MESSAGE( "Disable white_list permission" );
-      op.new_options.issuer_permissions = test.options.issuer_permissions & ~white_list;
+      op.new_options->issuer_permissions = test.options.issuer_permissions & ~white_list;
       trx.operations.back() = op;
       PUSH_TX( db, trx, ~0 );
 
       BOOST_TEST_MESSAGE( "Can't toggle white_list" );
-      REQUIRE_THROW_WITH_VALUE(op, new_options.flags, test.options.flags & ~white_list);
+      REQUIRE_THROW_WITH_VALUE(op, new_options->flags, test.options.flags & ~white_list);
 
       BOOST_TEST_MESSAGE( "Can toggle transfer_restricted" );
       for( int i=0; i<2; i++ )
       {
-         op.new_options.flags = test.options.flags ^ transfer_restricted;
+         op.new_options->flags = test.options.flags ^ transfer_restricted;
          trx.operations.back() = op;
          PUSH_TX( db, trx, ~0 );
       }
 
       BOOST_TEST_MESSAGE( "Make sure white_list can't be re-enabled" );
-      op.new_options.issuer_permissions = test.options.issuer_permissions;
-      op.new_options.flags = test.options.flags;
+      op.new_options->issuer_permissions = test.options.issuer_permissions;
+      op.new_options->flags = test.options.flags;
       BOOST_CHECK(!(test.options.issuer_permissions & white_list));
-      REQUIRE_THROW_WITH_VALUE(op, new_options.issuer_permissions, UIA_ASSET_ISSUER_PERMISSION_MASK);
+      REQUIRE_THROW_WITH_VALUE(op, new_options->issuer_permissions, UIA_ASSET_ISSUER_PERMISSION_MASK);
 
       BOOST_TEST_MESSAGE( "We can change issuer to account_id_type(), but can't do it again" );
       op.new_issuer = account_id_type();
@@ -1133,6 +1215,115 @@ BOOST_AUTO_TEST_CASE( cancel_limit_order_test )
  }
 }
 
+BOOST_AUTO_TEST_CASE( order_book_levels )
+{ try {
+   INVOKE( issue_uia );
+   const asset_object&   test_asset     = get_asset( "TEST" );
+   const asset_object&   core_asset     = asset_id_type()(db);
+   const account_object& nathan_account = get_account( "nathan" );
+   const account_object& buyer_account  = create_account( "buyer" );
+
+   transfer( committee_account(db), buyer_account, asset( 10000 ) );
+
+   const auto& idx = dynamic_cast<const primary_index<limit_order_index>&>( db.get_index_type<limit_order_index>() );
+   const auto& book = idx.get_secondary_index<limit_order_book_index>();
+   BOOST_CHECK( book.get_levels( core_asset.id, test_asset.id ) == nullptr );
+
+   create_sell_order( buyer_account, asset(100), test_asset.amount(100) );
+   auto second = create_sell_order( buyer_account, asset(200), test_asset.amount(200) );
+   create_sell_order( buyer_account, asset(100), test_asset.amount(200) );
+
+   // orders at the same price share one level, the best price for the buyer of core comes first
+   const auto* levels = book.get_levels( core_asset.id, test_asset.id );
+   BOOST_REQUIRE( levels != nullptr );
+   BOOST_REQUIRE_EQUAL( levels->size(), 2 );
+   BOOST_CHECK_EQUAL( levels->begin()->second.orders, 2 );
+   BOOST_CHECK_EQUAL( levels->begin()->second.for_sale.value, 300 );
+   BOOST_CHECK_EQUAL( levels->rbegin()->second.orders, 1 );
+   BOOST_CHECK_EQUAL( levels->rbegin()->second.for_sale.value, 100 );
+
+   {
+      // filling and cancelling orders is reflected in the levels and undone with them
+      auto session = db._undo_db.start_undo_session();
+      create_sell_order( nathan_account, test_asset.amount(150), asset(150) );
+      BOOST_CHECK_EQUAL( levels->begin()->second.for_sale.value, 150 );
+      cancel_limit_order( *second );
+      BOOST_CHECK_EQUAL( levels->size(), 1 );
+   }
+   levels = book.get_levels( core_asset.id, test_asset.id );
+   BOOST_REQUIRE( levels != nullptr );
+   BOOST_CHECK_EQUAL( levels->size(), 2 );
+   BOOST_CHECK_EQUAL( levels->begin()->second.orders, 2 );
+   BOOST_CHECK_EQUAL( levels->begin()->second.for_sale.value, 300 );
+ }
+ catch ( const fc::exception& e )
+ {
+    elog( "${e}", ("e", e.to_detail_string() ) );
+    throw;
+ }
+}
+
+BOOST_AUTO_TEST_CASE( order_book_deltas )
+{ try {
+   INVOKE( issue_uia );
+   const asset_object&   test_asset     = get_asset( "TEST" );
+   const asset_object&   core_asset     = asset_id_type()(db);
+   const account_object& buyer_account  = create_account( "buyer" );
+   transfer( committee_account(db), buyer_account, asset( 10000 ) );
+
+   const auto& idx = dynamic_cast<const primary_index<limit_order_index>&>( db.get_index_type<limit_order_index>() );
+   const auto& book = idx.get_secondary_index<limit_order_book_index>();
+   const auto market = std::make_pair( asset_id_type(), test_asset.get_id() );
+
+   // a block id of number num, fork tells the blocks of the same number apart
+   auto block = []( uint32_t num, uint32_t fork ) {
+      block_id_type id;
+      id._hash[0] = fc::endian_reverse_u32( num );
+      id._hash[1] = fork;
+      return id;
+   };
+
+   // changes are only collected once someone asked for them
+   BOOST_CHECK( book.get_deltas( block( 1000, 0 ), 0 ).empty() );
+   create_sell_order( buyer_account, asset(100), test_asset.amount(100) );
+   create_sell_order( buyer_account, asset(200), test_asset.amount(200) );
+   auto other = create_sell_order( buyer_account, asset(100), test_asset.amount(200) );
+
+   const auto& deltas = book.get_deltas( block( 1001, 0 ), 0 );
+   BOOST_REQUIRE_EQUAL( deltas.size(), 1 );
+   auto levels = deltas.at( market ).as< vector<order_book_delta> >();
+   BOOST_REQUIRE_EQUAL( levels.size(), 2 );
+   for( const auto& level : levels )
+   {
+      BOOST_CHECK( level.sell_price.base.asset_id == core_asset.id );
+      BOOST_CHECK_EQUAL( level.for_sale.value, level.orders == 2 ? 300 : 100 );
+   }
+   // the same block is not collected again
+   BOOST_CHECK_EQUAL( book.get_deltas( block( 1001, 0 ), 0 ).size(), 1 );
+
+   cancel_limit_order( *other );
+   levels = book.get_deltas( block( 1002, 0 ), 0 ).at( market ).as< vector<order_book_delta> >();
+   BOOST_REQUIRE_EQUAL( levels.size(), 1 );
+   BOOST_CHECK_EQUAL( levels[0].for_sale.value, 0 );
+   BOOST_CHECK_EQUAL( levels[0].orders, 0 );
+
+   // a block of the same number on another fork does not get the deltas of the first
+   create_sell_order( buyer_account, asset(50), test_asset.amount(500) );
+   BOOST_CHECK_EQUAL( book.get_deltas( block( 1002, 1 ), 0 ).size(), 1 );
+   BOOST_CHECK_EQUAL( book.get_deltas( block( 1002, 0 ), 0 ).at( market ).as< vector<order_book_delta> >()[0].orders, 0 );
+   BOOST_CHECK( book.get_deltas( block( 1003, 0 ), 0 ).empty() );
+
+   // once irreversible the deltas of a block are dropped, asking again collects the changes since
+   BOOST_CHECK( book.get_deltas( block( 1004, 0 ), 1003 ).empty() );
+   BOOST_CHECK( book.get_deltas( block( 1001, 0 ), 1003 ).empty() );
+ }
+ catch ( const fc::exception& e )
+ {
+    elog( "${e}", ("e", e.to_detail_string() ) );
+    throw;
+ }
+}
+
 BOOST_AUTO_TEST_CASE( witness_feeds )
 {
    using namespace graphene::chain;
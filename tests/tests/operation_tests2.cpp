@@ -327,7 +327,7 @@ BOOST_AUTO_TEST_CASE( mia_feeds )
       op.issuer = obj.issuer;
       op.new_issuer = nathan_id;
       op.new_options = obj.options;
-      op.new_options.flags &= ~witness_fed_asset;
+      op.new_options->flags &= ~witness_fed_asset;
       trx.operations.push_back(op);
       PUSH_TX( db, trx, ~0 );
       generate_block();
@@ -867,7 +867,7 @@ BOOST_AUTO_TEST_CASE( force_settle_test )
          op.asset_to_update = asset_id;
          op.issuer = _asset.issuer;
          op.new_options = _asset.options;
-         update_function( op.new_options );
+         update_function( *op.new_options );
          signed_transaction tx;
          tx.operations.push_back( op );
          set_expiration( db, tx );
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/protocol/fast_pack.hpp>
 
 
 #include <fc/crypto/digest.hpp>
@@ -35,6 +36,21 @@
 
 using namespace graphene::chain;
 
+namespace {
+   /** the fast serializer has to write the bytes of fc::raw and read them back into an equal value */
+   template<typename T>
+   void check_fast_pack( const T& value )
+   {
+      const vector<char> expected = fc::raw::pack( value );
+      BOOST_CHECK_EQUAL( fast_pack::packed_size( value ), expected.size() );
+      const vector<char> packed = fast_pack::pack_to_vector( value );
+      BOOST_CHECK( packed == expected );
+      const T unpacked = fast_pack::unpack_from_vector<T>( expected );
+      BOOST_CHECK( fc::raw::pack( unpacked ) == expected );
+      BOOST_CHECK( fast_pack::hash<fc::sha256>( value ) == fc::sha256::hash( value ) );
+   }
+}
+
 BOOST_FIXTURE_TEST_SUITE( operation_unit_tests, database_fixture )
 
 BOOST_AUTO_TEST_CASE( serialization_raw_test )
@@ -148,4 +164,109 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( fast_pack_matches_fc_raw )
+{
+   try {
+      const uint64_t instances[] = { 0, 1, 127, 128, 300, 16383, 16384, 1ull << 31, GRAPHENE_DB_MAX_INSTANCE_ID };
+      for( uint64_t instance : instances )
+      {
+         check_fast_pack( asset_id_type( instance ) );
+         check_fast_pack( object_id_type( 1, 2, instance ) );
+         check_fast_pack( asset( -int64_t( instance ) - 5, asset_id_type( instance ) ) );
+         check_fast_pack( price( asset( GRAPHENE_MAX_SHARE_SUPPLY, asset_id_type( instance ) ), asset( int64_t( instance ) + 1 ) ) );
+      }
+
+      signed_block_header header;
+      check_fast_pack( block_header( header ) );
+      check_fast_pack( header );
+      header.previous = fc::ripemd160::hash( std::string( "previous" ) );
+      header.timestamp = fc::time_point_sec( 1500000000 );
+      header.witness = witness_id_type( 4000 );
+      header.transaction_merkle_root = fc::ripemd160::hash( std::string( "merkle" ) );
+      auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "fast_pack" ) ) );
+      header.sign( key );
+      check_fast_pack( block_header( header ) );
+      check_fast_pack( header );
+      BOOST_CHECK( header.digest() == digest_type::hash( block_header( header ) ) );
+      BOOST_CHECK( header.signee() == key.get_public_key() );
+
+      // extensions are not used yet, a header carrying them still serializes like fc::raw
+      header.extensions.insert( future_extensions( void_t() ) );
+      check_fast_pack( header );
+
+      // truncated data is rejected
+      vector<char> truncated = fc::raw::pack( header );
+      truncated.pop_back();
+      GRAPHENE_REQUIRE_THROW( fast_pack::unpack_from_vector<signed_block_header>( truncated ), fc::exception );
+      vector<char> longer = fc::raw::pack( asset( 5 ) );
+      longer.push_back( 0 );
+      GRAPHENE_REQUIRE_THROW( fast_pack::unpack_from_vector<asset>( longer ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( boxed_members_keep_wire_format )
+{
+   try {
+      vector<char> expected;
+      auto append = [&expected]( const vector<char>& bytes ) { expected.insert( expected.end(), bytes.begin(), bytes.end() ); };
+
+      // an account update is packed as with the optionals it had before
+      account_update_operation update;
+      update.account = account_id_type( 7 );
+      update.owner = authority( 1, account_id_type( 9 ), 1 );
+      append( fc::raw::pack( update.fee ) );
+      append( fc::raw::pack( update.account ) );
+      append( fc::raw::pack( fc::optional<authority>( *update.owner ) ) );
+      append( fc::raw::pack( fc::optional<authority>() ) );
+      append( fc::raw::pack( fc::optional<account_options>() ) );
+      append( fc::raw::pack( update.extensions ) );
+      BOOST_CHECK( fc::raw::pack( update ) == expected );
+      const auto unpacked_update = fc::raw::unpack<account_update_operation>( expected );
+      BOOST_REQUIRE( unpacked_update.owner.valid() );
+      BOOST_CHECK( *unpacked_update.owner == *update.owner );
+      BOOST_CHECK( !unpacked_update.active.valid() );
+      BOOST_CHECK( !unpacked_update.new_options.valid() );
+
+      // and what it does not update is left out of its JSON
+      const fc::variant update_json( update );
+      BOOST_CHECK( update_json.get_object().contains( "owner" ) );
+      BOOST_CHECK( !update_json.get_object().contains( "active" ) );
+      BOOST_CHECK( !update_json.get_object().contains( "new_options" ) );
+      BOOST_CHECK( fc::raw::pack( update_json.as<account_update_operation>() ) == expected );
+
+      // a box that was never written reads as a default value
+      asset_create_operation create;
+      BOOST_CHECK( create.common_options->max_supply == asset_options().max_supply );
+      create.issuer = account_id_type( 3 );
+      create.symbol = "BOXED";
+      create.common_options->description = "kept on the heap";
+      expected.clear();
+      append( fc::raw::pack( create.fee ) );
+      append( fc::raw::pack( create.issuer ) );
+      append( fc::raw::pack( create.symbol ) );
+      append( fc::raw::pack( create.precision ) );
+      append( fc::raw::pack( *create.common_options ) );
+      append( fc::raw::pack( create.bitasset_opts ) );
+      append( fc::raw::pack( create.is_prediction_market ) );
+      append( fc::raw::pack( create.extensions ) );
+      BOOST_CHECK( fc::raw::pack( create ) == expected );
+      BOOST_CHECK_EQUAL( sizeof( create.common_options ), sizeof( void* ) );
+
+      // copies do not share the box
+      const asset_create_operation copy = create;
+      create.common_options->description.clear();
+      BOOST_CHECK_EQUAL( copy.common_options->description, "kept on the heap" );
+      const fc::variant create_json( copy );
+      BOOST_CHECK_EQUAL( create_json.get_object()["common_options"].get_object()["description"].as_string(), "kept on the heap" );
+      BOOST_CHECK( fc::raw::pack( create_json.as<asset_create_operation>() ) == expected );
+      BOOST_CHECK_EQUAL( fc::raw::unpack<asset_create_operation>( expected ).common_options->description, "kept on the heap" );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -49,13 +49,13 @@ BOOST_AUTO_TEST_CASE( create_advanced_uia )
       creator.issuer = account_id_type();
       creator.fee = asset();
       creator.symbol = "ADVANCED";
-      creator.common_options.max_supply = 100000000;
+      creator.common_options->max_supply = 100000000;
       creator.precision = 2;
-      creator.common_options.market_fee_percent = GRAPHENE_MAX_MARKET_FEE_PERCENT/100; /*1%*/
-      creator.common_options.issuer_permissions = charge_market_fee|white_list|override_authority|transfer_restricted|disable_confidential;
-      creator.common_options.flags = charge_market_fee|white_list|override_authority|disable_confidential;
-      creator.common_options.core_exchange_rate = price({asset(2),asset(1,asset_id_type(1))});
-      creator.common_options.whitelist_authorities = creator.common_options.blacklist_authorities = {account_id_type()};
+      creator.common_options->market_fee_percent = GRAPHENE_MAX_MARKET_FEE_PERCENT/100; /*1%*/
+      creator.common_options->issuer_permissions = charge_market_fee|white_list|override_authority|transfer_restricted|disable_confidential;
+      creator.common_options->flags = charge_market_fee|white_list|override_authority|disable_confidential;
+      creator.common_options->core_exchange_rate = price({asset(2),asset(1,asset_id_type(1))});
+      creator.common_options->whitelist_authorities = creator.common_options->blacklist_authorities = {account_id_type()};
       trx.operations.push_back(std::move(creator));
       PUSH_TX( db, trx, ~0 );
 
@@ -172,7 +172,7 @@ BOOST_AUTO_TEST_CASE( issue_whitelist_uia )
          uop.issuer = izzy_id;
          uop.asset_to_update = uia_id;
          uop.new_options = uia_id(db).options;
-         uop.new_options.whitelist_authorities.insert(izzy_id);
+         uop.new_options->whitelist_authorities.insert(izzy_id);
          trx.operations.back() = uop;
          PUSH_TX( db, trx, ~0 );
          BOOST_CHECK( uia_id(db).options.whitelist_authorities.find(izzy_id) != uia_id(db).options.whitelist_authorities.end() );
@@ -214,6 +214,42 @@ BOOST_AUTO_TEST_CASE( issue_whitelist_uia )
    }
 }
 
+BOOST_AUTO_TEST_CASE( authorized_asset_cache_test )
+{
+   try {
+      INVOKE(issue_whitelist_uia);
+      const asset_id_type uia_id = get_asset("ADVANCED").id;
+      const account_id_type nathan_id = get_account("nathan").id;
+      bool authorized = false;
+
+      BOOST_CHECK( is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+      BOOST_REQUIRE( db.get_authorized_asset_cache().find( nathan_id, uia_id, true, authorized ) );
+      BOOST_CHECK( authorized );
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( nathan_id(db), []( account_object& a ) { a.whitelisting_accounts.clear(); } );
+         BOOST_CHECK( !db.get_authorized_asset_cache().find( nathan_id, uia_id, true, authorized ) );
+         BOOST_CHECK( !is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+      }
+      // undoing the change forgets the verdict made while nathan was not whitelisted
+      BOOST_CHECK( !db.get_authorized_asset_cache().find( nathan_id, uia_id, true, authorized ) );
+      BOOST_CHECK( is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( uia_id(db), []( asset_object& a ) {
+            a.options.whitelist_authorities = { GRAPHENE_COMMITTEE_ACCOUNT };
+         } );
+         BOOST_CHECK( !is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+      }
+      BOOST_CHECK( is_authorized_asset( db, nathan_id(db), uia_id(db) ) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( transfer_whitelist_uia )
 {
    try {
@@ -256,7 +292,7 @@ BOOST_AUTO_TEST_CASE( transfer_whitelist_uia )
          uop.issuer = izzy_id;
          uop.asset_to_update = advanced.id;
          uop.new_options = advanced.options;
-         uop.new_options.blacklist_authorities.insert(izzy_id);
+         uop.new_options->blacklist_authorities.insert(izzy_id);
          trx.operations.back() = uop;
          PUSH_TX( db, trx, ~0 );
          BOOST_CHECK( advanced.options.blacklist_authorities.find(izzy_id) != advanced.options.blacklist_authorities.end() );
@@ -302,8 +338,8 @@ BOOST_AUTO_TEST_CASE( transfer_whitelist_uia )
          op.issuer = izzy_id;
          op.asset_to_update = advanced.id;
          op.new_options = advanced.options;
-         op.new_options.blacklist_authorities.clear();
-         op.new_options.blacklist_authorities.insert(dan.id);
+         op.new_options->blacklist_authorities.clear();
+         op.new_options->blacklist_authorities.insert(dan.id);
          trx.operations.back() = op;
          PUSH_TX( db, trx, ~0 );
          BOOST_CHECK(advanced.options.blacklist_authorities.find(dan.id) != advanced.options.blacklist_authorities.end());
@@ -388,9 +424,9 @@ BOOST_AUTO_TEST_CASE( transfer_restricted_test )
          op.asset_to_update = uia.id;
          op.new_options = uia.options;
          if( xfer_flag )
-            op.new_options.flags |= transfer_restricted;
+            op.new_options->flags |= transfer_restricted;
          else
-            op.new_options.flags &= ~transfer_restricted;
+            op.new_options->flags &= ~transfer_restricted;
          transaction tx;
          tx.operations.push_back( op );
          set_expiration( db, tx );